@@ -31,6 +31,10 @@
 #include "gdal_priv.h"
 #include "gdal_alg.h"
 #include "ogr_api.h"
+#include "cpl_multiproc.h"
+#include "cpl_worker_thread_pool.h"
+#include <vector>
+#include <algorithm>
 
 CPL_CVSID("$Id$");
 
@@ -137,6 +141,8 @@ class GDALContourGenerator
 
     GDALContourLevel *FindLevel( double dfLevel );
 
+    void   PerturbLine( double *padfLine );
+
 public:
     GDALContourWriter pfnWriter;
     void   *pWriterCBData;
@@ -153,6 +159,8 @@ public:
 
     void                SetFixedLevels( int, double * );
     CPLErr              FeedLine( double *padfScanline );
+    void                SetPreviousLine( int iNextLine, 
+                                         double *padfScanline );
     CPLErr              EjectContours( int bOnlyUnused = FALSE );
     
 };
@@ -530,10 +538,10 @@ CPLErr GDALContourGenerator::ProcessRect(
         double adfX[4], adfY[4];
         CPLErr eErr;
 
-        /* Logs how many points we have af left + bottom,
-        ** and left + bottom + right.
+        /* Logs how many points we have after left, and after
+        ** left + bottom.
         */
-        int nPoints1 = 0, nPoints2 = 0, nPoints3 = 0;
+        int nPoints1 = 0, nPoints2 = 0;
 
 
         Intersect( dfUpLeft, dfUpLeftX, dfUpLeftY,
@@ -547,7 +555,6 @@ CPLErr GDALContourGenerator::ProcessRect(
         Intersect( dfLoRight, dfLoRightX, dfLoRightY,
                    dfUpRight, dfUpRightX, dfUpRightY,
                    dfUpLeft, dfLevel, &nPoints, adfX, adfY );
-        nPoints3 = nPoints;
         Intersect( dfUpRight, dfUpRightX, dfUpRightY,
                    dfUpLeft, dfUpLeftX, dfUpLeftY,
                    dfLoLeft, dfLevel, &nPoints, adfX, adfY );
@@ -557,26 +564,25 @@ CPLErr GDALContourGenerator::ProcessRect(
 
         if( nPoints >= 2 )
         {
-            if( 
-                ( ( (nPoints1 == 1 && nPoints2 == 2)||
-                    (nPoints1 == 1 && nPoints3 == 2)|| 
-                    (nPoints1 == 1 && nPoints  == 2)  ) &&
-                                           dfUpLeft > dfLoLeft )
-                ||
-                ( ( (nPoints2 == 1 && nPoints3 == 2)||
-                    (nPoints2 == 1 && nPoints  == 2)  ) &&
-                                         dfLoLeft > dfLoRight )
-                ||
-                ( ( (nPoints3 == 1 && nPoints  == 2)  ) &&
-                                         dfLoRight > dfUpRight )
-              )
-                eErr = AddSegment( dfLevel,
-                                   adfX[0], adfY[0], adfX[1], adfY[1],
-                                   TRUE );
+            /* The edges are walked counter clockwise starting with the
+            ** left one, so the left of the segment is the high side if
+            ** the corner starting the edge of the first point is higher
+            ** than the corner ending it.  Only that edge may be tested:
+            ** testing the later edges as well would flip contours that
+            ** cross them in the other direction.
+            */
+            int bLeftHigh;
+
+            if( nPoints1 == 1 )
+                bLeftHigh = dfUpLeft > dfLoLeft;
+            else if( nPoints2 == 1 )
+                bLeftHigh = dfLoLeft > dfLoRight;
             else
-                eErr = AddSegment( dfLevel,
-                                   adfX[0], adfY[0], adfX[1], adfY[1],
-                                   FALSE );
+                bLeftHigh = dfLoRight > dfUpRight;
+
+            eErr = AddSegment( dfLevel,
+                               adfX[0], adfY[0], adfX[1], adfY[1],
+                               bLeftHigh );
 
             if( eErr != CE_None )
                 return eErr;
@@ -713,21 +719,7 @@ CPLErr GDALContourGenerator::FeedLine( double *padfScanline )
 /* -------------------------------------------------------------------- */
 /*      Perturb any values that occur exactly on level boundaries.      */
 /* -------------------------------------------------------------------- */
-    int iPixel;
-
-    for( iPixel = 0; iPixel < nWidth; iPixel++ )
-    {
-        if( bNoDataActive && padfThisLine[iPixel] == dfNoDataValue )
-            continue;
-
-        double dfLevel = (padfThisLine[iPixel] - dfContourOffset) 
-            / dfContourInterval;
-
-        if( dfLevel - (int) dfLevel == 0.0 )
-        {
-            padfThisLine[iPixel] += dfContourInterval * FUDGE_EXACT;
-        }
-    }
+    PerturbLine( padfThisLine );
 
 /* -------------------------------------------------------------------- */
 /*      If this is the first line we need to initialize the previous    */
@@ -756,6 +748,8 @@ CPLErr GDALContourGenerator::FeedLine( double *padfScanline )
 /* -------------------------------------------------------------------- */
 /*      Process each pixel.                                             */
 /* -------------------------------------------------------------------- */
+    int iPixel;
+
     for( iPixel = 0; iPixel < nWidth+1; iPixel++ )
     {
         CPLErr eErr = ProcessPixel( iPixel );
@@ -776,6 +770,48 @@ CPLErr GDALContourGenerator::FeedLine( double *padfScanline )
         return eErr;
 }
 
+/************************************************************************/
+/*                          SetPreviousLine()                           */
+/*                                                                      */
+/*      Load the scanline just above iNextLine so that feeding can      */
+/*      start in the middle of the raster, as when the raster is        */
+/*      contoured in strips.                                            */
+/************************************************************************/
+
+void GDALContourGenerator::SetPreviousLine( int iNextLine, 
+                                            double *padfScanline )
+
+{
+    memcpy( padfThisLine, padfScanline, sizeof(double) * nWidth );
+    PerturbLine( padfThisLine );
+
+    iLine = iNextLine;
+}
+
+/************************************************************************/
+/*                            PerturbLine()                             */
+/************************************************************************/
+
+void GDALContourGenerator::PerturbLine( double *padfLine )
+
+{
+    int iPixel;
+
+    for( iPixel = 0; iPixel < nWidth; iPixel++ )
+    {
+        if( bNoDataActive && padfLine[iPixel] == dfNoDataValue )
+            continue;
+
+        double dfLevel = (padfLine[iPixel] - dfContourOffset) 
+            / dfContourInterval;
+
+        if( dfLevel - (int) dfLevel == 0.0 )
+        {
+            padfLine[iPixel] += dfContourInterval * FUDGE_EXACT;
+        }
+    }
+}
+
 /************************************************************************/
 /*                           EjectContours()                            */
 /************************************************************************/
@@ -1359,6 +1395,467 @@ CPLErr OGRContourWriter( double dfLevel,
     return CE_None;
 }
 
+/************************************************************************/
+/* ==================================================================== */
+/*                           Strip Processing                           */
+/*                                                                      */
+/*      The raster may be contoured in horizontal strips of lines by    */
+/*      several threads.  Each strip is fed into its own generator,     */
+/*      and the contour pieces ejected with an end on a strip seam      */
+/*      are joined back together in strip order before writing.         */
+/* ==================================================================== */
+/************************************************************************/
+
+typedef struct {
+    int         nYOff;
+    int         nYSize;
+    std::vector<GDALContourItem *> apoPieces;
+    CPLErr      eErr;
+} GDALContourStrip;
+
+typedef struct {
+    GDALRasterBandH hBand;
+    int         nXSize;
+    int         nYSize;
+    int         nFixedLevelCount;
+    double      *padfFixedLevels;
+    double      dfContourInterval;
+    double      dfContourBase;
+    int         bUseNoData;
+    double      dfNoDataValue;
+    GDALContourStrip *pasStrips;
+    void        *hIOMutex;
+} GDALContourStripJob;
+
+typedef struct {
+    double      dfLevel;
+    double      dfX;
+    double      dfY;
+    int         iChain;
+    int         bUsed;
+} GDALContourSeamEnd;
+
+static bool GDALContourSeamEndLess( const GDALContourSeamEnd &sA, 
+                                    const GDALContourSeamEnd &sB )
+{
+    if( sA.dfLevel != sB.dfLevel )
+        return sA.dfLevel < sB.dfLevel;
+    return sA.dfX < sB.dfX;
+}
+
+/************************************************************************/
+/*                       GDALContourPieceWriter()                       */
+/*                                                                      */
+/*      Writer used by the strip generators to keep the ejected         */
+/*      contours, already in their final direction.                     */
+/************************************************************************/
+
+static CPLErr GDALContourPieceWriter( double dfLevel, int nPoints, 
+                                      double *padfX, double *padfY, 
+                                      void *pInfo )
+
+{
+    GDALContourStrip *psStrip = (GDALContourStrip *) pInfo;
+    GDALContourItem *poPiece = new GDALContourItem( dfLevel );
+
+    poPiece->MakeRoomFor( nPoints );
+    memcpy( poPiece->padfX, padfX, sizeof(double) * nPoints );
+    memcpy( poPiece->padfY, padfY, sizeof(double) * nPoints );
+    poPiece->nPoints = nPoints;
+    poPiece->dfTailX = padfX[nPoints-1];
+
+    psStrip->apoPieces.push_back( poPiece );
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                       GDALContourStripPieces()                       */
+/*                                                                      */
+/*      Run a generator over the lines of one strip, starting from      */
+/*      the line above it.                                              */
+/************************************************************************/
+
+static CPLErr GDALContourStripPieces( GDALContourStripJob *psJob, 
+                                      GDALContourStrip *psStrip )
+
+{
+    GDALContourGenerator oCG( psJob->nXSize, psJob->nYSize, 
+                              GDALContourPieceWriter, psStrip );
+
+    if( psJob->nFixedLevelCount > 0 )
+        oCG.SetFixedLevels( psJob->nFixedLevelCount, psJob->padfFixedLevels );
+    else
+        oCG.SetContourLevels( psJob->dfContourInterval, 
+                              psJob->dfContourBase );
+
+    if( psJob->bUseNoData )
+        oCG.SetNoData( psJob->dfNoDataValue );
+
+    double *padfScanline = 
+        (double *) VSIMalloc2( sizeof(double), psJob->nXSize );
+    if( padfScanline == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "VSIMalloc(): Out of memory in GDALContourGenerate" );
+        return CE_Failure;
+    }
+
+    const int nEndLine = psStrip->nYOff + psStrip->nYSize;
+    CPLErr eErr = CE_None;
+    int iLine;
+
+    for( iLine = MAX(0,psStrip->nYOff-1); 
+         iLine < nEndLine && eErr == CE_None; iLine++ )
+    {
+        {
+            CPLMutexHolderD( &(psJob->hIOMutex) );
+            eErr = GDALRasterIO( psJob->hBand, GF_Read, 0, iLine, 
+                                 psJob->nXSize, 1, padfScanline, 
+                                 psJob->nXSize, 1, GDT_Float64, 0, 0 );
+        }
+
+        if( eErr != CE_None )
+            break;
+
+        if( iLine < psStrip->nYOff )
+            oCG.SetPreviousLine( psStrip->nYOff, padfScanline );
+        else
+            eErr = oCG.FeedLine( padfScanline );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      The last line of the raster flushes the generator itself,       */
+/*      other strips have to eject what is left at their bottom.        */
+/* -------------------------------------------------------------------- */
+    if( eErr == CE_None && nEndLine < psJob->nYSize )
+        eErr = oCG.EjectContours( FALSE );
+
+    CPLFree( padfScanline );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                         GDALContourRunStrip()                        */
+/************************************************************************/
+
+static int GDALContourRunStrip( void *pUserData, int iJob )
+
+{
+    GDALContourStripJob *psJob = (GDALContourStripJob *) pUserData;
+    GDALContourStrip *psStrip = psJob->pasStrips + iJob;
+
+    psStrip->eErr = GDALContourStripPieces( psJob, psStrip );
+
+    return psStrip->eErr == CE_None;
+}
+
+/************************************************************************/
+/*                         GDALContourFindRoot()                        */
+/************************************************************************/
+
+static int GDALContourFindRoot( std::vector<int> &anParent, int iNode )
+
+{
+    while( anParent[iNode] != iNode )
+    {
+        anParent[iNode] = anParent[anParent[iNode]];
+        iNode = anParent[iNode];
+    }
+
+    return iNode;
+}
+
+/************************************************************************/
+/*                         GDALContourMoveEnd()                         */
+/*                                                                      */
+/*      Move the end of a chain found at (dfX,dfY) to (dfNewX,dfNewY).  */
+/************************************************************************/
+
+static void GDALContourMoveEnd( GDALContourItem *poChain, 
+                                double dfX, double dfY,
+                                double dfNewX, double dfNewY )
+
+{
+    int iEnd = poChain->nPoints - 1;
+
+    if( poChain->padfX[0] == dfX && poChain->padfY[0] == dfY )
+        iEnd = 0;
+    else if( poChain->padfX[iEnd] != dfX || poChain->padfY[iEnd] != dfY )
+        return;
+
+    poChain->padfX[iEnd] = dfNewX;
+    poChain->padfY[iEnd] = dfNewY;
+    if( iEnd == poChain->nPoints - 1 )
+        poChain->dfTailX = dfNewX;
+}
+
+/************************************************************************/
+/*                        GDALContourStitchStrip()                      */
+/*                                                                      */
+/*      Join the pieces of a strip to the contours left open at the     */
+/*      bottom of the previous strip, then write every contour that     */
+/*      does not reach the bottom of this strip.  The open contours     */
+/*      are carried on to the next strip in apoOpen.                    */
+/************************************************************************/
+
+static CPLErr GDALContourStitchStrip( GDALContourStrip *psStrip, 
+                                      int bLastStrip,
+                                      std::vector<GDALContourItem *> &apoOpen,
+                                      GDALContourWriter pfnWriter, 
+                                      void *pWriterCBData )
+
+{
+    const double dfTopY = psStrip->nYOff - 0.5;
+    const double dfBottomY = psStrip->nYOff + psStrip->nYSize - 0.5;
+    const int nOpen = (int) apoOpen.size();
+    std::vector<GDALContourItem *> apoChains( apoOpen );
+    int     iChain;
+
+    apoChains.insert( apoChains.end(), psStrip->apoPieces.begin(), 
+                      psStrip->apoPieces.end() );
+    psStrip->apoPieces.clear();
+    apoOpen.clear();
+
+    std::vector<int> anParent( apoChains.size() );
+    for( iChain = 0; iChain < (int) apoChains.size(); iChain++ )
+        anParent[iChain] = iChain;
+
+/* -------------------------------------------------------------------- */
+/*      Index the ends of the open contours, which all lie on our       */
+/*      top seam, by level and position.  Both strips compute the       */
+/*      points on the seam from the same pixel values, so the ends      */
+/*      that meet normally have exactly the same X.  Next to nodata     */
+/*      pixels and on pixel centers they may differ by rounding, up     */
+/*      to the JOIN_DIST the single pass generator also tolerates, so   */
+/*      each piece end is joined to the closest unused end within it.   */
+/* -------------------------------------------------------------------- */
+    std::vector<GDALContourSeamEnd> asEnds;
+
+    for( iChain = 0; iChain < nOpen; iChain++ )
+    {
+        GDALContourItem *poChain = apoChains[iChain];
+        int aiEnds[2], i;
+
+        aiEnds[0] = 0;
+        aiEnds[1] = poChain->nPoints - 1;
+
+        for( i = 0; i < 2; i++ )
+        {
+            int iEnd = aiEnds[i];
+
+            if( fabs(poChain->padfY[iEnd] - dfTopY) < JOIN_DIST )
+            {
+                GDALContourSeamEnd sEnd;
+
+                sEnd.dfLevel = poChain->dfLevel;
+                sEnd.dfX = poChain->padfX[iEnd];
+                sEnd.dfY = poChain->padfY[iEnd];
+                sEnd.iChain = iChain;
+                sEnd.bUsed = FALSE;
+                asEnds.push_back( sEnd );
+            }
+        }
+    }
+
+    std::sort( asEnds.begin(), asEnds.end(), GDALContourSeamEndLess );
+
+/* -------------------------------------------------------------------- */
+/*      Join the pieces reaching the top seam to the open contour       */
+/*      ends they meet.                                                 */
+/* -------------------------------------------------------------------- */
+    for( iChain = nOpen; iChain < (int) apoChains.size() && !asEnds.empty();
+         iChain++ )
+    {
+        GDALContourItem *poPiece = apoChains[iChain];
+        double dfLevel = poPiece->dfLevel, adfEndX[2], adfEndY[2];
+        int abOnSeam[2], iEnd;
+
+        // Take the ends now, the piece may be merged away below.
+        adfEndX[0] = poPiece->padfX[0];
+        adfEndX[1] = poPiece->padfX[poPiece->nPoints-1];
+        adfEndY[0] = poPiece->padfY[0];
+        adfEndY[1] = poPiece->padfY[poPiece->nPoints-1];
+        abOnSeam[0] = fabs(poPiece->padfY[0] - dfTopY) < JOIN_DIST;
+        abOnSeam[1] = 
+            fabs(poPiece->padfY[poPiece->nPoints-1] - dfTopY) < JOIN_DIST;
+
+        for( iEnd = 0; iEnd < 2; iEnd++ )
+        {
+            if( !abOnSeam[iEnd] )
+                continue;
+
+            GDALContourSeamEnd sKey;
+
+            sKey.dfLevel = dfLevel;
+            sKey.dfX = adfEndX[iEnd] - JOIN_DIST;
+
+            std::vector<GDALContourSeamEnd>::iterator oIter = 
+                std::lower_bound( asEnds.begin(), asEnds.end(), sKey, 
+                                  GDALContourSeamEndLess );
+            std::vector<GDALContourSeamEnd>::iterator oBest = asEnds.end();
+
+            for( ; oIter != asEnds.end() 
+                     && oIter->dfLevel == dfLevel
+                     && oIter->dfX < adfEndX[iEnd] + JOIN_DIST; ++oIter )
+            {
+                if( !oIter->bUsed 
+                    && ( oBest == asEnds.end() 
+                         || fabs(oIter->dfX - adfEndX[iEnd]) 
+                         < fabs(oBest->dfX - adfEndX[iEnd]) ) )
+                    oBest = oIter;
+            }
+
+            if( oBest == asEnds.end() )
+                continue;
+
+            int iTarget = GDALContourFindRoot( anParent, oBest->iChain );
+            int iSource = GDALContourFindRoot( anParent, iChain );
+
+            // Both ends of a closed contour meet the same chain.
+            if( iTarget == iSource )
+            {
+                oBest->bUsed = TRUE;
+                continue;
+            }
+
+            // Both ends are the same seam crossing, so put them at the
+            // same place for Merge() to join them.
+            GDALContourMoveEnd( apoChains[iSource], 
+                                adfEndX[iEnd], adfEndY[iEnd], 
+                                oBest->dfX, oBest->dfY );
+
+            if( !apoChains[iTarget]->Merge( apoChains[iSource] ) )
+                continue;
+
+            oBest->bUsed = TRUE;
+
+            delete apoChains[iSource];
+            apoChains[iSource] = NULL;
+            anParent[iSource] = iTarget;
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Write the finished contours, and keep those reaching the        */
+/*      bottom seam open for the next strip.                            */
+/* -------------------------------------------------------------------- */
+    CPLErr eErr = CE_None;
+
+    for( iChain = 0; iChain < (int) apoChains.size(); iChain++ )
+    {
+        GDALContourItem *poChain = apoChains[iChain];
+
+        if( poChain == NULL )
+            continue;
+
+        if( !bLastStrip && eErr == CE_None
+            && ( fabs(poChain->padfY[0] - dfBottomY) < JOIN_DIST
+                 || fabs(poChain->padfY[poChain->nPoints-1] - dfBottomY) 
+                 < JOIN_DIST ) )
+        {
+            apoOpen.push_back( poChain );
+            continue;
+        }
+
+        if( eErr == CE_None && pfnWriter != NULL )
+            eErr = pfnWriter( poChain->dfLevel, poChain->nPoints, 
+                              poChain->padfX, poChain->padfY, 
+                              pWriterCBData );
+
+        delete poChain;
+    }
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                       GDALContourGenerateStrips()                    */
+/************************************************************************/
+
+static CPLErr 
+GDALContourGenerateStrips( GDALContourStripJob *psJob, int nStripHeight, 
+                           int nThreads, 
+                           GDALContourWriter pfnWriter, void *pWriterCBData,
+                           GDALProgressFunc pfnProgress, void *pProgressArg )
+
+{
+    const int nYSize = psJob->nYSize;
+    const int nStripCount = (nYSize + nStripHeight - 1) / nStripHeight;
+    std::vector<GDALContourStrip> asStrips( nThreads );
+
+    psJob->pasStrips = &(asStrips[0]);
+    psJob->hIOMutex = CPLCreateMutex();
+    if( psJob->hIOMutex == NULL )
+        return CE_Failure;
+    CPLReleaseMutex( psJob->hIOMutex );
+
+    CPLDebug( "CONTOUR", "Contouring %d strips of %d lines with %d threads.",
+              nStripCount, nStripHeight, nThreads );
+
+/* -------------------------------------------------------------------- */
+/*      Process the strips, a batch of one per thread at a time, and    */
+/*      stitch them in order so the output does not depend on the       */
+/*      number of threads.                                              */
+/* -------------------------------------------------------------------- */
+    std::vector<GDALContourItem *> apoOpen;
+    CPLErr  eErr = CE_None;
+    int     iStrip, iJob;
+    size_t  iPiece;
+
+    for( iStrip = 0; eErr == CE_None && iStrip < nStripCount; 
+         iStrip += nThreads )
+    {
+        int nJobs = MIN( nThreads, nStripCount - iStrip );
+
+        for( iJob = 0; iJob < nJobs; iJob++ )
+        {
+            asStrips[iJob].nYOff = (iStrip + iJob) * nStripHeight;
+            asStrips[iJob].nYSize = 
+                MIN( nStripHeight, nYSize - asStrips[iJob].nYOff );
+            asStrips[iJob].eErr = CE_Failure;
+        }
+
+        CPLRunJobs( nJobs, nThreads, GDALContourRunStrip, psJob );
+
+        for( iJob = 0; iJob < nJobs; iJob++ )
+        {
+            GDALContourStrip *psStrip = &(asStrips[iJob]);
+
+            if( eErr == CE_None )
+                eErr = psStrip->eErr;
+
+            if( eErr == CE_None )
+                eErr = GDALContourStitchStrip( 
+                    psStrip, iStrip + iJob == nStripCount-1, apoOpen, 
+                    pfnWriter, pWriterCBData );
+
+            for( iPiece = 0; iPiece < psStrip->apoPieces.size(); iPiece++ )
+                delete psStrip->apoPieces[iPiece];
+            psStrip->apoPieces.clear();
+
+            if( eErr == CE_None 
+                && !pfnProgress( (psStrip->nYOff + psStrip->nYSize)
+                                 / (double) nYSize, "", pProgressArg ) )
+            {
+                CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+                eErr = CE_Failure;
+            }
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Cleanup                                                         */
+/* -------------------------------------------------------------------- */
+    for( iPiece = 0; iPiece < apoOpen.size(); iPiece++ )
+        delete apoOpen[iPiece];
+
+    CPLDestroyMutex( psJob->hIOMutex );
+
+    return eErr;
+}
+
 /************************************************************************/
 /*                        GDALContourGenerate()                         */
 /************************************************************************/
@@ -1494,6 +1991,17 @@ an averaged value from the two nearby points (in this case (12+3+5)/3).
  * 
  * @param pProgressArg the callback data for the pfnProgress function.
  *
+ * When the GDAL_CONTOUR_STRIP_HEIGHT configuration option is set to a
+ * number of lines, the raster is contoured in strips of that height on the
+ * number of threads given by the GDAL_NUM_THREADS configuration option,
+ * and the contours crossing from one strip to the next are joined back
+ * together.  The contours are written in a different order than with a
+ * single pass, and closed contours may start at a different vertex.  The
+ * order only depends on the strip height, not on the number of threads.
+ * The geometry is otherwise the same, except next to pixels whose value is
+ * within about 1e-5 of a contour level, where a single pass may join or
+ * split the lines differently depending on the order it meets them in.
+ *
  * @return CE_None on success or CE_Failure if an error occurs.
  */
 
@@ -1533,10 +2041,37 @@ CPLErr GDALContourGenerate( GDALRasterBandH hBand,
     oCWI.nNextID = 0;
 
 /* -------------------------------------------------------------------- */
-/*      Setup contour generator.                                        */
+/*      Contour in strips if a strip height is configured.              */
 /* -------------------------------------------------------------------- */
     int nXSize = GDALGetRasterBandXSize( hBand );
     int nYSize = GDALGetRasterBandYSize( hBand );
+    int nThreads = 
+        CPLParseNumThreads( CPLGetConfigOption( "GDAL_NUM_THREADS", NULL ), 1 );
+    int nStripHeight = 
+        atoi( CPLGetConfigOption( "GDAL_CONTOUR_STRIP_HEIGHT", "0" ) );
+
+    if( nStripHeight > 0 )
+    {
+        GDALContourStripJob sJob;
+
+        sJob.hBand = hBand;
+        sJob.nXSize = nXSize;
+        sJob.nYSize = nYSize;
+        sJob.nFixedLevelCount = nFixedLevelCount;
+        sJob.padfFixedLevels = padfFixedLevels;
+        sJob.dfContourInterval = dfContourInterval;
+        sJob.dfContourBase = dfContourBase;
+        sJob.bUseNoData = bUseNoData;
+        sJob.dfNoDataValue = dfNoDataValue;
+
+        return GDALContourGenerateStrips( &sJob, nStripHeight, nThreads,
+                                          OGRContourWriter, &oCWI,
+                                          pfnProgress, pProgressArg );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Setup contour generator.                                        */
+/* -------------------------------------------------------------------- */
 
     GDALContourGenerator oCG( nXSize, nYSize, OGRContourWriter, &oCWI );
 
@@ -438,6 +438,67 @@ GDALGridCreate( GDALGridAlgorithm, const void *, GUInt32,
                 double, double, double, double,
                 GUInt32, GUInt32, GDALDataType, void *,
                 GDALProgressFunc, void *);
+
+typedef struct GDALGridContext GDALGridContext;
+
+GDALGridContext CPL_DLL *
+GDALGridContextCreate( GDALGridAlgorithm, const void *, GUInt32,
+                       const double *, const double *, const double * );
+void CPL_DLL GDALGridContextFree( GDALGridContext * );
+CPLErr CPL_DLL
+GDALGridContextProcess( GDALGridContext *,
+                        double, double, double, double,
+                        GUInt32, GUInt32, GDALDataType, void *,
+                        GDALProgressFunc, void * );
+
+/************************************************************************/
+/*  Terrain analysis on a 3x3 window (gdaldem).                         */
+/************************************************************************/
+
+/** Terrain analysis algorithms */
+typedef enum {
+  /*! Shaded relief */                  GTA_Hillshade = 1,
+  /*! Slope, in degrees or percent */   GTA_Slope = 2,
+  /*! Aspect, in degrees */             GTA_Aspect = 3,
+  /*! Terrain Ruggedness Index */       GTA_TRI = 4,
+  /*! Topographic Position Index */     GTA_TPI = 5,
+  /*! Roughness */                      GTA_Roughness = 6
+} GDALTerrainAlgorithm;
+
+/** Terrain analysis control options */
+typedef struct
+{
+    /*! Geotransform of the elevation raster, for the pixel sizes. */
+    double  adfGeoTransform[6];
+    /*! Vertical exaggeration (hillshade). */
+    double  dfZFactor;
+    /*! Ratio of vertical units to horizontal units (hillshade, slope). */
+    double  dfScale;
+    /*! Altitude of the light, in degrees (hillshade). */
+    double  dfAltitude;
+    /*! Azimuth of the light, in degrees (hillshade). */
+    double  dfAzimuth;
+    /*! TRUE for a slope in percent rather than in degrees (slope). */
+    int     bSlopeInPercent;
+    /*! TRUE for an azimuth, FALSE for a trigonometric angle (aspect). */
+    int     bAngleAsAzimuth;
+} GDALTerrainOptions;
+
+typedef struct GDALTerrainContext GDALTerrainContext;
+
+GDALTerrainContext CPL_DLL *
+GDALTerrainContextCreate( GDALTerrainAlgorithm, const GDALTerrainOptions *,
+                          int bSrcHasNoData, double dfSrcNoDataValue,
+                          double dfDstNoDataValue );
+void CPL_DLL GDALTerrainContextFree( GDALTerrainContext * );
+void CPL_DLL GDALTerrainContextProcess( GDALTerrainContext *,
+                                        int nXSize, int nLines,
+                                        const float *pafSrc, float *pafDst );
+CPLErr CPL_DLL
+GDALTerrainProcess( GDALRasterBandH hSrcBand, GDALRasterBandH hDstBand,
+                    GDALTerrainAlgorithm, const GDALTerrainOptions *,
+                    GDALProgressFunc pfnProgress, void *pProgressArg );
+
 CPL_C_END
                             
 #endif /* ndef GDAL_ALG_H_INCLUDED */
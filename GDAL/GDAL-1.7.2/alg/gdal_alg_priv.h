@@ -81,6 +81,80 @@ void GDALdllImageFilledPolygon(int nRasterXSize, int nRasterYSize,
                                double *padfVariant,
                                llScanlineFunc pfnScanlineFunc, void *pCBData );
 
+/************************************************************************/
+/*      Vectorized warp kernel resamplers (gdalwarpkernel_simd.cpp).    */
+/*                                                                      */
+/*      Resample nCount destination pixels whose resampling kernel      */
+/*      lies entirely inside the source window.  padfSrcX/padfSrcY      */
+/*      are relative to the source window.                              */
+/************************************************************************/
+
+typedef void (*GWKRowByteFunc)( const GByte *pabySrc, int nSrcXSize,
+                                int nCount, const double *padfSrcX,
+                                const double *padfSrcY, 
+                                const int *panDstOffset, GByte *pabyDst );
+typedef void (*GWKRowShortFunc)( const GInt16 *panSrc, int nSrcXSize,
+                                 int nCount, const double *padfSrcX,
+                                 const double *padfSrcY, 
+                                 const int *panDstOffset, GInt16 *panDst );
+
+typedef struct {
+    const char      *pszName;
+    GWKRowByteFunc   pfnBilinearByte;
+    GWKRowByteFunc   pfnCubicByte;
+    GWKRowShortFunc  pfnBilinearShort;
+    GWKRowShortFunc  pfnCubicShort;
+} GWKSIMDFuncs;
+
+const GWKSIMDFuncs *GWKGetSIMDFuncs( void );
+
+/************************************************************************/
+/*      Copy of a transformer for use from another thread, or NULL if   */
+/*      the transformer cannot be copied (gdaltransformer.cpp).         */
+/************************************************************************/
+
+void *GDALCloneTransformer( GDALTransformerFunc pfnTransformer,
+                            void *pTransformArg );
+
+/************************************************************************/
+/*      Exact euclidean distance transform in strips of lines           */
+/*      (gdaldistancetransform.cpp), used by GDALComputeProximity()     */
+/*      and GDALFillNodata().                                           */
+/************************************************************************/
+
+/** Features searched for around each pixel */
+typedef enum {
+    /*! All features */                                GEDT_Whole = 0,
+    /*! At or above, and at or left of the pixel */    GEDT_TopLeft = 1,
+    /*! Below, and at or left of the pixel */          GEDT_BottomLeft = 2,
+    /*! At or above, and right of the pixel */         GEDT_TopRight = 3,
+    /*! Below, and right of the pixel */               GEDT_BottomRight = 4
+} GDALEDTRegion;
+
+#define GEDT_MAX_REGIONS 4
+
+typedef CPLErr (*GDALEDTReadFunc)( void *pUserData, int nYOff, int nLines,
+                                   GByte *pabyFeature, float *pafValue );
+typedef void (*GDALEDTLineFunc)( void *pUserData, int iLine,
+                                 float **papafDist, float **papafValue );
+typedef CPLErr (*GDALEDTWriteFunc)( void *pUserData, int nYOff, int nLines );
+
+typedef struct {
+    int              nXSize;
+    int              nYSize;
+    double           dfMaxDist;
+    int              nRegions;
+    GDALEDTRegion    aeRegions[GEDT_MAX_REGIONS];
+    int              bValues;
+    GDALEDTReadFunc  pfnRead;
+    GDALEDTLineFunc  pfnLine;
+    GDALEDTWriteFunc pfnWrite;
+    void             *pUserData;
+} GDALEDTInfo;
+
+CPLErr GDALEDTProcess( GDALEDTInfo *psInfo,
+                       GDALProgressFunc pfnProgress, void *pProgressArg );
+
 CPL_C_END
 
 /************************************************************************/
@@ -0,0 +1,635 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL
+ * Purpose:  Exact euclidean distance transform, computed in strips of
+ *           lines, shared by GDALComputeProximity() and GDALFillNodata().
+ *
+ ******************************************************************************
+ * Copyright (c) 2010, GDAL contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************
+ *
+ * The transform is separable (P. Felzenszwalb and D. Huttenlocher,
+ * "Distance Transforms of Sampled Functions", 2004).  A column pass finds
+ * the nearest feature above and below each pixel in its own column, and a
+ * line pass then takes, for each pixel, the lower envelope of the
+ * parabolas (x - x')^2 + dy(x')^2 over the columns x' of its line.
+ *
+ * The column pass is a top to bottom sweep followed by a bottom to top
+ * sweep.  The first sweep only keeps the column state at the top of each
+ * strip, and the second one recomputes it within the strip, so the whole
+ * raster never has to be held in memory or in temporary files.  The line
+ * pass of a strip is run by several threads.
+ ****************************************************************************/
+
+#include "gdal_alg_priv.h"
+#include "cpl_conv.h"
+#include "cpl_worker_thread_pool.h"
+#include <math.h>
+
+CPL_CVSID("$Id$");
+
+/************************************************************************/
+/*                          GDALEDTEnvelope                             */
+/*                                                                      */
+/*      Lower envelope of the parabolas (i - i')^2 + f(i') of a line,   */
+/*      the parabolas being added in increasing i' order.  With         */
+/*      bReverse the positions i are counted from the right end of the  */
+/*      line.  panV holds the position of the parabolas of the          */
+/*      envelope, and padfZ where each starts to be the lowest one.     */
+/************************************************************************/
+
+typedef struct {
+    int         nXSize;
+    int         bReverse;
+    const double *padfF;
+    int         *panV;
+    double      *padfZ;
+    int         nCount;
+    int         iCurrent;
+} GDALEDTEnvelope;
+
+#define EDT_COL(psEnv,i)  ((psEnv)->bReverse ? (psEnv)->nXSize - 1 - (i) : (i))
+#define EDT_VAL(psEnv,k,i) \
+    ((psEnv)->padfF[EDT_COL(psEnv,(psEnv)->panV[k])]                    \
+     + ((double)(i) - (psEnv)->panV[k]) * ((double)(i) - (psEnv)->panV[k]))
+
+/************************************************************************/
+/*                        GDALEDTAddParabola()                          */
+/*                                                                      */
+/*      Add the parabola at position i, if its column has a feature,    */
+/*      dropping the parabolas it hides.                                */
+/************************************************************************/
+
+static void GDALEDTAddParabola( GDALEDTEnvelope *psEnv, int i )
+
+{
+    double dfF = psEnv->padfF[EDT_COL(psEnv,i)];
+    double dfS = -HUGE_VAL;
+
+    if( dfF < 0.0 )
+        return;
+
+    while( psEnv->nCount > 0 )
+    {
+        int iLast = psEnv->panV[psEnv->nCount-1];
+
+        dfS = ((dfF + (double) i * i)
+               - (psEnv->padfF[EDT_COL(psEnv,iLast)] 
+                  + (double) iLast * iLast))
+            / (2.0 * (i - iLast));
+
+        if( dfS <= psEnv->padfZ[psEnv->nCount-1] )
+            psEnv->nCount--;
+        else
+            break;
+    }
+
+    psEnv->panV[psEnv->nCount] = i;
+    psEnv->padfZ[psEnv->nCount] = (psEnv->nCount == 0) ? -HUGE_VAL : dfS;
+    psEnv->nCount++;
+
+    if( psEnv->iCurrent > psEnv->nCount - 1 )
+        psEnv->iCurrent = psEnv->nCount - 1;
+}
+
+/************************************************************************/
+/*                          GDALEDTQuery()                              */
+/*                                                                      */
+/*      Find the lowest parabola at position i, setting the column of   */
+/*      its feature (-1 if the envelope is empty) and the squared       */
+/*      distance.  Positions must be queried in increasing order: the   */
+/*      parabolas before the current one were left behind by a         */
+/*      previous query.  On ties the parabola of highest position,      */
+/*      that is the nearest to a position past all of them, wins.      */
+/************************************************************************/
+
+static void GDALEDTQuery( GDALEDTEnvelope *psEnv, int i, 
+                          int *panArg, double *padfDistSq )
+
+{
+    int iCol = EDT_COL(psEnv,i);
+    int k = psEnv->iCurrent;
+
+    if( psEnv->nCount == 0 )
+    {
+        panArg[iCol] = -1;
+        padfDistSq[iCol] = -1.0;
+        return;
+    }
+
+    while( k < psEnv->nCount - 1 
+           && EDT_VAL(psEnv,k+1,i) <= EDT_VAL(psEnv,k,i) )
+        k++;
+
+    psEnv->iCurrent = k;
+    panArg[iCol] = EDT_COL(psEnv,psEnv->panV[k]);
+    padfDistSq[iCol] = EDT_VAL(psEnv,k,i);
+}
+
+/************************************************************************/
+/*                            GDALEDTJob                                */
+/************************************************************************/
+
+typedef struct {
+    GDALEDTInfo *psInfo;
+    int         nYOff;
+    int         nLines;
+    int         nLinesPerJob;
+    const GInt32 *panUp;
+    const GInt32 *panDown;
+    const float *pafUpValue;
+    const float *pafDownValue;
+} GDALEDTJob;
+
+/************************************************************************/
+/*                          GDALEDTLineJob()                            */
+/*                                                                      */
+/*      Line pass over a few lines of the strip.                        */
+/************************************************************************/
+
+static int GDALEDTLineJob( void *pData, int iJob )
+
+{
+    GDALEDTJob *psJob = (GDALEDTJob *) pData;
+    GDALEDTInfo *psInfo = psJob->psInfo;
+    const int nXSize = psInfo->nXSize;
+    const int nRegions = psInfo->nRegions;
+    const double dfMaxDistSq = psInfo->dfMaxDist * psInfo->dfMaxDist;
+    int iLine = iJob * psJob->nLinesPerJob;
+    int nEndLine = MIN(iLine + psJob->nLinesPerJob, psJob->nLines);
+    int iRegion, iX;
+
+/* -------------------------------------------------------------------- */
+/*      Allocate the work buffers of this job.                          */
+/* -------------------------------------------------------------------- */
+    double *padfF = (double *) VSIMalloc2( sizeof(double), nXSize );
+    double *padfZ = (double *) VSIMalloc2( sizeof(double), nXSize );
+    double *padfDistSq = (double *) VSIMalloc2( sizeof(double), nXSize );
+    int    *panV = (int *) VSIMalloc2( sizeof(int), nXSize );
+    int    *panArg = (int *) VSIMalloc2( sizeof(int), nXSize );
+    float  *pafColValue = (float *) VSIMalloc2( sizeof(float), nXSize );
+    float  *pafOutDist = (float *) VSIMalloc3( sizeof(float), nXSize, 
+                                               nRegions );
+    float  *pafOutValue = (float *) VSIMalloc3( sizeof(float), nXSize, 
+                                                nRegions );
+    float  *apafDist[GEDT_MAX_REGIONS];
+    float  *apafValue[GEDT_MAX_REGIONS];
+    int    bOK = TRUE;
+
+    if( padfF == NULL || padfZ == NULL || padfDistSq == NULL 
+        || panV == NULL || panArg == NULL || pafColValue == NULL 
+        || pafOutDist == NULL || pafOutValue == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "Out of memory allocating distance transform buffers." );
+        bOK = FALSE;
+        iLine = nEndLine;
+    }
+
+    for( iRegion = 0; bOK && iRegion < nRegions; iRegion++ )
+    {
+        apafDist[iRegion] = pafOutDist + (size_t) iRegion * nXSize;
+        apafValue[iRegion] = pafOutValue + (size_t) iRegion * nXSize;
+    }
+
+    for( ; iLine < nEndLine; iLine++ )
+    {
+        const int nLine = psJob->nYOff + iLine;
+        const GInt32 *panUp = psJob->panUp + (size_t) iLine * nXSize;
+        const GInt32 *panDown = psJob->panDown + (size_t) iLine * nXSize;
+        const float *pafUpValue = NULL, *pafDownValue = NULL;
+
+        if( psInfo->bValues )
+        {
+            pafUpValue = psJob->pafUpValue + (size_t) iLine * nXSize;
+            pafDownValue = psJob->pafDownValue + (size_t) iLine * nXSize;
+        }
+
+        for( iRegion = 0; iRegion < nRegions; iRegion++ )
+        {
+            GDALEDTRegion eRegion = psInfo->aeRegions[iRegion];
+            int bUp = (eRegion != GEDT_BottomLeft 
+                       && eRegion != GEDT_BottomRight);
+            int bDown = (eRegion != GEDT_TopLeft 
+                         && eRegion != GEDT_TopRight);
+
+/* -------------------------------------------------------------------- */
+/*      Squared distance to the nearest candidate of each column.       */
+/* -------------------------------------------------------------------- */
+            for( iX = 0; iX < nXSize; iX++ )
+            {
+                double dfDY = -1.0;
+
+                if( bUp && panUp[iX] >= 0 )
+                {
+                    dfDY = nLine - panUp[iX];
+                    if( pafUpValue != NULL )
+                        pafColValue[iX] = pafUpValue[iX];
+                }
+                if( bDown && panDown[iX] >= 0 
+                    && (dfDY < 0.0 || panDown[iX] - nLine < dfDY) )
+                {
+                    dfDY = panDown[iX] - nLine;
+                    if( pafDownValue != NULL )
+                        pafColValue[iX] = pafDownValue[iX];
+                }
+
+                if( dfDY < 0.0 || dfDY * dfDY > dfMaxDistSq )
+                    padfF[iX] = -1.0;
+                else
+                    padfF[iX] = dfDY * dfDY;
+            }
+
+/* -------------------------------------------------------------------- */
+/*      Nearest candidate of the line.  The right regions are           */
+/*      processed from the right end, so they become exclusive left     */
+/*      regions.                                                        */
+/* -------------------------------------------------------------------- */
+            GDALEDTEnvelope sEnv;
+
+            sEnv.nXSize = nXSize;
+            sEnv.bReverse = (eRegion == GEDT_TopRight 
+                             || eRegion == GEDT_BottomRight);
+            sEnv.padfF = padfF;
+            sEnv.panV = panV;
+            sEnv.padfZ = padfZ;
+            sEnv.nCount = 0;
+            sEnv.iCurrent = 0;
+
+            if( eRegion == GEDT_Whole )
+            {
+                for( iX = 0; iX < nXSize; iX++ )
+                    GDALEDTAddParabola( &sEnv, iX );
+                for( iX = 0; iX < nXSize; iX++ )
+                    GDALEDTQuery( &sEnv, iX, panArg, padfDistSq );
+            }
+            else if( sEnv.bReverse )
+            {
+                for( iX = 0; iX < nXSize; iX++ )
+                {
+                    GDALEDTQuery( &sEnv, iX, panArg, padfDistSq );
+                    GDALEDTAddParabola( &sEnv, iX );
+                }
+            }
+            else
+            {
+                for( iX = 0; iX < nXSize; iX++ )
+                {
+                    GDALEDTAddParabola( &sEnv, iX );
+                    GDALEDTQuery( &sEnv, iX, panArg, padfDistSq );
+                }
+            }
+
+            float *pafDist = apafDist[iRegion];
+            float *pafValue = apafValue[iRegion];
+
+            for( iX = 0; iX < nXSize; iX++ )
+            {
+                if( panArg[iX] < 0 || padfDistSq[iX] > dfMaxDistSq )
+                {
+                    pafDist[iX] = -1.0;
+                    pafValue[iX] = 0.0;
+                }
+                else
+                {
+                    pafDist[iX] = (float) sqrt( padfDistSq[iX] );
+                    pafValue[iX] = psInfo->bValues ? 
+                        pafColValue[panArg[iX]] : 0.0f;
+                }
+            }
+        }
+
+        psInfo->pfnLine( psInfo->pUserData, nLine, apafDist, apafValue );
+    }
+
+    CPLFree( padfF );
+    CPLFree( padfZ );
+    CPLFree( padfDistSq );
+    CPLFree( panV );
+    CPLFree( panArg );
+    CPLFree( pafColValue );
+    CPLFree( pafOutDist );
+    CPLFree( pafOutValue );
+
+    return bOK;
+}
+
+/************************************************************************/
+/*                          GDALEDTProcess()                            */
+/************************************************************************/
+
+/**
+ * Compute the distance of every pixel to the nearest features.
+ *
+ * The raster is processed in strips of lines.  For each strip, the read
+ * function is called to flag the features (and set their values if 
+ * bValues is set), then the line function is called for each line of the 
+ * strip with the distance to the nearest feature of each region, and the 
+ * value of that feature, and finally the write function is called.  The
+ * line function is called from several threads, as many as allowed by the
+ * GDAL_NUM_THREADS configuration option, and must only touch the data of
+ * its own line.
+ *
+ * The read function is called twice for each strip except the last, once 
+ * in a top to bottom pass and once in a bottom to top pass, with the same
+ * buffers.  In the second pass the buffers of a strip are left untouched
+ * until its write function returns, so the callbacks may keep pointers to
+ * them, and the line function may change the values of its own line.
+ *
+ * Distances are in pixels.  Features further than dfMaxDist are ignored,
+ * and a distance of -1 is given when there is none within dfMaxDist.
+ *
+ * @param psInfo the definition of the transform and the callbacks.
+ * @param pfnProgress progress function, or NULL.
+ * @param pProgressArg argument of the progress function.
+ *
+ * @return CE_None on success or CE_Failure if something goes wrong.
+ */
+
+CPLErr GDALEDTProcess( GDALEDTInfo *psInfo,
+                       GDALProgressFunc pfnProgress, void *pProgressArg )
+
+{
+    const int nXSize = psInfo->nXSize;
+    const int nYSize = psInfo->nYSize;
+    const int bValues = psInfo->bValues;
+    CPLErr eErr = CE_None;
+    int    iStrip, iX, iLine;
+
+    if( pfnProgress == NULL )
+        pfnProgress = GDALDummyProgress;
+
+    if( nXSize < 1 || nYSize < 1 )
+        return CE_None;
+
+    if( psInfo->nRegions < 1 || psInfo->nRegions > GEDT_MAX_REGIONS )
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                  "Unsupported number of distance transform regions: %d",
+                  psInfo->nRegions );
+        return CE_Failure;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Strips of about sqrt(nYSize) lines balance the memory used by   */
+/*      the column states kept at the top of each strip with the one    */
+/*      used by the buffers of a strip.                                 */
+/* -------------------------------------------------------------------- */
+    int nStripLines = MIN( nYSize, MAX( 64, (int) sqrt( (double) nYSize ) ) );
+    int nStrips = (nYSize + nStripLines - 1) / nStripLines;
+    int nThreads = 
+        CPLParseNumThreads( CPLGetConfigOption( "GDAL_NUM_THREADS", NULL ), 1 );
+
+    CPLDebug( "GDAL", 
+              "Distance transform in %d strips of %d lines with %d threads.",
+              nStrips, nStripLines, nThreads );
+
+/* -------------------------------------------------------------------- */
+/*      Allocate the buffers.                                           */
+/* -------------------------------------------------------------------- */
+    GByte  *pabyFeature = (GByte *) VSIMalloc2( nXSize, nStripLines );
+    GInt32 *panUp = (GInt32 *) VSIMalloc3( sizeof(GInt32), nXSize, 
+                                           nStripLines );
+    GInt32 *panDown = (GInt32 *) VSIMalloc3( sizeof(GInt32), nXSize, 
+                                             nStripLines );
+    GInt32 *panTopState = (GInt32 *) VSIMalloc3( sizeof(GInt32), nXSize, 
+                                                 nStrips );
+    GInt32 *panState = (GInt32 *) VSIMalloc2( sizeof(GInt32), nXSize );
+    float  *pafValue = NULL, *pafUpValue = NULL, *pafDownValue = NULL;
+    float  *pafTopStateValue = NULL, *pafStateValue = NULL;
+    int    bOutOfMemory = (pabyFeature == NULL || panUp == NULL 
+                           || panDown == NULL || panTopState == NULL 
+                           || panState == NULL);
+
+    if( bValues )
+    {
+        pafValue = (float *) VSIMalloc3( sizeof(float), nXSize, nStripLines );
+        pafUpValue = (float *) VSIMalloc3( sizeof(float), nXSize, 
+                                           nStripLines );
+        pafDownValue = (float *) VSIMalloc3( sizeof(float), nXSize, 
+                                             nStripLines );
+        pafTopStateValue = (float *) VSIMalloc3( sizeof(float), nXSize, 
+                                                 nStrips );
+        pafStateValue = (float *) VSIMalloc2( sizeof(float), nXSize );
+
+        bOutOfMemory = bOutOfMemory || pafValue == NULL || pafUpValue == NULL
+            || pafDownValue == NULL || pafTopStateValue == NULL 
+            || pafStateValue == NULL;
+    }
+
+    if( bOutOfMemory )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "Out of memory allocating distance transform buffers." );
+        eErr = CE_Failure;
+    }
+
+    double dfLinesDone = 0.0;
+    double dfLinesTotal = (double) (nStrips - 1) * nStripLines + nYSize;
+
+/* ==================================================================== */
+/*      Top to bottom pass, keeping the line of the nearest feature     */
+/*      at or above each column at the top of each strip.               */
+/* ==================================================================== */
+    if( eErr == CE_None )
+    {
+        for( iX = 0; iX < nXSize; iX++ )
+        {
+            panState[iX] = -1;
+            if( bValues )
+                pafStateValue[iX] = 0.0;
+        }
+    }
+
+    for( iStrip = 0; eErr == CE_None && iStrip < nStrips; iStrip++ )
+    {
+        int nYOff = iStrip * nStripLines;
+        int nLines = MIN( nStripLines, nYSize - nYOff );
+
+        memcpy( panTopState + (size_t) iStrip * nXSize, panState, 
+                sizeof(GInt32) * nXSize );
+        if( bValues )
+            memcpy( pafTopStateValue + (size_t) iStrip * nXSize, 
+                    pafStateValue, sizeof(float) * nXSize );
+
+        // The column state of the last strip is not needed.
+        if( iStrip == nStrips - 1 )
+            break;
+
+        eErr = psInfo->pfnRead( psInfo->pUserData, nYOff, nLines, 
+                                pabyFeature, pafValue );
+
+        for( iLine = 0; eErr == CE_None && iLine < nLines; iLine++ )
+        {
+            const GByte *pabyLine = pabyFeature + (size_t) iLine * nXSize;
+
+            for( iX = 0; iX < nXSize; iX++ )
+            {
+                if( pabyLine[iX] )
+                {
+                    panState[iX] = nYOff + iLine;
+                    if( bValues )
+                        pafStateValue[iX] = 
+                            pafValue[(size_t) iLine * nXSize + iX];
+                }
+            }
+        }
+
+        dfLinesDone += nLines;
+        if( eErr == CE_None 
+            && !pfnProgress( dfLinesDone / dfLinesTotal, "", pProgressArg ) )
+        {
+            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+            eErr = CE_Failure;
+        }
+    }
+
+/* ==================================================================== */
+/*      Bottom to top pass, computing the column state of each line     */
+/*      of the strip and then running the line pass.                    */
+/* ==================================================================== */
+    if( eErr == CE_None )
+    {
+        for( iX = 0; iX < nXSize; iX++ )
+        {
+            panState[iX] = -1;
+            if( bValues )
+                pafStateValue[iX] = 0.0;
+        }
+    }
+
+    for( iStrip = nStrips - 1; eErr == CE_None && iStrip >= 0; iStrip-- )
+    {
+        int nYOff = iStrip * nStripLines;
+        int nLines = MIN( nStripLines, nYSize - nYOff );
+
+        eErr = psInfo->pfnRead( psInfo->pUserData, nYOff, nLines, 
+                                pabyFeature, pafValue );
+        if( eErr != CE_None )
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      Nearest feature at or above, from the state at the top of the   */
+/*      strip.                                                          */
+/* -------------------------------------------------------------------- */
+        const GInt32 *panLastUp = panTopState + (size_t) iStrip * nXSize;
+        const float *pafLastUpValue = bValues ? 
+            pafTopStateValue + (size_t) iStrip * nXSize : NULL;
+
+        for( iLine = 0; iLine < nLines; iLine++ )
+        {
+            size_t nOff = (size_t) iLine * nXSize;
+
+            for( iX = 0; iX < nXSize; iX++ )
+            {
+                if( pabyFeature[nOff + iX] )
+                {
+                    panUp[nOff + iX] = nYOff + iLine;
+                    if( bValues )
+                        pafUpValue[nOff + iX] = pafValue[nOff + iX];
+                }
+                else
+                {
+                    panUp[nOff + iX] = panLastUp[iX];
+                    if( bValues )
+                        pafUpValue[nOff + iX] = pafLastUpValue[iX];
+                }
+            }
+
+            panLastUp = panUp + nOff;
+            if( bValues )
+                pafLastUpValue = pafUpValue + nOff;
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Nearest feature strictly below, from the state left by the      */
+/*      strip below.                                                    */
+/* -------------------------------------------------------------------- */
+        for( iLine = nLines - 1; iLine >= 0; iLine-- )
+        {
+            size_t nOff = (size_t) iLine * nXSize;
+
+            memcpy( panDown + nOff, panState, sizeof(GInt32) * nXSize );
+            if( bValues )
+                memcpy( pafDownValue + nOff, pafStateValue, 
+                        sizeof(float) * nXSize );
+
+            for( iX = 0; iX < nXSize; iX++ )
+            {
+                if( pabyFeature[nOff + iX] )
+                {
+                    panState[iX] = nYOff + iLine;
+                    if( bValues )
+                        pafStateValue[iX] = pafValue[nOff + iX];
+                }
+            }
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Line pass, a few jobs per thread for balance.                   */
+/* -------------------------------------------------------------------- */
+        GDALEDTJob sJob;
+
+        sJob.psInfo = psInfo;
+        sJob.nYOff = nYOff;
+        sJob.nLines = nLines;
+        sJob.panUp = panUp;
+        sJob.panDown = panDown;
+        sJob.pafUpValue = pafUpValue;
+        sJob.pafDownValue = pafDownValue;
+
+        int nJobCount = MAX( 1, MIN( nThreads * 4, nLines / 4 ) );
+
+        sJob.nLinesPerJob = (nLines + nJobCount - 1) / nJobCount;
+        nJobCount = (nLines + sJob.nLinesPerJob - 1) / sJob.nLinesPerJob;
+
+        if( !CPLRunJobs( nJobCount, nThreads, GDALEDTLineJob, &sJob ) )
+            eErr = CE_Failure;
+
+        if( eErr == CE_None )
+            eErr = psInfo->pfnWrite( psInfo->pUserData, nYOff, nLines );
+
+        dfLinesDone += nLines;
+        if( eErr == CE_None 
+            && !pfnProgress( dfLinesDone / dfLinesTotal, "", pProgressArg ) )
+        {
+            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+            eErr = CE_Failure;
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Cleanup                                                         */
+/* -------------------------------------------------------------------- */
+    CPLFree( pabyFeature );
+    CPLFree( panUp );
+    CPLFree( panDown );
+    CPLFree( panTopState );
+    CPLFree( panState );
+    CPLFree( pafValue );
+    CPLFree( pafUpValue );
+    CPLFree( pafDownValue );
+    CPLFree( pafTopStateValue );
+    CPLFree( pafStateValue );
+
+    return eErr;
+}
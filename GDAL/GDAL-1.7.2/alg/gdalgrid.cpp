@@ -28,12 +28,162 @@
  ****************************************************************************/
 
 #include "cpl_vsi.h"
+#include "cpl_multiproc.h"
+#include "cpl_quad_tree.h"
+#include "cpl_string.h"
+#include "cpl_worker_thread_pool.h"
 #include "gdalgrid.h"
 
 CPL_CVSID("$Id$");
 
 #define TO_RADIANS (3.14159265358979323846 / 180.0)
 
+/************************************************************************/
+/*                           GDALGridEllipse                            */
+/*                                                                      */
+/*      Search ellipse parameters.  They are computed once from the     */
+/*      algorithm options and shared by all grid nodes.  Radii are      */
+/*      stored squared.                                                 */
+/************************************************************************/
+
+typedef struct
+{
+    double      dfRadius1;
+    double      dfRadius2;
+    double      dfR12;
+    bool        bRotated;
+    double      dfCoeff1;
+    double      dfCoeff2;
+} GDALGridEllipse;
+
+/************************************************************************/
+/*                        GDALGridEllipseInit()                         */
+/************************************************************************/
+
+static void GDALGridEllipseInit( GDALGridEllipse *psEllipse,
+                                 double dfRadius1, double dfRadius2,
+                                 double dfAngle )
+{
+    psEllipse->dfRadius1 = dfRadius1 * dfRadius1;
+    psEllipse->dfRadius2 = dfRadius2 * dfRadius2;
+    psEllipse->dfR12 = psEllipse->dfRadius1 * psEllipse->dfRadius2;
+
+    // Compute coefficients for coordinate system rotation.
+    dfAngle = TO_RADIANS * dfAngle;
+    psEllipse->bRotated = ( dfAngle == 0.0 ) ? false : true;
+    psEllipse->dfCoeff1 = psEllipse->bRotated ? cos(dfAngle) : 0.0;
+    psEllipse->dfCoeff2 = psEllipse->bRotated ? sin(dfAngle) : 0.0;
+}
+
+/************************************************************************/
+/*                         GDALGridInEllipse()                          */
+/*                                                                      */
+/*      Rotate the offset of a point from the grid node into the        */
+/*      ellipse coordinate system and test whether it is located        */
+/*      inside the search ellipse.                                      */
+/************************************************************************/
+
+static CPL_INLINE bool GDALGridInEllipse( const GDALGridEllipse *psEllipse,
+                                          double &dfRX, double &dfRY )
+{
+    if ( psEllipse->bRotated )
+    {
+        double dfRXRotated = dfRX * psEllipse->dfCoeff1
+            + dfRY * psEllipse->dfCoeff2;
+        double dfRYRotated = dfRY * psEllipse->dfCoeff1
+            - dfRX * psEllipse->dfCoeff2;
+
+        dfRX = dfRXRotated;
+        dfRY = dfRYRotated;
+    }
+
+    return psEllipse->dfRadius2 * dfRX * dfRX
+        + psEllipse->dfRadius1 * dfRY * dfRY <= psEllipse->dfR12;
+}
+
+/*
+ * The gridding methods below are implemented once over a subset of the
+ * input points: panIndices lists nCount point indices in ascending order,
+ * or is NULL, in which case the first nCount points are used.  The public
+ * GDALGrid*() entry points pass all points, while GDALGridContextProcess()
+ * passes the candidates found in the point index for each grid node.
+ * Visiting the candidates in the original order keeps the results
+ * identical, including the max_points cut-off and summation order.
+ */
+
+typedef CPLErr (*GDALGridSubsetFunction)( const void *,
+                                          const GDALGridEllipse *,
+                                          GUInt32, const GUInt32 *,
+                                          const double *, const double *,
+                                          const double *,
+                                          double, double, double * );
+
+#define GRID_POINT(k) ( panIndices ? panIndices[k] : (k) )
+
+/************************************************************************/
+/*               GDALGridInverseDistanceToAPowerSubset()                */
+/************************************************************************/
+
+static CPLErr
+GDALGridInverseDistanceToAPowerSubset( const void *poOptions,
+                                       const GDALGridEllipse *psEllipse,
+                                       GUInt32 nCount,
+                                       const GUInt32 *panIndices,
+                                       const double *padfX,
+                                       const double *padfY,
+                                       const double *padfZ,
+                                       double dfXPoint, double dfYPoint,
+                                       double *pdfValue )
+{
+    const double    dfPower =
+        ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->dfPower;
+    const double    dfSmoothing =
+        ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->dfSmoothing;
+    const GUInt32   nMaxPoints = 
+        ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->nMaxPoints;
+    double  dfNominator = 0.0, dfDenominator = 0.0;
+    GUInt32 k, n = 0;
+
+    for ( k = 0; k < nCount; k++ )
+    {
+        const GUInt32 i = GRID_POINT(k);
+        double  dfRX = padfX[i] - dfXPoint;
+        double  dfRY = padfY[i] - dfYPoint;
+        const double dfR2 =
+            dfRX * dfRX + dfRY * dfRY + dfSmoothing * dfSmoothing;
+
+        // Is this point located inside the search ellipse?
+        if ( GDALGridInEllipse( psEllipse, dfRX, dfRY ) )
+        {
+            if ( CPLIsEqual(dfR2, 0.0) )
+            {
+                (*pdfValue) = padfZ[i];
+                return CE_None;
+            }
+            else
+            {
+                const double  dfW = pow( sqrt(dfR2), dfPower );
+                dfNominator += padfZ[i] / dfW;
+                dfDenominator += 1.0 / dfW;
+                n++;
+                if ( nMaxPoints > 0 && n > nMaxPoints )
+                    break;
+            }
+        }
+    }
+
+    if ( n < ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->nMinPoints
+         || dfDenominator == 0.0 )
+    {
+        (*pdfValue) =
+            ((GDALGridInverseDistanceToAPowerOptions*)poOptions)->dfNoDataValue;
+    }
+    else
+        (*pdfValue) = dfNominator / dfDenominator;
+
+    return CE_None;
+}
+
 /************************************************************************/
 /*                   GDALGridInverseDistanceToAPower()                  */
 /************************************************************************/
@@ -92,86 +242,18 @@ GDALGridInverseDistanceToAPower( const void *poOptions, GUInt32 nPoints,
                                  double dfXPoint, double dfYPoint,
                                  double *pdfValue )
 {
-    // TODO: For optimization purposes pre-computed parameters should be moved
-    // out of this routine to the calling function.
-
-    // Pre-compute search ellipse parameters
-    double      dfRadius1 =
-        ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->dfRadius1;
-    double      dfRadius2 =
-        ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->dfRadius2;
-    double  dfR12;
-
-    dfRadius1 *= dfRadius1;
-    dfRadius2 *= dfRadius2;
-    dfR12 = dfRadius1 * dfRadius2;
-
-    // Compute coefficients for coordinate system rotation.
-    double      dfCoeff1 = 0.0, dfCoeff2 = 0.0;
-    const double dfAngle = TO_RADIANS
-        * ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->dfAngle;
-    const bool  bRotated = ( dfAngle == 0.0 ) ? false : true;
-    if ( bRotated )
-    {
-        dfCoeff1 = cos(dfAngle);
-        dfCoeff2 = sin(dfAngle);
-    }
-
-    const double    dfPower =
-        ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->dfPower;
-    const double    dfSmoothing =
-        ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->dfSmoothing;
-    const GUInt32   nMaxPoints = 
-        ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->nMaxPoints;
-    double  dfNominator = 0.0, dfDenominator = 0.0;
-    GUInt32 i, n = 0;
-
-    for ( i = 0; i < nPoints; i++ )
-    {
-        double  dfRX = padfX[i] - dfXPoint;
-        double  dfRY = padfY[i] - dfYPoint;
-        const double dfR2 =
-            dfRX * dfRX + dfRY * dfRY + dfSmoothing * dfSmoothing;
-
-        if ( bRotated )
-        {
-            double dfRXRotated = dfRX * dfCoeff1 + dfRY * dfCoeff2;
-            double dfRYRotated = dfRY * dfCoeff1 - dfRX * dfCoeff2;
-
-            dfRX = dfRXRotated;
-            dfRY = dfRYRotated;
-        }
-
-        // Is this point located inside the search ellipse?
-        if ( dfRadius2 * dfRX * dfRX + dfRadius1 * dfRY * dfRY <= dfR12 )
-        {
-            if ( CPLIsEqual(dfR2, 0.0) )
-            {
-                (*pdfValue) = padfZ[i];
-                return CE_None;
-            }
-            else
-            {
-                const double  dfW = pow( sqrt(dfR2), dfPower );
-                dfNominator += padfZ[i] / dfW;
-                dfDenominator += 1.0 / dfW;
-                n++;
-                if ( nMaxPoints > 0 && n > nMaxPoints )
-                    break;
-            }
-        }
-    }
-
-    if ( n < ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->nMinPoints
-         || dfDenominator == 0.0 )
-    {
-        (*pdfValue) =
-            ((GDALGridInverseDistanceToAPowerOptions*)poOptions)->dfNoDataValue;
-    }
-    else
-        (*pdfValue) = dfNominator / dfDenominator;
-
-    return CE_None;
+    GDALGridEllipse sEllipse;
+
+    GDALGridEllipseInit( &sEllipse,
+        ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->dfRadius1,
+        ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->dfRadius2,
+        ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->dfAngle );
+
+    return GDALGridInverseDistanceToAPowerSubset( poOptions, &sEllipse,
+                                                  nPoints, NULL,
+                                                  padfX, padfY, padfZ,
+                                                  dfXPoint, dfYPoint,
+                                                  pdfValue );
 }
 
 /************************************************************************/
@@ -233,6 +315,49 @@ GDALGridInverseDistanceToAPowerNoSearch( const void *poOptions, GUInt32 nPoints,
 
     return CE_None;
 }
+
+/************************************************************************/
+/*                     GDALGridMovingAverageSubset()                    */
+/************************************************************************/
+
+static CPLErr
+GDALGridMovingAverageSubset( const void *poOptions,
+                             const GDALGridEllipse *psEllipse,
+                             GUInt32 nCount, const GUInt32 *panIndices,
+                             const double *padfX, const double *padfY,
+                             const double *padfZ,
+                             double dfXPoint, double dfYPoint,
+                             double *pdfValue )
+{
+    double  dfAccumulator = 0.0;
+    GUInt32 k, n = 0;
+
+    for ( k = 0; k < nCount; k++ )
+    {
+        const GUInt32 i = GRID_POINT(k);
+        double  dfRX = padfX[i] - dfXPoint;
+        double  dfRY = padfY[i] - dfYPoint;
+
+        // Is this point located inside the search ellipse?
+        if ( GDALGridInEllipse( psEllipse, dfRX, dfRY ) )
+        {
+            dfAccumulator += padfZ[i];
+            n++;
+        }
+    }
+
+    if ( n < ((GDALGridMovingAverageOptions *)poOptions)->nMinPoints
+         || n == 0 )
+    {
+        (*pdfValue) =
+            ((GDALGridMovingAverageOptions *)poOptions)->dfNoDataValue;
+    }
+    else
+        (*pdfValue) = dfAccumulator / n;
+
+    return CE_None;
+}
+
 /************************************************************************/
 /*                        GDALGridMovingAverage()                       */
 /************************************************************************/
@@ -280,64 +405,61 @@ GDALGridMovingAverage( const void *poOptions, GUInt32 nPoints,
                        const double *padfZ,
                        double dfXPoint, double dfYPoint, double *pdfValue )
 {
-    // TODO: For optimization purposes pre-computed parameters should be moved
-    // out of this routine to the calling function.
+    GDALGridEllipse sEllipse;
 
-    // Pre-compute search ellipse parameters
-    double  dfRadius1 = ((GDALGridMovingAverageOptions *)poOptions)->dfRadius1;
-    double  dfRadius2 = ((GDALGridMovingAverageOptions *)poOptions)->dfRadius2;
-    double  dfR12;
+    GDALGridEllipseInit( &sEllipse,
+                    ((GDALGridMovingAverageOptions *)poOptions)->dfRadius1,
+                    ((GDALGridMovingAverageOptions *)poOptions)->dfRadius2,
+                    ((GDALGridMovingAverageOptions *)poOptions)->dfAngle );
 
-    dfRadius1 *= dfRadius1;
-    dfRadius2 *= dfRadius2;
-    dfR12 = dfRadius1 * dfRadius2;
+    return GDALGridMovingAverageSubset( poOptions, &sEllipse, nPoints, NULL,
+                                        padfX, padfY, padfZ,
+                                        dfXPoint, dfYPoint, pdfValue );
+}
 
-    // Compute coefficients for coordinate system rotation.
-    double      dfCoeff1 = 0.0, dfCoeff2 = 0.0;
-    const double    dfAngle =
-        TO_RADIANS * ((GDALGridMovingAverageOptions *)poOptions)->dfAngle;
-    const bool  bRotated = ( dfAngle == 0.0 ) ? false : true;
-    if ( bRotated )
-    {
-        dfCoeff1 = cos(dfAngle);
-        dfCoeff2 = sin(dfAngle);
-    }
+/************************************************************************/
+/*                    GDALGridNearestNeighborSubset()                   */
+/************************************************************************/
 
-    double  dfAccumulator = 0.0;
-    GUInt32 i = 0, n = 0;
+static CPLErr
+GDALGridNearestNeighborSubset( const void *poOptions,
+                               const GDALGridEllipse *psEllipse,
+                               GUInt32 nCount, const GUInt32 *panIndices,
+                               const double *padfX, const double *padfY,
+                               const double *padfZ,
+                               double dfXPoint, double dfYPoint,
+                               double *pdfValue )
+{
+    // If the nearest point will not be found, its value remains as NODATA.
+    double      dfNearestValue =
+        ((GDALGridNearestNeighborOptions *)poOptions)->dfNoDataValue;
+    // Nearest distance will be initialized with a largest ellipse semi-axis.
+    // All nearest points should be located in this range.  Without search
+    // ellipse the first point is taken unconditionally.
+    double      dfNearestR = MAX(psEllipse->dfRadius1, psEllipse->dfRadius2);
+    bool        bUnlimited = ( dfNearestR == 0.0 );
+    GUInt32     k;
 
-    while ( i < nPoints )
+    for ( k = 0; k < nCount; k++ )
     {
+        const GUInt32 i = GRID_POINT(k);
         double  dfRX = padfX[i] - dfXPoint;
         double  dfRY = padfY[i] - dfYPoint;
 
-        if ( bRotated )
-        {
-            double dfRXRotated = dfRX * dfCoeff1 + dfRY * dfCoeff2;
-            double dfRYRotated = dfRY * dfCoeff1 - dfRX * dfCoeff2;
-
-            dfRX = dfRXRotated;
-            dfRY = dfRYRotated;
-        }
-
         // Is this point located inside the search ellipse?
-        if ( dfRadius2 * dfRX * dfRX + dfRadius1 * dfRY * dfRY <= dfR12 )
+        if ( GDALGridInEllipse( psEllipse, dfRX, dfRY ) )
         {
-            dfAccumulator += padfZ[i];
-            n++;
+            const double    dfR2 = dfRX * dfRX + dfRY * dfRY;
+            if ( bUnlimited || dfR2 < dfNearestR )
+            {
+                dfNearestR = dfR2;
+                dfNearestValue = padfZ[i];
+                bUnlimited = false;
+            }
         }
-
-        i++;
     }
 
-    if ( n < ((GDALGridMovingAverageOptions *)poOptions)->nMinPoints
-         || n == 0 )
-    {
-        (*pdfValue) =
-            ((GDALGridMovingAverageOptions *)poOptions)->dfNoDataValue;
-    }
-    else
-        (*pdfValue) = dfAccumulator / n;
+    (*pdfValue) = dfNearestValue;
 
     return CE_None;
 }
@@ -354,6 +476,11 @@ GDALGridMovingAverage( const void *poOptions, GUInt32 nPoints,
  * and returns it as a result. If there are no points found, the specified
  * NODATA value will be returned.
  *
+ * A point located exactly at the grid node is taken as the nearest one.
+ * Earlier versions replaced it by the next point of the input arrays
+ * located inside the search ellipse, so the values of grid nodes falling
+ * on input points may differ from theirs.
+ *
  * @param poOptions Algorithm parameters. This should point to
  * GDALGridNearestNeighborOptions object. 
  * @param nPoints Number of elements in input arrays.
@@ -374,68 +501,62 @@ GDALGridNearestNeighbor( const void *poOptions, GUInt32 nPoints,
                          const double *padfZ,
                          double dfXPoint, double dfYPoint, double *pdfValue )
 {
-    // TODO: For optimization purposes pre-computed parameters should be moved
-    // out of this routine to the calling function.
+    GDALGridEllipse sEllipse;
 
-    // Pre-compute search ellipse parameters
-    double  dfRadius1 =
-        ((GDALGridNearestNeighborOptions *)poOptions)->dfRadius1;
-    double  dfRadius2 =
-        ((GDALGridNearestNeighborOptions *)poOptions)->dfRadius2;
-    double  dfR12;
+    GDALGridEllipseInit( &sEllipse,
+                    ((GDALGridNearestNeighborOptions *)poOptions)->dfRadius1,
+                    ((GDALGridNearestNeighborOptions *)poOptions)->dfRadius2,
+                    ((GDALGridNearestNeighborOptions *)poOptions)->dfAngle );
 
-    dfRadius1 *= dfRadius1;
-    dfRadius2 *= dfRadius2;
-    dfR12 = dfRadius1 * dfRadius2;
+    return GDALGridNearestNeighborSubset( poOptions, &sEllipse, nPoints, NULL,
+                                          padfX, padfY, padfZ,
+                                          dfXPoint, dfYPoint, pdfValue );
+}
 
-    // Compute coefficients for coordinate system rotation.
-    double      dfCoeff1 = 0.0, dfCoeff2 = 0.0;
-    const double    dfAngle =
-        TO_RADIANS * ((GDALGridNearestNeighborOptions *)poOptions)->dfAngle;
-    const bool  bRotated = ( dfAngle == 0.0 ) ? false : true;
-    if ( bRotated )
-    {
-        dfCoeff1 = cos(dfAngle);
-        dfCoeff2 = sin(dfAngle);
-    }
+/************************************************************************/
+/*                  GDALGridDataMetricMinimumSubset()                   */
+/************************************************************************/
 
-    // If the nearest point will not be found, its value remains as NODATA.
-    double      dfNearestValue =
-        ((GDALGridNearestNeighborOptions *)poOptions)->dfNoDataValue;
-    // Nearest distance will be initialized with a largest ellipse semi-axis.
-    // All nearest points should be located in this range.
-    double      dfNearestR = MAX(dfRadius1, dfRadius2);
-    GUInt32 i = 0;
+static CPLErr
+GDALGridDataMetricMinimumSubset( const void *poOptions,
+                                 const GDALGridEllipse *psEllipse,
+                                 GUInt32 nCount, const GUInt32 *panIndices,
+                                 const double *padfX, const double *padfY,
+                                 const double *padfZ,
+                                 double dfXPoint, double dfYPoint,
+                                 double *pdfValue )
+{
+    double      dfMinimumValue=0.0;
+    GUInt32     k, n = 0;
 
-    while ( i < nPoints )
+    for ( k = 0; k < nCount; k++ )
     {
+        const GUInt32 i = GRID_POINT(k);
         double  dfRX = padfX[i] - dfXPoint;
         double  dfRY = padfY[i] - dfYPoint;
 
-        if ( bRotated )
-        {
-            double dfRXRotated = dfRX * dfCoeff1 + dfRY * dfCoeff2;
-            double dfRYRotated = dfRY * dfCoeff1 - dfRX * dfCoeff2;
-
-            dfRX = dfRXRotated;
-            dfRY = dfRYRotated;
-        }
-
         // Is this point located inside the search ellipse?
-        if ( dfRadius2 * dfRX * dfRX + dfRadius1 * dfRY * dfRY <= dfR12 )
+        if ( GDALGridInEllipse( psEllipse, dfRX, dfRY ) )
         {
-            const double    dfR2 = dfRX * dfRX + dfRY * dfRY;
-            if ( dfNearestR == 0.0 || dfR2 < dfNearestR )
+            if ( n )
             {
-                dfNearestR = dfR2;
-                dfNearestValue = padfZ[i];
+                if ( dfMinimumValue > padfZ[i] )
+                    dfMinimumValue = padfZ[i];
             }
+            else
+                dfMinimumValue = padfZ[i];
+            n++;
         }
-
-        i++;
     }
 
-    (*pdfValue) = dfNearestValue;
+    if ( n < ((GDALGridDataMetricsOptions *)poOptions)->nMinPoints
+         || n == 0 )
+    {
+        (*pdfValue) =
+            ((GDALGridDataMetricsOptions *)poOptions)->dfNoDataValue;
+    }
+    else
+        (*pdfValue) = dfMinimumValue;
 
     return CE_None;
 }
@@ -481,62 +602,52 @@ GDALGridDataMetricMinimum( const void *poOptions, GUInt32 nPoints,
                            const double *padfZ,
                            double dfXPoint, double dfYPoint, double *pdfValue )
 {
-    // TODO: For optimization purposes pre-computed parameters should be moved
-    // out of this routine to the calling function.
+    GDALGridEllipse sEllipse;
 
-    // Pre-compute search ellipse parameters
-    double  dfRadius1 =
-        ((GDALGridDataMetricsOptions *)poOptions)->dfRadius1;
-    double  dfRadius2 =
-        ((GDALGridDataMetricsOptions *)poOptions)->dfRadius2;
-    double  dfR12;
+    GDALGridEllipseInit( &sEllipse,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfRadius1,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfRadius2,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfAngle );
 
-    dfRadius1 *= dfRadius1;
-    dfRadius2 *= dfRadius2;
-    dfR12 = dfRadius1 * dfRadius2;
+    return GDALGridDataMetricMinimumSubset( poOptions, &sEllipse, nPoints, NULL,
+                                            padfX, padfY, padfZ,
+                                            dfXPoint, dfYPoint, pdfValue );
+}
 
-    // Compute coefficients for coordinate system rotation.
-    double      dfCoeff1 = 0.0, dfCoeff2 = 0.0;
-    const double dfAngle =
-        TO_RADIANS * ((GDALGridDataMetricsOptions *)poOptions)->dfAngle;
-    const bool  bRotated = ( dfAngle == 0.0 ) ? false : true;
-    if ( bRotated )
-    {
-        dfCoeff1 = cos(dfAngle);
-        dfCoeff2 = sin(dfAngle);
-    }
+/************************************************************************/
+/*                  GDALGridDataMetricMaximumSubset()                   */
+/************************************************************************/
 
-    double      dfMinimumValue=0.0;
-    GUInt32     i = 0, n = 0;
+static CPLErr
+GDALGridDataMetricMaximumSubset( const void *poOptions,
+                                 const GDALGridEllipse *psEllipse,
+                                 GUInt32 nCount, const GUInt32 *panIndices,
+                                 const double *padfX, const double *padfY,
+                                 const double *padfZ,
+                                 double dfXPoint, double dfYPoint,
+                                 double *pdfValue )
+{
+    double      dfMaximumValue=0.0;
+    GUInt32     k, n = 0;
 
-    while ( i < nPoints )
+    for ( k = 0; k < nCount; k++ )
     {
+        const GUInt32 i = GRID_POINT(k);
         double  dfRX = padfX[i] - dfXPoint;
         double  dfRY = padfY[i] - dfYPoint;
 
-        if ( bRotated )
-        {
-            double dfRXRotated = dfRX * dfCoeff1 + dfRY * dfCoeff2;
-            double dfRYRotated = dfRY * dfCoeff1 - dfRX * dfCoeff2;
-
-            dfRX = dfRXRotated;
-            dfRY = dfRYRotated;
-        }
-
         // Is this point located inside the search ellipse?
-        if ( dfRadius2 * dfRX * dfRX + dfRadius1 * dfRY * dfRY <= dfR12 )
+        if ( GDALGridInEllipse( psEllipse, dfRX, dfRY ) )
         {
             if ( n )
             {
-                if ( dfMinimumValue > padfZ[i] )
-                    dfMinimumValue = padfZ[i];
+                if ( dfMaximumValue < padfZ[i] )
+                    dfMaximumValue = padfZ[i];
             }
             else
-                dfMinimumValue = padfZ[i];
+                dfMaximumValue = padfZ[i];
             n++;
         }
-
-        i++;
     }
 
     if ( n < ((GDALGridDataMetricsOptions *)poOptions)->nMinPoints
@@ -546,7 +657,7 @@ GDALGridDataMetricMinimum( const void *poOptions, GUInt32 nPoints,
             ((GDALGridDataMetricsOptions *)poOptions)->dfNoDataValue;
     }
     else
-        (*pdfValue) = dfMinimumValue;
+        (*pdfValue) = dfMaximumValue;
 
     return CE_None;
 }
@@ -592,62 +703,54 @@ GDALGridDataMetricMaximum( const void *poOptions, GUInt32 nPoints,
                            const double *padfZ,
                            double dfXPoint, double dfYPoint, double *pdfValue )
 {
-    // TODO: For optimization purposes pre-computed parameters should be moved
-    // out of this routine to the calling function.
+    GDALGridEllipse sEllipse;
 
-    // Pre-compute search ellipse parameters
-    double  dfRadius1 =
-        ((GDALGridDataMetricsOptions *)poOptions)->dfRadius1;
-    double  dfRadius2 =
-        ((GDALGridDataMetricsOptions *)poOptions)->dfRadius2;
-    double  dfR12;
+    GDALGridEllipseInit( &sEllipse,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfRadius1,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfRadius2,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfAngle );
 
-    dfRadius1 *= dfRadius1;
-    dfRadius2 *= dfRadius2;
-    dfR12 = dfRadius1 * dfRadius2;
+    return GDALGridDataMetricMaximumSubset( poOptions, &sEllipse, nPoints, NULL,
+                                            padfX, padfY, padfZ,
+                                            dfXPoint, dfYPoint, pdfValue );
+}
 
-    // Compute coefficients for coordinate system rotation.
-    double      dfCoeff1 = 0.0, dfCoeff2 = 0.0;
-    const double    dfAngle =
-        TO_RADIANS * ((GDALGridDataMetricsOptions *)poOptions)->dfAngle;
-    const bool  bRotated = ( dfAngle == 0.0 ) ? false : true;
-    if ( bRotated )
-    {
-        dfCoeff1 = cos(dfAngle);
-        dfCoeff2 = sin(dfAngle);
-    }
+/************************************************************************/
+/*                   GDALGridDataMetricRangeSubset()                    */
+/************************************************************************/
 
-    double      dfMaximumValue=0.0;
-    GUInt32     i = 0, n = 0;
+static CPLErr
+GDALGridDataMetricRangeSubset( const void *poOptions,
+                               const GDALGridEllipse *psEllipse,
+                               GUInt32 nCount, const GUInt32 *panIndices,
+                               const double *padfX, const double *padfY,
+                               const double *padfZ,
+                               double dfXPoint, double dfYPoint,
+                               double *pdfValue )
+{
+    double      dfMaximumValue=0.0, dfMinimumValue=0.0;
+    GUInt32     k, n = 0;
 
-    while ( i < nPoints )
+    for ( k = 0; k < nCount; k++ )
     {
+        const GUInt32 i = GRID_POINT(k);
         double  dfRX = padfX[i] - dfXPoint;
         double  dfRY = padfY[i] - dfYPoint;
 
-        if ( bRotated )
-        {
-            double dfRXRotated = dfRX * dfCoeff1 + dfRY * dfCoeff2;
-            double dfRYRotated = dfRY * dfCoeff1 - dfRX * dfCoeff2;
-
-            dfRX = dfRXRotated;
-            dfRY = dfRYRotated;
-        }
-
         // Is this point located inside the search ellipse?
-        if ( dfRadius2 * dfRX * dfRX + dfRadius1 * dfRY * dfRY <= dfR12 )
+        if ( GDALGridInEllipse( psEllipse, dfRX, dfRY ) )
         {
             if ( n )
             {
+                if ( dfMinimumValue > padfZ[i] )
+                    dfMinimumValue = padfZ[i];
                 if ( dfMaximumValue < padfZ[i] )
                     dfMaximumValue = padfZ[i];
             }
             else
-                dfMaximumValue = padfZ[i];
+                dfMinimumValue = dfMaximumValue = padfZ[i];
             n++;
         }
-
-        i++;
     }
 
     if ( n < ((GDALGridDataMetricsOptions *)poOptions)->nMinPoints
@@ -657,7 +760,7 @@ GDALGridDataMetricMaximum( const void *poOptions, GUInt32 nPoints,
             ((GDALGridDataMetricsOptions *)poOptions)->dfNoDataValue;
     }
     else
-        (*pdfValue) = dfMaximumValue;
+        (*pdfValue) = dfMaximumValue - dfMinimumValue;
 
     return CE_None;
 }
@@ -704,74 +807,51 @@ GDALGridDataMetricRange( const void *poOptions, GUInt32 nPoints,
                          const double *padfZ,
                          double dfXPoint, double dfYPoint, double *pdfValue )
 {
-    // TODO: For optimization purposes pre-computed parameters should be moved
-    // out of this routine to the calling function.
+    GDALGridEllipse sEllipse;
 
-    // Pre-compute search ellipse parameters
-    double  dfRadius1 =
-        ((GDALGridDataMetricsOptions *)poOptions)->dfRadius1;
-    double  dfRadius2 =
-        ((GDALGridDataMetricsOptions *)poOptions)->dfRadius2;
-    double  dfR12;
+    GDALGridEllipseInit( &sEllipse,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfRadius1,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfRadius2,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfAngle );
 
-    dfRadius1 *= dfRadius1;
-    dfRadius2 *= dfRadius2;
-    dfR12 = dfRadius1 * dfRadius2;
+    return GDALGridDataMetricRangeSubset( poOptions, &sEllipse, nPoints, NULL,
+                                          padfX, padfY, padfZ,
+                                          dfXPoint, dfYPoint, pdfValue );
+}
 
-    // Compute coefficients for coordinate system rotation.
-    double      dfCoeff1 = 0.0, dfCoeff2 = 0.0;
-    const double    dfAngle =
-        TO_RADIANS * ((GDALGridDataMetricsOptions *)poOptions)->dfAngle;
-    const bool  bRotated = ( dfAngle == 0.0 ) ? false : true;
-    if ( bRotated )
-    {
-        dfCoeff1 = cos(dfAngle);
-        dfCoeff2 = sin(dfAngle);
-    }
+/************************************************************************/
+/*                   GDALGridDataMetricCountSubset()                    */
+/************************************************************************/
 
-    double      dfMaximumValue=0.0, dfMinimumValue=0.0;
-    GUInt32     i = 0, n = 0;
+static CPLErr
+GDALGridDataMetricCountSubset( const void *poOptions,
+                               const GDALGridEllipse *psEllipse,
+                               GUInt32 nCount, const GUInt32 *panIndices,
+                               const double *padfX, const double *padfY,
+                               const double *padfZ,
+                               double dfXPoint, double dfYPoint,
+                               double *pdfValue )
+{
+    GUInt32     k, n = 0;
 
-    while ( i < nPoints )
+    for ( k = 0; k < nCount; k++ )
     {
+        const GUInt32 i = GRID_POINT(k);
         double  dfRX = padfX[i] - dfXPoint;
         double  dfRY = padfY[i] - dfYPoint;
 
-        if ( bRotated )
-        {
-            double dfRXRotated = dfRX * dfCoeff1 + dfRY * dfCoeff2;
-            double dfRYRotated = dfRY * dfCoeff1 - dfRX * dfCoeff2;
-
-            dfRX = dfRXRotated;
-            dfRY = dfRYRotated;
-        }
-
         // Is this point located inside the search ellipse?
-        if ( dfRadius2 * dfRX * dfRX + dfRadius1 * dfRY * dfRY <= dfR12 )
-        {
-            if ( n )
-            {
-                if ( dfMinimumValue > padfZ[i] )
-                    dfMinimumValue = padfZ[i];
-                if ( dfMaximumValue < padfZ[i] )
-                    dfMaximumValue = padfZ[i];
-            }
-            else
-                dfMinimumValue = dfMaximumValue = padfZ[i];
+        if ( GDALGridInEllipse( psEllipse, dfRX, dfRY ) )
             n++;
-        }
-
-        i++;
     }
 
-    if ( n < ((GDALGridDataMetricsOptions *)poOptions)->nMinPoints
-         || n == 0 )
+    if ( n < ((GDALGridDataMetricsOptions *)poOptions)->nMinPoints )
     {
         (*pdfValue) =
             ((GDALGridDataMetricsOptions *)poOptions)->dfNoDataValue;
     }
     else
-        (*pdfValue) = dfMaximumValue - dfMinimumValue;
+        (*pdfValue) = (double)n;
 
     return CE_None;
 }
@@ -815,61 +895,54 @@ GDALGridDataMetricCount( const void *poOptions, GUInt32 nPoints,
                          const double *padfZ,
                          double dfXPoint, double dfYPoint, double *pdfValue )
 {
-    // TODO: For optimization purposes pre-computed parameters should be moved
-    // out of this routine to the calling function.
+    GDALGridEllipse sEllipse;
 
-    // Pre-compute search ellipse parameters
-    double  dfRadius1 =
-        ((GDALGridDataMetricsOptions *)poOptions)->dfRadius1;
-    double  dfRadius2 =
-        ((GDALGridDataMetricsOptions *)poOptions)->dfRadius2;
-    double  dfR12;
+    GDALGridEllipseInit( &sEllipse,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfRadius1,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfRadius2,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfAngle );
 
-    dfRadius1 *= dfRadius1;
-    dfRadius2 *= dfRadius2;
-    dfR12 = dfRadius1 * dfRadius2;
+    return GDALGridDataMetricCountSubset( poOptions, &sEllipse, nPoints, NULL,
+                                          padfX, padfY, padfZ,
+                                          dfXPoint, dfYPoint, pdfValue );
+}
 
-    // Compute coefficients for coordinate system rotation.
-    double      dfCoeff1 = 0.0, dfCoeff2 = 0.0;
-    const double    dfAngle =
-        TO_RADIANS * ((GDALGridDataMetricsOptions *)poOptions)->dfAngle;
-    const bool  bRotated = ( dfAngle == 0.0 ) ? false : true;
-    if ( bRotated )
-    {
-        dfCoeff1 = cos(dfAngle);
-        dfCoeff2 = sin(dfAngle);
-    }
+/************************************************************************/
+/*              GDALGridDataMetricAverageDistanceSubset()               */
+/************************************************************************/
 
-    GUInt32     i = 0, n = 0;
+static CPLErr
+GDALGridDataMetricAverageDistanceSubset( const void *poOptions,
+    const GDALGridEllipse *psEllipse,
+    GUInt32 nCount, const GUInt32 *panIndices,
+    const double *padfX, const double *padfY, const double *padfZ,
+    double dfXPoint, double dfYPoint, double *pdfValue )
+{
+    double      dfAccumulator = 0.0;
+    GUInt32     k, n = 0;
 
-    while ( i < nPoints )
+    for ( k = 0; k < nCount; k++ )
     {
+        const GUInt32 i = GRID_POINT(k);
         double  dfRX = padfX[i] - dfXPoint;
         double  dfRY = padfY[i] - dfYPoint;
 
-        if ( bRotated )
-        {
-            double dfRXRotated = dfRX * dfCoeff1 + dfRY * dfCoeff2;
-            double dfRYRotated = dfRY * dfCoeff1 - dfRX * dfCoeff2;
-
-            dfRX = dfRXRotated;
-            dfRY = dfRYRotated;
-        }
-
         // Is this point located inside the search ellipse?
-        if ( dfRadius2 * dfRX * dfRX + dfRadius1 * dfRY * dfRY <= dfR12 )
+        if ( GDALGridInEllipse( psEllipse, dfRX, dfRY ) )
+        {
+            dfAccumulator += sqrt( dfRX * dfRX + dfRY * dfRY );
             n++;
-
-        i++;
+        }
     }
 
-    if ( n < ((GDALGridDataMetricsOptions *)poOptions)->nMinPoints )
+    if ( n < ((GDALGridDataMetricsOptions *)poOptions)->nMinPoints
+         || n == 0 )
     {
         (*pdfValue) =
             ((GDALGridDataMetricsOptions *)poOptions)->dfNoDataValue;
     }
     else
-        (*pdfValue) = (double)n;
+        (*pdfValue) = dfAccumulator / n;
 
     return CE_None;
 }
@@ -918,56 +991,62 @@ GDALGridDataMetricAverageDistance( const void *poOptions, GUInt32 nPoints,
                                    double dfXPoint, double dfYPoint,
                                    double *pdfValue )
 {
-    // TODO: For optimization purposes pre-computed parameters should be moved
-    // out of this routine to the calling function.
+    GDALGridEllipse sEllipse;
 
-    // Pre-compute search ellipse parameters
-    double  dfRadius1 =
-        ((GDALGridDataMetricsOptions *)poOptions)->dfRadius1;
-    double  dfRadius2 =
-        ((GDALGridDataMetricsOptions *)poOptions)->dfRadius2;
-    double  dfR12;
+    GDALGridEllipseInit( &sEllipse,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfRadius1,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfRadius2,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfAngle );
 
-    dfRadius1 *= dfRadius1;
-    dfRadius2 *= dfRadius2;
-    dfR12 = dfRadius1 * dfRadius2;
+    return GDALGridDataMetricAverageDistanceSubset(
+        poOptions, &sEllipse, nPoints, NULL,
+        padfX, padfY, padfZ, dfXPoint, dfYPoint, pdfValue );
+}
 
-    // Compute coefficients for coordinate system rotation.
-    double      dfCoeff1 = 0.0, dfCoeff2 = 0.0;
-    const double    dfAngle =
-        TO_RADIANS * ((GDALGridDataMetricsOptions *)poOptions)->dfAngle;
-    const bool  bRotated = ( dfAngle == 0.0 ) ? false : true;
-    if ( bRotated )
-    {
-        dfCoeff1 = cos(dfAngle);
-        dfCoeff2 = sin(dfAngle);
-    }
+/************************************************************************/
+/*             GDALGridDataMetricAverageDistancePtsSubset()             */
+/************************************************************************/
 
+static CPLErr
+GDALGridDataMetricAverageDistancePtsSubset( const void *poOptions,
+    const GDALGridEllipse *psEllipse,
+    GUInt32 nCount, const GUInt32 *panIndices,
+    const double *padfX, const double *padfY, const double *padfZ,
+    double dfXPoint, double dfYPoint, double *pdfValue )
+{
     double      dfAccumulator = 0.0;
-    GUInt32     i = 0, n = 0;
+    GUInt32     k, n = 0;
 
-    while ( i < nPoints )
+    // Search for the first point within the search ellipse
+    for ( k = 0; k + 1 < nCount; k++ )
     {
-        double  dfRX = padfX[i] - dfXPoint;
-        double  dfRY = padfY[i] - dfYPoint;
+        const GUInt32 i = GRID_POINT(k);
+        double  dfRX1 = padfX[i] - dfXPoint;
+        double  dfRY1 = padfY[i] - dfYPoint;
 
-        if ( bRotated )
+        // Is this point located inside the search ellipse?
+        if ( GDALGridInEllipse( psEllipse, dfRX1, dfRY1 ) )
         {
-            double dfRXRotated = dfRX * dfCoeff1 + dfRY * dfCoeff2;
-            double dfRYRotated = dfRY * dfCoeff1 - dfRX * dfCoeff2;
+            GUInt32 l;
 
-            dfRX = dfRXRotated;
-            dfRY = dfRYRotated;
-        }
+            // Search all the remaining points within the ellipse and compute
+            // distances between them and the first point
+            for ( l = k + 1; l < nCount; l++ )
+            {
+                const GUInt32 j = GRID_POINT(l);
+                double  dfRX2 = padfX[j] - dfXPoint;
+                double  dfRY2 = padfY[j] - dfYPoint;
 
-        // Is this point located inside the search ellipse?
-        if ( dfRadius2 * dfRX * dfRX + dfRadius1 * dfRY * dfRY <= dfR12 )
-        {
-            dfAccumulator += sqrt( dfRX * dfRX + dfRY * dfRY );
-            n++;
-        }
+                if ( GDALGridInEllipse( psEllipse, dfRX2, dfRY2 ) )
+                {
+                    const double dfRX = padfX[j] - padfX[i];
+                    const double dfRY = padfY[j] - padfY[i];
 
-        i++;
+                    dfAccumulator += sqrt( dfRX * dfRX + dfRY * dfRY );
+                    n++;
+                }
+            }
+        }
     }
 
     if ( n < ((GDALGridDataMetricsOptions *)poOptions)->nMinPoints
@@ -983,7 +1062,7 @@ GDALGridDataMetricAverageDistance( const void *poOptions, GUInt32 nPoints,
 }
 
 /************************************************************************/
-/*                 GDALGridDataMetricAverageDistance()                  */
+/*                GDALGridDataMetricAverageDistancePts()                */
 /************************************************************************/
 
 /**
@@ -1028,253 +1107,808 @@ GDALGridDataMetricAverageDistancePts( const void *poOptions, GUInt32 nPoints,
                                       double dfXPoint, double dfYPoint,
                                       double *pdfValue )
 {
-    // TODO: For optimization purposes pre-computed parameters should be moved
-    // out of this routine to the calling function.
+    GDALGridEllipse sEllipse;
 
-    // Pre-compute search ellipse parameters
-    double  dfRadius1 =
-        ((GDALGridDataMetricsOptions *)poOptions)->dfRadius1;
-    double  dfRadius2 =
-        ((GDALGridDataMetricsOptions *)poOptions)->dfRadius2;
-    double  dfR12;
+    GDALGridEllipseInit( &sEllipse,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfRadius1,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfRadius2,
+                    ((GDALGridDataMetricsOptions *)poOptions)->dfAngle );
 
-    dfRadius1 *= dfRadius1;
-    dfRadius2 *= dfRadius2;
-    dfR12 = dfRadius1 * dfRadius2;
+    return GDALGridDataMetricAverageDistancePtsSubset(
+        poOptions, &sEllipse, nPoints, NULL,
+        padfX, padfY, padfZ, dfXPoint, dfYPoint, pdfValue );
+}
 
-    // Compute coefficients for coordinate system rotation.
-    double      dfCoeff1 = 0.0, dfCoeff2 = 0.0;
-    const double    dfAngle =
-        TO_RADIANS * ((GDALGridDataMetricsOptions *)poOptions)->dfAngle;
-    const bool  bRotated = ( dfAngle == 0.0 ) ? false : true;
-    if ( bRotated )
-    {
-        dfCoeff1 = cos(dfAngle);
-        dfCoeff2 = sin(dfAngle);
-    }
+/************************************************************************/
+/*                           GDALGridContext                            */
+/************************************************************************/
 
-    double      dfAccumulator = 0.0;
-    GUInt32     i = 0, n = 0;
+/* Points are copied into the index, so that the bounds callback of the
+ * quad tree can reach their coordinates. */
+typedef struct
+{
+    double      dfX;
+    double      dfY;
+} GDALGridPoint;
 
-    // Search for the first point within the search ellipse
-    while ( i < nPoints - 1 )
+struct GDALGridContext
+{
+    GDALGridAlgorithm       eAlgorithm;
+    union
     {
-        double  dfRX1 = padfX[i] - dfXPoint;
-        double  dfRY1 = padfY[i] - dfYPoint;
+        GDALGridInverseDistanceToAPowerOptions  sInvDist;
+        GDALGridMovingAverageOptions            sMovingAverage;
+        GDALGridNearestNeighborOptions          sNearestNeighbor;
+        GDALGridDataMetricsOptions              sDataMetrics;
+    } uOptions;
+
+    // NULL for the inverse distance to a power without search.
+    GDALGridSubsetFunction  pfnSubsetMethod;
+    GDALGridEllipse         sEllipse;
+
+    GUInt32                 nPoints;
+    const double            *padfX;
+    const double            *padfY;
+    const double            *padfZ;
+
+    // Point index, NULL if every point has to be visited for every node.
+    CPLQuadTree             *hQuadTree;
+    GDALGridPoint           *pasGridPoints;
+    CPLRectObj              sPointsExtent;
+
+    // Half size of the square window enclosing the search ellipse, or 0.0
+    // for the nearest neighbor without search ellipse, in which case the
+    // window grows from dfNearestWindowStart until it finds some points.
+    double                  dfSearchWindow;
+    double                  dfNearestWindowStart;
+
+    // Number of threads computing the rows of the output grid.
+    int                     nThreads;
+};
+
+/* Below this number of points the index lookup costs more than visiting
+ * all of them. */
+#define GRID_INDEX_MIN_POINTS   32
 
-        if ( bRotated )
-        {
-            double dfRXRotated = dfRX1 * dfCoeff1 + dfRY1 * dfCoeff2;
-            double dfRYRotated = dfRY1 * dfCoeff1 - dfRX1 * dfCoeff2;
+/************************************************************************/
+/*                       GDALGridPointGetBounds()                       */
+/************************************************************************/
 
-            dfRX1 = dfRXRotated;
-            dfRY1 = dfRYRotated;
-        }
+static void GDALGridPointGetBounds( const void *hFeature, CPLRectObj *pBounds )
+{
+    const GDALGridPoint *psPoint = (const GDALGridPoint *)hFeature;
 
-        // Is this point located inside the search ellipse?
-        if ( dfRadius2 * dfRX1 * dfRX1 + dfRadius1 * dfRY1 * dfRY1 <= dfR12 )
-        {
-            GUInt32 j;
-            
-            // Search all the remaining points within the ellipse and compute
-            // distances between them and the first point
-            for ( j = i + 1; j < nPoints; j++ )
-            {
-                double  dfRX2 = padfX[j] - dfXPoint;
-                double  dfRY2 = padfY[j] - dfYPoint;
-                
-                if ( bRotated )
-                {
-                    double dfRXRotated = dfRX2 * dfCoeff1 + dfRY2 * dfCoeff2;
-                    double dfRYRotated = dfRY2 * dfCoeff1 - dfRX2 * dfCoeff2;
+    pBounds->minx = pBounds->maxx = psPoint->dfX;
+    pBounds->miny = pBounds->maxy = psPoint->dfY;
+}
 
-                    dfRX2 = dfRXRotated;
-                    dfRY2 = dfRYRotated;
-                }
+/************************************************************************/
+/*                         GDALGridBuildIndex()                         */
+/************************************************************************/
 
-                if ( dfRadius2 * dfRX2 * dfRX2 + dfRadius1 * dfRY2 * dfRY2 <= dfR12 )
-                {
-                    const double dfRX = padfX[j] - padfX[i];
-                    const double dfRY = padfY[j] - padfY[i];
+static bool GDALGridBuildIndex( GDALGridContext *psContext )
+{
+    const GUInt32   nPoints = psContext->nPoints;
+    GUInt32         i;
 
-                    dfAccumulator += sqrt( dfRX * dfRX + dfRY * dfRY );
-                    n++;
-                }
-            }
-        }
+    psContext->pasGridPoints = (GDALGridPoint *)
+        VSIMalloc2( nPoints, sizeof(GDALGridPoint) );
+    if ( psContext->pasGridPoints == NULL )
+    {
+        CPLDebug( "GDAL_GRID",
+                  "Not enough memory to index %lu points, not using index.",
+                  (long unsigned int)nPoints );
+        return false;
+    }
 
-        i++;
+    psContext->sPointsExtent.minx = psContext->sPointsExtent.maxx =
+        psContext->padfX[0];
+    psContext->sPointsExtent.miny = psContext->sPointsExtent.maxy =
+        psContext->padfY[0];
+
+    for ( i = 0; i < nPoints; i++ )
+    {
+        psContext->pasGridPoints[i].dfX = psContext->padfX[i];
+        psContext->pasGridPoints[i].dfY = psContext->padfY[i];
+
+        psContext->sPointsExtent.minx =
+            MIN( psContext->sPointsExtent.minx, psContext->padfX[i] );
+        psContext->sPointsExtent.maxx =
+            MAX( psContext->sPointsExtent.maxx, psContext->padfX[i] );
+        psContext->sPointsExtent.miny =
+            MIN( psContext->sPointsExtent.miny, psContext->padfY[i] );
+        psContext->sPointsExtent.maxy =
+            MAX( psContext->sPointsExtent.maxy, psContext->padfY[i] );
     }
 
-    if ( n < ((GDALGridDataMetricsOptions *)poOptions)->nMinPoints
-         || n == 0 )
+/* -------------------------------------------------------------------- */
+/*      Aim at a few points per leaf.  The depth advised by             */
+/*      CPLQuadTreeGetAdvisedMaxDepth() is meant for larger features    */
+/*      and makes the searches walk too many nodes.                     */
+/* -------------------------------------------------------------------- */
+    int         nMaxDepth = 1;
+    GUIntBig    nLeaves = 16;
+
+    while ( nMaxDepth < 12 && nLeaves < nPoints )
     {
-        (*pdfValue) =
-            ((GDALGridDataMetricsOptions *)poOptions)->dfNoDataValue;
+        nMaxDepth++;
+        nLeaves *= 4;
     }
-    else
-        (*pdfValue) = dfAccumulator / n;
 
-    return CE_None;
+    psContext->hQuadTree = CPLQuadTreeCreate( &psContext->sPointsExtent,
+                                              GDALGridPointGetBounds );
+    CPLQuadTreeSetMaxDepth( psContext->hQuadTree, nMaxDepth );
+
+    for ( i = 0; i < nPoints; i++ )
+        CPLQuadTreeInsert( psContext->hQuadTree,
+                           psContext->pasGridPoints + i );
+
+/* -------------------------------------------------------------------- */
+/*      Start the nearest neighbor window at about the mean distance    */
+/*      between points.                                                 */
+/* -------------------------------------------------------------------- */
+    psContext->dfNearestWindowStart =
+        MAX( psContext->sPointsExtent.maxx - psContext->sPointsExtent.minx,
+             psContext->sPointsExtent.maxy - psContext->sPointsExtent.miny )
+        / sqrt( (double)nPoints );
+    if ( !(psContext->dfNearestWindowStart > 0.0) )
+        psContext->dfNearestWindowStart = 1.0;
+
+    CPLDebug( "GDAL_GRID", "Indexed %lu points in a quad tree of depth %d.",
+              (long unsigned int)nPoints, nMaxDepth );
+
+    return true;
 }
 
 /************************************************************************/
-/*                            GDALGridCreate()                          */
+/*                       GDALGridContextCreate()                        */
 /************************************************************************/
 
 /**
- * Create regular grid from the scattered data.
+ * Prepare gridding of the scattered data.
  *
- * This fucntion takes the arrays of X and Y coordinates and corresponding Z
- * values as input and computes regular grid (or call it a raster) from these
- * scattered data. You should supply geometry and extent of the output grid
- * and allocate array sufficient to hold such a grid.
+ * Checks the algorithm options, precomputes the search ellipse parameters
+ * and builds a spatial index of the points, so that the nodes only visit
+ * the points located around them. The index is used by the search ellipse
+ * algorithms and by the nearest neighbor method. Setting the
+ * GDAL_GRID_INDEX configuration option to NO disables it, which is mostly
+ * useful to measure its benefit.
+ *
+ * The context may then be used by GDALGridContextProcess() to compute
+ * any number of grids, which is much cheaper than calling GDALGridCreate()
+ * for every block of a large output raster.
+ *
+ * The rows of the grids are computed by the number of threads given by the
+ * GDAL_NUM_THREADS configuration option, a number or ALL_CPUS, which
+ * defaults to 1. The result does not depend on the number of threads.
  *
  * @param eAlgorithm Gridding method. 
- * @param poOptions Options to control choosen gridding method.
+ * @param poOptions Options to control choosen gridding method. They are
+ * copied in the context.
  * @param nPoints Number of elements in input arrays.
  * @param padfX Input array of X coordinates. 
  * @param padfY Input array of Y coordinates. 
  * @param padfZ Input array of Z values. 
- * @param dfXMin Lowest X border of output grid.
- * @param dfXMax Highest X border of output grid.
- * @param dfYMin Lowest Y border of output grid.
- * @param dfYMax Highest Y border of output grid.
- * @param nXSize Number of columns in output grid.
- * @param nYSize Number of rows in output grid.
- * @param eType Data type of output array.  
- * @param pData Pointer to array where the computed grid will be stored.
- * @param pfnProgress a GDALProgressFunc() compatible callback function for
- * reporting progress or NULL.
- * @param pProgressArg argument to be passed to pfnProgress.  May be NULL.
  *
- * @return CE_None on success or CE_Failure if something goes wrong.
+ * The input arrays are not copied and must be kept alive until
+ * GDALGridContextFree() is called.
+ *
+ * @return the context or NULL if something goes wrong.
  */
 
-CPLErr
-GDALGridCreate( GDALGridAlgorithm eAlgorithm, const void *poOptions,
-                GUInt32 nPoints,
-                const double *padfX, const double *padfY, const double *padfZ,
-                double dfXMin, double dfXMax, double dfYMin, double dfYMax,
-                GUInt32 nXSize, GUInt32 nYSize, GDALDataType eType, void *pData,
-                GDALProgressFunc pfnProgress, void *pProgressArg )
+GDALGridContext *
+GDALGridContextCreate( GDALGridAlgorithm eAlgorithm, const void *poOptions,
+                       GUInt32 nPoints, const double *padfX,
+                       const double *padfY, const double *padfZ )
 {
     CPLAssert( poOptions );
     CPLAssert( padfX );
     CPLAssert( padfY );
     CPLAssert( padfZ );
-    CPLAssert( pData );
-
-    if ( pfnProgress == NULL )
-        pfnProgress = GDALDummyProgress;
 
-    if ( nXSize == 0 || nYSize == 0 )
-    {
-        CPLError( CE_Failure, CPLE_IllegalArg,
-                  "Output raster dimesions should have non-zero size." );
-        return CE_Failure;
-    }
-
-    GDALGridFunction    pfnGDALGridMethod;
+    GDALGridContext *psContext =
+        (GDALGridContext *)CPLCalloc( 1, sizeof(GDALGridContext) );
+    double          dfRadius1 = 0.0, dfRadius2 = 0.0, dfAngle = 0.0;
 
     switch ( eAlgorithm )
     {
         case GGA_InverseDistanceToAPower:
-            if ( ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->
-                 dfRadius1 == 0.0 &&
-                 ((GDALGridInverseDistanceToAPowerOptions *)poOptions)->
-                 dfRadius2 == 0.0 )
-                pfnGDALGridMethod = GDALGridInverseDistanceToAPowerNoSearch;
+            memcpy( &psContext->uOptions.sInvDist, poOptions,
+                    sizeof(GDALGridInverseDistanceToAPowerOptions) );
+            dfRadius1 = psContext->uOptions.sInvDist.dfRadius1;
+            dfRadius2 = psContext->uOptions.sInvDist.dfRadius2;
+            dfAngle = psContext->uOptions.sInvDist.dfAngle;
+            if ( dfRadius1 == 0.0 && dfRadius2 == 0.0 )
+                psContext->pfnSubsetMethod = NULL;
             else
-                pfnGDALGridMethod = GDALGridInverseDistanceToAPower;
+                psContext->pfnSubsetMethod =
+                    GDALGridInverseDistanceToAPowerSubset;
             break;
 
         case GGA_MovingAverage:
-            pfnGDALGridMethod = GDALGridMovingAverage;
+            memcpy( &psContext->uOptions.sMovingAverage, poOptions,
+                    sizeof(GDALGridMovingAverageOptions) );
+            dfRadius1 = psContext->uOptions.sMovingAverage.dfRadius1;
+            dfRadius2 = psContext->uOptions.sMovingAverage.dfRadius2;
+            dfAngle = psContext->uOptions.sMovingAverage.dfAngle;
+            psContext->pfnSubsetMethod = GDALGridMovingAverageSubset;
             break;
 
         case GGA_NearestNeighbor:
-            pfnGDALGridMethod = GDALGridNearestNeighbor;
+            memcpy( &psContext->uOptions.sNearestNeighbor, poOptions,
+                    sizeof(GDALGridNearestNeighborOptions) );
+            dfRadius1 = psContext->uOptions.sNearestNeighbor.dfRadius1;
+            dfRadius2 = psContext->uOptions.sNearestNeighbor.dfRadius2;
+            dfAngle = psContext->uOptions.sNearestNeighbor.dfAngle;
+            psContext->pfnSubsetMethod = GDALGridNearestNeighborSubset;
             break;
 
         case GGA_MetricMinimum:
-            pfnGDALGridMethod = GDALGridDataMetricMinimum;
-            break;
-
         case GGA_MetricMaximum:
-            pfnGDALGridMethod = GDALGridDataMetricMaximum;
-            break;
-
         case GGA_MetricRange:
-            pfnGDALGridMethod = GDALGridDataMetricRange;
-            break;
-
         case GGA_MetricCount:
-            pfnGDALGridMethod = GDALGridDataMetricCount;
-            break;
-
         case GGA_MetricAverageDistance:
-            pfnGDALGridMethod = GDALGridDataMetricAverageDistance;
-            break;
-
         case GGA_MetricAverageDistancePts:
-            pfnGDALGridMethod = GDALGridDataMetricAverageDistancePts;
+            memcpy( &psContext->uOptions.sDataMetrics, poOptions,
+                    sizeof(GDALGridDataMetricsOptions) );
+            dfRadius1 = psContext->uOptions.sDataMetrics.dfRadius1;
+            dfRadius2 = psContext->uOptions.sDataMetrics.dfRadius2;
+            dfAngle = psContext->uOptions.sDataMetrics.dfAngle;
+            if ( eAlgorithm == GGA_MetricMinimum )
+                psContext->pfnSubsetMethod = GDALGridDataMetricMinimumSubset;
+            else if ( eAlgorithm == GGA_MetricMaximum )
+                psContext->pfnSubsetMethod = GDALGridDataMetricMaximumSubset;
+            else if ( eAlgorithm == GGA_MetricRange )
+                psContext->pfnSubsetMethod = GDALGridDataMetricRangeSubset;
+            else if ( eAlgorithm == GGA_MetricCount )
+                psContext->pfnSubsetMethod = GDALGridDataMetricCountSubset;
+            else if ( eAlgorithm == GGA_MetricAverageDistance )
+                psContext->pfnSubsetMethod =
+                    GDALGridDataMetricAverageDistanceSubset;
+            else
+                psContext->pfnSubsetMethod =
+                    GDALGridDataMetricAverageDistancePtsSubset;
             break;
 
         default:
             CPLError( CE_Failure, CPLE_IllegalArg,
                       "GDAL does not support gridding method %d", eAlgorithm );
-	    return CE_Failure;
+            CPLFree( psContext );
+            return NULL;
     }
 
-    GUInt32 nXPoint, nYPoint;
-    const double    dfDeltaX = ( dfXMax - dfXMin ) / nXSize;
-    const double    dfDeltaY = ( dfYMax - dfYMin ) / nYSize;
+    psContext->eAlgorithm = eAlgorithm;
+    psContext->nPoints = nPoints;
+    psContext->padfX = padfX;
+    psContext->padfY = padfY;
+    psContext->padfZ = padfZ;
+    psContext->nThreads =
+        CPLParseNumThreads( CPLGetConfigOption( "GDAL_NUM_THREADS", NULL ), 1 );
+
+    GDALGridEllipseInit( &psContext->sEllipse, dfRadius1, dfRadius2, dfAngle );
+
+/* -------------------------------------------------------------------- */
+/*      Search ellipses with a zero radius degenerate, and are handled  */
+/*      by visiting all the points as well as the inverse distance to   */
+/*      a power without search.  The nearest neighbor without search    */
+/*      ellipse uses the index with a growing window.                   */
+/* -------------------------------------------------------------------- */
+    if ( psContext->pfnSubsetMethod == NULL
+         || nPoints < GRID_INDEX_MIN_POINTS
+         || !CSLTestBoolean( CPLGetConfigOption( "GDAL_GRID_INDEX", "YES" ) ) )
+        return psContext;
+
+    if ( dfRadius1 != 0.0 && dfRadius2 != 0.0 )
+    {
+        // Slightly enlarged to stay clear of rounding in the rotation.
+        psContext->dfSearchWindow =
+            MAX( fabs(dfRadius1), fabs(dfRadius2) ) * (1.0 + 1e-9);
+    }
+    else if ( eAlgorithm == GGA_NearestNeighbor
+              && dfRadius1 == 0.0 && dfRadius2 == 0.0 )
+    {
+        psContext->dfSearchWindow = 0.0;
+    }
+    else
+        return psContext;
+
+    GDALGridBuildIndex( psContext );
+
+    return psContext;
+}
+
+/************************************************************************/
+/*                        GDALGridContextFree()                         */
+/************************************************************************/
+
+/**
+ * Free a context used created by GDALGridContextCreate().
+ *
+ * @param psContext the context.
+ */
+
+void GDALGridContextFree( GDALGridContext *psContext )
+{
+    if ( psContext == NULL )
+        return;
+
+    if ( psContext->hQuadTree != NULL )
+        CPLQuadTreeDestroy( psContext->hQuadTree );
+    CPLFree( psContext->pasGridPoints );
+    CPLFree( psContext );
+}
+
+/************************************************************************/
+/*                         GDALGridCandidates                           */
+/*                                                                      */
+/*      Scratch list of the points found in the index for a node.       */
+/************************************************************************/
+
+typedef struct
+{
+    GUInt32     *panIndices;
+    GUInt32     nMaxIndices;
+} GDALGridCandidates;
+
+/************************************************************************/
+/*                      GDALGridCompareIndices()                        */
+/************************************************************************/
+
+static int GDALGridCompareIndices( const void *pA, const void *pB )
+{
+    const GUInt32 nA = *(const GUInt32 *)pA;
+    const GUInt32 nB = *(const GUInt32 *)pB;
+
+    return ( nA < nB ) ? -1 : ( nA > nB ) ? 1 : 0;
+}
+
+/************************************************************************/
+/*                      GDALGridSearchCandidates()                      */
+/*                                                                      */
+/*      Collect the indices of the points located in the square         */
+/*      window of the given half size around the node.                  */
+/************************************************************************/
+
+static GUInt32 GDALGridSearchCandidates( const GDALGridContext *psContext,
+                                         double dfXPoint, double dfYPoint,
+                                         double dfHalfSize,
+                                         GDALGridCandidates *psCandidates )
+{
+    CPLRectObj  sAoi;
+    int         nFeatures = 0, i;
+
+    sAoi.minx = dfXPoint - dfHalfSize;
+    sAoi.maxx = dfXPoint + dfHalfSize;
+    sAoi.miny = dfYPoint - dfHalfSize;
+    sAoi.maxy = dfYPoint + dfHalfSize;
+
+    void **pahFeatures =
+        CPLQuadTreeSearch( psContext->hQuadTree, &sAoi, &nFeatures );
+
+    if ( (GUInt32)nFeatures > psCandidates->nMaxIndices )
+    {
+        psCandidates->nMaxIndices = nFeatures + nFeatures / 2;
+        psCandidates->panIndices = (GUInt32 *)
+            CPLRealloc( psCandidates->panIndices,
+                        sizeof(GUInt32) * psCandidates->nMaxIndices );
+    }
+
+    for ( i = 0; i < nFeatures; i++ )
+        psCandidates->panIndices[i] = (GUInt32)
+            ((GDALGridPoint *)pahFeatures[i] - psContext->pasGridPoints);
+
+    CPLFree( pahFeatures );
+
+    return (GUInt32)nFeatures;
+}
+
+/************************************************************************/
+/*                     GDALGridContextProcessNode()                     */
+/************************************************************************/
+
+static CPLErr GDALGridContextProcessNode( const GDALGridContext *psContext,
+                                          GDALGridCandidates *psCandidates,
+                                          double dfXPoint, double dfYPoint,
+                                          double *pdfValue )
+{
+    const void  *poOptions = &psContext->uOptions;
+
+    if ( psContext->pfnSubsetMethod == NULL )
+        return GDALGridInverseDistanceToAPowerNoSearch( poOptions,
+                                                        psContext->nPoints,
+                                                        psContext->padfX,
+                                                        psContext->padfY,
+                                                        psContext->padfZ,
+                                                        dfXPoint, dfYPoint,
+                                                        pdfValue );
+
+    if ( psContext->hQuadTree == NULL )
+        return psContext->pfnSubsetMethod( poOptions, &psContext->sEllipse,
+                                           psContext->nPoints, NULL,
+                                           psContext->padfX, psContext->padfY,
+                                           psContext->padfZ,
+                                           dfXPoint, dfYPoint, pdfValue );
+
+    GUInt32 nCount;
+
+    if ( psContext->dfSearchWindow > 0.0 )
+    {
+        nCount = GDALGridSearchCandidates( psContext, dfXPoint, dfYPoint,
+                                           psContext->dfSearchWindow,
+                                           psCandidates );
+    }
+    else
+    {
+/* -------------------------------------------------------------------- */
+/*      Nearest neighbor without search ellipse: grow the window until */
+/*      it catches some points, then search again within the distance  */
+/*      to the closest of them, which gets all the points at least as  */
+/*      close as the nearest one.                                       */
+/* -------------------------------------------------------------------- */
+        const CPLRectObj *psExtent = &psContext->sPointsExtent;
+        double  dfHalfSize = psContext->dfNearestWindowStart;
+
+        for ( ;; )
+        {
+            nCount = GDALGridSearchCandidates( psContext, dfXPoint, dfYPoint,
+                                               dfHalfSize, psCandidates );
+            if ( nCount > 0
+                 || ( dfXPoint - dfHalfSize <= psExtent->minx
+                      && dfXPoint + dfHalfSize >= psExtent->maxx
+                      && dfYPoint - dfHalfSize <= psExtent->miny
+                      && dfYPoint + dfHalfSize >= psExtent->maxy ) )
+                break;
+            dfHalfSize *= 2.0;
+        }
+
+        if ( nCount > 0 )
+        {
+            double  dfNearestR2 = 0.0;
+            GUInt32 k;
+
+            for ( k = 0; k < nCount; k++ )
+            {
+                const GUInt32 i = psCandidates->panIndices[k];
+                const double  dfRX = psContext->padfX[i] - dfXPoint;
+                const double  dfRY = psContext->padfY[i] - dfYPoint;
+                const double  dfR2 = dfRX * dfRX + dfRY * dfRY;
+
+                if ( k == 0 || dfR2 < dfNearestR2 )
+                    dfNearestR2 = dfR2;
+            }
+
+            nCount = GDALGridSearchCandidates( psContext, dfXPoint, dfYPoint,
+                                               sqrt(dfNearestR2) * (1.0 + 1e-9),
+                                               psCandidates );
+        }
+    }
+
+    qsort( psCandidates->panIndices, nCount, sizeof(GUInt32),
+           GDALGridCompareIndices );
+
+    return psContext->pfnSubsetMethod( poOptions, &psContext->sEllipse,
+                                       nCount, psCandidates->panIndices,
+                                       psContext->padfX, psContext->padfY,
+                                       psContext->padfZ,
+                                       dfXPoint, dfYPoint, pdfValue );
+}
+
+/************************************************************************/
+/*                             GDALGridJob                              */
+/*                                                                      */
+/*      State shared by the threads computing the nodes of a grid.      */
+/************************************************************************/
+
+typedef struct
+{
+    const GDALGridContext *psContext;
+    double              dfXMin;
+    double              dfYMin;
+    double              dfDeltaX;
+    double              dfDeltaY;
+    GUInt32             nXSize;
+    GUInt32             nYSize;
+    GDALDataType        eType;
+    GByte               *pabyData;
+    GUInt32             nRowsPerJob;
+    GUInt32             nColsPerJob;
+    int                 nColJobCount;
+    GDALProgressFunc    pfnProgress;
+    void                *pProgressArg;
+
+    void                *hMutex;
+    double              dfNodesDone;
+    int                 bAbort;
+    CPLErr              eErr;
+} GDALGridJob;
+
+/************************************************************************/
+/*                           GDALGridJobFunc()                          */
+/*                                                                      */
+/*      Compute one tile of rows and columns.  Every thread has its     */
+/*      own scanline and candidate buffers, the context and the points  */
+/*      are only read, and the tiles are written to disjoint parts of   */
+/*      the output array.  The node coordinates only depend on the      */
+/*      node position, not on the tile that computes it.                */
+/************************************************************************/
+
+static int GDALGridJobFunc( void *pUserData, int iJob )
+{
+    GDALGridJob *psJob = (GDALGridJob *)pUserData;
+    const GUInt32 nXSize = psJob->nXSize;
+    const GUInt32 nYStart = (iJob / psJob->nColJobCount) * psJob->nRowsPerJob;
+    const GUInt32 nYEnd = MIN( nYStart + psJob->nRowsPerJob, psJob->nYSize );
+    const GUInt32 nXStart = (iJob % psJob->nColJobCount) * psJob->nColsPerJob;
+    const GUInt32 nXEnd = MIN( nXStart + psJob->nColsPerJob, nXSize );
+    const int   nDataTypeSize = GDALGetDataTypeSize(psJob->eType) / 8;
+    GDALGridCandidates sCandidates = { NULL, 0 };
+    GUInt32     nXPoint, nYPoint;
+    CPLErr      eErr = CE_None;
 
 /* -------------------------------------------------------------------- */
 /*  Allocate a buffer of scanline size, fill it with gridded values     */
 /*  and use GDALCopyWords() to copy values into output data array with  */
 /*  appropriate data type conversion.                                   */
 /* -------------------------------------------------------------------- */
-    double      *padfValues = (double *)VSIMalloc( sizeof(double) * nXSize );
-    GByte       *pabyData = (GByte *)pData;
-    int         nDataTypeSize = GDALGetDataTypeSize(eType) / 8;
-    int         nLineSpace = nXSize * nDataTypeSize;
-    
-    for ( nYPoint = 0; nYPoint < nYSize; nYPoint++ )
+    double      *padfValues =
+        (double *)VSIMalloc2( sizeof(double), nXEnd - nXStart );
+
+    if ( padfValues == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "Cannot allocate scanline of %lu values.",
+                  (long unsigned int)(nXEnd - nXStart) );
+        eErr = CE_Failure;
+    }
+
+    for ( nYPoint = nYStart; nYPoint < nYEnd && eErr == CE_None; nYPoint++ )
     {
-        const double    dfYPoint = dfYMin + ( nYPoint + 0.5 ) * dfDeltaY;
+        const double    dfYPoint =
+            psJob->dfYMin + ( nYPoint + 0.5 ) * psJob->dfDeltaY;
 
-        for ( nXPoint = 0; nXPoint < nXSize; nXPoint++ )
+        for ( nXPoint = nXStart; nXPoint < nXEnd; nXPoint++ )
         {
-            const double    dfXPoint = dfXMin + ( nXPoint + 0.5 ) * dfDeltaX;
+            const double    dfXPoint =
+                psJob->dfXMin + ( nXPoint + 0.5 ) * psJob->dfDeltaX;
 
-            if ( (*pfnGDALGridMethod)( poOptions, nPoints, padfX, padfY, padfZ,
-                                       dfXPoint, dfYPoint,
-                                       padfValues + nXPoint ) != CE_None )
+            if ( GDALGridContextProcessNode( psJob->psContext, &sCandidates,
+                                             dfXPoint, dfYPoint,
+                                             padfValues + nXPoint - nXStart )
+                 != CE_None )
             {
                 CPLError( CE_Failure, CPLE_AppDefined,
                           "Gridding failed at X position %lu, Y position %lu",
                           (long unsigned int)nXPoint,
                           (long unsigned int)nYPoint );
-                return CE_Failure;
+                eErr = CE_Failure;
+                break;
             }
         }
 
+        if ( eErr != CE_None )
+            break;
+
         GDALCopyWords( padfValues, GDT_Float64, sizeof(double),
-                       pabyData, eType, nDataTypeSize,
-                       nXSize );
-        pabyData += nLineSpace;
+                       psJob->pabyData
+                       + ((size_t)nYPoint * nXSize + nXStart) * nDataTypeSize,
+                       psJob->eType, nDataTypeSize, nXEnd - nXStart );
 
-        if( !pfnProgress( (double)(nYPoint + 1) / nYSize, NULL, pProgressArg ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            return CE_Failure;
-        }
+/* -------------------------------------------------------------------- */
+/*      Report the nodes completed by all threads.  The progress        */
+/*      function is only called by one thread at a time.                */
+/* -------------------------------------------------------------------- */
+        CPLMutexHolderD( &(psJob->hMutex) );
+
+        psJob->dfNodesDone += nXEnd - nXStart;
+        if ( !psJob->bAbort
+             && !psJob->pfnProgress( psJob->dfNodesDone
+                                     / ((double)nXSize * psJob->nYSize),
+                                     NULL, psJob->pProgressArg ) )
+            psJob->bAbort = TRUE;
+
+        if ( psJob->bAbort )
+            break;
     }
 
+    CPLFree( sCandidates.panIndices );
     VSIFree( padfValues );
 
-    return CE_None;
+    if ( eErr != CE_None )
+    {
+        CPLMutexHolderD( &(psJob->hMutex) );
+        psJob->eErr = eErr;
+        psJob->bAbort = TRUE;
+    }
+
+    return !psJob->bAbort;
+}
+
+/************************************************************************/
+/*                       GDALGridContextProcess()                       */
+/************************************************************************/
+
+/**
+ * Compute a regular grid from the scattered data of a context.
+ *
+ * The rows, or for requests of a few rows the columns, are distributed to
+ * the number of threads set up when the context was created, see
+ * GDALGridContextCreate(). The progress function is called from one
+ * thread at a time, after each completed row piece.
+ *
+ * @param psContext Context created by GDALGridContextCreate().
+ * @param dfXMin Lowest X border of output grid.
+ * @param dfXMax Highest X border of output grid.
+ * @param dfYMin Lowest Y border of output grid.
+ * @param dfYMax Highest Y border of output grid.
+ * @param nXSize Number of columns in output grid.
+ * @param nYSize Number of rows in output grid.
+ * @param eType Data type of output array.  
+ * @param pData Pointer to array where the computed grid will be stored.
+ * @param pfnProgress a GDALProgressFunc() compatible callback function for
+ * reporting progress or NULL.
+ * @param pProgressArg argument to be passed to pfnProgress.  May be NULL.
+ *
+ * @return CE_None on success or CE_Failure if something goes wrong.
+ *
+ * @see GDALGridCreate()
+ */
+
+CPLErr
+GDALGridContextProcess( GDALGridContext *psContext,
+                        double dfXMin, double dfXMax,
+                        double dfYMin, double dfYMax,
+                        GUInt32 nXSize, GUInt32 nYSize,
+                        GDALDataType eType, void *pData,
+                        GDALProgressFunc pfnProgress, void *pProgressArg )
+{
+    CPLAssert( psContext );
+    CPLAssert( pData );
+
+    if ( pfnProgress == NULL )
+        pfnProgress = GDALDummyProgress;
+
+    if ( nXSize == 0 || nYSize == 0 )
+    {
+        CPLError( CE_Failure, CPLE_IllegalArg,
+                  "Output raster dimesions should have non-zero size." );
+        return CE_Failure;
+    }
+
+    GDALGridJob sJob;
+
+    sJob.psContext = psContext;
+    sJob.dfXMin = dfXMin;
+    sJob.dfYMin = dfYMin;
+    sJob.dfDeltaX = ( dfXMax - dfXMin ) / nXSize;
+    sJob.dfDeltaY = ( dfYMax - dfYMin ) / nYSize;
+    sJob.nXSize = nXSize;
+    sJob.nYSize = nYSize;
+    sJob.eType = eType;
+    sJob.pabyData = (GByte *)pData;
+    sJob.pfnProgress = pfnProgress;
+    sJob.pProgressArg = pProgressArg;
+    sJob.hMutex = NULL;
+    sJob.dfNodesDone = 0.0;
+    sJob.bAbort = FALSE;
+    sJob.eErr = CE_None;
+
+/* -------------------------------------------------------------------- */
+/*      With several threads, hand out bands of rows a few times more   */
+/*      numerous than the threads, so that the load stays balanced      */
+/*      when the point density varies over the grid.  Requests of a     */
+/*      few rows, such as single strips, are also split by columns.     */
+/* -------------------------------------------------------------------- */
+    const int   nThreads = psContext->nThreads;
+    const GUInt32 nWantedJobs = (GUInt32)MAX( 1, nThreads ) * 4;
+    int         nJobCount;
+
+    sJob.nRowsPerJob = nYSize;
+    sJob.nColsPerJob = nXSize;
+    sJob.nColJobCount = 1;
+
+    if ( nThreads > 1 && nYSize >= nWantedJobs )
+    {
+        sJob.nRowsPerJob = ( nYSize + nWantedJobs - 1 ) / nWantedJobs;
+    }
+    else if ( nThreads > 1 )
+    {
+        const GUInt32 nColJobs =
+            MIN( nXSize, ( nWantedJobs + nYSize - 1 ) / nYSize );
+
+        sJob.nRowsPerJob = 1;
+        sJob.nColsPerJob = ( nXSize + nColJobs - 1 ) / nColJobs;
+        sJob.nColJobCount =
+            (int)(( nXSize + sJob.nColsPerJob - 1 ) / sJob.nColsPerJob);
+    }
+
+    nJobCount = sJob.nColJobCount
+        * (int)(( nYSize + sJob.nRowsPerJob - 1 ) / sJob.nRowsPerJob);
+
+    CPLRunJobs( nJobCount, (int)nThreads, GDALGridJobFunc, &sJob );
+
+    if ( sJob.hMutex != NULL )
+        CPLDestroyMutex( sJob.hMutex );
+
+    if ( sJob.eErr == CE_None && sJob.bAbort )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        sJob.eErr = CE_Failure;
+    }
+
+    return sJob.eErr;
 }
 
+/************************************************************************/
+/*                            GDALGridCreate()                          */
+/************************************************************************/
+
+/**
+ * Create regular grid from the scattered data.
+ *
+ * This fucntion takes the arrays of X and Y coordinates and corresponding Z
+ * values as input and computes regular grid (or call it a raster) from these
+ * scattered data. You should supply geometry and extent of the output grid
+ * and allocate array sufficient to hold such a grid.
+ *
+ * This is a shortcut for GDALGridContextCreate(), GDALGridContextProcess()
+ * and GDALGridContextFree(). Callers computing several grids from the same
+ * points, for instance one per output block, should use these functions
+ * directly to build the point index only once.
+ *
+ * @param eAlgorithm Gridding method. 
+ * @param poOptions Options to control choosen gridding method.
+ * @param nPoints Number of elements in input arrays.
+ * @param padfX Input array of X coordinates. 
+ * @param padfY Input array of Y coordinates. 
+ * @param padfZ Input array of Z values. 
+ * @param dfXMin Lowest X border of output grid.
+ * @param dfXMax Highest X border of output grid.
+ * @param dfYMin Lowest Y border of output grid.
+ * @param dfYMax Highest Y border of output grid.
+ * @param nXSize Number of columns in output grid.
+ * @param nYSize Number of rows in output grid.
+ * @param eType Data type of output array.  
+ * @param pData Pointer to array where the computed grid will be stored.
+ * @param pfnProgress a GDALProgressFunc() compatible callback function for
+ * reporting progress or NULL.
+ * @param pProgressArg argument to be passed to pfnProgress.  May be NULL.
+ *
+ * @return CE_None on success or CE_Failure if something goes wrong.
+ */
+
+CPLErr
+GDALGridCreate( GDALGridAlgorithm eAlgorithm, const void *poOptions,
+                GUInt32 nPoints,
+                const double *padfX, const double *padfY, const double *padfZ,
+                double dfXMin, double dfXMax, double dfYMin, double dfYMax,
+                GUInt32 nXSize, GUInt32 nYSize, GDALDataType eType, void *pData,
+                GDALProgressFunc pfnProgress, void *pProgressArg )
+{
+    CPLAssert( poOptions );
+    CPLAssert( padfX );
+    CPLAssert( padfY );
+    CPLAssert( padfZ );
+    CPLAssert( pData );
+
+    if ( nXSize == 0 || nYSize == 0 )
+    {
+        CPLError( CE_Failure, CPLE_IllegalArg,
+                  "Output raster dimesions should have non-zero size." );
+        return CE_Failure;
+    }
+
+    GDALGridContext *psContext =
+        GDALGridContextCreate( eAlgorithm, poOptions, nPoints,
+                               padfX, padfY, padfZ );
+    if ( psContext == NULL )
+        return CE_Failure;
+
+    CPLErr  eErr = GDALGridContextProcess( psContext,
+                                           dfXMin, dfXMax, dfYMin, dfYMax,
+                                           nXSize, nYSize, eType, pData,
+                                           pfnProgress, pProgressArg );
+
+    GDALGridContextFree( psContext );
+
+    return eErr;
+}
@@ -27,17 +27,146 @@
  * DEALINGS IN THE SOFTWARE.
  ****************************************************************************/
 
-#include "gdal_alg.h"
+#include "gdal_alg_priv.h"
 #include "cpl_conv.h"
 #include "cpl_string.h"
 
 CPL_CVSID("$Id$");
 
-static CPLErr
-ProcessProximityLine( GInt32 *panSrcScanline, int *panNearX, int *panNearY, 
-                      int bForward, int iLine, int nXSize, double nMaxDist,
-                      float *pafProximity,
-                      int nTargetValues, int *panTargetValues );
+/************************************************************************/
+/*                          GDALProximityData                           */
+/*                                                                      */
+/*      State shared by the distance transform callbacks.               */
+/************************************************************************/
+
+typedef struct {
+    GDALRasterBandH hSrcBand;
+    GDALRasterBandH hProximityBand;
+    int         nXSize;
+    int         nTargetValues;
+    int         *panTargetValues;
+    double      dfDistMult;
+    int         bFixedBufVal;
+    double      dfFixedBufVal;
+    float       fNoDataValue;
+
+    int         nYOff;
+    int         nAllocLines;
+    GInt32      *panSrcScanline;
+    float       *pafProximity;
+} GDALProximityData;
+
+/************************************************************************/
+/*                          GDALProximityRead()                         */
+/*                                                                      */
+/*      Read a strip of the source band and flag the target pixels.     */
+/************************************************************************/
+
+static CPLErr GDALProximityRead( void *pUserData, int nYOff, int nLines, 
+                                 GByte *pabyFeature, float *pafValue )
+
+{
+    GDALProximityData *psData = (GDALProximityData *) pUserData;
+    const int nXSize = psData->nXSize;
+    size_t i, nPixels = (size_t) nXSize * nLines;
+
+    if( nLines > psData->nAllocLines )
+    {
+        CPLFree( psData->panSrcScanline );
+        CPLFree( psData->pafProximity );
+        psData->panSrcScanline = (GInt32 *) 
+            VSIMalloc3( sizeof(GInt32), nXSize, nLines );
+        psData->pafProximity = (float *) 
+            VSIMalloc3( sizeof(float), nXSize, nLines );
+        psData->nAllocLines = nLines;
+
+        if( psData->panSrcScanline == NULL || psData->pafProximity == NULL )
+        {
+            CPLError( CE_Failure, CPLE_OutOfMemory, 
+                      "Out of memory allocating working buffers.");
+            psData->nAllocLines = 0;
+            return CE_Failure;
+        }
+    }
+
+    psData->nYOff = nYOff;
+
+    CPLErr eErr = GDALRasterIO( psData->hSrcBand, GF_Read, 0, nYOff, 
+                                nXSize, nLines, psData->panSrcScanline, 
+                                nXSize, nLines, GDT_Int32, 0, 0 );
+    if( eErr != CE_None )
+        return eErr;
+
+    for( i = 0; i < nPixels; i++ )
+    {
+        GInt32 nValue = psData->panSrcScanline[i];
+        int bIsTarget = FALSE;
+
+        if( psData->nTargetValues == 0 )
+            bIsTarget = (nValue != 0);
+        else
+        {
+            int iTarget;
+
+            for( iTarget = 0; iTarget < psData->nTargetValues; iTarget++ )
+            {
+                if( nValue == psData->panTargetValues[iTarget] )
+                    bIsTarget = TRUE;
+            }
+        }
+
+        pabyFeature[i] = (GByte) bIsTarget;
+    }
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                          GDALProximityLine()                         */
+/*                                                                      */
+/*      Turn the distances of a line into output values.                */
+/************************************************************************/
+
+static void GDALProximityLine( void *pUserData, int iLine, 
+                               float **papafDist, float **papafValue )
+
+{
+    GDALProximityData *psData = (GDALProximityData *) pUserData;
+    const int nXSize = psData->nXSize;
+    const float *pafDist = papafDist[0];
+    float *pafProximity = psData->pafProximity 
+        + (size_t) (iLine - psData->nYOff) * nXSize;
+    int i;
+
+    for( i = 0; i < nXSize; i++ )
+    {
+        if( pafDist[i] < 0.0 )
+            pafProximity[i] = psData->fNoDataValue;
+        else if( pafDist[i] > 0.0 )
+        {
+            if( psData->bFixedBufVal )
+                pafProximity[i] = (float) psData->dfFixedBufVal;
+            else 
+                pafProximity[i] = (float) (pafDist[i] * psData->dfDistMult);
+        }
+        else
+            pafProximity[i] = 0.0;
+    }
+}
+
+/************************************************************************/
+/*                         GDALProximityWrite()                         */
+/************************************************************************/
+
+static CPLErr GDALProximityWrite( void *pUserData, int nYOff, int nLines )
+
+{
+    GDALProximityData *psData = (GDALProximityData *) pUserData;
+
+    return GDALRasterIO( psData->hProximityBand, GF_Write, 0, nYOff, 
+                         psData->nXSize, nLines, psData->pafProximity, 
+                         psData->nXSize, nLines, GDT_Float32, 0, 0 );
+}
 
 /************************************************************************/
 /*                        GDALComputeProximity()                        */
@@ -88,6 +217,10 @@ queried for a nodata value.  If one is not found, 65535 will be used.
 
 If this option is set, all pixels within the MAXDIST threadhold are
 set to this fixed value instead of to a proximity distance.  
+
+The distances are those to the nearest target pixel, computed exactly 
+with a distance transform.  The raster is processed in strips of lines
+with as many threads as the GDAL_NUM_THREADS configuration option allows.
 */
 
 
@@ -222,317 +355,45 @@ GDALComputeProximity( GDALRasterBandH hSrcBand,
     }
 
 /* -------------------------------------------------------------------- */
-/*      We need a signed type for the working proximity values kept     */
-/*      on disk.  If our proximity band is not signed, then create a    */
-/*      temporary file for this purpose.                                */
-/* -------------------------------------------------------------------- */
-    GDALRasterBandH hWorkProximityBand = hProximityBand;
-    GDALDatasetH hWorkProximityDS = NULL;
-    GDALDataType eProxType = GDALGetRasterDataType( hProximityBand );
-    int   *panNearX = NULL, *panNearY = NULL;
-    float *pafProximity = NULL;
-    GInt32 *panSrcScanline = NULL;
-    int iLine;
-    CPLErr eErr = CE_None;
-
-    if( eProxType == GDT_Byte 
-        || eProxType == GDT_UInt16
-        || eProxType == GDT_UInt32 )
-    {
-        GDALDriverH hDriver = GDALGetDriverByName("GTiff");
-        if (hDriver == NULL)
-        {
-            CPLError(CE_Failure, CPLE_AppDefined,
-                     "GDALComputeProximity needs GTiff driver");
-            eErr = CE_Failure;
-            goto end;
-        }
-        CPLString osTmpFile = CPLGenerateTempFilename( "proximity" );
-        hWorkProximityDS = 
-            GDALCreate( hDriver, osTmpFile,
-                        nXSize, nYSize, 1, GDT_Float32, NULL );
-        if (hWorkProximityDS == NULL)
-        {
-            eErr = CE_Failure;
-            goto end;
-        }
-        hWorkProximityBand = GDALGetRasterBand( hWorkProximityDS, 1 );
-    }
-
-/* -------------------------------------------------------------------- */
-/*      Allocate buffer for two scanlines of distances as floats        */
-/*      (the current and last line).                                    */
-/* -------------------------------------------------------------------- */
-    pafProximity = (float *) VSIMalloc2(sizeof(float), nXSize);
-    panNearX = (int *) VSIMalloc2(sizeof(int), nXSize);
-    panNearY = (int *) VSIMalloc2(sizeof(int), nXSize);
-    panSrcScanline = (GInt32 *) VSIMalloc2(sizeof(GInt32), nXSize);
-
-    if( pafProximity== NULL 
-        || panNearX == NULL 
-        || panNearY == NULL
-        || panSrcScanline == NULL)
-    {
-        CPLError( CE_Failure, CPLE_OutOfMemory, 
-                  "Out of memory allocating working buffers.");
-        eErr = CE_Failure;
-        goto end;
-    }
-
-/* -------------------------------------------------------------------- */
-/*      Loop from top to bottom of the image.                           */
-/* -------------------------------------------------------------------- */
-
-    for( i = 0; i < nXSize; i++ )
-        panNearX[i] = panNearY[i] = -1;
-
-    for( iLine = 0; eErr == CE_None && iLine < nYSize; iLine++ )
-    {
-        // Read for target values.
-        eErr = GDALRasterIO( hSrcBand, GF_Read, 0, iLine, nXSize, 1, 
-                             panSrcScanline, nXSize, 1, GDT_Int32, 0, 0 );
-        if( eErr != CE_None )
-            break;
-
-        for( i = 0; i < nXSize; i++ )
-            pafProximity[i] = -1.0;
-
-        // Left to right
-        ProcessProximityLine( panSrcScanline, panNearX, panNearY, 
-                              TRUE, iLine, nXSize, dfMaxDist,
-                              pafProximity, nTargetValues, panTargetValues );
-
-        // Right to Left
-        ProcessProximityLine( panSrcScanline, panNearX, panNearY, 
-                              FALSE, iLine, nXSize, dfMaxDist,
-                              pafProximity, nTargetValues, panTargetValues );
-
-        // Write out results.
-        eErr = 
-            GDALRasterIO( hWorkProximityBand, GF_Write, 0, iLine, nXSize, 1, 
-                          pafProximity, nXSize, 1, GDT_Float32, 0, 0 );
-
-        if( eErr != CE_None )
-            break;
-
-        if( !pfnProgress( 0.5 * (iLine+1) / (double) nYSize, 
-                          "", pProgressArg ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
-    }
-
-/* -------------------------------------------------------------------- */
-/*      Loop from bottom to top of the image.                           */
-/* -------------------------------------------------------------------- */
-    for( i = 0; i < nXSize; i++ )
-        panNearX[i] = panNearY[i] = -1;
-
-    for( iLine = nYSize-1; eErr == CE_None && iLine >= 0; iLine-- )
-    {
-        // Read first pass proximity
-        eErr = 
-            GDALRasterIO( hWorkProximityBand, GF_Read, 0, iLine, nXSize, 1, 
-                          pafProximity, nXSize, 1, GDT_Float32, 0, 0 );
-
-        if( eErr != CE_None )
-            break;
-
-        // Read pixel values.
-
-        eErr = GDALRasterIO( hSrcBand, GF_Read, 0, iLine, nXSize, 1, 
-                             panSrcScanline, nXSize, 1, GDT_Int32, 0, 0 );
-        if( eErr != CE_None )
-            break;
-
-        // Right to left
-        ProcessProximityLine( panSrcScanline, panNearX, panNearY, 
-                              FALSE, iLine, nXSize, dfMaxDist,
-                              pafProximity, nTargetValues, panTargetValues );
-
-        // Left to right
-        ProcessProximityLine( panSrcScanline, panNearX, panNearY, 
-                              TRUE, iLine, nXSize, dfMaxDist,
-                              pafProximity, nTargetValues, panTargetValues );
-
-        // Final post processing of distances. 
-        for( i = 0; i < nXSize; i++ )
-        {
-            if( pafProximity[i] < 0.0 )
-                pafProximity[i] = fNoDataValue;
-            else if( pafProximity[i] > 0.0 )
-            {
-                if( bFixedBufVal )
-                    pafProximity[i] = (float) dfFixedBufVal;
-                else 
-                    pafProximity[i] *= dfDistMult;
-            }
-        }
-  
-        // Write out results.
-        eErr = 
-            GDALRasterIO( hProximityBand, GF_Write, 0, iLine, nXSize, 1, 
-                          pafProximity, nXSize, 1, GDT_Float32, 0, 0 );
-
-        if( eErr != CE_None )
-            break;
-
-        if( !pfnProgress( 0.5 + 0.5 * (nYSize-iLine) / (double) nYSize, 
-                          "", pProgressArg ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
-    }
+/*      Run the distance transform, the callbacks reading the source    */
+/*      band and writing the proximity band strip by strip.             */
+/* -------------------------------------------------------------------- */
+    GDALProximityData sData;
+    GDALEDTInfo sInfo;
+
+    sData.hSrcBand = hSrcBand;
+    sData.hProximityBand = hProximityBand;
+    sData.nXSize = nXSize;
+    sData.nTargetValues = nTargetValues;
+    sData.panTargetValues = panTargetValues;
+    sData.dfDistMult = dfDistMult;
+    sData.bFixedBufVal = bFixedBufVal;
+    sData.dfFixedBufVal = dfFixedBufVal;
+    sData.fNoDataValue = fNoDataValue;
+    sData.nYOff = 0;
+    sData.nAllocLines = 0;
+    sData.panSrcScanline = NULL;
+    sData.pafProximity = NULL;
+
+    sInfo.nXSize = nXSize;
+    sInfo.nYSize = nYSize;
+    sInfo.dfMaxDist = dfMaxDist;
+    sInfo.nRegions = 1;
+    sInfo.aeRegions[0] = GEDT_Whole;
+    sInfo.bValues = FALSE;
+    sInfo.pfnRead = GDALProximityRead;
+    sInfo.pfnLine = GDALProximityLine;
+    sInfo.pfnWrite = GDALProximityWrite;
+    sInfo.pUserData = &sData;
+
+    CPLErr eErr = GDALEDTProcess( &sInfo, pfnProgress, pProgressArg );
 
 /* -------------------------------------------------------------------- */
 /*      Cleanup                                                         */
 /* -------------------------------------------------------------------- */
-end:
-    CPLFree( panNearX );
-    CPLFree( panNearY );
-    CPLFree( panSrcScanline );
-    CPLFree( pafProximity );
+    CPLFree( sData.panSrcScanline );
+    CPLFree( sData.pafProximity );
     CPLFree(panTargetValues);
 
-    if( hWorkProximityDS != NULL )
-    {
-        CPLString osProxFile = GDALGetDescription( hWorkProximityDS );
-        GDALClose( hWorkProximityDS );
-        GDALDeleteDataset( GDALGetDriverByName( "GTiff" ), osProxFile );
-    }
-
     return eErr;
 }
-
-/************************************************************************/
-/*                        ProcessProximityLine()                        */
-/************************************************************************/
-                      
-static CPLErr
-ProcessProximityLine( GInt32 *panSrcScanline, int *panNearX, int *panNearY, 
-                      int bForward, int iLine, int nXSize, double dfMaxDist,
-                      float *pafProximity,
-                      int nTargetValues, int *panTargetValues )
-
-{
-    int iStart, iEnd, iStep, iPixel;
-
-    if( bForward )
-    {
-        iStart = 0;
-        iEnd = nXSize; 
-        iStep = 1;
-    }
-    else
-    {
-        iStart = nXSize-1;
-        iEnd = -1; 
-        iStep = -1;
-    }
-
-    for( iPixel = iStart; iPixel != iEnd; iPixel += iStep )
-    {
-        int bIsTarget = FALSE;
-
-/* -------------------------------------------------------------------- */
-/*      Is the current pixel a target pixel?                            */
-/* -------------------------------------------------------------------- */
-        if( nTargetValues == 0 )
-            bIsTarget = (panSrcScanline[iPixel] != 0);
-        else
-        {
-            int i;
-
-            for( i = 0; i < nTargetValues; i++ )
-            {
-                if( panSrcScanline[iPixel] == panTargetValues[i] )
-                    bIsTarget = TRUE;
-            }
-        }
-
-        if( bIsTarget )
-        {
-            pafProximity[iPixel] = 0.0;
-            panNearX[iPixel] = iPixel;
-            panNearY[iPixel] = iLine;
-            continue;
-        }
-
-/* -------------------------------------------------------------------- */
-/*      Are we near(er) to the closest target to the above (below)      */
-/*      pixel?                                                          */
-/* -------------------------------------------------------------------- */
-        float fNearDistSq = MAX(dfMaxDist,nXSize) * MAX(dfMaxDist,nXSize) * 2;
-        float fDistSq;
-
-        if( panNearX[iPixel] != -1 )
-        {
-            fDistSq = 
-                (panNearX[iPixel] - iPixel) * (panNearX[iPixel] - iPixel)
-                + (panNearY[iPixel] - iLine) * (panNearY[iPixel] - iLine);
-
-            if( fDistSq < fNearDistSq )
-            {
-                fNearDistSq = fDistSq;
-            }
-            else
-            {
-                panNearX[iPixel] = -1;
-                panNearY[iPixel] = -1;
-            }
-        }
-
-/* -------------------------------------------------------------------- */
-/*      Are we near(er) to the closest target to the left (right)       */
-/*      pixel?                                                          */
-/* -------------------------------------------------------------------- */
-        int iLast = iPixel-iStep;
-
-        if( iPixel != iStart && panNearX[iLast] != -1 )
-        {
-            fDistSq = 
-                (panNearX[iLast] - iPixel) * (panNearX[iLast] - iPixel)
-                + (panNearY[iLast] - iLine) * (panNearY[iLast] - iLine);
-
-            if( fDistSq < fNearDistSq )
-            {
-                fNearDistSq = fDistSq;
-                panNearX[iPixel] = panNearX[iLast];
-                panNearY[iPixel] = panNearY[iLast];
-            }
-        }
-
-/* -------------------------------------------------------------------- */
-/*      Are we near(er) to the closest target to the topright           */
-/*      (bottom left) pixel?                                            */
-/* -------------------------------------------------------------------- */
-        int iTR = iPixel+iStep;
-
-        if( iTR != iEnd && panNearX[iTR] != -1 )
-        {
-            fDistSq = 
-                (panNearX[iTR] - iPixel) * (panNearX[iTR] - iPixel)
-                + (panNearY[iTR] - iLine) * (panNearY[iTR] - iLine);
-
-            if( fDistSq < fNearDistSq )
-            {
-                fNearDistSq = fDistSq;
-                panNearX[iPixel] = panNearX[iTR];
-                panNearY[iPixel] = panNearY[iTR];
-            }
-        }
-
-/* -------------------------------------------------------------------- */
-/*      Update our proximity value.                                     */
-/* -------------------------------------------------------------------- */
-        if( panNearX[iPixel] != -1 
-            && fNearDistSq <= dfMaxDist * dfMaxDist
-            && (pafProximity[iPixel] < 0 
-                || fNearDistSq < pafProximity[iPixel] * pafProximity[iPixel]) )
-            pafProximity[iPixel] = sqrt(fNearDistSq);
-    }
-
-    return CE_None;
-}
@@ -32,6 +32,8 @@
 #include "gdal_alg.h"
 #include "gdal_alg_priv.h"
 #include "gdal_priv.h"
+#include "cpl_multiproc.h"
+#include "cpl_worker_thread_pool.h"
 #include "ogr_api.h"
 #include "ogr_geometry.h"
 #include "ogr_spatialref.h"
@@ -273,30 +275,106 @@ static void GDALCollectRingsFromGeometry(
 }
 
 /************************************************************************/
-/*                       gv_rasterize_one_shape()                       */
+/*                        GDALRasterizeShapeList                        */
+/*                                                                      */
+/*      Shapes collected into rings and transformed to pixel/line       */
+/*      coordinates once, and the list of the shapes overlapping        */
+/*      each chunk of lines, in burning order.  The arrays are only     */
+/*      read while the chunks are burnt, so the chunks can be burnt     */
+/*      by several threads at once.                                     */
 /************************************************************************/
-static void 
-gv_rasterize_one_shape( unsigned char *pabyChunkBuf, int nYOff,
-                        int nXSize, int nYSize,
-                        int nBands, GDALDataType eType, int bAllTouched,
-                        OGRGeometry *poShape, double *padfBurnValue, 
-                        GDALBurnValueSrc eBurnValueSrc,
-                        GDALTransformerFunc pfnTransformer, 
-                        void *pTransformArg )
+
+typedef enum {
+    GRS_Point = 0,
+    GRS_Line = 1,
+    GRS_Polygon = 2
+} GDALRasterizeShapeKind;
+
+typedef struct {
+    GDALRasterizeShapeKind eKind;
+    int     nFirstPart;
+    int     nPartCount;
+    int     nFirstPoint;
+    int     nPointCount;
+    int     nFirstVariant;
+    int     nVariantCount;
+    int     nFirstBurnValue;
+} GDALRasterizeShape;
+
+typedef struct {
+    int                 nBands;
+    int                 nYChunkSize;
+    std::vector<GDALRasterizeShape> asShapes;
+    std::vector<int>    anPartSize;
+    std::vector<double> adfX;
+    std::vector<double> adfY;
+    std::vector<double> adfVariant;
+    std::vector<double> adfBurnValue;
+    std::vector< std::vector<int> > aanChunkShapes;
+    size_t              nChunkShapeCount;
+} GDALRasterizeShapeList;
+
+/************************************************************************/
+/*                    GDALRasterizeShapeListInit()                      */
+/************************************************************************/
+
+static void GDALRasterizeShapeListInit( GDALRasterizeShapeList *psList,
+                                        int nBands, int nYSize,
+                                        int nYChunkSize )
 
 {
-    GDALRasterizeInfo sInfo;
+    psList->nBands = nBands;
+    psList->nYChunkSize = nYChunkSize;
+    psList->asShapes.clear();
+    psList->anPartSize.clear();
+    psList->adfX.clear();
+    psList->adfY.clear();
+    psList->adfVariant.clear();
+    psList->adfBurnValue.clear();
+    psList->aanChunkShapes.clear();
+    psList->aanChunkShapes.resize( (nYSize + nYChunkSize - 1) / nYChunkSize );
+    psList->nChunkShapeCount = 0;
+}
 
-    if (poShape == NULL)
-        return;
+/************************************************************************/
+/*                    GDALRasterizeShapeListSize()                      */
+/*                                                                      */
+/*      Approximate memory used by the list, to bound the number of     */
+/*      shapes held at once.                                            */
+/************************************************************************/
 
-    sInfo.nXSize = nXSize;
-    sInfo.nYSize = nYSize;
-    sInfo.nBands = nBands;
-    sInfo.pabyChunkBuf = pabyChunkBuf;
-    sInfo.eType = eType;
-    sInfo.padfBurnValue = padfBurnValue;
-    sInfo.eBurnValueSource = eBurnValueSrc;
+static size_t GDALRasterizeShapeListSize( GDALRasterizeShapeList *psList )
+
+{
+    return psList->asShapes.size() * sizeof(GDALRasterizeShape)
+        + psList->anPartSize.size() * sizeof(int)
+        + ( psList->adfX.size() + psList->adfY.size()
+            + psList->adfVariant.size() + psList->adfBurnValue.size() )
+          * sizeof(double)
+        + psList->nChunkShapeCount * sizeof(int);
+}
+
+/************************************************************************/
+/*                       GDALRasterizeAddShape()                        */
+/*                                                                      */
+/*      Collect the rings of a geometry, transform them to pixel/line   */
+/*      coordinates and append the shape to the chunks its lines        */
+/*      overlap.  The rasterizers never burn a line more than one       */
+/*      pixel away from the Y extent of the points, the shapes are      */
+/*      binned with a margin of two lines so a chunk gets every shape   */
+/*      that could burn any pixel of it.                                */
+/************************************************************************/
+
+static void GDALRasterizeAddShape( GDALRasterizeShapeList *psList,
+                                   OGRGeometry *poShape,
+                                   const double *padfBurnValue,
+                                   GDALBurnValueSrc eBurnValueSrc,
+                                   GDALTransformerFunc pfnTransformer,
+                                   void *pTransformArg )
+
+{
+    if( poShape == NULL )
+        return;
 
 /* -------------------------------------------------------------------- */
 /*      Transform polygon geometries into a set of rings and a part     */
@@ -310,78 +388,189 @@ gv_rasterize_one_shape( unsigned char *pabyChunkBuf, int nYOff,
     GDALCollectRingsFromGeometry( poShape, aPointX, aPointY, aPointVariant,
                                     aPartSize, eBurnValueSrc );
 
+    if( aPartSize.empty() )
+        return;
+
 /* -------------------------------------------------------------------- */
 /*      Transform points if needed.                                     */
 /* -------------------------------------------------------------------- */
-    if( pfnTransformer != NULL )
+    if( pfnTransformer != NULL && !aPointX.empty() )
     {
         int *panSuccess = (int *) CPLCalloc(sizeof(int),aPointX.size());
 
         // TODO: we need to add all appropriate error checking at some point.
-        pfnTransformer( pTransformArg, FALSE, aPointX.size(), 
+        pfnTransformer( pTransformArg, FALSE, aPointX.size(),
                         &(aPointX[0]), &(aPointY[0]), NULL, panSuccess );
         CPLFree( panSuccess );
     }
 
 /* -------------------------------------------------------------------- */
-/*      Shift to account for the buffer offset of this buffer.          */
+/*      Find the chunks the shape overlaps, if the list is binned.      */
+/*      A shape with NaN coordinates goes to all of them, as it         */
+/*      always did.                                                     */
 /* -------------------------------------------------------------------- */
-    unsigned int i;
+    const int nChunkCount = (int) psList->aanChunkShapes.size();
+    int     iFirstChunk = 0, iLastChunk = nChunkCount - 1;
+    int     bHasNan = FALSE, bHasY = FALSE;
+    double  dfYMin = 0.0, dfYMax = 0.0;
+    size_t  i;
 
     for( i = 0; i < aPointY.size(); i++ )
-        aPointY[i] -= nYOff;
+    {
+        if( CPLIsNan(aPointY[i]) )
+            bHasNan = TRUE;
+        else if( !bHasY )
+        {
+            dfYMin = dfYMax = aPointY[i];
+            bHasY = TRUE;
+        }
+        else if( aPointY[i] < dfYMin )
+            dfYMin = aPointY[i];
+        else if( aPointY[i] > dfYMax )
+            dfYMax = aPointY[i];
+    }
+
+    if( nChunkCount > 0 && bHasY && !bHasNan )
+    {
+        double dfFirst = floor( (dfYMin - 2) / psList->nYChunkSize );
+        double dfLast = floor( (dfYMax + 2) / psList->nYChunkSize );
+
+        if( dfLast < 0 || dfFirst > nChunkCount - 1 )
+            return;
+
+        if( dfFirst > 0 )
+            iFirstChunk = (int) dfFirst;
+        if( dfLast < iLastChunk )
+            iLastChunk = (int) dfLast;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Append the shape.                                               */
+/* -------------------------------------------------------------------- */
+    GDALRasterizeShape sShape;
+
+    switch( wkbFlatten(poShape->getGeometryType()) )
+    {
+      case wkbPoint:
+      case wkbMultiPoint:
+        sShape.eKind = GRS_Point;
+        break;
+
+      case wkbLineString:
+      case wkbMultiLineString:
+        sShape.eKind = GRS_Line;
+        break;
+
+      default:
+        sShape.eKind = GRS_Polygon;
+        break;
+    }
+
+    sShape.nFirstPart = (int) psList->anPartSize.size();
+    sShape.nPartCount = (int) aPartSize.size();
+    sShape.nFirstPoint = (int) psList->adfX.size();
+    sShape.nPointCount = (int) aPointX.size();
+    sShape.nFirstVariant = (int) psList->adfVariant.size();
+    sShape.nVariantCount = (int) aPointVariant.size();
+    sShape.nFirstBurnValue = (int) psList->adfBurnValue.size();
+
+    psList->anPartSize.insert( psList->anPartSize.end(),
+                               aPartSize.begin(), aPartSize.end() );
+    psList->adfX.insert( psList->adfX.end(), aPointX.begin(), aPointX.end() );
+    psList->adfY.insert( psList->adfY.end(), aPointY.begin(), aPointY.end() );
+    psList->adfVariant.insert( psList->adfVariant.end(),
+                               aPointVariant.begin(), aPointVariant.end() );
+    psList->adfBurnValue.insert( psList->adfBurnValue.end(), padfBurnValue,
+                                 padfBurnValue + psList->nBands );
+
+    int iShape = (int) psList->asShapes.size();
+    int iChunk;
+
+    psList->asShapes.push_back( sShape );
+
+    for( iChunk = iFirstChunk; iChunk <= iLastChunk; iChunk++ )
+        psList->aanChunkShapes[iChunk].push_back( iShape );
+    psList->nChunkShapeCount += iLastChunk - iFirstChunk + 1;
+}
+
+/************************************************************************/
+/*                       GDALRasterizeBurnShape()                       */
+/*                                                                      */
+/*      Burn one shape of the list into a chunk buffer.  adfY and       */
+/*      adfVariant are scratch arrays of the calling thread.            */
+/************************************************************************/
+
+static void GDALRasterizeBurnShape( unsigned char *pabyChunkBuf, int nYOff,
+                                    int nXSize, int nYSize,
+                                    GDALDataType eType, int bAllTouched,
+                                    GDALRasterizeShapeList *psList,
+                                    int iShape,
+                                    GDALBurnValueSrc eBurnValueSrc,
+                                    std::vector<double> &adfY,
+                                    std::vector<double> &adfVariant )
+
+{
+    const GDALRasterizeShape *psShape = &(psList->asShapes[iShape]);
+    GDALRasterizeInfo sInfo;
+
+    sInfo.nXSize = nXSize;
+    sInfo.nYSize = nYSize;
+    sInfo.nBands = psList->nBands;
+    sInfo.pabyChunkBuf = pabyChunkBuf;
+    sInfo.eType = eType;
+    sInfo.padfBurnValue = &(psList->adfBurnValue[psShape->nFirstBurnValue]);
+    sInfo.eBurnValueSource = eBurnValueSrc;
+
+    int     *panPartSize = &(psList->anPartSize[psShape->nFirstPart]);
+    double  *padfX = NULL;
+    double  *padfVariant = NULL;
+
+    if( psShape->nPointCount > 0 )
+        padfX = &(psList->adfX[psShape->nFirstPoint]);
+    if( eBurnValueSrc != GBV_UserBurnValue && psShape->nVariantCount > 0 )
+        padfVariant = &(psList->adfVariant[psShape->nFirstVariant]);
+
+/* -------------------------------------------------------------------- */
+/*      Shift to account for the buffer offset of this buffer.          */
+/* -------------------------------------------------------------------- */
+    int     i;
+
+    adfY.resize( psShape->nPointCount + 1 );
+    for( i = 0; i < psShape->nPointCount; i++ )
+        adfY[i] = psList->adfY[psShape->nFirstPoint + i] - nYOff;
 
 /* -------------------------------------------------------------------- */
 /*      Perform the rasterization.                                      */
-/*      According to the C++ Standard/23.2.4, elements of a vector are  */
-/*      stored in continuous memory block.                              */
 /* -------------------------------------------------------------------- */
-    unsigned int j,n;
-
-    // TODO - mloskot: Check if vectors are empty, otherwise it may
-    // lead to undefined behavior by returning non-referencable pointer.
-    // if (!aPointX.empty())
-    //    /* fill polygon */
-    // else
-    //    /* How to report this problem? */    
-    switch ( wkbFlatten(poShape->getGeometryType()) )
+    switch ( psShape->eKind )
     {
-        case wkbPoint:
-        case wkbMultiPoint:
-            GDALdllImagePoint( sInfo.nXSize, nYSize, 
-                               aPartSize.size(), &(aPartSize[0]), 
-                               &(aPointX[0]), &(aPointY[0]), 
-                               (eBurnValueSrc == GBV_UserBurnValue)?
-                                   NULL : &(aPointVariant[0]),
+        case GRS_Point:
+            GDALdllImagePoint( nXSize, nYSize,
+                               psShape->nPartCount, panPartSize,
+                               padfX, &(adfY[0]), padfVariant,
                                gvBurnPoint, &sInfo );
             break;
-        case wkbLineString:
-        case wkbMultiLineString:
+
+        case GRS_Line:
         {
             if( bAllTouched )
-                GDALdllImageLineAllTouched( sInfo.nXSize, nYSize, 
-                                            aPartSize.size(), &(aPartSize[0]), 
-                                            &(aPointX[0]), &(aPointY[0]), 
-                                            (eBurnValueSrc == GBV_UserBurnValue)?
-                                                NULL : &(aPointVariant[0]),
+                GDALdllImageLineAllTouched( nXSize, nYSize,
+                                            psShape->nPartCount, panPartSize,
+                                            padfX, &(adfY[0]), padfVariant,
                                             gvBurnPoint, &sInfo );
             else
-                GDALdllImageLine( sInfo.nXSize, nYSize, 
-                                  aPartSize.size(), &(aPartSize[0]), 
-                                  &(aPointX[0]), &(aPointY[0]), 
-                                  (eBurnValueSrc == GBV_UserBurnValue)?
-                                      NULL : &(aPointVariant[0]),
+                GDALdllImageLine( nXSize, nYSize,
+                                  psShape->nPartCount, panPartSize,
+                                  padfX, &(adfY[0]), padfVariant,
                                   gvBurnPoint, &sInfo );
         }
         break;
 
         default:
         {
-            GDALdllImageFilledPolygon( sInfo.nXSize, nYSize, 
-                                       aPartSize.size(), &(aPartSize[0]), 
-                                       &(aPointX[0]), &(aPointY[0]), 
-                                       (eBurnValueSrc == GBV_UserBurnValue)?
-                                           NULL : &(aPointVariant[0]),
+            GDALdllImageFilledPolygon( nXSize, nYSize,
+                                       psShape->nPartCount, panPartSize,
+                                       padfX, &(adfY[0]), padfVariant,
                                        gvBurnScanline, &sInfo );
             if( bAllTouched )
             {
@@ -389,32 +578,268 @@ gv_rasterize_one_shape( unsigned char *pabyChunkBuf, int nYOff,
                    polygon is filled using the variant from the first point of
                    the first segment. Should be removed when the code to full
                    polygons more appropriately is added. */
-                if(eBurnValueSrc == GBV_UserBurnValue)
+                if( padfVariant != NULL )
                 {
-                GDALdllImageLineAllTouched( sInfo.nXSize, nYSize, 
-                                            aPartSize.size(), &(aPartSize[0]), 
-                                            &(aPointX[0]), &(aPointY[0]), 
-                                            NULL,
-                                            gvBurnPoint, &sInfo );
+                    adfVariant.assign( psShape->nPointCount + 1,
+                                       padfVariant[0] );
+                    padfVariant = &(adfVariant[0]);
                 }
-                else
-                {
-                for( i = 0, n = 0; i < aPartSize.size(); i++ )
-                    for( j = 0; j < aPartSize[i]; j++ )
-                        aPointVariant[n++] = aPointVariant[0];
-                   
-                GDALdllImageLineAllTouched( sInfo.nXSize, nYSize, 
-                                            aPartSize.size(), &(aPartSize[0]), 
-                                            &(aPointX[0]), &(aPointY[0]), 
-                                            &(aPointVariant[0]),
+
+                GDALdllImageLineAllTouched( nXSize, nYSize,
+                                            psShape->nPartCount, panPartSize,
+                                            padfX, &(adfY[0]), padfVariant,
                                             gvBurnPoint, &sInfo );
-                }
             }
         }
         break;
     }
 }
 
+/************************************************************************/
+/*                       gv_rasterize_one_shape()                       */
+/************************************************************************/
+static void
+gv_rasterize_one_shape( unsigned char *pabyChunkBuf, int nYOff,
+                        int nXSize, int nYSize,
+                        int nBands, GDALDataType eType, int bAllTouched,
+                        OGRGeometry *poShape, double *padfBurnValue,
+                        GDALBurnValueSrc eBurnValueSrc,
+                        GDALTransformerFunc pfnTransformer,
+                        void *pTransformArg )
+
+{
+    GDALRasterizeShapeList sList;
+    std::vector<double> adfY, adfVariant;
+
+    if (poShape == NULL)
+        return;
+
+/* -------------------------------------------------------------------- */
+/*      A list without chunks holds the shape unbinned.                 */
+/* -------------------------------------------------------------------- */
+    GDALRasterizeShapeListInit( &sList, nBands, 0, 1 );
+
+    GDALRasterizeAddShape( &sList, poShape, padfBurnValue, eBurnValueSrc,
+                           pfnTransformer, pTransformArg );
+
+    if( !sList.asShapes.empty() )
+        GDALRasterizeBurnShape( pabyChunkBuf, nYOff, nXSize, nYSize,
+                                eType, bAllTouched, &sList, 0,
+                                eBurnValueSrc, adfY, adfVariant );
+}
+
+/************************************************************************/
+/*                           GDALRasterizeJob                           */
+/************************************************************************/
+
+typedef struct {
+    GDALDataset         *poDS;
+    int                 nBandCount;
+    int                 *panBandList;
+    GDALDataType        eType;
+    int                 nScanlineBytes;
+    int                 bAllTouched;
+    GDALBurnValueSrc    eBurnValueSrc;
+    GDALRasterizeShapeList *psList;
+    int                 nThreads;
+
+    GDALProgressFunc    pfnProgress;
+    void                *pProgressArg;
+
+    int                 iFirstChunk;
+    void                *hMutex;
+    CPLErr              eErr;
+} GDALRasterizeJob;
+
+/************************************************************************/
+/*                        GDALRasterizeChunkJob()                       */
+/*                                                                      */
+/*      Read a chunk, burn the shapes overlapping it in their list      */
+/*      order and write it back.  Datasets cannot be accessed from      */
+/*      several threads at once, so the I/O is serialized, only the     */
+/*      burning runs concurrently.  Chunks no shape overlaps are left   */
+/*      alone.  Progress is reported by the calling thread.             */
+/************************************************************************/
+
+static int GDALRasterizeChunkJob( void *pUserData, int iJob )
+
+{
+    GDALRasterizeJob *psJob = (GDALRasterizeJob *) pUserData;
+    const int   iChunk = psJob->iFirstChunk + iJob;
+    GDALRasterizeShapeList *psList = psJob->psList;
+    GDALDataset *poDS = psJob->poDS;
+    const std::vector<int> &anShapes = psList->aanChunkShapes[iChunk];
+    const int   nXSize = poDS->GetRasterXSize();
+    const int   iY = iChunk * psList->nYChunkSize;
+    const int   nThisYChunkSize =
+        MIN( psList->nYChunkSize, poDS->GetRasterYSize() - iY );
+    CPLErr      eErr = CE_None;
+
+    if( !anShapes.empty() )
+    {
+        unsigned char *pabyChunkBuf = (unsigned char *)
+            VSIMalloc2( nThisYChunkSize, psJob->nScanlineBytes );
+
+        if( pabyChunkBuf == NULL )
+        {
+            CPLError( CE_Failure, CPLE_OutOfMemory,
+                      "Unable to allocate rasterization buffer." );
+            eErr = CE_Failure;
+        }
+        else
+        {
+            CPLMutexHolderD( &(psJob->hMutex) );
+
+            eErr = poDS->RasterIO( GF_Read, 0, iY, nXSize, nThisYChunkSize,
+                                   pabyChunkBuf, nXSize, nThisYChunkSize,
+                                   psJob->eType, psJob->nBandCount,
+                                   psJob->panBandList, 0, 0, 0 );
+        }
+
+        if( eErr == CE_None )
+        {
+            std::vector<double> adfY, adfVariant;
+            size_t  i;
+
+            for( i = 0; i < anShapes.size(); i++ )
+                GDALRasterizeBurnShape( pabyChunkBuf, iY,
+                                        nXSize, nThisYChunkSize,
+                                        psJob->eType, psJob->bAllTouched,
+                                        psList, anShapes[i],
+                                        psJob->eBurnValueSrc,
+                                        adfY, adfVariant );
+
+            CPLMutexHolderD( &(psJob->hMutex) );
+
+            eErr = poDS->RasterIO( GF_Write, 0, iY, nXSize, nThisYChunkSize,
+                                   pabyChunkBuf, nXSize, nThisYChunkSize,
+                                   psJob->eType, psJob->nBandCount,
+                                   psJob->panBandList, 0, 0, 0 );
+        }
+
+        VSIFree( pabyChunkBuf );
+    }
+
+    if( eErr != CE_None )
+    {
+        CPLMutexHolderD( &(psJob->hMutex) );
+
+        psJob->eErr = eErr;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                        GDALRasterizeJobInit()                        */
+/*                                                                      */
+/*      Set up the job state and its empty shape list.  The chunk       */
+/*      size does not depend on the number of threads: the all          */
+/*      touched line rasterizer clips the interpolated burn values at   */
+/*      the chunk edges, so other chunk boundaries could change the     */
+/*      result by rounding.                                             */
+/************************************************************************/
+
+static CPLErr GDALRasterizeJobInit( GDALRasterizeJob *psJob,
+                                    GDALRasterizeShapeList *psList,
+                                    GDALDataset *poDS,
+                                    int nBandCount, int *panBandList,
+                                    GDALDataType eType,
+                                    int nYChunkSize,
+                                    int bAllTouched,
+                                    GDALBurnValueSrc eBurnValueSrc,
+                                    GDALProgressFunc pfnProgress,
+                                    void *pProgressArg )
+
+{
+    const int nYSize = poDS->GetRasterYSize();
+
+    psJob->nThreads =
+        CPLParseNumThreads( CPLGetConfigOption( "GDAL_NUM_THREADS", NULL ), 1 );
+
+    if( nYChunkSize < 1 )
+        nYChunkSize = 1;
+    if( nYChunkSize > nYSize )
+        nYChunkSize = nYSize;
+
+    psJob->poDS = poDS;
+    psJob->nBandCount = nBandCount;
+    psJob->panBandList = panBandList;
+    psJob->eType = eType;
+    psJob->nScanlineBytes = nBandCount * poDS->GetRasterXSize()
+        * (GDALGetDataTypeSize(eType)/8);
+    psJob->bAllTouched = bAllTouched;
+    psJob->eBurnValueSrc = eBurnValueSrc;
+    psJob->psList = psList;
+    psJob->pfnProgress = pfnProgress;
+    psJob->pProgressArg = pProgressArg;
+    psJob->iFirstChunk = 0;
+    psJob->eErr = CE_None;
+
+    /* The list is set up first, as the caller cleans it up anyway. */
+    GDALRasterizeShapeListInit( psList, nBandCount, nYSize, nYChunkSize );
+
+    psJob->hMutex = CPLCreateMutex();
+    if( psJob->hMutex == NULL )
+        return CE_Failure;
+    CPLReleaseMutex( psJob->hMutex );
+
+    CPLDebug( "GDAL", "Rasterizing in chunks of %d lines with %d threads.",
+              nYChunkSize, psJob->nThreads );
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                        GDALRasterizeChunks()                         */
+/*                                                                      */
+/*      Burn the shapes of the list into all the chunks, reporting      */
+/*      progress from dfProgressStart to dfProgressEnd, and empty the   */
+/*      list for the next batch of shapes.  The chunks are handed to    */
+/*      the threads in batches, a few per thread to balance empty and   */
+/*      busy chunks, and progress is reported and checked for an        */
+/*      interrupt on the calling thread between two batches.            */
+/************************************************************************/
+
+#define RASTERIZE_CHUNKS_PER_THREAD 4
+
+static CPLErr GDALRasterizeChunks( GDALRasterizeJob *psJob,
+                                   double dfProgressStart,
+                                   double dfProgressEnd )
+
+{
+    GDALRasterizeShapeList *psList = psJob->psList;
+    const int   nChunks = (int) psList->aanChunkShapes.size();
+    const int   nBatch = psJob->nThreads * RASTERIZE_CHUNKS_PER_THREAD;
+    int         iChunk;
+
+    for( iChunk = 0; iChunk < nChunks && psJob->eErr == CE_None;
+         iChunk += nBatch )
+    {
+        int nJobs = MIN( nBatch, nChunks - iChunk );
+
+        psJob->iFirstChunk = iChunk;
+        CPLRunJobs( nJobs, psJob->nThreads, GDALRasterizeChunkJob, psJob );
+
+        if( psJob->eErr == CE_None
+            && !psJob->pfnProgress( dfProgressStart
+                                    + (dfProgressEnd - dfProgressStart)
+                                      * (iChunk + nJobs) / nChunks,
+                                    "", psJob->pProgressArg ) )
+        {
+            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+            psJob->eErr = CE_Failure;
+        }
+    }
+
+    GDALRasterizeShapeListInit( psList, psList->nBands,
+                                psJob->poDS->GetRasterYSize(),
+                                psList->nYChunkSize );
+
+    return psJob->eErr;
+}
+
 /************************************************************************/
 /*                      GDALRasterizeGeometries()                       */
 /************************************************************************/
@@ -436,6 +861,12 @@ gv_rasterize_one_shape( unsigned char *pabyChunkBuf, int nYOff,
  * may be improved in the future.  An explicit list of burn values for
  * each geometry for each band must be passed in. 
  *
+ * The geometries are transformed once, and each one is only burnt into
+ * the chunks of lines it overlaps.  The chunks can be burnt by several
+ * threads, as set by the GDAL_NUM_THREADS configuration option (a number
+ * or ALL_CPUS, 1 by default), each one holding a chunk buffer.  The result
+ * does not depend on the number of threads.
+ *
  * The papszOption list of options currently only supports one option. The
  * "ALL_TOUCHED" option may be enabled by setting it to "TRUE".
  *
@@ -467,6 +898,7 @@ gv_rasterize_one_shape( unsigned char *pabyChunkBuf, int nYOff,
  * @return CE_None on success or CE_Failure on error.
  */
 
+
 CPLErr GDALRasterizeGeometries( GDALDatasetH hDS, 
                                 int nBandCount, int *panBandList,
                                 int nGeomCount, OGRGeometryH *pahGeometries,
@@ -480,8 +912,7 @@ CPLErr GDALRasterizeGeometries( GDALDatasetH hDS,
 {
     GDALDataType   eType;
     int            nYChunkSize, nScanlineBytes;
-    unsigned char *pabyChunkBuf;
-    int            iY;
+    int            iShape;
     GDALDataset *poDS = (GDALDataset *) hDS;
 
     if( pfnProgress == NULL )
@@ -530,9 +961,9 @@ CPLErr GDALRasterizeGeometries( GDALDatasetH hDS,
     }
 
 /* -------------------------------------------------------------------- */
-/*      Establish a chunksize to operate on.  The larger the chunk      */
-/*      size the less times we need to make a pass through all the      */
-/*      shapes.                                                         */
+/*      Establish a chunksize to operate on.  The geometries are        */
+/*      transformed once and only burnt into the chunks they            */
+/*      overlap, so the chunk size just bounds the buffer memory.       */
 /* -------------------------------------------------------------------- */
     if( poBand->GetRasterDataType() == GDT_Byte )
         eType = GDT_Byte;
@@ -542,74 +973,46 @@ CPLErr GDALRasterizeGeometries( GDALDatasetH hDS,
     nScanlineBytes = nBandCount * poDS->GetRasterXSize()
         * (GDALGetDataTypeSize(eType)/8);
     nYChunkSize = 10000000 / nScanlineBytes;
-    if( nYChunkSize > poDS->GetRasterYSize() )
-        nYChunkSize = poDS->GetRasterYSize();
 
-    pabyChunkBuf = (unsigned char *) VSIMalloc(nYChunkSize * nScanlineBytes);
-    if( pabyChunkBuf == NULL )
-    {
-        CPLError( CE_Failure, CPLE_OutOfMemory, 
-                  "Unable to allocate rasterization buffer." );
-        return CE_Failure;
-    }
+    GDALRasterizeShapeList sList;
+    GDALRasterizeJob sJob;
+    CPLErr  eErr;
+
+    eErr = GDALRasterizeJobInit( &sJob, &sList, poDS, nBandCount, panBandList,
+                                 eType, nYChunkSize, bAllTouched,
+                                 eBurnValueSource, pfnProgress, pProgressArg );
 
 /* ==================================================================== */
-/*      Loop over image in designated chunks.                           */
+/*      Collect the geometries, and burn them into the chunks every     */
+/*      time the collected shapes exceed the cache size.                */
 /* ==================================================================== */
-    CPLErr  eErr = CE_None;
+    const size_t nMaxListSize = GDALGetCacheMax();
+    int     iFirstShape = 0;
 
     pfnProgress( 0.0, NULL, pProgressArg );
 
-    for( iY = 0; 
-         iY < poDS->GetRasterYSize() && eErr == CE_None; 
-         iY += nYChunkSize )
+    for( iShape = 0; iShape < nGeomCount && eErr == CE_None; iShape++ )
     {
-        int	nThisYChunkSize;
-        int     iShape;
-
-        nThisYChunkSize = nYChunkSize;
-        if( nThisYChunkSize + iY > poDS->GetRasterYSize() )
-            nThisYChunkSize = poDS->GetRasterYSize() - iY;
-
-        eErr = 
-            poDS->RasterIO(GF_Read, 
-                           0, iY, poDS->GetRasterXSize(), nThisYChunkSize, 
-                           pabyChunkBuf,poDS->GetRasterXSize(),nThisYChunkSize,
-                           eType, nBandCount, panBandList,
-                           0, 0, 0 );
-        if( eErr != CE_None )
-            break;
+        GDALRasterizeAddShape( &sList, (OGRGeometry *) pahGeometries[iShape],
+                               padfGeomBurnValue + iShape*nBandCount,
+                               eBurnValueSource,
+                               pfnTransformer, pTransformArg );
 
-        for( iShape = 0; iShape < nGeomCount; iShape++ )
+        if( iShape == nGeomCount - 1
+            || GDALRasterizeShapeListSize( &sList ) > nMaxListSize )
         {
-            gv_rasterize_one_shape( pabyChunkBuf, iY,
-                                    poDS->GetRasterXSize(), nThisYChunkSize,
-                                    nBandCount, eType, bAllTouched,
-                                    (OGRGeometry *) pahGeometries[iShape],
-                                    padfGeomBurnValue + iShape*nBandCount,
-                                    eBurnValueSource,
-                                    pfnTransformer, pTransformArg );
-        }
-
-        eErr = 
-            poDS->RasterIO( GF_Write, 0, iY,
-                            poDS->GetRasterXSize(), nThisYChunkSize, 
-                            pabyChunkBuf,
-                            poDS->GetRasterXSize(), nThisYChunkSize, 
-                            eType, nBandCount, panBandList, 0, 0, 0 );
-
-        if( !pfnProgress((iY+nThisYChunkSize)/((double)poDS->GetRasterYSize()),
-                         "", pProgressArg ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
+            eErr = GDALRasterizeChunks( &sJob,
+                                        iFirstShape / (double) nGeomCount,
+                                        (iShape + 1) / (double) nGeomCount );
+            iFirstShape = iShape + 1;
         }
     }
     
 /* -------------------------------------------------------------------- */
 /*      cleanup                                                         */
 /* -------------------------------------------------------------------- */
-    VSIFree( pabyChunkBuf );
+    if( sJob.hMutex != NULL )
+        CPLDestroyMutex( sJob.hMutex );
     
     if( bNeedToFreeTransformer )
         GDALDestroyTransformer( pTransformArg );
@@ -617,6 +1020,7 @@ CPLErr GDALRasterizeGeometries( GDALDatasetH hDS,
     return eErr;
 }
 
+
 /************************************************************************/
 /*                        GDALRasterizeLayers()                         */
 /************************************************************************/
@@ -638,6 +1042,12 @@ CPLErr GDALRasterizeGeometries( GDALDatasetH hDS,
  * may be improved in the future.  An explicit list of burn values for
  * each layer for each band must be passed in. 
  *
+ * The features are read and transformed once, and each one is only burnt
+ * into the chunks of lines it overlaps.  The chunks can be burnt by several
+ * threads, as set by the GDAL_NUM_THREADS configuration option (a number
+ * or ALL_CPUS, 1 by default), each one holding a chunk buffer.  The result
+ * does not depend on the number of threads.
+ *
  * @param hDS output data, must be opened in update mode.
  * @param nBandCount the number of bands to be updated.
  * @param panBandList the list of bands to be updated. 
@@ -656,11 +1066,11 @@ CPLErr GDALRasterizeGeometries( GDALDatasetH hDS,
  * bands. If specified, padfLayerBurnValues will not be used and can be a NULL
  * pointer.</dd>
  * <dt>"CHUNKYSIZE":</dt> <dd>The height in lines of the chunk to operate on.
- * The larger the chunk size the less times we need to make a pass through all
- * the shapes. If it is not set or set to zero the default chunk size will be
- * used. Default size will be estimated based on the GDAL cache buffer size
- * using formula: cache_size_bytes/scanline_size_bytes, so the chunk will
- * not exceed the cache.</dd>
+ * Each thread burns one chunk at a time in its own buffer. If it is not set
+ * or set to zero the default chunk size will be used. Default size will be
+ * estimated based on the GDAL cache buffer size using formula:
+ * cache_size_bytes/scanline_size_bytes, so the chunk will not exceed the
+ * cache.</dd>
  * <dt>"ALL_TOUCHED":</dt> <dd>May be set to TRUE to set all pixels touched 
  * by the line or polygons, not just those whose center is within the polygon
  * or that are selected by brezenhams line algorithm.  Defaults to FALSE.</dd>
@@ -690,7 +1100,6 @@ CPLErr GDALRasterizeLayers( GDALDatasetH hDS,
 
 {
     GDALDataType   eType;
-    unsigned char *pabyChunkBuf;
     GDALDataset *poDS = (GDALDataset *) hDS;
 
     if( pfnProgress == NULL )
@@ -719,9 +1128,9 @@ CPLErr GDALRasterizeLayers( GDALDatasetH hDS,
     }
 
 /* -------------------------------------------------------------------- */
-/*      Establish a chunksize to operate on.  The larger the chunk      */
-/*      size the less times we need to make a pass through all the      */
-/*      shapes.                                                         */
+/*      Establish a chunksize to operate on.  The features are read     */
+/*      once and only burnt into the chunks they overlap, so the        */
+/*      chunk size just bounds the buffer memory.                       */
 /* -------------------------------------------------------------------- */
     int         nYChunkSize, nScanlineBytes;
     const char  *pszYChunkSize =
@@ -740,50 +1149,50 @@ CPLErr GDALRasterizeLayers( GDALDatasetH hDS,
     else
         nYChunkSize = GDALGetCacheMax() / nScanlineBytes;
 
-    if( nYChunkSize < 1 )
-        nYChunkSize = 1;
-    if( nYChunkSize > poDS->GetRasterYSize() )
-        nYChunkSize = poDS->GetRasterYSize();
+    GDALRasterizeShapeList sList;
+    GDALRasterizeJob sJob;
+    CPLErr      eErr;
 
-    pabyChunkBuf = (unsigned char *) VSIMalloc(nYChunkSize * nScanlineBytes);
-    if( pabyChunkBuf == NULL )
-    {
-        CPLError( CE_Failure, CPLE_OutOfMemory, 
-                  "Unable to allocate rasterization buffer." );
-        return CE_Failure;
-    }
+    eErr = GDALRasterizeJobInit( &sJob, &sList, poDS, nBandCount, panBandList,
+                                 eType, nYChunkSize, bAllTouched,
+                                 eBurnValueSource, pfnProgress, pProgressArg );
 
 /* -------------------------------------------------------------------- */
-/*      Read the image once for all layers if user requested to render  */
-/*      the whole raster in single chunk.                               */
+/*      Progress is reported as the share of the features burnt, if     */
+/*      the layers know their feature count cheaply.                    */
 /* -------------------------------------------------------------------- */
-    if ( nYChunkSize == poDS->GetRasterYSize() )
+    int         iLayer;
+    double      dfFeatureCount = 0.0;
+
+    for( iLayer = 0; iLayer < nLayerCount && dfFeatureCount >= 0; iLayer++ )
     {
-        if ( poDS->RasterIO( GF_Read, 0, 0, poDS->GetRasterXSize(),
-                             nYChunkSize, pabyChunkBuf,
-                             poDS->GetRasterXSize(), nYChunkSize,
-                             eType, nBandCount, panBandList, 0, 0, 0 )
-             != CE_None )
+        OGRLayer    *poLayer = (OGRLayer *) pahLayers[iLayer];
+
+        if ( poLayer )
         {
-            CPLError( CE_Failure, CPLE_OutOfMemory, 
-                      "Unable to read buffer." );
-            CPLFree( pabyChunkBuf );
-            return CE_Failure;
+            int nLayerFeatureCount = poLayer->GetFeatureCount(FALSE);
+
+            if( nLayerFeatureCount < 0 )
+                dfFeatureCount = -1.0;
+            else
+                dfFeatureCount += nLayerFeatureCount;
         }
     }
 
 /* ==================================================================== */
-/*      Read the specified layers transfoming and rasterizing           */
-/*      geometries.                                                     */
+/*      Read the specified layers transfoming and collecting            */
+/*      geometries, and burn them into the chunks every time the        */
+/*      collected shapes exceed the cache size.                         */
 /* ==================================================================== */
-    CPLErr      eErr = CE_None;
-    int         iLayer;
+    const size_t nMaxListSize = GDALGetCacheMax();
     const char  *pszBurnAttribute =
         CSLFetchNameValue( papszOptions, "ATTRIBUTE" );
+    std::vector<double> adfAttrValues( nBandCount );
+    double      dfFeaturesRead = 0.0, dfFeaturesBurnt = 0.0;
 
     pfnProgress( 0.0, NULL, pProgressArg );
 
-    for( iLayer = 0; iLayer < nLayerCount; iLayer++ )
+    for( iLayer = 0; iLayer < nLayerCount && eErr == CE_None; iLayer++ )
     {
         int         iBurnField = -1;
         double      *padfBurnValues = NULL;
@@ -855,82 +1264,46 @@ CPLErr GDALRasterizeLayers( GDALDatasetH hDS,
 
         poLayer->ResetReading();
 
-/* -------------------------------------------------------------------- */
-/*      Loop over image in designated chunks.                           */
-/* -------------------------------------------------------------------- */
-        int     iY;
-        for( iY = 0; 
-             iY < poDS->GetRasterYSize() && eErr == CE_None; 
-             iY += nYChunkSize )
+        while( eErr == CE_None
+               && (poFeat = poLayer->GetNextFeature()) != NULL )
         {
-            int	nThisYChunkSize;
-
-            nThisYChunkSize = nYChunkSize;
-            if( nThisYChunkSize + iY > poDS->GetRasterYSize() )
-                nThisYChunkSize = poDS->GetRasterYSize() - iY;
-
-            // Only re-read image if not a single chunk is being rendered
-            if ( nYChunkSize < poDS->GetRasterYSize() )
-            {
-                eErr = 
-                    poDS->RasterIO( GF_Read, 0, iY,
-                                    poDS->GetRasterXSize(), nThisYChunkSize, 
-                                    pabyChunkBuf,
-                                    poDS->GetRasterXSize(), nThisYChunkSize,
-                                    eType, nBandCount, panBandList, 0, 0, 0 );
-                if( eErr != CE_None )
-                    break;
-            }
+            OGRGeometry *poGeom = poFeat->GetGeometryRef();
 
-            double *padfAttrValues = (double *) VSIMalloc(sizeof(double) * nBandCount);
-            while( (poFeat = poLayer->GetNextFeature()) != NULL )
+            if ( pszBurnAttribute )
             {
-                OGRGeometry *poGeom = poFeat->GetGeometryRef();
-
-                if ( pszBurnAttribute )
-                {
-                    int         iBand;
-                    double      dfAttrValue;
+                int         iBand;
+                double      dfAttrValue;
 
-                    dfAttrValue = poFeat->GetFieldAsDouble( iBurnField );
-                    for (iBand = 0 ; iBand < nBandCount ; iBand++)
-                        padfAttrValues[iBand] = dfAttrValue;
+                dfAttrValue = poFeat->GetFieldAsDouble( iBurnField );
+                for (iBand = 0 ; iBand < nBandCount ; iBand++)
+                    adfAttrValues[iBand] = dfAttrValue;
 
-                    padfBurnValues = padfAttrValues;
-                }
-                
-                gv_rasterize_one_shape( pabyChunkBuf, iY,
-                                        poDS->GetRasterXSize(),
-                                        nThisYChunkSize,
-                                        nBandCount, eType, bAllTouched, poGeom,
-                                        padfBurnValues, eBurnValueSource,
-                                        pfnTransformer, pTransformArg );
-
-                delete poFeat;
+                padfBurnValues = &(adfAttrValues[0]);
             }
-            VSIFree( padfAttrValues );
 
-            // Only write image if not a single chunk is being rendered
-            if ( nYChunkSize < poDS->GetRasterYSize() )
-            {
-                eErr = 
-                    poDS->RasterIO( GF_Write, 0, iY,
-                                    poDS->GetRasterXSize(), nThisYChunkSize, 
-                                    pabyChunkBuf,
-                                    poDS->GetRasterXSize(), nThisYChunkSize, 
-                                    eType, nBandCount, panBandList, 0, 0, 0 );
-            }
+            GDALRasterizeAddShape( &sList, poGeom, padfBurnValues,
+                                   eBurnValueSource,
+                                   pfnTransformer, pTransformArg );
 
-            poLayer->ResetReading();
+            delete poFeat;
+            dfFeaturesRead++;
 
-            if( !pfnProgress((iY+nThisYChunkSize)/((double)poDS->GetRasterYSize()),
-                             "", pProgressArg) )
+            if( GDALRasterizeShapeListSize( &sList ) > nMaxListSize )
             {
-                CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-                eErr = CE_Failure;
+                double dfStart = 0.0, dfEnd = 1.0;
+
+                if( dfFeatureCount > 0 )
+                {
+                    dfStart = dfFeaturesBurnt / dfFeatureCount;
+                    dfEnd = MIN( 1.0, dfFeaturesRead / dfFeatureCount );
+                }
+                eErr = GDALRasterizeChunks( &sJob, dfStart, dfEnd );
+                dfFeaturesBurnt = dfFeaturesRead;
             }
         }
 
+        poLayer->ResetReading();
+
         if ( bNeedToFreeTransformer )
         {
             GDALDestroyTransformer( pTransformArg );
@@ -938,24 +1311,24 @@ CPLErr GDALRasterizeLayers( GDALDatasetH hDS,
             pfnTransformer = NULL;
         }
     }
-    
+
 /* -------------------------------------------------------------------- */
-/*      Write out the image once for all layers if user requested       */
-/*      to render the whole raster in single chunk.                     */
+/*      Burn the remaining shapes.                                      */
 /* -------------------------------------------------------------------- */
-    if ( nYChunkSize == poDS->GetRasterYSize() )
+    if( eErr == CE_None )
     {
-        poDS->RasterIO( GF_Write, 0, 0,
-                                poDS->GetRasterXSize(), nYChunkSize, 
-                                pabyChunkBuf,
-                                poDS->GetRasterXSize(), nYChunkSize, 
-                                eType, nBandCount, panBandList, 0, 0, 0 );
+        double dfStart = 0.0;
+
+        if( dfFeatureCount > 0 )
+            dfStart = MIN( 1.0, dfFeaturesBurnt / dfFeatureCount );
+        eErr = GDALRasterizeChunks( &sJob, dfStart, 1.0 );
     }
 
 /* -------------------------------------------------------------------- */
 /*      cleanup                                                         */
 /* -------------------------------------------------------------------- */
-    VSIFree( pabyChunkBuf );
+    if( sJob.hMutex != NULL )
+        CPLDestroyMutex( sJob.hMutex );
     
     return eErr;
 }
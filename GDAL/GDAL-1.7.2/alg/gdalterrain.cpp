@@ -0,0 +1,680 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL
+ * Purpose:  Terrain analysis on a 3x3 window: hillshade, slope, aspect,
+ *           TRI, TPI and roughness, as used by gdaldem.
+ * Authors:  Matthew Perry, perrygeo at gmail.com
+ *           Even Rouault, even dot rouault at mines dash paris dot org
+ *           Howard Butler, hobu.inc at gmail.com
+ *           Chris Yesson, chris dot yesson at ioz dot ac dot uk
+ *
+ ******************************************************************************
+ * Copyright (c) 2006, 2009 Matthew Perry
+ * Copyright (c) 2009 Even Rouault
+ * Portions derived from GRASS 4.1 (public domain) See
+ * http://trac.osgeo.org/gdal/ticket/2975 for more information regarding
+ * history of this code
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************
+ *
+ * See apps/gdaldem.cpp for the origin of the slope, aspect and shaded
+ * relief formulas (GRASS GIS 4.1, Horn 1981), and for the references of
+ * TRI, TPI and roughness (Wilson et al. 2007).
+ ****************************************************************************/
+
+#include "gdal_alg.h"
+#include "cpl_conv.h"
+#include "cpl_worker_thread_pool.h"
+
+CPL_CVSID("$Id$");
+
+#ifndef M_PI
+# define M_PI  3.1415926535897932384626433832795
+#endif
+
+/************************************************************************/
+/*                          GDALTerrainContext                          */
+/************************************************************************/
+
+struct GDALTerrainContext
+{
+    GDALTerrainAlgorithm    eAlgorithm;
+
+    // Hillshade and slope.
+    double                  nsres;
+    double                  ewres;
+    double                  sin_altRadians;
+    double                  cos_altRadians_mul_z_scale_factor;
+    double                  azRadians;
+    double                  square_z_scale_factor;
+    double                  scale;
+    int                     bSlopeInPercent;
+
+    // Aspect.
+    int                     bAngleAsAzimuth;
+
+    int                     bSrcHasNoData;
+    double                  dfSrcNoDataValue;
+    float                   fDstNoDataValue;
+
+    int                     nThreads;
+};
+
+/************************************************************************/
+/* ==================================================================== */
+/*      Line kernels.                                                   */
+/*                                                                      */
+/*      Each kernel computes the columns 1 to nXSize-2 of an output     */
+/*      line from the three source lines centered on it.  The window    */
+/*      of a column is                                                  */
+/*                                                                      */
+/*          p0[j-1] p0[j] p0[j+1]         0 1 2                         */
+/*          p1[j-1] p1[j] p1[j+1]   (as   3 4 5   in gdaldem)           */
+/*          p2[j-1] p2[j] p2[j+1]         6 7 8                         */
+/*                                                                      */
+/*      The expressions are those of the former per pixel functions     */
+/*      of gdaldem, operation for operation and with the same float     */
+/*      and double types, so that the results are bit identical.        */
+/*      There is no call and no branch on nodata in the loops, nodata   */
+/*      windows are overwritten afterwards.                             */
+/* ==================================================================== */
+/************************************************************************/
+
+/* Unoptimized formulas are :
+    x = psData->z*((afWin[0] + afWin[3] + afWin[3] + afWin[6]) -
+        (afWin[2] + afWin[5] + afWin[5] + afWin[8])) /
+        (8.0 * psData->ewres * psData->scale);
+
+    y = psData->z*((afWin[6] + afWin[7] + afWin[7] + afWin[8]) -
+        (afWin[0] + afWin[1] + afWin[1] + afWin[2])) /
+        (8.0 * psData->nsres * psData->scale);
+
+    slope = M_PI / 2 - atan(sqrt(x*x + y*y));
+
+    aspect = atan2(x,y);
+
+    cang = sin(alt * degreesToRadians) * sin(slope) +
+           cos(alt * degreesToRadians) * cos(slope) *
+           cos(az * degreesToRadians - M_PI/2 - aspect);
+*/
+
+static void GDALHillshadeLine( const GDALTerrainContext *psContext,
+                               const float *p0, const float *p1,
+                               const float *p2, float *pafOut, int nXSize )
+{
+    const double ewres = psContext->ewres;
+    const double nsres = psContext->nsres;
+    const double sin_altRadians = psContext->sin_altRadians;
+    const double cos_altRadians_mul_z_scale_factor =
+        psContext->cos_altRadians_mul_z_scale_factor;
+    const double azRadians = psContext->azRadians;
+    const double square_z_scale_factor = psContext->square_z_scale_factor;
+
+    for( int j = 1; j < nXSize - 1; j++ )
+    {
+        double x, y, aspect, xx_plus_yy, cang;
+
+        // First Slope ...
+        x = ((p0[j-1] + p1[j-1] + p1[j-1] + p2[j-1]) -
+            (p0[j+1] + p1[j+1] + p1[j+1] + p2[j+1])) / ewres;
+
+        y = ((p2[j-1] + p2[j] + p2[j] + p2[j+1]) -
+            (p0[j-1] + p0[j] + p0[j] + p0[j+1])) / nsres;
+
+        xx_plus_yy = x * x + y * y;
+
+        // ... then aspect...
+        aspect = atan2(x,y);
+
+        // ... then the shade value
+        cang = (sin_altRadians -
+               cos_altRadians_mul_z_scale_factor * sqrt(xx_plus_yy) *
+               sin(aspect - azRadians)) /
+               sqrt(1 + square_z_scale_factor * xx_plus_yy);
+
+        if (cang <= 0.0)
+            cang = 1.0;
+        else
+            cang = 1.0 + (254.0 * cang);
+
+        pafOut[j] = (float) cang;
+    }
+}
+
+static void GDALSlopeLine( const GDALTerrainContext *psContext,
+                           const float *p0, const float *p1,
+                           const float *p2, float *pafOut, int nXSize )
+{
+    const double radiansToDegrees = 180.0 / M_PI;
+    const double ewres = psContext->ewres;
+    const double nsres = psContext->nsres;
+    const double scale = psContext->scale;
+    const int bSlopeInPercent = psContext->bSlopeInPercent;
+
+    for( int j = 1; j < nXSize - 1; j++ )
+    {
+        double dx, dy, key;
+
+        dx = ((p0[j-1] + p1[j-1] + p1[j-1] + p2[j-1]) -
+              (p0[j+1] + p1[j+1] + p1[j+1] + p2[j+1]))/ewres;
+
+        dy = ((p2[j-1] + p2[j] + p2[j] + p2[j+1]) -
+              (p0[j-1] + p0[j] + p0[j] + p0[j+1]))/nsres;
+
+        key = (dx * dx + dy * dy);
+
+        if (!bSlopeInPercent)
+            pafOut[j] = atan(sqrt(key) / (8*scale)) * radiansToDegrees;
+        else
+            pafOut[j] = 100*(sqrt(key) / (8*scale));
+    }
+}
+
+static void GDALAspectLine( const GDALTerrainContext *psContext,
+                            const float *p0, const float *p1,
+                            const float *p2, float *pafOut, int nXSize )
+{
+    const double degreesToRadians = M_PI / 180.0;
+    const int bAngleAsAzimuth = psContext->bAngleAsAzimuth;
+    const float fDstNoDataValue = psContext->fDstNoDataValue;
+
+    for( int j = 1; j < nXSize - 1; j++ )
+    {
+        double dx, dy;
+        float aspect;
+
+        dx = ((p0[j+1] + p1[j+1] + p1[j+1] + p2[j+1]) -
+              (p0[j-1] + p1[j-1] + p1[j-1] + p2[j-1]));
+
+        dy = ((p2[j-1] + p2[j] + p2[j] + p2[j+1]) -
+              (p0[j-1] + p0[j] + p0[j] + p0[j+1]));
+
+        aspect = atan2(dy,-dx) / degreesToRadians;
+
+        if (dx == 0 && dy == 0)
+        {
+            /* Flat area */
+            aspect = fDstNoDataValue;
+        }
+        else if ( bAngleAsAzimuth )
+        {
+            if (aspect > 90.0)
+                aspect = 450.0 - aspect;
+            else
+                aspect = 90.0 - aspect;
+        }
+        else
+        {
+            if (aspect < 0)
+                aspect += 360.0;
+        }
+
+        if (aspect == 360.0)
+            aspect = 0.0;
+
+        pafOut[j] = aspect;
+    }
+}
+
+static void GDALTRILine( const GDALTerrainContext *psContext,
+                         const float *p0, const float *p1,
+                         const float *p2, float *pafOut, int nXSize )
+{
+    for( int j = 1; j < nXSize - 1; j++ )
+    {
+        const float c = p1[j];
+
+        // Terrain Ruggedness is average difference in height
+        pafOut[j] = (fabs(p0[j-1]-c) +
+                     fabs(p0[j]-c) +
+                     fabs(p0[j+1]-c) +
+                     fabs(p1[j-1]-c) +
+                     fabs(p1[j+1]-c) +
+                     fabs(p2[j-1]-c) +
+                     fabs(p2[j]-c) +
+                     fabs(p2[j+1]-c))/8;
+    }
+}
+
+static void GDALTPILine( const GDALTerrainContext *psContext,
+                         const float *p0, const float *p1,
+                         const float *p2, float *pafOut, int nXSize )
+{
+    for( int j = 1; j < nXSize - 1; j++ )
+    {
+        // Terrain Position is the difference between
+        // The central cell and the mean of the surrounding cells
+        pafOut[j] = p1[j] -
+                ((p0[j-1]+
+                  p0[j]+
+                  p0[j+1]+
+                  p1[j-1]+
+                  p1[j+1]+
+                  p2[j-1]+
+                  p2[j]+
+                  p2[j+1])/8);
+    }
+}
+
+static void GDALRoughnessLine( const GDALTerrainContext *psContext,
+                               const float *p0, const float *p1,
+                               const float *p2, float *pafOut, int nXSize )
+{
+    for( int j = 1; j < nXSize - 1; j++ )
+    {
+        // Roughness is the largest difference
+        //  between any two cells.  Same comparisons, in the same order,
+        //  as the original loop over the window.
+        const float afWin[9] = { p0[j-1], p0[j], p0[j+1],
+                                 p1[j-1], p1[j], p1[j+1],
+                                 p2[j-1], p2[j], p2[j+1] };
+        float fMin = afWin[0];
+        float fMax = afWin[0];
+
+        for( int k = 1; k < 9; k++ )
+        {
+            fMax = (afWin[k] > fMax) ? afWin[k] : fMax;
+            fMin = (afWin[k] < fMin) ? afWin[k] : fMin;
+        }
+
+        pafOut[j] = fMax - fMin;
+    }
+}
+
+/************************************************************************/
+/*                        GDALTerrainNoDataLine()                       */
+/*                                                                      */
+/*      Set the output of the windows containing a source nodata        */
+/*      value, and of the first and last columns, to the destination    */
+/*      nodata value.                                                   */
+/************************************************************************/
+
+static void GDALTerrainNoDataLine( const GDALTerrainContext *psContext,
+                                   const float *p0, const float *p1,
+                                   const float *p2, float *pafOut,
+                                   int nXSize )
+{
+    const float fDstNoDataValue = psContext->fDstNoDataValue;
+
+    if( psContext->bSrcHasNoData )
+    {
+        const double dfNoData = psContext->dfSrcNoDataValue;
+        int bPrevCol, bCol, bNextCol;
+
+        bCol = p0[0] == dfNoData || p1[0] == dfNoData || p2[0] == dfNoData;
+        bNextCol = nXSize > 1
+            && (p0[1] == dfNoData || p1[1] == dfNoData || p2[1] == dfNoData);
+
+        for( int j = 1; j < nXSize - 1; j++ )
+        {
+            bPrevCol = bCol;
+            bCol = bNextCol;
+            bNextCol = p0[j+1] == dfNoData || p1[j+1] == dfNoData
+                || p2[j+1] == dfNoData;
+
+            if( bPrevCol || bCol || bNextCol )
+                pafOut[j] = fDstNoDataValue;
+        }
+    }
+
+    // Exclude the edges
+    pafOut[0] = fDstNoDataValue;
+    if( nXSize > 1 )
+        pafOut[nXSize - 1] = fDstNoDataValue;
+}
+
+/************************************************************************/
+/*                      GDALTerrainContextCreate()                      */
+/************************************************************************/
+
+/**
+ * Prepare a terrain analysis.
+ *
+ * The algorithms compute each output pixel from the 3x3 window of the
+ * elevation raster centered on it.  Windows containing the source nodata
+ * value, and the pixels of the first and last columns and lines, are set
+ * to the destination nodata value.
+ *
+ * Lines are computed by the number of threads given by the
+ * GDAL_NUM_THREADS configuration option, a number or ALL_CPUS, which
+ * defaults to 1.  The result does not depend on the number of threads.
+ *
+ * @param eAlgorithm the terrain analysis algorithm.
+ * @param psOptions the algorithm options, which are copied in the context.
+ * @param bSrcHasNoData whether dfSrcNoDataValue is to be used.
+ * @param dfSrcNoDataValue the nodata value of the elevation raster.
+ * @param dfDstNoDataValue the value of the output pixels that cannot be
+ * computed.  It is also the aspect of flat areas.
+ *
+ * @return the context or NULL if something goes wrong.
+ */
+
+GDALTerrainContext *
+GDALTerrainContextCreate( GDALTerrainAlgorithm eAlgorithm,
+                          const GDALTerrainOptions *psOptions,
+                          int bSrcHasNoData, double dfSrcNoDataValue,
+                          double dfDstNoDataValue )
+{
+    CPLAssert( psOptions );
+
+    if( eAlgorithm < GTA_Hillshade || eAlgorithm > GTA_Roughness )
+    {
+        CPLError( CE_Failure, CPLE_IllegalArg,
+                  "GDAL does not support terrain algorithm number %d.",
+                  eAlgorithm );
+        return NULL;
+    }
+
+    GDALTerrainContext *psContext =
+        (GDALTerrainContext *)CPLCalloc( 1, sizeof(GDALTerrainContext) );
+    const double degreesToRadians = M_PI / 180.0;
+
+    psContext->eAlgorithm = eAlgorithm;
+
+    psContext->nsres = psOptions->adfGeoTransform[5];
+    psContext->ewres = psOptions->adfGeoTransform[1];
+    psContext->sin_altRadians = sin(psOptions->dfAltitude * degreesToRadians);
+    psContext->azRadians = psOptions->dfAzimuth * degreesToRadians;
+    double z_scale_factor = psOptions->dfZFactor / (8 * psOptions->dfScale);
+    psContext->cos_altRadians_mul_z_scale_factor =
+        cos(psOptions->dfAltitude * degreesToRadians) * z_scale_factor;
+    psContext->square_z_scale_factor = z_scale_factor * z_scale_factor;
+    psContext->scale = psOptions->dfScale;
+    psContext->bSlopeInPercent = psOptions->bSlopeInPercent;
+
+    psContext->bAngleAsAzimuth = psOptions->bAngleAsAzimuth;
+
+    psContext->bSrcHasNoData = bSrcHasNoData;
+    psContext->dfSrcNoDataValue = dfSrcNoDataValue;
+    psContext->fDstNoDataValue = (float) dfDstNoDataValue;
+
+    psContext->nThreads =
+        CPLParseNumThreads( CPLGetConfigOption( "GDAL_NUM_THREADS", NULL ), 1 );
+
+    return psContext;
+}
+
+/************************************************************************/
+/*                       GDALTerrainContextFree()                       */
+/************************************************************************/
+
+/**
+ * Free a context created by GDALTerrainContextCreate().
+ *
+ * @param psContext the context.
+ */
+
+void GDALTerrainContextFree( GDALTerrainContext *psContext )
+{
+    CPLFree( psContext );
+}
+
+/************************************************************************/
+/*                            GDALTerrainJob                            */
+/************************************************************************/
+
+typedef struct
+{
+    GDALTerrainContext  *psContext;
+    int                 nXSize;
+    int                 nLines;
+    int                 nLinesPerJob;
+    const float         *pafSrc;
+    float               *pafDst;
+} GDALTerrainJob;
+
+static int GDALTerrainProcessJob( void *pData, int iJob )
+{
+    GDALTerrainJob *psJob = (GDALTerrainJob *) pData;
+    const GDALTerrainContext *psContext = psJob->psContext;
+    const int nXSize = psJob->nXSize;
+    int iLine = iJob * psJob->nLinesPerJob;
+    int nEndLine = MIN(iLine + psJob->nLinesPerJob, psJob->nLines);
+
+    for( ; iLine < nEndLine; iLine++ )
+    {
+        const float *p0 = psJob->pafSrc + (size_t) iLine * nXSize;
+        const float *p1 = p0 + nXSize;
+        const float *p2 = p1 + nXSize;
+        float *pafOut = psJob->pafDst + (size_t) iLine * nXSize;
+
+        switch( psContext->eAlgorithm )
+        {
+          case GTA_Hillshade:
+            GDALHillshadeLine( psContext, p0, p1, p2, pafOut, nXSize );
+            break;
+          case GTA_Slope:
+            GDALSlopeLine( psContext, p0, p1, p2, pafOut, nXSize );
+            break;
+          case GTA_Aspect:
+            GDALAspectLine( psContext, p0, p1, p2, pafOut, nXSize );
+            break;
+          case GTA_TRI:
+            GDALTRILine( psContext, p0, p1, p2, pafOut, nXSize );
+            break;
+          case GTA_TPI:
+            GDALTPILine( psContext, p0, p1, p2, pafOut, nXSize );
+            break;
+          case GTA_Roughness:
+            GDALRoughnessLine( psContext, p0, p1, p2, pafOut, nXSize );
+            break;
+        }
+
+        GDALTerrainNoDataLine( psContext, p0, p1, p2, pafOut, nXSize );
+    }
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                     GDALTerrainContextProcess()                      */
+/************************************************************************/
+
+/**
+ * Compute a strip of lines.
+ *
+ * @param psContext the context created by GDALTerrainContextCreate().
+ * @param nXSize the width of the lines.
+ * @param nLines the number of output lines.
+ * @param pafSrc the nLines + 2 source lines, from the line above the first
+ * output line to the line below the last one.
+ * @param pafDst the nLines output lines.
+ */
+
+void GDALTerrainContextProcess( GDALTerrainContext *psContext,
+                                int nXSize, int nLines,
+                                const float *pafSrc, float *pafDst )
+{
+    GDALTerrainJob sJob;
+
+    if( nXSize < 1 || nLines < 1 )
+        return;
+
+    sJob.psContext = psContext;
+    sJob.nXSize = nXSize;
+    sJob.nLines = nLines;
+    sJob.pafSrc = pafSrc;
+    sJob.pafDst = pafDst;
+
+    // A few jobs per thread, for balance, of at least 16 lines each.
+    int nJobCount = MIN( psContext->nThreads * 4, (nLines + 15) / 16 );
+
+    if( nJobCount <= 1 )
+    {
+        sJob.nLinesPerJob = nLines;
+        GDALTerrainProcessJob( &sJob, 0 );
+        return;
+    }
+
+    sJob.nLinesPerJob = (nLines + nJobCount - 1) / nJobCount;
+    nJobCount = (nLines + sJob.nLinesPerJob - 1) / sJob.nLinesPerJob;
+
+    CPLRunJobs( nJobCount, psContext->nThreads, GDALTerrainProcessJob, &sJob );
+}
+
+/************************************************************************/
+/*                         GDALTerrainProcess()                         */
+/************************************************************************/
+
+/**
+ * Compute a terrain analysis of a whole band.
+ *
+ * The source band is read, and the destination band written, by strips
+ * of lines, each strip being computed by GDALTerrainContextProcess().
+ * The nodata values are those of the bands, 0 being used if the
+ * destination band has none.
+ *
+ * @param hSrcBand the elevation band.
+ * @param hDstBand the output band, of the same size.
+ * @param eAlgorithm the terrain analysis algorithm.
+ * @param psOptions the algorithm options.
+ * @param pfnProgress progress function, or NULL.
+ * @param pProgressArg argument of the progress function.
+ *
+ * @return CE_None on success or CE_Failure if something goes wrong.
+ */
+
+CPLErr GDALTerrainProcess( GDALRasterBandH hSrcBand, GDALRasterBandH hDstBand,
+                           GDALTerrainAlgorithm eAlgorithm,
+                           const GDALTerrainOptions *psOptions,
+                           GDALProgressFunc pfnProgress, void *pProgressArg )
+{
+    VALIDATE_POINTER1( hSrcBand, "GDALTerrainProcess", CE_Failure );
+    VALIDATE_POINTER1( hDstBand, "GDALTerrainProcess", CE_Failure );
+
+    CPLErr eErr = CE_None;
+    int nXSize = GDALGetRasterBandXSize(hSrcBand);
+    int nYSize = GDALGetRasterBandYSize(hSrcBand);
+    int bSrcHasNoData, bDstHasNoData;
+    float fSrcNoDataValue, fDstNoDataValue;
+
+    if (pfnProgress == NULL)
+        pfnProgress = GDALDummyProgress;
+
+/* -------------------------------------------------------------------- */
+/*      Initialize progress counter.                                    */
+/* -------------------------------------------------------------------- */
+    if( !pfnProgress( 0.0, NULL, pProgressArg ) )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        return CE_Failure;
+    }
+
+    // The nodata values are compared as floats, as they always were.
+    fSrcNoDataValue = (float) GDALGetRasterNoDataValue(hSrcBand, &bSrcHasNoData);
+    fDstNoDataValue = (float) GDALGetRasterNoDataValue(hDstBand, &bDstHasNoData);
+    if (!bDstHasNoData)
+        fDstNoDataValue = 0.0;
+
+    GDALTerrainContext *psContext =
+        GDALTerrainContextCreate( eAlgorithm, psOptions, bSrcHasNoData,
+                                  fSrcNoDataValue, fDstNoDataValue );
+    if( psContext == NULL )
+        return CE_Failure;
+
+/* -------------------------------------------------------------------- */
+/*      Strips of about 4 MB of source lines, plus the two lines above  */
+/*      and below, which are carried over from one strip to the next.  */
+/* -------------------------------------------------------------------- */
+    int nStripLines = MAX(1, (4 * 1024 * 1024) / (nXSize * (int)sizeof(float)));
+    if( nStripLines > nYSize )
+        nStripLines = nYSize;
+
+    float *pafSrc = (float *)
+        VSIMalloc3( nStripLines + 2, nXSize, sizeof(float) );
+    float *pafDst = (float *)
+        VSIMalloc3( nStripLines, nXSize, sizeof(float) );
+
+    if( pafSrc == NULL || pafDst == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "Out of memory allocating %d lines of %d pixels "
+                  "in GDALTerrainProcess()", nStripLines + 2, nXSize );
+        eErr = CE_Failure;
+        goto end;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      The first and last lines are nodata.                            */
+/* -------------------------------------------------------------------- */
+    int j;
+    for (j = 0; j < nXSize; j++)
+    {
+        pafDst[j] = fDstNoDataValue;
+    }
+    eErr = GDALRasterIO(hDstBand, GF_Write,
+                        0, 0, nXSize, 1,
+                        pafDst, nXSize, 1, GDT_Float32, 0, 0);
+
+    if (eErr == CE_None && nYSize > 1)
+    {
+        eErr = GDALRasterIO(hDstBand, GF_Write,
+                            0, nYSize - 1, nXSize, 1,
+                            pafDst, nXSize, 1, GDT_Float32, 0, 0);
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Process the lines 1 to nYSize-2 by strips.                      */
+/* -------------------------------------------------------------------- */
+    if( eErr == CE_None && nYSize > 2 )
+        eErr = GDALRasterIO( hSrcBand, GF_Read, 0, 0, nXSize, 2,
+                             pafSrc, nXSize, 2, GDT_Float32, 0, 0 );
+
+    for( int iY = 1; eErr == CE_None && iY < nYSize - 1; iY += nStripLines )
+    {
+        int nLines = MIN(nStripLines, nYSize - 1 - iY);
+
+        // Source lines iY-1 and iY are already in the first two lines.
+        eErr = GDALRasterIO( hSrcBand, GF_Read, 0, iY + 1, nXSize, nLines,
+                             pafSrc + 2 * (size_t) nXSize, nXSize, nLines,
+                             GDT_Float32, 0, 0 );
+        if( eErr != CE_None )
+            break;
+
+        GDALTerrainContextProcess( psContext, nXSize, nLines,
+                                   pafSrc, pafDst );
+
+        eErr = GDALRasterIO( hDstBand, GF_Write, 0, iY, nXSize, nLines,
+                             pafDst, nXSize, nLines, GDT_Float32, 0, 0 );
+        if( eErr != CE_None )
+            break;
+
+        if( !pfnProgress( 1.0 * (iY + nLines) / nYSize, NULL, pProgressArg ) )
+        {
+            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+            eErr = CE_Failure;
+            break;
+        }
+
+        memmove( pafSrc, pafSrc + (size_t) nLines * nXSize,
+                 2 * sizeof(float) * nXSize );
+    }
+
+    if( eErr == CE_None )
+        pfnProgress( 1.0, NULL, pProgressArg );
+
+end:
+    CPLFree( pafSrc );
+    CPLFree( pafDst );
+    GDALTerrainContextFree( psContext );
+
+    return eErr;
+}
@@ -31,6 +31,7 @@
 
 #include "gdal_priv.h"
 #include "gdal_alg.h"
+#include "gdal_alg_priv.h"
 #include "ogr_spatialref.h"
 #include "cpl_string.h"
 
@@ -764,6 +765,10 @@ typedef struct {
     
     void     *pDstGCPTransformArg;
 
+    /* TRUE for GDALCloneTransformer() copies, which share the read-only */
+    /* source and destination sub-transformers with the original. */
+    int      bSharedSubTransformers;
+
 } GDALGenImgProjTransformInfo;
 
 /************************************************************************/
@@ -1348,6 +1353,15 @@ void GDALDestroyGenImgProjTransformer( void *hTransformArg )
     GDALGenImgProjTransformInfo *psInfo = 
         (GDALGenImgProjTransformInfo *) hTransformArg;
 
+    if( psInfo->pReprojectArg != NULL )
+        GDALDestroyReprojectionTransformer( psInfo->pReprojectArg );
+
+    if( psInfo->bSharedSubTransformers )
+    {
+        CPLFree( psInfo );
+        return;
+    }
+
     if( psInfo->pSrcGCPTransformArg != NULL )
         GDALDestroyGCPTransformer( psInfo->pSrcGCPTransformArg );
 
@@ -1363,9 +1377,6 @@ void GDALDestroyGenImgProjTransformer( void *hTransformArg )
     if( psInfo->pDstGCPTransformArg != NULL )
         GDALDestroyGCPTransformer( psInfo->pDstGCPTransformArg );
 
-    if( psInfo->pReprojectArg != NULL )
-        GDALDestroyReprojectionTransformer( psInfo->pReprojectArg );
-
     CPLFree( psInfo );
 }
 
@@ -2544,6 +2555,122 @@ CPLErr GDALDeserializeTransformer( CPLXMLNode *psTree,
     return CPLGetLastErrorType();
 }
 
+/************************************************************************/
+/*                        GDALCloneTransformer()                        */
+/*                                                                      */
+/*      Create a copy of a transformer that may be used from another    */
+/*      thread while the original is in use.  The geotransform, GCP,    */
+/*      TPS, RPC and geolocation transformers are only read while       */
+/*      transforming and are shared with the original, while the OGR    */
+/*      coordinate transformations of a reprojection are created anew   */
+/*      from the same spatial references.  Going through serialization  */
+/*      is avoided as it does not round trip GCPs and RPCs exactly.     */
+/*                                                                      */
+/*      Returns NULL for transformers that cannot be copied, such as    */
+/*      application transformers; these must only be used from one     */
+/*      thread.  The copy is destroyed with GDALDestroyTransformer(),   */
+/*      and must not outlive the original.                              */
+/************************************************************************/
+
+void *GDALCloneTransformer( GDALTransformerFunc pfnTransformer,
+                            void *pTransformArg )
+
+{
+    if( pTransformArg == NULL )
+        return NULL;
+
+/* -------------------------------------------------------------------- */
+/*      Approximating transformer: copy the base transformer.           */
+/* -------------------------------------------------------------------- */
+    if( pfnTransformer == GDALApproxTransform )
+    {
+        ApproxTransformInfo *psATInfo = (ApproxTransformInfo *) pTransformArg;
+        void *pBaseClone;
+
+        pBaseClone = GDALCloneTransformer( psATInfo->pfnBaseTransformer,
+                                           psATInfo->pBaseCBData );
+        if( pBaseClone == NULL )
+            return NULL;
+
+        void *pClone = 
+            GDALCreateApproxTransformer( psATInfo->pfnBaseTransformer,
+                                         pBaseClone, psATInfo->dfMaxError );
+        GDALApproxTransformerOwnsSubtransformer( pClone, TRUE );
+
+        return pClone;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Reprojection: new coordinate transformations, as OGRProj4CT     */
+/*      keeps state between calls.                                      */
+/* -------------------------------------------------------------------- */
+    if( pfnTransformer == GDALReprojectionTransform )
+    {
+        GDALReprojectionTransformInfo *psInfo = 
+            (GDALReprojectionTransformInfo *) pTransformArg;
+        GDALReprojectionTransformInfo *psClone;
+
+        if( psInfo->poForwardTransform == NULL )
+            return NULL;
+
+        psClone = (GDALReprojectionTransformInfo *) 
+            CPLCalloc(sizeof(GDALReprojectionTransformInfo),1);
+        psClone->sTI = psInfo->sTI;
+
+        psClone->poForwardTransform = 
+            OGRCreateCoordinateTransformation( 
+                psInfo->poForwardTransform->GetSourceCS(),
+                psInfo->poForwardTransform->GetTargetCS() );
+
+        if( psInfo->poReverseTransform != NULL )
+            psClone->poReverseTransform = 
+                OGRCreateCoordinateTransformation( 
+                    psInfo->poReverseTransform->GetSourceCS(),
+                    psInfo->poReverseTransform->GetTargetCS() );
+
+        if( psClone->poForwardTransform == NULL
+            || (psInfo->poReverseTransform != NULL 
+                && psClone->poReverseTransform == NULL) )
+        {
+            GDALDestroyReprojectionTransformer( psClone );
+            return NULL;
+        }
+
+        return psClone;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      General image transformer: share everything but the            */
+/*      reprojection.                                                   */
+/* -------------------------------------------------------------------- */
+    if( pfnTransformer == GDALGenImgProjTransform )
+    {
+        GDALGenImgProjTransformInfo *psInfo = 
+            (GDALGenImgProjTransformInfo *) pTransformArg;
+        GDALGenImgProjTransformInfo *psClone;
+        void *pReprojectClone = NULL;
+
+        if( psInfo->pReprojectArg != NULL )
+        {
+            pReprojectClone = 
+                GDALCloneTransformer( GDALReprojectionTransform,
+                                      psInfo->pReprojectArg );
+            if( pReprojectClone == NULL )
+                return NULL;
+        }
+
+        psClone = (GDALGenImgProjTransformInfo *) 
+            CPLMalloc(sizeof(GDALGenImgProjTransformInfo));
+        memcpy( psClone, psInfo, sizeof(GDALGenImgProjTransformInfo) );
+        psClone->pReprojectArg = pReprojectClone;
+        psClone->bSharedSubTransformers = TRUE;
+
+        return psClone;
+    }
+
+    return NULL;
+}
+
 /************************************************************************/
 /*                       GDALDestroyTransformer()                       */
 /************************************************************************/
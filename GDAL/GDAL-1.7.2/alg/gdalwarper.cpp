@@ -655,6 +655,12 @@ GDALWarpDstAlphaMasker( void *pMaskFuncArg, int nBandCount, GDALDataType eType,
  * careful.  Mostly useful to short circuit a lot of extra work in mosaicing 
  * situations.
  * 
+ * - NUM_THREADS=[number]/ALL_CPUS: The number of worker threads used by
+ * GDALWarpOperation::ChunkAndWarpMulti() to process chunks concurrently.
+ * The default is 2.  With ChunkAndWarpImage(), or when there are fewer 
+ * chunks than threads, the warp kernel uses the threads to process bands 
+ * of rows of a chunk concurrently (the default is then 1).
+ *
  * - UNIFIED_SRC_NODATA=YES/[NO]: By default nodata masking values considered
  * independently for each band.  However, sometimes it is desired to treat all
  * bands as nodata if and only if, all bands match the corresponding nodata
@@ -290,6 +290,8 @@ public:
     
     double              *padfDstNoDataReal;
 
+    int                 nThreads;
+
                        GDALWarpKernel();
     virtual           ~GDALWarpKernel();
 
@@ -320,16 +322,17 @@ private:
     CPLErr          ComputeSourceWindow( int nDstXOff, int nDstYOff, 
                                          int nDstXSize, int nDstYSize,
                                          int *pnSrcXOff, int *pnSrcYOff, 
-                                         int *pnSrcXSize, int *pnSrcYSize );
+                                         int *pnSrcXSize, int *pnSrcYSize,
+                                         void *pTransformerArg );
 
     CPLErr          CreateKernelMask( GDALWarpKernel *, int iBand, 
                                       const char *pszType );
 
-    void            *hThread1Mutex;
-    void            *hThread2Mutex;
     void            *hIOMutex;
     void            *hWarpMutex;
 
+    int             nKernelThreads;
+
     int             nChunkListCount;
     int             nChunkListMax;
     int            *panChunkList;
@@ -365,6 +368,20 @@ public:
                                         GDALDataType eBufDataType,
                                         int nSrcXOff=0, int nSrcYOff=0,
                                         int nSrcXSize=0, int nSrcYSize=0 );
+
+    /* with a copy of the transformer, for use from several threads */
+    CPLErr          WarpRegion( int nDstXOff, int nDstYOff, 
+                                int nDstXSize, int nDstYSize,
+                                int nSrcXOff, int nSrcYOff,
+                                int nSrcXSize, int nSrcYSize,
+                                void *pTransformerArg );
+    CPLErr          WarpRegionToBuffer( int nDstXOff, int nDstYOff, 
+                                        int nDstXSize, int nDstYSize, 
+                                        void *pDataBuf, 
+                                        GDALDataType eBufDataType,
+                                        int nSrcXOff, int nSrcYOff,
+                                        int nSrcXSize, int nSrcYSize,
+                                        void *pTransformerArg );
 };
 
 #endif /* def __cplusplus */
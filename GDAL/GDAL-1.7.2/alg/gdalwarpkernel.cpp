@@ -30,7 +30,10 @@
  ****************************************************************************/
 
 #include "gdalwarper.h"
+#include "gdal_alg_priv.h"
 #include "cpl_string.h"
+#include "cpl_multiproc.h"
+#include "cpl_worker_thread_pool.h"
 
 CPL_CVSID("$Id$");
 
@@ -63,6 +66,8 @@ static CPLErr GWKNearestShort( GDALWarpKernel *poWK );
 static CPLErr GWKNearestNoMasksFloat( GDALWarpKernel *poWK );
 static CPLErr GWKNearestFloat( GDALWarpKernel *poWK );
 
+typedef CPLErr (*GWKWarpFunc)( GDALWarpKernel * );
+
 /************************************************************************/
 /* ==================================================================== */
 /*                            GDALWarpKernel                            */
@@ -462,6 +467,20 @@ static CPLErr GWKNearestFloat( GDALWarpKernel *poWK );
  * This field may be NULL if not required for the pfnProgress being used.
  */
 
+/**
+ * \var int GDALWarpKernel::nThreads;
+ *
+ * Number of threads used to warp the destination window.
+ *
+ * When greater than one, PerformWarp() splits the destination window in
+ * bands of rows that are warped concurrently.  Each thread uses its own
+ * copy of the transformer, and the window is warped on one thread if the
+ * transformer is not one of the GDAL transformers that can be copied. 
+ * pfnProgress is only ever called by one thread at a time. 
+ *
+ * This field defaults to 1.
+ */
+
 
 /************************************************************************/
 /*                           GDALWarpKernel()                           */
@@ -503,6 +522,7 @@ GDALWarpKernel::GDALWarpKernel()
     pfnTransformer = NULL;
     pTransformerArg = NULL;
     papszWarpOptions = NULL;
+    nThreads = 1;
 }
 
 /************************************************************************/
@@ -514,6 +534,356 @@ GDALWarpKernel::~GDALWarpKernel()
 {
 }
 
+/************************************************************************/
+/*                           GWKGetWarpFunc()                           */
+/*                                                                      */
+/*      Select the specialised resampling function best suited to       */
+/*      the data type, resampling algorithm and masks of the kernel.    */
+/************************************************************************/
+
+static GWKWarpFunc GWKGetWarpFunc( GDALWarpKernel *poWK )
+
+{
+    if( CSLFetchBoolean( poWK->papszWarpOptions, "USE_GENERAL_CASE", FALSE ) )
+        return GWKGeneralCase;
+
+    if( poWK->eWorkingDataType == GDT_Byte
+        && poWK->eResample == GRA_NearestNeighbour
+        && poWK->papanBandSrcValid == NULL
+        && poWK->panUnifiedSrcValid == NULL
+        && poWK->pafUnifiedSrcDensity == NULL
+        && poWK->panDstValid == NULL
+        && poWK->pafDstDensity == NULL )
+        return GWKNearestNoMasksByte;
+
+    if( poWK->eWorkingDataType == GDT_Byte
+        && poWK->eResample == GRA_Bilinear
+        && poWK->papanBandSrcValid == NULL
+        && poWK->panUnifiedSrcValid == NULL
+        && poWK->pafUnifiedSrcDensity == NULL
+        && poWK->panDstValid == NULL
+        && poWK->pafDstDensity == NULL )
+        return GWKBilinearNoMasksByte;
+
+    if( poWK->eWorkingDataType == GDT_Byte
+        && poWK->eResample == GRA_Cubic
+        && poWK->papanBandSrcValid == NULL
+        && poWK->panUnifiedSrcValid == NULL
+        && poWK->pafUnifiedSrcDensity == NULL
+        && poWK->panDstValid == NULL
+        && poWK->pafDstDensity == NULL )
+        return GWKCubicNoMasksByte;
+
+    if( poWK->eWorkingDataType == GDT_Byte
+        && poWK->eResample == GRA_CubicSpline
+        && poWK->papanBandSrcValid == NULL
+        && poWK->panUnifiedSrcValid == NULL
+        && poWK->pafUnifiedSrcDensity == NULL
+        && poWK->panDstValid == NULL
+        && poWK->pafDstDensity == NULL )
+        return GWKCubicSplineNoMasksByte;
+
+    if( poWK->eWorkingDataType == GDT_Byte
+        && poWK->eResample == GRA_NearestNeighbour )
+        return GWKNearestByte;
+
+    if( (poWK->eWorkingDataType == GDT_Int16 || poWK->eWorkingDataType == GDT_UInt16)
+        && poWK->eResample == GRA_NearestNeighbour
+        && poWK->papanBandSrcValid == NULL
+        && poWK->panUnifiedSrcValid == NULL
+        && poWK->pafUnifiedSrcDensity == NULL
+        && poWK->panDstValid == NULL
+        && poWK->pafDstDensity == NULL )
+        return GWKNearestNoMasksShort;
+
+    if( (poWK->eWorkingDataType == GDT_Int16 )
+        && poWK->eResample == GRA_Cubic
+        && poWK->papanBandSrcValid == NULL
+        && poWK->panUnifiedSrcValid == NULL
+        && poWK->pafUnifiedSrcDensity == NULL
+        && poWK->panDstValid == NULL
+        && poWK->pafDstDensity == NULL )
+        return GWKCubicNoMasksShort;
+
+    if( (poWK->eWorkingDataType == GDT_Int16 )
+        && poWK->eResample == GRA_CubicSpline
+        && poWK->papanBandSrcValid == NULL
+        && poWK->panUnifiedSrcValid == NULL
+        && poWK->pafUnifiedSrcDensity == NULL
+        && poWK->panDstValid == NULL
+        && poWK->pafDstDensity == NULL )
+        return GWKCubicSplineNoMasksShort;
+
+    if( (poWK->eWorkingDataType == GDT_Int16 )
+        && poWK->eResample == GRA_Bilinear
+        && poWK->papanBandSrcValid == NULL
+        && poWK->panUnifiedSrcValid == NULL
+        && poWK->pafUnifiedSrcDensity == NULL
+        && poWK->panDstValid == NULL
+        && poWK->pafDstDensity == NULL )
+        return GWKBilinearNoMasksShort;
+
+    if( (poWK->eWorkingDataType == GDT_Int16 || poWK->eWorkingDataType == GDT_UInt16)
+        && poWK->eResample == GRA_NearestNeighbour )
+        return GWKNearestShort;
+
+    if( poWK->eWorkingDataType == GDT_Float32
+        && poWK->eResample == GRA_NearestNeighbour
+        && poWK->papanBandSrcValid == NULL
+        && poWK->panUnifiedSrcValid == NULL
+        && poWK->pafUnifiedSrcDensity == NULL
+        && poWK->panDstValid == NULL
+        && poWK->pafDstDensity == NULL )
+        return GWKNearestNoMasksFloat;
+
+    if( poWK->eWorkingDataType == GDT_Float32
+        && poWK->eResample == GRA_NearestNeighbour )
+        return GWKNearestFloat;
+
+    return GWKGeneralCase;
+}
+
+/************************************************************************/
+/*                            GWKJobStruct                              */
+/*                                                                      */
+/*      State shared by the threads warping the row bands of a          */
+/*      kernel, and the per band progress accounting.                   */
+/************************************************************************/
+
+typedef struct
+{
+    GDALWarpKernel *poWK;
+    GWKWarpFunc     pfnWarp;
+    int             nRowsPerJob;
+
+    /* transformers not in use by a job, the last nFreeTransformers ones */
+    void          **papTransformerArgs;
+    int             nFreeTransformers;
+
+    void           *hMutex;
+    double          dfRowsDone;
+    int             bAbort;
+    CPLErr          eErr;
+} GWKJobStruct;
+
+typedef struct
+{
+    GWKJobStruct   *psJob;
+    int             nRows;
+    double          dfLastComplete;
+} GWKJobProgress;
+
+/************************************************************************/
+/*                         GWKJobProgressFunc()                         */
+/*                                                                      */
+/*      Progress function installed on the kernel of each row band.     */
+/*      It accumulates the rows completed by all bands, and forwards    */
+/*      the combined progress to the progress function of the kernel.   */
+/************************************************************************/
+
+static int CPL_STDCALL GWKJobProgressFunc( double dfComplete, 
+                                           const char *pszMessage, 
+                                           void *pProgressArg )
+
+{
+    GWKJobProgress *psProgress = (GWKJobProgress *) pProgressArg;
+    GWKJobStruct *psJob = psProgress->psJob;
+    GDALWarpKernel *poWK = psJob->poWK;
+    int bContinue;
+
+    CPLMutexHolderD( &(psJob->hMutex) );
+
+    psJob->dfRowsDone += 
+        (dfComplete - psProgress->dfLastComplete) * psProgress->nRows;
+    psProgress->dfLastComplete = dfComplete;
+
+    if( !psJob->bAbort 
+        && !poWK->pfnProgress( poWK->dfProgressBase + poWK->dfProgressScale *
+                               (psJob->dfRowsDone / poWK->nDstYSize), 
+                               pszMessage, poWK->pProgress ) )
+        psJob->bAbort = TRUE;
+
+    bContinue = !psJob->bAbort;
+
+    return bContinue;
+}
+
+/************************************************************************/
+/*                             GWKJobFunc()                             */
+/*                                                                      */
+/*      Warp one band of destination rows.  The band is described by    */
+/*      a shallow copy of the kernel whose destination window and       */
+/*      buffers are offset to the first row of the band.  Each          */
+/*      resampling function allocates its own coordinate arrays and     */
+/*      work structures and the job takes a transformer from the pool   */
+/*      for its duration, so nothing but the read-only source data,     */
+/*      and disjoint parts of the destination buffers, is shared.       */
+/************************************************************************/
+
+static int GWKJobFunc( void *pUserData, int iJob )
+
+{
+    GWKJobStruct *psJob = (GWKJobStruct *) pUserData;
+    GDALWarpKernel *poWK = psJob->poWK;
+    int nRowOff = iJob * psJob->nRowsPerJob;
+    int nRows = MIN( psJob->nRowsPerJob, poWK->nDstYSize - nRowOff );
+    int nWordSize = GDALGetDataTypeSize(poWK->eWorkingDataType) / 8;
+    int iBand;
+
+    if( psJob->bAbort )
+        return FALSE;
+
+    GDALWarpKernel oBandWK( *poWK );
+    GWKJobProgress sProgress;
+
+    sProgress.psJob = psJob;
+    sProgress.nRows = nRows;
+    sProgress.dfLastComplete = 0.0;
+
+    oBandWK.nDstYOff = poWK->nDstYOff + nRowOff;
+    oBandWK.nDstYSize = nRows;
+    oBandWK.nThreads = 1;
+    {
+        CPLMutexHolderD( &(psJob->hMutex) );
+        oBandWK.pTransformerArg = 
+            psJob->papTransformerArgs[--psJob->nFreeTransformers];
+    }
+    oBandWK.pfnProgress = GWKJobProgressFunc;
+    oBandWK.pProgress = &sProgress;
+    oBandWK.dfProgressBase = 0.0;
+    oBandWK.dfProgressScale = 1.0;
+
+    oBandWK.papabyDstImage = (GByte **) 
+        CPLMalloc(sizeof(GByte*) * poWK->nBands);
+    for( iBand = 0; iBand < poWK->nBands; iBand++ )
+        oBandWK.papabyDstImage[iBand] = poWK->papabyDstImage[iBand] 
+            + nRowOff * (size_t) poWK->nDstXSize * nWordSize;
+
+    if( poWK->pafDstDensity != NULL )
+        oBandWK.pafDstDensity = 
+            poWK->pafDstDensity + nRowOff * (size_t) poWK->nDstXSize;
+
+    /* nRowsPerJob is chosen so that bands start on a mask word boundary */
+    if( poWK->panDstValid != NULL )
+        oBandWK.panDstValid = 
+            poWK->panDstValid + (nRowOff * (size_t) poWK->nDstXSize) / 32;
+
+    CPLErr eErr = psJob->pfnWarp( &oBandWK );
+
+    CPLFree( oBandWK.papabyDstImage );
+
+    CPLMutexHolderD( &(psJob->hMutex) );
+
+    psJob->papTransformerArgs[psJob->nFreeTransformers++] = 
+        oBandWK.pTransformerArg;
+
+    if( eErr != CE_None )
+    {
+        psJob->eErr = eErr;
+        psJob->bAbort = TRUE;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                           GWKRunThreaded()                           */
+/*                                                                      */
+/*      Split the destination window in bands of rows, and warp them    */
+/*      concurrently on poWK->nThreads threads.  The bands are a few    */
+/*      times more numerous than the threads so that the load stays     */
+/*      balanced when parts of the window fall outside the source.      */
+/************************************************************************/
+
+static CPLErr GWKRunThreaded( GDALWarpKernel *poWK, GWKWarpFunc pfnWarp )
+
+{
+/* -------------------------------------------------------------------- */
+/*      The destination validity mask is written 32 bits at a time,     */
+/*      so bands must start at a row where a mask word starts.          */
+/* -------------------------------------------------------------------- */
+    int nRowAlign = 1;
+
+    while( (nRowAlign * (GIntBig) poWK->nDstXSize) % 32 != 0 )
+        nRowAlign++;
+
+    int nRowsPerJob = (poWK->nDstYSize + poWK->nThreads * 4 - 1) 
+        / (poWK->nThreads * 4);
+    nRowsPerJob = ((nRowsPerJob + nRowAlign - 1) / nRowAlign) * nRowAlign;
+
+    int nJobCount = (poWK->nDstYSize + nRowsPerJob - 1) / nRowsPerJob;
+
+    if( nJobCount < 2 )
+        return pfnWarp( poWK );
+
+/* -------------------------------------------------------------------- */
+/*      Transformers keep state between calls (PROJ.4 coordinate        */
+/*      transformations for instance), so each thread needs its own     */
+/*      copy.  Warp on this thread if the transformer cannot be         */
+/*      copied.                                                         */
+/* -------------------------------------------------------------------- */
+    int nThreads = MIN( poWK->nThreads, nJobCount );
+    int iThread;
+    void **papTransformerArgs = (void **) 
+        CPLMalloc(sizeof(void*) * nThreads);
+
+    papTransformerArgs[0] = poWK->pTransformerArg;
+    for( iThread = 1; iThread < nThreads; iThread++ )
+    {
+        papTransformerArgs[iThread] = 
+            GDALCloneTransformer( poWK->pfnTransformer, 
+                                  poWK->pTransformerArg );
+        if( papTransformerArgs[iThread] == NULL )
+        {
+            CPLDebug( "WARP", 
+                      "Transformer cannot be copied, warping on one thread." );
+            while( --iThread > 0 )
+                GDALDestroyTransformer( papTransformerArgs[iThread] );
+            CPLFree( papTransformerArgs );
+            return pfnWarp( poWK );
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Run the jobs.                                                   */
+/* -------------------------------------------------------------------- */
+    GWKJobStruct sJob;
+
+    sJob.poWK = poWK;
+    sJob.pfnWarp = pfnWarp;
+    sJob.nRowsPerJob = nRowsPerJob;
+    sJob.papTransformerArgs = papTransformerArgs;
+    sJob.nFreeTransformers = nThreads;
+    sJob.hMutex = NULL;
+    sJob.dfRowsDone = 0.0;
+    sJob.bAbort = FALSE;
+    sJob.eErr = CE_None;
+
+    if( !poWK->pfnProgress( poWK->dfProgressBase, "", poWK->pProgress ) )
+        sJob.bAbort = TRUE;
+    else
+        CPLRunJobs( nJobCount, nThreads, GWKJobFunc, &sJob );
+
+    if( sJob.hMutex != NULL )
+        CPLDestroyMutex( sJob.hMutex );
+
+    for( iThread = 0; iThread < nThreads; iThread++ )
+    {
+        if( papTransformerArgs[iThread] != poWK->pTransformerArg )
+            GDALDestroyTransformer( papTransformerArgs[iThread] );
+    }
+    CPLFree( papTransformerArgs );
+
+    if( sJob.eErr == CE_None && sJob.bAbort )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        sJob.eErr = CE_Failure;
+    }
+
+    return sJob.eErr;
+}
+
 /************************************************************************/
 /*                            PerformWarp()                             */
 /************************************************************************/
@@ -562,105 +932,15 @@ CPLErr GDALWarpKernel::PerformWarp()
     nFiltInitY = ((anGWKFilterRadius[eResample] + 1) % 2) - nYRadius;
 
 /* -------------------------------------------------------------------- */
-/*      Set up resampling functions.                                    */
-/* -------------------------------------------------------------------- */
-    if( CSLFetchBoolean( papszWarpOptions, "USE_GENERAL_CASE", FALSE ) )
-        return GWKGeneralCase( this );
-
-    if( eWorkingDataType == GDT_Byte
-        && eResample == GRA_NearestNeighbour
-        && papanBandSrcValid == NULL
-        && panUnifiedSrcValid == NULL
-        && pafUnifiedSrcDensity == NULL
-        && panDstValid == NULL
-        && pafDstDensity == NULL )
-        return GWKNearestNoMasksByte( this );
-
-    if( eWorkingDataType == GDT_Byte
-        && eResample == GRA_Bilinear
-        && papanBandSrcValid == NULL
-        && panUnifiedSrcValid == NULL
-        && pafUnifiedSrcDensity == NULL
-        && panDstValid == NULL
-        && pafDstDensity == NULL )
-        return GWKBilinearNoMasksByte( this );
-
-    if( eWorkingDataType == GDT_Byte
-        && eResample == GRA_Cubic
-        && papanBandSrcValid == NULL
-        && panUnifiedSrcValid == NULL
-        && pafUnifiedSrcDensity == NULL
-        && panDstValid == NULL
-        && pafDstDensity == NULL )
-        return GWKCubicNoMasksByte( this );
-
-    if( eWorkingDataType == GDT_Byte
-        && eResample == GRA_CubicSpline
-        && papanBandSrcValid == NULL
-        && panUnifiedSrcValid == NULL
-        && pafUnifiedSrcDensity == NULL
-        && panDstValid == NULL
-        && pafDstDensity == NULL )
-        return GWKCubicSplineNoMasksByte( this );
-
-    if( eWorkingDataType == GDT_Byte
-        && eResample == GRA_NearestNeighbour )
-        return GWKNearestByte( this );
-
-    if( (eWorkingDataType == GDT_Int16 || eWorkingDataType == GDT_UInt16)
-        && eResample == GRA_NearestNeighbour
-        && papanBandSrcValid == NULL
-        && panUnifiedSrcValid == NULL
-        && pafUnifiedSrcDensity == NULL
-        && panDstValid == NULL
-        && pafDstDensity == NULL )
-        return GWKNearestNoMasksShort( this );
-
-    if( (eWorkingDataType == GDT_Int16 )
-        && eResample == GRA_Cubic
-        && papanBandSrcValid == NULL
-        && panUnifiedSrcValid == NULL
-        && pafUnifiedSrcDensity == NULL
-        && panDstValid == NULL
-        && pafDstDensity == NULL )
-        return GWKCubicNoMasksShort( this );
-
-    if( (eWorkingDataType == GDT_Int16 )
-        && eResample == GRA_CubicSpline
-        && papanBandSrcValid == NULL
-        && panUnifiedSrcValid == NULL
-        && pafUnifiedSrcDensity == NULL
-        && panDstValid == NULL
-        && pafDstDensity == NULL )
-        return GWKCubicSplineNoMasksShort( this );
-
-    if( (eWorkingDataType == GDT_Int16 )
-        && eResample == GRA_Bilinear
-        && papanBandSrcValid == NULL
-        && panUnifiedSrcValid == NULL
-        && pafUnifiedSrcDensity == NULL
-        && panDstValid == NULL
-        && pafDstDensity == NULL )
-        return GWKBilinearNoMasksShort( this );
-
-    if( (eWorkingDataType == GDT_Int16 || eWorkingDataType == GDT_UInt16)
-        && eResample == GRA_NearestNeighbour )
-        return GWKNearestShort( this );
-
-    if( eWorkingDataType == GDT_Float32
-        && eResample == GRA_NearestNeighbour
-        && papanBandSrcValid == NULL
-        && panUnifiedSrcValid == NULL
-        && pafUnifiedSrcDensity == NULL
-        && panDstValid == NULL
-        && pafDstDensity == NULL )
-        return GWKNearestNoMasksFloat( this );
-
-    if( eWorkingDataType == GDT_Float32
-        && eResample == GRA_NearestNeighbour )
-        return GWKNearestFloat( this );
-
-    return GWKGeneralCase( this );
+/*      Select the resampling function, and run it either directly,     */
+/*      or split in bands of destination rows over several threads.     */
+/* -------------------------------------------------------------------- */
+    GWKWarpFunc pfnWarp = GWKGetWarpFunc( this );
+
+    if( nThreads > 1 )
+        return GWKRunThreaded( this, pfnWarp );
+
+    return pfnWarp( this );
 }
                                   
 /************************************************************************/
@@ -2295,6 +2575,76 @@ static int GWKCubicSplineResampleNoMasksShort( GDALWarpKernel *poWK, int iBand,
     return TRUE;
 }
 
+/************************************************************************/
+/*                         GWKInteriorPixels                            */
+/*                                                                      */
+/*      List of the destination pixels of a scanline whose resampling   */
+/*      kernel lies entirely inside the source window.  These are       */
+/*      resampled by the vectorized row resamplers of                   */
+/*      gdalwarpkernel_simd.cpp, several pixels at a time.              */
+/************************************************************************/
+
+typedef struct
+{
+    int     nCount;
+    double *padfSrcX;
+    double *padfSrcY;
+    int    *panDstOffset;
+} GWKInteriorPixels;
+
+static void GWKInteriorInit( GWKInteriorPixels *psInterior, int nMaxCount,
+                             int bEnabled )
+
+{
+    psInterior->nCount = 0;
+    psInterior->padfSrcX = NULL;
+    psInterior->padfSrcY = NULL;
+    psInterior->panDstOffset = NULL;
+
+    if( bEnabled )
+    {
+        psInterior->padfSrcX = (double *) CPLMalloc(sizeof(double)*nMaxCount);
+        psInterior->padfSrcY = (double *) CPLMalloc(sizeof(double)*nMaxCount);
+        psInterior->panDstOffset = (int *) CPLMalloc(sizeof(int)*nMaxCount);
+    }
+}
+
+static void GWKInteriorFree( GWKInteriorPixels *psInterior )
+
+{
+    CPLFree( psInterior->padfSrcX );
+    CPLFree( psInterior->padfSrcY );
+    CPLFree( psInterior->panDstOffset );
+}
+
+/* -------------------------------------------------------------------- */
+/*      Add the pixel to the list if the nBefore source pixels before,  */
+/*      and nAfter after, the kernel origin are all in the window.      */
+/* -------------------------------------------------------------------- */
+static int GWKInteriorAdd( GWKInteriorPixels *psInterior, 
+                           GDALWarpKernel *poWK, 
+                           double dfSrcX, double dfSrcY, int iDstOffset,
+                           int nBefore, int nAfter )
+
+{
+    if( psInterior->padfSrcX == NULL )
+        return FALSE;
+
+    int     iSrcX = (int) floor( dfSrcX - 0.5 );
+    int     iSrcY = (int) floor( dfSrcY - 0.5 );
+
+    if( iSrcX - nBefore < 0 || iSrcX + nAfter >= poWK->nSrcXSize
+        || iSrcY - nBefore < 0 || iSrcY + nAfter >= poWK->nSrcYSize )
+        return FALSE;
+
+    psInterior->padfSrcX[psInterior->nCount] = dfSrcX;
+    psInterior->padfSrcY[psInterior->nCount] = dfSrcY;
+    psInterior->panDstOffset[psInterior->nCount] = iDstOffset;
+    psInterior->nCount++;
+
+    return TRUE;
+}
+
 /************************************************************************/
 /*                           GWKGeneralCase()                           */
 /*                                                                      */
@@ -2706,6 +3056,11 @@ static CPLErr GWKBilinearNoMasksByte( GDALWarpKernel *poWK )
     padfZ = (double *) CPLMalloc(sizeof(double) * nDstXSize);
     pabSuccess = (int *) CPLMalloc(sizeof(int) * nDstXSize);
 
+    const GWKSIMDFuncs *psSIMD = GWKGetSIMDFuncs();
+    GWKInteriorPixels sInterior;
+
+    GWKInteriorInit( &sInterior, nDstXSize, psSIMD != NULL );
+
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
@@ -2770,6 +3125,12 @@ static CPLErr GWKBilinearNoMasksByte( GDALWarpKernel *poWK )
 
             iDstOffset = iDstX + iDstY * nDstXSize;
 
+            if( GWKInteriorAdd( &sInterior, poWK, 
+                                padfX[iDstX]-poWK->nSrcXOff,
+                                padfY[iDstX]-poWK->nSrcYOff,
+                                iDstOffset, 0, 1 ) )
+                continue;
+
             for( iBand = 0; iBand < poWK->nBands; iBand++ )
             {
                 GWKBilinearResampleNoMasksByte( poWK, iBand,
@@ -2779,6 +3140,22 @@ static CPLErr GWKBilinearNoMasksByte( GDALWarpKernel *poWK )
             }
         }
 
+/* -------------------------------------------------------------------- */
+/*      Resample the interior pixels of the scanline.                   */
+/* -------------------------------------------------------------------- */
+        if( sInterior.nCount > 0 )
+        {
+            int iBand;
+
+            for( iBand = 0; iBand < poWK->nBands; iBand++ )
+                psSIMD->pfnBilinearByte( poWK->papabySrcImage[iBand], nSrcXSize, 
+                                  sInterior.nCount, sInterior.padfSrcX, 
+                                  sInterior.padfSrcY, sInterior.panDstOffset,
+                                  poWK->papabyDstImage[iBand] );
+
+            sInterior.nCount = 0;
+        }
+
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
@@ -2798,6 +3175,7 @@ static CPLErr GWKBilinearNoMasksByte( GDALWarpKernel *poWK )
     CPLFree( padfY );
     CPLFree( padfZ );
     CPLFree( pabSuccess );
+    GWKInteriorFree( &sInterior );
 
     return eErr;
 }
@@ -2843,6 +3221,11 @@ static CPLErr GWKCubicNoMasksByte( GDALWarpKernel *poWK )
     padfZ = (double *) CPLMalloc(sizeof(double) * nDstXSize);
     pabSuccess = (int *) CPLMalloc(sizeof(int) * nDstXSize);
 
+    const GWKSIMDFuncs *psSIMD = GWKGetSIMDFuncs();
+    GWKInteriorPixels sInterior;
+
+    GWKInteriorInit( &sInterior, nDstXSize, psSIMD != NULL );
+
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
@@ -2907,6 +3290,12 @@ static CPLErr GWKCubicNoMasksByte( GDALWarpKernel *poWK )
 
             iDstOffset = iDstX + iDstY * nDstXSize;
 
+            if( GWKInteriorAdd( &sInterior, poWK, 
+                                padfX[iDstX]-poWK->nSrcXOff,
+                                padfY[iDstX]-poWK->nSrcYOff,
+                                iDstOffset, 1, 2 ) )
+                continue;
+
             for( iBand = 0; iBand < poWK->nBands; iBand++ )
             {
                 GWKCubicResampleNoMasksByte( poWK, iBand,
@@ -2916,6 +3305,22 @@ static CPLErr GWKCubicNoMasksByte( GDALWarpKernel *poWK )
             }
         }
 
+/* -------------------------------------------------------------------- */
+/*      Resample the interior pixels of the scanline.                   */
+/* -------------------------------------------------------------------- */
+        if( sInterior.nCount > 0 )
+        {
+            int iBand;
+
+            for( iBand = 0; iBand < poWK->nBands; iBand++ )
+                psSIMD->pfnCubicByte( poWK->papabySrcImage[iBand], nSrcXSize, 
+                                  sInterior.nCount, sInterior.padfSrcX, 
+                                  sInterior.padfSrcY, sInterior.panDstOffset,
+                                  poWK->papabyDstImage[iBand] );
+
+            sInterior.nCount = 0;
+        }
+
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
@@ -2935,6 +3340,7 @@ static CPLErr GWKCubicNoMasksByte( GDALWarpKernel *poWK )
     CPLFree( padfY );
     CPLFree( padfZ );
     CPLFree( pabSuccess );
+    GWKInteriorFree( &sInterior );
 
     return eErr;
 }
@@ -3450,6 +3856,11 @@ static CPLErr GWKBilinearNoMasksShort( GDALWarpKernel *poWK )
     padfZ = (double *) CPLMalloc(sizeof(double) * nDstXSize);
     pabSuccess = (int *) CPLMalloc(sizeof(int) * nDstXSize);
 
+    const GWKSIMDFuncs *psSIMD = GWKGetSIMDFuncs();
+    GWKInteriorPixels sInterior;
+
+    GWKInteriorInit( &sInterior, nDstXSize, psSIMD != NULL );
+
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
@@ -3514,6 +3925,12 @@ static CPLErr GWKBilinearNoMasksShort( GDALWarpKernel *poWK )
 
             iDstOffset = iDstX + iDstY * nDstXSize;
 
+            if( GWKInteriorAdd( &sInterior, poWK, 
+                                padfX[iDstX]-poWK->nSrcXOff,
+                                padfY[iDstX]-poWK->nSrcYOff,
+                                iDstOffset, 0, 1 ) )
+                continue;
+
             for( iBand = 0; iBand < poWK->nBands; iBand++ )
             {
                 GInt16  iValue = 0;
@@ -3525,6 +3942,23 @@ static CPLErr GWKBilinearNoMasksShort( GDALWarpKernel *poWK )
             }
         }
 
+/* -------------------------------------------------------------------- */
+/*      Resample the interior pixels of the scanline.                   */
+/* -------------------------------------------------------------------- */
+        if( sInterior.nCount > 0 )
+        {
+            int iBand;
+
+            for( iBand = 0; iBand < poWK->nBands; iBand++ )
+                psSIMD->pfnBilinearShort( (GInt16 *) poWK->papabySrcImage[iBand],
+                                  nSrcXSize, sInterior.nCount, 
+                                  sInterior.padfSrcX, sInterior.padfSrcY, 
+                                  sInterior.panDstOffset,
+                                  (GInt16 *) poWK->papabyDstImage[iBand] );
+
+            sInterior.nCount = 0;
+        }
+
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
@@ -3544,6 +3978,7 @@ static CPLErr GWKBilinearNoMasksShort( GDALWarpKernel *poWK )
     CPLFree( padfY );
     CPLFree( padfZ );
     CPLFree( pabSuccess );
+    GWKInteriorFree( &sInterior );
 
     return eErr;
 }
@@ -3589,6 +4024,11 @@ static CPLErr GWKCubicNoMasksShort( GDALWarpKernel *poWK )
     padfZ = (double *) CPLMalloc(sizeof(double) * nDstXSize);
     pabSuccess = (int *) CPLMalloc(sizeof(int) * nDstXSize);
 
+    const GWKSIMDFuncs *psSIMD = GWKGetSIMDFuncs();
+    GWKInteriorPixels sInterior;
+
+    GWKInteriorInit( &sInterior, nDstXSize, psSIMD != NULL );
+
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
@@ -3653,6 +4093,12 @@ static CPLErr GWKCubicNoMasksShort( GDALWarpKernel *poWK )
 
             iDstOffset = iDstX + iDstY * nDstXSize;
 
+            if( GWKInteriorAdd( &sInterior, poWK, 
+                                padfX[iDstX]-poWK->nSrcXOff,
+                                padfY[iDstX]-poWK->nSrcYOff,
+                                iDstOffset, 1, 2 ) )
+                continue;
+
             for( iBand = 0; iBand < poWK->nBands; iBand++ )
             {
                 GInt16  iValue = 0;
@@ -3664,6 +4110,23 @@ static CPLErr GWKCubicNoMasksShort( GDALWarpKernel *poWK )
             }
         }
 
+/* -------------------------------------------------------------------- */
+/*      Resample the interior pixels of the scanline.                   */
+/* -------------------------------------------------------------------- */
+        if( sInterior.nCount > 0 )
+        {
+            int iBand;
+
+            for( iBand = 0; iBand < poWK->nBands; iBand++ )
+                psSIMD->pfnCubicShort( (GInt16 *) poWK->papabySrcImage[iBand],
+                                  nSrcXSize, sInterior.nCount, 
+                                  sInterior.padfSrcX, sInterior.padfSrcY, 
+                                  sInterior.panDstOffset,
+                                  (GInt16 *) poWK->papabyDstImage[iBand] );
+
+            sInterior.nCount = 0;
+        }
+
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
@@ -3683,6 +4146,7 @@ static CPLErr GWKCubicNoMasksShort( GDALWarpKernel *poWK )
     CPLFree( padfY );
     CPLFree( padfZ );
     CPLFree( pabSuccess );
+    GWKInteriorFree( &sInterior );
 
     return eErr;
 }
@@ -0,0 +1,850 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  High Performance Image Reprojector
+ * Purpose:  SSE2 and AVX2 implementations of the bilinear and cubic
+ *           resamplers of the no-mask Byte and Int16 warp kernels.
+ *
+ ******************************************************************************
+ * Copyright (c) 2010, GDAL contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/*
+ * The functions of this file resample a list of destination pixels whose
+ * resampling kernel lies entirely inside the source window (the "interior"
+ * pixels), several pixels at a time.  Border pixels are still handled by
+ * the scalar resamplers of gdalwarpkernel.cpp.
+ *
+ * The vector code performs the same double precision operations, in the
+ * same order, as the scalar code, so on x86 the results are normally
+ * identical.  The documented tolerance is 1 digital number, to allow for
+ * compilers that evaluate the scalar code in extended precision or contract
+ * multiply-adds.  The warpsimdbench utility checks this tolerance.
+ *
+ * SSE2 is part of the x86-64 baseline so it is enabled at compile time.
+ * The AVX2 code is compiled with a function level target attribute (GCC
+ * 4.9 or later), and only selected if the CPU supports it at runtime.
+ */
+
+#include "gdal_alg_priv.h"
+#include "cpl_conv.h"
+#include "cpl_string.h"
+
+CPL_CVSID("$Id$");
+
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define HAVE_GWK_SSE2
+#  include <emmintrin.h>
+#endif
+
+#if defined(HAVE_GWK_SSE2) && defined(__GNUC__) && !defined(__clang__) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#  define HAVE_GWK_AVX2
+#  include <immintrin.h>
+#  define GWK_AVX2 __attribute__((target("avx2")))
+#endif
+
+#ifdef HAVE_GWK_SSE2
+
+/************************************************************************/
+/*                     Scalar interior resamplers.                      */
+/*                                                                      */
+/*      Used for the pixels left over by the vector loops.  These       */
+/*      mirror GWKBilinearResampleNoMasks*() and                        */
+/*      GWKCubicResampleNoMasks*() for interior pixels.                 */
+/************************************************************************/
+
+template<class T>
+static double GWKBilinearInterior( const T *pSrc, int nSrcXSize,
+                                   double dfSrcX, double dfSrcY )
+
+{
+    int     iSrcX = (int) floor(dfSrcX - 0.5);
+    int     iSrcY = (int) floor(dfSrcY - 0.5);
+    const T *p = pSrc + iSrcX + iSrcY * nSrcXSize;
+    double  dfRatioX = 1.5 - (dfSrcX - iSrcX);
+    double  dfRatioY = 1.5 - (dfSrcY - iSrcY);
+    double  dfMult1 = dfRatioX * dfRatioY;
+    double  dfMult2 = (1.0-dfRatioX) * dfRatioY;
+    double  dfMult3 = (1.0-dfRatioX) * (1.0-dfRatioY);
+    double  dfMult4 = dfRatioX * (1.0-dfRatioY);
+
+    double  dfAccumulator = (double)p[0] * dfMult1;
+    dfAccumulator += (double)p[1] * dfMult2;
+    dfAccumulator += (double)p[1+nSrcXSize] * dfMult3;
+    dfAccumulator += (double)p[nSrcXSize] * dfMult4;
+
+    return dfAccumulator / (dfMult1 + dfMult2 + dfMult3 + dfMult4);
+}
+
+static double GWKCubicConvolution( double dfDist1, double dfDist2,
+                                   double dfDist3, double f0, double f1,
+                                   double f2, double f3 )
+
+{
+    return (   -f0 +     f1 - f2 + f3) * dfDist3
+        + (2.0*(f0 - f1) + f2 - f3) * dfDist2
+        + (   -f0          + f2     ) * dfDist1
+        +               f1;
+}
+
+template<class T>
+static double GWKCubicInterior( const T *pSrc, int nSrcXSize,
+                                double dfSrcX, double dfSrcY )
+
+{
+    int     iSrcX = (int) floor( dfSrcX - 0.5 );
+    int     iSrcY = (int) floor( dfSrcY - 0.5 );
+    double  dfDeltaX = dfSrcX - 0.5 - iSrcX;
+    double  dfDeltaY = dfSrcY - 0.5 - iSrcY;
+    double  dfDeltaX2 = dfDeltaX * dfDeltaX;
+    double  dfDeltaY2 = dfDeltaY * dfDeltaY;
+    double  dfDeltaX3 = dfDeltaX2 * dfDeltaX;
+    double  dfDeltaY3 = dfDeltaY2 * dfDeltaY;
+    double  adfValue[4];
+    int     i;
+
+    for ( i = -1; i < 3; i++ )
+    {
+        const T *p = pSrc + iSrcX + (iSrcY + i) * nSrcXSize;
+
+        adfValue[i + 1] = GWKCubicConvolution( dfDeltaX, dfDeltaX2, dfDeltaX3,
+                                               (double) p[-1], (double) p[0],
+                                               (double) p[1], (double) p[2] );
+    }
+
+    return GWKCubicConvolution( dfDeltaY, dfDeltaY2, dfDeltaY3,
+                                adfValue[0], adfValue[1],
+                                adfValue[2], adfValue[3] );
+}
+
+static GByte GWKClampByte( double dfValue )
+
+{
+    if ( dfValue < 0.0 )
+        return 0;
+    else if ( dfValue > 255.0 )
+        return 255;
+    else
+        return (GByte)(0.5 + dfValue);
+}
+
+/************************************************************************/
+/* ==================================================================== */
+/*                          SSE2 resamplers                             */
+/* ==================================================================== */
+/************************************************************************/
+
+
+/* -------------------------------------------------------------------- */
+/*      Compute the integer source position of two pixels, as           */
+/*      doubles, and their offset in the source buffer.  Interior       */
+/*      pixels have positive coordinates so truncation is floor().      */
+/* -------------------------------------------------------------------- */
+static void GWKSplitCoords_SSE2( const double *padfSrcX,
+                                 const double *padfSrcY, int nSrcXSize,
+                                 __m128d &xSrcX, __m128d &xSrcY,
+                                 __m128d &xFloorX, __m128d &xFloorY,
+                                 int *panOffset )
+
+{
+    __m128d xHalf = _mm_set1_pd( 0.5 );
+    int     anX[4], anY[4];
+
+    xSrcX = _mm_loadu_pd( padfSrcX );
+    xSrcY = _mm_loadu_pd( padfSrcY );
+
+    __m128i xiX = _mm_cvttpd_epi32( _mm_sub_pd( xSrcX, xHalf ) );
+    __m128i xiY = _mm_cvttpd_epi32( _mm_sub_pd( xSrcY, xHalf ) );
+
+    _mm_storeu_si128( (__m128i *) anX, xiX );
+    _mm_storeu_si128( (__m128i *) anY, xiY );
+
+    panOffset[0] = anX[0] + anY[0] * nSrcXSize;
+    panOffset[1] = anX[1] + anY[1] * nSrcXSize;
+
+    xFloorX = _mm_cvtepi32_pd( xiX );
+    xFloorY = _mm_cvtepi32_pd( xiY );
+}
+
+template<class T>
+static __m128d GWKBilinear2_SSE2( const T *pSrc, int nSrcXSize,
+                                  const double *padfSrcX,
+                                  const double *padfSrcY )
+
+{
+    __m128d xSrcX, xSrcY, xFloorX, xFloorY;
+    int     anOffset[2];
+
+    GWKSplitCoords_SSE2( padfSrcX, padfSrcY, nSrcXSize, 
+                         xSrcX, xSrcY, xFloorX, xFloorY, anOffset );
+
+    const T *p0 = pSrc + anOffset[0];
+    const T *p1 = pSrc + anOffset[1];
+    __m128d xOne = _mm_set1_pd( 1.0 );
+    __m128d xOneHalf = _mm_set1_pd( 1.5 );
+    __m128d xRatioX = _mm_sub_pd( xOneHalf, _mm_sub_pd( xSrcX, xFloorX ) );
+    __m128d xRatioY = _mm_sub_pd( xOneHalf, _mm_sub_pd( xSrcY, xFloorY ) );
+    __m128d xInvRatioX = _mm_sub_pd( xOne, xRatioX );
+    __m128d xInvRatioY = _mm_sub_pd( xOne, xRatioY );
+    __m128d xMult1 = _mm_mul_pd( xRatioX, xRatioY );
+    __m128d xMult2 = _mm_mul_pd( xInvRatioX, xRatioY );
+    __m128d xMult3 = _mm_mul_pd( xInvRatioX, xInvRatioY );
+    __m128d xMult4 = _mm_mul_pd( xRatioX, xInvRatioY );
+
+    __m128d xAcc = _mm_mul_pd( _mm_set_pd( p1[0], p0[0] ), xMult1 );
+    xAcc = _mm_add_pd( xAcc,
+                       _mm_mul_pd( _mm_set_pd( p1[1], p0[1] ), xMult2 ) );
+    xAcc = _mm_add_pd( xAcc,
+                       _mm_mul_pd( _mm_set_pd( p1[1+nSrcXSize],
+                                               p0[1+nSrcXSize] ), xMult3 ) );
+    xAcc = _mm_add_pd( xAcc,
+                       _mm_mul_pd( _mm_set_pd( p1[nSrcXSize],
+                                               p0[nSrcXSize] ), xMult4 ) );
+
+    __m128d xDiv = _mm_add_pd( _mm_add_pd( _mm_add_pd( xMult1, xMult2 ),
+                                           xMult3 ), xMult4 );
+
+    return _mm_div_pd( xAcc, xDiv );
+}
+
+/* -------------------------------------------------------------------- */
+/*      -f0 + f1 is evaluated as f1 - f0, which is exactly the same.    */
+/* -------------------------------------------------------------------- */
+static __m128d GWKCubicConvolution_SSE2( __m128d xD1, __m128d xD2,
+                                         __m128d xD3, __m128d f0,
+                                         __m128d f1, __m128d f2, __m128d f3 )
+
+{
+    __m128d xA = _mm_add_pd( _mm_sub_pd( _mm_sub_pd( f1, f0 ), f2 ), f3 );
+    __m128d xB = _mm_sub_pd( _mm_add_pd( _mm_mul_pd( _mm_set1_pd( 2.0 ),
+                                                     _mm_sub_pd( f0, f1 ) ),
+                                         f2 ), f3 );
+    __m128d xC = _mm_sub_pd( f2, f0 );
+
+    return _mm_add_pd( _mm_add_pd( _mm_add_pd( _mm_mul_pd( xA, xD3 ),
+                                               _mm_mul_pd( xB, xD2 ) ),
+                                   _mm_mul_pd( xC, xD1 ) ), f1 );
+}
+
+template<class T>
+static __m128d GWKCubic2_SSE2( const T *pSrc, int nSrcXSize,
+                               const double *padfSrcX,
+                               const double *padfSrcY )
+
+{
+    __m128d xSrcX, xSrcY, xFloorX, xFloorY;
+    int     anOffset[2];
+
+    GWKSplitCoords_SSE2( padfSrcX, padfSrcY, nSrcXSize, 
+                         xSrcX, xSrcY, xFloorX, xFloorY, anOffset );
+
+    __m128d xHalf = _mm_set1_pd( 0.5 );
+    __m128d xDX = _mm_sub_pd( _mm_sub_pd( xSrcX, xHalf ), xFloorX );
+    __m128d xDY = _mm_sub_pd( _mm_sub_pd( xSrcY, xHalf ), xFloorY );
+    __m128d xDX2 = _mm_mul_pd( xDX, xDX );
+    __m128d xDY2 = _mm_mul_pd( xDY, xDY );
+    __m128d xDX3 = _mm_mul_pd( xDX2, xDX );
+    __m128d xDY3 = _mm_mul_pd( xDY2, xDY );
+    __m128d axValue[4];
+    int     i;
+
+    for( i = -1; i < 3; i++ )
+    {
+        const T *p0 = pSrc + anOffset[0] + i * nSrcXSize;
+        const T *p1 = pSrc + anOffset[1] + i * nSrcXSize;
+
+        axValue[i+1] =
+            GWKCubicConvolution_SSE2( xDX, xDX2, xDX3,
+                                      _mm_set_pd( p1[-1], p0[-1] ),
+                                      _mm_set_pd( p1[0], p0[0] ),
+                                      _mm_set_pd( p1[1], p0[1] ),
+                                      _mm_set_pd( p1[2], p0[2] ) );
+    }
+
+    return GWKCubicConvolution_SSE2( xDY, xDY2, xDY3, axValue[0], axValue[1],
+                                     axValue[2], axValue[3] );
+}
+
+/* -------------------------------------------------------------------- */
+/*      Output conversions, matching the casts of the scalar code.      */
+/* -------------------------------------------------------------------- */
+static void GWKStoreByte_SSE2( __m128d xValue, const int *panDstOffset,
+                               GByte *pabyDst )
+
+{
+    int     anValue[4];
+
+    xValue = _mm_min_pd( _mm_max_pd( xValue, _mm_setzero_pd() ),
+                         _mm_set1_pd( 255.0 ) );
+    _mm_storeu_si128( (__m128i *) anValue,
+                      _mm_cvttpd_epi32( _mm_add_pd( xValue,
+                                                    _mm_set1_pd( 0.5 ) ) ) );
+    pabyDst[panDstOffset[0]] = (GByte) anValue[0];
+    pabyDst[panDstOffset[1]] = (GByte) anValue[1];
+}
+
+static void GWKStoreShort_SSE2( __m128d xValue, double dfRound,
+                                const int *panDstOffset, GInt16 *panDst )
+
+{
+    int     anValue[4];
+
+    _mm_storeu_si128( (__m128i *) anValue,
+                      _mm_cvttpd_epi32( _mm_add_pd( xValue,
+                                                    _mm_set1_pd(dfRound) ) ) );
+    panDst[panDstOffset[0]] = (GInt16) anValue[0];
+    panDst[panDstOffset[1]] = (GInt16) anValue[1];
+}
+
+/************************************************************************/
+/*                         SSE2 row functions.                          */
+/************************************************************************/
+
+static void GWKBilinearRowByte_SSE2( const GByte *pabySrc, int nSrcXSize,
+                                     int nCount, const double *padfSrcX,
+                                     const double *padfSrcY,
+                                     const int *panDstOffset, GByte *pabyDst )
+
+{
+    int i;
+
+    for( i = 0; i + 1 < nCount; i += 2 )
+        GWKStoreByte_SSE2( GWKBilinear2_SSE2( pabySrc, nSrcXSize, 
+                                              padfSrcX + i, padfSrcY + i ),
+                           panDstOffset + i, pabyDst );
+
+    for( ; i < nCount; i++ )
+        pabyDst[panDstOffset[i]] = 
+            GWKClampByte( GWKBilinearInterior( pabySrc, nSrcXSize,
+                                               padfSrcX[i], padfSrcY[i] ) );
+}
+
+static void GWKCubicRowByte_SSE2( const GByte *pabySrc, int nSrcXSize,
+                                  int nCount, const double *padfSrcX,
+                                  const double *padfSrcY,
+                                  const int *panDstOffset, GByte *pabyDst )
+
+{
+    int i;
+
+    for( i = 0; i + 1 < nCount; i += 2 )
+        GWKStoreByte_SSE2( GWKCubic2_SSE2( pabySrc, nSrcXSize, 
+                                           padfSrcX + i, padfSrcY + i ),
+                           panDstOffset + i, pabyDst );
+
+    for( ; i < nCount; i++ )
+        pabyDst[panDstOffset[i]] = 
+            GWKClampByte( GWKCubicInterior( pabySrc, nSrcXSize,
+                                            padfSrcX[i], padfSrcY[i] ) );
+}
+
+static void GWKBilinearRowShort_SSE2( const GInt16 *panSrc, int nSrcXSize,
+                                      int nCount, const double *padfSrcX,
+                                      const double *padfSrcY,
+                                      const int *panDstOffset, GInt16 *panDst )
+
+{
+    int i;
+
+    for( i = 0; i + 1 < nCount; i += 2 )
+        GWKStoreShort_SSE2( GWKBilinear2_SSE2( panSrc, nSrcXSize, 
+                                               padfSrcX + i, padfSrcY + i ),
+                            0.5, panDstOffset + i, panDst );
+
+    for( ; i < nCount; i++ )
+        panDst[panDstOffset[i]] = (GInt16)
+            (0.5 + GWKBilinearInterior( panSrc, nSrcXSize,
+                                        padfSrcX[i], padfSrcY[i] ));
+}
+
+static void GWKCubicRowShort_SSE2( const GInt16 *panSrc, int nSrcXSize,
+                                   int nCount, const double *padfSrcX,
+                                   const double *padfSrcY,
+                                   const int *panDstOffset, GInt16 *panDst )
+
+{
+    int i;
+
+    for( i = 0; i + 1 < nCount; i += 2 )
+        GWKStoreShort_SSE2( GWKCubic2_SSE2( panSrc, nSrcXSize, 
+                                            padfSrcX + i, padfSrcY + i ),
+                            0.0, panDstOffset + i, panDst );
+
+    for( ; i < nCount; i++ )
+        panDst[panDstOffset[i]] = (GInt16)
+            GWKCubicInterior( panSrc, nSrcXSize, padfSrcX[i], padfSrcY[i] );
+}
+
+static const GWKSIMDFuncs sSSE2Funcs = 
+{
+    "SSE2",
+    GWKBilinearRowByte_SSE2,
+    GWKCubicRowByte_SSE2,
+    GWKBilinearRowShort_SSE2,
+    GWKCubicRowShort_SSE2
+};
+
+#endif /* def HAVE_GWK_SSE2 */
+
+#ifdef HAVE_GWK_AVX2
+
+/************************************************************************/
+/* ==================================================================== */
+/*                          AVX2 resamplers                             */
+/*                                                                      */
+/*      Four pixels per iteration.  The source taps are fetched with    */
+/*      32 bit gathers: a gather at a tap offset returns two 16 bit,    */
+/*      or four 8 bit, horizontally adjacent source pixels.  The upper  */
+/*      halves of the ymm registers are cleared after the vector loop,  */
+/*      or the SSE code that follows (the scalar tail, the rest of the  */
+/*      warp kernel, libm) pays a state transition on every instruction */
+/*      on some CPUs.                                                   */
+/* ==================================================================== */
+/************************************************************************/
+
+GWK_AVX2
+static void GWKSplitCoords_AVX2( const double *padfSrcX,
+                                 const double *padfSrcY, int nSrcXSize,
+                                 __m256d &xSrcX, __m256d &xSrcY,
+                                 __m256d &xFloorX, __m256d &xFloorY,
+                                 __m128i &xiOffset )
+
+{
+    __m256d xHalf = _mm256_set1_pd( 0.5 );
+
+    xSrcX = _mm256_loadu_pd( padfSrcX );
+    xSrcY = _mm256_loadu_pd( padfSrcY );
+
+    __m128i xiX = _mm256_cvttpd_epi32( _mm256_sub_pd( xSrcX, xHalf ) );
+    __m128i xiY = _mm256_cvttpd_epi32( _mm256_sub_pd( xSrcY, xHalf ) );
+
+    xiOffset = _mm_add_epi32( xiX, _mm_mullo_epi32( xiY, 
+                                                    _mm_set1_epi32(nSrcXSize) ));
+    xFloorX = _mm256_cvtepi32_pd( xiX );
+    xFloorY = _mm256_cvtepi32_pd( xiY );
+}
+
+/* -------------------------------------------------------------------- */
+/*      Split gathered words in their 8 or 16 bit components.           */
+/* -------------------------------------------------------------------- */
+GWK_AVX2
+static __m256d GWKByteOfWord_AVX2( __m128i xiWord, int iByte )
+
+{
+    return _mm256_cvtepi32_pd(
+        _mm_and_si128( _mm_srli_epi32( xiWord, iByte * 8 ), 
+                       _mm_set1_epi32( 0xff ) ) );
+}
+
+GWK_AVX2
+static __m256d GWKLowShortOfWord_AVX2( __m128i xiWord )
+
+{
+    return _mm256_cvtepi32_pd( _mm_srai_epi32( _mm_slli_epi32( xiWord, 16 ),
+                                               16 ) );
+}
+
+GWK_AVX2
+static __m256d GWKHighShortOfWord_AVX2( __m128i xiWord )
+
+{
+    return _mm256_cvtepi32_pd( _mm_srai_epi32( xiWord, 16 ) );
+}
+
+/* -------------------------------------------------------------------- */
+/*      Bilinear weighting of the four taps, as in GWKBilinear2_SSE2(). */
+/* -------------------------------------------------------------------- */
+GWK_AVX2
+static __m256d GWKBilinearWeight_AVX2( __m256d xSrcX, __m256d xSrcY,
+                                       __m256d xFloorX, __m256d xFloorY,
+                                       __m256d xUL, __m256d xUR, 
+                                       __m256d xLR, __m256d xLL )
+
+{
+    __m256d xOne = _mm256_set1_pd( 1.0 );
+    __m256d xOneHalf = _mm256_set1_pd( 1.5 );
+    __m256d xRatioX = _mm256_sub_pd( xOneHalf, 
+                                     _mm256_sub_pd( xSrcX, xFloorX ) );
+    __m256d xRatioY = _mm256_sub_pd( xOneHalf,
+                                     _mm256_sub_pd( xSrcY, xFloorY ) );
+    __m256d xInvRatioX = _mm256_sub_pd( xOne, xRatioX );
+    __m256d xInvRatioY = _mm256_sub_pd( xOne, xRatioY );
+    __m256d xMult1 = _mm256_mul_pd( xRatioX, xRatioY );
+    __m256d xMult2 = _mm256_mul_pd( xInvRatioX, xRatioY );
+    __m256d xMult3 = _mm256_mul_pd( xInvRatioX, xInvRatioY );
+    __m256d xMult4 = _mm256_mul_pd( xRatioX, xInvRatioY );
+
+    __m256d xAcc = _mm256_mul_pd( xUL, xMult1 );
+    xAcc = _mm256_add_pd( xAcc, _mm256_mul_pd( xUR, xMult2 ) );
+    xAcc = _mm256_add_pd( xAcc, _mm256_mul_pd( xLR, xMult3 ) );
+    xAcc = _mm256_add_pd( xAcc, _mm256_mul_pd( xLL, xMult4 ) );
+
+    __m256d xDiv = _mm256_add_pd( _mm256_add_pd( _mm256_add_pd( xMult1, 
+                                                                xMult2 ),
+                                                 xMult3 ), xMult4 );
+
+    return _mm256_div_pd( xAcc, xDiv );
+}
+
+GWK_AVX2
+static __m256d GWKCubicConvolution_AVX2( __m256d xD1, __m256d xD2,
+                                         __m256d xD3, __m256d f0,
+                                         __m256d f1, __m256d f2, __m256d f3 )
+
+{
+    __m256d xA = _mm256_add_pd( _mm256_sub_pd( _mm256_sub_pd( f1, f0 ), f2 ),
+                                f3 );
+    __m256d xB = _mm256_sub_pd(
+        _mm256_add_pd( _mm256_mul_pd( _mm256_set1_pd( 2.0 ),
+                                      _mm256_sub_pd( f0, f1 ) ), f2 ), f3 );
+    __m256d xC = _mm256_sub_pd( f2, f0 );
+
+    return _mm256_add_pd(
+        _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( xA, xD3 ),
+                                      _mm256_mul_pd( xB, xD2 ) ),
+                       _mm256_mul_pd( xC, xD1 ) ), f1 );
+}
+
+/* -------------------------------------------------------------------- */
+/*      Output conversions.                                             */
+/* -------------------------------------------------------------------- */
+GWK_AVX2
+static void GWKStoreByte_AVX2( __m256d xValue, const int *panDstOffset,
+                               GByte *pabyDst )
+
+{
+    int     anValue[4];
+
+    xValue = _mm256_min_pd( _mm256_max_pd( xValue, _mm256_setzero_pd() ),
+                            _mm256_set1_pd( 255.0 ) );
+    _mm_storeu_si128( (__m128i *) anValue,
+                      _mm256_cvttpd_epi32( 
+                          _mm256_add_pd( xValue, _mm256_set1_pd( 0.5 ) ) ) );
+    pabyDst[panDstOffset[0]] = (GByte) anValue[0];
+    pabyDst[panDstOffset[1]] = (GByte) anValue[1];
+    pabyDst[panDstOffset[2]] = (GByte) anValue[2];
+    pabyDst[panDstOffset[3]] = (GByte) anValue[3];
+}
+
+GWK_AVX2
+static void GWKStoreShort_AVX2( __m256d xValue, double dfRound,
+                                const int *panDstOffset, GInt16 *panDst )
+
+{
+    int     anValue[4];
+
+    _mm_storeu_si128( (__m128i *) anValue,
+                      _mm256_cvttpd_epi32( 
+                          _mm256_add_pd( xValue, 
+                                         _mm256_set1_pd( dfRound ) ) ) );
+    panDst[panDstOffset[0]] = (GInt16) anValue[0];
+    panDst[panDstOffset[1]] = (GInt16) anValue[1];
+    panDst[panDstOffset[2]] = (GInt16) anValue[2];
+    panDst[panDstOffset[3]] = (GInt16) anValue[3];
+}
+
+/************************************************************************/
+/*                         AVX2 row functions.                          */
+/************************************************************************/
+
+GWK_AVX2
+static void GWKBilinearRowByte_AVX2( const GByte *pabySrc, int nSrcXSize,
+                                     int nCount, const double *padfSrcX,
+                                     const double *padfSrcY,
+                                     const int *panDstOffset, GByte *pabyDst )
+
+{
+    const int *panBase = (const int *) pabySrc;
+    int i;
+
+    for( i = 0; i + 3 < nCount; i += 4 )
+    {
+        __m256d xSrcX, xSrcY, xFloorX, xFloorY;
+        __m128i xiOffset;
+
+        GWKSplitCoords_AVX2( padfSrcX + i, padfSrcY + i, nSrcXSize, 
+                             xSrcX, xSrcY, xFloorX, xFloorY, xiOffset );
+
+        // The words are gathered two bytes before the taps so that the
+        // read never goes past the end of the source buffer.  The few
+        // pixels of the very start of the buffer are done one at a time.
+        __m128i xiStart = _mm_sub_epi32( xiOffset, _mm_set1_epi32( 2 ) );
+
+        if( _mm_movemask_ps( _mm_castsi128_ps( 
+                _mm_cmplt_epi32( xiStart, _mm_setzero_si128() ) ) ) != 0 )
+        {
+            int j;
+
+            for( j = i; j < i + 4; j++ )
+                pabyDst[panDstOffset[j]] = 
+                    GWKClampByte( GWKBilinearInterior( pabySrc, nSrcXSize,
+                                                       padfSrcX[j], 
+                                                       padfSrcY[j] ) );
+            continue;
+        }
+
+        __m128i xiUp = _mm_i32gather_epi32( panBase, xiStart, 1 );
+        __m128i xiDown = _mm_i32gather_epi32( 
+            panBase, _mm_add_epi32( xiStart, _mm_set1_epi32( nSrcXSize ) ),
+            1 );
+
+        GWKStoreByte_AVX2(
+            GWKBilinearWeight_AVX2( xSrcX, xSrcY, xFloorX, xFloorY,
+                                    GWKByteOfWord_AVX2( xiUp, 2 ),
+                                    GWKByteOfWord_AVX2( xiUp, 3 ),
+                                    GWKByteOfWord_AVX2( xiDown, 3 ),
+                                    GWKByteOfWord_AVX2( xiDown, 2 ) ),
+            panDstOffset + i, pabyDst );
+    }
+
+    _mm256_zeroupper();
+
+    for( ; i < nCount; i++ )
+        pabyDst[panDstOffset[i]] = 
+            GWKClampByte( GWKBilinearInterior( pabySrc, nSrcXSize,
+                                               padfSrcX[i], padfSrcY[i] ) );
+}
+
+GWK_AVX2
+static void GWKBilinearRowShort_AVX2( const GInt16 *panSrc, int nSrcXSize,
+                                      int nCount, const double *padfSrcX,
+                                      const double *padfSrcY,
+                                      const int *panDstOffset, GInt16 *panDst )
+
+{
+    const int *panBase = (const int *) panSrc;
+    int i;
+
+    for( i = 0; i + 3 < nCount; i += 4 )
+    {
+        __m256d xSrcX, xSrcY, xFloorX, xFloorY;
+        __m128i xiOffset;
+
+        GWKSplitCoords_AVX2( padfSrcX + i, padfSrcY + i, nSrcXSize, 
+                             xSrcX, xSrcY, xFloorX, xFloorY, xiOffset );
+
+        __m128i xiUp = _mm_i32gather_epi32( panBase, xiOffset, 2 );
+        __m128i xiDown = _mm_i32gather_epi32( 
+            panBase, _mm_add_epi32( xiOffset, _mm_set1_epi32( nSrcXSize ) ),
+            2 );
+
+        GWKStoreShort_AVX2(
+            GWKBilinearWeight_AVX2( xSrcX, xSrcY, xFloorX, xFloorY,
+                                    GWKLowShortOfWord_AVX2( xiUp ),
+                                    GWKHighShortOfWord_AVX2( xiUp ),
+                                    GWKHighShortOfWord_AVX2( xiDown ),
+                                    GWKLowShortOfWord_AVX2( xiDown ) ),
+            0.5, panDstOffset + i, panDst );
+    }
+
+    _mm256_zeroupper();
+
+    for( ; i < nCount; i++ )
+        panDst[panDstOffset[i]] = (GInt16)
+            (0.5 + GWKBilinearInterior( panSrc, nSrcXSize,
+                                        padfSrcX[i], padfSrcY[i] ));
+}
+
+/* -------------------------------------------------------------------- */
+/*      Cubic: returns the interpolated values of four pixels, the      */
+/*      source rows being fetched by pfnRow.                            */
+/* -------------------------------------------------------------------- */
+GWK_AVX2
+static void GWKCubicDeltas_AVX2( __m256d xSrc, __m256d xFloor, 
+                                 __m256d &xD1, __m256d &xD2, __m256d &xD3 )
+
+{
+    xD1 = _mm256_sub_pd( _mm256_sub_pd( xSrc, _mm256_set1_pd( 0.5 ) ),
+                         xFloor );
+    xD2 = _mm256_mul_pd( xD1, xD1 );
+    xD3 = _mm256_mul_pd( xD2, xD1 );
+}
+
+GWK_AVX2
+static void GWKCubicRowByte_AVX2( const GByte *pabySrc, int nSrcXSize,
+                                  int nCount, const double *padfSrcX,
+                                  const double *padfSrcY,
+                                  const int *panDstOffset, GByte *pabyDst )
+
+{
+    const int *panBase = (const int *) pabySrc;
+    int i;
+
+    for( i = 0; i + 3 < nCount; i += 4 )
+    {
+        __m256d xSrcX, xSrcY, xFloorX, xFloorY;
+        __m256d xDX, xDX2, xDX3, xDY, xDY2, xDY3;
+        __m256d axValue[4];
+        __m128i xiOffset;
+        int     iRow;
+
+        GWKSplitCoords_AVX2( padfSrcX + i, padfSrcY + i, nSrcXSize, 
+                             xSrcX, xSrcY, xFloorX, xFloorY, xiOffset );
+        GWKCubicDeltas_AVX2( xSrcX, xFloorX, xDX, xDX2, xDX3 );
+        GWKCubicDeltas_AVX2( xSrcY, xFloorY, xDY, xDY2, xDY3 );
+
+        // One gather returns the four taps of a row.
+        __m128i xiRow = _mm_sub_epi32( xiOffset, 
+                                       _mm_set1_epi32( nSrcXSize + 1 ) );
+
+        for( iRow = 0; iRow < 4; iRow++ )
+        {
+            __m128i xiTaps = _mm_i32gather_epi32( panBase, xiRow, 1 );
+
+            axValue[iRow] = 
+                GWKCubicConvolution_AVX2( xDX, xDX2, xDX3,
+                                          GWKByteOfWord_AVX2( xiTaps, 0 ),
+                                          GWKByteOfWord_AVX2( xiTaps, 1 ),
+                                          GWKByteOfWord_AVX2( xiTaps, 2 ),
+                                          GWKByteOfWord_AVX2( xiTaps, 3 ) );
+
+            xiRow = _mm_add_epi32( xiRow, _mm_set1_epi32( nSrcXSize ) );
+        }
+
+        GWKStoreByte_AVX2(
+            GWKCubicConvolution_AVX2( xDY, xDY2, xDY3, axValue[0], axValue[1],
+                                      axValue[2], axValue[3] ),
+            panDstOffset + i, pabyDst );
+    }
+
+    _mm256_zeroupper();
+
+    for( ; i < nCount; i++ )
+        pabyDst[panDstOffset[i]] = 
+            GWKClampByte( GWKCubicInterior( pabySrc, nSrcXSize,
+                                            padfSrcX[i], padfSrcY[i] ) );
+}
+
+GWK_AVX2
+static void GWKCubicRowShort_AVX2( const GInt16 *panSrc, int nSrcXSize,
+                                   int nCount, const double *padfSrcX,
+                                   const double *padfSrcY,
+                                   const int *panDstOffset, GInt16 *panDst )
+
+{
+    const int *panBase = (const int *) panSrc;
+    int i;
+
+    for( i = 0; i + 3 < nCount; i += 4 )
+    {
+        __m256d xSrcX, xSrcY, xFloorX, xFloorY;
+        __m256d xDX, xDX2, xDX3, xDY, xDY2, xDY3;
+        __m256d axValue[4];
+        __m128i xiOffset;
+        int     iRow;
+
+        GWKSplitCoords_AVX2( padfSrcX + i, padfSrcY + i, nSrcXSize, 
+                             xSrcX, xSrcY, xFloorX, xFloorY, xiOffset );
+        GWKCubicDeltas_AVX2( xSrcX, xFloorX, xDX, xDX2, xDX3 );
+        GWKCubicDeltas_AVX2( xSrcY, xFloorY, xDY, xDY2, xDY3 );
+
+        // Two gathers return the four taps of a row.
+        __m128i xiRow = _mm_sub_epi32( xiOffset, 
+                                       _mm_set1_epi32( nSrcXSize + 1 ) );
+
+        for( iRow = 0; iRow < 4; iRow++ )
+        {
+            __m128i xiLeft = _mm_i32gather_epi32( panBase, xiRow, 2 );
+            __m128i xiRight = _mm_i32gather_epi32( 
+                panBase, _mm_add_epi32( xiRow, _mm_set1_epi32( 2 ) ), 2 );
+
+            axValue[iRow] = 
+                GWKCubicConvolution_AVX2( xDX, xDX2, xDX3,
+                                          GWKLowShortOfWord_AVX2( xiLeft ),
+                                          GWKHighShortOfWord_AVX2( xiLeft ),
+                                          GWKLowShortOfWord_AVX2( xiRight ),
+                                          GWKHighShortOfWord_AVX2( xiRight ));
+
+            xiRow = _mm_add_epi32( xiRow, _mm_set1_epi32( nSrcXSize ) );
+        }
+
+        GWKStoreShort_AVX2(
+            GWKCubicConvolution_AVX2( xDY, xDY2, xDY3, axValue[0], axValue[1],
+                                      axValue[2], axValue[3] ),
+            0.0, panDstOffset + i, panDst );
+    }
+
+    _mm256_zeroupper();
+
+    for( ; i < nCount; i++ )
+        panDst[panDstOffset[i]] = (GInt16)
+            GWKCubicInterior( panSrc, nSrcXSize, padfSrcX[i], padfSrcY[i] );
+}
+
+static const GWKSIMDFuncs sAVX2Funcs = 
+{
+    "AVX2",
+    GWKBilinearRowByte_AVX2,
+    GWKCubicRowByte_AVX2,
+    GWKBilinearRowShort_AVX2,
+    GWKCubicRowShort_AVX2
+};
+
+/************************************************************************/
+/*                            GWKHasAVX2()                              */
+/************************************************************************/
+
+static int GWKHasAVX2()
+
+{
+    static int bHasAVX2 = -1;
+
+    if( bHasAVX2 < 0 )
+    {
+        __builtin_cpu_init();
+        bHasAVX2 = __builtin_cpu_supports( "avx2" ) ? TRUE : FALSE;
+    }
+
+    return bHasAVX2;
+}
+
+#endif /* def HAVE_GWK_AVX2 */
+
+/************************************************************************/
+/*                          GWKGetSIMDFuncs()                           */
+/*                                                                      */
+/*      Return the best set of vector row resamplers available on       */
+/*      this CPU, or NULL if the scalar code should be used.  The       */
+/*      GDAL_WARP_SIMD configuration option may be set to NO, SSE2      */
+/*      or AVX2 to restrict the choice, mostly for benchmarking.        */
+/************************************************************************/
+
+const GWKSIMDFuncs *GWKGetSIMDFuncs()
+
+{
+    const char *pszSIMD = CPLGetConfigOption( "GDAL_WARP_SIMD", "YES" );
+
+    if( !CSLTestBoolean( pszSIMD ) )
+        return NULL;
+
+#ifdef HAVE_GWK_AVX2
+    if( !EQUAL(pszSIMD,"SSE2") && GWKHasAVX2() )
+        return &sAVX2Funcs;
+#endif
+
+#ifdef HAVE_GWK_SSE2
+    return &sSSE2Funcs;
+#else
+    return NULL;
+#endif
+}
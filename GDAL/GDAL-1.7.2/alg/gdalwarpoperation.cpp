@@ -28,8 +28,10 @@
  ****************************************************************************/
 
 #include "gdalwarper.h"
+#include "gdal_alg_priv.h"
 #include "cpl_string.h"
 #include "cpl_multiproc.h"
+#include "cpl_worker_thread_pool.h"
 #include "ogr_api.h"
 
 CPL_CVSID("$Id$");
@@ -124,11 +126,11 @@ GDALWarpOperation::GDALWarpOperation()
     dfProgressBase = 0.0;
     dfProgressScale = 1.0;
 
-    hThread1Mutex = NULL;
-    hThread2Mutex = NULL;
     hIOMutex = NULL;
     hWarpMutex = NULL;
 
+    nKernelThreads = 0;
+
     nChunkListCount = 0;
     nChunkListMax = 0;
     panChunkList = NULL;
@@ -146,13 +148,10 @@ GDALWarpOperation::~GDALWarpOperation()
 {
     WipeOptions();
 
-    if( hThread1Mutex != NULL )
-    {
-        CPLDestroyMutex( hThread1Mutex );
-        CPLDestroyMutex( hThread2Mutex );
+    if( hIOMutex != NULL )
         CPLDestroyMutex( hIOMutex );
+    if( hWarpMutex != NULL )
         CPLDestroyMutex( hWarpMutex );
-    }
 
     WipeChunkList();
 }
@@ -712,41 +711,104 @@ CPLErr GDALChunkAndWarpImage( GDALWarpOperationH hOperation,
         ChunkAndWarpImage( nDstXOff, nDstYOff, nDstXSize, nDstYSize );
 }
 
+/************************************************************************/
+/*                          GDALWarpMultiJob                            */
+/*                                                                      */
+/*      State shared by the worker threads of ChunkAndWarpMulti().      */
+/************************************************************************/
+
+typedef struct
+{
+    GDALWarpOperation *poOperation;
+    int               *panChunkList;
+
+    /* transformers not in use by a chunk, the last nFreeTransformers ones */
+    void             **papTransformerArgs;
+    int                nFreeTransformers;
+
+    void              *hProgressMutex;
+    GDALProgressFunc   pfnProgress;
+    void              *pProgressArg;
+    double             dfPixelsProcessed;
+    double             dfTotalPixels;
+    volatile int       bAbort;
+} GDALWarpMultiJob;
+
+/************************************************************************/
+/*                        GDALWarpMultiProgress()                       */
+/*                                                                      */
+/*      Progress function installed on the warp kernels while           */
+/*      chunks are processed concurrently.  Progress is reported        */
+/*      once per completed chunk instead, so here we only propagate     */
+/*      user interruption.                                              */
+/************************************************************************/
+
+static int CPL_STDCALL GDALWarpMultiProgress( double, const char *, 
+                                              void *pProgressArg )
+
+{
+    GDALWarpMultiJob *psJob = (GDALWarpMultiJob *) pProgressArg;
+
+    return !psJob->bAbort;
+}
+
 /************************************************************************/
 /*                          ChunkThreadMain()                           */
 /************************************************************************/
 
-static void ChunkThreadMain( void *pThreadData )
+static int ChunkThreadMain( void *pJobData, int iChunk )
 
 {
-    void *hThreadMutex = ((void **) pThreadData)[0];
-    GDALWarpOperation *poOperation = 
-        (GDALWarpOperation *) (((void **) pThreadData)[1]);
-    int *panChunkInfo = (int *) (((void **) pThreadData)[2]);
+    GDALWarpMultiJob *psJob = (GDALWarpMultiJob *) pJobData;
+    int *panChunkInfo = psJob->panChunkList + iChunk * 8;
+
+    if( psJob->bAbort )
+        return FALSE;
 
-    if( !CPLAcquireMutex( hThreadMutex, 2.0 ) )
+    void *pTransformerArg;
     {
-        CPLError( CE_Failure, CPLE_AppDefined, 
-                  "Failed to acquire thread mutex in ChunkThreadMain()." );
-        return;
+        CPLMutexHolderD( &(psJob->hProgressMutex) );
+        pTransformerArg = 
+            psJob->papTransformerArgs[--psJob->nFreeTransformers];
     }
 
-    CPLErr eErr;
+    CPLDebug( "GDAL", "Start chunk %d.", iChunk );
+
+    CPLErr eErr = 
+        psJob->poOperation->WarpRegion( panChunkInfo[0], panChunkInfo[1], 
+                                        panChunkInfo[2], panChunkInfo[3], 
+                                        panChunkInfo[4], panChunkInfo[5], 
+                                        panChunkInfo[6], panChunkInfo[7],
+                                        pTransformerArg );
 
-    eErr = 
-        poOperation->WarpRegion( panChunkInfo[0], panChunkInfo[1], 
-                                 panChunkInfo[2], panChunkInfo[3], 
-                                 panChunkInfo[4], panChunkInfo[5], 
-                                 panChunkInfo[6], panChunkInfo[7] );
+    CPLDebug( "GDAL", "Finished chunk %d.", iChunk );
 
-    /* Return error. */
-    ((void **) pThreadData)[2] = (void *) (long) eErr;
+/* -------------------------------------------------------------------- */
+/*      Report progress.  Chunks complete in any order, so we report    */
+/*      the accumulated number of pixels processed.                     */
+/* -------------------------------------------------------------------- */
+    CPLMutexHolderD( &(psJob->hProgressMutex) );
 
-    /* Marks that we are done. */
-    ((void **) pThreadData)[1] = NULL;
+    psJob->papTransformerArgs[psJob->nFreeTransformers++] = pTransformerArg;
+
+    if( eErr != CE_None )
+    {
+        psJob->bAbort = TRUE;
+        return FALSE;
+    }
+
+    psJob->dfPixelsProcessed += panChunkInfo[2] * (double) panChunkInfo[3];
+
+    if( psJob->pfnProgress != NULL && !psJob->bAbort
+        && !psJob->pfnProgress( psJob->dfPixelsProcessed 
+                                / psJob->dfTotalPixels, 
+                                "", psJob->pProgressArg ) )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        psJob->bAbort = TRUE;
+    }
 
-    /* Release mutex so parent knows we are done. */
-    CPLReleaseMutex( hThreadMutex );
+    return !psJob->bAbort;
 }
 
 /************************************************************************/
@@ -762,8 +824,22 @@ static void ChunkThreadMain( void *pThreadData )
  * Progress is reported to the installed progress monitor, if any.  
  *
  * Externally this method operates the same as ChunkAndWarpImage(), but
- * internally this method uses multiple threads to interleave input/output
- * for one region while the processing is being done for another.
+ * internally this method uses a pool of worker threads that take chunks
+ * from the chunk list as soon as they are done with the previous one.  
+ * Reading the source and destination data, and writing the destination 
+ * data, are serialized since datasets cannot be accessed from several 
+ * threads at once, but the warp kernels of different chunks run 
+ * concurrently.  Each chunk is processed exactly as in 
+ * ChunkAndWarpImage(), so the result is identical.  Each thread uses its 
+ * own copy of the transformer.  Transformers that cannot be copied, as
+ * application provided ones, are only used from one thread, so the
+ * chunks are then processed one after the other.
+ *
+ * The number of worker threads is taken from the NUM_THREADS warp option, 
+ * which may be a number or ALL_CPUS, and defaults to 2.  When there are 
+ * fewer chunks than threads, the spare threads are handed to the warp 
+ * kernels which then split their chunk in bands of rows.  Progress is 
+ * reported as chunks are completed.
  *
  * @param nDstXOff X offset to window of destination data to be produced.
  * @param nDstYOff Y offset to window of destination data to be produced.
@@ -777,15 +853,11 @@ CPLErr GDALWarpOperation::ChunkAndWarpMulti(
     int nDstXOff, int nDstYOff,  int nDstXSize, int nDstYSize )
 
 {
-    hThread1Mutex = CPLCreateMutex();
-    hThread2Mutex = CPLCreateMutex();
-    hIOMutex = CPLCreateMutex();
-    hWarpMutex = CPLCreateMutex();
-
-    CPLReleaseMutex( hThread1Mutex );
-    CPLReleaseMutex( hThread2Mutex );
-    CPLReleaseMutex( hIOMutex );
-    CPLReleaseMutex( hWarpMutex );
+    if( hIOMutex == NULL )
+    {
+        hIOMutex = CPLCreateMutex();
+        CPLReleaseMutex( hIOMutex );
+    }
 
 /* -------------------------------------------------------------------- */
 /*      Collect the list of chunks to operate on.                       */
@@ -797,90 +869,83 @@ CPLErr GDALWarpOperation::ChunkAndWarpMulti(
     qsort(panChunkList, nChunkListCount, sizeof(WarpChunk), OrderWarpChunk); 
 
 /* -------------------------------------------------------------------- */
-/*      Process them one at a time, updating the progress               */
-/*      information for each region.                                    */
+/*      Setup the shared job state.  The kernels of the individual      */
+/*      chunks only check for interruption through our progress         */
+/*      function, as per chunk progress ranges would overlap.           */
 /* -------------------------------------------------------------------- */
-    void * volatile papThreadDataList[6] = { hThread1Mutex, NULL, NULL, 
-                                            hThread2Mutex, NULL, NULL };
-    int iChunk;
-    double dfPixelsProcessed=0.0, dfTotalPixels = nDstXSize*(double)nDstYSize;
-    CPLErr eErr = CE_None;
+    GDALWarpMultiJob sJob;
+    int nThreads = CPLParseNumThreads( 
+        CSLFetchNameValue( psOptions->papszWarpOptions, "NUM_THREADS" ), 2 );
 
-    for( iChunk = 0; iChunk < nChunkListCount+1; iChunk++ )
-    {
-        int    iThread = iChunk % 2;
+    sJob.poOperation = this;
+    sJob.panChunkList = panChunkList;
+    sJob.hProgressMutex = NULL;
+    sJob.pfnProgress = psOptions->pfnProgress;
+    sJob.pProgressArg = psOptions->pProgressArg;
+    sJob.dfPixelsProcessed = 0.0;
+    sJob.dfTotalPixels = nDstXSize * (double) nDstYSize;
+    sJob.bAbort = FALSE;
 
-/* -------------------------------------------------------------------- */
-/*      Launch thread for this chunk.                                   */
-/* -------------------------------------------------------------------- */
-        if( iChunk < nChunkListCount )
-        {
-            int *panThisChunk = panChunkList + iChunk*8;
-            double dfChunkPixels = panThisChunk[2] * (double) panThisChunk[3];
+    psOptions->pfnProgress = GDALWarpMultiProgress;
+    psOptions->pProgressArg = &sJob;
 
-            dfProgressBase = dfPixelsProcessed / dfTotalPixels;
-            dfProgressScale = dfChunkPixels / dfTotalPixels;
+    dfProgressBase = 0.0;
+    dfProgressScale = 1.0;
 
-            dfPixelsProcessed += dfChunkPixels;
-            
-            papThreadDataList[iThread*3+1] = (void *) this;
-            papThreadDataList[iThread*3+2] = (void *) panThisChunk;
+    int nChunkThreads = MAX( 1, MIN(nThreads, nChunkListCount) );
 
-            CPLDebug( "GDAL", "Start chunk %d.", iChunk );
-            if( CPLCreateThread( ChunkThreadMain, 
-                          (void *) (papThreadDataList + iThread*3)) == -1 )
-            {
-                CPLError( CE_Failure, CPLE_AppDefined, 
-                          "CPLCreateThread() failed in ChunkAndWarpMulti()" );
-                return CE_Failure;
-            }
+/* -------------------------------------------------------------------- */
+/*      Give each thread its own copy of the transformer, as            */
+/*      transformers keep state between calls.  If it cannot be         */
+/*      copied, fall back to a single thread.                           */
+/* -------------------------------------------------------------------- */
+    int iThread;
 
-            /* Eventually we need a mechanism to ensure we wait for this 
-               thread to acquire the IO mutex before proceeding. */
-            if( iChunk == 0 )
-                CPLSleep( 0.25 );
+    sJob.papTransformerArgs = (void **) 
+        CPLMalloc(sizeof(void*) * nChunkThreads);
+    sJob.papTransformerArgs[0] = psOptions->pTransformerArg;
+    for( iThread = 1; iThread < nChunkThreads; iThread++ )
+    {
+        sJob.papTransformerArgs[iThread] = 
+            GDALCloneTransformer( psOptions->pfnTransformer, 
+                                  psOptions->pTransformerArg );
+        if( sJob.papTransformerArgs[iThread] == NULL )
+        {
+            CPLDebug( "GDAL", 
+                      "Transformer cannot be copied, warping on one thread." );
+            while( --iThread > 0 )
+                GDALDestroyTransformer( sJob.papTransformerArgs[iThread] );
+            nThreads = nChunkThreads = 1;
+            break;
         }
+    }
+    sJob.nFreeTransformers = nChunkThreads;
+
+    nKernelThreads = MAX( 1, nThreads / nChunkThreads );
+
+    CPLDebug( "GDAL", "Warping %d chunks with %d threads, %d per kernel.", 
+              nChunkListCount, nChunkThreads, nKernelThreads );
 
-        
 /* -------------------------------------------------------------------- */
-/*      Wait for previous chunks thread to complete.                    */
+/*      Process the chunks.                                             */
 /* -------------------------------------------------------------------- */
-        if( iChunk > 0 )
-        {
-            iThread = (iChunk-1) % 2;
-            
-            /* Wait for thread to finish. */
-            while( papThreadDataList[iThread*3+1] != NULL )
-            {
-                if( CPLAcquireMutex( papThreadDataList[iThread*3+0], 1.0 ) )
-                    CPLReleaseMutex( papThreadDataList[iThread*3+0] );
-            }
+    int bSuccess = CPLRunJobs( nChunkListCount, nChunkThreads, 
+                               ChunkThreadMain, &sJob );
 
-            CPLDebug( "GDAL", "Finished chunk %d.", iChunk-1 );
+    psOptions->pfnProgress = sJob.pfnProgress;
+    psOptions->pProgressArg = sJob.pProgressArg;
+    nKernelThreads = 0;
 
-            eErr = (CPLErr) (long) (GIntBig) papThreadDataList[iThread*3+2];
+    if( sJob.hProgressMutex != NULL )
+        CPLDestroyMutex( sJob.hProgressMutex );
 
-            if( eErr != CE_None )
-                break;
-        }
-    }
-
-    /* -------------------------------------------------------------------- */
-    /*      Wait for all threads to complete.                               */
-    /* -------------------------------------------------------------------- */
-    int iThread;
-    for(iThread = 0; iThread < 2; iThread ++)
-    {
-        while( papThreadDataList[iThread*3+1] != NULL )
-        {
-            if( CPLAcquireMutex( papThreadDataList[iThread*3+0], 1.0 ) )
-                CPLReleaseMutex( papThreadDataList[iThread*3+0] );
-        }
-    }
+    for( iThread = 1; iThread < nChunkThreads; iThread++ )
+        GDALDestroyTransformer( sJob.papTransformerArgs[iThread] );
+    CPLFree( sJob.papTransformerArgs );
 
     WipeChunkList();
 
-    return eErr;
+    return (bSuccess) ? CE_None : CE_Failure;
 }
 
 /************************************************************************/
@@ -929,7 +994,8 @@ CPLErr GDALWarpOperation::CollectChunkList(
     CPLErr eErr;
 
     eErr = ComputeSourceWindow( nDstXOff, nDstYOff, nDstXSize, nDstYSize,
-                                &nSrcXOff, &nSrcYOff, &nSrcXSize, &nSrcYSize );
+                                &nSrcXOff, &nSrcYOff, &nSrcXSize, &nSrcYSize,
+                                psOptions->pTransformerArg );
     
     if( eErr != CE_None )
         return eErr;
@@ -1115,6 +1181,25 @@ CPLErr GDALWarpOperation::WarpRegion( int nDstXOff, int nDstYOff,
                                       int nSrcXOff, int nSrcYOff,
                                       int nSrcXSize, int nSrcYSize )
 
+{
+    return WarpRegion( nDstXOff, nDstYOff, nDstXSize, nDstYSize,
+                       nSrcXOff, nSrcYOff, nSrcXSize, nSrcYSize,
+                       psOptions->pTransformerArg );
+}
+
+/************************************************************************/
+/*                             WarpRegion()                             */
+/*                                                                      */
+/*      Warp with the given transformer, which ChunkAndWarpMulti()      */
+/*      uses to give each thread its own copy of the transformer.       */
+/************************************************************************/
+
+CPLErr GDALWarpOperation::WarpRegion( int nDstXOff, int nDstYOff, 
+                                      int nDstXSize, int nDstYSize,
+                                      int nSrcXOff, int nSrcYOff,
+                                      int nSrcXSize, int nSrcYSize,
+                                      void *pTransformerArg )
+
 {
     CPLErr eErr;
     int   iBand;
@@ -1147,6 +1232,8 @@ CPLErr GDALWarpOperation::WarpRegion( int nDstXOff, int nDstYOff,
         CPLError( CE_Failure, CPLE_AppDefined,
                   "Integer overflow : nDstXSize=%d, nDstYSize=%d",
                   nDstXSize, nDstYSize);
+        if( hIOMutex != NULL )
+            CPLReleaseMutex( hIOMutex );
         return CE_Failure;
     }
 
@@ -1156,6 +1243,8 @@ CPLErr GDALWarpOperation::WarpRegion( int nDstXOff, int nDstYOff,
         CPLError( CE_Failure, CPLE_OutOfMemory,
                   "Out of memory allocating %d byte destination buffer.",
                   nBandSize * psOptions->nBandCount );
+        if( hIOMutex != NULL )
+            CPLReleaseMutex( hIOMutex );
         return CE_Failure;
     }
 
@@ -1239,6 +1328,8 @@ CPLErr GDALWarpOperation::WarpRegion( int nDstXOff, int nDstYOff,
         if( eErr != CE_None )
         {
             CPLFree( pDstBuffer );
+            if( hIOMutex != NULL )
+                CPLReleaseMutex( hIOMutex );
             return eErr;
         }
 
@@ -1250,7 +1341,8 @@ CPLErr GDALWarpOperation::WarpRegion( int nDstXOff, int nDstYOff,
 /* -------------------------------------------------------------------- */
     eErr = WarpRegionToBuffer( nDstXOff, nDstYOff, nDstXSize, nDstYSize, 
                                pDstBuffer, psOptions->eWorkingDataType, 
-                               nSrcXOff, nSrcYOff, nSrcXSize, nSrcYSize );
+                               nSrcXOff, nSrcYOff, nSrcXSize, nSrcYSize,
+                               pTransformerArg );
 
 /* -------------------------------------------------------------------- */
 /*      Write the output data back to disk if all went well.            */
@@ -1347,6 +1439,25 @@ CPLErr GDALWarpOperation::WarpRegionToBuffer(
     void *pDataBuf, GDALDataType eBufDataType,
     int nSrcXOff, int nSrcYOff, int nSrcXSize, int nSrcYSize )
 
+{
+    return WarpRegionToBuffer( nDstXOff, nDstYOff, nDstXSize, nDstYSize,
+                               pDataBuf, eBufDataType,
+                               nSrcXOff, nSrcYOff, nSrcXSize, nSrcYSize,
+                               psOptions->pTransformerArg );
+}
+
+/************************************************************************/
+/*                         WarpRegionToBuffer()                         */
+/*                                                                      */
+/*      Warp with the given transformer.                                */
+/************************************************************************/
+
+CPLErr GDALWarpOperation::WarpRegionToBuffer( 
+    int nDstXOff, int nDstYOff, int nDstXSize, int nDstYSize, 
+    void *pDataBuf, GDALDataType eBufDataType,
+    int nSrcXOff, int nSrcYOff, int nSrcXSize, int nSrcYSize,
+    void *pTransformerArg )
+
 {
     CPLErr eErr = CE_None;
     int    i;
@@ -1362,7 +1473,8 @@ CPLErr GDALWarpOperation::WarpRegionToBuffer(
     {
         eErr = ComputeSourceWindow( nDstXOff, nDstYOff, nDstXSize, nDstYSize,
                                     &nSrcXOff, &nSrcYOff, 
-                                    &nSrcXSize, &nSrcYSize );
+                                    &nSrcXSize, &nSrcYSize,
+                                    pTransformerArg );
     
         if( eErr != CE_None )
             return eErr;
@@ -1378,7 +1490,7 @@ CPLErr GDALWarpOperation::WarpRegionToBuffer(
     oWK.eWorkingDataType = psOptions->eWorkingDataType;
 
     oWK.pfnTransformer = psOptions->pfnTransformer;
-    oWK.pTransformerArg = psOptions->pTransformerArg;
+    oWK.pTransformerArg = pTransformerArg;
     
     oWK.pfnProgress = psOptions->pfnProgress;
     oWK.pProgress = psOptions->pProgressArg;
@@ -1386,6 +1498,13 @@ CPLErr GDALWarpOperation::WarpRegionToBuffer(
     oWK.dfProgressScale = dfProgressScale;
 
     oWK.papszWarpOptions = psOptions->papszWarpOptions;
+
+    if( nKernelThreads > 0 )
+        oWK.nThreads = nKernelThreads;
+    else
+        oWK.nThreads = CPLParseNumThreads( 
+            CSLFetchNameValue( psOptions->papszWarpOptions, "NUM_THREADS" ),
+            1 );
     
     oWK.padfDstNoDataReal = psOptions->padfDstNoDataReal;
 
@@ -1644,12 +1763,14 @@ CPLErr GDALWarpOperation::WarpRegionToBuffer(
     }
         
 /* -------------------------------------------------------------------- */
-/*      Release IO Mutex, and acquire warper mutex.                     */
+/*      Release IO Mutex, and acquire warper mutex if there is one.     */
+/*      ChunkAndWarpMulti() lets the kernels of several chunks run      */
+/*      concurrently, so it does not create a warper mutex.             */
 /* -------------------------------------------------------------------- */
     if( hIOMutex != NULL )
     {
         CPLReleaseMutex( hIOMutex );
-        if( !CPLAcquireMutex( hWarpMutex, 600.0 ) )
+        if( hWarpMutex != NULL && !CPLAcquireMutex( hWarpMutex, 600.0 ) )
         {
             CPLError( CE_Failure, CPLE_AppDefined, 
                       "Failed to acquire WarpMutex in WarpRegion()." );
@@ -1685,7 +1806,8 @@ CPLErr GDALWarpOperation::WarpRegionToBuffer(
 /* -------------------------------------------------------------------- */
     if( hIOMutex != NULL )
     {
-        CPLReleaseMutex( hWarpMutex );
+        if( hWarpMutex != NULL )
+            CPLReleaseMutex( hWarpMutex );
         if( !CPLAcquireMutex( hIOMutex, 600.0 ) )
         {
             CPLError( CE_Failure, CPLE_AppDefined, 
@@ -1860,7 +1982,8 @@ CPLErr GDALWarpOperation::CreateKernelMask( GDALWarpKernel *poKernel,
 CPLErr GDALWarpOperation::ComputeSourceWindow(int nDstXOff, int nDstYOff, 
                                               int nDstXSize, int nDstYSize,
                                               int *pnSrcXOff, int *pnSrcYOff, 
-                                              int *pnSrcXSize, int *pnSrcYSize)
+                                              int *pnSrcXSize, int *pnSrcYSize,
+                                              void *pTransformerArg )
 
 {
 /* -------------------------------------------------------------------- */
@@ -1980,7 +2103,7 @@ CPLErr GDALWarpOperation::ComputeSourceWindow(int nDstXOff, int nDstYOff,
 /* -------------------------------------------------------------------- */
 /*      Transform them to the input pixel coordinate space              */
 /* -------------------------------------------------------------------- */
-    if( !psOptions->pfnTransformer( psOptions->pTransformerArg, 
+    if( !psOptions->pfnTransformer( pTransformerArg, 
                                     TRUE, nSamplePoints, 
                                     padfX, padfY, padfZ, pabSuccess ) )
     {
@@ -28,7 +28,11 @@
 
 #include "gdal_alg_priv.h"
 #include "cpl_conv.h"
+#include "cpl_string.h"
+#include "cpl_multiproc.h"
+#include "cpl_worker_thread_pool.h"
 #include <vector>
+#include <algorithm>
 
 CPL_CVSID("$Id$");
 
@@ -57,6 +61,7 @@ public:
     void             Dump();
     void             Coalesce();
     void             Merge( int iBaseString, int iSrcString, int iDirection );
+    void             RemoveSeamVertices( int nStripHeight );
 };
 
 /************************************************************************/
@@ -179,6 +184,54 @@ void RPolygon::Merge( int iBaseString, int iSrcString, int iDirection )
     aanXY.resize(nSize-1);
 }
 
+/************************************************************************/
+/*                         RemoveSeamVertices()                         */
+/*                                                                      */
+/*      Drop the vertices of the coalesced rings that lie on a strip    */
+/*      seam, every nStripHeight lines, where the ring goes straight    */
+/*      across it.  They come from joining the strings of adjacent      */
+/*      strips, within a strip AddSegment() extends straight strings    */
+/*      instead.                                                        */
+/************************************************************************/
+
+void RPolygon::RemoveSeamVertices( int nStripHeight )
+
+{
+    size_t iString;
+
+    for( iString = 0; iString < aanXY.size(); iString++ )
+    {
+        std::vector<int> &anString = aanXY[iString];
+        int nPoints = anString.size() / 2 - 1;
+        int i;
+
+        if( nPoints < 4 )
+            continue;
+
+        std::vector<int> anNew;
+
+        anNew.reserve( anString.size() );
+        for( i = 0; i < nPoints; i++ )
+        {
+            int iPrev = (i + nPoints - 1) % nPoints;
+            int iNext = (i + 1) % nPoints;
+            int nX = anString[i*2], nY = anString[i*2+1];
+
+            if( nY % nStripHeight == 0
+                && anString[iPrev*2] == nX && anString[iNext*2] == nX
+                && (anString[iPrev*2+1] < nY) != (anString[iNext*2+1] < nY) )
+                continue;
+
+            anNew.push_back( nX );
+            anNew.push_back( nY );
+        }
+
+        anNew.push_back( anNew[0] );
+        anNew.push_back( anNew[1] );
+        anString.swap( anNew );
+    }
+}
+
 /************************************************************************/
 /*                             AddSegment()                             */
 /************************************************************************/
@@ -264,12 +317,14 @@ void RPolygon::AddSegment( int x1, int y1, int x2, int y2 )
 /*      Examine one pixel and compare to its neighbour above            */
 /*      (previous) and right.  If they are different polygon ids        */
 /*      then add the pixel edge to this polygon and the one on the      */
-/*      other side of the edge.                                         */
+/*      other side of the edge.  Right edges can be skipped for a line  */
+/*      that only stands for the neighbours below a strip.              */
 /************************************************************************/
 
 static void AddEdges( GInt32 *panThisLineId, GInt32 *panLastLineId, 
                       GInt32 *panPolyIdMap, GInt32 *panPolyValue,
-                      RPolygon **papoPoly, int iX, int iY )
+                      RPolygon **papoPoly, int iX, int iY, 
+                      int bRightEdge = TRUE )
 
 {
     int nThisId = panThisLineId[iX];
@@ -302,7 +357,7 @@ static void AddEdges( GInt32 *panThisLineId, GInt32 *panLastLineId,
         }
     }
 
-    if( nThisId != nRightId )
+    if( bRightEdge && nThisId != nRightId )
     {
         if( nThisId != -1 )
         {
@@ -328,7 +383,8 @@ static void AddEdges( GInt32 *panThisLineId, GInt32 *panLastLineId,
 
 static CPLErr
 EmitPolygonToLayer( OGRLayerH hOutLayer, int iPixValField,
-                    RPolygon *poRPoly, double *padfGeoTransform )
+                    RPolygon *poRPoly, double *padfGeoTransform,
+                    int nStripHeight = 0 )
 
 {
     OGRFeatureH hFeat;
@@ -339,6 +395,9 @@ EmitPolygonToLayer( OGRLayerH hOutLayer, int iPixValField,
 /* -------------------------------------------------------------------- */
     poRPoly->Coalesce();
 
+    if( nStripHeight > 0 )
+        poRPoly->RemoveSeamVertices( nStripHeight );
+
 /* -------------------------------------------------------------------- */
 /*      Create the polygon geometry.                                    */
 /* -------------------------------------------------------------------- */
@@ -428,6 +487,576 @@ GPMaskImageData( GDALRasterBandH hMaskBand, GByte* pabyMaskLine, int iY, int nXS
     return eErr;
 }
  
+/************************************************************************/
+/* ==================================================================== */
+/*                     Polygonizing in strips                           */
+/*                                                                      */
+/*      The strips of lines are polygonized independently by worker     */
+/*      threads, and then joined from top to bottom on the calling      */
+/*      thread.  Two vertically adjacent pixels belong to the same      */
+/*      polygon exactly when they have the same value, so a strip       */
+/*      knows which of its pixels have an edge on its top and bottom    */
+/*      seams from the lines just above and below it.  Each strip adds  */
+/*      the seam edges to its own polygon parts, and the parts          */
+/*      touching across a seam with the same value are the same         */
+/*      polygon.  Polygons that do not reach the last line of a strip   */
+/*      are complete and written out right away.                        */
+/* ==================================================================== */
+/************************************************************************/
+
+/************************************************************************/
+/*                               GPStrip                                */
+/*                                                                      */
+/*      The polygon parts of one strip in scan order of their first     */
+/*      pixel, and for the first and last line of the strip the         */
+/*      pixel values and the part index of every pixel (-1 for masked   */
+/*      pixels).                                                        */
+/************************************************************************/
+
+typedef struct {
+    int         nYOff;
+    int         nYSize;
+    std::vector<RPolygon *> apoParts;
+    std::vector<int> anFirstLinePart;
+    std::vector<int> anLastLinePart;
+    std::vector<GInt32> anFirstLineVal;
+    std::vector<GInt32> anLastLineVal;
+    CPLErr      eErr;
+} GPStrip;
+
+typedef struct {
+    GDALRasterBandH hSrcBand;
+    GDALRasterBandH hMaskBand;
+    int         nXSize;
+    int         nYSize;
+    GPStrip     *pasStrips;
+    void        *hIOMutex;
+} GPStripJob;
+
+/************************************************************************/
+/*                            GPFreeStrip()                             */
+/************************************************************************/
+
+static void GPFreeStrip( GPStrip *psStrip )
+
+{
+    size_t iPart;
+
+    for( iPart = 0; iPart < psStrip->apoParts.size(); iPart++ )
+        delete psStrip->apoParts[iPart];
+
+    psStrip->apoParts.clear();
+    psStrip->anFirstLinePart.clear();
+    psStrip->anLastLinePart.clear();
+    psStrip->anFirstLineVal.clear();
+    psStrip->anLastLineVal.clear();
+}
+
+/************************************************************************/
+/*                         GPPolygonizeStrip()                          */
+/*                                                                      */
+/*      Collect the polygon parts of a strip, with the same two         */
+/*      passes as GDALPolygonize() does over the whole raster.          */
+/************************************************************************/
+
+static CPLErr GPPolygonizeStrip( GPStripJob *psJob, GPStrip *psStrip )
+
+{
+    const int nXSize = psJob->nXSize;
+    const int nYOff = psStrip->nYOff;
+    const int nLines = psStrip->nYSize;
+    const int nFirstRow = MAX( 0, nYOff - 1 );
+    const int nRows = MIN( psJob->nYSize, nYOff + nLines + 1 ) - nFirstRow;
+    CPLErr  eErr = CE_None;
+    int     iLine, iX;
+
+/* -------------------------------------------------------------------- */
+/*      Read the strip, with the lines above and below it.              */
+/* -------------------------------------------------------------------- */
+    GInt32 *panVal = (GInt32 *) VSIMalloc3( sizeof(GInt32), nXSize, nRows );
+    GInt32 *panLastLineId = (GInt32 *) VSIMalloc2(sizeof(GInt32),nXSize + 2);
+    GInt32 *panThisLineId = (GInt32 *) VSIMalloc2(sizeof(GInt32),nXSize + 2);
+    GByte *pabyMask = (psJob->hMaskBand != NULL) ? 
+        (GByte *) VSIMalloc2( nXSize, nRows ) : NULL;
+
+    if( panVal == NULL || panLastLineId == NULL || panThisLineId == NULL
+        || (psJob->hMaskBand != NULL && pabyMask == NULL) )
+    {
+        CPLError(CE_Failure, CPLE_OutOfMemory,
+                 "Could not allocate enough memory for temporary buffers");
+        eErr = CE_Failure;
+    }
+    else
+    {
+        CPLMutexHolderD( &(psJob->hIOMutex) );
+
+        eErr = GDALRasterIO( psJob->hSrcBand, GF_Read, 0, nFirstRow,
+                             nXSize, nRows, panVal, nXSize, nRows,
+                             GDT_Int32, 0, 0 );
+        if( eErr == CE_None && psJob->hMaskBand != NULL )
+            eErr = GDALRasterIO( psJob->hMaskBand, GF_Read, 0, nFirstRow,
+                                 nXSize, nRows, pabyMask, nXSize, nRows,
+                                 GDT_Byte, 0, 0 );
+    }
+
+    if( eErr != CE_None )
+    {
+        VSIFree( panVal );
+        VSIFree( panLastLineId );
+        VSIFree( panThisLineId );
+        VSIFree( pabyMask );
+        return eErr;
+    }
+
+    if( pabyMask != NULL )
+    {
+        size_t i, nPixels = (size_t) nXSize * nRows;
+
+        for( i = 0; i < nPixels; i++ )
+        {
+            if( pabyMask[i] == 0 )
+                panVal[i] = GP_NODATA_MARKER;
+        }
+    }
+
+    GInt32 *panStripVal = panVal + (size_t) (nYOff - nFirstRow) * nXSize;
+    GInt32 *panAboveVal = (nYOff > 0) ? panVal : NULL;
+    GInt32 *panBelowVal = (nYOff + nLines < psJob->nYSize) ?
+        panStripVal + (size_t) nLines * nXSize : NULL;
+
+/* -------------------------------------------------------------------- */
+/*      First pass, building the polygon id map of the strip.           */
+/* -------------------------------------------------------------------- */
+    GDALRasterPolygonEnumerator oFirstEnum;
+
+    for( iLine = 0; iLine < nLines; iLine++ )
+    {
+        GInt32 *panThisLineVal = panStripVal + (size_t) iLine * nXSize;
+
+        if( iLine == 0 )
+            oFirstEnum.ProcessLine( 
+                NULL, panThisLineVal, NULL, panThisLineId, nXSize );
+        else
+            oFirstEnum.ProcessLine(
+                panThisLineVal - nXSize, panThisLineVal, 
+                panLastLineId,  panThisLineId, 
+                nXSize );
+
+        GInt32 *panTmp = panThisLineId;
+        panThisLineId = panLastLineId;
+        panLastLineId = panTmp;
+    }
+
+    oFirstEnum.CompleteMerges();
+
+/* -------------------------------------------------------------------- */
+/*      Second pass collecting the edges.  The line above the strip     */
+/*      gets the id of the pixel below it where they have the same      */
+/*      value and -1 elsewhere, so only the seam edges are added, to    */
+/*      the parts of this strip.  The same goes for the line below.     */
+/* -------------------------------------------------------------------- */
+    GDALRasterPolygonEnumerator oSecondEnum;
+    RPolygon **papoPoly = (RPolygon **) 
+        CPLCalloc(sizeof(RPolygon*),oFirstEnum.nNextPolygonId);
+    std::vector<int> anFirstLineId( nXSize ), anLastLineId( nXSize );
+
+    panThisLineId[0] = -1;
+    panThisLineId[nXSize+1] = -1;
+
+    for( iX = 0; iX < nXSize+2; iX++ )
+        panLastLineId[iX] = -1;
+
+    for( iLine = 0; iLine <= nLines; iLine++ )
+    {
+        GInt32 *panThisLineVal = panStripVal + (size_t) iLine * nXSize;
+
+        if( iLine == nLines )
+        {
+            for( iX = 0; iX < nXSize; iX++ )
+                panThisLineId[iX+1] = 
+                    (panBelowVal != NULL 
+                     && panBelowVal[iX] == panThisLineVal[iX - nXSize]) ?
+                    panLastLineId[iX+1] : -1;
+        }
+        else if( iLine == 0 )
+        {
+            oSecondEnum.ProcessLine( 
+                NULL, panThisLineVal, NULL, panThisLineId+1, nXSize );
+
+            for( iX = 0; iX < nXSize; iX++ )
+                panLastLineId[iX+1] = 
+                    (panAboveVal != NULL 
+                     && panAboveVal[iX] == panThisLineVal[iX]) ?
+                    panThisLineId[iX+1] : -1;
+        }
+        else
+            oSecondEnum.ProcessLine(
+                panThisLineVal - nXSize, panThisLineVal, 
+                panLastLineId+1,  panThisLineId+1, 
+                nXSize );
+
+        for( iX = 0; iX < nXSize+1; iX++ )
+        {
+            AddEdges( panThisLineId, panLastLineId, 
+                      oFirstEnum.panPolyIdMap, oFirstEnum.panPolyValue,
+                      papoPoly, iX, nYOff + iLine, iLine < nLines );
+        }
+
+        if( iLine == 0 )
+        {
+            for( iX = 0; iX < nXSize; iX++ )
+                anFirstLineId[iX] = 
+                    oFirstEnum.panPolyIdMap[panThisLineId[iX+1]];
+        }
+        if( iLine == nLines - 1 )
+        {
+            for( iX = 0; iX < nXSize; iX++ )
+                anLastLineId[iX] = 
+                    oFirstEnum.panPolyIdMap[panThisLineId[iX+1]];
+        }
+
+        GInt32 *panTmp = panThisLineId;
+        panThisLineId = panLastLineId;
+        panLastLineId = panTmp;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Order the parts by their first pixel, which is where their      */
+/*      first segment was added.  Masked parts are dropped.             */
+/* -------------------------------------------------------------------- */
+    std::vector< std::pair< std::pair<int,int>, int > > aoOrder;
+    std::vector<int> anPartIndex( oFirstEnum.nNextPolygonId, -1 );
+    int     iPoly;
+    size_t  iPart;
+
+    for( iPoly = 0; iPoly < oFirstEnum.nNextPolygonId; iPoly++ )
+    {
+        RPolygon *poPoly = papoPoly[iPoly];
+
+        if( poPoly == NULL )
+            continue;
+
+        if( psJob->hMaskBand != NULL 
+            && poPoly->nPolyValue == GP_NODATA_MARKER )
+        {
+            delete poPoly;
+            continue;
+        }
+
+        aoOrder.push_back( std::make_pair( 
+            std::make_pair( poPoly->aanXY[0][1], poPoly->aanXY[0][0] ),
+            iPoly ) );
+    }
+
+    std::sort( aoOrder.begin(), aoOrder.end() );
+
+    for( iPart = 0; iPart < aoOrder.size(); iPart++ )
+    {
+        psStrip->apoParts.push_back( papoPoly[aoOrder[iPart].second] );
+        anPartIndex[aoOrder[iPart].second] = (int) iPart;
+    }
+
+    psStrip->anFirstLinePart.resize( nXSize );
+    psStrip->anLastLinePart.resize( nXSize );
+    for( iX = 0; iX < nXSize; iX++ )
+    {
+        psStrip->anFirstLinePart[iX] = anPartIndex[anFirstLineId[iX]];
+        psStrip->anLastLinePart[iX] = anPartIndex[anLastLineId[iX]];
+    }
+
+    psStrip->anFirstLineVal.assign( panStripVal, panStripVal + nXSize );
+    psStrip->anLastLineVal.assign( panStripVal + (size_t)(nLines-1) * nXSize,
+                                   panStripVal + (size_t) nLines * nXSize );
+
+    CPLFree( papoPoly );
+    VSIFree( panVal );
+    VSIFree( panLastLineId );
+    VSIFree( panThisLineId );
+    VSIFree( pabyMask );
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                        GPPolygonizeStripJob()                        */
+/************************************************************************/
+
+static int GPPolygonizeStripJob( void *pUserData, int iJob )
+
+{
+    GPStripJob *psJob = (GPStripJob *) pUserData;
+    GPStrip *psStrip = psJob->pasStrips + iJob;
+
+    psStrip->eErr = GPPolygonizeStrip( psJob, psStrip );
+
+    return psStrip->eErr == CE_None;
+}
+
+/************************************************************************/
+/*                             GPFindRoot()                             */
+/************************************************************************/
+
+static int GPFindRoot( std::vector<int> &anParent, int iNode )
+
+{
+    while( anParent[iNode] != iNode )
+    {
+        anParent[iNode] = anParent[anParent[iNode]];
+        iNode = anParent[iNode];
+    }
+
+    return iNode;
+}
+
+/************************************************************************/
+/*                           GPStitchStrip()                            */
+/*                                                                      */
+/*      Join the parts of a strip to the polygons left open on the      */
+/*      line above it, and write out the polygons that do not reach     */
+/*      the last line of the strip.                                     */
+/*                                                                      */
+/*      The open polygons are kept in scan order of their first         */
+/*      pixel, and come before the parts of the strip, so the node of   */
+/*      smallest index in a set is the one with the first pixel of      */
+/*      the polygon.  Its first string holds the top edge of that       */
+/*      pixel and will become the outer ring, so the strings of the     */
+/*      other nodes are appended to it.                                 */
+/************************************************************************/
+
+static CPLErr GPStitchStrip( GPStrip *psStrip, int bLastStrip,
+                             std::vector<RPolygon *> &apoOpen,
+                             std::vector<int> &anOpenLine,
+                             std::vector<GInt32> &anOpenLineVal,
+                             OGRLayerH hOutLayer, int iPixValField, 
+                             double *padfGeoTransform, int nStripHeight )
+
+{
+    const int nOpen = (int) apoOpen.size();
+    const int nNodes = nOpen + (int) psStrip->apoParts.size();
+    const int nXSize = (int) psStrip->anFirstLineVal.size();
+    std::vector<int> anParent( nNodes );
+    std::vector<RPolygon *> apoNode( apoOpen );
+    int     iNode, iX;
+    CPLErr  eErr = CE_None;
+
+    apoNode.insert( apoNode.end(), 
+                    psStrip->apoParts.begin(), psStrip->apoParts.end() );
+    psStrip->apoParts.clear();
+
+    for( iNode = 0; iNode < nNodes; iNode++ )
+        anParent[iNode] = iNode;
+
+/* -------------------------------------------------------------------- */
+/*      Merge the parts with the polygons they touch across the seam.   */
+/* -------------------------------------------------------------------- */
+    for( iX = 0; iX < nXSize && !anOpenLine.empty(); iX++ )
+    {
+        int iOpen = anOpenLine[iX];
+        int iPart = psStrip->anFirstLinePart[iX];
+
+        if( iOpen < 0 || iPart < 0 
+            || anOpenLineVal[iX] != psStrip->anFirstLineVal[iX] )
+            continue;
+
+        int iRoot1 = GPFindRoot( anParent, iOpen );
+        int iRoot2 = GPFindRoot( anParent, nOpen + iPart );
+
+        if( iRoot1 < iRoot2 )
+            anParent[iRoot2] = iRoot1;
+        else if( iRoot2 < iRoot1 )
+            anParent[iRoot1] = iRoot2;
+    }
+
+    for( iNode = 0; iNode < nNodes; iNode++ )
+    {
+        int iRoot = GPFindRoot( anParent, iNode );
+
+        if( iRoot == iNode )
+            continue;
+
+        std::vector< std::vector<int> > &aanSrc = apoNode[iNode]->aanXY;
+        std::vector< std::vector<int> > &aanDst = apoNode[iRoot]->aanXY;
+        size_t iString;
+
+        for( iString = 0; iString < aanSrc.size(); iString++ )
+        {
+            aanDst.resize( aanDst.size() + 1 );
+            aanDst.back().swap( aanSrc[iString] );
+        }
+
+        delete apoNode[iNode];
+        apoNode[iNode] = NULL;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      The polygons on the last line stay open, the others are         */
+/*      complete.                                                       */
+/* -------------------------------------------------------------------- */
+    std::vector<int> anNewIndex( nNodes, -1 );
+    std::vector<int> anNewLine;
+
+    if( !bLastStrip )
+    {
+        anNewLine.resize( nXSize );
+        for( iX = 0; iX < nXSize; iX++ )
+        {
+            int iPart = psStrip->anLastLinePart[iX];
+
+            anNewLine[iX] = (iPart < 0) ? -1 : 
+                GPFindRoot( anParent, nOpen + iPart );
+            if( anNewLine[iX] >= 0 )
+                anNewIndex[anNewLine[iX]] = 0;
+        }
+    }
+
+    apoOpen.clear();
+
+    for( iNode = 0; iNode < nNodes; iNode++ )
+    {
+        if( apoNode[iNode] == NULL )
+            continue;
+
+        if( anNewIndex[iNode] == 0 )
+        {
+            anNewIndex[iNode] = (int) apoOpen.size();
+            apoOpen.push_back( apoNode[iNode] );
+            continue;
+        }
+
+        if( eErr == CE_None )
+            eErr = EmitPolygonToLayer( hOutLayer, iPixValField, 
+                                       apoNode[iNode], padfGeoTransform,
+                                       nStripHeight );
+        delete apoNode[iNode];
+    }
+
+    for( iX = 0; iX < (int) anNewLine.size(); iX++ )
+    {
+        if( anNewLine[iX] >= 0 )
+            anNewLine[iX] = anNewIndex[anNewLine[iX]];
+    }
+
+    anOpenLine.swap( anNewLine );
+    anOpenLineVal.swap( psStrip->anLastLineVal );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                         GPPolygonizeStrips()                         */
+/*                                                                      */
+/*      GDALPolygonize() in strips of nStripHeight lines.  As many      */
+/*      strips as there are threads are polygonized at once, then       */
+/*      joined in order.                                                */
+/************************************************************************/
+
+static CPLErr
+GPPolygonizeStrips( GDALRasterBandH hSrcBand, GDALRasterBandH hMaskBand,
+                    OGRLayerH hOutLayer, int iPixValField, int nStripHeight,
+                    GDALProgressFunc pfnProgress, void * pProgressArg )
+
+{
+    int nXSize = GDALGetRasterBandXSize( hSrcBand );
+    int nYSize = GDALGetRasterBandYSize( hSrcBand );
+
+/* -------------------------------------------------------------------- */
+/*      Get the geotransform, if there is one, so we can convert the    */
+/*      vectors into georeferenced coordinates.                         */
+/* -------------------------------------------------------------------- */
+    GDALDatasetH hSrcDS = GDALGetBandDataset( hSrcBand );
+    double adfGeoTransform[6] = { 0.0, 1.0, 0.0, 0.0, 0.0, 1.0 };
+
+    if( hSrcDS )
+        GDALGetGeoTransform( hSrcDS, adfGeoTransform );
+
+/* -------------------------------------------------------------------- */
+/*      Setup the job.                                                  */
+/* -------------------------------------------------------------------- */
+    GPStripJob sJob;
+    int nThreads = 
+        CPLParseNumThreads( CPLGetConfigOption( "GDAL_NUM_THREADS", NULL ), 1 );
+    int nStripCount = (nYSize + nStripHeight - 1) / nStripHeight;
+    std::vector<GPStrip> asStrips( nThreads );
+
+    sJob.hSrcBand = hSrcBand;
+    sJob.hMaskBand = hMaskBand;
+    sJob.nXSize = nXSize;
+    sJob.nYSize = nYSize;
+    sJob.pasStrips = &(asStrips[0]);
+    sJob.hIOMutex = CPLCreateMutex();
+    if( sJob.hIOMutex == NULL )
+        return CE_Failure;
+    CPLReleaseMutex( sJob.hIOMutex );
+
+    CPLDebug( "GDAL", "Polygonizing %d strips of %d lines with %d threads.",
+              nStripCount, nStripHeight, nThreads );
+
+/* ==================================================================== */
+/*      Process the strips.                                             */
+/* ==================================================================== */
+    std::vector<RPolygon *> apoOpen;
+    std::vector<int> anOpenLine;
+    std::vector<GInt32> anOpenLineVal;
+    CPLErr  eErr = CE_None;
+    int     iStrip, iJob;
+
+    for( iStrip = 0; eErr == CE_None && iStrip < nStripCount; 
+         iStrip += nThreads )
+    {
+        int nJobs = MIN( nThreads, nStripCount - iStrip );
+
+        for( iJob = 0; iJob < nJobs; iJob++ )
+        {
+            asStrips[iJob].nYOff = (iStrip + iJob) * nStripHeight;
+            asStrips[iJob].nYSize = 
+                MIN( nStripHeight, nYSize - asStrips[iJob].nYOff );
+            asStrips[iJob].eErr = CE_Failure;
+        }
+
+        CPLRunJobs( nJobs, nThreads, GPPolygonizeStripJob, &sJob );
+
+        for( iJob = 0; iJob < nJobs; iJob++ )
+        {
+            GPStrip *psStrip = &(asStrips[iJob]);
+
+            if( eErr == CE_None )
+                eErr = psStrip->eErr;
+
+            if( eErr == CE_None )
+                eErr = GPStitchStrip( psStrip, iStrip + iJob == nStripCount-1,
+                                      apoOpen, anOpenLine, anOpenLineVal,
+                                      hOutLayer, iPixValField, 
+                                      adfGeoTransform, nStripHeight );
+
+            GPFreeStrip( psStrip );
+
+/* -------------------------------------------------------------------- */
+/*      Report progress, and support interrupts.                        */
+/* -------------------------------------------------------------------- */
+            if( eErr == CE_None 
+                && !pfnProgress( (psStrip->nYOff + psStrip->nYSize)
+                                 / (double) nYSize, 
+                                 "", pProgressArg ) )
+            {
+                CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+                eErr = CE_Failure;
+            }
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Cleanup                                                         */
+/* -------------------------------------------------------------------- */
+    size_t iOpen;
+
+    for( iOpen = 0; iOpen < apoOpen.size(); iOpen++ )
+        delete apoOpen[iOpen];
+
+    CPLDestroyMutex( sJob.hIOMutex );
+
+    return eErr;
+}
+
 /************************************************************************/
 /*                           GDALPolygonize()                           */
 /************************************************************************/
@@ -473,8 +1102,16 @@ GPMaskImageData( GDALRasterBandH hMaskBand, GByte* pabyMaskLine, int iY, int nXS
  * be written. 
  * @param iPixValField the attribute field index indicating the feature
  * attribute into which the pixel value of the polygon should be written.
- * @param papszOptions a name/value list of additional options (none currently
- * supported). 
+ * @param papszOptions a name/value list of additional options. 
+ * <ul>
+ * <li>STRIP_HEIGHT=n: polygonize the raster in strips of n lines which are 
+ * then joined together.  The strips are processed with as many threads as 
+ * the GDAL_NUM_THREADS configuration option allows, and the memory used for 
+ * the polygon enumerations is bounded by the strip size instead of the
+ * raster size.  The polygons are the same as without this option, but the 
+ * features may be written in a different order, and the rings may start at
+ * a different vertex.
+ * </ul>
  * @param pfnProgress callback for reporting algorithm progress matching the
  * GDALProgressFunc() semantics.  May be NULL.
  * @param pProgressArg callback argument passed to pfnProgress.
@@ -508,6 +1145,17 @@ GDALPolygonize( GDALRasterBandH hSrcBand,
         return CE_Failure;
     }
 
+/* -------------------------------------------------------------------- */
+/*      Polygonize in strips if requested.                              */
+/* -------------------------------------------------------------------- */
+    const char *pszStripHeight = 
+        CSLFetchNameValue( papszOptions, "STRIP_HEIGHT" );
+
+    if( pszStripHeight != NULL && atoi(pszStripHeight) > 0 )
+        return GPPolygonizeStrips( hSrcBand, hMaskBand, hOutLayer, 
+                                   iPixValField, atoi(pszStripHeight),
+                                   pfnProgress, pProgressArg );
+
 /* -------------------------------------------------------------------- */
 /*      Allocate working buffers.                                       */
 /* -------------------------------------------------------------------- */
@@ -27,7 +27,7 @@
  * DEALINGS IN THE SOFTWARE.
  ****************************************************************************/
 
-#include "gdal_alg.h"
+#include "gdal_alg_priv.h"
 #include "cpl_conv.h"
 #include "cpl_string.h"
 
@@ -325,25 +325,141 @@ end:
 }
  
 /************************************************************************/
-/*                             QUAD_CHECK()                             */
+/*                            GDALFillData                              */
 /*                                                                      */
-/*      macro for checking whether a point is nearer than the           */
-/*      existing closest point.                                         */
+/*      State shared by the distance transform callbacks.  The mask     */
+/*      and data buffers of the strip are those of the distance         */
+/*      transform.                                                      */
 /************************************************************************/
-#define QUAD_CHECK(quad_dist, quad_value, 				\
-target_x, target_y, origin_x, origin_y, target_value )			\
-									\
-if( quad_value != nNoDataVal ) 						\
-{									\
-    double dfDistSq = ((target_x-origin_x) * (target_x-origin_x))       \
-                    + ((target_y-origin_y) * (target_y-origin_y));      \
-    									\
-    if( dfDistSq < quad_dist*quad_dist )				\
-    {									\
-	CPLAssert( dfDistSq > 0.0 );                                    \
-        quad_dist = sqrt(dfDistSq); 					\
-        quad_value = target_value;					\
-    }									\
+
+typedef struct {
+    GDALRasterBandH hTargetBand;
+    GDALRasterBandH hMaskBand;
+    GDALRasterBandH hFiltMaskBand;
+    int         nXSize;
+
+    int         nYOff;
+    int         nAllocLines;
+    GByte       *pabyMask;
+    float       *pafScanline;
+    GByte       *pabyFiltMask;
+} GDALFillData;
+
+/************************************************************************/
+/*                            GDALFillRead()                            */
+/*                                                                      */
+/*      Read a strip of the mask and target bands.  The valid pixels    */
+/*      are the features of the distance transform.                     */
+/************************************************************************/
+
+static CPLErr GDALFillRead( void *pUserData, int nYOff, int nLines, 
+                            GByte *pabyFeature, float *pafValue )
+
+{
+    GDALFillData *psData = (GDALFillData *) pUserData;
+    const int nXSize = psData->nXSize;
+    CPLErr eErr;
+
+    if( nLines > psData->nAllocLines )
+    {
+        CPLFree( psData->pabyFiltMask );
+        psData->pabyFiltMask = (GByte *) VSIMalloc2( nXSize, nLines );
+        psData->nAllocLines = nLines;
+
+        if( psData->pabyFiltMask == NULL )
+        {
+            CPLError(CE_Failure, CPLE_OutOfMemory,
+                     "Could not allocate enough memory for temporary buffers");
+            psData->nAllocLines = 0;
+            return CE_Failure;
+        }
+    }
+
+    psData->nYOff = nYOff;
+    psData->pabyMask = pabyFeature;
+    psData->pafScanline = pafValue;
+
+    eErr = GDALRasterIO( psData->hMaskBand, GF_Read, 0, nYOff, nXSize, nLines,
+                         pabyFeature, nXSize, nLines, GDT_Byte, 0, 0 );
+
+    if( eErr == CE_None )
+        eErr = GDALRasterIO( psData->hTargetBand, GF_Read, 0, nYOff, 
+                             nXSize, nLines, pafValue, nXSize, nLines, 
+                             GDT_Float32, 0, 0 );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                            GDALFillLine()                            */
+/*                                                                      */
+/*      Interpolate the nodata pixels of a line from the nearest valid  */
+/*      pixel of each quadrant, with inverse distance weighting.        */
+/************************************************************************/
+
+static void GDALFillLine( void *pUserData, int iLine, 
+                          float **papafDist, float **papafValue )
+
+{
+    GDALFillData *psData = (GDALFillData *) pUserData;
+    const int nXSize = psData->nXSize;
+    size_t nOff = (size_t) (iLine - psData->nYOff) * nXSize;
+    GByte *pabyMask = psData->pabyMask + nOff;
+    float *pafScanline = psData->pafScanline + nOff;
+    GByte *pabyFiltMask = psData->pabyFiltMask + nOff;
+    int   iX, iQuad;
+
+    memset( pabyFiltMask, 0, nXSize );
+
+    for( iX = 0; iX < nXSize; iX++ )
+    {
+        // If this was a valid target - no change.
+        if( pabyMask[iX] )
+            continue;
+
+        double dfWeightSum = 0.0;
+        double dfValueSum = 0.0;
+
+        for( iQuad = 0; iQuad < 4; iQuad++ )
+        {
+            if( papafDist[iQuad][iX] > 0.0 )
+            {
+                double dfWeight = 1.0 / papafDist[iQuad][iX];
+
+                dfWeightSum += dfWeight;
+                dfValueSum += papafValue[iQuad][iX] * dfWeight;
+            }
+        }
+
+        if( dfWeightSum > 0.0 )
+        {
+            pabyFiltMask[iX] = 255;
+            pafScanline[iX] = dfValueSum / dfWeightSum;
+        }
+    }
+}
+
+/************************************************************************/
+/*                           GDALFillWrite()                            */
+/************************************************************************/
+
+static CPLErr GDALFillWrite( void *pUserData, int nYOff, int nLines )
+
+{
+    GDALFillData *psData = (GDALFillData *) pUserData;
+    const int nXSize = psData->nXSize;
+    CPLErr eErr;
+
+    eErr = GDALRasterIO( psData->hTargetBand, GF_Write, 0, nYOff, 
+                         nXSize, nLines, psData->pafScanline, 
+                         nXSize, nLines, GDT_Float32, 0, 0 );
+
+    if( eErr == CE_None )
+        eErr = GDALRasterIO( psData->hFiltMaskBand, GF_Write, 0, nYOff, 
+                             nXSize, nLines, psData->pabyFiltMask, 
+                             nXSize, nLines, GDT_Byte, 0, 0 );
+
+    return eErr;
 }
 
 /************************************************************************/
@@ -355,8 +471,11 @@ if( quad_value != nNoDataVal ) 						\
  *
  * This algorithm will interpolate values for all designated 
  * nodata pixels (marked by zeros in hMaskBand).  For each pixel
- * a four direction conic search is done to find values to interpolate
- * from (using inverse distance weighting).  Once all values are
+ * the nearest valid pixel of each of the four quadrants around it
+ * (within dfMaxSearchDist) is found with a distance transform, and the 
+ * values of these are interpolated using inverse distance weighting.  
+ * The raster is processed in strips of lines with as many threads as
+ * the GDAL_NUM_THREADS configuration option allows.  Once all values are
  * interpolated, zero or more smoothing iterations (3x3 average
  * filters on interpolated pixels) are applied to smooth out 
  * artifacts. 
@@ -400,26 +519,9 @@ GDALFillNodata( GDALRasterBandH hTargetBand,
     int nYSize = GDALGetRasterBandYSize( hTargetBand );
     CPLErr eErr = CE_None;
 
-    // Special "x" pixel values identifying pixels as special.
-    GUInt32 nNoDataVal;
-    GDALDataType eType;
-
     if( dfMaxSearchDist == 0.0 )
         dfMaxSearchDist = MAX(nXSize,nYSize) + 1;
 
-    int nMaxSearchDist = (int) floor(dfMaxSearchDist);
-
-    if( nXSize > 65533 || nYSize > 65533 )
-    {
-        eType = GDT_UInt32;
-        nNoDataVal = 4000002;
-    }
-    else
-    {
-        eType = GDT_UInt16;
-        nNoDataVal = 65535;
-    }
-
     if( hMaskBand == NULL )
         hMaskBand = GDALGetMaskBand( hTargetBand );
 
@@ -436,7 +538,8 @@ GDALFillNodata( GDALRasterBandH hTargetBand,
     }
 
 /* -------------------------------------------------------------------- */
-/*      Create a work file to hold the Y "last value" indices.          */
+/*      Create a mask file to make it clear what pixels can be filtered */
+/*      on the filtering pass.                                          */
 /* -------------------------------------------------------------------- */
     GDALDriverH  hDriver = GDALGetDriverByName( "GTiff" );
     if (hDriver == NULL)
@@ -446,43 +549,10 @@ GDALFillNodata( GDALRasterBandH hTargetBand,
         return CE_Failure;
     }
     
-    GDALDatasetH hYDS;
-    GDALRasterBandH hYBand;
-    static const char *apszOptions[] = { "COMPRESS=LZW", NULL };
-    CPLString osTmpFile = CPLGenerateTempFilename("");
-    CPLString osYTmpFile = osTmpFile + "fill_y_work.tif";
-    
-    hYDS = GDALCreate( hDriver, osYTmpFile, nXSize, nYSize, 1, 
-                       eType, (char **) apszOptions );
-    
-    if( hYDS == NULL )
-        return CE_Failure;
-
-    hYBand = GDALGetRasterBand( hYDS, 1 );
-
-/* -------------------------------------------------------------------- */
-/*      Create a work file to hold the pixel value associated with      */
-/*      the "last xy value" pixel.                                      */
-/* -------------------------------------------------------------------- */
-    GDALDatasetH hValDS;
-    GDALRasterBandH hValBand;
-    CPLString osValTmpFile = osTmpFile + "fill_val_work.tif";
-
-    hValDS = GDALCreate( hDriver, osValTmpFile, nXSize, nYSize, 1,
-                         GDALGetRasterDataType( hTargetBand ), 
-                         (char **) apszOptions );
-    
-    if( hValDS == NULL )
-        return CE_Failure;
-
-    hValBand = GDALGetRasterBand( hValDS, 1 );
-
-/* -------------------------------------------------------------------- */
-/*      Create a mask file to make it clear what pixels can be filtered */
-/*      on the filtering pass.                                          */
-/* -------------------------------------------------------------------- */
     GDALDatasetH hFiltMaskDS;
     GDALRasterBandH hFiltMaskBand;
+    static const char *apszOptions[] = { "COMPRESS=LZW", NULL };
+    CPLString osTmpFile = CPLGenerateTempFilename("");
     CPLString osFiltMaskTmpFile = osTmpFile + "fill_filtmask_work.tif";
     
     hFiltMaskDS = 
@@ -494,307 +564,43 @@ GDALFillNodata( GDALRasterBandH hTargetBand,
 
     hFiltMaskBand = GDALGetRasterBand( hFiltMaskDS, 1 );
 
-/* -------------------------------------------------------------------- */
-/*      Allocate buffers for last scanline and this scanline.           */
-/* -------------------------------------------------------------------- */
-    GUInt32 *panLastY, *panThisY, *panTopDownY;
-    float   *pafLastValue, *pafThisValue, *pafScanline, *pafTopDownValue;
-    GByte   *pabyMask, *pabyFiltMask;
-    int     iX;
-    int     iY;
-
-    panLastY = (GUInt32 *) VSICalloc(nXSize,sizeof(GUInt32));
-    panThisY = (GUInt32 *) VSICalloc(nXSize,sizeof(GUInt32));
-    panTopDownY = (GUInt32 *) VSICalloc(nXSize,sizeof(GUInt32));
-    pafLastValue = (float *) VSICalloc(nXSize,sizeof(float));
-    pafThisValue = (float *) VSICalloc(nXSize,sizeof(float));
-    pafTopDownValue = (float *) VSICalloc(nXSize,sizeof(float));
-    pafScanline = (float *) VSICalloc(nXSize,sizeof(float));
-    pabyMask = (GByte *) VSICalloc(nXSize,1);
-    pabyFiltMask = (GByte *) VSICalloc(nXSize,1);
-    if (panLastY == NULL || panThisY == NULL || panTopDownY == NULL ||
-        pafLastValue == NULL || pafThisValue == NULL || pafTopDownValue == NULL ||
-        pafScanline == NULL || pabyMask == NULL || pabyFiltMask == NULL)
-    {
-        CPLError(CE_Failure, CPLE_OutOfMemory,
-                 "Could not allocate enough memory for temporary buffers");
-
-        eErr = CE_Failure;
-        goto end;
-    }
-
-    for( iX = 0; iX < nXSize; iX++ )
-    {
-        panLastY[iX] = nNoDataVal;
-    }
-
 /* ==================================================================== */
-/*      Make first pass from top to bottom collecting the "last         */
-/*      known value" for each column and writing it out to the work     */
-/*      files.                                                          */
+/*      Find the nearest valid pixel in each quadrant of every pixel,   */
+/*      and interpolate the nodata pixels from them, writing out the    */
+/*      updated data and the mask of the interpolated pixels.  The      */
+/*      top quadrants include the line of the pixel, and the left       */
+/*      ones its column.                                                */
 /* ==================================================================== */
-    
-    for( iY = 0; iY < nYSize && eErr == CE_None; iY++ )
-    {
-/* -------------------------------------------------------------------- */
-/*      Read data and mask for this line.                               */
-/* -------------------------------------------------------------------- */
-        eErr = 
-            GDALRasterIO( hMaskBand, GF_Read, 0, iY, nXSize, 1, 
-                          pabyMask, nXSize, 1, GDT_Byte, 0, 0 );
-
-        if( eErr != CE_None )
-            break;
-
-        eErr = 
-            GDALRasterIO( hTargetBand, GF_Read, 0, iY, nXSize, 1, 
-                          pafScanline, nXSize, 1, GDT_Float32, 0, 0 );
-        
-        if( eErr != CE_None )
-            break;
-        
-/* -------------------------------------------------------------------- */
-/*      Figure out the most recent pixel for each column.               */
-/* -------------------------------------------------------------------- */
-        
-        for( iX = 0; iX < nXSize; iX++ )
-        {
-            if( pabyMask[iX] )
-            {
-                pafThisValue[iX] = pafScanline[iX];
-                panThisY[iX] = iY;
-            }
-            else if( iY - panLastY[iX] <= dfMaxSearchDist )
-            {
-                pafThisValue[iX] = pafLastValue[iX];
-                panThisY[iX] = panLastY[iX];
-            }
-            else
-            {
-                panThisY[iX] = nNoDataVal;
-            }
-        }
-        
-/* -------------------------------------------------------------------- */
-/*      Write out best index/value to working files.                    */
-/* -------------------------------------------------------------------- */
-        eErr = GDALRasterIO( hYBand, GF_Write, 0, iY, nXSize, 1, 
-                             panThisY, nXSize, 1, GDT_UInt32, 0, 0 );
-        if( eErr != CE_None )
-            break;
-
-        eErr = GDALRasterIO( hValBand, GF_Write, 0, iY, nXSize, 1, 
-                             pafThisValue, nXSize, 1, GDT_Float32, 0, 0 );
-        if( eErr != CE_None )
-            break;
-
-/* -------------------------------------------------------------------- */
-/*      Flip this/last buffers.                                         */
-/* -------------------------------------------------------------------- */
-        {
-            float *pafTmp = pafThisValue;
-            pafThisValue = pafLastValue;
-            pafLastValue = pafTmp;
-
-            GUInt32 *panTmp = panThisY;
-            panThisY = panLastY;
-            panLastY = panTmp;
-        }
-
-/* -------------------------------------------------------------------- */
-/*      report progress.                                                */
-/* -------------------------------------------------------------------- */
-        if( eErr == CE_None
-            && !pfnProgress( 0.5*(iY+1) / (double)nYSize, 
-                             "Filling...", pProgressArg ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
-    }
-
-/* ==================================================================== */
-/*      Now we will do collect similar this/last information from       */
-/*      bottom to top and use it in combination with the top to         */
-/*      bottom search info to interpolate.                              */
-/* ==================================================================== */
-    for( iY = nYSize-1; iY >= 0 && eErr == CE_None; iY-- )
-    {
-        eErr = 
-            GDALRasterIO( hMaskBand, GF_Read, 0, iY, nXSize, 1, 
-                          pabyMask, nXSize, 1, GDT_Byte, 0, 0 );
-
-        if( eErr != CE_None )
-            break;
-
-        eErr = 
-            GDALRasterIO( hTargetBand, GF_Read, 0, iY, nXSize, 1, 
-                          pafScanline, nXSize, 1, GDT_Float32, 0, 0 );
-        
-        if( eErr != CE_None )
-            break;
-        
-/* -------------------------------------------------------------------- */
-/*      Figure out the most recent pixel for each column.               */
-/* -------------------------------------------------------------------- */
-        
-        for( iX = 0; iX < nXSize; iX++ )
-        {
-            if( pabyMask[iX] )
-            {
-                pafThisValue[iX] = pafScanline[iX];
-                panThisY[iX] = iY;
-            }
-            else if( panLastY[iX] - iY <= dfMaxSearchDist )
-            {
-                pafThisValue[iX] = pafLastValue[iX];
-                panThisY[iX] = panLastY[iX];
-            }
-            else
-            {
-                panThisY[iX] = nNoDataVal;
-            }
-        }
-        
-/* -------------------------------------------------------------------- */
-/*      Load the last y and corresponding value from the top down pass. */
-/* -------------------------------------------------------------------- */
-        eErr = 
-            GDALRasterIO( hYBand, GF_Read, 0, iY, nXSize, 1, 
-                          panTopDownY, nXSize, 1, GDT_UInt32, 0, 0 );
-
-        if( eErr != CE_None )
-            break;
-
-        eErr = 
-            GDALRasterIO( hValBand, GF_Read, 0, iY, nXSize, 1, 
-                          pafTopDownValue, nXSize, 1, GDT_Float32, 0, 0 );
-
-        if( eErr != CE_None )
-            break;
-
-/* -------------------------------------------------------------------- */
-/*      Attempt to interpolate any pixels that are nodata.              */
-/* -------------------------------------------------------------------- */
-        memset( pabyFiltMask, 0, nXSize );
-        for( iX = 0; iX < nXSize; iX++ )
-        {
-            int iStep, iQuad;
-            int nThisMaxSearchDist = nMaxSearchDist;
-
-            // If this was a valid target - no change.
-            if( pabyMask[iX] )
-                continue;
-
-            // Quadrants 0:topleft, 1:bottomleft, 2:topright, 3:bottomright
-            double adfQuadDist[4];
-            double adfQuadValue[4];
-
-            for( iQuad = 0; iQuad < 4; iQuad++ )
-                adfQuadDist[iQuad] = dfMaxSearchDist + 1.0;
-            
-            // Step left and right by one pixel searching for the closest 
-            // target value for each quadrant. 
-            for( iStep = 0; iStep < nThisMaxSearchDist; iStep++ )
-            {
-                int iLeftX = MAX(0,iX - iStep);
-                int iRightX = MIN(nXSize-1,iX + iStep);
-                
-                // top left includes current line 
-                QUAD_CHECK(adfQuadDist[0],adfQuadValue[0], 
-                           iLeftX, panTopDownY[iLeftX], iX, iY,
-                           pafTopDownValue[iLeftX] );
-
-                // bottom left 
-                QUAD_CHECK(adfQuadDist[1],adfQuadValue[1], 
-                           iLeftX, panLastY[iLeftX], iX, iY, 
-                           pafLastValue[iLeftX] );
-
-                // top right and bottom right do no include center pixel.
-                if( iStep == 0 )
-                     continue;
-                    
-                // top right includes current line 
-                QUAD_CHECK(adfQuadDist[2],adfQuadValue[2], 
-                           iRightX, panTopDownY[iRightX], iX, iY,
-                           pafTopDownValue[iRightX] );
-
-                // bottom right
-                QUAD_CHECK(adfQuadDist[3],adfQuadValue[3], 
-                           iRightX, panLastY[iRightX], iX, iY,
-                           pafLastValue[iRightX] );
-
-                // every four steps, recompute maximum distance.
-                if( (iStep & 0x3) == 0 )
-                    nThisMaxSearchDist = (int) floor(
-                        MAX(MAX(adfQuadDist[0],adfQuadDist[1]),
-                            MAX(adfQuadDist[2],adfQuadDist[3])) );
-            }
-
-            double dfWeightSum = 0.0;
-            double dfValueSum = 0.0;
-            
-            for( iQuad = 0; iQuad < 4; iQuad++ )
-            {
-                if( adfQuadDist[iQuad] <= dfMaxSearchDist )
-                {
-                    double dfWeight = 1.0 / adfQuadDist[iQuad];
-
-                    dfWeightSum += dfWeight;
-                    dfValueSum += adfQuadValue[iQuad] * dfWeight;
-                }
-            }
-
-            if( dfWeightSum > 0.0 )
-            {
-                pabyMask[iX] = 255;
-                pabyFiltMask[iX] = 255;
-                pafScanline[iX] = dfValueSum / dfWeightSum;
-            }
-
-        }
-
-/* -------------------------------------------------------------------- */
-/*      Write out the updated data and mask information.                */
-/* -------------------------------------------------------------------- */
-        eErr = 
-            GDALRasterIO( hTargetBand, GF_Write, 0, iY, nXSize, 1, 
-                          pafScanline, nXSize, 1, GDT_Float32, 0, 0 );
-        
-        if( eErr != CE_None )
-            break;
-
-        eErr = 
-            GDALRasterIO( hFiltMaskBand, GF_Write, 0, iY, nXSize, 1, 
-                          pabyFiltMask, nXSize, 1, GDT_Byte, 0, 0 );
-        
-        if( eErr != CE_None )
-            break;
-
-/* -------------------------------------------------------------------- */
-/*      Flip this/last buffers.                                         */
-/* -------------------------------------------------------------------- */
-        {
-            float *pafTmp = pafThisValue;
-            pafThisValue = pafLastValue;
-            pafLastValue = pafTmp;
-            
-            GUInt32 *panTmp = panThisY;
-            panThisY = panLastY;
-            panLastY = panTmp;
-        }
-
-/* -------------------------------------------------------------------- */
-/*      report progress.                                                */
-/* -------------------------------------------------------------------- */
-        if( eErr == CE_None
-            && !pfnProgress( 0.5+0.5*(nYSize-iY) / (double)nYSize, 
-                             "Filling...", pProgressArg ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
-    }        
+    GDALFillData sData;
+    GDALEDTInfo sInfo;
+
+    sData.hTargetBand = hTargetBand;
+    sData.hMaskBand = hMaskBand;
+    sData.hFiltMaskBand = hFiltMaskBand;
+    sData.nXSize = nXSize;
+    sData.nYOff = 0;
+    sData.nAllocLines = 0;
+    sData.pabyMask = NULL;
+    sData.pafScanline = NULL;
+    sData.pabyFiltMask = NULL;
+
+    sInfo.nXSize = nXSize;
+    sInfo.nYSize = nYSize;
+    sInfo.dfMaxDist = dfMaxSearchDist;
+    sInfo.nRegions = 4;
+    sInfo.aeRegions[0] = GEDT_TopLeft;
+    sInfo.aeRegions[1] = GEDT_BottomLeft;
+    sInfo.aeRegions[2] = GEDT_TopRight;
+    sInfo.aeRegions[3] = GEDT_BottomRight;
+    sInfo.bValues = TRUE;
+    sInfo.pfnRead = GDALFillRead;
+    sInfo.pfnLine = GDALFillLine;
+    sInfo.pfnWrite = GDALFillWrite;
+    sInfo.pUserData = &sData;
+
+    eErr = GDALEDTProcess( &sInfo, pfnProgress, pProgressArg );
+
+    CPLFree( sData.pabyFiltMask );
 
 /* ==================================================================== */
 /*      Now we will do iterative average filters over the               */
@@ -812,25 +618,10 @@ GDALFillNodata( GDALRasterBandH hTargetBand,
     }
 
 /* -------------------------------------------------------------------- */
-/*      Close and clean up temporary files. Free working buffers        */
+/*      Close and clean up temporary files.                             */
 /* -------------------------------------------------------------------- */
-end:
-    CPLFree(panLastY);
-    CPLFree(panThisY);
-    CPLFree(panTopDownY);
-    CPLFree(pafLastValue);
-    CPLFree(pafThisValue);
-    CPLFree(pafTopDownValue);
-    CPLFree(pafScanline);
-    CPLFree(pabyMask);
-    CPLFree(pabyFiltMask);
-
-    GDALClose( hYDS );
-    GDALClose( hValDS );
     GDALClose( hFiltMaskDS );
 
-    GDALDeleteDataset( hDriver, osYTmpFile );
-    GDALDeleteDataset( hDriver, osValTmpFile );
     GDALDeleteDataset( hDriver, osFiltMaskTmpFile );
 
     return eErr;
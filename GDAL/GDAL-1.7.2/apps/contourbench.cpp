@@ -0,0 +1,478 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Utilities
+ * Purpose:  Benchmark of GDALContourGenerate() in one pass and in strips.
+ *
+ ******************************************************************************
+ * Copyright (c) 2010, GDAL contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "gdal.h"
+#include "gdal_alg.h"
+#include "ogr_api.h"
+#include "cpl_conv.h"
+#include "cpl_string.h"
+#include <vector>
+#include <algorithm>
+
+CPL_CVSID("$Id$");
+
+typedef struct {
+    double      dfLevel;
+    std::vector<double> adfXY;
+} ContourLine;
+
+/************************************************************************/
+/*                               Usage()                                */
+/************************************************************************/
+
+static void Usage()
+{
+    printf( "contourbench [-size <n>] [-interval <d>] [-threads <n>]\n"
+            "             [-strip <lines>] [-nodata] [-i <iterations>]\n"
+            "\n"
+            "Builds a synthetic n x n Float32 DEM in memory, optionally with\n"
+            "nodata holes, and contours it into an OGR Memory layer in one\n"
+            "pass and with the given number of threads in strips of the\n"
+            "given height (256 by default).  Reports the time of each run, the\n"
+            "speedup, whether the strip run wrote the same contour lines\n"
+            "as the one pass run, or how many of them differ, and whether\n"
+            "the strip run wrote them in the same order with two threads.\n"
+            "Exits with a non-zero status if the geometry or the order\n"
+            "differs.\n" );
+    exit( 1 );
+}
+
+/************************************************************************/
+/*                             CreateDEM()                              */
+/*                                                                      */
+/*      Rolling hills on a slope, with some noise, closed summits and   */
+/*      saddles, and round nodata holes if requested.                   */
+/************************************************************************/
+
+static GDALDatasetH CreateDEM( int nSize, int bNoData )
+{
+    GDALDatasetH hDS = GDALCreate( GDALGetDriverByName( "MEM" ), "",
+                                   nSize, nSize, 1, GDT_Float32, NULL );
+    if( hDS == NULL )
+        return NULL;
+
+    GDALRasterBandH hBand = GDALGetRasterBand( hDS, 1 );
+    float *pafLine = (float *) CPLMalloc( sizeof(float) * nSize );
+    double adfGeoTransform[6] = { 500000.0, 10.0, 0.0, 4000000.0, 0.0, -10.0 };
+    GUInt32 nSeed = 1;
+    int iX, iY;
+
+    GDALSetGeoTransform( hDS, adfGeoTransform );
+    if( bNoData )
+        GDALSetRasterNoDataValue( hBand, -9999.0 );
+
+    for( iY = 0; iY < nSize; iY++ )
+    {
+        for( iX = 0; iX < nSize; iX++ )
+        {
+            double dfX = iX / 97.0, dfY = iY / 131.0;
+
+            nSeed = nSeed * 1103515245 + 12345;
+
+            pafLine[iX] = (float)
+                (iX * 0.05 + iY * 0.02
+                 + 120.0 * sin( dfX ) * cos( dfY )
+                 + 35.0 * sin( dfX * 3.1 + dfY * 2.3 )
+                 + ((nSeed >> 16) & 255) / 64.0);
+
+            if( bNoData )
+            {
+                int nDX = (iX % 300) - 150, nDY = (iY % 370) - 185;
+
+                if( nDX * nDX + nDY * nDY < 40 * 40 )
+                    pafLine[iX] = -9999.0f;
+            }
+        }
+
+        GDALRasterIO( hBand, GF_Write, 0, iY, nSize, 1,
+                      pafLine, nSize, 1, GDT_Float32, 0, 0 );
+    }
+
+    CPLFree( pafLine );
+
+    return hDS;
+}
+
+/************************************************************************/
+/*                              Contour()                               */
+/*                                                                      */
+/*      Contour the band into a new Memory layer with nThreads, in      */
+/*      strips of pszStripHeight lines or in one pass if it is NULL,    */
+/*      and collect the lines written.  Returns the elapsed time, or    */
+/*      a negative value on failure.                                    */
+/************************************************************************/
+
+static double Contour( GDALDatasetH hDS, double dfInterval, int nThreads,
+                       const char *pszStripHeight,
+                       std::vector<ContourLine> &aoLines )
+{
+    OGRDataSourceH hMemDS =
+        OGR_Dr_CreateDataSource( OGRGetDriverByName( "Memory" ), "", NULL );
+    if( hMemDS == NULL )
+        return -1.0;
+
+    OGRLayerH hLayer = OGR_DS_CreateLayer( hMemDS, "contour", NULL,
+                                           wkbLineString, NULL );
+    OGRFieldDefnH hFld = OGR_Fld_Create( "ID", OFTInteger );
+    OGR_L_CreateField( hLayer, hFld, FALSE );
+    OGR_Fld_Destroy( hFld );
+    hFld = OGR_Fld_Create( "ELEV", OFTReal );
+    OGR_L_CreateField( hLayer, hFld, FALSE );
+    OGR_Fld_Destroy( hFld );
+
+    GDALRasterBandH hBand = GDALGetRasterBand( hDS, 1 );
+    int bNoData = FALSE;
+    double dfNoData = GDALGetRasterNoDataValue( hBand, &bNoData );
+
+    CPLSetConfigOption( "GDAL_NUM_THREADS", CPLSPrintf( "%d", nThreads ) );
+    CPLSetConfigOption( "GDAL_CONTOUR_STRIP_HEIGHT", pszStripHeight );
+
+    double dfStart = CPLGetWallTime();
+    CPLErr eErr = GDALContourGenerate( hBand, dfInterval, 0.0, 0, NULL,
+                                       bNoData, dfNoData, hLayer, 0, 1,
+                                       NULL, NULL );
+    double dfElapsed = CPLGetWallTime() - dfStart;
+
+    CPLSetConfigOption( "GDAL_NUM_THREADS", NULL );
+    CPLSetConfigOption( "GDAL_CONTOUR_STRIP_HEIGHT", NULL );
+
+    OGRFeatureH hFeat;
+
+    aoLines.clear();
+    OGR_L_ResetReading( hLayer );
+    while( (hFeat = OGR_L_GetNextFeature( hLayer )) != NULL )
+    {
+        OGRGeometryH hGeom = OGR_F_GetGeometryRef( hFeat );
+        int iPoint, nPoints = OGR_G_GetPointCount( hGeom );
+        ContourLine oLine;
+
+        oLine.dfLevel = OGR_F_GetFieldAsDouble( hFeat, 1 );
+        for( iPoint = 0; iPoint < nPoints; iPoint++ )
+        {
+            oLine.adfXY.push_back( OGR_G_GetX( hGeom, iPoint ) );
+            oLine.adfXY.push_back( OGR_G_GetY( hGeom, iPoint ) );
+        }
+        aoLines.push_back( oLine );
+
+        OGR_F_Destroy( hFeat );
+    }
+
+    OGR_DS_Destroy( hMemDS );
+
+    return eErr == CE_None ? dfElapsed : -1.0;
+}
+
+/************************************************************************/
+/*                             Normalize()                              */
+/*                                                                      */
+/*      The generator joins line ends closer than a small tolerance,    */
+/*      so where a line passes within that distance of a pixel          */
+/*      corner the vertices it keeps there depend on the order of the   */
+/*      joins.  Merge vertices closer than dfSnap, drop the lines this  */
+/*      collapses, start closed lines at their lowest vertex and sort   */
+/*      the lines, so that sets written in a different order compare    */
+/*      equal.                                                          */
+/************************************************************************/
+
+static bool LineLess( const ContourLine &oA, const ContourLine &oB )
+{
+    if( oA.dfLevel != oB.dfLevel )
+        return oA.dfLevel < oB.dfLevel;
+    return oA.adfXY < oB.adfXY;
+}
+
+static int Near( const std::vector<double> &adfXY, size_t i, size_t j,
+                 double dfSnap )
+{
+    return fabs(adfXY[i] - adfXY[j]) <= dfSnap
+        && fabs(adfXY[i+1] - adfXY[j+1]) <= dfSnap;
+}
+
+static void Normalize( std::vector<ContourLine> &aoLines, double dfSnap )
+{
+    std::vector<ContourLine> aoKept;
+    size_t iLine, i;
+
+    for( iLine = 0; iLine < aoLines.size(); iLine++ )
+    {
+        std::vector<double> &adfIn = aoLines[iLine].adfXY;
+        ContourLine oLine;
+
+        oLine.dfLevel = aoLines[iLine].dfLevel;
+        for( i = 0; i < adfIn.size(); i += 2 )
+        {
+            size_t n = oLine.adfXY.size();
+
+            if( n > 0 && fabs(adfIn[i] - oLine.adfXY[n-2]) <= dfSnap
+                && fabs(adfIn[i+1] - oLine.adfXY[n-1]) <= dfSnap )
+                continue;
+
+            oLine.adfXY.push_back( adfIn[i] );
+            oLine.adfXY.push_back( adfIn[i+1] );
+        }
+
+        std::vector<double> &adfXY = oLine.adfXY;
+        size_t n = adfXY.size();
+
+        if( n < 4 )
+            continue;
+
+        if( n >= 6 && Near( adfXY, 0, n-2, dfSnap ) )
+        {
+            // Drop the closing vertex, rotate, and close the ring again.
+            size_t iMin = 0;
+
+            adfXY.resize( n - 2 );
+            for( i = 2; i < adfXY.size(); i += 2 )
+            {
+                if( adfXY[i] < adfXY[iMin]
+                    || (adfXY[i] == adfXY[iMin] 
+                        && adfXY[i+1] < adfXY[iMin+1]) )
+                    iMin = i;
+            }
+            std::rotate( adfXY.begin(), adfXY.begin() + iMin, adfXY.end() );
+            adfXY.push_back( adfXY[0] );
+            adfXY.push_back( adfXY[1] );
+        }
+
+        aoKept.push_back( oLine );
+    }
+
+    std::sort( aoKept.begin(), aoKept.end(), LineLess );
+    aoLines.swap( aoKept );
+}
+
+/************************************************************************/
+/*                            SameLines()                               */
+/************************************************************************/
+
+static int SameLine( const ContourLine &oA, const ContourLine &oB,
+                     double dfTolerance )
+{
+    size_t i;
+
+    if( oA.dfLevel != oB.dfLevel || oA.adfXY.size() != oB.adfXY.size() )
+        return FALSE;
+
+    for( i = 0; i < oA.adfXY.size(); i++ )
+    {
+        if( fabs(oA.adfXY[i] - oB.adfXY[i]) > dfTolerance )
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static int SameLines( const std::vector<ContourLine> &aoA,
+                      const std::vector<ContourLine> &aoB,
+                      double dfTolerance )
+{
+    size_t iLine;
+
+    if( aoA.size() != aoB.size() )
+        return FALSE;
+
+    for( iLine = 0; iLine < aoA.size(); iLine++ )
+    {
+        if( !SameLine( aoA[iLine], aoB[iLine], dfTolerance ) )
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                           CountMissing()                             */
+/*                                                                      */
+/*      Count the lines of aoA that have no match in aoB.  Both are     */
+/*      normalized, so candidates are found by their first vertex.      */
+/************************************************************************/
+
+static bool FirstVertexLess( const ContourLine &oA, const ContourLine &oB )
+{
+    if( oA.dfLevel != oB.dfLevel )
+        return oA.dfLevel < oB.dfLevel;
+    return oA.adfXY[0] < oB.adfXY[0];
+}
+
+static int CountMissing( const std::vector<ContourLine> &aoA,
+                         const std::vector<ContourLine> &aoB,
+                         double dfTolerance )
+{
+    std::vector<int> abUsed( aoB.size(), 0 );
+    size_t iLine;
+    int nMissing = 0;
+
+    for( iLine = 0; iLine < aoA.size(); iLine++ )
+    {
+        ContourLine oKey;
+
+        oKey.dfLevel = aoA[iLine].dfLevel;
+        oKey.adfXY.push_back( aoA[iLine].adfXY[0] - dfTolerance );
+
+        size_t iCand = std::lower_bound( aoB.begin(), aoB.end(), oKey,
+                                         FirstVertexLess ) - aoB.begin();
+
+        for( ; iCand < aoB.size()
+               && aoB[iCand].dfLevel == oKey.dfLevel
+               && aoB[iCand].adfXY[0] <= aoA[iLine].adfXY[0] + dfTolerance;
+             iCand++ )
+        {
+            if( !abUsed[iCand]
+                && SameLine( aoA[iLine], aoB[iCand], dfTolerance ) )
+                break;
+        }
+
+        if( iCand < aoB.size() && !abUsed[iCand]
+            && SameLine( aoA[iLine], aoB[iCand], dfTolerance ) )
+            abUsed[iCand] = TRUE;
+        else
+            nMissing++;
+    }
+
+    return nMissing;
+}
+
+/************************************************************************/
+/*                                main()                                */
+/************************************************************************/
+
+int main( int argc, char ** argv )
+
+{
+    int nSize = 4096, nThreads = 4, nIterations = 1, bNoData = FALSE;
+    double dfInterval = 10.0;
+    const char *pszStripHeight = "256";
+    int i;
+
+    GDALAllRegister();
+    OGRRegisterAll();
+
+    argc = GDALGeneralCmdLineProcessor( argc, &argv, 0 );
+    if( argc < 1 )
+        exit( -argc );
+
+    for( i = 1; i < argc; i++ )
+    {
+        if( EQUAL(argv[i],"-size") && i < argc-1 )
+            nSize = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-interval") && i < argc-1 )
+            dfInterval = atof(argv[++i]);
+        else if( EQUAL(argv[i],"-threads") && i < argc-1 )
+            nThreads = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-strip") && i < argc-1 )
+            pszStripHeight = argv[++i];
+        else if( EQUAL(argv[i],"-nodata") )
+            bNoData = TRUE;
+        else if( EQUAL(argv[i],"-i") && i < argc-1 )
+            nIterations = atoi(argv[++i]);
+        else
+            Usage();
+    }
+
+    if( nSize < 2 || dfInterval <= 0.0 || nThreads < 2 || nIterations < 1 )
+        Usage();
+
+    GDALDatasetH hDS = CreateDEM( nSize, bNoData );
+    if( hDS == NULL )
+    {
+        fprintf( stderr, "Creating the DEM failed.\n" );
+        exit( 1 );
+    }
+
+    printf( "%dx%d Float32 DEM%s, contours every %g, strips of %s lines,\n"
+            "best of %d iterations\n",
+            nSize, nSize, bNoData ? " with nodata holes" : "", dfInterval,
+            pszStripHeight,
+            nIterations );
+
+/* -------------------------------------------------------------------- */
+/*      Time the one pass run and the strip runs.                       */
+/* -------------------------------------------------------------------- */
+    std::vector<ContourLine> aoSerial, aoStrips, aoTwoThreads;
+    double adfBest[2] = { 0.0, 0.0 };
+    int iRun, iIter;
+
+    for( iRun = 0; iRun < 2; iRun++ )
+    {
+        for( iIter = 0; iIter < nIterations; iIter++ )
+        {
+            double dfElapsed =
+                Contour( hDS, dfInterval, iRun ? nThreads : 1,
+                         iRun ? pszStripHeight : NULL,
+                         iRun ? aoStrips : aoSerial );
+            if( dfElapsed < 0.0 )
+            {
+                fprintf( stderr, "Contouring failed.\n" );
+                exit( 1 );
+            }
+            if( iIter == 0 || dfElapsed < adfBest[iRun] )
+                adfBest[iRun] = dfElapsed;
+        }
+    }
+
+    if( Contour( hDS, dfInterval, 2, pszStripHeight, aoTwoThreads ) < 0.0 )
+    {
+        fprintf( stderr, "Contouring failed.\n" );
+        exit( 1 );
+    }
+
+    int bSameOrder = SameLines( aoStrips, aoTwoThreads, 0.0 );
+    size_t nSerialLines = aoSerial.size(), nStripLines = aoStrips.size();
+
+    // Five times the generator join distance, in georeferenced units.
+    double dfSnap = 5 * 0.0001 * 10.0;
+
+    Normalize( aoSerial, dfSnap );
+    Normalize( aoStrips, dfSnap );
+
+    printf( "%-14s %10s %10s\n", "run", "seconds", "lines" );
+    printf( "%-14s %10.3f %10d\n", "1 thread",
+            adfBest[0], (int) nSerialLines );
+    printf( "%-14s %10.3f %10d\n", CPLSPrintf( "%d threads", nThreads ),
+            adfBest[1], (int) nStripLines );
+    printf( "speedup %.2f, order with 2 threads %s\n",
+            adfBest[0] / adfBest[1], bSameOrder ? "identical" : "DIFFERENT" );
+
+    int bSameGeometry = SameLines( aoSerial, aoStrips, dfSnap );
+
+    if( bSameGeometry )
+        printf( "geometry identical\n" );
+    else
+        printf( "geometry DIFFERENT: %d one pass lines and %d strip lines "
+                "have no match\n",
+                CountMissing( aoSerial, aoStrips, dfSnap ),
+                CountMissing( aoStrips, aoSerial, dfSnap ) );
+
+    GDALClose( hDS );
+    CSLDestroy( argv );
+    GDALDestroyDriverManager();
+    OGRCleanupAll();
+
+    return (bSameGeometry && bSameOrder) ? 0 : 1;
+}
@@ -0,0 +1,251 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Utilities
+ * Purpose:  Benchmark of GDALCopyWords() over the matrix of real data
+ *           type conversions, packed and strided.
+ *
+ ******************************************************************************
+ * Copyright (c) 2010, GDAL contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+
+#include "gdal_priv.h"
+#include "cpl_conv.h"
+#include "cpl_string.h"
+
+CPL_CVSID("$Id$");
+
+/************************************************************************/
+/*                               Usage()                                */
+/************************************************************************/
+
+static void Usage()
+{
+    printf( "copywordsbench [-n <words>] [-bands <n>] [-i <calls>]\n"
+            "\n"
+            "Converts n words with GDALCopyWords() between every pair of\n"
+            "real data types, packed, and from and to a pixel interleaved\n"
+            "buffer of the given number of bands.  Reports millions of words\n"
+            "per second over the best of 3 rounds of i calls, and whether\n"
+            "the result matches a word by word conversion, which always\n"
+            "takes the generic code path.  Run it once more with --config\n"
+            "GDAL_COPYWORDS_SIMD NO (or SSE2) to get the figures to compare\n"
+            "with.\n" );
+    exit( 1 );
+}
+
+/************************************************************************/
+/*                            FillSource()                              */
+/*                                                                      */
+/*      Pseudo random values over the range of the type, and for the    */
+/*      floating point types a share of values near the rounding and    */
+/*      clamping limits of the integer types, infinities and NaNs.      */
+/************************************************************************/
+
+static void FillSource( GByte *pabyData, GDALDataType eType, int nStride,
+                        int nWords )
+{
+    static const double adfSpecial[] = {
+        0.0, -0.0, 0.5, -0.5, 0.49999997, -0.49999997, 1.5, -1.5,
+        254.5, 255.49, 255.5, 256.0, -1.0, 65534.5, 65535.5, 65536.0,
+        32766.5, 32767.5, -32767.5, -32768.5, -32769.0, 2147483520.0,
+        -2147483648.0, 1e10, -1e10, 1e300, -1e300, 1e-310 };
+    const int nSpecial = sizeof(adfSpecial) / sizeof(adfSpecial[0]);
+    GUInt32 nSeed = 1;
+    int i;
+
+    for( i = 0; i < nWords; i++ )
+    {
+        double dfValue;
+        GUInt32 nRand;
+
+        nSeed = nSeed * 1103515245 + 12345;
+        nRand = nSeed >> 8;
+
+        switch( eType )
+        {
+          case GDT_Byte:    dfValue = nRand & 0xff;               break;
+          case GDT_UInt16:  dfValue = nRand & 0xffff;             break;
+          case GDT_Int16:   dfValue = (int) (nRand & 0xffff) - 32768; break;
+          case GDT_UInt32:  dfValue = nSeed;                      break;
+          case GDT_Int32:   dfValue = (GInt32) nSeed;             break;
+          default:
+            if( (nRand & 15) == 0 )
+                dfValue = adfSpecial[(nRand >> 4) % nSpecial];
+            else
+                dfValue = ((int) (nRand & 0x3ffff) - 0x18000) / 3.0;
+            break;
+        }
+
+        GDALCopyWords( &dfValue, GDT_Float64, 0,
+                       pabyData + i * nStride, eType, 0, 1 );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      GDALCopyWords() clamps, put the special values in directly.     */
+/* -------------------------------------------------------------------- */
+    if( eType == GDT_Float32 || eType == GDT_Float64 )
+    {
+        double dfInf = 1e300 * 1e300;
+        double adfNonFinite[3];
+
+        adfNonFinite[0] = dfInf;
+        adfNonFinite[1] = -dfInf;
+        adfNonFinite[2] = dfInf - dfInf;
+
+        for( i = 7; i < nWords; i += 97 )
+        {
+            if( eType == GDT_Float32 )
+                *(float *) (pabyData + i * nStride) =
+                    (float) adfNonFinite[i % 3];
+            else
+                *(double *) (pabyData + i * nStride) = adfNonFinite[i % 3];
+        }
+    }
+}
+
+/************************************************************************/
+/*                                main()                                */
+/************************************************************************/
+
+int main( int argc, char ** argv )
+
+{
+    int nWords = 65536, nBands = 3, nIterations = 200;
+    int i;
+
+    GDALAllRegister();
+
+    argc = GDALGeneralCmdLineProcessor( argc, &argv, 0 );
+    if( argc < 1 )
+        exit( -argc );
+
+    for( i = 1; i < argc; i++ )
+    {
+        if( EQUAL(argv[i],"-n") && i < argc-1 )
+            nWords = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-bands") && i < argc-1 )
+            nBands = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-i") && i < argc-1 )
+            nIterations = atoi(argv[++i]);
+        else
+            Usage();
+    }
+
+    if( nWords < 1 || nBands < 2 || nIterations < 1 )
+        Usage();
+
+    GByte *pabySrc = (GByte *) VSIMalloc3( nWords, nBands, 8 );
+    GByte *pabyDst = (GByte *) VSIMalloc3( nWords, nBands, 8 );
+    GByte *pabyRef = (GByte *) VSIMalloc3( nWords, nBands, 8 );
+
+    if( pabySrc == NULL || pabyDst == NULL || pabyRef == NULL )
+        exit( 1 );
+
+    printf( "%d words, %d bands when interleaved, best of 3 rounds of %d "
+            "calls, GDAL_COPYWORDS_SIMD=%s\n", nWords, nBands, nIterations,
+            CPLGetConfigOption( "GDAL_COPYWORDS_SIMD", "YES" ) );
+    printf( "%-8s %-8s %12s %12s %12s  %s\n", "from", "to",
+            "packed", "strided src", "strided dst", "values" );
+
+    const GDALDataType aeTypes[7] = { GDT_Byte, GDT_UInt16, GDT_Int16,
+                                      GDT_UInt32, GDT_Int32, GDT_Float32,
+                                      GDT_Float64 };
+    int iSrc, iDst, iLayout, iRound, iIter, nMismatches = 0;
+
+    for( iSrc = 0; iSrc < 7; iSrc++ )
+    {
+        for( iDst = 0; iDst < 7; iDst++ )
+        {
+            GDALDataType eSrcType = aeTypes[iSrc];
+            GDALDataType eDstType = aeTypes[iDst];
+            int nSrcSize = GDALGetDataTypeSize( eSrcType ) / 8;
+            int nDstSize = GDALGetDataTypeSize( eDstType ) / 8;
+            double adfRate[3];
+            int bSame = TRUE;
+
+            if( eSrcType == eDstType )
+                continue;
+
+/* -------------------------------------------------------------------- */
+/*      Layouts: both packed, source interleaved, destination           */
+/*      interleaved.                                                    */
+/* -------------------------------------------------------------------- */
+            for( iLayout = 0; iLayout < 3; iLayout++ )
+            {
+                int nSrcStride = iLayout == 1 ? nSrcSize * nBands : nSrcSize;
+                int nDstStride = iLayout == 2 ? nDstSize * nBands : nDstSize;
+                double dfBest = 0.0;
+
+                FillSource( pabySrc, eSrcType, nSrcStride, nWords );
+                memset( pabyDst, 0, (size_t) nWords * nDstStride );
+                memset( pabyRef, 0, (size_t) nWords * nDstStride );
+
+                /* A call is too short to be timed alone, time batches */
+                for( iRound = 0; iRound < 3; iRound++ )
+                {
+                    double dfStart = CPLGetWallTime();
+
+                    for( iIter = 0; iIter < nIterations; iIter++ )
+                        GDALCopyWords( pabySrc, eSrcType, nSrcStride,
+                                       pabyDst, eDstType, nDstStride,
+                                       nWords );
+
+                    double dfTime = CPLGetWallTime() - dfStart;
+
+                    if( iRound == 0 || dfTime < dfBest )
+                        dfBest = dfTime;
+                }
+
+                adfRate[iLayout] = dfBest > 0 ?
+                    nWords * (double) nIterations / dfBest : 0.0;
+
+                for( i = 0; i < nWords; i++ )
+                    GDALCopyWords( pabySrc + i * nSrcStride, eSrcType,
+                                   nSrcStride, pabyRef + i * nDstStride,
+                                   eDstType, nDstStride, 1 );
+
+                if( memcmp( pabyDst, pabyRef,
+                            (size_t) nWords * nDstStride ) != 0 )
+                    bSame = FALSE;
+            }
+
+            if( !bSame )
+                nMismatches++;
+
+            printf( "%-8s %-8s %12.1f %12.1f %12.1f  %s\n",
+                    GDALGetDataTypeName( eSrcType ),
+                    GDALGetDataTypeName( eDstType ),
+                    adfRate[0] / 1000000.0, adfRate[1] / 1000000.0,
+                    adfRate[2] / 1000000.0,
+                    bSame ? "identical" : "DIFFERENT" );
+        }
+    }
+
+    VSIFree( pabySrc );
+    VSIFree( pabyDst );
+    VSIFree( pabyRef );
+    CSLDestroy( argv );
+    GDALDestroyDriverManager();
+
+    return nMismatches ? 1 : 0;
+}
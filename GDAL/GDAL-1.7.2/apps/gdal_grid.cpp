@@ -70,7 +70,7 @@ static void Usage()
         "    [-l layername]* [-where expression] [-sql select_statement]\n"
         "    [-txe xmin xmax] [-tye ymin ymax] [-outsize xsize ysize]\n"
         "    [-a algorithm[:parameter1=value1]*]"
-        "    [-q]\n"
+        "    [-nthreads n|ALL_CPUS] [-q]\n"
         "    <src_datasource> <dst_filename>\n"
         "\n"
         "Available algorithms and parameters with their's defaults:\n"
@@ -415,16 +415,16 @@ static void ProcessGeometry( OGRPoint *poGeom, OGRGeometry *poClipSrc,
 /*      geometries and burn values.                                     */
 /************************************************************************/
 
-static void ProcessLayer( OGRLayerH hSrcLayer, GDALDatasetH hDstDS,
-                          OGRGeometry *poClipSrc,
-                          GUInt32 nXSize, GUInt32 nYSize, int nBand,
-                          int& bIsXExtentSet, int& bIsYExtentSet,
-                          double& dfXMin, double& dfXMax,
-                          double& dfYMin, double& dfYMax,
-                          const char *pszBurnAttribute,
-                          GDALDataType eType,
-                          GDALGridAlgorithm eAlgorithm, void *pOptions,
-                          int bQuiet, GDALProgressFunc pfnProgress )
+static CPLErr ProcessLayer( OGRLayerH hSrcLayer, GDALDatasetH hDstDS,
+                            OGRGeometry *poClipSrc,
+                            GUInt32 nXSize, GUInt32 nYSize, int nBand,
+                            int& bIsXExtentSet, int& bIsYExtentSet,
+                            double& dfXMin, double& dfXMax,
+                            double& dfYMin, double& dfYMax,
+                            const char *pszBurnAttribute,
+                            GDALDataType eType,
+                            GDALGridAlgorithm eAlgorithm, void *pOptions,
+                            int bQuiet, GDALProgressFunc pfnProgress )
 
 {
 /* -------------------------------------------------------------------- */
@@ -441,7 +441,7 @@ static void ProcessLayer( OGRLayerH hSrcLayer, GDALDatasetH hDstDS,
             printf( "Failed to find field %s on layer %s, skipping.\n",
                     pszBurnAttribute, 
                     OGR_FD_GetName( OGR_L_GetLayerDefn( hSrcLayer ) ) );
-            return;
+            return CE_None;
         }
     }
 
@@ -492,7 +492,7 @@ static void ProcessLayer( OGRLayerH hSrcLayer, GDALDatasetH hDstDS,
     {
         printf( "No point geometry found on layer %s, skipping.\n",
                 OGR_FD_GetName( OGR_L_GetLayerDefn( hSrcLayer ) ) );
-        return;
+        return CE_None;
     }
 
 /* -------------------------------------------------------------------- */
@@ -540,9 +540,14 @@ static void ProcessLayer( OGRLayerH hSrcLayer, GDALDatasetH hDstDS,
     {
         // FIXME: Shoulda' set to nodata value instead
         GDALFillRaster( hBand, 0.0 , 0.0 );
-        return;
+        return CE_None;
     }
 
+/* -------------------------------------------------------------------- */
+/*      Grid the raster one block at a time.  The threads share the     */
+/*      rows, or the columns of single strips, of each block, and the   */
+/*      node coordinates are derived from the block bounds as before.   */
+/* -------------------------------------------------------------------- */
     GUInt32 nXOffset, nYOffset;
     int     nBlockXSize, nBlockYSize;
 
@@ -554,9 +559,26 @@ static void ProcessLayer( OGRLayerH hSrcLayer, GDALDatasetH hDstDS,
     GUInt32 nBlockCount = ((nXSize + nBlockXSize - 1) / nBlockXSize)
         * ((nYSize + nBlockYSize - 1) / nBlockYSize);
 
-    for ( nYOffset = 0; nYOffset < nYSize; nYOffset += nBlockYSize )
+/* -------------------------------------------------------------------- */
+/*      Prepare the points once for all the blocks.                     */
+/* -------------------------------------------------------------------- */
+    double  dfStartTime = CPLGetWallTime();
+    GDALGridContext *psContext =
+        GDALGridContextCreate( eAlgorithm, pOptions, adfX.size(),
+                               &(adfX[0]), &(adfY[0]), &(adfZ[0]) );
+    if ( psContext == NULL )
+    {
+        CPLFree( pData );
+        return CE_Failure;
+    }
+
+    CPLErr  eErr = CE_None;
+
+    for ( nYOffset = 0; nYOffset < nYSize && eErr == CE_None;
+          nYOffset += nBlockYSize )
     {
-        for ( nXOffset = 0; nXOffset < nXSize; nXOffset += nBlockXSize )
+        for ( nXOffset = 0; nXOffset < nXSize && eErr == CE_None;
+              nXOffset += nBlockXSize )
         {
             void *pScaledProgress;
             pScaledProgress =
@@ -572,24 +594,38 @@ static void ProcessLayer( OGRLayerH hSrcLayer, GDALDatasetH hDstDS,
             if (nYOffset + nYRequest > nYSize)
                 nYRequest = nYSize - nYOffset;
 
-            GDALGridCreate( eAlgorithm, pOptions,
-                            adfX.size(), &(adfX[0]), &(adfY[0]), &(adfZ[0]),
-                            dfXMin + dfDeltaX * nXOffset,
-                            dfXMin + dfDeltaX * (nXOffset + nXRequest),
-                            dfYMin + dfDeltaY * nYOffset,
-                            dfYMin + dfDeltaY * (nYOffset + nYRequest),
-                            nXRequest, nYRequest, eType, pData,
-                            GDALScaledProgress, pScaledProgress );
+            eErr = GDALGridContextProcess( psContext,
+                                    dfXMin + dfDeltaX * nXOffset,
+                                    dfXMin + dfDeltaX * (nXOffset + nXRequest),
+                                    dfYMin + dfDeltaY * nYOffset,
+                                    dfYMin + dfDeltaY * (nYOffset + nYRequest),
+                                    nXRequest, nYRequest, eType, pData,
+                                    GDALScaledProgress, pScaledProgress );
 
-            GDALRasterIO( hBand, GF_Write, nXOffset, nYOffset,
-                          nXRequest, nYRequest, pData,
-                          nXRequest, nYRequest, eType, 0, 0 );
+            if ( eErr == CE_None )
+                eErr = GDALRasterIO( hBand, GF_Write, nXOffset, nYOffset,
+                                     nXRequest, nYRequest, pData,
+                                     nXRequest, nYRequest, eType, 0, 0 );
 
             GDALDestroyScaledProgress( pScaledProgress );
         }
     }
 
+    GDALGridContextFree( psContext );
+
+/* -------------------------------------------------------------------- */
+/*      Report the gridding time, so that runs with the point index     */
+/*      (the default) and without it (--config GDAL_GRID_INDEX NO)      */
+/*      can be compared with --debug on.                                */
+/* -------------------------------------------------------------------- */
+    CPLDebug( "GDAL_GRID", "Gridding took %.3f seconds (point index %s).",
+              CPLGetWallTime() - dfStartTime,
+              CSLTestBoolean( CPLGetConfigOption( "GDAL_GRID_INDEX", "YES" ) )
+              ? "enabled" : "disabled" );
+
     CPLFree( pData );
+
+    return eErr;
 }
 
 /************************************************************************/
@@ -735,6 +771,11 @@ int main( int argc, char ** argv )
             pszFormat = argv[++i];
         }
 
+        else if( EQUAL(argv[i],"-nthreads") && i < argc-1 )
+        {
+            CPLSetConfigOption( "GDAL_NUM_THREADS", argv[++i] );
+        }
+
         else if( EQUAL(argv[i],"-q") || EQUAL(argv[i],"-quiet") )
         {
             bQuiet = TRUE;
@@ -1053,6 +1094,8 @@ int main( int argc, char ** argv )
 /* -------------------------------------------------------------------- */
 /*      Process SQL request.                                            */
 /* -------------------------------------------------------------------- */
+    CPLErr  eErr = CE_None;
+
     if( pszSQL != NULL )
     {
         OGRLayerH hLayer;
@@ -1062,18 +1105,18 @@ int main( int argc, char ** argv )
         if( hLayer != NULL )
         {
             // Custom layer will be rasterized in the first band.
-            ProcessLayer( hLayer, hDstDS, poClipSrc, nXSize, nYSize, 1,
-                          bIsXExtentSet, bIsYExtentSet,
-                          dfXMin, dfXMax, dfYMin, dfYMax, pszBurnAttribute,
-                          eOutputType, eAlgorithm, pOptions,
-                          bQuiet, pfnProgress );
+            eErr = ProcessLayer( hLayer, hDstDS, poClipSrc, nXSize, nYSize,
+                                 1, bIsXExtentSet, bIsYExtentSet,
+                                 dfXMin, dfXMax, dfYMin, dfYMax,
+                                 pszBurnAttribute, eOutputType,
+                                 eAlgorithm, pOptions, bQuiet, pfnProgress );
         }
     }
 
 /* -------------------------------------------------------------------- */
 /*      Process each layer.                                             */
 /* -------------------------------------------------------------------- */
-    for( i = 0; i < nLayerCount; i++ )
+    for( i = 0; i < nLayerCount && eErr == CE_None; i++ )
     {
         OGRLayerH hLayer = OGR_DS_GetLayerByName( hSrcDS, papszLayers[i] );
         if( hLayer == NULL )
@@ -1100,12 +1143,12 @@ int main( int argc, char ** argv )
                 OSRExportToWkt( hSRS, &pszOutputSRS );
         }
 
-        ProcessLayer( hLayer, hDstDS, poClipSrc, nXSize, nYSize,
-                      i + 1 + nBands - nLayerCount,
-                      bIsXExtentSet, bIsYExtentSet,
-                      dfXMin, dfXMax, dfYMin, dfYMax, pszBurnAttribute,
-                      eOutputType, eAlgorithm, pOptions,
-                      bQuiet, pfnProgress );
+        eErr = ProcessLayer( hLayer, hDstDS, poClipSrc, nXSize, nYSize,
+                             i + 1 + nBands - nLayerCount,
+                             bIsXExtentSet, bIsYExtentSet,
+                             dfXMin, dfXMax, dfYMin, dfYMax, pszBurnAttribute,
+                             eOutputType, eAlgorithm, pOptions,
+                             bQuiet, pfnProgress );
     }
 
 /* -------------------------------------------------------------------- */
@@ -1146,6 +1189,6 @@ int main( int argc, char ** argv )
 
     GDALDestroyDriverManager();
  
-    return 0;
+    return ( eErr == CE_None ) ? 0 : 1;
 }
 
@@ -89,6 +89,7 @@
 #include "cpl_string.h"
 #include "gdal.h"
 #include "gdal_priv.h"
+#include "gdal_alg.h"
 
 CPL_CVSID("$Id$");
 
@@ -145,362 +146,6 @@ static void Usage()
     exit( 1 );
 }
 
-/************************************************************************/
-/*                  GDALGeneric3x3Processing()                          */
-/************************************************************************/
-
-typedef float (*GDALGeneric3x3ProcessingAlg) (float* pafWindow, float fDstNoDataValue, void* pData);
-
-CPLErr GDALGeneric3x3Processing  ( GDALRasterBandH hSrcBand,
-                                   GDALRasterBandH hDstBand,
-                                   GDALGeneric3x3ProcessingAlg pfnAlg,
-                                   void* pData,
-                                   GDALProgressFunc pfnProgress,
-                                   void * pProgressData)
-{
-    CPLErr eErr;
-    float *pafThreeLineWin; /* 3 line rotating source buffer */
-    float *pafOutputBuf;     /* 1 line destination buffer */
-    int i, j;
-
-    int bSrcHasNoData, bDstHasNoData;
-    float fSrcNoDataValue = 0.0, fDstNoDataValue = 0.0;
-
-    int nXSize = GDALGetRasterBandXSize(hSrcBand);
-    int nYSize = GDALGetRasterBandYSize(hSrcBand);
-
-    if (pfnProgress == NULL)
-        pfnProgress = GDALDummyProgress;
-
-/* -------------------------------------------------------------------- */
-/*      Initialize progress counter.                                    */
-/* -------------------------------------------------------------------- */
-    if( !pfnProgress( 0.0, NULL, pProgressData ) )
-    {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
-    }
-
-    pafOutputBuf = (float *) CPLMalloc(sizeof(float)*nXSize);
-    pafThreeLineWin  = (float *) CPLMalloc(3*sizeof(float)*(nXSize+1));
-
-    fSrcNoDataValue = (float) GDALGetRasterNoDataValue(hSrcBand, &bSrcHasNoData);
-    fDstNoDataValue = (float) GDALGetRasterNoDataValue(hDstBand, &bDstHasNoData);
-    if (!bDstHasNoData)
-        fDstNoDataValue = 0.0;
-
-    // Move a 3x3 pafWindow over each cell 
-    // (where the cell in question is #4)
-    // 
-    //      0 1 2
-    //      3 4 5
-    //      6 7 8
-
-    /* Preload the first 2 lines */
-    for ( i = 0; i < 2 && i < nYSize; i++)
-    {
-        GDALRasterIO(   hSrcBand,
-                        GF_Read,
-                        0, i,
-                        nXSize, 1,
-                        pafThreeLineWin + i * nXSize,
-                        nXSize, 1,
-                        GDT_Float32,
-                        0, 0);
-    }
-    
-    // Exclude the edges
-    for (j = 0; j < nXSize; j++)
-    {
-        pafOutputBuf[j] = fDstNoDataValue;
-    }
-    GDALRasterIO(hDstBand, GF_Write,
-                 0, 0, nXSize, 1,
-                 pafOutputBuf, nXSize, 1, GDT_Float32, 0, 0);
-
-    if (nYSize > 1)
-    {
-        GDALRasterIO(hDstBand, GF_Write,
-                     0, nYSize - 1, nXSize, 1,
-                     pafOutputBuf, nXSize, 1, GDT_Float32, 0, 0);
-    }
-    
-    int nLine1Off = 0*nXSize;
-    int nLine2Off = 1*nXSize;
-    int nLine3Off = 2*nXSize;
-
-    for ( i = 1; i < nYSize-1; i++)
-    {
-        /* Read third line of the line buffer */
-        eErr = GDALRasterIO(   hSrcBand,
-                        GF_Read,
-                        0, i+1,
-                        nXSize, 1,
-                        pafThreeLineWin + nLine3Off,
-                        nXSize, 1,
-                        GDT_Float32,
-                        0, 0);
-        if (eErr != CE_None)
-            goto end;
-
-        // Exclude the edges
-        pafOutputBuf[0] = fDstNoDataValue;
-        if (nXSize > 1)
-            pafOutputBuf[nXSize - 1] = fDstNoDataValue;
-        
-        for (j = 1; j < nXSize - 1; j++)
-        {
-            float afWin[9];
-            afWin[0] = pafThreeLineWin[nLine1Off + j-1];
-            afWin[1] = pafThreeLineWin[nLine1Off + j];
-            afWin[2] = pafThreeLineWin[nLine1Off + j+1];
-            afWin[3] = pafThreeLineWin[nLine2Off + j-1];
-            afWin[4] = pafThreeLineWin[nLine2Off + j];
-            afWin[5] = pafThreeLineWin[nLine2Off + j+1];
-            afWin[6] = pafThreeLineWin[nLine3Off + j-1];
-            afWin[7] = pafThreeLineWin[nLine3Off + j];
-            afWin[8] = pafThreeLineWin[nLine3Off + j+1];
-
-            if (bSrcHasNoData && (
-                   afWin[0] == fSrcNoDataValue ||
-                   afWin[1] == fSrcNoDataValue ||
-                   afWin[2] == fSrcNoDataValue ||
-                   afWin[3] == fSrcNoDataValue ||
-                   afWin[4] == fSrcNoDataValue ||
-                   afWin[5] == fSrcNoDataValue ||
-                   afWin[6] == fSrcNoDataValue ||
-                   afWin[7] == fSrcNoDataValue ||
-                   afWin[8] == fSrcNoDataValue))
-            {
-                // We have nulls so write nullValue and move on
-                pafOutputBuf[j] = fDstNoDataValue;
-            }
-            else
-            {
-                // We have a valid 3x3 window.
-                pafOutputBuf[j] = pfnAlg(afWin, fDstNoDataValue, pData);
-            }
-        }
-
-        /* -----------------------------------------
-         * Write Line to Raster
-         */
-        eErr = GDALRasterIO(hDstBand, GF_Write, 0, i, nXSize, 1,
-                     pafOutputBuf, nXSize, 1, GDT_Float32, 0, 0);
-        if (eErr != CE_None)
-            goto end;
-
-        if( !pfnProgress( 1.0 * (i+1) / nYSize, NULL, pProgressData ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-            goto end;
-        }
-        
-        int nTemp = nLine1Off;
-        nLine1Off = nLine2Off;
-        nLine2Off = nLine3Off;
-        nLine3Off = nTemp;
-    }
-
-    pfnProgress( 1.0, NULL, pProgressData );
-    eErr = CE_None;
-
-end:
-    CPLFree(pafOutputBuf);
-    CPLFree(pafThreeLineWin);
-
-    return eErr;
-}
-
-
-/************************************************************************/
-/*                         GDALHillshade()                              */
-/************************************************************************/
-
-typedef struct
-{
-    double nsres;
-    double ewres;
-    double sin_altRadians;
-    double cos_altRadians_mul_z_scale_factor;
-    double azRadians;
-    double square_z_scale_factor;
-} GDALHillshadeAlgData;
-
-/* Unoptimized formulas are :
-    x = psData->z*((afWin[0] + afWin[3] + afWin[3] + afWin[6]) -
-        (afWin[2] + afWin[5] + afWin[5] + afWin[8])) /
-        (8.0 * psData->ewres * psData->scale);
-
-    y = psData->z*((afWin[6] + afWin[7] + afWin[7] + afWin[8]) -
-        (afWin[0] + afWin[1] + afWin[1] + afWin[2])) /
-        (8.0 * psData->nsres * psData->scale);
-
-    slope = M_PI / 2 - atan(sqrt(x*x + y*y));
-
-    aspect = atan2(x,y);
-
-    cang = sin(alt * degreesToRadians) * sin(slope) +
-           cos(alt * degreesToRadians) * cos(slope) *
-           cos(az * degreesToRadians - M_PI/2 - aspect);
-*/
-
-float GDALHillshadeAlg (float* afWin, float fDstNoDataValue, void* pData)
-{
-    GDALHillshadeAlgData* psData = (GDALHillshadeAlgData*)pData;
-    double x, y, aspect, xx_plus_yy, cang;
-    
-    // First Slope ...
-    x = ((afWin[0] + afWin[3] + afWin[3] + afWin[6]) -
-        (afWin[2] + afWin[5] + afWin[5] + afWin[8])) / psData->ewres;
-
-    y = ((afWin[6] + afWin[7] + afWin[7] + afWin[8]) -
-        (afWin[0] + afWin[1] + afWin[1] + afWin[2])) / psData->nsres;
-
-    xx_plus_yy = x * x + y * y;
-
-    // ... then aspect...
-    aspect = atan2(x,y);
-
-    // ... then the shade value
-    cang = (psData->sin_altRadians -
-           psData->cos_altRadians_mul_z_scale_factor * sqrt(xx_plus_yy) *
-           sin(aspect - psData->azRadians)) /
-           sqrt(1 + psData->square_z_scale_factor * xx_plus_yy);
-
-    if (cang <= 0.0) 
-        cang = 1.0;
-    else
-        cang = 1.0 + (254.0 * cang);
-        
-    return cang;
-}
-
-void*  GDALCreateHillshadeData(double* adfGeoTransform,
-                               double z,
-                               double scale,
-                               double alt,
-                               double az)
-{
-    GDALHillshadeAlgData* pData =
-        (GDALHillshadeAlgData*)CPLMalloc(sizeof(GDALHillshadeAlgData));
-        
-    const double degreesToRadians = M_PI / 180.0;
-    pData->nsres = adfGeoTransform[5];
-    pData->ewres = adfGeoTransform[1];
-    pData->sin_altRadians = sin(alt * degreesToRadians);
-    pData->azRadians = az * degreesToRadians;
-    double z_scale_factor = z / (8 * scale);
-    pData->cos_altRadians_mul_z_scale_factor =
-        cos(alt * degreesToRadians) * z_scale_factor;
-    pData->square_z_scale_factor = z_scale_factor * z_scale_factor;
-    return pData;
-}
-
-/************************************************************************/
-/*                         GDALSlope()                                  */
-/************************************************************************/
-
-typedef struct
-{
-    double nsres;
-    double ewres;
-    double scale;
-    int    slopeFormat;
-} GDALSlopeAlgData;
-
-float GDALSlopeAlg (float* afWin, float fDstNoDataValue, void* pData)
-{
-    const double radiansToDegrees = 180.0 / M_PI;
-    GDALSlopeAlgData* psData = (GDALSlopeAlgData*)pData;
-    double dx, dy, key;
-    
-    dx = ((afWin[0] + afWin[3] + afWin[3] + afWin[6]) - 
-          (afWin[2] + afWin[5] + afWin[5] + afWin[8]))/psData->ewres;
-
-    dy = ((afWin[6] + afWin[7] + afWin[7] + afWin[8]) - 
-          (afWin[0] + afWin[1] + afWin[1] + afWin[2]))/psData->nsres;
-
-    key = (dx * dx + dy * dy);
-
-    if (psData->slopeFormat == 1) 
-        return atan(sqrt(key) / (8*psData->scale)) * radiansToDegrees;
-    else
-        return 100*(sqrt(key) / (8*psData->scale));
-}
-
-void*  GDALCreateSlopeData(double* adfGeoTransform,
-                           double scale,
-                           int slopeFormat)
-{
-    GDALSlopeAlgData* pData =
-        (GDALSlopeAlgData*)CPLMalloc(sizeof(GDALSlopeAlgData));
-        
-    pData->nsres = adfGeoTransform[5];
-    pData->ewres = adfGeoTransform[1];
-    pData->scale = scale;
-    pData->slopeFormat = slopeFormat;
-    return pData;
-}
-
-/************************************************************************/
-/*                         GDALAspect()                                 */
-/************************************************************************/
-
-typedef struct
-{
-    int bAngleAsAzimuth;
-} GDALAspectAlgData;
-
-float GDALAspectAlg (float* afWin, float fDstNoDataValue, void* pData)
-{
-    const double degreesToRadians = M_PI / 180.0;
-    GDALAspectAlgData* psData = (GDALAspectAlgData*)pData;
-    double dx, dy;
-    float aspect;
-    
-    dx = ((afWin[2] + afWin[5] + afWin[5] + afWin[8]) -
-          (afWin[0] + afWin[3] + afWin[3] + afWin[6]));
-
-    dy = ((afWin[6] + afWin[7] + afWin[7] + afWin[8]) - 
-          (afWin[0] + afWin[1] + afWin[1] + afWin[2]));
-
-    aspect = atan2(dy,-dx) / degreesToRadians;
-
-    if (dx == 0 && dy == 0)
-    {
-        /* Flat area */
-        aspect = fDstNoDataValue;
-    } 
-    else if ( psData->bAngleAsAzimuth )
-    {
-        if (aspect > 90.0) 
-            aspect = 450.0 - aspect;
-        else
-            aspect = 90.0 - aspect;
-    }
-    else
-    {
-        if (aspect < 0)
-            aspect += 360.0;
-    }
-
-    if (aspect == 360.0) 
-        aspect = 0.0;
-
-    return aspect;
-}
-
-void*  GDALCreateAspectData(int bAngleAsAzimuth)
-{
-    GDALAspectAlgData* pData =
-        (GDALAspectAlgData*)CPLMalloc(sizeof(GDALAspectAlgData));
-        
-    pData->bAngleAsAzimuth = bAngleAsAzimuth;
-    return pData;
-}
-
 /************************************************************************/
 /*                      GDALColorRelief()                               */
 /************************************************************************/
@@ -1377,69 +1022,6 @@ CPLErr GDALGenerateVRTColorRelief(const char* pszDstFilename,
 }
 
 
-/************************************************************************/
-/*                         GDALTRIAlg()                                 */
-/************************************************************************/
-
-float GDALTRIAlg (float* afWin, float fDstNoDataValue, void* pData)
-{
-    // Terrain Ruggedness is average difference in height
-    return (fabs(afWin[0]-afWin[4]) +
-            fabs(afWin[1]-afWin[4]) +
-            fabs(afWin[2]-afWin[4]) +
-            fabs(afWin[3]-afWin[4]) +
-            fabs(afWin[5]-afWin[4]) +
-            fabs(afWin[6]-afWin[4]) +
-            fabs(afWin[7]-afWin[4]) +
-            fabs(afWin[8]-afWin[4]))/8;
-}
-
-
-/************************************************************************/
-/*                         GDALTPIAlg()                                 */
-/************************************************************************/
-
-float GDALTPIAlg (float* afWin, float fDstNoDataValue, void* pData)
-{
-    // Terrain Position is the difference between
-    // The central cell and the mean of the surrounding cells
-    return afWin[4] - 
-            ((afWin[0]+
-              afWin[1]+
-              afWin[2]+
-              afWin[3]+
-              afWin[5]+
-              afWin[6]+
-              afWin[7]+
-              afWin[8])/8);
-}
-
-/************************************************************************/
-/*                     GDALRoughnessAlg()                               */
-/************************************************************************/
-
-float GDALRoughnessAlg (float* afWin, float fDstNoDataValue, void* pData)
-{
-    // Roughness is the largest difference
-    //  between any two cells
-
-    float pafRoughnessMin = afWin[0];
-    float pafRoughnessMax = afWin[0];
-
-    for ( int k = 1; k < 9; k++)
-    {
-        if (afWin[k] > pafRoughnessMax)
-        {
-            pafRoughnessMax=afWin[k];
-        }
-        if (afWin[k] < pafRoughnessMin)
-        {
-            pafRoughnessMin=afWin[k];
-        }
-    }
-    return pafRoughnessMax - pafRoughnessMin;
-}
-
 /************************************************************************/
 /* ==================================================================== */
 /*                       GDALGeneric3x3Dataset                        */
@@ -1452,14 +1034,13 @@ class GDALGeneric3x3Dataset : public GDALDataset
 {
     friend class GDALGeneric3x3RasterBand;
 
-    GDALGeneric3x3ProcessingAlg pfnAlg;
-    void*              pAlgData;
+    GDALTerrainContext* psContext;
     GDALDatasetH       hSrcDS;
     GDALRasterBandH    hSrcBand;
-    float*             apafSourceBuf[3];
+    float*             pafSourceBuf;
+    float*             pafOutputBuf;
     int                bDstHasNoData;
     double             dfDstNoDataValue;
-    int                nCurLine;
 
   public:
                         GDALGeneric3x3Dataset(GDALDatasetH hSrcDS,
@@ -1467,8 +1048,8 @@ class GDALGeneric3x3Dataset : public GDALDataset
                                               GDALDataType eDstDataType,
                                               int bDstHasNoData,
                                               double dfDstNoDataValue,
-                                              GDALGeneric3x3ProcessingAlg pfnAlg,
-                                              void* pAlgData);
+                                              GDALTerrainAlgorithm eAlg,
+                                              const GDALTerrainOptions* psOptions);
                        ~GDALGeneric3x3Dataset();
 
     CPLErr      GetGeoTransform( double * padfGeoTransform );
@@ -1500,13 +1081,11 @@ GDALGeneric3x3Dataset::GDALGeneric3x3Dataset(
                                      GDALDataType eDstDataType,
                                      int bDstHasNoData,
                                      double dfDstNoDataValue,
-                                     GDALGeneric3x3ProcessingAlg pfnAlg,
-                                     void* pAlgData)
+                                     GDALTerrainAlgorithm eAlg,
+                                     const GDALTerrainOptions* psOptions)
 {
     this->hSrcDS = hSrcDS;
     this->hSrcBand = hSrcBand;
-    this->pfnAlg = pfnAlg;
-    this->pAlgData = pAlgData;
     this->bDstHasNoData = bDstHasNoData;
     this->dfDstNoDataValue = dfDstNoDataValue;
     
@@ -1515,20 +1094,28 @@ GDALGeneric3x3Dataset::GDALGeneric3x3Dataset(
     nRasterXSize = GDALGetRasterXSize(hSrcDS);
     nRasterYSize = GDALGetRasterYSize(hSrcDS);
     
-    SetBand(1, new GDALGeneric3x3RasterBand(this, eDstDataType));
-    
-    apafSourceBuf[0] = (float *) CPLMalloc(sizeof(float)*nRasterXSize);
-    apafSourceBuf[1] = (float *) CPLMalloc(sizeof(float)*nRasterXSize);
-    apafSourceBuf[2] = (float *) CPLMalloc(sizeof(float)*nRasterXSize);
-    
-    nCurLine = -1;
+    GDALGeneric3x3RasterBand* poBand =
+        new GDALGeneric3x3RasterBand(this, eDstDataType);
+    SetBand(1, poBand);
+
+    int bSrcHasNoData;
+    double dfSrcNoDataValue = GDALGetRasterNoDataValue(hSrcBand,
+                                                       &bSrcHasNoData);
+    psContext = GDALTerrainContextCreate(eAlg, psOptions,
+                                         bSrcHasNoData, dfSrcNoDataValue,
+                                         dfDstNoDataValue);
+
+    /* A block and the lines above and below it */
+    int nBlockYSize = poBand->nBlockYSize;
+    pafSourceBuf = (float *) CPLMalloc(sizeof(float)*nRasterXSize*(nBlockYSize+2));
+    pafOutputBuf = (float *) CPLMalloc(sizeof(float)*nRasterXSize*nBlockYSize);
 }
 
 GDALGeneric3x3Dataset::~GDALGeneric3x3Dataset()
 {
-    CPLFree(apafSourceBuf[0]);
-    CPLFree(apafSourceBuf[1]);
-    CPLFree(apafSourceBuf[2]);
+    GDALTerrainContextFree(psContext);
+    CPLFree(pafSourceBuf);
+    CPLFree(pafOutputBuf);
 }
 
 CPLErr GDALGeneric3x3Dataset::GetGeoTransform( double * padfGeoTransform )
@@ -1548,7 +1135,11 @@ GDALGeneric3x3RasterBand::GDALGeneric3x3RasterBand(GDALGeneric3x3Dataset *poDS,
     this->nBand = 1;
     eDataType = eDstDataType;
     nBlockXSize = poDS->GetRasterXSize();
-    nBlockYSize = 1;
+    /* Strips of up to 256 lines and about 4 MB, so that the lines of a */
+    /* block can be computed on several threads */
+    nBlockYSize = MAX(1, MIN(256, (4 * 1024 * 1024) / (nBlockXSize * 4)));
+    if (nBlockYSize > poDS->GetRasterYSize())
+        nBlockYSize = poDS->GetRasterYSize();
 }
 
 CPLErr GDALGeneric3x3RasterBand::IReadBlock( int nBlockXOff,
@@ -1556,133 +1147,69 @@ CPLErr GDALGeneric3x3RasterBand::IReadBlock( int nBlockXOff,
                                              void *pImage )
 {
     GDALGeneric3x3Dataset * poGDS = (GDALGeneric3x3Dataset *) poDS;
-    
-    if ( nBlockYOff == 0 || nBlockYOff == nRasterYSize - 1)
-    {
-        int j;
-        if (eDataType == GDT_Byte)
-        {
-            for(j=0;j<nBlockXSize;j++)
-                ((GByte*)pImage)[j] = (GByte) poGDS->dfDstNoDataValue;
-        }
-        else
-        {
-            for(j=0;j<nBlockXSize;j++)
-                ((float*)pImage)[j] = (float) poGDS->dfDstNoDataValue;
-        }
-            
-        return CE_None;
-    }
+    float fDstNoDataValue = (float) poGDS->dfDstNoDataValue;
+    int nYOff = nBlockYOff * nBlockYSize;
+    int nLines = MIN(nBlockYSize, nRasterYSize - nYOff);
+    int i, j;
+
+    if (poGDS->psContext == NULL)
+        return CE_Failure;
+
+/* -------------------------------------------------------------------- */
+/*      Compute the lines of the block that have the 3 source lines,    */
+/*      the first and last lines of the raster are nodata.              */
+/* -------------------------------------------------------------------- */
+    int iFirst = MAX(nYOff, 1);
+    int iLast = MIN(nYOff + nLines, nRasterYSize - 1);    /* excluded */
 
-    if ( poGDS->nCurLine != nBlockYOff )
+    if (iFirst < iLast)
     {
-        if (nBlockYOff != 1 &&
-            poGDS->nCurLine == nBlockYOff + 1)
-        {
-            float* pafTmp =  poGDS->apafSourceBuf[0];
-            poGDS->apafSourceBuf[0] = poGDS->apafSourceBuf[1];
-            poGDS->apafSourceBuf[1] = poGDS->apafSourceBuf[2];
-            poGDS->apafSourceBuf[2] = pafTmp;
-            
-            poGDS->nCurLine = nBlockYOff;
-            
-            CPLErr eErr = GDALRasterIO( poGDS->hSrcBand,
+        CPLErr eErr = GDALRasterIO( poGDS->hSrcBand,
                                     GF_Read,
-                                    0, nBlockYOff + 1, nBlockXSize, 1,
-                                    poGDS->apafSourceBuf[2],
-                                    nBlockXSize, 1,
+                                    0, iFirst - 1, nBlockXSize,
+                                    iLast - iFirst + 2,
+                                    poGDS->pafSourceBuf,
+                                    nBlockXSize, iLast - iFirst + 2,
                                     GDT_Float32,
                                     0, 0);
-                                    
-            if (eErr != CE_None)
-            {
-                memset(pImage, 0, nBlockXSize * sizeof(float));
-                return eErr;
-            }
-        }
-        else
+        if (eErr != CE_None)
         {
-            poGDS->nCurLine = nBlockYOff;
-            int i;
-            for(i=0;i<3;i++)
-            {
-                CPLErr eErr = GDALRasterIO( poGDS->hSrcBand,
-                                    GF_Read,
-                                    0, nBlockYOff + i - 1, nBlockXSize, 1,
-                                    poGDS->apafSourceBuf[i],
-                                    nBlockXSize, 1,
-                                    GDT_Float32,
-                                    0, 0);
-                if (eErr != CE_None)
-                {
-                    memset(pImage, 0, nBlockXSize * sizeof(float));
-                    return eErr;
-                }
-            }
+            memset(pImage, 0, nBlockXSize * nBlockYSize *
+                              (GDALGetDataTypeSize(eDataType) / 8));
+            return eErr;
         }
-    }
 
-    int j;
-    
-    if (eDataType == GDT_Byte)
-    {
-        ((GByte*)pImage)[0] = (GByte) poGDS->dfDstNoDataValue;
-        if (nBlockXSize > 1)
-            ((GByte*)pImage)[nBlockXSize - 1] = (GByte) poGDS->dfDstNoDataValue;
+        GDALTerrainContextProcess( poGDS->psContext, nBlockXSize,
+                                   iLast - iFirst, poGDS->pafSourceBuf,
+                                   poGDS->pafOutputBuf +
+                                        (size_t) (iFirst - nYOff) * nBlockXSize );
     }
-    else
-    {
-        ((float*)pImage)[0] = (float) poGDS->dfDstNoDataValue;
-        if (nBlockXSize > 1)
-            ((float*)pImage)[nBlockXSize - 1] = (float) poGDS->dfDstNoDataValue;
-    }
-    
-    int bSrcHasNoData;
-    double dfSrcNoDataValue = GDALGetRasterNoDataValue(poGDS->hSrcBand,
-                                                       &bSrcHasNoData);
 
-    for(j=1;j<nBlockXSize - 1;j++)
+    for(i=0;i<nLines;i++)
     {
-        float afWin[9];
-        afWin[0] = poGDS->apafSourceBuf[0][j-1];
-        afWin[1] = poGDS->apafSourceBuf[0][j];
-        afWin[2] = poGDS->apafSourceBuf[0][j+1];
-        afWin[3] = poGDS->apafSourceBuf[1][j-1];
-        afWin[4] = poGDS->apafSourceBuf[1][j];
-        afWin[5] = poGDS->apafSourceBuf[1][j+1];
-        afWin[6] = poGDS->apafSourceBuf[2][j-1];
-        afWin[7] = poGDS->apafSourceBuf[2][j];
-        afWin[8] = poGDS->apafSourceBuf[2][j+1];
-
-        // Check if afWin has null value
-        int bContainsNull = FALSE;
-        if (bSrcHasNoData)
+        float* pafLine = poGDS->pafOutputBuf + (size_t) i * nBlockXSize;
+
+        if (nYOff + i < iFirst || nYOff + i >= iLast)
         {
-            for ( int n = 0; n <= 8; n++)
+            for(j=0;j<nBlockXSize;j++)
+                pafLine[j] = fDstNoDataValue;
+        }
+
+        if (eDataType == GDT_Byte)
+        {
+            GByte* pabyImage = ((GByte*)pImage) + (size_t) i * nBlockXSize;
+            for(j=0;j<nBlockXSize;j++)
             {
-                if(afWin[n] == dfSrcNoDataValue)
-                {
-                    bContainsNull = TRUE;
-                    break;
-                }
+                if (pafLine[j] == fDstNoDataValue)
+                    pabyImage[j] = (GByte) poGDS->dfDstNoDataValue;
+                else
+                    pabyImage[j] = (GByte) (pafLine[j] + 0.5);
             }
         }
-
-        if (bContainsNull)
+        else
         {
-            // We have nulls so write nullValue and move on
-            if (eDataType == GDT_Byte)
-                ((GByte*)pImage)[j] = (GByte) poGDS->dfDstNoDataValue;
-            else
-                ((float*)pImage)[j] = (float) poGDS->dfDstNoDataValue;
-        } else {
-            // We have a valid 3x3 window.
-            if (eDataType == GDT_Byte)
-                ((GByte*)pImage)[j] = (GByte) (poGDS->pfnAlg(
-                        afWin, poGDS->dfDstNoDataValue, poGDS->pAlgData) + 0.5);
-            else
-                ((float*)pImage)[j] = (float) poGDS->pfnAlg(
-                        afWin, poGDS->dfDstNoDataValue, poGDS->pAlgData);
+            memcpy(((float*)pImage) + (size_t) i * nBlockXSize, pafLine,
+                   nBlockXSize * sizeof(float));
         }
     }
     
@@ -1979,27 +1506,29 @@ int main( int argc, char ** argv )
 
     double dfDstNoDataValue = 0;
     int bDstHasNoData = FALSE;
-    void* pData = NULL;
-    GDALGeneric3x3ProcessingAlg pfnAlg = NULL;
+    GDALTerrainAlgorithm eTerrainAlg = GTA_Hillshade;
+    GDALTerrainOptions sTerrainOptions;
+
+    memcpy(sTerrainOptions.adfGeoTransform, adfGeoTransform,
+           sizeof(adfGeoTransform));
+    sTerrainOptions.dfZFactor = z;
+    sTerrainOptions.dfScale = scale;
+    sTerrainOptions.dfAltitude = alt;
+    sTerrainOptions.dfAzimuth = az;
+    sTerrainOptions.bSlopeInPercent = (slopeFormat != 1);
+    sTerrainOptions.bAngleAsAzimuth = bAngleAsAzimuth;
 
     if (eUtilityMode == HILL_SHADE)
     {
         dfDstNoDataValue = 0;
         bDstHasNoData = TRUE;
-        pData = GDALCreateHillshadeData   (adfGeoTransform,
-                                           z,
-                                           scale,
-                                           alt,
-                                           az);
-        pfnAlg = GDALHillshadeAlg;
+        eTerrainAlg = GTA_Hillshade;
     }
     else if (eUtilityMode == SLOPE)
     {
         dfDstNoDataValue = -9999;
         bDstHasNoData = TRUE;
-
-        pData = GDALCreateSlopeData(adfGeoTransform, scale, slopeFormat);
-        pfnAlg = GDALSlopeAlg;
+        eTerrainAlg = GTA_Slope;
     }
 
     else if (eUtilityMode == ASPECT)
@@ -2010,26 +1539,25 @@ int main( int argc, char ** argv )
             bDstHasNoData = TRUE;
         }
 
-        pData = GDALCreateAspectData(bAngleAsAzimuth);
-        pfnAlg = GDALAspectAlg;
+        eTerrainAlg = GTA_Aspect;
     }
     else if (eUtilityMode == TRI)
     {
         dfDstNoDataValue = -9999;
         bDstHasNoData = TRUE;
-        pfnAlg = GDALTRIAlg;
+        eTerrainAlg = GTA_TRI;
     }
     else if (eUtilityMode == TPI)
     {
         dfDstNoDataValue = -9999;
         bDstHasNoData = TRUE;
-        pfnAlg = GDALTPIAlg;
+        eTerrainAlg = GTA_TPI;
     }
     else if (eUtilityMode == ROUGHNESS)
     {
         dfDstNoDataValue = -9999;
         bDstHasNoData = TRUE;
-        pfnAlg = GDALRoughnessAlg;
+        eTerrainAlg = GTA_Roughness;
     }
     
     GDALDataType eDstDataType = (eUtilityMode == HILL_SHADE ||
@@ -2047,8 +1575,6 @@ int main( int argc, char ** argv )
                                        eColorSelectionMode,
                                        bAddAlpha);
             GDALClose(hSrcDataset);
-        
-            CPLFree(pData);
 
             GDALDestroyDriverManager();
             CSLDestroy( argv );
@@ -2083,8 +1609,8 @@ int main( int argc, char ** argv )
                                           eDstDataType,
                                           bDstHasNoData,
                                           dfDstNoDataValue,
-                                          pfnAlg,
-                                          pData);
+                                          eTerrainAlg,
+                                          &sTerrainOptions);
 
         GDALDatasetH hOutDS = GDALCreateCopy(
                                  hDriver, pszDstFilename, hIntermediateDataset, 
@@ -2095,8 +1621,6 @@ int main( int argc, char ** argv )
             GDALClose( hOutDS );
         GDALClose(hIntermediateDataset);
         GDALClose(hSrcDataset);
-        
-        CPLFree(pData);
 
         GDALDestroyDriverManager();
         CSLDestroy( argv );
@@ -2149,15 +1673,14 @@ int main( int argc, char ** argv )
         if (bDstHasNoData)
             GDALSetRasterNoDataValue(hDstBand, dfDstNoDataValue);
         
-        GDALGeneric3x3Processing(hSrcBand, hDstBand,
-                                 pfnAlg, pData,
-                                 pfnProgress, NULL);
+        GDALTerrainProcess(hSrcBand, hDstBand,
+                           eTerrainAlg, &sTerrainOptions,
+                           pfnProgress, NULL);
                                     
     }
 
     GDALClose(hSrcDataset);
     GDALClose(hDstDataset);
-    CPLFree(pData);
 
     GDALDestroyDriverManager();
     CSLDestroy( argv );
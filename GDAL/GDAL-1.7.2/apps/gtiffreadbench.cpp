@@ -0,0 +1,273 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Utilities
+ * Purpose:  Benchmark of large window reads on compressed GeoTIFF files
+ *           with GDAL_NUM_THREADS.
+ *
+ ******************************************************************************
+ * Copyright (c) 2010, GDAL contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+
+#include "gdal_priv.h"
+#include "cpl_conv.h"
+#include "cpl_string.h"
+
+CPL_CVSID("$Id$");
+
+/************************************************************************/
+/*                               Usage()                                */
+/************************************************************************/
+
+static void Usage()
+{
+    printf( "gtiffreadbench [-size <n>] [-win <n>] [-threads <n1,n2,...>]\n"
+            "               [-i <iterations>] [-dir <work_dir>]\n"
+            "\n"
+            "Writes a synthetic n x n, 3 band tiled mosaic as a DEFLATE and\n"
+            "as a JPEG compressed GeoTIFF, then reads win x win windows from\n"
+            "them with a cold block cache, once for each GDAL_NUM_THREADS\n"
+            "value.  Reports the time per window, the speedup relative to\n"
+            "the first GDAL_NUM_THREADS value, and whether the pixels read\n"
+            "are the same.\n" );
+    exit( 1 );
+}
+
+/************************************************************************/
+/*                            WriteMosaic()                             */
+/*                                                                      */
+/*      Pixel interleaved imagery made of 512x512 patches of smooth     */
+/*      gradients with some noise, written one line at a time.          */
+/************************************************************************/
+
+static int WriteMosaic( const char *pszFilename, int nSize,
+                        const char *pszCompress )
+{
+    GDALDriver *poDriver = (GDALDriver *) GDALGetDriverByName( "GTiff" );
+    char **papszOptions = NULL;
+
+    papszOptions = CSLSetNameValue( papszOptions, "TILED", "YES" );
+    papszOptions = CSLSetNameValue( papszOptions, "COMPRESS", pszCompress );
+    if( EQUAL(pszCompress, "JPEG") )
+        papszOptions = CSLSetNameValue( papszOptions, "PHOTOMETRIC", "YCBCR" );
+
+    GDALDataset *poDS = poDriver->Create( pszFilename, nSize, nSize, 3,
+                                          GDT_Byte, papszOptions );
+    CSLDestroy( papszOptions );
+    if( poDS == NULL )
+        return FALSE;
+
+    GByte *pabyLine = (GByte *) CPLMalloc( nSize * 3 );
+    GUInt32 nSeed = 1;
+    CPLErr eErr = CE_None;
+    int iX, iY;
+
+    for( iY = 0; iY < nSize && eErr == CE_None; iY++ )
+    {
+        for( iX = 0; iX < nSize; iX++ )
+        {
+            int nPatch = (iY / 512) * 7 + (iX / 512) * 3;
+            int nBase = ((iX % 512) * (nPatch % 5 + 1)
+                         + (iY % 512) * (nPatch % 3 + 1)) / 8;
+
+            nSeed = nSeed * 1103515245 + 12345;
+
+            pabyLine[iX*3+0] = (GByte) (nBase + ((nSeed >> 16) & 7));
+            pabyLine[iX*3+1] = (GByte) (nBase + nPatch * 17);
+            pabyLine[iX*3+2] = (GByte) (255 - nBase + ((nSeed >> 20) & 3));
+        }
+
+        eErr = poDS->RasterIO( GF_Write, 0, iY, nSize, 1, pabyLine,
+                               nSize, 1, GDT_Byte, 3, NULL, 3, nSize * 3, 1 );
+    }
+
+    CPLFree( pabyLine );
+    GDALClose( (GDALDatasetH) poDS );
+
+    return eErr == CE_None;
+}
+
+/************************************************************************/
+/*                            ReadWindows()                             */
+/*                                                                      */
+/*      Read all the win x win windows of the file, into the same       */
+/*      buffer.  Returns the time per window, or a negative value on    */
+/*      failure.  pnChecksum gets a checksum of all the pixels read.    */
+/************************************************************************/
+
+static double ReadWindows( const char *pszFilename, int nWin,
+                           GByte *pabyBuffer, GUInt32 *pnChecksum )
+{
+    double dfStart = CPLGetWallTime();
+    GDALDataset *poDS = (GDALDataset *) GDALOpen( pszFilename, GA_ReadOnly );
+    int nWindows = 0, iX, iY;
+    CPLErr eErr = CE_None;
+
+    if( poDS == NULL )
+        return -1.0;
+
+    *pnChecksum = 0;
+
+    for( iY = 0; iY + nWin <= poDS->GetRasterYSize(); iY += nWin )
+    {
+        for( iX = 0; iX + nWin <= poDS->GetRasterXSize(); iX += nWin )
+        {
+            eErr = poDS->RasterIO( GF_Read, iX, iY, nWin, nWin, pabyBuffer,
+                                   nWin, nWin, GDT_Byte, 3, NULL,
+                                   3, nWin * 3, 1 );
+            if( eErr != CE_None )
+                break;
+
+            for( int i = 0; i < nWin * nWin * 3; i++ )
+                *pnChecksum = *pnChecksum * 31 + pabyBuffer[i];
+            nWindows++;
+        }
+    }
+
+    GDALClose( (GDALDatasetH) poDS );
+
+    if( eErr != CE_None || nWindows == 0 )
+        return -1.0;
+
+    return (CPLGetWallTime() - dfStart) / nWindows;
+}
+
+/************************************************************************/
+/*                                main()                                */
+/************************************************************************/
+
+int main( int argc, char ** argv )
+
+{
+    int nSize = 8192, nWin = 2048, nIterations = 3;
+    const char *pszThreads = "1,2,4,ALL_CPUS";
+    const char *pszDir = "gtiffreadbench.tmp";
+    int i;
+
+    GDALAllRegister();
+
+    argc = GDALGeneralCmdLineProcessor( argc, &argv, 0 );
+    if( argc < 1 )
+        exit( -argc );
+
+    for( i = 1; i < argc; i++ )
+    {
+        if( EQUAL(argv[i],"-size") && i < argc-1 )
+            nSize = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-win") && i < argc-1 )
+            nWin = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-threads") && i < argc-1 )
+            pszThreads = argv[++i];
+        else if( EQUAL(argv[i],"-i") && i < argc-1 )
+            nIterations = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-dir") && i < argc-1 )
+            pszDir = argv[++i];
+        else
+            Usage();
+    }
+
+    char **papszThreads = CSLTokenizeStringComplex( pszThreads, ",",
+                                                    FALSE, FALSE );
+
+    if( nWin < 1 || nSize < nWin || nIterations < 1
+        || CSLCount( papszThreads ) == 0 )
+        Usage();
+
+    VSIMkdir( pszDir, 0755 );
+
+    /* Room for the blocks of a window, so they are decoded only once */
+    GDALSetCacheMax( MAX( GDALGetCacheMax(), 4 * nWin * nWin * 3 ) );
+
+    GByte *pabyBuffer = (GByte *) VSIMalloc3( nWin, nWin, 3 );
+    if( pabyBuffer == NULL )
+        exit( 1 );
+
+    printf( "%dx%d 3 band Byte tiled mosaic, %dx%d windows, "
+            "best of %d iterations\n", nSize, nSize, nWin, nWin, nIterations );
+    printf( "%-9s %-16s %10s %8s  %s\n", "COMPRESS", "GDAL_NUM_THREADS",
+            "ms/window", "speedup", "pixels" );
+
+    const char *apszCompress[2] = { "DEFLATE", "JPEG" };
+    int iCompress, iThreads, iIter;
+
+    for( iCompress = 0; iCompress < 2; iCompress++ )
+    {
+        CPLString osFilename;
+        double dfReference = 0.0;
+        GUInt32 nReferenceChecksum = 0;
+
+        osFilename.Printf( "%s/%s.tif", pszDir, apszCompress[iCompress] );
+        if( !WriteMosaic( osFilename, nSize, apszCompress[iCompress] ) )
+        {
+            fprintf( stderr, "Writing %s failed.\n", osFilename.c_str() );
+            exit( 1 );
+        }
+
+        for( iThreads = 0; papszThreads[iThreads] != NULL; iThreads++ )
+        {
+            double dfBest = 0.0;
+            GUInt32 nChecksum = 0;
+
+            CPLSetConfigOption( "GDAL_NUM_THREADS", papszThreads[iThreads] );
+
+            for( iIter = 0; iIter < nIterations; iIter++ )
+            {
+                double dfTime = ReadWindows( osFilename, nWin, pabyBuffer,
+                                             &nChecksum );
+
+                if( dfTime < 0 )
+                {
+                    fprintf( stderr, "Reading %s failed.\n",
+                             osFilename.c_str() );
+                    exit( 1 );
+                }
+                if( iIter == 0 || dfTime < dfBest )
+                    dfBest = dfTime;
+            }
+
+            const char *pszPixels = "reference";
+
+            if( iThreads == 0 )
+            {
+                dfReference = dfBest;
+                nReferenceChecksum = nChecksum;
+            }
+            else if( nChecksum == nReferenceChecksum )
+                pszPixels = "identical";
+            else
+                pszPixels = "DIFFERENT";
+
+            printf( "%-9s %-16s %10.1f %8.2f  %s\n",
+                    apszCompress[iCompress], papszThreads[iThreads],
+                    1000.0 * dfBest, dfReference / dfBest, pszPixels );
+        }
+
+        CPLSetConfigOption( "GDAL_NUM_THREADS", NULL );
+    }
+
+    VSIFree( pabyBuffer );
+    CSLDestroy( papszThreads );
+    CSLDestroy( argv );
+    GDALDestroyDriverManager();
+
+    return 0;
+}
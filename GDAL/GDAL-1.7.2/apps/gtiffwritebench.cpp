@@ -0,0 +1,263 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Utilities
+ * Purpose:  Benchmark of compressed GeoTIFF writing with NUM_THREADS.
+ *
+ ******************************************************************************
+ * Copyright (c) 2010, GDAL contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+
+#include "gdal_priv.h"
+#include "cpl_conv.h"
+#include "cpl_string.h"
+
+CPL_CVSID("$Id$");
+
+/************************************************************************/
+/*                               Usage()                                */
+/************************************************************************/
+
+static void Usage()
+{
+    printf( "gtiffwritebench [-size <n>] [-threads <n1,n2,...>] [-i <iterations>]\n"
+            "                [-strips] [-dir <work_dir>]\n"
+            "\n"
+            "Writes a synthetic n x n, 3 band mosaic as a DEFLATE and as a\n"
+            "LZW compressed GeoTIFF (tiled, or stripped with -strips), once\n"
+            "for each NUM_THREADS value, and reports the write time and\n"
+            "whether the file is identical to the one written with the\n"
+            "first NUM_THREADS value.\n" );
+    exit( 1 );
+}
+
+/************************************************************************/
+/*                            FillMosaic()                              */
+/*                                                                      */
+/*      Pixel interleaved imagery made of 512x512 patches of smooth     */
+/*      gradients with some noise, so that it compresses somewhat       */
+/*      like real imagery.                                              */
+/************************************************************************/
+
+static void FillMosaic( GByte *pabyBuffer, int nSize )
+{
+    GUInt32 nSeed = 1;
+    int iX, iY;
+
+    for( iY = 0; iY < nSize; iY++ )
+    {
+        GByte *pabyLine = pabyBuffer + (size_t) iY * nSize * 3;
+
+        for( iX = 0; iX < nSize; iX++ )
+        {
+            int nPatch = (iY / 512) * 7 + (iX / 512) * 3;
+            int nBase = ((iX % 512) * (nPatch % 5 + 1)
+                         + (iY % 512) * (nPatch % 3 + 1)) / 8;
+
+            nSeed = nSeed * 1103515245 + 12345;
+
+            pabyLine[iX*3+0] = (GByte) (nBase + ((nSeed >> 16) & 7));
+            pabyLine[iX*3+1] = (GByte) (nBase + nPatch * 17);
+            pabyLine[iX*3+2] = (GByte) (255 - nBase + ((nSeed >> 20) & 3));
+        }
+    }
+}
+
+/************************************************************************/
+/*                            WriteGTiff()                              */
+/*                                                                      */
+/*      Returns the time to create, write and close the file, or a      */
+/*      negative value on failure.                                      */
+/************************************************************************/
+
+static double WriteGTiff( const char *pszFilename, int nSize,
+                          GByte *pabyBuffer, char **papszOptions )
+{
+    GDALDriver *poDriver = (GDALDriver *) GDALGetDriverByName( "GTiff" );
+    double dfStart = CPLGetWallTime();
+
+    GDALDataset *poDS = poDriver->Create( pszFilename, nSize, nSize, 3,
+                                          GDT_Byte, papszOptions );
+    if( poDS == NULL )
+        return -1.0;
+
+    CPLErr eErr = poDS->RasterIO( GF_Write, 0, 0, nSize, nSize,
+                                  pabyBuffer, nSize, nSize, GDT_Byte,
+                                  3, NULL, 3, nSize * 3, 1 );
+    GDALClose( (GDALDatasetH) poDS );
+
+    if( eErr != CE_None )
+        return -1.0;
+
+    return CPLGetWallTime() - dfStart;
+}
+
+/************************************************************************/
+/*                           SameContent()                              */
+/************************************************************************/
+
+static int SameContent( const char *pszFile1, const char *pszFile2 )
+{
+    FILE *fp1 = VSIFOpenL( pszFile1, "rb" );
+    FILE *fp2 = VSIFOpenL( pszFile2, "rb" );
+    int bSame = (fp1 != NULL && fp2 != NULL);
+    GByte abyBuf1[65536], abyBuf2[65536];
+
+    while( bSame )
+    {
+        size_t n1 = VSIFReadL( abyBuf1, 1, sizeof(abyBuf1), fp1 );
+        size_t n2 = VSIFReadL( abyBuf2, 1, sizeof(abyBuf2), fp2 );
+
+        if( n1 != n2 || memcmp( abyBuf1, abyBuf2, n1 ) != 0 )
+            bSame = FALSE;
+        else if( n1 == 0 )
+            break;
+    }
+
+    if( fp1 != NULL )
+        VSIFCloseL( fp1 );
+    if( fp2 != NULL )
+        VSIFCloseL( fp2 );
+
+    return bSame;
+}
+
+/************************************************************************/
+/*                                main()                                */
+/************************************************************************/
+
+int main( int argc, char ** argv )
+
+{
+    int nSize = 4096, nIterations = 3, bStrips = FALSE;
+    const char *pszThreads = "1,2,4,ALL_CPUS";
+    const char *pszDir = "gtiffwritebench.tmp";
+    int i;
+
+    GDALAllRegister();
+
+    argc = GDALGeneralCmdLineProcessor( argc, &argv, 0 );
+    if( argc < 1 )
+        exit( -argc );
+
+    for( i = 1; i < argc; i++ )
+    {
+        if( EQUAL(argv[i],"-size") && i < argc-1 )
+            nSize = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-threads") && i < argc-1 )
+            pszThreads = argv[++i];
+        else if( EQUAL(argv[i],"-i") && i < argc-1 )
+            nIterations = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-strips") )
+            bStrips = TRUE;
+        else if( EQUAL(argv[i],"-dir") && i < argc-1 )
+            pszDir = argv[++i];
+        else
+            Usage();
+    }
+
+    char **papszThreads = CSLTokenizeStringComplex( pszThreads, ",",
+                                                    FALSE, FALSE );
+
+    if( nSize < 1 || nIterations < 1 || CSLCount( papszThreads ) == 0 )
+        Usage();
+
+    VSIMkdir( pszDir, 0755 );
+
+    GByte *pabyBuffer = (GByte *) VSIMalloc3( nSize, nSize, 3 );
+    if( pabyBuffer == NULL )
+        exit( 1 );
+
+    FillMosaic( pabyBuffer, nSize );
+
+    printf( "%dx%d 3 band Byte mosaic, %s, best of %d iterations\n",
+            nSize, nSize, bStrips ? "stripped" : "tiled", nIterations );
+    printf( "%-9s %-12s %10s %10s %10s  %s\n", "COMPRESS", "NUM_THREADS",
+            "seconds", "MB/s", "size", "output" );
+
+    const char *apszCompress[2] = { "DEFLATE", "LZW" };
+    int iCompress, iThreads, iIter;
+
+    for( iCompress = 0; iCompress < 2; iCompress++ )
+    {
+        CPLString osReference;
+
+        for( iThreads = 0; papszThreads[iThreads] != NULL; iThreads++ )
+        {
+            CPLString osFilename;
+            char **papszOptions = NULL;
+            double dfBest = 0.0;
+
+            osFilename.Printf( "%s/%s_%s.tif", pszDir,
+                               apszCompress[iCompress],
+                               papszThreads[iThreads] );
+
+            papszOptions = CSLSetNameValue( papszOptions, "COMPRESS",
+                                            apszCompress[iCompress] );
+            papszOptions = CSLSetNameValue( papszOptions, "NUM_THREADS",
+                                            papszThreads[iThreads] );
+            if( !bStrips )
+                papszOptions = CSLSetNameValue( papszOptions, "TILED", "YES" );
+
+            for( iIter = 0; iIter < nIterations; iIter++ )
+            {
+                double dfTime = WriteGTiff( osFilename, nSize, pabyBuffer,
+                                            papszOptions );
+
+                if( dfTime < 0 )
+                {
+                    fprintf( stderr, "Writing %s failed.\n",
+                             osFilename.c_str() );
+                    exit( 1 );
+                }
+                if( iIter == 0 || dfTime < dfBest )
+                    dfBest = dfTime;
+            }
+            CSLDestroy( papszOptions );
+
+            VSIStatBufL sStat;
+            const char *pszOutput = "reference";
+
+            if( VSIStatL( osFilename, &sStat ) != 0 )
+                sStat.st_size = 0;
+
+            if( iThreads == 0 )
+                osReference = osFilename;
+            else if( SameContent( osReference, osFilename ) )
+                pszOutput = "identical";
+            else
+                pszOutput = "DIFFERENT";
+
+            printf( "%-9s %-12s %10.3f %10.1f %10ld  %s\n",
+                    apszCompress[iCompress], papszThreads[iThreads], dfBest,
+                    nSize * (double) nSize * 3 / (dfBest * 1024 * 1024),
+                    (long) sStat.st_size, pszOutput );
+        }
+    }
+
+    VSIFree( pabyBuffer );
+    CSLDestroy( papszThreads );
+    CSLDestroy( argv );
+    GDALDestroyDriverManager();
+
+    return 0;
+}
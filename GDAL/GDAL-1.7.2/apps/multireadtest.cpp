@@ -36,6 +36,7 @@ CPL_CVSID("$Id$");
 
 static int nThreadCount = 4, nIterations = 1, bLockOnOpen = TRUE;
 static int nOpenIterations = 1;
+static int bScaling = FALSE;
 static volatile int nPendingThreads = 0;
 static const char *pszFilename = NULL;
 static int nChecksum = 0;
@@ -50,12 +51,41 @@ static void WorkerFunc( void * );
 
 static void Usage()
 {
-    printf( "multireadtest [-nlo] [-t <thread#>]\n"
+    printf( "multireadtest [-nlo] [-t <thread#>] [-scaling]\n"
             "              [-i <iterations>] [-oi <iterations>\n"
             "              filename\n" );
     exit( 1 );
 }
 
+/************************************************************************/
+/*                             RunThreads()                             */
+/*                                                                      */
+/*      Run the workers on nThreads threads, and return the elapsed     */
+/*      wall clock time.                                                */
+/************************************************************************/
+
+static double RunThreads( int nThreads )
+{
+    int iThread;
+    double dfStart = CPLGetWallTime();
+
+    nPendingThreads = nThreads;
+
+    for( iThread = 0; iThread < nThreads; iThread++ )
+    {
+        if( CPLCreateThread( WorkerFunc, NULL ) == -1 )
+        {
+            printf( "CPLCreateThread() failed.\n" );
+            exit( 1 );
+        }
+    }
+
+    while( nPendingThreads > 0 )
+        CPLSleep( 0.01 );
+
+    return CPLGetWallTime() - dfStart;
+}
+
 
 /************************************************************************/
 /*                                main()                                */
@@ -83,6 +113,8 @@ int main( int argc, char ** argv )
             nThreadCount = atoi(argv[++iArg]);
         else if( EQUAL(argv[iArg],"-nlo") )
             bLockOnOpen = FALSE;
+        else if( EQUAL(argv[iArg],"-scaling") )
+            bScaling = TRUE;
         else if( pszFilename == NULL )
             pszFilename = argv[iArg];
         else
@@ -106,12 +138,16 @@ int main( int argc, char ** argv )
 /*      Get the checksum of band1.                                      */
 /* -------------------------------------------------------------------- */
     GDALDatasetH hDS;
+    double dfPixels;
 
     GDALAllRegister();
     hDS = GDALOpen( pszFilename, GA_ReadOnly );
     if( hDS == NULL )
         exit( 1 );
 
+    dfPixels = GDALGetRasterXSize( hDS ) * (double) GDALGetRasterYSize( hDS )
+        * nIterations * nOpenIterations;
+
     nChecksum = GDALChecksumImage( GDALGetRasterBand( hDS, 1 ), 
                                    0, 0, 
                                    GDALGetRasterXSize( hDS ), 
@@ -123,28 +159,28 @@ int main( int argc, char ** argv )
             nChecksum, nThreadCount, pszFilename, nIterations );
 
 /* -------------------------------------------------------------------- */
-/*      Fire off worker threads.                                        */
+/*      Fire off worker threads.  In scaling mode we run with 1, 2,     */
+/*      4 ... up to the requested number of threads, and report the     */
+/*      aggregate read throughput of each run.                          */
 /* -------------------------------------------------------------------- */
-    int iThread;
+    int nThreads = (bScaling) ? 1 : nThreadCount;
 
     pGlobalMutex = CPLCreateMutex();
     CPLReleaseMutex( pGlobalMutex );
 
-    nPendingThreads = nThreadCount;
-
-    for( iThread = 0; iThread < nThreadCount; iThread++ )
+    while( TRUE )
     {
-        if( CPLCreateThread( WorkerFunc, NULL ) == -1 )
-        {
-            printf( "CPLCreateThread() failed.\n" );
-            exit( 1 );
-        }
-    }
+        double dfElapsed = RunThreads( nThreads );
 
-    while( nPendingThreads > 0 )
-        CPLSleep( 0.5 );
+        printf( "%d threads: %.3f seconds, %.2f Mpixels/s\n", 
+                nThreads, dfElapsed, 
+                dfPixels * nThreads / 1000000.0 / MAX(dfElapsed,0.001) );
 
-    CPLReleaseMutex( pGlobalMutex );
+        if( nThreads >= nThreadCount )
+            break;
+
+        nThreads = MIN(nThreads * 2, nThreadCount);
+    }
 
     printf( "All threads complete.\n" );
     
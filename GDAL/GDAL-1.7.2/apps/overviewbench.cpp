@@ -0,0 +1,293 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Utilities
+ * Purpose:  Benchmark of the 2x2 AVERAGE overview kernels, level by level,
+ *           with and without GDAL_OVERVIEW_SIMD.
+ *
+ ******************************************************************************
+ * Copyright (c) 2010, GDAL contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+
+#include "gdal_priv.h"
+#include "cpl_conv.h"
+#include "cpl_string.h"
+#include "gdal_alg.h"
+
+CPL_CVSID("$Id$");
+
+/************************************************************************/
+/*                               Usage()                                */
+/************************************************************************/
+
+static void Usage()
+{
+    printf( "overviewbench [-size <n>] [-levels <n>] [-i <iterations>]\n"
+            "              [-dir <work_dir>]\n"
+            "\n"
+            "Writes a synthetic n x n tiled GeoTIFF for each of the Byte,\n"
+            "Int16 and Float32 data types, then computes its 2, 4, 8, ...\n"
+            "AVERAGE overviews one level at a time, each from the level\n"
+            "above it, with GDAL_OVERVIEW_SIMD=NO and then YES.  Reports\n"
+            "the source megapixels per second of each level, the speedup,\n"
+            "and whether both settings give the same overview pixels.\n" );
+    exit( 1 );
+}
+
+/************************************************************************/
+/*                            WriteImage()                              */
+/*                                                                      */
+/*      Smooth gradients in 512x512 patches with some noise, scaled     */
+/*      to cover most of the range of the data type, and with an        */
+/*      overview structure for nLevels power of two levels.             */
+/************************************************************************/
+
+static GDALDataset *WriteImage( const char *pszFilename, int nSize,
+                                GDALDataType eType, int nLevels )
+{
+    GDALDriver *poDriver = (GDALDriver *) GDALGetDriverByName( "GTiff" );
+    char **papszOptions = NULL;
+
+    papszOptions = CSLSetNameValue( papszOptions, "TILED", "YES" );
+
+    GDALDataset *poDS = poDriver->Create( pszFilename, nSize, nSize, 1,
+                                          eType, papszOptions );
+    CSLDestroy( papszOptions );
+    if( poDS == NULL )
+        return NULL;
+
+    double dfScale = (eType == GDT_Byte) ? 1.0 : 200.0;
+    double dfOffset = (eType == GDT_Byte) ? 0.0 : -25000.0;
+    double *padfLine = (double *) CPLMalloc( sizeof(double) * nSize );
+    GUInt32 nSeed = 1;
+    CPLErr eErr = CE_None;
+    int i, iX, iY;
+
+    for( iY = 0; iY < nSize && eErr == CE_None; iY++ )
+    {
+        for( iX = 0; iX < nSize; iX++ )
+        {
+            int nPatch = (iY / 512) * 7 + (iX / 512) * 3;
+            int nBase = ((iX % 512) * (nPatch % 5 + 1)
+                         + (iY % 512) * (nPatch % 3 + 1)) / 8;
+
+            nSeed = nSeed * 1103515245 + 12345;
+
+            padfLine[iX] = (nBase % 248 + ((nSeed >> 16) & 7)) * dfScale
+                + dfOffset;
+            if( eType == GDT_Float32 )
+                padfLine[iX] += ((nSeed >> 8) & 255) / 256.0;
+        }
+
+        eErr = poDS->GetRasterBand(1)->RasterIO( GF_Write, 0, iY, nSize, 1,
+                                                 padfLine, nSize, 1,
+                                                 GDT_Float64, 0, 0 );
+    }
+
+    CPLFree( padfLine );
+
+/* -------------------------------------------------------------------- */
+/*      Create the overview levels with cheap content, they are all     */
+/*      recomputed by the benchmark.                                    */
+/* -------------------------------------------------------------------- */
+    int anLevels[32];
+
+    for( i = 0; i < nLevels; i++ )
+        anLevels[i] = 2 << i;
+
+    if( eErr == CE_None )
+        eErr = poDS->BuildOverviews( "NEAREST", nLevels, anLevels, 0, NULL,
+                                     GDALDummyProgress, NULL );
+
+    if( eErr != CE_None )
+    {
+        GDALClose( (GDALDatasetH) poDS );
+        return NULL;
+    }
+
+    return poDS;
+}
+
+/************************************************************************/
+/*                           ComputeLevel()                             */
+/*                                                                      */
+/*      Returns the best time of nIterations recomputations of the      */
+/*      overview from its source band, or a negative value on failure.  */
+/************************************************************************/
+
+static double ComputeLevel( GDALRasterBand *poSrcBand,
+                            GDALRasterBand *poOvrBand, int nIterations )
+{
+    double dfBest = 0.0;
+    int iIter;
+
+    for( iIter = 0; iIter < nIterations; iIter++ )
+    {
+        double dfStart = CPLGetWallTime();
+        GDALRasterBandH hOvrBand = (GDALRasterBandH) poOvrBand;
+
+        if( GDALRegenerateOverviews( (GDALRasterBandH) poSrcBand,
+                                     1, &hOvrBand, "AVERAGE",
+                                     GDALDummyProgress, NULL ) != CE_None )
+            return -1.0;
+
+        double dfTime = CPLGetWallTime() - dfStart;
+
+        if( iIter == 0 || dfTime < dfBest )
+            dfBest = dfTime;
+    }
+
+    return dfBest;
+}
+
+/************************************************************************/
+/*                                main()                                */
+/************************************************************************/
+
+int main( int argc, char ** argv )
+
+{
+    int nSize = 8192, nLevels = 4, nIterations = 3;
+    const char *pszDir = "overviewbench.tmp";
+    int i;
+
+    GDALAllRegister();
+
+    argc = GDALGeneralCmdLineProcessor( argc, &argv, 0 );
+    if( argc < 1 )
+        exit( -argc );
+
+    for( i = 1; i < argc; i++ )
+    {
+        if( EQUAL(argv[i],"-size") && i < argc-1 )
+            nSize = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-levels") && i < argc-1 )
+            nLevels = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-i") && i < argc-1 )
+            nIterations = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-dir") && i < argc-1 )
+            pszDir = argv[++i];
+        else
+            Usage();
+    }
+
+    if( nLevels < 1 || nLevels > 30 || (nSize >> nLevels) < 1
+        || nIterations < 1 )
+        Usage();
+
+    VSIMkdir( pszDir, 0755 );
+
+    /* Room for a Float32 image and its overviews, to time no disk I/O */
+    double dfCacheMax = nSize * (double) nSize * 4 * 4 / 3 + 16 * 1024 * 1024;
+
+    GDALSetCacheMax( (int) MIN( dfCacheMax, 2000.0 * 1024 * 1024 ) );
+
+    printf( "%dx%d tiled image, AVERAGE, best of %d iterations\n",
+            nSize, nSize, nIterations );
+    printf( "%-8s %6s %10s %12s %12s %8s  %s\n", "type", "level", "size",
+            "NO MPix/s", "YES MPix/s", "speedup", "pixels" );
+
+    const GDALDataType aeTypes[3] = { GDT_Byte, GDT_Int16, GDT_Float32 };
+    int iType, iLevel;
+
+    for( iType = 0; iType < 3; iType++ )
+    {
+        CPLString osFilename;
+
+        osFilename.Printf( "%s/%s.tif", pszDir,
+                           GDALGetDataTypeName( aeTypes[iType] ) );
+
+        GDALDataset *poDS = WriteImage( osFilename, nSize, aeTypes[iType],
+                                        nLevels );
+        if( poDS == NULL )
+        {
+            fprintf( stderr, "Writing %s failed.\n", osFilename.c_str() );
+            exit( 1 );
+        }
+
+        GDALRasterBand *poBand = poDS->GetRasterBand( 1 );
+
+        for( iLevel = 0; iLevel < nLevels; iLevel++ )
+        {
+            GDALRasterBand *poSrcBand =
+                iLevel == 0 ? poBand : poBand->GetOverview( iLevel - 1 );
+            GDALRasterBand *poOvrBand = poBand->GetOverview( iLevel );
+            double adfTime[2];
+            int anChecksum[2];
+            int iSIMD;
+
+            if( poSrcBand == NULL || poOvrBand == NULL )
+            {
+                fprintf( stderr, "Missing overview in %s.\n",
+                         osFilename.c_str() );
+                exit( 1 );
+            }
+
+/* -------------------------------------------------------------------- */
+/*      Both settings rewrite the same level, so the next level is      */
+/*      computed from the same pixels as long as they agree.            */
+/* -------------------------------------------------------------------- */
+            for( iSIMD = 0; iSIMD < 2; iSIMD++ )
+            {
+                CPLSetConfigOption( "GDAL_OVERVIEW_SIMD",
+                                    iSIMD ? "YES" : "NO" );
+
+                adfTime[iSIMD] = ComputeLevel( poSrcBand, poOvrBand,
+                                               nIterations );
+                if( adfTime[iSIMD] < 0 )
+                {
+                    fprintf( stderr, "Computing overviews of %s failed.\n",
+                             osFilename.c_str() );
+                    exit( 1 );
+                }
+
+                anChecksum[iSIMD] =
+                    GDALChecksumImage( (GDALRasterBandH) poOvrBand, 0, 0,
+                                       poOvrBand->GetXSize(),
+                                       poOvrBand->GetYSize() );
+            }
+
+            CPLSetConfigOption( "GDAL_OVERVIEW_SIMD", NULL );
+
+            double dfMPix = poSrcBand->GetXSize()
+                * (double) poSrcBand->GetYSize() / 1000000.0;
+            CPLString osSize;
+
+            osSize.Printf( "%dx%d", poOvrBand->GetXSize(),
+                           poOvrBand->GetYSize() );
+
+            printf( "%-8s %6d %10s %12.1f %12.1f %8.2f  %s\n",
+                    GDALGetDataTypeName( aeTypes[iType] ), 2 << iLevel,
+                    osSize.c_str(), dfMPix / adfTime[0],
+                    dfMPix / adfTime[1], adfTime[0] / adfTime[1],
+                    anChecksum[0] == anChecksum[1] ? "identical"
+                                                   : "DIFFERENT" );
+        }
+
+        GDALClose( (GDALDatasetH) poDS );
+    }
+
+    CSLDestroy( argv );
+    GDALDestroyDriverManager();
+
+    return 0;
+}
@@ -0,0 +1,286 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Utilities
+ * Purpose:  Benchmark of raw binary reads with and without GDAL_RAW_MMAP.
+ *
+ ******************************************************************************
+ * Copyright (c) 2010, GDAL contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+
+#include "gdal_priv.h"
+#include "cpl_conv.h"
+#include "cpl_string.h"
+
+CPL_CVSID("$Id$");
+
+/************************************************************************/
+/*                               Usage()                                */
+/************************************************************************/
+
+static void Usage()
+{
+    printf( "rawreadbench [-size <n>] [-win <n>] [-n <windows>] [-ot <type>]\n"
+            "             [-i <iterations>] [-dir <work_dir>]\n"
+            "\n"
+            "Writes a synthetic n x n Int16 elevation grid as a BIL file in\n"
+            "little and in big endian byte order, then reads it with\n"
+            "GDAL_RAW_MMAP=NO and YES: sequentially by strips of win lines,\n"
+            "and as a number of win x win windows at random locations.\n"
+            "Reports megapixels per second, the speedup of the mapped reads\n"
+            "and whether both settings read the same values.\n" );
+    exit( 1 );
+}
+
+/************************************************************************/
+/*                              WriteBIL()                              */
+/*                                                                      */
+/*      Smooth terrain with some noise, written as a raw file with an   */
+/*      ESRI .hdr so that the byte order can be chosen.                 */
+/************************************************************************/
+
+static int WriteBIL( const char *pszFilename, int nSize, int bMSB )
+{
+    FILE *fp = VSIFOpenL( pszFilename, "wb" );
+    if( fp == NULL )
+        return FALSE;
+
+    GInt16 *panLine = (GInt16 *) CPLMalloc( sizeof(GInt16) * nSize );
+    GUInt32 nSeed = 1;
+    int bOK = TRUE, iX, iY;
+
+    for( iY = 0; iY < nSize && bOK; iY++ )
+    {
+        for( iX = 0; iX < nSize; iX++ )
+        {
+            nSeed = nSeed * 1103515245 + 12345;
+
+            panLine[iX] = (GInt16)
+                (((iX * 7 + iY * 3) % 4096) - ((iX * iY) % 1024)
+                 + ((nSeed >> 16) & 15));
+        }
+
+#ifdef CPL_LSB
+        if( bMSB )
+#else
+        if( !bMSB )
+#endif
+            GDALSwapWords( panLine, 2, nSize, 2 );
+
+        bOK = VSIFWriteL( panLine, 2, nSize, fp ) == (size_t) nSize;
+    }
+
+    CPLFree( panLine );
+    VSIFCloseL( fp );
+
+    fp = VSIFOpenL( CPLResetExtension( pszFilename, "hdr" ), "wt" );
+    if( fp == NULL )
+        return FALSE;
+
+    VSIFPrintfL( fp, "BYTEORDER %s\nLAYOUT BIL\nNROWS %d\nNCOLS %d\n"
+                 "NBANDS 1\nNBITS 16\nPIXELTYPE SIGNEDINT\n",
+                 bMSB ? "M" : "I", nSize, nSize );
+    VSIFCloseL( fp );
+
+    return bOK;
+}
+
+/************************************************************************/
+/*                              ReadBIL()                               */
+/*                                                                      */
+/*      Open the file and read nWindows windows of it, or the whole     */
+/*      file by strips of nWin lines if bRandom is FALSE.  Returns the  */
+/*      number of pixels read per second, or a negative value on        */
+/*      failure.  pnChecksum gets a checksum of the values read.        */
+/************************************************************************/
+
+static double ReadBIL( const char *pszFilename, int nWin, int nWindows,
+                       int bRandom, GDALDataType eBufType, void *pBuffer,
+                       GUInt32 *pnChecksum )
+{
+    double dfStart = CPLGetWallTime();
+    GDALDataset *poDS = (GDALDataset *) GDALOpen( pszFilename, GA_ReadOnly );
+    GDALRasterBand *poBand;
+    int nXSize, nYSize, iWindow;
+    double dfPixels = 0.0;
+    GUInt32 nSeed = 42;
+    CPLErr eErr = CE_None;
+
+    if( poDS == NULL )
+        return -1.0;
+
+    poBand = poDS->GetRasterBand( 1 );
+    nXSize = poDS->GetRasterXSize();
+    nYSize = poDS->GetRasterYSize();
+
+    if( !bRandom )
+        nWindows = (nYSize + nWin - 1) / nWin;
+
+    *pnChecksum = 0;
+
+    for( iWindow = 0; iWindow < nWindows && eErr == CE_None; iWindow++ )
+    {
+        int nXOff = 0, nYOff = iWindow * nWin, nW = nXSize, nH = nWin;
+
+        if( bRandom )
+        {
+            nSeed = nSeed * 1103515245 + 12345;
+            nXOff = (nSeed >> 8) % (nXSize - nWin + 1);
+            nSeed = nSeed * 1103515245 + 12345;
+            nYOff = (nSeed >> 8) % (nYSize - nWin + 1);
+            nW = nWin;
+        }
+        else if( nYOff + nH > nYSize )
+            nH = nYSize - nYOff;
+
+        eErr = poBand->RasterIO( GF_Read, nXOff, nYOff, nW, nH,
+                                 pBuffer, nW, nH, eBufType, 0, 0 );
+
+        /* Sample the values, a full checksum would dominate the timing */
+        int nBytes = nW * nH * (GDALGetDataTypeSize( eBufType ) / 8);
+        for( int i = 0; i < nBytes; i += 61 )
+            *pnChecksum = *pnChecksum * 31 + ((GByte *) pBuffer)[i];
+
+        dfPixels += nW * (double) nH;
+    }
+
+    GDALClose( (GDALDatasetH) poDS );
+
+    if( eErr != CE_None )
+        return -1.0;
+
+    return dfPixels / (CPLGetWallTime() - dfStart);
+}
+
+/************************************************************************/
+/*                                main()                                */
+/************************************************************************/
+
+int main( int argc, char ** argv )
+
+{
+    int nSize = 8192, nWin = 256, nWindows = 2000, nIterations = 3;
+    GDALDataType eBufType = GDT_Int16;
+    const char *pszDir = "rawreadbench.tmp";
+    int i;
+
+    GDALAllRegister();
+
+    argc = GDALGeneralCmdLineProcessor( argc, &argv, 0 );
+    if( argc < 1 )
+        exit( -argc );
+
+    for( i = 1; i < argc; i++ )
+    {
+        if( EQUAL(argv[i],"-size") && i < argc-1 )
+            nSize = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-win") && i < argc-1 )
+            nWin = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-n") && i < argc-1 )
+            nWindows = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-ot") && i < argc-1 )
+        {
+            eBufType = GDALGetDataTypeByName( argv[++i] );
+            if( eBufType == GDT_Unknown )
+                Usage();
+        }
+        else if( EQUAL(argv[i],"-i") && i < argc-1 )
+            nIterations = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-dir") && i < argc-1 )
+            pszDir = argv[++i];
+        else
+            Usage();
+    }
+
+    if( nWin < 1 || nSize < nWin || nWindows < 1 || nIterations < 1 )
+        Usage();
+
+    VSIMkdir( pszDir, 0755 );
+
+    void *pBuffer = VSIMalloc3( nSize, nWin,
+                                GDALGetDataTypeSize( eBufType ) / 8 );
+    if( pBuffer == NULL )
+        exit( 1 );
+
+    printf( "%dx%d Int16 BIL read as %s, strips of %d lines and %d random "
+            "%dx%d windows,\nbest of %d iterations\n",
+            nSize, nSize, GDALGetDataTypeName( eBufType ), nWin, nWindows,
+            nWin, nWin, nIterations );
+    printf( "%-10s %-10s %12s %12s %8s  %s\n", "BYTEORDER", "access",
+            "NO MPix/s", "YES MPix/s", "speedup", "values" );
+
+    int iOrder, iRandom, iMMap, iIter;
+
+    for( iOrder = 0; iOrder < 2; iOrder++ )
+    {
+        CPLString osFilename;
+
+        osFilename.Printf( "%s/%s.bil", pszDir, iOrder ? "msb" : "lsb" );
+        if( !WriteBIL( osFilename, nSize, iOrder ) )
+        {
+            fprintf( stderr, "Writing %s failed.\n", osFilename.c_str() );
+            exit( 1 );
+        }
+
+        for( iRandom = 0; iRandom < 2; iRandom++ )
+        {
+            double adfBest[2] = { 0.0, 0.0 };
+            GUInt32 anChecksum[2] = { 0, 0 };
+
+            for( iMMap = 0; iMMap < 2; iMMap++ )
+            {
+                CPLSetConfigOption( "GDAL_RAW_MMAP", iMMap ? "YES" : "NO" );
+
+                for( iIter = 0; iIter < nIterations; iIter++ )
+                {
+                    double dfRate = ReadBIL( osFilename, nWin, nWindows,
+                                             iRandom, eBufType, pBuffer,
+                                             anChecksum + iMMap );
+                    if( dfRate < 0 )
+                    {
+                        fprintf( stderr, "Reading %s failed.\n",
+                                 osFilename.c_str() );
+                        exit( 1 );
+                    }
+                    if( dfRate > adfBest[iMMap] )
+                        adfBest[iMMap] = dfRate;
+                }
+            }
+
+            CPLSetConfigOption( "GDAL_RAW_MMAP", NULL );
+
+            printf( "%-10s %-10s %12.1f %12.1f %8.2f  %s\n",
+                    iOrder ? "MSB" : "LSB",
+                    iRandom ? "random" : "sequential",
+                    adfBest[0] / 1000000.0, adfBest[1] / 1000000.0,
+                    adfBest[1] / adfBest[0],
+                    anChecksum[0] == anChecksum[1] ? "identical"
+                                                   : "DIFFERENT" );
+        }
+    }
+
+    VSIFree( pBuffer );
+    CSLDestroy( argv );
+    GDALDestroyDriverManager();
+
+    return 0;
+}
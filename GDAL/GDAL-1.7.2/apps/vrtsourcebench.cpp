@@ -0,0 +1,255 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Utilities
+ * Purpose:  Benchmark of small window reads on VRT mosaics with a large
+ *           number of sources, with and without the source index.
+ *
+ ******************************************************************************
+ * Copyright (c) 2010, GDAL contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+
+#include "gdal.h"
+#include "vrt/gdal_vrt.h"
+#include "cpl_conv.h"
+#include "cpl_string.h"
+
+CPL_CVSID("$Id$");
+
+/************************************************************************/
+/*                               Usage()                                */
+/************************************************************************/
+
+static void Usage()
+{
+    printf( "vrtsourcebench [-sources <n>] [-tile <n>] [-win <n>] [-reads <n>]\n"
+            "               [-dir <work_dir>]\n"
+            "\n"
+            "Builds an in-memory VRT mosaic of about n overlapping tile x tile\n"
+            "sources, all taken from one small GeoTIFF, then reads the same\n"
+            "random win x win windows from it with VRT_SOURCE_INDEX=NO and\n"
+            "VRT_SOURCE_INDEX=YES.  Reports the time per window and whether\n"
+            "the pixels read are the same.\n" );
+    exit( 1 );
+}
+
+/************************************************************************/
+/*                            WriteSource()                             */
+/************************************************************************/
+
+static int WriteSource( const char *pszFilename, int nSize )
+{
+    GDALDatasetH hDS = GDALCreate( GDALGetDriverByName( "GTiff" ),
+                                   pszFilename, nSize, nSize, 1, GDT_Byte,
+                                   NULL );
+    if( hDS == NULL )
+        return FALSE;
+
+    GByte *pabyData = (GByte *) CPLMalloc( nSize * nSize );
+    int iX, iY;
+
+    for( iY = 0; iY < nSize; iY++ )
+        for( iX = 0; iX < nSize; iX++ )
+            pabyData[iY * nSize + iX] = (GByte) ((iX * 7 + iY * 13) ^ (iX*iY));
+
+    CPLErr eErr = GDALRasterIO( GDALGetRasterBand( hDS, 1 ), GF_Write, 
+                                0, 0, nSize, nSize, pabyData, nSize, nSize,
+                                GDT_Byte, 0, 0 );
+    CPLFree( pabyData );
+    GDALClose( hDS );
+
+    return eErr == CE_None;
+}
+
+/************************************************************************/
+/*                             ReadWindows()                            */
+/*                                                                      */
+/*      Read nReads pseudo-random windows, always the same ones.        */
+/*      Returns the time per window, or a negative value on failure.    */
+/*      pnChecksum gets a checksum of all the pixels read.              */
+/************************************************************************/
+
+static double ReadWindows( GDALRasterBandH hBand, int nWin, int nReads,
+                           GByte *pabyBuffer, GUInt32 *pnChecksum )
+{
+    int nXSize = GDALGetRasterBandXSize( hBand );
+    int nYSize = GDALGetRasterBandYSize( hBand );
+    GUInt32 nSeed = 1;
+    double dfStart = CPLGetWallTime();
+    int iRead, i;
+
+    *pnChecksum = 0;
+
+    for( iRead = 0; iRead < nReads; iRead++ )
+    {
+        nSeed = nSeed * 1103515245 + 12345;
+        int nXOff = (int) ((nSeed >> 8) % (GUInt32) (nXSize - nWin + 1));
+        nSeed = nSeed * 1103515245 + 12345;
+        int nYOff = (int) ((nSeed >> 8) % (GUInt32) (nYSize - nWin + 1));
+
+        if( GDALRasterIO( hBand, GF_Read, nXOff, nYOff, nWin, nWin, 
+                          pabyBuffer, nWin, nWin, GDT_Byte, 0, 0 )
+            != CE_None )
+            return -1.0;
+
+        for( i = 0; i < nWin * nWin; i++ )
+            *pnChecksum = *pnChecksum * 31 + pabyBuffer[i];
+    }
+
+    return (CPLGetWallTime() - dfStart) / nReads;
+}
+
+/************************************************************************/
+/*                                main()                                */
+/************************************************************************/
+
+int main( int argc, char ** argv )
+
+{
+    int nSources = 100000, nTile = 64, nWin = 256, nReads = 500;
+    const char *pszDir = "vrtsourcebench.tmp";
+    int i;
+
+    GDALAllRegister();
+
+    argc = GDALGeneralCmdLineProcessor( argc, &argv, 0 );
+    if( argc < 1 )
+        exit( -argc );
+
+    for( i = 1; i < argc; i++ )
+    {
+        if( EQUAL(argv[i],"-sources") && i < argc-1 )
+            nSources = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-tile") && i < argc-1 )
+            nTile = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-win") && i < argc-1 )
+            nWin = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-reads") && i < argc-1 )
+            nReads = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-dir") && i < argc-1 )
+            pszDir = argv[++i];
+        else
+            Usage();
+    }
+
+    if( nSources < 1 || nTile < 8 || nWin < 1 || nReads < 1 )
+        Usage();
+
+/* -------------------------------------------------------------------- */
+/*      Tiles are laid out on a square grid with a step of 7/8 of the   */
+/*      tile size, so neighbours overlap and the overlay order of the   */
+/*      sources shows in the result.                                    */
+/* -------------------------------------------------------------------- */
+    int nSrcSize = 512;
+    int nStep = nTile - nTile / 8;
+    int nTilesPerLine = (int) ceil( sqrt( (double) nSources ) );
+    int nSize = nStep * (nTilesPerLine - 1) + nTile;
+
+    if( nTile > nSrcSize || nWin > nSize )
+        Usage();
+
+    VSIMkdir( pszDir, 0755 );
+
+    CPLString osSource = CPLFormFilename( pszDir, "source.tif", NULL );
+    if( !WriteSource( osSource, nSrcSize ) )
+    {
+        fprintf( stderr, "Writing %s failed.\n", osSource.c_str() );
+        exit( 1 );
+    }
+
+    GDALDatasetH hSrcDS = GDALOpenShared( osSource, GA_ReadOnly );
+    if( hSrcDS == NULL )
+        exit( 1 );
+
+    double dfStart = CPLGetWallTime();
+    VRTDatasetH hVRTDS = VRTCreate( nSize, nSize );
+
+    GDALAddBand( hVRTDS, GDT_Byte, NULL );
+    VRTSourcedRasterBandH hVRTBand = 
+        (VRTSourcedRasterBandH) GDALGetRasterBand( hVRTDS, 1 );
+
+    for( i = 0; i < nSources; i++ )
+    {
+        int nSrcXOff = (i * 37) % (nSrcSize - nTile + 1);
+        int nSrcYOff = (i * 101) % (nSrcSize - nTile + 1);
+
+        VRTAddSimpleSource( hVRTBand, GDALGetRasterBand( hSrcDS, 1 ),
+                            nSrcXOff, nSrcYOff, nTile, nTile,
+                            (i % nTilesPerLine) * nStep,
+                            (i / nTilesPerLine) * nStep, nTile, nTile,
+                            "near", VRT_NODATA_UNSET );
+    }
+
+    printf( "%dx%d VRT of %d %dx%d sources built in %.2f s, "
+            "%d random %dx%d reads\n", nSize, nSize, nSources, nTile, nTile,
+            CPLGetWallTime() - dfStart, nReads, nWin, nWin );
+    printf( "%-16s %10s %8s  %s\n", "VRT_SOURCE_INDEX", "ms/window", 
+            "speedup", "pixels" );
+
+    GByte *pabyBuffer = (GByte *) CPLMalloc( nWin * nWin );
+    const char *apszIndex[2] = { "NO", "YES" };
+    double dfReference = 0.0;
+    GUInt32 nReferenceChecksum = 0;
+
+/* -------------------------------------------------------------------- */
+/*      The index is built on the first read that needs it, so the      */
+/*      unindexed run must come first.                                  */
+/* -------------------------------------------------------------------- */
+    for( i = 0; i < 2; i++ )
+    {
+        GUInt32 nChecksum = 0;
+        const char *pszPixels = "reference";
+
+        CPLSetConfigOption( "VRT_SOURCE_INDEX", apszIndex[i] );
+
+        double dfTime = ReadWindows( (GDALRasterBandH) hVRTBand, nWin, nReads,
+                                     pabyBuffer, &nChecksum );
+        if( dfTime < 0 )
+        {
+            fprintf( stderr, "Reading the VRT failed.\n" );
+            exit( 1 );
+        }
+
+        if( i == 0 )
+        {
+            dfReference = dfTime;
+            nReferenceChecksum = nChecksum;
+        }
+        else if( nChecksum == nReferenceChecksum )
+            pszPixels = "identical";
+        else
+            pszPixels = "DIFFERENT";
+
+        printf( "%-16s %10.3f %8.1f  %s\n", apszIndex[i], 1000.0 * dfTime,
+                dfReference / dfTime, pszPixels );
+    }
+
+    CPLSetConfigOption( "VRT_SOURCE_INDEX", NULL );
+
+    CPLFree( pabyBuffer );
+    GDALClose( hVRTDS );
+    GDALClose( hSrcDS );
+    CSLDestroy( argv );
+    GDALDestroyDriverManager();
+
+    return 0;
+}
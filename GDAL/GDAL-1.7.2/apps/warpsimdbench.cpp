@@ -0,0 +1,299 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Utilities
+ * Purpose:  Benchmark of the scalar and vectorized warp kernel resamplers.
+ *
+ ******************************************************************************
+ * Copyright (c) 2010, GDAL contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "gdalwarper.h"
+#include "cpl_conv.h"
+#include "cpl_string.h"
+
+CPL_CVSID("$Id$");
+
+/************************************************************************/
+/*                               Usage()                                */
+/************************************************************************/
+
+static void Usage()
+{
+    printf( "warpsimdbench [-size <pixels>] [-i <iterations>]\n"
+            "\n"
+            "Warps synthetic Byte and Int16 in-memory rasters with each\n"
+            "resampling algorithm, with the vectorized resamplers disabled\n"
+            "(GDAL_WARP_SIMD=NO), restricted to SSE2, and with the best\n"
+            "available ones, and checks that the results are within 1.\n" );
+    exit( 1 );
+}
+
+/************************************************************************/
+/*                          CreateSourceDS()                            */
+/*                                                                      */
+/*      Smooth gradients with some high frequency content, so that      */
+/*      the interpolators produce non trivial values.                   */
+/************************************************************************/
+
+static GDALDatasetH CreateSourceDS( GDALDataType eType, int nBands,
+                                    int nSize )
+
+{
+    GDALDriverH hDriver = GDALGetDriverByName( "MEM" );
+    GDALDatasetH hDS = GDALCreate( hDriver, "", nSize, nSize, nBands,
+                                   eType, NULL );
+    double adfGeoTransform[6] = { 1000.0, 1.0, 0.0, 2000.0, 0.0, -1.0 };
+    double *padfLine = (double *) CPLMalloc( sizeof(double) * nSize );
+    double dfRange = (eType == GDT_Byte) ? 255.0 : 8000.0;
+    int    iBand, iX, iY;
+
+    GDALSetGeoTransform( hDS, adfGeoTransform );
+
+    for( iBand = 0; iBand < nBands; iBand++ )
+    {
+        GDALRasterBandH hBand = GDALGetRasterBand( hDS, iBand + 1 );
+
+        for( iY = 0; iY < nSize; iY++ )
+        {
+            for( iX = 0; iX < nSize; iX++ )
+            {
+                double dfValue = 0.5 + 0.3 * sin( (iX + iBand * 7) * 0.05 )
+                    * cos( iY * 0.03 ) + 0.2 * (((iX * 31 + iY * 17) % 13)
+                                                / 13.0 - 0.5);
+                padfLine[iX] = dfValue * dfRange - (eType == GDT_Byte ? 0 : 500);
+            }
+            GDALRasterIO( hBand, GF_Write, 0, iY, nSize, 1,
+                          padfLine, nSize, 1, GDT_Float64, 0, 0 );
+        }
+    }
+
+    CPLFree( padfLine );
+
+    return hDS;
+}
+
+/************************************************************************/
+/*                              RunWarp()                               */
+/*                                                                      */
+/*      Warp to a rotated and slightly zoomed grid, and return the      */
+/*      best wall time of the iterations.  The destination is read      */
+/*      back as doubles in padfResult.                                  */
+/************************************************************************/
+
+static double RunWarp( GDALDatasetH hSrcDS, GDALResampleAlg eResampleAlg,
+                       int nIterations, double *padfResult )
+
+{
+    int    nSize = GDALGetRasterXSize( hSrcDS );
+    int    nBands = GDALGetRasterCount( hSrcDS );
+    GDALDataType eType =
+        GDALGetRasterDataType( GDALGetRasterBand( hSrcDS, 1 ) );
+    GDALDatasetH hDstDS = GDALCreate( GDALGetDriverByName( "MEM" ), "",
+                                      nSize, nSize, nBands, eType, NULL );
+    double dfAngle = 10.0 * 3.14159265358979323846 / 180.0;
+    double dfRes = 0.9;
+    double adfGeoTransform[6];
+    double dfBest = 0.0;
+    int    iIter, iBand;
+
+    adfGeoTransform[0] = 1000.0 + nSize * 0.05;
+    adfGeoTransform[1] = dfRes * cos( dfAngle );
+    adfGeoTransform[2] = dfRes * sin( dfAngle );
+    adfGeoTransform[3] = 2000.0 - nSize * 0.02;
+    adfGeoTransform[4] = dfRes * sin( dfAngle );
+    adfGeoTransform[5] = -dfRes * cos( dfAngle );
+    GDALSetGeoTransform( hDstDS, adfGeoTransform );
+
+    for( iIter = 0; iIter < nIterations; iIter++ )
+    {
+        GDALWarpOptions *psOptions = GDALCreateWarpOptions();
+
+        psOptions->hSrcDS = hSrcDS;
+        psOptions->hDstDS = hDstDS;
+        psOptions->eResampleAlg = eResampleAlg;
+        psOptions->dfWarpMemoryLimit = 256.0 * 1024 * 1024;
+        psOptions->nBandCount = nBands;
+        psOptions->panSrcBands = (int *) CPLMalloc( sizeof(int) * nBands );
+        psOptions->panDstBands = (int *) CPLMalloc( sizeof(int) * nBands );
+        for( iBand = 0; iBand < nBands; iBand++ )
+        {
+            psOptions->panSrcBands[iBand] = iBand + 1;
+            psOptions->panDstBands[iBand] = iBand + 1;
+        }
+
+        psOptions->pTransformerArg =
+            GDALCreateGenImgProjTransformer( hSrcDS, NULL, hDstDS, NULL,
+                                             FALSE, 0.0, 0 );
+        psOptions->pfnTransformer = GDALGenImgProjTransform;
+        if( psOptions->pTransformerArg == NULL )
+            exit( 1 );
+
+        GDALWarpOperation oOperation;
+        double dfStart = CPLGetWallTime();
+
+        if( oOperation.Initialize( psOptions ) == CE_None )
+            oOperation.ChunkAndWarpImage( 0, 0, nSize, nSize );
+
+        double dfElapsed = CPLGetWallTime() - dfStart;
+
+        if( iIter == 0 || dfElapsed < dfBest )
+            dfBest = dfElapsed;
+
+        GDALDestroyGenImgProjTransformer( psOptions->pTransformerArg );
+        GDALDestroyWarpOptions( psOptions );
+    }
+
+    for( iBand = 0; iBand < nBands; iBand++ )
+        GDALRasterIO( GDALGetRasterBand( hDstDS, iBand + 1 ), GF_Read,
+                      0, 0, nSize, nSize,
+                      padfResult + iBand * (size_t) nSize * nSize,
+                      nSize, nSize, GDT_Float64, 0, 0 );
+
+    GDALClose( hDstDS );
+
+    return dfBest;
+}
+
+/************************************************************************/
+/*                             MaxDiff()                                */
+/************************************************************************/
+
+static double MaxDiff( const double *padfA, const double *padfB,
+                       size_t nCount )
+
+{
+    double dfMax = 0.0;
+    size_t i;
+
+    for( i = 0; i < nCount; i++ )
+    {
+        double dfDiff = fabs( padfA[i] - padfB[i] );
+        if( dfDiff > dfMax )
+            dfMax = dfDiff;
+    }
+
+    return dfMax;
+}
+
+/************************************************************************/
+/*                                main()                                */
+/************************************************************************/
+
+int main( int argc, char ** argv )
+
+{
+    int nSize = 2048, nIterations = 3;
+    int i, bFailed = FALSE;
+
+    GDALAllRegister();
+
+    argc = GDALGeneralCmdLineProcessor( argc, &argv, 0 );
+    if( argc < 1 )
+        exit( -argc );
+
+    for( i = 1; i < argc; i++ )
+    {
+        if( EQUAL(argv[i],"-size") && i < argc-1 )
+            nSize = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-i") && i < argc-1 )
+            nIterations = atoi(argv[++i]);
+        else
+            Usage();
+    }
+
+    if( nSize < 16 || nIterations < 1 )
+        Usage();
+
+    static const GDALResampleAlg aeAlgs[] =
+        { GRA_NearestNeighbour, GRA_Bilinear, GRA_Cubic, GRA_CubicSpline,
+          GRA_Lanczos };
+    static const char *apszAlgNames[] =
+        { "near", "bilinear", "cubic", "cubicspline", "lanczos" };
+    static const char *apszModes[] = { "NO", "SSE2", "YES" };
+    GDALDataType aeTypes[2] = { GDT_Byte, GDT_Int16 };
+    int anBands[2] = { 3, 1 };
+    int iType, iAlg, iMode;
+
+    printf( "%dx%d, best of %d iterations (seconds, speed-up, max diff)\n",
+            nSize, nSize, nIterations );
+    printf( "%-6s %-12s %8s %16s %16s\n", "type", "resampling",
+            "scalar", "SSE2", "best" );
+
+    for( iType = 0; iType < 2; iType++ )
+    {
+        GDALDatasetH hSrcDS = CreateSourceDS( aeTypes[iType], anBands[iType],
+                                              nSize );
+        size_t nValues = (size_t) nSize * nSize * anBands[iType];
+        double *padfScalar = (double *) CPLMalloc( sizeof(double) * nValues );
+        double *padfSIMD = (double *) CPLMalloc( sizeof(double) * nValues );
+
+        for( iAlg = 0; iAlg < (int) (sizeof(aeAlgs) / sizeof(aeAlgs[0]));
+             iAlg++ )
+        {
+            double dfScalarTime = 0.0;
+
+            printf( "%-6s %-12s", GDALGetDataTypeName( aeTypes[iType] ),
+                    apszAlgNames[iAlg] );
+
+            for( iMode = 0; iMode < 3; iMode++ )
+            {
+                CPLSetConfigOption( "GDAL_WARP_SIMD", apszModes[iMode] );
+
+                if( iMode == 0 )
+                {
+                    dfScalarTime = RunWarp( hSrcDS, aeAlgs[iAlg], nIterations,
+                                            padfScalar );
+                    printf( " %8.3f", dfScalarTime );
+                }
+                else
+                {
+                    double dfTime = RunWarp( hSrcDS, aeAlgs[iAlg],
+                                             nIterations, padfSIMD );
+                    double dfDiff = MaxDiff( padfScalar, padfSIMD, nValues );
+
+                    printf( " %6.3f x%4.2f %2.0f", dfTime,
+                            dfTime > 0.0 ? dfScalarTime / dfTime : 0.0,
+                            dfDiff );
+
+                    if( dfDiff > 1.0 )
+                        bFailed = TRUE;
+                }
+                fflush( stdout );
+            }
+            printf( "\n" );
+        }
+
+        CPLFree( padfScalar );
+        CPLFree( padfSIMD );
+        GDALClose( hSrcDS );
+    }
+
+    CPLSetConfigOption( "GDAL_WARP_SIMD", NULL );
+
+    if( bFailed )
+        printf( "FAILED: vectorized results differ by more than 1.\n" );
+
+    CSLDestroy( argv );
+    GDALDestroyDriverManager();
+
+    return bFailed ? 1 : 0;
+}
@@ -0,0 +1,290 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Utilities
+ * Purpose:  Benchmark of WMS tile fetching and decoding from a local tile tree.
+ *
+ ******************************************************************************
+ * Copyright (c) 2010, GDAL contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+
+#include "gdal_priv.h"
+#include "cpl_conv.h"
+#include "cpl_string.h"
+
+CPL_CVSID("$Id$");
+
+/************************************************************************/
+/*                               Usage()                                */
+/************************************************************************/
+
+static void Usage()
+{
+    printf( "wmstilebench [-tiles <n>] [-format PNG|JPEG] [-i <iterations>]\n"
+            "             [-depth <cache_depth>] [-dir <work_dir>]\n"
+            "             [-url <tiles_url>] [-maxconn <n>]\n"
+            "\n"
+            "Writes n x n tiles of 256x256 pixels under work_dir, and reads\n"
+            "them through the WMS driver (TMS service with file:// URLs):\n"
+            "first without disk cache, then from a warm disk cache in\n"
+            "offline mode.  Reports the time per tile.  A cache depth of 0\n"
+            "puts all the cached tiles in a single directory, like a large\n"
+            "cache would have in its leaf directories.\n"
+            "\n"
+            "With -url, the tiles are fetched from <tiles_url>/1/x/y.ext\n"
+            "instead, for instance from a local HTTP server serving\n"
+            "work_dir/tiles.\n" );
+    exit( 1 );
+}
+
+/************************************************************************/
+/*                            WriteTiles()                              */
+/************************************************************************/
+
+static int WriteTiles( const char *pszDir, int nTiles, const char *pszFormat,
+                       const char *pszExt )
+
+{
+    GDALDriverH hDriver = GDALGetDriverByName( pszFormat );
+    GDALDatasetH hMemDS;
+    GByte *pabyTile = (GByte *) CPLMalloc( 256 * 256 );
+    int iX, iY, iBand, iPixel;
+
+    if( hDriver == NULL )
+    {
+        fprintf( stderr, "%s driver not available.\n", pszFormat );
+        return FALSE;
+    }
+
+    hMemDS = GDALCreate( GDALGetDriverByName( "MEM" ), "", 256, 256, 3,
+                         GDT_Byte, NULL );
+
+    VSIMkdir( pszDir, 0755 );
+    VSIMkdir( CPLFormFilename( pszDir, "tiles", NULL ), 0755 );
+    VSIMkdir( CPLFormFilename( pszDir, "tiles/1", NULL ), 0755 );
+
+    for( iX = 0; iX < nTiles; iX++ )
+    {
+        CPLString osColumn;
+        osColumn.Printf( "%s/tiles/1/%d", pszDir, iX );
+        VSIMkdir( osColumn, 0755 );
+
+        for( iY = 0; iY < nTiles; iY++ )
+        {
+            for( iBand = 0; iBand < 3; iBand++ )
+            {
+                for( iPixel = 0; iPixel < 256 * 256; iPixel++ )
+                {
+                    int nX = iX * 256 + iPixel % 256;
+                    int nY = iY * 256 + iPixel / 256;
+                    pabyTile[iPixel] = (GByte)
+                        (((nX * (iBand + 1) + nY * 3) >> 2)
+                         + ((nX * 7 + nY * 13 + iBand) % 11));
+                }
+                GDALRasterIO( GDALGetRasterBand( hMemDS, iBand + 1 ), GF_Write,
+                              0, 0, 256, 256, pabyTile, 256, 256, GDT_Byte,
+                              0, 0 );
+            }
+
+            CPLString osTile;
+            osTile.Printf( "%s/%d.%s", osColumn.c_str(), iY, pszExt );
+
+            GDALDatasetH hTileDS = GDALCreateCopy( hDriver, osTile, hMemDS,
+                                                   FALSE, NULL, NULL, NULL );
+            if( hTileDS == NULL )
+                return FALSE;
+            GDALClose( hTileDS );
+        }
+    }
+
+    GDALClose( hMemDS );
+    CPLFree( pabyTile );
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                              ReadWMS()                               */
+/*                                                                      */
+/*      Read the whole raster of a WMS service description, and         */
+/*      return the wall time, or -1 on failure.                         */
+/************************************************************************/
+
+static double ReadWMS( const char *pszXML, int nSize, GByte *pabyBuffer )
+
+{
+    double dfStart = CPLGetWallTime();
+    GDALDatasetH hDS = GDALOpen( pszXML, GA_ReadOnly );
+    CPLErr eErr;
+
+    if( hDS == NULL )
+        return -1.0;
+
+    eErr = GDALDatasetRasterIO( hDS, GF_Read, 0, 0, nSize, nSize,
+                                pabyBuffer, nSize, nSize, GDT_Byte,
+                                3, NULL, 0, 0, 0 );
+    GDALClose( hDS );
+
+    if( eErr != CE_None )
+        return -1.0;
+
+    return CPLGetWallTime() - dfStart;
+}
+
+/************************************************************************/
+/*                                main()                                */
+/************************************************************************/
+
+int main( int argc, char ** argv )
+
+{
+    int nTiles = 8, nIterations = 3, nDepth = 2, nMaxConn = 8;
+    const char *pszFormat = "PNG";
+    const char *pszDir = "wmstilebench.tmp";
+    const char *pszURL = NULL;
+    int i;
+
+    GDALAllRegister();
+
+    argc = GDALGeneralCmdLineProcessor( argc, &argv, 0 );
+    if( argc < 1 )
+        exit( -argc );
+
+    for( i = 1; i < argc; i++ )
+    {
+        if( EQUAL(argv[i],"-tiles") && i < argc-1 )
+            nTiles = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-format") && i < argc-1 )
+            pszFormat = argv[++i];
+        else if( EQUAL(argv[i],"-i") && i < argc-1 )
+            nIterations = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-depth") && i < argc-1 )
+            nDepth = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-url") && i < argc-1 )
+            pszURL = argv[++i];
+        else if( EQUAL(argv[i],"-maxconn") && i < argc-1 )
+            nMaxConn = atoi(argv[++i]);
+        else if( EQUAL(argv[i],"-dir") && i < argc-1 )
+            pszDir = argv[++i];
+        else
+            Usage();
+    }
+
+    if( nTiles < 1 || nTiles > 64 || nIterations < 1 || nDepth < 0
+        || nMaxConn < 1 )
+        Usage();
+
+    const char *pszExt = EQUAL(pszFormat, "JPEG") ? "jpg" : "png";
+    int nSize = nTiles * 256;
+
+    if( !WriteTiles( pszDir, nTiles, pszFormat, pszExt ) )
+        exit( 1 );
+
+/* -------------------------------------------------------------------- */
+/*      Service descriptions.  The data window covers the               */
+/*      nTiles x nTiles tiles of level 1.                               */
+/* -------------------------------------------------------------------- */
+    char *pszFullDir = CPLStrdup( CPLGetCurrentDir() );
+    CPLString osTilesURL, osWindow, osXML, osCachedXML;
+
+    if( pszURL != NULL )
+        osTilesURL = pszURL;
+    else if( CPLIsFilenameRelative( pszDir ) )
+        osTilesURL.Printf( "file://%s/%s/tiles", pszFullDir, pszDir );
+    else
+        osTilesURL.Printf( "file://%s/tiles", pszDir );
+    CPLFree( pszFullDir );
+
+    osWindow.Printf(
+        "<DataWindow><UpperLeftX>0</UpperLeftX><UpperLeftY>%d</UpperLeftY>"
+        "<LowerRightX>%d</LowerRightX><LowerRightY>0</LowerRightY>"
+        "<SizeX>%d</SizeX><SizeY>%d</SizeY><TileLevel>1</TileLevel>"
+        "<YOrigin>top</YOrigin></DataWindow>",
+        nSize, nSize, nSize, nSize );
+
+    osXML.Printf(
+        "<GDAL_WMS><Service name=\"TMS\">"
+        "<ServerUrl>%s/${z}/${x}/${y}.%s</ServerUrl></Service>%s"
+        "<BlockSizeX>256</BlockSizeX><BlockSizeY>256</BlockSizeY>"
+        "<BandsCount>3</BandsCount><OverviewCount>0</OverviewCount>"
+        "<MaxConnections>%d</MaxConnections>%%s</GDAL_WMS>",
+        osTilesURL.c_str(), pszExt, osWindow.c_str(), nMaxConn );
+    osCachedXML.Printf( osXML.c_str(),
+                        CPLSPrintf( "<Cache><Path>%s/cache%d</Path>"
+                                    "<Depth>%d</Depth></Cache>"
+                                    "<OfflineMode>true</OfflineMode>",
+                                    pszDir, nDepth, nDepth ) );
+    osXML.Printf( CPLString( osXML ).c_str(), "" );
+
+    GDALSetCacheMax( 256 * 1024 * 1024 );
+
+    GByte *pabyBuffer = (GByte *) VSIMalloc3( nSize, nSize, 3 );
+    if( pabyBuffer == NULL )
+        exit( 1 );
+
+/* -------------------------------------------------------------------- */
+/*      Populate the disk cache, then time both paths.                  */
+/* -------------------------------------------------------------------- */
+    CPLString osFillXML( osCachedXML );
+    osFillXML.replace( osFillXML.find( "<OfflineMode>true" ),
+                       strlen( "<OfflineMode>true</OfflineMode>" ), "" );
+
+    if( ReadWMS( osFillXML, nSize, pabyBuffer ) < 0 )
+    {
+        fprintf( stderr, "Reading %s failed.\n", osTilesURL.c_str() );
+        exit( 1 );
+    }
+
+    printf( "%d %s tiles, best of %d iterations (ms per tile)\n",
+            nTiles * nTiles, pszFormat, nIterations );
+
+    const char *apszLabels[2] = { "fetch", "disk cache" };
+    const char *apszXML[2] = { osXML.c_str(), osCachedXML.c_str() };
+    int iMode, iIter;
+
+    for( iMode = 0; iMode < 2; iMode++ )
+    {
+        double dfBest = 0.0;
+
+        for( iIter = 0; iIter < nIterations; iIter++ )
+        {
+            double dfTime = ReadWMS( apszXML[iMode], nSize, pabyBuffer );
+
+            if( dfTime < 0 )
+            {
+                fprintf( stderr, "Reading %s failed.\n", apszLabels[iMode] );
+                exit( 1 );
+            }
+            if( iIter == 0 || dfTime < dfBest )
+                dfBest = dfTime;
+        }
+
+        printf( "%-14s %8.3f\n", apszLabels[iMode],
+                1000.0 * dfBest / (nTiles * nTiles) );
+    }
+
+    VSIFree( pabyBuffer );
+    CSLDestroy( argv );
+    GDALDestroyDriverManager();
+
+    return 0;
+}
@@ -40,6 +40,7 @@
 #include "cpl_minixml.h"
 #include "gt_overview.h"
 #include "ogr_spatialref.h"
+#include "cpl_worker_thread_pool.h"
 
 CPL_CVSID("$Id$");
 
@@ -69,6 +70,29 @@ enum
     ENDIANNESS_BIG
 };
 
+/* A tile or strip waiting to be compressed by a worker thread (NUM_THREADS) */
+typedef struct
+{
+    int         nBlockId;
+    int         nRows;          /* rows of the block actually written */
+    GByte      *pabyData;       /* uncompressed copy of the block */
+    int         nDataSize;
+    GByte      *pabyCompressed;
+    int         nCompressedSize;
+    int         bSuccess;
+} GTiffCompressionJob;
+
+/* A block of a RasterIO() request to be decoded by a worker thread */
+typedef struct
+{
+    int         nBlockId;
+    int         nBlockXOff;
+    int         nBlockYOff;
+    int         nBlockReqSize;
+    GDALRasterBlock **papoBlocks; /* per band if pixel interleaved, NULL if cached */
+    int         bSuccess;
+} GTiffDecodeJob;
+
 /************************************************************************/
 /* ==================================================================== */
 /*				GTiffDataset				*/
@@ -140,7 +164,7 @@ class GTiffDataset : public GDALPamDataset
     int		nGCPCount;
     GDAL_GCP	*pasGCPList;
 
-    int         IsBlockAvailable( int nBlockId );
+    int         IsBlockAvailable( int nBlockId, int *pbErrOccurred = NULL );
 
     int         bGeoTIFFInfoChanged;
     int         bNoDataSet;
@@ -167,6 +191,7 @@ class GTiffDataset : public GDALPamDataset
     int          nTempWriteBufferSize;
     int          WriteEncodedTile(uint32 tile, void* data, int bPreserveDataBuffer);
     int          WriteEncodedStrip(uint32 strip, void* data, int bPreserveDataBuffer);
+    int          GetStripWriteSize(uint32 strip);
 
     GTiffDataset* poMaskDS;
     GTiffDataset* poBaseDS;
@@ -176,7 +201,7 @@ class GTiffDataset : public GDALPamDataset
     int          bFillEmptyTiles;
     void         FillEmptyTiles(void);
 
-    void         FlushDirectory();
+    CPLErr       FlushDirectory();
     CPLErr       CleanOverviews();
 
     /* Used for the all-in-on-strip case */
@@ -241,6 +266,28 @@ class GTiffDataset : public GDALPamDataset
                               GDALDataType eType, char **papszParmList );
 
     CPLErr   WriteEncodedTileOrStrip(uint32 tile_or_strip, void* data, int bPreserveDataBuffer);
+
+    /* Deferred compression of tiles/strips by a pool of threads */
+    int          nCompressionThreads;
+    int          nCompressionJobs;
+    GTiffCompressionJob *pasCompressionJobs;
+
+    int          CanQueueCompressionJob( uint32 tile_or_strip,
+                                         int *pbErrOccurred );
+    CPLErr       QueueCompressionJob( uint32 tile_or_strip, void* data );
+    CPLErr       FlushCompressionJobs();
+
+    /* Decoding of the blocks of a RasterIO() request by a pool of threads */
+    TIFF       **OpenDecodeTIFFs( int nThreads );
+    static void  CloseDecodeTIFFs( TIFF **pahDecodeTIFF, int nThreads );
+    void         CacheMultiBlocks( int nXOff, int nYOff, int nXSize, int nYSize,
+                                   int nBufXSize, int nBufYSize,
+                                   int nBandCount, int *panBandMap );
+
+  protected:
+    virtual CPLErr IRasterIO( GDALRWFlag, int, int, int, int,
+                              void *, int, int, GDALDataType,
+                              int, int *, int, int, int );
 };
 
 /************************************************************************/
@@ -272,10 +319,14 @@ protected:
 public:
                    GTiffRasterBand( GTiffDataset *, int );
 
-    // should override RasterIO eventually.
-    
     virtual CPLErr IReadBlock( int, int, void * );
     virtual CPLErr IWriteBlock( int, int, void * ); 
+    virtual CPLErr IRasterIO( GDALRWFlag, int, int, int, int,
+                              void *, int, int, GDALDataType,
+                              int, int );
+
+    GDALRasterBlock *TryGetCachedBlock( int nXBlockOff, int nYBlockOff )
+        { return TryGetLockedBlockRef( nXBlockOff, nYBlockOff ); }
 
     virtual GDALColorInterp GetColorInterpretation();
     virtual GDALColorTable *GetColorTable();
@@ -517,8 +568,11 @@ CPLErr GTiffRasterBand::IReadBlock( int nBlockXOff, int nBlockYOff,
 /*      Handle the case of a strip or tile that doesn't exist yet.      */
 /*      Just set to zeros and return.                                   */
 /* -------------------------------------------------------------------- */
-    if( !poGDS->IsBlockAvailable(nBlockId) )
+    int bErrOccurred;
+    if( !poGDS->IsBlockAvailable(nBlockId, &bErrOccurred) )
     {
+        if( bErrOccurred )
+            return CE_Failure;
         NullBlock( pImage );
         return CE_None;
     }
@@ -741,6 +795,26 @@ CPLErr GTiffRasterBand::IReadBlock( int nBlockXOff, int nBlockYOff,
     return eErr;
 }
 
+/************************************************************************/
+/*                             IRasterIO()                              */
+/************************************************************************/
+
+CPLErr GTiffRasterBand::IRasterIO( GDALRWFlag eRWFlag,
+                                   int nXOff, int nYOff, int nXSize, int nYSize,
+                                   void * pData, int nBufXSize, int nBufYSize,
+                                   GDALDataType eBufType,
+                                   int nPixelSpace, int nLineSpace )
+
+{
+    if( eRWFlag == GF_Read )
+        poGDS->CacheMultiBlocks( nXOff, nYOff, nXSize, nYSize,
+                                 nBufXSize, nBufYSize, 1, &nBand );
+
+    return GDALPamRasterBand::IRasterIO( eRWFlag, nXOff, nYOff, nXSize, nYSize,
+                                         pData, nBufXSize, nBufYSize, eBufType,
+                                         nPixelSpace, nLineSpace );
+}
+
 /************************************************************************/
 /*                            IWriteBlock()                             */
 /************************************************************************/
@@ -1919,8 +1993,11 @@ CPLErr GTiffOddBitsBand::IReadBlock( int nBlockXOff, int nBlockYOff,
 /*	exist yet, but that we want to read.  Just set to zeros and	*/
 /*	return.								*/
 /* -------------------------------------------------------------------- */
-    if( !poGDS->IsBlockAvailable(nBlockId) )
+    int bErrOccurred;
+    if( !poGDS->IsBlockAvailable(nBlockId, &bErrOccurred) )
     {
+        if( bErrOccurred )
+            return CE_Failure;
         NullBlock( pImage );
         return CE_None;
     }
@@ -2423,6 +2500,10 @@ GTiffDataset::GTiffDataset()
     nLastBandRead = -1;
     bTreatAsSplit = FALSE;
     bTreatAsSplitBitmap = FALSE;
+
+    nCompressionThreads = 1;
+    nCompressionJobs = 0;
+    pasCompressionJobs = NULL;
 }
 
 /************************************************************************/
@@ -2506,6 +2587,9 @@ GTiffDataset::~GTiffDataset()
 
     CPLFree(pabyTempWriteBuffer);
 
+    CPLAssert( nCompressionJobs == 0 );
+    CPLFree( pasCompressionJobs );
+
     if( *ppoActiveDSRef == this )
         *ppoActiveDSRef = NULL;
 }
@@ -2523,6 +2607,9 @@ void GTiffDataset::FillEmptyTiles()
     if (!SetDirectory())
         return;
 
+    if( FlushCompressionJobs() != CE_None )
+        return;
+
 /* -------------------------------------------------------------------- */
 /*      How many blocks are there in this file?                         */
 /* -------------------------------------------------------------------- */
@@ -2594,11 +2681,10 @@ int GTiffDataset::WriteEncodedTile(uint32 tile, void* data,
 }
 
 /************************************************************************/
-/*                        WriteEncodedStrip()                           */
+/*                        GetStripWriteSize()                           */
 /************************************************************************/
 
-int  GTiffDataset::WriteEncodedStrip(uint32 strip, void* data,
-                                     int bPreserveDataBuffer)
+int GTiffDataset::GetStripWriteSize(uint32 strip)
 {
     int cc = TIFFStripSize( hTIFF );
     
@@ -2617,6 +2703,18 @@ int  GTiffDataset::WriteEncodedStrip(uint32 strip, void* data,
                   (int) TIFFStripSize(hTIFF), cc );
     }
 
+    return cc;
+}
+
+/************************************************************************/
+/*                        WriteEncodedStrip()                           */
+/************************************************************************/
+
+int  GTiffDataset::WriteEncodedStrip(uint32 strip, void* data,
+                                     int bPreserveDataBuffer)
+{
+    int cc = GetStripWriteSize( strip );
+
 /* -------------------------------------------------------------------- */
 /*      TIFFWriteEncodedStrip can alter the passed buffer if            */
 /*      byte-swapping is necessary so we use a temporary buffer         */
@@ -2645,6 +2743,16 @@ CPLErr  GTiffDataset::WriteEncodedTileOrStrip(uint32 tile_or_strip, void* data,
 {
     CPLErr eErr = CE_None;
 
+    if( nCompressionThreads > 1 )
+    {
+        int bErrOccurred;
+
+        if( CanQueueCompressionJob( tile_or_strip, &bErrOccurred ) )
+            return QueueCompressionJob( tile_or_strip, data );
+        if( bErrOccurred )
+            return CE_Failure;
+    }
+
     if( TIFFIsTiled( hTIFF ) )
     {
         if( WriteEncodedTile(tile_or_strip, data, bPreserveDataBuffer) == -1 )
@@ -2663,6 +2771,676 @@ CPLErr  GTiffDataset::WriteEncodedTileOrStrip(uint32 tile_or_strip, void* data,
     return eErr;
 }
 
+/************************************************************************/
+/*                       CanQueueCompressionJob()                       */
+/*                                                                      */
+/*      Only fresh blocks of codecs without state shared between        */
+/*      blocks can be compressed out of order.  Rewritten blocks go     */
+/*      through libtiff as usual so that its in place rewriting         */
+/*      logic is preserved.  *pbErrOccurred is set if writing out the   */
+/*      queue failed.                                                   */
+/************************************************************************/
+
+int GTiffDataset::CanQueueCompressionJob( uint32 tile_or_strip,
+                                          int *pbErrOccurred )
+
+{
+    *pbErrOccurred = FALSE;
+
+    if( nCompression != COMPRESSION_LZW
+        && nCompression != COMPRESSION_ADOBE_DEFLATE
+        && nCompression != COMPRESSION_DEFLATE
+        && nCompression != COMPRESSION_PACKBITS )
+        return FALSE;
+
+/* -------------------------------------------------------------------- */
+/*      If the block is already queued, write the queue out first so    */
+/*      the new version goes on top of the old one.                     */
+/* -------------------------------------------------------------------- */
+    int iJob;
+
+    for( iJob = 0; iJob < nCompressionJobs; iJob++ )
+    {
+        if( pasCompressionJobs[iJob].nBlockId == (int) tile_or_strip )
+        {
+            if( FlushCompressionJobs() != CE_None )
+            {
+                *pbErrOccurred = TRUE;
+                return FALSE;
+            }
+            break;
+        }
+    }
+
+    toff_t *panByteCounts = NULL;
+
+    if( TIFFIsTiled( hTIFF ) )
+        TIFFGetField( hTIFF, TIFFTAG_TILEBYTECOUNTS, &panByteCounts );
+    else
+        TIFFGetField( hTIFF, TIFFTAG_STRIPBYTECOUNTS, &panByteCounts );
+
+    return panByteCounts != NULL && panByteCounts[tile_or_strip] == 0;
+}
+
+/************************************************************************/
+/*                        QueueCompressionJob()                         */
+/************************************************************************/
+
+CPLErr GTiffDataset::QueueCompressionJob( uint32 tile_or_strip, void* data )
+
+{
+    int nRows, cc;
+
+    if( TIFFIsTiled( hTIFF ) )
+    {
+        nRows = nBlockYSize;
+        cc = TIFFTileSize( hTIFF );
+    }
+    else
+    {
+        int nRowBytes = TIFFScanlineSize( hTIFF );
+
+        cc = GetStripWriteSize( tile_or_strip );
+        nRows = (cc + nRowBytes - 1) / nRowBytes;
+    }
+
+    GByte *pabyData = (GByte *) VSIMalloc( cc );
+    if( pabyData == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "Cannot allocate %d bytes", cc );
+        return CE_Failure;
+    }
+    memcpy( pabyData, data, cc );
+
+    if( pasCompressionJobs == NULL )
+        pasCompressionJobs = (GTiffCompressionJob *)
+            CPLCalloc( nCompressionThreads * 4, sizeof(GTiffCompressionJob) );
+
+    GTiffCompressionJob *psJob = pasCompressionJobs + nCompressionJobs++;
+
+    psJob->nBlockId = tile_or_strip;
+    psJob->nRows = nRows;
+    psJob->pabyData = pabyData;
+    psJob->nDataSize = cc;
+    psJob->pabyCompressed = NULL;
+    psJob->nCompressedSize = 0;
+    psJob->bSuccess = FALSE;
+
+    if( nCompressionJobs == nCompressionThreads * 4 )
+        return FlushCompressionJobs();
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                          GTiffCompressJob()                          */
+/*                                                                      */
+/*      Compress one block by writing it as the only block of a         */
+/*      temporary in-memory TIFF with the same encoding parameters      */
+/*      as the target file, and pick the compressed bytes from there.   */
+/************************************************************************/
+
+typedef struct
+{
+    GTiffCompressionJob *pasJobs;
+    int         bTiled;
+    int         bBigEndian;
+    uint32      nWidth;         /* tile width, or image width for strips */
+    uint32      nTileHeight;
+    uint16      nSamplesPerPixel;
+    uint16      nBitsPerSample;
+    uint16      nSampleFormat;
+    uint16      nCompression;
+    uint16      nPredictor;
+    int         nZLevel;
+} GTiffCompressionContext;
+
+static int GTiffCompressJob( void *pUserData, int iJob )
+
+{
+    GTiffCompressionContext *psContext = (GTiffCompressionContext *) pUserData;
+    GTiffCompressionJob *psJob = psContext->pasJobs + iJob;
+    CPLString osTmpFilename;
+
+    osTmpFilename.Printf( "/vsimem/gtiff_compress_%p_%d.tif", 
+                          psContext, iJob );
+
+    TIFF *hTIFFTmp = VSI_TIFFOpen( osTmpFilename, 
+                                   psContext->bBigEndian ? "wb" : "wl" );
+    if( hTIFFTmp == NULL )
+        return TRUE;
+
+    TIFFSetField( hTIFFTmp, TIFFTAG_IMAGEWIDTH, psContext->nWidth );
+    TIFFSetField( hTIFFTmp, TIFFTAG_SAMPLESPERPIXEL, 
+                  psContext->nSamplesPerPixel );
+    TIFFSetField( hTIFFTmp, TIFFTAG_BITSPERSAMPLE, psContext->nBitsPerSample );
+    TIFFSetField( hTIFFTmp, TIFFTAG_SAMPLEFORMAT, psContext->nSampleFormat );
+    TIFFSetField( hTIFFTmp, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG );
+    TIFFSetField( hTIFFTmp, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK );
+    if( psContext->bTiled )
+    {
+        TIFFSetField( hTIFFTmp, TIFFTAG_IMAGELENGTH, psContext->nTileHeight );
+        TIFFSetField( hTIFFTmp, TIFFTAG_TILEWIDTH, psContext->nWidth );
+        TIFFSetField( hTIFFTmp, TIFFTAG_TILELENGTH, psContext->nTileHeight );
+    }
+    else
+    {
+        TIFFSetField( hTIFFTmp, TIFFTAG_IMAGELENGTH, psJob->nRows );
+        TIFFSetField( hTIFFTmp, TIFFTAG_ROWSPERSTRIP, psJob->nRows );
+    }
+    TIFFSetField( hTIFFTmp, TIFFTAG_COMPRESSION, psContext->nCompression );
+    if( psContext->nPredictor > 1 )
+        TIFFSetField( hTIFFTmp, TIFFTAG_PREDICTOR, psContext->nPredictor );
+    if( psContext->nZLevel > 0 )
+        TIFFSetField( hTIFFTmp, TIFFTAG_ZIPQUALITY, psContext->nZLevel );
+
+    int nWritten;
+    toff_t *panOffsets = NULL, *panByteCounts = NULL;
+
+    if( psContext->bTiled )
+    {
+        nWritten = TIFFWriteEncodedTile( hTIFFTmp, 0, psJob->pabyData, 
+                                         psJob->nDataSize );
+        TIFFGetField( hTIFFTmp, TIFFTAG_TILEOFFSETS, &panOffsets );
+        TIFFGetField( hTIFFTmp, TIFFTAG_TILEBYTECOUNTS, &panByteCounts );
+    }
+    else
+    {
+        nWritten = TIFFWriteEncodedStrip( hTIFFTmp, 0, psJob->pabyData, 
+                                          psJob->nDataSize );
+        TIFFGetField( hTIFFTmp, TIFFTAG_STRIPOFFSETS, &panOffsets );
+        TIFFGetField( hTIFFTmp, TIFFTAG_STRIPBYTECOUNTS, &panByteCounts );
+    }
+
+    vsi_l_offset nFileSize = 0;
+    GByte *pabyFile = VSIGetMemFileBuffer( osTmpFilename, &nFileSize, FALSE );
+
+    if( nWritten == psJob->nDataSize && panOffsets != NULL 
+        && panByteCounts != NULL && pabyFile != NULL
+        && panOffsets[0] + panByteCounts[0] <= nFileSize )
+    {
+        psJob->nCompressedSize = (int) panByteCounts[0];
+        psJob->pabyCompressed = (GByte *) 
+            VSIMalloc( MAX(1, psJob->nCompressedSize) );
+        if( psJob->pabyCompressed != NULL )
+        {
+            memcpy( psJob->pabyCompressed, pabyFile + panOffsets[0], 
+                    psJob->nCompressedSize );
+            psJob->bSuccess = TRUE;
+        }
+    }
+
+    XTIFFClose( hTIFFTmp );
+    VSIUnlink( osTmpFilename );
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                        FlushCompressionJobs()                        */
+/*                                                                      */
+/*      Compress the queued blocks on several threads, then append      */
+/*      them to the file in the order they were queued, which gives     */
+/*      the same file as writing them one at a time.                    */
+/************************************************************************/
+
+CPLErr GTiffDataset::FlushCompressionJobs()
+
+{
+    CPLErr eErr = CE_None;
+    int    iJob;
+
+    if( nCompressionJobs == 0 )
+        return CE_None;
+
+    GTiffCompressionContext sContext;
+    uint16 nPredictor = 1;
+
+    sContext.pasJobs = pasCompressionJobs;
+    sContext.bTiled = TIFFIsTiled( hTIFF );
+    sContext.bBigEndian = TIFFIsBigEndian( hTIFF );
+    sContext.nWidth = sContext.bTiled ? nBlockXSize : (uint32) nRasterXSize;
+    sContext.nTileHeight = nBlockYSize;
+    sContext.nSamplesPerPixel = 
+        nPlanarConfig == PLANARCONFIG_SEPARATE ? 1 : nSamplesPerPixel;
+    sContext.nBitsPerSample = nBitsPerSample;
+    sContext.nSampleFormat = nSampleFormat;
+    sContext.nCompression = nCompression;
+    sContext.nZLevel = -1;
+    if( !TIFFGetField( hTIFF, TIFFTAG_PREDICTOR, &nPredictor ) )
+        nPredictor = 1;
+    sContext.nPredictor = nPredictor;
+    if( nCompression == COMPRESSION_ADOBE_DEFLATE
+        || nCompression == COMPRESSION_DEFLATE )
+        TIFFGetField( hTIFF, TIFFTAG_ZIPQUALITY, &(sContext.nZLevel) );
+
+    CPLRunJobs( nCompressionJobs, nCompressionThreads, 
+                GTiffCompressJob, &sContext );
+
+/* -------------------------------------------------------------------- */
+/*      Append the compressed blocks in submission order.               */
+/* -------------------------------------------------------------------- */
+    for( iJob = 0; iJob < nCompressionJobs; iJob++ )
+    {
+        GTiffCompressionJob *psJob = pasCompressionJobs + iJob;
+
+        if( !psJob->bSuccess )
+        {
+            if( eErr == CE_None )
+                CPLError( CE_Failure, CPLE_AppDefined,
+                          "Compression of block %d failed.", 
+                          psJob->nBlockId );
+            eErr = CE_Failure;
+        }
+        else if( eErr == CE_None && psJob->nCompressedSize > 0 )
+        {
+            int nRet;
+
+            if( sContext.bTiled )
+                nRet = TIFFWriteRawTile( hTIFF, psJob->nBlockId, 
+                                         psJob->pabyCompressed, 
+                                         psJob->nCompressedSize );
+            else
+                nRet = TIFFWriteRawStrip( hTIFF, psJob->nBlockId, 
+                                          psJob->pabyCompressed, 
+                                          psJob->nCompressedSize );
+            if( nRet == -1 )
+            {
+                CPLError( CE_Failure, CPLE_AppDefined,
+                          "WriteRawTile/Strip() failed." );
+                eErr = CE_Failure;
+            }
+        }
+
+        CPLFree( psJob->pabyData );
+        CPLFree( psJob->pabyCompressed );
+    }
+
+    nCompressionJobs = 0;
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                             IRasterIO()                              */
+/************************************************************************/
+
+CPLErr GTiffDataset::IRasterIO( GDALRWFlag eRWFlag,
+                                int nXOff, int nYOff, int nXSize, int nYSize,
+                                void * pData, int nBufXSize, int nBufYSize,
+                                GDALDataType eBufType, 
+                                int nBandCount, int *panBandMap,
+                                int nPixelSpace, int nLineSpace, int nBandSpace)
+
+{
+    if( eRWFlag == GF_Read )
+        CacheMultiBlocks( nXOff, nYOff, nXSize, nYSize, nBufXSize, nBufYSize,
+                          nBandCount, panBandMap );
+
+    return GDALPamDataset::IRasterIO( eRWFlag, nXOff, nYOff, nXSize, nYSize,
+                                      pData, nBufXSize, nBufYSize, eBufType,
+                                      nBandCount, panBandMap,
+                                      nPixelSpace, nLineSpace, nBandSpace );
+}
+
+/************************************************************************/
+/*                          OpenDecodeTIFFs()                           */
+/*                                                                      */
+/*      Open nThreads extra read-only handles on our directory, so      */
+/*      that several blocks can be decoded at once.  They are only      */
+/*      kept for the duration of one request, so that idle datasets     */
+/*      and their overviews do not hold file handles and libtiff        */
+/*      states per thread.                                              */
+/************************************************************************/
+
+TIFF **GTiffDataset::OpenDecodeTIFFs( int nThreads )
+
+{
+    const char *pszFilename = 
+        poBaseDS != NULL ? poBaseDS->osFilename.c_str() : osFilename.c_str();
+    int nColorMode = -1;
+
+    if( nCompression == COMPRESSION_JPEG )
+        TIFFGetField( hTIFF, TIFFTAG_JPEGCOLORMODE, &nColorMode );
+
+    TIFF **pahDecodeTIFF = (TIFF **) CPLCalloc( sizeof(TIFF*), nThreads );
+
+    for( int iTIFF = 0; iTIFF < nThreads; iTIFF++ )
+    {
+        TIFF *hDecodeTIFF = VSI_TIFFOpen( pszFilename, "r" );
+
+        if( hDecodeTIFF == NULL )
+        {
+            CloseDecodeTIFFs( pahDecodeTIFF, iTIFF );
+            return NULL;
+        }
+
+        pahDecodeTIFF[iTIFF] = hDecodeTIFF;
+
+        if( TIFFCurrentDirOffset( hDecodeTIFF ) != nDirOffset
+            && !TIFFSetSubDirectory( hDecodeTIFF, nDirOffset ) )
+        {
+            CloseDecodeTIFFs( pahDecodeTIFF, iTIFF + 1 );
+            return NULL;
+        }
+
+        /* Same on the fly YCbCr to RGB translation as hTIFF */
+        if( nColorMode == JPEGCOLORMODE_RGB )
+            TIFFSetField( hDecodeTIFF, TIFFTAG_JPEGCOLORMODE, nColorMode );
+    }
+
+    return pahDecodeTIFF;
+}
+
+/************************************************************************/
+/*                          CloseDecodeTIFFs()                          */
+/************************************************************************/
+
+void GTiffDataset::CloseDecodeTIFFs( TIFF **pahDecodeTIFF, int nThreads )
+
+{
+    for( int iTIFF = 0; iTIFF < nThreads; iTIFF++ )
+        XTIFFClose( pahDecodeTIFF[iTIFF] );
+    CPLFree( pahDecodeTIFF );
+}
+
+/************************************************************************/
+/*                           GTiffDecodeJob()                           */
+/*                                                                      */
+/*      Worker iThread decodes the pending blocks with its own TIFF     */
+/*      handle, straight into the block cache buffers.                  */
+/************************************************************************/
+
+typedef struct
+{
+    TIFF      **pahTIFF;
+    GTiffDecodeJob *pasJobs;
+    int         nJobCount;
+    volatile int nNextJob;
+    int         bTiled;
+    int         nBlockBufSize;
+    int         nBlockPixels;
+    int         nBands;         /* bands decoded together (pixel interleaving) */
+    int         nWordBytes;
+} GTiffDecodeContext;
+
+static int GTiffDecodeBlocks( void *pUserData, int iThread )
+
+{
+    GTiffDecodeContext *psContext = (GTiffDecodeContext *) pUserData;
+    TIFF   *hTIFF = psContext->pahTIFF[iThread];
+    GByte  *pabyInterleaved = NULL;
+    int     iJob;
+
+    if( psContext->nBands > 1 )
+    {
+        pabyInterleaved = (GByte *) VSIMalloc( psContext->nBlockBufSize );
+        if( pabyInterleaved == NULL )
+            return TRUE;
+    }
+
+    /* Failed blocks are read again, and reported, by IReadBlock() */
+    CPLPushErrorHandler( CPLQuietErrorHandler );
+
+    while( (iJob = CPLAtomicInc( &(psContext->nNextJob) ) - 1) 
+           < psContext->nJobCount )
+    {
+        GTiffDecodeJob *psJob = psContext->pasJobs + iJob;
+        GByte *pabyDest;
+        int    nRet;
+
+        if( pabyInterleaved != NULL )
+            pabyDest = pabyInterleaved;
+        else
+            pabyDest = (GByte *) psJob->papoBlocks[0]->GetDataRef();
+
+        if( psJob->nBlockReqSize < psContext->nBlockBufSize )
+            memset( pabyDest, 0, psContext->nBlockBufSize );
+
+        if( psContext->bTiled )
+            nRet = TIFFReadEncodedTile( hTIFF, psJob->nBlockId, pabyDest,
+                                        psJob->nBlockReqSize );
+        else
+            nRet = TIFFReadEncodedStrip( hTIFF, psJob->nBlockId, pabyDest,
+                                         psJob->nBlockReqSize );
+        if( nRet == -1 )
+            continue;
+
+/* -------------------------------------------------------------------- */
+/*      Split pixel interleaved data over the band blocks.              */
+/* -------------------------------------------------------------------- */
+        if( pabyInterleaved != NULL )
+        {
+            int nWordBytes = psContext->nWordBytes;
+            int nPixelBytes = psContext->nBands * nWordBytes;
+            int iBand, i;
+
+            for( iBand = 0; iBand < psContext->nBands; iBand++ )
+            {
+                if( psJob->papoBlocks[iBand] == NULL )
+                    continue;
+
+                GByte *pabySrc = pabyInterleaved + iBand * nWordBytes;
+                GByte *pabyBlock = (GByte *) 
+                    psJob->papoBlocks[iBand]->GetDataRef();
+
+                if( nWordBytes == 1 )
+                {
+                    for( i = 0; i < psContext->nBlockPixels; i++ )
+                        pabyBlock[i] = pabySrc[i * nPixelBytes];
+                }
+                else
+                {
+                    for( i = 0; i < psContext->nBlockPixels; i++ )
+                        memcpy( pabyBlock + i * nWordBytes, 
+                                pabySrc + i * nPixelBytes, nWordBytes );
+                }
+            }
+        }
+
+        psJob->bSuccess = TRUE;
+    }
+
+    CPLPopErrorHandler();
+    VSIFree( pabyInterleaved );
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                          CacheMultiBlocks()                          */
+/*                                                                      */
+/*      When GDAL_NUM_THREADS allows it, decode the compressed blocks   */
+/*      of a read request that are not in the block cache yet on        */
+/*      several threads, and push them into the cache.  The actual      */
+/*      request is then served from the cache as usual.                 */
+/************************************************************************/
+
+void GTiffDataset::CacheMultiBlocks( int nXOff, int nYOff, 
+                                     int nXSize, int nYSize,
+                                     int nBufXSize, int nBufYSize,
+                                     int nBandCount, int *panBandMap )
+
+{
+    int nThreads = 
+        CPLParseNumThreads( CPLGetConfigOption( "GDAL_NUM_THREADS", NULL ), 1 );
+
+    if( nThreads < 2 || eAccess != GA_ReadOnly || nBands == 0
+        || nCompression == COMPRESSION_NONE
+        || bTreatAsRGBA || bTreatAsSplit || bTreatAsSplitBitmap
+        || (nBitsPerSample % 8) != 0 
+        || GDALGetDataTypeSize( GetRasterBand(1)->GetRasterDataType() ) 
+           != nBitsPerSample )
+        return;
+
+/* -------------------------------------------------------------------- */
+/*      Downsampled requests will likely be served from overviews.      */
+/* -------------------------------------------------------------------- */
+    if( (nBufXSize < nXSize || nBufYSize < nYSize)
+        && GetRasterBand(1)->GetOverviewCount() > 0 )
+        return;
+
+    if( !SetDirectory() )
+        return;
+
+    int bTiled = TIFFIsTiled( hTIFF );
+    int nBlockBufSize = bTiled ? TIFFTileSize( hTIFF ) : TIFFStripSize( hTIFF );
+    int bInterleaved = nPlanarConfig == PLANARCONFIG_CONTIG && nBands > 1;
+    int nBlocksPerRow = (nRasterXSize + nBlockXSize - 1) / nBlockXSize;
+    int nXBlockStart = nXOff / nBlockXSize;
+    int nXBlockEnd = (nXOff + nXSize - 1) / nBlockXSize;
+    int nYBlockStart = nYOff / nBlockYSize;
+    int nYBlockEnd = (nYOff + nYSize - 1) / nBlockYSize;
+    int nMaxJobs = (nXBlockEnd - nXBlockStart + 1) 
+        * (nYBlockEnd - nYBlockStart + 1) * (bInterleaved ? 1 : nBandCount);
+    int nSlots = bInterleaved ? nBands : 1;
+
+    if( nMaxJobs < 2 )
+        return;
+
+/* -------------------------------------------------------------------- */
+/*      Don't bother if the blocks would not stay in the cache until    */
+/*      the request is served from it.                                  */
+/* -------------------------------------------------------------------- */
+    if( (double) nMaxJobs * nBlockBufSize > GDALGetCacheMax() / 2 )
+        return;
+
+/* -------------------------------------------------------------------- */
+/*      Collect the blocks that exist in the file but not in the        */
+/*      cache, and allocate their cache buffers.                        */
+/* -------------------------------------------------------------------- */
+    GTiffDecodeJob *pasJobs = (GTiffDecodeJob *)
+        CPLCalloc( nMaxJobs, sizeof(GTiffDecodeJob) );
+    GDALRasterBlock **papoBlocks = (GDALRasterBlock **)
+        CPLCalloc( nMaxJobs * nSlots, sizeof(GDALRasterBlock *) );
+    int nJobCount = 0, iBandIndex, iBlockX, iBlockY, iJob, iSlot;
+    int bErrOccurred = FALSE;
+
+    for( iBandIndex = 0; 
+         iBandIndex < (bInterleaved ? 1 : nBandCount) && !bErrOccurred; 
+         iBandIndex++ )
+    {
+        for( iBlockY = nYBlockStart; 
+             iBlockY <= nYBlockEnd && !bErrOccurred; iBlockY++ )
+        {
+            for( iBlockX = nXBlockStart; iBlockX <= nXBlockEnd; iBlockX++ )
+            {
+                GTiffDecodeJob *psJob = pasJobs + nJobCount;
+                int nBlockId = iBlockX + iBlockY * nBlocksPerRow;
+                int bNeeded = FALSE;
+
+                if( !bInterleaved && nPlanarConfig == PLANARCONFIG_SEPARATE )
+                    nBlockId += (panBandMap[iBandIndex] - 1) * nBlocksPerBand;
+
+                if( !IsBlockAvailable( nBlockId, &bErrOccurred ) )
+                {
+                    if( bErrOccurred )
+                        break;
+                    continue;
+                }
+
+                psJob->papoBlocks = papoBlocks + nJobCount * nSlots;
+
+                for( iSlot = 0; iSlot < nSlots; iSlot++ )
+                {
+                    GTiffRasterBand *poBand = (GTiffRasterBand *) 
+                        GetRasterBand( bInterleaved ? iSlot + 1 
+                                       : panBandMap[iBandIndex] );
+                    GDALRasterBlock *poBlock = 
+                        poBand->TryGetCachedBlock( iBlockX, iBlockY );
+
+                    if( poBlock != NULL )
+                    {
+                        poBlock->DropLock();
+                        continue;
+                    }
+
+                    poBlock = poBand->GetLockedBlockRef( iBlockX, iBlockY, 
+                                                         TRUE );
+                    if( poBlock == NULL )
+                        continue;
+
+                    psJob->papoBlocks[iSlot] = poBlock;
+                    bNeeded = TRUE;
+                }
+
+                if( !bNeeded )
+                    continue;
+
+/* -------------------------------------------------------------------- */
+/*      The bottom most partial blocks are sometimes only partially     */
+/*      encoded, so only request the valid part (#1179).                */
+/* -------------------------------------------------------------------- */
+                psJob->nBlockId = nBlockId;
+                psJob->nBlockXOff = iBlockX;
+                psJob->nBlockYOff = iBlockY;
+                psJob->nBlockReqSize = nBlockBufSize;
+                if( (iBlockY + 1) * (int) nBlockYSize > nRasterYSize )
+                    psJob->nBlockReqSize = (nBlockBufSize / nBlockYSize)
+                        * (nBlockYSize - (((iBlockY + 1) * nBlockYSize) 
+                                          % nRasterYSize));
+                nJobCount++;
+            }
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Decode, unless the block offsets could not be read, in which    */
+/*      case IReadBlock() reports the error.                            */
+/* -------------------------------------------------------------------- */
+    nThreads = MIN( nThreads, nJobCount );
+
+    TIFF **pahDecodeTIFF = NULL;
+
+    if( nThreads >= 2 && !bErrOccurred )
+        pahDecodeTIFF = OpenDecodeTIFFs( nThreads );
+
+    if( pahDecodeTIFF != NULL )
+    {
+        GTiffDecodeContext sContext;
+
+        sContext.pahTIFF = pahDecodeTIFF;
+        sContext.pasJobs = pasJobs;
+        sContext.nJobCount = nJobCount;
+        sContext.nNextJob = 0;
+        sContext.bTiled = bTiled;
+        sContext.nBlockBufSize = nBlockBufSize;
+        sContext.nBlockPixels = nBlockXSize * nBlockYSize;
+        sContext.nBands = nSlots;
+        sContext.nWordBytes = nBitsPerSample / 8;
+
+        CPLRunJobs( nThreads, nThreads, GTiffDecodeBlocks, &sContext );
+
+        CloseDecodeTIFFs( pahDecodeTIFF, nThreads );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Release the blocks.  Those that could not be decoded are        */
+/*      removed from the cache so that IReadBlock() deals with them.    */
+/* -------------------------------------------------------------------- */
+    for( iJob = 0; iJob < nJobCount; iJob++ )
+    {
+        GTiffDecodeJob *psJob = pasJobs + iJob;
+
+        for( iSlot = 0; iSlot < nSlots; iSlot++ )
+        {
+            GDALRasterBlock *poBlock = psJob->papoBlocks[iSlot];
+
+            if( poBlock == NULL )
+                continue;
+
+            poBlock->DropLock();
+            if( !psJob->bSuccess )
+                poBlock->GetBand()->FlushBlock( psJob->nBlockXOff, 
+                                                psJob->nBlockYOff );
+        }
+    }
+
+    CPLFree( papoBlocks );
+    CPLFree( pasJobs );
+}
+
 /************************************************************************/
 /*                           FlushBlockBuf()                            */
 /************************************************************************/
@@ -2779,8 +3557,11 @@ CPLErr GTiffDataset::LoadBlockBuf( int nBlockId, int bReadFromDisk )
 /*      doesn't yet exist on disk, just zero the memory buffer and      */
 /*      pretend we loaded it.                                           */
 /* -------------------------------------------------------------------- */
-    if( !IsBlockAvailable( nBlockId ) )
+    int bErrOccurred;
+    if( !IsBlockAvailable( nBlockId, &bErrOccurred ) )
     {
+        if( bErrOccurred )
+            return CE_Failure;
         memset( pabyBlockBuf, 0, nBlockBufSize );
         nLoadedBlock = nBlockId;
         return CE_None;
@@ -2879,13 +3660,26 @@ void GTiffDataset::Crystalize()
 /*      Return TRUE if the indicated strip/tile is available.  We       */
 /*      establish this by testing if the stripbytecount is zero.  If    */
 /*      zero then the block has never been committed to disk.           */
+/*      If pbErrOccurred is not NULL, it is set if writing out the      */
+/*      compression queue failed.                                       */
 /************************************************************************/
 
-int GTiffDataset::IsBlockAvailable( int nBlockId )
+int GTiffDataset::IsBlockAvailable( int nBlockId, int *pbErrOccurred )
 
 {
     toff_t *panByteCounts = NULL;
 
+    if( pbErrOccurred )
+        *pbErrOccurred = FALSE;
+
+    /* Blocks still in the compression queue have no byte count yet */
+    if( nCompressionJobs > 0 && FlushCompressionJobs() != CE_None )
+    {
+        if( pbErrOccurred )
+            *pbErrOccurred = TRUE;
+        return FALSE;
+    }
+
     if( ( TIFFIsTiled( hTIFF ) 
           && TIFFGetField( hTIFF, TIFFTAG_TILEBYTECOUNTS, &panByteCounts ) )
         || ( !TIFFIsTiled( hTIFF ) 
@@ -2929,15 +3723,19 @@ void GTiffDataset::FlushCache()
 /*                           FlushDirectory()                           */
 /************************************************************************/
 
-void GTiffDataset::FlushDirectory()
+CPLErr GTiffDataset::FlushDirectory()
 
 {
+    CPLErr eErr = CE_None;
+
     if( GetAccess() == GA_Update )
     {
+        eErr = FlushCompressionJobs();
+
         if( bMetadataChanged )
         {
             if (!SetDirectory())
-                return;
+                return CE_Failure;
             bNeedsRewrite = 
                 WriteMetadata( this, hTIFF, TRUE, osProfile, osFilename,
                                papszCreationOptions );
@@ -2947,7 +3745,7 @@ void GTiffDataset::FlushDirectory()
         if( bGeoTIFFInfoChanged )
         {
             if (!SetDirectory())
-                return;
+                return CE_Failure;
             WriteGeoTIFFInfo();
         }
 
@@ -2957,7 +3755,7 @@ void GTiffDataset::FlushDirectory()
 /* We need at least TIFF 3.7.0 for TIFFGetSizeProc and TIFFClientdata */
 #if  TIFFLIB_VERSION > 20041016
             if (!SetDirectory())
-                return;
+                return CE_Failure;
 
             TIFFSizeProc pfnSizeProc = TIFFGetSizeProc( hTIFF );
 
@@ -2970,7 +3768,7 @@ void GTiffDataset::FlushDirectory()
             TIFFSetSubDirectory( hTIFF, nDirOffset );
 #elif  TIFFLIB_VERSION > 20010925 && TIFFLIB_VERSION != 20011807
             if (!SetDirectory())
-                return;
+                return CE_Failure;
 
             TIFFRewriteDirectory( hTIFF );
 #endif
@@ -2984,6 +3782,8 @@ void GTiffDataset::FlushDirectory()
     // case we should not risk a flush. 
     if( TIFFCurrentDirOffset(hTIFF) == nDirOffset )
         TIFFFlush( hTIFF );
+
+    return eErr;
 }
 
 /************************************************************************/
@@ -3021,7 +3821,8 @@ CPLErr GTiffDataset::CleanOverviews()
 {
     CPLAssert( bBase );
 
-    FlushDirectory();
+    if( FlushDirectory() != CE_None )
+        return CE_Failure;
     *ppoActiveDSRef = NULL;
 
 /* -------------------------------------------------------------------- */
@@ -3168,7 +3969,8 @@ CPLErr GTiffDataset::IBuildOverviews(
 /* -------------------------------------------------------------------- */
     if (!SetDirectory())
         return CE_Failure;
-    FlushDirectory();
+    if( FlushDirectory() != CE_None )
+        return CE_Failure;
 
 /* -------------------------------------------------------------------- */
 /*      If we are averaging bit data to grayscale we need to create     */
@@ -3307,6 +4109,7 @@ CPLErr GTiffDataset::IBuildOverviews(
             }
             else
             {
+                poODS->nCompressionThreads = nCompressionThreads;
                 nOverviewCount++;
                 papoOverviewDS = (GTiffDataset **)
                     CPLRealloc(papoOverviewDS, 
@@ -4258,8 +5061,9 @@ int GTiffDataset::SetDirectory( toff_t nNewOffset )
         TIFFGetField(hTIFF, TIFFTAG_JPEGQUALITY, &jquality); 
         TIFFGetField(hTIFF, TIFFTAG_ZIPQUALITY, &zquality); 
 
-        if( *ppoActiveDSRef != NULL )
-            (*ppoActiveDSRef)->FlushDirectory();
+        if( *ppoActiveDSRef != NULL
+            && (*ppoActiveDSRef)->FlushDirectory() != CE_None )
+            return FALSE;
     }
     
     if( nNewOffset == 0)
@@ -4755,6 +5559,10 @@ CPLErr GTiffDataset::OpenOffset( TIFF *hTIFFIn,
 
     this->eAccess = eAccess;
 
+    if( eAccess == GA_Update )
+        nCompressionThreads = 
+            CPLParseNumThreads( CPLGetConfigOption( "GDAL_NUM_THREADS", NULL ), 1 );
+
 /* -------------------------------------------------------------------- */
 /*      Capture some information from the file that is of interest.     */
 /* -------------------------------------------------------------------- */
@@ -6333,6 +7141,11 @@ GDALDataset *GTiffDataset::Create( const char * pszFilename,
 /*      to decide if a TFW file should be written).                     */
 /* -------------------------------------------------------------------- */
     poDS->papszCreationOptions = CSLDuplicate( papszParmList );
+
+    const char *pszNumThreads = CSLFetchNameValue( papszParmList, "NUM_THREADS" );
+    if( pszNumThreads == NULL )
+        pszNumThreads = CPLGetConfigOption( "GDAL_NUM_THREADS", NULL );
+    poDS->nCompressionThreads = CPLParseNumThreads( pszNumThreads, 1 );
     
 /* -------------------------------------------------------------------- */
 /*      Create band information objects.                                */
@@ -6790,6 +7603,11 @@ GTiffDataset::CreateCopy( const char * pszFilename, GDALDataset *poSrcDS,
     poDS->CloneInfo( poSrcDS, GCIF_PAM_DEFAULT );
     poDS->papszCreationOptions = CSLDuplicate( papszOptions );
 
+    if( CSLFetchNameValue( papszOptions, "NUM_THREADS" ) != NULL
+        && poDS->GetAccess() == GA_Update )
+        poDS->nCompressionThreads = 
+            CPLParseNumThreads( CSLFetchNameValue( papszOptions, "NUM_THREADS" ), 1 );
+
 /* -------------------------------------------------------------------- */
 /*      CloneInfo() doesn't merge metadata, it just replaces it totally */
 /*      So we have to merge it                                          */
@@ -7612,6 +8430,7 @@ void GDALRegister_GTiff()
 "     <Value>IF_SAFER</Value>"
 "   </Option>"
 #endif
+"   <Option name='NUM_THREADS' type='string' description='Number of worker threads for LZW, DEFLATE or PACKBITS compression. Can be set to ALL_CPUS' default='1'/>"
 "   <Option name='ENDIANNESS' type='string-select' default='NATIVE' description='Force endianness of created file. For DEBUG purpose mostly'>"
 "       <Value>NATIVE</Value>"
 "       <Value>INVERTED</Value>"
@@ -33,6 +33,32 @@
 
 CPL_CVSID("$Id$");
 
+/************************************************************************/
+/*                            RawSwapWords()                            */
+/*                                                                      */
+/*      Byte swap nWordCount values of eDataType nStride bytes apart,   */
+/*      the two components of complex values being swapped              */
+/*      separately.                                                     */
+/************************************************************************/
+
+static void RawSwapWords( void *pData, GDALDataType eDataType,
+                          int nWordCount, int nStride )
+
+{
+    if( GDALDataTypeIsComplex( eDataType ) )
+    {
+        int nWordSize;
+
+        nWordSize = GDALGetDataTypeSize(eDataType)/16;
+        GDALSwapWords( pData, nWordSize, nWordCount, nStride );
+        GDALSwapWords( ((GByte *) pData)+nWordSize, 
+                       nWordSize, nWordCount, nStride );
+    }
+    else
+        GDALSwapWords( pData, GDALGetDataTypeSize(eDataType)/8,
+                       nWordCount, nStride );
+}
+
 /************************************************************************/
 /*                           RawRasterBand()                            */
 /************************************************************************/
@@ -171,6 +197,10 @@ void RawRasterBand::Initialize()
     papszCategoryNames = NULL;
 
     bDirty = FALSE;
+
+    bMappingTried = FALSE;
+    hMapping = NULL;
+    pabyMapping = NULL;
 }
 
 
@@ -187,6 +217,8 @@ RawRasterBand::~RawRasterBand()
     CSLDestroy( papszCategoryNames );
 
     FlushCache();
+
+    VSIFUnmapL( hMapping );
     
     if (bOwnsFP)
     {
@@ -339,6 +371,23 @@ CPLErr RawRasterBand::IReadBlock( int nBlockXOff, int nBlockYOff,
     if (pLineBuffer == NULL)
         return CE_Failure;
 
+/* -------------------------------------------------------------------- */
+/*      Copy straight from the mapped file, swapping in place.          */
+/* -------------------------------------------------------------------- */
+    if( IsMapped() )
+    {
+        int nWordSize = GDALGetDataTypeSize(eDataType)/8;
+
+        GDALCopyWords( pabyMapping + (size_t) nBlockYOff * nLineOffset,
+                       eDataType, nPixelOffset,
+                       pImage, eDataType, nWordSize, nBlockXSize );
+
+        if( !bNativeOrder && eDataType != GDT_Byte )
+            RawSwapWords( pImage, eDataType, nBlockXSize, nWordSize );
+
+        return CE_None;
+    }
+
     eErr = AccessLine( nBlockYOff );
     
 /* -------------------------------------------------------------------- */
@@ -546,6 +595,23 @@ CPLErr RawRasterBand::IRasterIO( GDALRWFlag eRWFlag,
     int         nBufDataSize = GDALGetDataTypeSize( eBufType ) / 8;
     int         nBytesToRW = nPixelOffset * nXSize;
 
+/* -------------------------------------------------------------------- */
+/*      Mapped files are read directly, without the block cache.        */
+/* -------------------------------------------------------------------- */
+    if( eRWFlag == GF_Read && IsMapped() )
+    {
+        if( (nBufXSize < nXSize || nBufYSize < nYSize)
+            && GetOverviewCount() > 0 
+            && OverviewRasterIO( eRWFlag, nXOff, nYOff, nXSize, nYSize, 
+                                 pData, nBufXSize, nBufYSize, 
+                                 eBufType, nPixelSpace, nLineSpace ) == CE_None )
+            return CE_None;
+
+        return MappedRasterIO( nXOff, nYOff, nXSize, nYSize,
+                               pData, nBufXSize, nBufYSize, eBufType,
+                               nPixelSpace, nLineSpace );
+    }
+
 /* -------------------------------------------------------------------- */
 /* Use direct IO without caching if:                                    */
 /*                                                                      */
@@ -890,6 +956,142 @@ CPLErr RawRasterBand::IRasterIO( GDALRWFlag eRWFlag,
     return CE_None;
 }
 
+/************************************************************************/
+/*                              IsMapped()                              */
+/*                                                                      */
+/*      With GDAL_RAW_MMAP=YES, a read-only band maps the region of     */
+/*      the file holding its pixels the first time it is read, and      */
+/*      reads from the mapping from then on.  This is not possible      */
+/*      for all files, in which case the band keeps reading through     */
+/*      its line buffer.                                                */
+/************************************************************************/
+
+int RawRasterBand::IsMapped()
+
+{
+    if( bMappingTried )
+        return pabyMapping != NULL;
+
+    bMappingTried = TRUE;
+
+    if( !bIsVSIL || eAccess != GA_ReadOnly 
+        || (poDS != NULL && poDS->GetAccess() != GA_ReadOnly)
+        || nPixelOffset <= 0 || nLineOffset <= 0 
+        || nRasterXSize <= 0 || nRasterYSize <= 0
+        || !CSLTestBoolean( CPLGetConfigOption( "GDAL_RAW_MMAP", "NO" ) ) )
+        return FALSE;
+
+/* -------------------------------------------------------------------- */
+/*      Map from the first byte of the first pixel to the last byte     */
+/*      of the last pixel.                                              */
+/* -------------------------------------------------------------------- */
+    vsi_l_offset nMapSize = 
+        (vsi_l_offset) (nRasterYSize - 1) * nLineOffset
+        + (vsi_l_offset) (nRasterXSize - 1) * nPixelOffset
+        + GDALGetDataTypeSize(eDataType) / 8;
+
+    if( (vsi_l_offset) (size_t) nMapSize != nMapSize )
+        return FALSE;
+
+    pabyMapping = (GByte *) 
+        VSIFMapL( fpRaw, nImgOffset, (size_t) nMapSize, &hMapping );
+
+    CPLDebug( "GDALRaw", "Mapping %lu bytes at %lu for band %d %s.",
+              (unsigned long) nMapSize, (unsigned long) nImgOffset, nBand,
+              pabyMapping != NULL ? "succeeded" : "failed" );
+
+    return pabyMapping != NULL;
+}
+
+/************************************************************************/
+/*                           MappedRasterIO()                           */
+/*                                                                      */
+/*      Read from the mapped file into the caller's buffer in one       */
+/*      copy, using the same pixel selection as the block based         */
+/*      GDALRasterBand::IRasterIO() when resampling.                    */
+/************************************************************************/
+
+CPLErr RawRasterBand::MappedRasterIO( int nXOff, int nYOff, 
+                                      int nXSize, int nYSize,
+                                      void * pData, 
+                                      int nBufXSize, int nBufYSize,
+                                      GDALDataType eBufType,
+                                      int nPixelSpace, int nLineSpace )
+
+{
+    int         nWordSize = GDALGetDataTypeSize(eDataType) / 8;
+    int         bSwap = !bNativeOrder && eDataType != GDT_Byte;
+    int         bResampleX = (nXSize != nBufXSize);
+    double      dfSrcXInc = nXSize / (double) nBufXSize;
+    double      dfSrcYInc = nYSize / (double) nBufYSize;
+    GByte      *pabyLine = NULL;
+    int        *panSrcOffset = NULL;
+    int         iLine, iPixel;
+
+/* -------------------------------------------------------------------- */
+/*      Go through a line of native order eDataType values when the     */
+/*      copy into the buffer can not select the pixels or swap them.    */
+/* -------------------------------------------------------------------- */
+    if( bResampleX || (bSwap && eBufType != eDataType) )
+    {
+        pabyLine = (GByte *) VSIMalloc2( nBufXSize, nWordSize );
+        if( bResampleX )
+            panSrcOffset = (int *) VSIMalloc2( nBufXSize, sizeof(int) );
+
+        if( pabyLine == NULL || (bResampleX && panSrcOffset == NULL) )
+        {
+            CPLError( CE_Failure, CPLE_OutOfMemory,
+                      "Out of memory in RawRasterBand::MappedRasterIO()." );
+            CPLFree( pabyLine );
+            CPLFree( panSrcOffset );
+            return CE_Failure;
+        }
+
+        for( iPixel = 0; bResampleX && iPixel < nBufXSize; iPixel++ )
+            panSrcOffset[iPixel] = 
+                ((int) ((iPixel + 0.5) * dfSrcXInc + nXOff)) * nPixelOffset;
+    }
+
+    for( iLine = 0; iLine < nBufYSize; iLine++ )
+    {
+        int     iSrcY = (int) ((iLine + 0.5) * dfSrcYInc + nYOff);
+        GByte  *pabySrc = pabyMapping + (size_t) iSrcY * nLineOffset;
+        GByte  *pabyDst = ((GByte *) pData) + (size_t) iLine * nLineSpace;
+
+        if( pabyLine == NULL )
+        {
+            GDALCopyWords( pabySrc + (size_t) nXOff * nPixelOffset,
+                           eDataType, nPixelOffset,
+                           pabyDst, eBufType, nPixelSpace, nBufXSize );
+            if( bSwap )
+                RawSwapWords( pabyDst, eDataType, nBufXSize, nPixelSpace );
+            continue;
+        }
+
+        if( bResampleX )
+        {
+            for( iPixel = 0; iPixel < nBufXSize; iPixel++ )
+                memcpy( pabyLine + iPixel * nWordSize, 
+                        pabySrc + panSrcOffset[iPixel], nWordSize );
+        }
+        else
+            GDALCopyWords( pabySrc + (size_t) nXOff * nPixelOffset,
+                           eDataType, nPixelOffset,
+                           pabyLine, eDataType, nWordSize, nBufXSize );
+
+        if( bSwap )
+            RawSwapWords( pabyLine, eDataType, nBufXSize, nWordSize );
+
+        GDALCopyWords( pabyLine, eDataType, nWordSize,
+                       pabyDst, eBufType, nPixelSpace, nBufXSize );
+    }
+
+    CPLFree( pabyLine );
+    CPLFree( panSrcOffset );
+
+    return CE_None;
+}
+
 /************************************************************************/
 /*                                Seek()                                */
 /************************************************************************/
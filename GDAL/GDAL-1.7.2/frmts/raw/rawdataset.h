@@ -94,6 +94,10 @@ protected:
     
     int         bOwnsFP;
 
+    int         bMappingTried;
+    void       *hMapping;
+    GByte      *pabyMapping;
+
     int         Seek( vsi_l_offset, int );
     size_t      Read( void *, size_t, size_t );
     size_t      Write( void *, size_t, size_t );
@@ -103,6 +107,11 @@ protected:
     int         IsLineLoaded( int nLineOff, int nLines );
     void        Initialize();
 
+    int         IsMapped();
+    CPLErr      MappedRasterIO( int, int, int, int,
+                                void *, int, int, GDALDataType,
+                                int, int );
+
     virtual CPLErr  IRasterIO( GDALRWFlag, int, int, int, int,
                               void *, int, int, GDALDataType,
                               int, int );
@@ -42,9 +42,20 @@ CPLXMLNode *VRTSerializeMetadata( GDALMajorObject * );
 /*                              VRTSource                               */
 /************************************************************************/
 
+class VRTSourcedRasterBand;
+
 class VRTSource 
 {
+    friend class VRTSourcedRasterBand;
+
+    /* band the source was added to, told when the window changes */
+    VRTSourcedRasterBand *poOwnerBand;
+
+protected:
+    void            DstWindowChanged();
+
 public:
+                    VRTSource();
     virtual ~VRTSource();
 
     virtual CPLErr  RasterIO( int nXOff, int nYOff, int nXSize, int nYSize, 
@@ -57,6 +68,9 @@ public:
     
     virtual void   GetFileList(char*** ppapszFileList, int *pnSize,
                                int *pnMaxSize, CPLHashSet* hSetFiles);
+
+    virtual int    GetDstWindow( int *pnXOff, int *pnYOff, 
+                                 int *pnXSize, int *pnYSize );
 };
 
 typedef VRTSource *(*VRTSourceParser)(CPLXMLNode *, const char *);
@@ -249,12 +263,23 @@ class CPL_DLL VRTRasterBand : public GDALRasterBand
 /*                         VRTSourcedRasterBand                         */
 /************************************************************************/
 
+struct VRTSourceIndex;
+
 class CPL_DLL VRTSourcedRasterBand : public VRTRasterBand
 {
+    friend class VRTSource;
+
     int            bAlreadyInIRasterIO;
     
     void           Initialize( int nXSize, int nYSize );
 
+    VRTSourceIndex *psSourceIndex;
+
+    void           BuildSourceIndex();
+    void           InvalidateSourceIndex();
+    int            QuerySourceIndex( int nXOff, int nYOff, 
+                                     int nXSize, int nYSize );
+
   public:
     int            nSources;
     VRTSource    **papoSources;
@@ -458,6 +483,8 @@ public:
     void           SetSrcWindow( int, int, int, int );
     void           SetDstWindow( int, int, int, int );
     void           SetNoDataValue( double dfNoDataValue );
+    virtual int    GetDstWindow( int *pnXOff, int *pnYOff, 
+                                 int *pnXSize, int *pnYSize );
 
     int            GetSrcDstWindow( int, int, int, int, int, int, 
                                     int *, int *, int *, int *,
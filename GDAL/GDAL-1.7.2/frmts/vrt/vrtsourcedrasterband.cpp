@@ -33,6 +33,49 @@
 
 CPL_CVSID("$Id$");
 
+/* Bands with fewer sources than this just visit all of them. */
+#define VRT_MIN_SOURCES_FOR_INDEX  16
+
+/* Sources spanning more cells than this are visited by every request. */
+#define VRT_MAX_CELLS_PER_SOURCE   16
+
+/************************************************************************/
+/*                            VRTSourceIndex                            */
+/*                                                                      */
+/*      Uniform grid over the band, listing for each cell the sources   */
+/*      whose destination window touches it, in increasing source       */
+/*      order.  Sources with an unknown or very large destination       */
+/*      window are kept in a separate list visited by all requests.     */
+/************************************************************************/
+
+struct VRTSourceIndex
+{
+    int         nCellXSize;
+    int         nCellYSize;
+    int         nCellsX;
+    int         nCellsY;
+
+    int        *panCellStart;     /* nCellsX*nCellsY+1 offsets */
+    int        *panCellSources;
+
+    int         nGlobalSources;
+    int        *panGlobalSources;
+
+    int        *panSourceStamp;   /* last query that collected each source */
+    int         nStamp;
+    int        *panQuerySources;  /* result of QuerySourceIndex() */
+};
+
+/************************************************************************/
+/*                         VRTCompareSourceNo()                         */
+/************************************************************************/
+
+static int VRTCompareSourceNo( const void *pA, const void *pB )
+
+{
+    return *((const int *) pA) - *((const int *) pB);
+}
+
 /************************************************************************/
 /* ==================================================================== */
 /*                          VRTSourcedRasterBand                        */
@@ -95,6 +138,7 @@ void VRTSourcedRasterBand::Initialize( int nXSize, int nYSize )
     papoSources = NULL;
     bEqualAreas = FALSE;
     bAlreadyInIRasterIO = FALSE;
+    psSourceIndex = NULL;
 }
 
 /************************************************************************/
@@ -109,6 +153,276 @@ VRTSourcedRasterBand::~VRTSourcedRasterBand()
 
     CPLFree( papoSources );
     nSources = 0;
+
+    InvalidateSourceIndex();
+}
+
+/************************************************************************/
+/*                       InvalidateSourceIndex()                        */
+/************************************************************************/
+
+void VRTSourcedRasterBand::InvalidateSourceIndex()
+
+{
+    if( psSourceIndex == NULL )
+        return;
+
+    CPLFree( psSourceIndex->panCellStart );
+    CPLFree( psSourceIndex->panCellSources );
+    CPLFree( psSourceIndex->panGlobalSources );
+    CPLFree( psSourceIndex->panSourceStamp );
+    CPLFree( psSourceIndex->panQuerySources );
+    CPLFree( psSourceIndex );
+    psSourceIndex = NULL;
+}
+
+/************************************************************************/
+/*                          BuildSourceIndex()                          */
+/*                                                                      */
+/*      Build the grid index of the source destination windows.  The   */
+/*      cells are about the average size of a source window, so a      */
+/*      mosaic of N similar tiles gives a grid of about N cells with    */
+/*      a few sources each.  On failure psSourceIndex stays NULL and    */
+/*      IRasterIO() visits all the sources.                             */
+/************************************************************************/
+
+void VRTSourcedRasterBand::BuildSourceIndex()
+
+{
+    int  iSource, nXOff, nYOff, nXSize, nYSize;
+    int  *panFirstCell, *panLastCell;
+    double dfSumXSize = 0.0, dfSumYSize = 0.0;
+    int  nWindows = 0;
+
+    InvalidateSourceIndex();
+
+    if( nSources == 0 || nRasterXSize <= 0 || nRasterYSize <= 0 )
+        return;
+
+/* -------------------------------------------------------------------- */
+/*      Pick the cell size from the average source window size,         */
+/*      growing it if needed so the grid is not much larger than the    */
+/*      source list.                                                    */
+/* -------------------------------------------------------------------- */
+    for( iSource = 0; iSource < nSources; iSource++ )
+    {
+        if( papoSources[iSource]->GetDstWindow( &nXOff, &nYOff,
+                                                &nXSize, &nYSize )
+            && nXSize > 0 && nYSize > 0 )
+        {
+            dfSumXSize += MIN(nXSize, nRasterXSize);
+            dfSumYSize += MIN(nYSize, nRasterYSize);
+            nWindows++;
+        }
+    }
+
+    if( nWindows == 0 )
+        return;
+
+    VRTSourceIndex *psIndex = (VRTSourceIndex *) 
+        VSICalloc( 1, sizeof(VRTSourceIndex) );
+    if( psIndex == NULL )
+        return;
+
+    psIndex->nCellXSize = MAX( 1, (int) (dfSumXSize / nWindows) );
+    psIndex->nCellYSize = MAX( 1, (int) (dfSumYSize / nWindows) );
+
+    for( ;; )
+    {
+        psIndex->nCellsX = 
+            (nRasterXSize + psIndex->nCellXSize - 1) / psIndex->nCellXSize;
+        psIndex->nCellsY = 
+            (nRasterYSize + psIndex->nCellYSize - 1) / psIndex->nCellYSize;
+
+        if( (double) psIndex->nCellsX * psIndex->nCellsY 
+            <= 4.0 * nSources + 16 )
+            break;
+
+        psIndex->nCellXSize = MIN( nRasterXSize, psIndex->nCellXSize * 2 );
+        psIndex->nCellYSize = MIN( nRasterYSize, psIndex->nCellYSize * 2 );
+    }
+
+    int nCells = psIndex->nCellsX * psIndex->nCellsY;
+
+    panFirstCell = (int *) VSIMalloc2( sizeof(int), nSources * 2 );
+    panLastCell = panFirstCell ? panFirstCell + nSources : NULL;
+    psIndex->panCellStart = (int *) VSICalloc( sizeof(int), nCells + 1 );
+    psIndex->panGlobalSources = (int *) VSIMalloc2( sizeof(int), nSources );
+    psIndex->panSourceStamp = (int *) VSICalloc( sizeof(int), nSources );
+    psIndex->panQuerySources = (int *) VSIMalloc2( sizeof(int), nSources );
+
+    if( panFirstCell == NULL || psIndex->panCellStart == NULL
+        || psIndex->panGlobalSources == NULL 
+        || psIndex->panSourceStamp == NULL
+        || psIndex->panQuerySources == NULL )
+    {
+        CPLFree( panFirstCell );
+        psSourceIndex = psIndex;
+        InvalidateSourceIndex();
+        return;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Find the cell range of each source, and count the sources of    */
+/*      each cell.  GetSrcDstWindow() keeps a source when the request   */
+/*      merely touches the end of its window, so the ranges are         */
+/*      computed on [xoff, xoff+xsize-1] and the queries are inclusive  */
+/*      of the request end.                                             */
+/* -------------------------------------------------------------------- */
+    for( iSource = 0; iSource < nSources; iSource++ )
+    {
+        panFirstCell[iSource] = -1;
+
+        if( !papoSources[iSource]->GetDstWindow( &nXOff, &nYOff,
+                                                 &nXSize, &nYSize )
+            || nXSize <= 0 || nYSize <= 0 )
+        {
+            psIndex->panGlobalSources[psIndex->nGlobalSources++] = iSource;
+            continue;
+        }
+
+        int nCellX0 = MAX( 0, nXOff / psIndex->nCellXSize );
+        int nCellY0 = MAX( 0, nYOff / psIndex->nCellYSize );
+        int nCellX1 = (int) MIN( (double) psIndex->nCellsX - 1,
+                 ((double) nXOff + nXSize - 1) / psIndex->nCellXSize );
+        int nCellY1 = (int) MIN( (double) psIndex->nCellsY - 1,
+                 ((double) nYOff + nYSize - 1) / psIndex->nCellYSize );
+
+        nCellX0 = MIN( nCellX0, psIndex->nCellsX - 1 );
+        nCellY0 = MIN( nCellY0, psIndex->nCellsY - 1 );
+        nCellX1 = MAX( nCellX1, nCellX0 );
+        nCellY1 = MAX( nCellY1, nCellY0 );
+
+        if( (nCellX1 - nCellX0 + 1) * (nCellY1 - nCellY0 + 1) 
+            > VRT_MAX_CELLS_PER_SOURCE )
+        {
+            psIndex->panGlobalSources[psIndex->nGlobalSources++] = iSource;
+            continue;
+        }
+
+        panFirstCell[iSource] = nCellY0 * psIndex->nCellsX + nCellX0;
+        panLastCell[iSource] = nCellY1 * psIndex->nCellsX + nCellX1;
+
+        for( int iY = nCellY0; iY <= nCellY1; iY++ )
+            for( int iX = nCellX0; iX <= nCellX1; iX++ )
+                psIndex->panCellStart[iY * psIndex->nCellsX + iX + 1]++;
+    }
+
+    for( int iCell = 0; iCell < nCells; iCell++ )
+        psIndex->panCellStart[iCell+1] += psIndex->panCellStart[iCell];
+
+/* -------------------------------------------------------------------- */
+/*      Fill the cell lists.  Sources are visited in order so each      */
+/*      list is sorted.                                                 */
+/* -------------------------------------------------------------------- */
+    psIndex->panCellSources = (int *) 
+        VSIMalloc2( sizeof(int), MAX(1, psIndex->panCellStart[nCells]) );
+    int *panCellFill = (int *) VSIMalloc2( sizeof(int), nCells );
+
+    if( psIndex->panCellSources == NULL || panCellFill == NULL )
+    {
+        CPLFree( panCellFill );
+        CPLFree( panFirstCell );
+        psSourceIndex = psIndex;
+        InvalidateSourceIndex();
+        return;
+    }
+
+    memcpy( panCellFill, psIndex->panCellStart, sizeof(int) * nCells );
+
+    for( iSource = 0; iSource < nSources; iSource++ )
+    {
+        if( panFirstCell[iSource] < 0 )
+            continue;
+
+        int nCellX0 = panFirstCell[iSource] % psIndex->nCellsX;
+        int nCellY0 = panFirstCell[iSource] / psIndex->nCellsX;
+        int nCellX1 = panLastCell[iSource] % psIndex->nCellsX;
+        int nCellY1 = panLastCell[iSource] / psIndex->nCellsX;
+
+        for( int iY = nCellY0; iY <= nCellY1; iY++ )
+            for( int iX = nCellX0; iX <= nCellX1; iX++ )
+                psIndex->panCellSources[
+                    panCellFill[iY * psIndex->nCellsX + iX]++] = iSource;
+    }
+
+    CPLFree( panCellFill );
+    CPLFree( panFirstCell );
+
+    CPLDebug( "VRT", "Indexed %d sources in a %dx%d grid of %dx%d cells, "
+              "%d sources visited by all requests.",
+              nSources, psIndex->nCellsX, psIndex->nCellsY,
+              psIndex->nCellXSize, psIndex->nCellYSize,
+              psIndex->nGlobalSources );
+
+    psSourceIndex = psIndex;
+}
+
+/************************************************************************/
+/*                          QuerySourceIndex()                          */
+/*                                                                      */
+/*      Collect in psSourceIndex->panQuerySources, in increasing        */
+/*      order, the sources that may intersect the passed window, and    */
+/*      return their count.                                             */
+/************************************************************************/
+
+int VRTSourcedRasterBand::QuerySourceIndex( int nXOff, int nYOff, 
+                                            int nXSize, int nYSize )
+
+{
+    VRTSourceIndex *psIndex = psSourceIndex;
+    int nCount = 0, i;
+
+    if( psIndex->nStamp == INT_MAX )
+    {
+        memset( psIndex->panSourceStamp, 0, sizeof(int) * nSources );
+        psIndex->nStamp = 0;
+    }
+    psIndex->nStamp++;
+
+    int nCellX0 = MIN( psIndex->nCellsX - 1,
+                       MAX( 0, nXOff / psIndex->nCellXSize ) );
+    int nCellY0 = MIN( psIndex->nCellsY - 1,
+                       MAX( 0, nYOff / psIndex->nCellYSize ) );
+    int nCellX1 = MIN( psIndex->nCellsX - 1,
+                       (nXOff + nXSize) / psIndex->nCellXSize );
+    int nCellY1 = MIN( psIndex->nCellsY - 1,
+                       (nYOff + nYSize) / psIndex->nCellYSize );
+
+    for( int iY = nCellY0; iY <= nCellY1; iY++ )
+    {
+        for( int iX = nCellX0; iX <= nCellX1; iX++ )
+        {
+            int iCell = iY * psIndex->nCellsX + iX;
+
+            for( i = psIndex->panCellStart[iCell]; 
+                 i < psIndex->panCellStart[iCell+1]; i++ )
+            {
+                int iSource = psIndex->panCellSources[i];
+
+                if( psIndex->panSourceStamp[iSource] != psIndex->nStamp )
+                {
+                    psIndex->panSourceStamp[iSource] = psIndex->nStamp;
+                    psIndex->panQuerySources[nCount++] = iSource;
+                }
+            }
+        }
+    }
+
+    for( i = 0; i < psIndex->nGlobalSources; i++ )
+        psIndex->panQuerySources[nCount++] = psIndex->panGlobalSources[i];
+
+/* -------------------------------------------------------------------- */
+/*      Sources from several cells (and the global ones) come out of    */
+/*      order, but they must be overlaid in the order of the VRT.       */
+/* -------------------------------------------------------------------- */
+    if( nCount > 1 
+        && (nCellX0 != nCellX1 || nCellY0 != nCellY1 
+            || psIndex->nGlobalSources > 0) )
+        qsort( psIndex->panQuerySources, nCount, sizeof(int), 
+               VRTCompareSourceNo );
+
+    return nCount;
 }
 
 /************************************************************************/
@@ -195,6 +509,32 @@ CPLErr VRTSourcedRasterBand::IRasterIO( GDALRWFlag eRWFlag,
     
     bAlreadyInIRasterIO = TRUE;
 
+/* -------------------------------------------------------------------- */
+/*      With many sources, only visit those whose destination window   */
+/*      may intersect the request.                                      */
+/* -------------------------------------------------------------------- */
+    if( psSourceIndex == NULL && nSources >= VRT_MIN_SOURCES_FOR_INDEX
+        && CSLTestBoolean( CPLGetConfigOption( "VRT_SOURCE_INDEX", "YES" ) ) )
+        BuildSourceIndex();
+
+    if( psSourceIndex != NULL )
+    {
+        int nCandidates = QuerySourceIndex( nXOff, nYOff, nXSize, nYSize );
+        int *panCandidates = psSourceIndex->panQuerySources;
+
+        for( int i = 0; eErr == CE_None && i < nCandidates; i++ )
+        {
+            eErr = papoSources[panCandidates[i]]->RasterIO( 
+                nXOff, nYOff, nXSize, nYSize, 
+                pData, nBufXSize, nBufYSize, 
+                eBufType, nPixelSpace, nLineSpace );
+        }
+
+        bAlreadyInIRasterIO = FALSE;
+
+        return eErr;
+    }
+
 /* -------------------------------------------------------------------- */
 /*      Overlay each source in turn over top this.                      */
 /* -------------------------------------------------------------------- */
@@ -251,6 +591,9 @@ CPLErr VRTSourcedRasterBand::AddSource( VRTSource *poNewSource )
     papoSources = (VRTSource **) 
         CPLRealloc(papoSources, sizeof(void*) * nSources);
     papoSources[nSources-1] = poNewSource;
+    poNewSource->poOwnerBand = this;
+
+    InvalidateSourceIndex();
 
     ((VRTDataset *)poDS)->SetNeedsFlush();
 
@@ -707,6 +1050,8 @@ CPLErr VRTSourcedRasterBand::SetMetadataItem( const char *pszName,
         {
             delete papoSources[iSource];
             papoSources[iSource] = poSource;
+            poSource->poOwnerBand = this;
+            InvalidateSourceIndex();
             ((VRTDataset *)poDS)->SetNeedsFlush();
             return CE_None;
         }
@@ -739,6 +1084,7 @@ CPLErr VRTSourcedRasterBand::SetMetadata( char **papszNewMD, const char *pszDoma
             CPLFree( papoSources );
             papoSources = NULL;
             nSources = 0;
+            InvalidateSourceIndex();
         }
 
         for( i = 0; i < CSLCount(papszNewMD); i++ )
@@ -43,10 +43,36 @@ CPL_CVSID("$Id$");
 /* ==================================================================== */
 /************************************************************************/
 
+/************************************************************************/
+/*                             VRTSource()                              */
+/************************************************************************/
+
+VRTSource::VRTSource()
+{
+    poOwnerBand = NULL;
+}
+
+/************************************************************************/
+/*                             ~VRTSource()                             */
+/************************************************************************/
+
 VRTSource::~VRTSource()
 {
 }
 
+/************************************************************************/
+/*                          DstWindowChanged()                          */
+/*                                                                      */
+/*      Drop the source index of the band we were added to, if any,    */
+/*      as it was built from our previous destination window.          */
+/************************************************************************/
+
+void VRTSource::DstWindowChanged()
+{
+    if( poOwnerBand != NULL )
+        poOwnerBand->InvalidateSourceIndex();
+}
+
 /************************************************************************/
 /*                             GetFileList()                            */
 /************************************************************************/
@@ -56,6 +82,20 @@ void VRTSource::GetFileList(char*** ppapszFileList, int *pnSize,
 {
 }
 
+/************************************************************************/
+/*                            GetDstWindow()                            */
+/*                                                                      */
+/*      Returns TRUE and the window of the band this source writes      */
+/*      to, or FALSE if it is unknown and the source may touch any      */
+/*      part of the band.                                               */
+/************************************************************************/
+
+int VRTSource::GetDstWindow( int *pnXOff, int *pnYOff, 
+                             int *pnXSize, int *pnYSize )
+{
+    return FALSE;
+}
+
 /************************************************************************/
 /* ==================================================================== */
 /*                          VRTSimpleSource                             */
@@ -125,6 +165,28 @@ void VRTSimpleSource::SetDstWindow( int nNewXOff, int nNewYOff,
     nDstYOff = nNewYOff;
     nDstXSize = nNewXSize;
     nDstYSize = nNewYSize;
+
+    DstWindowChanged();
+}
+
+/************************************************************************/
+/*                            GetDstWindow()                            */
+/************************************************************************/
+
+int VRTSimpleSource::GetDstWindow( int *pnXOff, int *pnYOff, 
+                                   int *pnXSize, int *pnYSize )
+
+{
+    if( nDstXOff == -1 && nDstYOff == -1 
+        && nDstXSize == -1 && nDstYSize == -1 )
+        return FALSE;
+
+    *pnXOff = nDstXOff;
+    *pnYOff = nDstYOff;
+    *pnXSize = nDstXSize;
+    *pnYSize = nDstYSize;
+
+    return TRUE;
 }
 
 /************************************************************************/
@@ -357,6 +419,8 @@ CPLErr VRTSimpleSource::XMLInit( CPLXMLNode *psSrc, const char *pszVRTPath )
         nDstXOff = nDstYOff = nDstXSize = nDstYSize = -1;
     }
 
+    DstWindowChanged();
+
     return CE_None;
 }
 
@@ -30,18 +30,251 @@
 
 #include "stdinc.h"
 
+/* Cache file names are the 32 hex digits of an MD5 hash followed by the
+   optional extension.  Only such files are indexed, and thus evicted. */
+static bool IsCacheFileName(const char *name) {
+    int i;
+    for (i = 0; i < 32; ++i) {
+        const char c = name[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+    }
+    return true;
+}
+
+/* In-memory index of the files of one cache directory, in least recently
+   used order.  It is loaded once and shared by all the datasets of the
+   process using that directory, so that cache hits do not scan the file
+   system and the size bound is enforced across datasets. */
+class GDALWMSCacheIndex {
+public:
+    static GDALWMSCacheIndex *Acquire(const CPLString &path);
+    static void Release(GDALWMSCacheIndex *index);
+
+public:
+    enum { MISS = 0, HIT, EXPIRED };
+
+    int Find(const CPLString &name, int max_age);
+    int Add(const CPLString &name, GIntBig size, GIntBig max_size);
+    GIntBig GetSize();
+    int GetCount();
+
+protected:
+    GDALWMSCacheIndex(const CPLString &path);
+    ~GDALWMSCacheIndex();
+    void Load(const CPLString &dir, const CPLString &prefix, int depth);
+    void Insert(const CPLString &name, GIntBig size, time_t mtime, bool most_recent);
+    void Remove(const CPLString &name);
+
+protected:
+    struct Entry {
+        GIntBig m_size;
+        time_t m_mtime;
+        std::list<CPLString>::iterator m_lru;
+    };
+    struct LoadedFile {
+        CPLString m_name;
+        GIntBig m_size;
+        time_t m_mtime;
+        bool operator<(const LoadedFile &other) const { return m_mtime > other.m_mtime; }
+    };
+
+    CPLString m_path;
+    int m_ref_count;
+    void *m_mutex;
+    std::map<CPLString, Entry> m_entries;
+    std::list<CPLString> m_lru; // Most recently used first.
+    GIntBig m_size;
+    std::vector<LoadedFile> m_loaded;
+};
+
+static void *g_cache_index_mutex = NULL;
+static std::map<CPLString, GDALWMSCacheIndex *> g_cache_indexes;
+
+/* The directory scan runs without the global mutex held, so that the
+   datasets using other caches, or an already indexed one, are not held
+   up by it.  If two threads index the same path at once, the index
+   published first is kept and the other one discarded. */
+GDALWMSCacheIndex *GDALWMSCacheIndex::Acquire(const CPLString &path) {
+    {
+        CPLMutexHolderD(&g_cache_index_mutex);
+
+        std::map<CPLString, GDALWMSCacheIndex *>::iterator it = g_cache_indexes.find(path);
+        if (it != g_cache_indexes.end()) {
+            it->second->m_ref_count++;
+            return it->second;
+        }
+    }
+
+    GDALWMSCacheIndex *index = new GDALWMSCacheIndex(path);
+    index->Load(path, "", 0);
+    std::sort(index->m_loaded.begin(), index->m_loaded.end());
+    for (size_t i = 0; i < index->m_loaded.size(); ++i) {
+        const LoadedFile &lf = index->m_loaded[i];
+        index->Insert(lf.m_name, lf.m_size, lf.m_mtime, false);
+    }
+    index->m_loaded.clear();
+    CPLDebug("WMS", "Cache %s: indexed %d files, " CPL_FRMT_GIB " bytes.",
+        path.c_str(), static_cast<int>(index->m_entries.size()), index->m_size);
+
+    CPLMutexHolderD(&g_cache_index_mutex);
+
+    std::map<CPLString, GDALWMSCacheIndex *>::iterator it = g_cache_indexes.find(path);
+    if (it != g_cache_indexes.end()) {
+        delete index;
+        it->second->m_ref_count++;
+        return it->second;
+    }
+
+    g_cache_indexes[path] = index;
+    return index;
+}
+
+void GDALWMSCacheIndex::Release(GDALWMSCacheIndex *index) {
+    CPLMutexHolderD(&g_cache_index_mutex);
+
+    if (--index->m_ref_count == 0) {
+        g_cache_indexes.erase(index->m_path);
+        delete index;
+    }
+}
+
+GDALWMSCacheIndex::GDALWMSCacheIndex(const CPLString &path) {
+    m_path = path;
+    m_ref_count = 1;
+    m_mutex = NULL;
+    m_size = 0;
+}
+
+GDALWMSCacheIndex::~GDALWMSCacheIndex() {
+    if (m_mutex != NULL) CPLDestroyMutex(m_mutex);
+}
+
+void GDALWMSCacheIndex::Load(const CPLString &dir, const CPLString &prefix, int depth) {
+    char **files = VSIReadDir(dir.c_str());
+    for (int i = 0; files != NULL && files[i] != NULL; ++i) {
+        const char *file = files[i];
+        if (EQUAL(file, ".") || EQUAL(file, "..")) continue;
+
+        CPLString path(CPLFormFilename(dir.c_str(), file, NULL));
+        VSIStatBufL stat;
+        if (VSIStatL(path.c_str(), &stat) != 0) continue;
+        if (VSI_ISDIR(stat.st_mode)) {
+            if (depth < 32) Load(path, prefix + file + "/", depth + 1);
+        } else if (VSI_ISREG(stat.st_mode) && IsCacheFileName(file)) {
+            LoadedFile lf;
+            lf.m_name = prefix + file;
+            lf.m_size = stat.st_size;
+            lf.m_mtime = stat.st_mtime;
+            m_loaded.push_back(lf);
+        }
+    }
+    CSLDestroy(files);
+}
+
+void GDALWMSCacheIndex::Insert(const CPLString &name, GIntBig size, time_t mtime, bool most_recent) {
+    Remove(name);
+
+    Entry &entry = m_entries[name];
+    entry.m_size = size;
+    entry.m_mtime = mtime;
+    entry.m_lru = m_lru.insert(most_recent ? m_lru.begin() : m_lru.end(), name);
+    m_size += size;
+}
+
+void GDALWMSCacheIndex::Remove(const CPLString &name) {
+    std::map<CPLString, Entry>::iterator it = m_entries.find(name);
+    if (it != m_entries.end()) {
+        m_size -= it->second.m_size;
+        m_lru.erase(it->second.m_lru);
+        m_entries.erase(it);
+    }
+}
+
+/* Looks up a cache file, touching it in the LRU order.  The file is
+   checked on disk, outside of the mutex, as another process may have
+   removed it, or written it since the index was loaded.  An indexed
+   file that is gone is dropped from the index and reported as a miss. */
+int GDALWMSCacheIndex::Find(const CPLString &name, int max_age) {
+    VSIStatBufL stat;
+    CPLString path(CPLFormFilename(m_path.c_str(), name.c_str(), NULL));
+    const bool exists = (VSIStatL(path.c_str(), &stat) == 0) && VSI_ISREG(stat.st_mode);
+
+    CPLMutexHolderD(&m_mutex);
+
+    std::map<CPLString, Entry>::iterator it = m_entries.find(name);
+    if (!exists) {
+        if (it != m_entries.end()) Remove(name);
+        return MISS;
+    }
+    if (it == m_entries.end()) {
+        Insert(name, stat.st_size, stat.st_mtime, true);
+        it = m_entries.find(name);
+    } else {
+        m_lru.splice(m_lru.begin(), m_lru, it->second.m_lru);
+    }
+
+    if ((max_age > 0) && (time(NULL) - it->second.m_mtime > max_age)) return EXPIRED;
+    return HIT;
+}
+
+/* Records a newly written cache file and evicts least recently used files
+   until the cache is within max_size bytes (0 meaning unlimited).  The new
+   file itself is never evicted.  Returns the number of files evicted. */
+int GDALWMSCacheIndex::Add(const CPLString &name, GIntBig size, GIntBig max_size) {
+    CPLMutexHolderD(&m_mutex);
+    int evicted = 0;
+
+    Insert(name, size, time(NULL), true);
+    while ((max_size > 0) && (m_size > max_size) && (m_lru.size() > 1)) {
+        CPLString victim(m_lru.back());
+        CPLString path(CPLFormFilename(m_path.c_str(), victim.c_str(), NULL));
+        VSIUnlink(path.c_str());
+        Remove(victim);
+        ++evicted;
+    }
+
+    return evicted;
+}
+
+GIntBig GDALWMSCacheIndex::GetSize() {
+    CPLMutexHolderD(&m_mutex);
+    return m_size;
+}
+
+int GDALWMSCacheIndex::GetCount() {
+    CPLMutexHolderD(&m_mutex);
+    return static_cast<int>(m_entries.size());
+}
+
+
 GDALWMSCache::GDALWMSCache() {
     m_cache_path = "./gdalwmscache";
     m_postfix = "";
     m_cache_depth = 2;
+    m_max_size = 0;
+    m_max_age = 0;
+    m_offline_mode = 0;
+    m_index = NULL;
+    m_hits = 0;
+    m_misses = 0;
+    m_expired = 0;
+    m_evictions = 0;
 }
 
 GDALWMSCache::~GDALWMSCache() {
+    if (m_index != NULL) {
+        CPLDebug("WMS", "Cache %s: %d hits, %d misses (%d expired), %d evictions.",
+            m_cache_path.c_str(), m_hits, m_misses, m_expired, m_evictions);
+        GDALWMSCacheIndex::Release(m_index);
+    }
 }
 
-CPLErr GDALWMSCache::Initialize(CPLXMLNode *config) {
+CPLErr GDALWMSCache::Initialize(CPLXMLNode *config, int offline_mode) {
     const char *cache_path = CPLGetXMLValue(config, "Path", "./gdalwmscache");
     m_cache_path = cache_path;
+    while ((m_cache_path.size() > 1) && (m_cache_path[m_cache_path.size() - 1] == '/')) {
+        m_cache_path.resize(m_cache_path.size() - 1);
+    }
 
     const char *cache_depth = CPLGetXMLValue(config, "Depth", "2");
     m_cache_depth = atoi(cache_depth);
@@ -49,39 +282,66 @@ CPLErr GDALWMSCache::Initialize(CPLXMLNode *config) {
     const char *cache_extension = CPLGetXMLValue(config, "Extension", "");
     m_postfix = cache_extension;
 
+    const char *max_size = CPLGetXMLValue(config, "MaxSize", "0");
+    m_max_size = CPLScanUIntBig(max_size, static_cast<int>(strlen(max_size)));
+
+    const char *max_age = CPLGetXMLValue(config, "MaxAge", "0");
+    m_max_age = atoi(max_age);
+
+    m_offline_mode = offline_mode;
+    m_index = GDALWMSCacheIndex::Acquire(m_cache_path);
+
     return CE_None;
 }
 
 CPLErr GDALWMSCache::Write(const char *key, const CPLString &file_name) {
-    CPLString cache_file(KeyToCacheFile(key));
+    CPLString cache_name(KeyToCacheName(key));
+    CPLString cache_file(CPLFormFilename(m_cache_path.c_str(), cache_name.c_str(), NULL));
     //	printf("GDALWMSCache::Write(%s, %s) -> %s\n", key, file_name.c_str());
     if (CPLCopyFile(cache_file.c_str(), file_name.c_str()) != CE_None) {
         MakeDirs(cache_file.c_str());
-        CPLCopyFile(cache_file.c_str(), file_name.c_str());
+        if (CPLCopyFile(cache_file.c_str(), file_name.c_str()) != CE_None) return CE_Failure;
     }
 
+    VSIStatBufL stat;
+    GIntBig size = (VSIStatL(file_name.c_str(), &stat) == 0) ? static_cast<GIntBig>(stat.st_size) : 0;
+    CPLAtomicAdd(&m_evictions, m_index->Add(cache_name, size, m_max_size));
+
     return CE_None;
 }
 
 CPLErr GDALWMSCache::Read(const char *key, CPLString *file_name) {
     CPLErr ret = CE_Failure;
-    CPLString cache_file(KeyToCacheFile(key));
-    FILE *f = VSIFOpen(cache_file.c_str(), "rb");
-    if (f != NULL) {
-        VSIFClose(f);
-        *file_name = cache_file;
+    CPLString cache_name(KeyToCacheName(key));
+    // Expired files are still good enough when we are not going to download anything.
+    const int state = m_index->Find(cache_name, m_offline_mode ? 0 : m_max_age);
+    if (state == GDALWMSCacheIndex::HIT) {
+        *file_name = CPLFormFilename(m_cache_path.c_str(), cache_name.c_str(), NULL);
         ret = CE_None;
+        CPLAtomicInc(&m_hits);
+    } else {
+        if (state == GDALWMSCacheIndex::EXPIRED) CPLAtomicInc(&m_expired);
+        CPLAtomicInc(&m_misses);
     }
     //    printf("GDALWMSCache::Read(...) -> %s\n", cache_file.c_str());
 
     return ret;
 }
 
-CPLString GDALWMSCache::KeyToCacheFile(const char *key) {
+void GDALWMSCache::GetStatistics(int *hits, int *misses, int *expired, int *evictions, GIntBig *size, int *count) {
+    *hits = m_hits;
+    *misses = m_misses;
+    *expired = m_expired;
+    *evictions = m_evictions;
+    *size = m_index->GetSize();
+    *count = m_index->GetCount();
+}
+
+/* Path of the cache file of key, relative to the cache directory. */
+CPLString GDALWMSCache::KeyToCacheName(const char *key) {
     CPLString hash(MD5String(key));
-    CPLString cache_file(m_cache_path);
+    CPLString cache_file;
 
-    if (cache_file.size() && (cache_file[cache_file.size() - 1] != '/')) cache_file.append(1, '/');
     for (int i = 0; i < m_cache_depth; ++i) {
         cache_file.append(1, hash[i]);
         cache_file.append(1, '/');
@@ -33,6 +33,8 @@
 GDALWMSDataset::GDALWMSDataset() {
     m_mini_driver = 0;
     m_cache = 0;
+    m_tile_driver = NULL;
+    m_advise_read_prefetch = 0;
     m_hint.m_valid = false;
     m_data_type = GDT_Byte;
     m_clamp_requests = true;
@@ -105,6 +107,10 @@ CPLErr GDALWMSDataset::Initialize(CPLXMLNode *config) {
             }
         }
     }
+    if (ret == CE_None) {
+        const char *prefetch = CPLGetXMLValue(config, "AdviseReadPrefetch", "0");
+        m_advise_read_prefetch = MAX(0, atoi(prefetch));
+    }
     if (ret == CE_None) {
         const char *block_size_x = CPLGetXMLValue(config, "BlockSizeX", "1024");
         const char *block_size_y = CPLGetXMLValue(config, "BlockSizeY", "1024");
@@ -244,7 +250,7 @@ CPLErr GDALWMSDataset::Initialize(CPLXMLNode *config) {
         CPLXMLNode *cache_node = CPLGetXMLNode(config, "Cache");
         if (cache_node != NULL) {
             m_cache = new GDALWMSCache();
-            if (m_cache->Initialize(cache_node) != CE_None) {
+            if (m_cache->Initialize(cache_node, m_offline_mode) != CE_None) {
                 delete m_cache;
                 m_cache = NULL;
                 CPLError(CE_Failure, CPLE_AppDefined, "GDALWMS: Failed to initialize cache.");
@@ -386,3 +392,26 @@ CPLErr GDALWMSDataset::AdviseRead(int x0, int y0, int sx, int sy, int bsx, int b
     if (band == NULL) return CE_Failure;
     return band->AdviseRead(x0, y0, sx, sy, bsx, bsy, bdt, options);
 }
+
+/* The WMS_CACHE domain reports the activity of the disk cache of this
+   dataset (HITS, MISSES, EXPIRED, EVICTIONS), and the size of the cache
+   directory (SIZE in bytes, FILES) as shared by all the datasets using it. */
+const char *GDALWMSDataset::GetMetadataItem(const char *name, const char *domain) {
+    if ((domain != NULL) && EQUAL(domain, "WMS_CACHE") && (name != NULL)) {
+        if (m_cache == NULL) return NULL;
+
+        int hits, misses, expired, evictions, count;
+        GIntBig size;
+        m_cache->GetStatistics(&hits, &misses, &expired, &evictions, &size, &count);
+        if (EQUAL(name, "HITS")) m_metadata_item.Printf("%d", hits);
+        else if (EQUAL(name, "MISSES")) m_metadata_item.Printf("%d", misses);
+        else if (EQUAL(name, "EXPIRED")) m_metadata_item.Printf("%d", expired);
+        else if (EQUAL(name, "EVICTIONS")) m_metadata_item.Printf("%d", evictions);
+        else if (EQUAL(name, "SIZE")) m_metadata_item.Printf(CPL_FRMT_GIB, size);
+        else if (EQUAL(name, "FILES")) m_metadata_item.Printf("%d", count);
+        else return NULL;
+        return m_metadata_item.c_str();
+    }
+
+    return GDALPamDataset::GetMetadataItem(name, domain);
+}
@@ -152,12 +152,44 @@ void CPLHTTPCleanupRequest(CPLHTTPRequest *psRequest) {
     }
 }
 
-CPLErr CPLHTTPFetchMulti(CPLHTTPRequest *pasRequest, int nRequestCount, const char *const *papszOptions) {
+static void CPLHTTPFinishRequest(CPLHTTPRequest *psRequest, int iRequest) {
+    long response_code = 0;
+    curl_easy_getinfo(psRequest->m_curl_handle, CURLINFO_RESPONSE_CODE, &response_code);
+    psRequest->nStatus = response_code;
+
+    char *content_type = 0;
+    curl_easy_getinfo(psRequest->m_curl_handle, CURLINFO_CONTENT_TYPE, &content_type);
+    if (content_type) psRequest->pszContentType = CPLStrdup(content_type);
+
+    if ((psRequest->pszError == NULL) && (psRequest->m_curl_error != NULL) && (psRequest->m_curl_error[0] != '\0')) {
+        psRequest->pszError = CPLStrdup(psRequest->m_curl_error);
+    }
+
+    /* There is no response code for file:// URLs, a successful read of
+       a local tile stands for HTTP 200. */
+    if ((psRequest->nStatus == 0) && (psRequest->pszError == NULL)
+        && (psRequest->nDataLen > 0) && EQUALN(psRequest->pszURL, "file://", 7)) {
+        psRequest->nStatus = 200;
+    }
+
+    CPLDebug("HTTP", "Request [%d] %s : status = %d, content type = %s, error = %s",
+             iRequest + 1, psRequest->pszURL, psRequest->nStatus,
+             (psRequest->pszContentType) ? psRequest->pszContentType : "(null)",
+             (psRequest->pszError) ? psRequest->pszError : "(null)");
+}
+
+/* Runs the requests with at most MAXCONN transfers in flight, starting the
+   next request as soon as one completes.  When pfnDone is given, it is called
+   for each request right after its transfer completes, in completion order,
+   while the other transfers go on.  It may release the data of the request
+   with CPLHTTPCleanupRequest(). */
+CPLErr CPLHTTPFetchMulti(CPLHTTPRequest *pasRequest, int nRequestCount, const char *const *papszOptions,
+                         CPLHTTPRequestDoneFunc pfnDone, void *pDoneArg) {
     CPLErr ret = CE_None;
     CURLM *curl_multi = 0;
-    int still_running;
+    int still_running = 0;
     int max_conn;
-    int i, conn_i;
+    int i, conn_i, done_count = 0;
 
     const char *max_conn_opt = CSLFetchNameValue(const_cast<char **>(papszOptions), "MAXCONN");
     if (max_conn_opt && (max_conn_opt[0] != '\0')) {
@@ -171,6 +203,8 @@ CPLErr CPLHTTPFetchMulti(CPLHTTPRequest *pasRequest, int nRequestCount, const ch
         CPLError(CE_Fatal, CPLE_AppDefined, "CPLHTTPFetchMulti(): Unable to create CURL multi-handle.");
     }
 
+    std::vector<char> done(nRequestCount, 0);
+
     // add at most max_conn requests
     for (conn_i = 0; conn_i < MIN(nRequestCount, max_conn); ++conn_i) {
         CPLHTTPRequest *const psRequest = &pasRequest[conn_i];
@@ -179,60 +213,75 @@ CPLErr CPLHTTPFetchMulti(CPLHTTPRequest *pasRequest, int nRequestCount, const ch
     }
 
     while (curl_multi_perform(curl_multi, &still_running) == CURLM_CALL_MULTI_PERFORM);
-    while (still_running || (conn_i != nRequestCount)) {
-        struct timeval timeout;
-        fd_set fdread, fdwrite, fdexcep;
-        int maxfd;
+    while (done_count < nRequestCount) {
         CURLMsg *msg;
         int msgs_in_queue;
+        int completed = 0;
 
-        do {
-            msg = curl_multi_info_read(curl_multi, &msgs_in_queue);
-            if (msg != NULL) {
-                if (msg->msg == CURLMSG_DONE) { // transfer completed, check if we have more waiting and add them
-                    if (conn_i < nRequestCount) {
-                        CPLHTTPRequest *const psRequest = &pasRequest[conn_i];
-                        CPLDebug("HTTP", "Requesting [%d/%d] %s", conn_i + 1, nRequestCount, pasRequest[conn_i].pszURL);
-                        curl_multi_add_handle(curl_multi, psRequest->m_curl_handle);
-                        ++conn_i;
-                    }
-                }
+        while ((msg = curl_multi_info_read(curl_multi, &msgs_in_queue)) != NULL) {
+            if (msg->msg != CURLMSG_DONE) continue;
+
+            CURL *curl_handle = msg->easy_handle;
+            for (i = 0; i < conn_i; ++i) {
+                if (pasRequest[i].m_curl_handle == curl_handle) break;
             }
-        } while (msg != NULL);
-        FD_ZERO(&fdread);
-        FD_ZERO(&fdwrite);
-        FD_ZERO(&fdexcep);
-        curl_multi_fdset(curl_multi, &fdread, &fdwrite, &fdexcep, &maxfd);
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 100000;
-        select(maxfd + 1, &fdread, &fdwrite, &fdexcep, &timeout);
-        while (curl_multi_perform(curl_multi, &still_running) == CURLM_CALL_MULTI_PERFORM);
-    }
+            if ((i == conn_i) || done[i]) continue;
 
-    if (conn_i != nRequestCount) { // something gone really really wrong
-        CPLError(CE_Fatal, CPLE_AppDefined, "CPLHTTPFetchMulti(): conn_i != nRequestCount, this should never happen ...");
-    }
-    for (i = 0; i < nRequestCount; ++i) {
-        CPLHTTPRequest *const psRequest = &pasRequest[i];
+            // msg is not valid anymore after this
+            curl_multi_remove_handle(curl_multi, curl_handle);
+            CPLHTTPFinishRequest(&pasRequest[i], i);
+            done[i] = 1;
+            ++done_count;
+            ++completed;
 
-        long response_code = 0;
-        curl_easy_getinfo(psRequest->m_curl_handle, CURLINFO_RESPONSE_CODE, &response_code);
-        psRequest->nStatus = response_code;
+            // keep max_conn transfers going while this one is being processed
+            if (conn_i < nRequestCount) {
+                CPLHTTPRequest *const psRequest = &pasRequest[conn_i];
+                CPLDebug("HTTP", "Requesting [%d/%d] %s", conn_i + 1, nRequestCount, pasRequest[conn_i].pszURL);
+                curl_multi_add_handle(curl_multi, psRequest->m_curl_handle);
+                ++conn_i;
+                while (curl_multi_perform(curl_multi, &still_running) == CURLM_CALL_MULTI_PERFORM);
+            }
+
+            if (pfnDone != NULL) pfnDone(&pasRequest[i], i, pDoneArg);
+        }
+        if (done_count == nRequestCount) break;
+        if ((completed == 0) && (still_running == 0) && (conn_i == nRequestCount)) break; // should not happen
 
-        char *content_type = 0;
-        curl_easy_getinfo(psRequest->m_curl_handle, CURLINFO_CONTENT_TYPE, &content_type);
-        if (content_type) psRequest->pszContentType = CPLStrdup(content_type);
+        /* Wait for socket activity, but no longer than curl wants to. There
+           is no socket to wait on for file:// URLs or while resolving names,
+           so a short sleep stands for the select() then. */
+        long timeout_ms = 100;
+#if LIBCURL_VERSION_NUM >= 0x070f04
+        curl_multi_timeout(curl_multi, &timeout_ms);
+        if ((timeout_ms < 0) || (timeout_ms > 100)) timeout_ms = 100;
+#endif
+        if (timeout_ms > 0) {
+            struct timeval timeout;
+            fd_set fdread, fdwrite, fdexcep;
+            int maxfd = -1;
 
-        if ((psRequest->pszError == NULL) && (psRequest->m_curl_error != NULL) && (psRequest->m_curl_error[0] != '\0')) {
-            psRequest->pszError = CPLStrdup(psRequest->m_curl_error);
+            FD_ZERO(&fdread);
+            FD_ZERO(&fdwrite);
+            FD_ZERO(&fdexcep);
+            curl_multi_fdset(curl_multi, &fdread, &fdwrite, &fdexcep, &maxfd);
+            if (maxfd >= 0) {
+                timeout.tv_sec = 0;
+                timeout.tv_usec = timeout_ms * 1000;
+                select(maxfd + 1, &fdread, &fdwrite, &fdexcep, &timeout);
+            } else {
+                CPLSleep(MIN(timeout_ms, 10) / 1000.0);
+            }
         }
-        
-        CPLDebug("HTTP", "Request [%d] %s : status = %d, content type = %s, error = %s",
-                 conn_i, psRequest->pszURL, psRequest->nStatus,
-                 (psRequest->pszContentType) ? psRequest->pszContentType : "(null)",
-                 (psRequest->pszError) ? psRequest->pszError : "(null)");
+        while (curl_multi_perform(curl_multi, &still_running) == CURLM_CALL_MULTI_PERFORM);
+    }
 
-        curl_multi_remove_handle(curl_multi, pasRequest[i].m_curl_handle);
+    for (i = 0; i < nRequestCount; ++i) {
+        if (done[i]) continue;
+        CPLHTTPRequest *const psRequest = &pasRequest[i];
+        if (i < conn_i) curl_multi_remove_handle(curl_multi, psRequest->m_curl_handle);
+        CPLHTTPFinishRequest(psRequest, i);
+        if (pfnDone != NULL) pfnDone(psRequest, i, pDoneArg);
     }
     curl_multi_cleanup(curl_multi);
 
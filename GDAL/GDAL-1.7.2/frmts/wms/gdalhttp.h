@@ -51,6 +51,10 @@ typedef struct {
     char *m_curl_error;
 } CPLHTTPRequest;
 
+/* Called by CPLHTTPFetchMulti() as soon as the transfer of a request completes. */
+typedef void (*CPLHTTPRequestDoneFunc)(CPLHTTPRequest *psRequest, int iRequest, void *pUserData);
+
 void CPL_DLL CPLHTTPInitializeRequest(CPLHTTPRequest *psRequest, const char *pszURL = 0, const char *const *papszOptions = 0);
 void CPL_DLL CPLHTTPCleanupRequest(CPLHTTPRequest *psRequest);
-CPLErr CPL_DLL CPLHTTPFetchMulti(CPLHTTPRequest *pasRequest, int nRequestCount = 1, const char *const *papszOptions = 0);
+CPLErr CPL_DLL CPLHTTPFetchMulti(CPLHTTPRequest *pasRequest, int nRequestCount = 1, const char *const *papszOptions = 0,
+                                 CPLHTTPRequestDoneFunc pfnDone = 0, void *pDoneArg = 0);
@@ -52,6 +52,19 @@ GDALWMSRasterBand::~GDALWMSRasterBand() {
     }
 }
 
+struct GDALWMSBlockXY {
+    int x, y;
+};
+
+struct GDALWMSDownloadContext {
+    GDALWMSRasterBand *band;
+    int x, y;
+    void *buffer;
+    int advise_read;
+    const GDALWMSBlockXY *blocks;
+    CPLErr ret;
+};
+
 CPLErr GDALWMSRasterBand::ReadBlocks(int x, int y, void *buffer, int bx0, int by0, int bx1, int by1, int advise_read) {
     CPLErr ret = CE_None;
     int i;
@@ -60,12 +73,10 @@ CPLErr GDALWMSRasterBand::ReadBlocks(int x, int y, void *buffer, int bx0, int by
     int request_count = 0;
     CPLHTTPRequest *download_requests = NULL;
     GDALWMSCache *cache = m_parent_dataset->m_cache;
-    struct BlockXY {
-        int x, y;
-    } *download_blocks = NULL;
+    GDALWMSBlockXY *download_blocks = NULL;
     if (!m_parent_dataset->m_offline_mode) {
         download_requests = new CPLHTTPRequest[max_request_count];
-        download_blocks = new BlockXY[max_request_count];
+        download_blocks = new GDALWMSBlockXY[max_request_count];
     }
 
     char **http_request_opts = NULL;
@@ -134,74 +145,101 @@ CPLErr GDALWMSRasterBand::ReadBlocks(int x, int y, void *buffer, int bx0, int by
             optstr.Printf("MAXCONN=%d", m_parent_dataset->m_http_max_conn);
             opts = CSLAddString(opts, optstr.c_str());
         }
-        if (CPLHTTPFetchMulti(download_requests, request_count, opts) != CE_None) {
+        /* Each tile is decoded as soon as it arrives, while the others are
+           still downloading. */
+        GDALWMSDownloadContext context;
+        context.band = this;
+        context.x = x;
+        context.y = y;
+        context.buffer = buffer;
+        context.advise_read = advise_read;
+        context.blocks = download_blocks;
+        context.ret = CE_None;
+        if (CPLHTTPFetchMulti(download_requests, request_count, opts, DownloadDone, &context) != CE_None) {
             CPLError(CE_Failure, CPLE_AppDefined, "GDALWMS: CPLHTTPFetchMulti failed.");
             ret = CE_Failure;
         }
+        if (context.ret != CE_None) ret = context.ret;
         if (opts != NULL) {
             CSLDestroy(opts);
         }
     }
 
     for (i = 0; i < request_count; ++i) {
-        if (ret == CE_None) {
-            if ((download_requests[i].nStatus == 200) && (download_requests[i].pabyData != NULL) && (download_requests[i].nDataLen > 0)) {
-                CPLString file_name(BufferToVSIFile(download_requests[i].pabyData, download_requests[i].nDataLen));
-                if (file_name.size() > 0) {
-                    /* check for error xml */
-                    if (download_requests[i].nDataLen >= 20) {
-                        const char *download_data = reinterpret_cast<char *>(download_requests[i].pabyData);
-                        if (EQUALN(download_data, "<?xml ", 6) 
-                        || EQUALN(download_data, "<!DOCTYPE ", 10)
-                        || EQUALN(download_data, "<ServiceException", 17)) {
-                            if (ReportWMSException(file_name.c_str()) != CE_None) {
-                                CPLError(CE_Failure, CPLE_AppDefined, "GDALWMS: The server returned unknown exception.");
-                            }
-                            ret = CE_Failure;
-                        }
-                    }
-                    if (ret == CE_None) {
-                        if (advise_read && !m_parent_dataset->m_verify_advise_read) {
-                            if (cache != NULL) {
-                                cache->Write(download_requests[i].pszURL, file_name);
-                            }
-                        } else {
-                            void *p = 0;
-                            if ((download_blocks[i].x == x) && (download_blocks[i].y == y)) p = buffer;
-                            if (ReadBlockFromFile(download_blocks[i].x, download_blocks[i].y, file_name.c_str(), nBand, p, advise_read) == CE_None) {
-                                if (cache != NULL) {
-                                    cache->Write(download_requests[i].pszURL, file_name);
-                                }
-                            } else {
-                                CPLError(CE_Failure, CPLE_AppDefined, "GDALWMS: ReadBlockFromFile (%s) failed.",
-                                         download_requests[i].pszURL);
-                                ret = CE_Failure;
-                            }
-                        }
+        CPLHTTPCleanupRequest(&download_requests[i]);
+    }
+    if (!m_parent_dataset->m_offline_mode) {
+        delete[] download_blocks;
+        delete[] download_requests;
+    }
+
+    return ret;
+}
+
+void GDALWMSRasterBand::DownloadDone(CPLHTTPRequest *request, int i, void *arg) {
+    GDALWMSDownloadContext *context = reinterpret_cast<GDALWMSDownloadContext *>(arg);
+    if (context->ret == CE_None) {
+        context->ret = context->band->ReadDownloadedBlock(request, context->blocks[i].x, context->blocks[i].y,
+                                                          context->x, context->y, context->buffer, context->advise_read);
+    }
+    /* Release the tile data early, the request itself is cleaned up by ReadBlocks() */
+    CPLHTTPCleanupRequest(request);
+}
+
+CPLErr GDALWMSRasterBand::ReadDownloadedBlock(CPLHTTPRequest *request, int bx, int by, int x, int y, void *buffer, int advise_read) {
+    CPLErr ret = CE_None;
+    GDALWMSCache *cache = m_parent_dataset->m_cache;
+
+    if ((request->nStatus == 200) && (request->pabyData != NULL) && (request->nDataLen > 0)) {
+        CPLString file_name(BufferToVSIFile(request->pabyData, request->nDataLen));
+        if (file_name.size() > 0) {
+            /* check for error xml */
+            if (request->nDataLen >= 20) {
+                const char *download_data = reinterpret_cast<char *>(request->pabyData);
+                if (EQUALN(download_data, "<?xml ", 6) 
+                || EQUALN(download_data, "<!DOCTYPE ", 10)
+                || EQUALN(download_data, "<ServiceException", 17)) {
+                    if (ReportWMSException(file_name.c_str()) != CE_None) {
+                        CPLError(CE_Failure, CPLE_AppDefined, "GDALWMS: The server returned unknown exception.");
                     }
-                    VSIUnlink(file_name.c_str());
+                    ret = CE_Failure;
                 }
-            } else if (download_requests[i].nStatus == 204) {
-                if (!advise_read) {
+            }
+            if (ret == CE_None) {
+                if (advise_read && !m_parent_dataset->m_verify_advise_read) {
+                    if (cache != NULL) {
+                        cache->Write(request->pszURL, file_name);
+                    }
+                } else {
                     void *p = 0;
-                    if ((download_blocks[i].x == x) && (download_blocks[i].y == y)) p = buffer;
-                    if (ZeroBlock(download_blocks[i].x, download_blocks[i].y, nBand, p) != CE_None) {
-                        CPLError(CE_Failure, CPLE_AppDefined, "GDALWMS: ZeroBlock failed.");
+                    if ((bx == x) && (by == y)) p = buffer;
+                    if (ReadBlockFromFile(bx, by, file_name.c_str(), nBand, p, advise_read) == CE_None) {
+                        if (cache != NULL) {
+                            cache->Write(request->pszURL, file_name);
+                        }
+                    } else {
+                        CPLError(CE_Failure, CPLE_AppDefined, "GDALWMS: ReadBlockFromFile (%s) failed.",
+                                 request->pszURL);
                         ret = CE_Failure;
                     }
                 }
-            } else {
-                CPLError(CE_Failure, CPLE_AppDefined, "GDALWMS: Unable to download block %d, %d.\n  URL: %s\n  HTTP status code: %d, error: %s.",
-                    download_blocks[i].x, download_blocks[i].y, download_requests[i].pszURL, download_requests[i].nStatus, 
-		    download_requests[i].pszError ? download_requests[i].pszError : "(null)");
+            }
+            VSIUnlink(file_name.c_str());
+        }
+    } else if (request->nStatus == 204) {
+        if (!advise_read) {
+            void *p = 0;
+            if ((bx == x) && (by == y)) p = buffer;
+            if (ZeroBlock(bx, by, nBand, p) != CE_None) {
+                CPLError(CE_Failure, CPLE_AppDefined, "GDALWMS: ZeroBlock failed.");
                 ret = CE_Failure;
             }
         }
-        CPLHTTPCleanupRequest(&download_requests[i]);
-    }
-    if (!m_parent_dataset->m_offline_mode) {
-        delete[] download_blocks;
-        delete[] download_requests;
+    } else {
+        CPLError(CE_Failure, CPLE_AppDefined, "GDALWMS: Unable to download block %d, %d.\n  URL: %s\n  HTTP status code: %d, error: %s.",
+            bx, by, request->pszURL, request->nStatus,
+            request->pszError ? request->pszError : "(null)");
+        ret = CE_Failure;
     }
 
     return ret;
@@ -321,6 +359,36 @@ void GDALWMSRasterBand::AskMiniDriverForBlock(CPLString *url, int x, int y) {
     m_parent_dataset->m_mini_driver->TiledImageRequest(url, iri, tiri);
 }
 
+/* All the tiles of a service normally come in the same format, so the driver
+   that opened the previous tile is tried first, skipping the identification
+   pass of GDALOpen() over all the registered drivers.  A tile is a single
+   file, so it is given itself as the only sibling, which also saves reading
+   the cache directory.  The description and error state are set up as
+   GDALOpen() does; the tile dataset does not learn its driver, which is fine
+   as it is only read and closed.  GDALOpen() remains the fallback when the
+   driver rejects a tile, for example when a server mixes PNG and JPEG. */
+GDALDataset *GDALWMSRasterBand::OpenTile(const char *file_name) {
+    GDALDriver *driver = m_parent_dataset->m_tile_driver;
+    GDALDataset *ds = NULL;
+
+    if ((driver != NULL) && (driver->pfnOpen != NULL)) {
+        char *siblings[2] = { const_cast<char *>(CPLGetFilename(file_name)), NULL };
+        GDALOpenInfo open_info(file_name, GA_ReadOnly, siblings);
+        CPLLocaleC locale_forcer;
+
+        CPLErrorReset();
+        ds = driver->pfnOpen(&open_info);
+        if (ds != NULL) {
+            if (strlen(ds->GetDescription()) == 0) ds->SetDescription(file_name);
+            return ds;
+        }
+    }
+
+    ds = reinterpret_cast<GDALDataset*>(GDALOpen(file_name, GA_ReadOnly));
+    if (ds != NULL) m_parent_dataset->m_tile_driver = ds->GetDriver();
+    return ds;
+}
+
 CPLErr GDALWMSRasterBand::ReadBlockFromFile(int x, int y, const char *file_name, int to_buffer_band, void *buffer, int advise_read) {
     CPLErr ret = CE_None;
     GDALDataset *ds = 0;
@@ -332,7 +400,7 @@ CPLErr GDALWMSRasterBand::ReadBlockFromFile(int x, int y, const char *file_name,
     /* expected size */
     const int esx = MIN(MAX(0, (x + 1) * nBlockXSize), nRasterXSize) - MIN(MAX(0, x * nBlockXSize), nRasterXSize);
     const int esy = MIN(MAX(0, (y + 1) * nBlockYSize), nRasterYSize) - MIN(MAX(0, y * nBlockYSize), nRasterYSize);
-    ds = reinterpret_cast<GDALDataset*>(GDALOpen(file_name, GA_ReadOnly));
+    ds = OpenTile(file_name);
     if (ds != NULL) {
         int sx = ds->GetRasterXSize();
         int sy = ds->GetRasterYSize();
@@ -582,5 +650,14 @@ CPLErr GDALWMSRasterBand::AdviseRead(int x0, int y0, int sx, int sy, int bsx, in
     int bx1 = (x0 + sx - 1) / nBlockXSize;
     int by1 = (y0 + sy - 1) / nBlockYSize;
 
+    /* Also fetch a ring of neighbouring blocks, which are likely to be read next */
+    const int prefetch = m_parent_dataset->m_advise_read_prefetch;
+    if (prefetch > 0) {
+        bx0 = MAX(0, bx0 - prefetch);
+        by0 = MAX(0, by0 - prefetch);
+        bx1 = MIN((nRasterXSize + nBlockXSize - 1) / nBlockXSize - 1, bx1 + prefetch);
+        by1 = MIN((nRasterYSize + nBlockYSize - 1) / nBlockYSize - 1, by1 + prefetch);
+    }
+
     return ReadBlocks(0, 0, NULL, bx0, by0, bx1, by1, 1);
 }
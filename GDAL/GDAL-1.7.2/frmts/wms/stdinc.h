@@ -1,6 +1,8 @@
 #include <math.h>
 #include <vector>
 #include <list>
+#include <map>
+#include <algorithm>
 #include <curl/curl.h>
 #include <gdal.h>
 #include <gdalwarper.h>
@@ -11,6 +13,7 @@
 #include <gdal_priv.h>
 #include <gdal_pam.h>
 #include <cpl_multiproc.h>
+#include <cpl_atomic_ops.h>
 
 #include "md5.h"
 #include "gdalhttp.h"
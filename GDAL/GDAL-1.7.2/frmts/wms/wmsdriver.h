@@ -169,23 +169,35 @@ public: \
     delete instance; \
 }
 
+class GDALWMSCacheIndex;
+
 class GDALWMSCache {
 public:
     GDALWMSCache();
     ~GDALWMSCache();
 
 public:
-    CPLErr Initialize(CPLXMLNode *config);
+    CPLErr Initialize(CPLXMLNode *config, int offline_mode);
     CPLErr Write(const char *key, const CPLString &file_name);
     CPLErr Read(const char *key, CPLString *file_name);
+    void GetStatistics(int *hits, int *misses, int *expired, int *evictions, GIntBig *size, int *count);
 
 protected:
-    CPLString KeyToCacheFile(const char *key);
+    CPLString KeyToCacheName(const char *key);
 
 protected:
     CPLString m_cache_path;
     CPLString m_postfix;
     int m_cache_depth;
+    GIntBig m_max_size;
+    int m_max_age;
+    int m_offline_mode;
+    GDALWMSCacheIndex *m_index;
+    // Updated atomically, as the datasets may be read from several threads.
+    volatile int m_hits;
+    volatile int m_misses;
+    volatile int m_expired;
+    volatile int m_evictions;
 };
 
 class GDALWMSDataset : public GDALPamDataset {
@@ -202,6 +214,7 @@ public:
     virtual CPLErr GetGeoTransform(double *gt);
     virtual CPLErr SetGeoTransform(double *gt);
     virtual CPLErr AdviseRead(int x0, int y0, int sx, int sy, int bsx, int bsy, GDALDataType bdt, int band_count, int *band_map, char **options);
+    virtual const char *GetMetadataItem(const char *name, const char *domain = "");
 
 protected:
     virtual CPLErr IRasterIO(GDALRWFlag rw, int x0, int y0, int sx, int sy, void *buffer, int bsx, int bsy, GDALDataType bdt, int band_count, int *band_map, int pixel_space, int line_space, int band_space);
@@ -219,6 +232,7 @@ protected:
     GDALWMSMiniDriver *m_mini_driver;
     GDALWMSMiniDriverCapabilities m_mini_driver_caps;
     GDALWMSCache *m_cache;
+    GDALDriver *m_tile_driver;
     CPLString m_projection;
     int m_overview_count;
     GDALDataType m_data_type;
@@ -226,10 +240,12 @@ protected:
     GDALWMSRasterIOHint m_hint;
     int m_use_advise_read;
     int m_verify_advise_read;
+    int m_advise_read_prefetch;
     int m_offline_mode;
     int m_http_max_conn;
     int m_http_timeout;
     int m_clamp_requests;
+    CPLString m_metadata_item;
 };
 
 class GDALWMSRasterBand : public GDALPamRasterBand {
@@ -252,7 +268,10 @@ protected:
     void AddOverview(double scale);
     bool IsBlockInCache(int x, int y);
     void AskMiniDriverForBlock(CPLString *url, int x, int y);
+    GDALDataset *OpenTile(const char *file_name);
     CPLErr ReadBlockFromFile(int x, int y, const char *file_name, int to_buffer_band, void *buffer, int advise_read);
+    CPLErr ReadDownloadedBlock(CPLHTTPRequest *request, int bx, int by, int x, int y, void *buffer, int advise_read);
+    static void DownloadDone(CPLHTTPRequest *request, int i, void *arg);
     CPLErr ZeroBlock(int x, int y, int to_buffer_band, void *buffer);
     CPLErr ReportWMSException(const char *file_name);
 
@@ -55,6 +55,8 @@ class GDALProxyRasterBand;
 #include "cpl_conv.h"
 #include "cpl_string.h"
 #include "cpl_minixml.h"
+#include "cpl_atomic_ops.h"
+#include "cpl_hash_set.h"
 #include <vector>
 
 #define GMO_VALID                0x0001
@@ -316,7 +318,7 @@ class CPL_DLL GDALRasterBlock
     GDALDataType        eType;
     
     int                 bDirty;
-    int                 nLockCount;
+    volatile int        nLockCount;
 
     int                 nXOff;
     int                 nYOff;
@@ -331,6 +333,11 @@ class CPL_DLL GDALRasterBlock
     GDALRasterBlock     *poNext;
     GDALRasterBlock     *poPrevious;
 
+    int                 nTouchTick;
+
+    static void VerifyShard( int );
+    static int  FlushCacheBlock( int *pbDirtySkipped );
+
   public:
                 GDALRasterBlock( GDALRasterBand *, int, int );
     virtual     ~GDALRasterBlock();
@@ -339,8 +346,8 @@ class CPL_DLL GDALRasterBlock
     void        Touch( void );      
     void        MarkDirty( void );  
     void        MarkClean( void );
-    void        AddLock( void ) { nLockCount++; }
-    void        DropLock( void ) { nLockCount--; }
+    void        AddLock( void ) { CPLAtomicInc( &nLockCount ); }
+    void        DropLock( void ) { CPLAtomicDec( &nLockCount ); }
     void        Detach();
 
     CPLErr      Write();
@@ -362,7 +369,18 @@ class CPL_DLL GDALRasterBlock
     static int  FlushCacheBlock();
     static void Verify();
 
+    static void EnterDisableDirtyBlockFlush();
+    static void LeaveDisableDirtyBlockFlush();
+
     static int  SafeLockBlock( GDALRasterBlock ** );
+    static int  SafeLockBlock( GDALRasterBlock **, GDALRasterBand *,
+                               int, int );
+    static GDALRasterBlock *LockBlockRef( GDALRasterBlock **,
+                                          GDALRasterBand *, int, int );
+    static GDALRasterBlock *TakeBlockRef( GDALRasterBlock **,
+                                          GDALRasterBand *, int, int );
+    static GDALRasterBlock *AdoptBlockRef( GDALRasterBlock **, 
+                                           GDALRasterBlock * );
 };
 
 /* ******************************************************************** */
@@ -422,6 +440,10 @@ class CPL_DLL GDALRasterBand : public GDALMajorObject
     int         nSubBlocksPerColumn;
     GDALRasterBlock **papoBlocks;
 
+    /* sparse block index, used instead of papoBlocks for huge bands */
+    CPLHashSet  *hBlockHash;
+    void        *hBlockHashMutex;
+
     int         nBlockReads;
     int         bForceCachedIO;
 
@@ -446,6 +468,9 @@ class CPL_DLL GDALRasterBand : public GDALMajorObject
     int            InitBlockInfo();
 
     CPLErr         AdoptBlock( int, int, GDALRasterBlock * );
+    CPLErr         AdoptBlock( int, int, GDALRasterBlock *, 
+                               GDALRasterBlock **ppoCachedBlock );
+    CPLErr         FlushBlock( int, int, int *pbFreed );
     GDALRasterBlock *TryGetLockedBlockRef( int nXBlockOff, int nYBlockYOff );
 
   public:
@@ -804,6 +829,11 @@ CPLErr CPL_DLL GDALParseGMLCoverage( CPLXMLNode *psTree,
                                      double *padfGeoTransform,
                                      char **ppszProjection );
 
+int GDALCopyWordsSIMD( const void *pSrcData, GDALDataType eSrcType,
+                       int nSrcPixelOffset,
+                       void *pDstData, GDALDataType eDstType,
+                       int nDstPixelOffset, int nWordCount );
+
 /* ==================================================================== */
 /*  Infrastructure to check that dataset characteristics are valid      */
 /* ==================================================================== */
@@ -203,8 +203,6 @@ class CPL_DLL GDALProxyPoolDataset : public GDALProxyDataset
         CPLHashSet      *metadataSet;
         CPLHashSet      *metadataItemSet;
 
-        GDALProxyPoolCacheEntry* cacheEntry;
-
     protected:
         virtual GDALDataset *RefUnderlyingDataset();
         virtual void UnrefUnderlyingDataset(GDALDataset* poUnderlyingDataset);
@@ -303,8 +301,12 @@ class GDALProxyPoolOverviewRasterBand : public GDALProxyPoolRasterBand
         GDALProxyPoolRasterBand *poMainBand;
         int                      nOverviewBand;
 
-        GDALRasterBand          *poUnderlyingMainRasterBand;
+        /* underlying bands handed out, with the main band of the thread */
+        /* each one was taken from */
+        void                    *hMutex;
         int                      nRefCountUnderlyingMainRasterBand;
+        GDALRasterBand         **papoUnderlyingBands;
+        GDALRasterBand         **papoUnderlyingMainBands;
 
     protected:
         virtual GDALRasterBand* RefUnderlyingRasterBand();
@@ -327,8 +329,12 @@ class GDALProxyPoolMaskBand : public GDALProxyPoolRasterBand
     private:
         GDALProxyPoolRasterBand *poMainBand;
 
-        GDALRasterBand          *poUnderlyingMainRasterBand;
+        /* underlying bands handed out, with the main band of the thread */
+        /* each one was taken from */
+        void                    *hMutex;
         int                      nRefCountUnderlyingMainRasterBand;
+        GDALRasterBand         **papoUnderlyingBands;
+        GDALRasterBand         **papoUnderlyingMainBands;
 
     protected:
         virtual GDALRasterBand* RefUnderlyingRasterBand();
@@ -365,6 +371,9 @@ void CPL_DLL GDALProxyPoolDatasetAddSrcBandDescription( GDALProxyPoolDatasetH hP
                                                         GDALDataType eDataType,
                                                         int nBlockXSize, int nBlockYSize);
 
+void CPL_DLL CPL_STDCALL GDALGetDatasetPoolStatistics( int *pnHits, int *pnOpens,
+                                                       int *pnEvictions, int *pnSize );
+
 CPL_C_END
 
 #endif /* GDAL_PROXY_H_INCLUDED */
@@ -403,16 +403,14 @@ void GDALDataset::BlockBasedFlushCache()
             for( iBand = 0; iBand < nBands; iBand++ )
             {
                 GDALRasterBand *poBand = GetRasterBand( iBand+1 );
-                
-                if( poBand->papoBlocks[iX + iY*poBand1->nBlocksPerRow] != NULL)
-                {
-                    CPLErr    eErr;
-                    
-                    eErr = poBand->FlushBlock( iX, iY );
+                CPLErr    eErr;
+
+                /* FlushBlock() is a no-op for blocks that are not cached, */
+                /* whatever the block index layout of the band is. */
+                eErr = poBand->FlushBlock( iX, iY );
                     
-                    if( eErr != CE_None )
-                        return;
-                }
+                if( eErr != CE_None )
+                    return;
             }
         }
     }
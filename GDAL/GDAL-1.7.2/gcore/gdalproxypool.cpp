@@ -50,9 +50,24 @@ GIntBig GDALGetResponsiblePIDForCurrentThread();
 /* This class is a singleton that maintains a pool of opened datasets */
 /* The cache uses a LRU strategy */
 
+/* Entries are found through a hash set keyed by (filename, responsiblePID). */
+/* Several entries may share the same key : an entry referenced by a thread */
+/* is not handed to another thread, which gets its own handle on the file */
+/* instead, since a GDALDataset must not be used by two threads at once. */
+
+/* Datasets are opened and closed without holding the mutex, so threads */
+/* only contend on it for the lookups and the LRU list maintenance. */
+
 class GDALDatasetPool;
 static GDALDatasetPool* singleton = NULL;
 
+/* Statistics, kept across the lifetimes of the singleton */
+static int nPoolHits = 0;
+static int nPoolOpens = 0;
+static int nPoolEvictions = 0;
+
+typedef struct _GDALProxyPoolCacheKey GDALProxyPoolCacheKey;
+
 struct _GDALProxyPoolCacheEntry
 {
     GIntBig       responsiblePID;
@@ -62,10 +77,55 @@ struct _GDALProxyPoolCacheEntry
     /* Ref count of the cached dataset */
     int           refCount;
 
+    /* Thread that holds the references, when refCount > 0 */
+    GIntBig       ownerPID;
+
+    GDALProxyPoolCacheKey* key;
+    GDALProxyPoolCacheEntry* nextSameKey;
+
     GDALProxyPoolCacheEntry* prev;
     GDALProxyPoolCacheEntry* next;
 };
 
+struct _GDALProxyPoolCacheKey
+{
+    char         *pszFileName;
+    GIntBig       responsiblePID;
+    GDALProxyPoolCacheEntry* firstEntry;
+};
+
+static unsigned long GDALProxyPoolHashKey(const void* elt)
+{
+    const GDALProxyPoolCacheKey* key = (const GDALProxyPoolCacheKey*) elt;
+    return CPLHashSetHashStr(key->pszFileName) ^ (unsigned long) key->responsiblePID;
+}
+
+static int GDALProxyPoolEqualKey(const void* elt1, const void* elt2)
+{
+    const GDALProxyPoolCacheKey* key1 = (const GDALProxyPoolCacheKey*) elt1;
+    const GDALProxyPoolCacheKey* key2 = (const GDALProxyPoolCacheKey*) elt2;
+    return key1->responsiblePID == key2->responsiblePID &&
+           strcmp(key1->pszFileName, key2->pszFileName) == 0;
+}
+
+static void GDALProxyPoolFreeKey(void* elt)
+{
+    GDALProxyPoolCacheKey* key = (GDALProxyPoolCacheKey*) elt;
+    CPLFree(key->pszFileName);
+    CPLFree(key);
+}
+
+static unsigned long GDALProxyPoolHashDataset(const void* elt)
+{
+    return CPLHashSetHashPointer(((const GDALProxyPoolCacheEntry*) elt)->poDS);
+}
+
+static int GDALProxyPoolEqualDataset(const void* elt1, const void* elt2)
+{
+    return ((const GDALProxyPoolCacheEntry*) elt1)->poDS ==
+           ((const GDALProxyPoolCacheEntry*) elt2)->poDS;
+}
+
 class GDALDatasetPool
 {
     private:
@@ -80,19 +140,33 @@ class GDALDatasetPool
         GDALProxyPoolCacheEntry* firstEntry;
         GDALProxyPoolCacheEntry* lastEntry;
 
-        /* This variable prevents a dataset that is going to be opened in GDALDatasetPool::_RefDataset */
+        /* (filename, responsiblePID) -> GDALProxyPoolCacheKey */
+        CPLHashSet* keySet;
+        /* poDS -> GDALProxyPoolCacheEntry */
+        CPLHashSet* datasetSet;
+
+        /* This prevents a dataset that is going to be opened in GDALDatasetPool::_RefDataset */
         /* from increasing refCount if, during its opening, it creates a GDALProxyPoolDataset */
-        /* We increment it before opening or closing a cached dataset and decrement it afterwards */
+        /* We push the PID of the thread before opening or closing a cached dataset and pop it afterwards */
         /* The typical use case is a VRT made of simple sources that are VRT */
         /* We don't want the "inner" VRT to take a reference on the pool, otherwise there is */
         /* a high chance that this reference will not be dropped and the pool remain ghost */
+        /* As datasets are opened without holding the mutex, this is tracked per thread */
         int refCountOfDisableRefCount;
+        GIntBig* disableRefCountPIDs;
 
         /* Caution : to be sure that we don't run out of entries, size must be at */
         /* least greater or equal than the maximum number of threads */
         GDALDatasetPool(int maxSize);
         ~GDALDatasetPool();
         GDALProxyPoolCacheEntry* _RefDataset(const char* pszFileName, GDALAccess eAccess);
+        GDALProxyPoolCacheEntry* _FindEntry(GDALDataset* poDS);
+
+        void MoveToFront(GDALProxyPoolCacheEntry* cur);
+        void Detach(GDALProxyPoolCacheEntry* cur);
+        void DisableRefCount();
+        void EnableRefCount();
+        int  IsRefCountDisabled();
 
         void ShowContent();
         void CheckLinks();
@@ -102,6 +176,9 @@ class GDALDatasetPool
         static void Unref();
         static GDALProxyPoolCacheEntry* RefDataset(const char* pszFileName, GDALAccess eAccess);
         static void UnrefDataset(GDALProxyPoolCacheEntry* cacheEntry);
+        static void UnrefDataset(GDALDataset* poDS);
+        static void GetStatistics(int *pnHits, int *pnOpens,
+                                  int *pnEvictions, int *pnSize);
 };
 
 
@@ -117,6 +194,11 @@ GDALDatasetPool::GDALDatasetPool(int maxSize)
     lastEntry = NULL;
     refCount = 0;
     refCountOfDisableRefCount = 0;
+    disableRefCountPIDs = NULL;
+    keySet = CPLHashSetNew(GDALProxyPoolHashKey, GDALProxyPoolEqualKey,
+                           GDALProxyPoolFreeKey);
+    datasetSet = CPLHashSetNew(GDALProxyPoolHashDataset,
+                               GDALProxyPoolEqualDataset, NULL);
 }
 
 /************************************************************************/
@@ -141,6 +223,14 @@ GDALDatasetPool::~GDALDatasetPool()
         cur = next;
     }
     GDALSetResponsiblePIDForCurrentThread(responsiblePID);
+
+    CPLHashSetDestroy(keySet);
+    CPLHashSetDestroy(datasetSet);
+    CPLFree(disableRefCountPIDs);
+
+    if (nPoolOpens > 0)
+        CPLDebug("GDAL", "Dataset pool: %d hits, %d opens, %d evictions.",
+                 nPoolHits, nPoolOpens, nPoolEvictions);
 }
 
 /************************************************************************/
@@ -153,8 +243,9 @@ void GDALDatasetPool::ShowContent()
     int i = 0;
     while(cur)
     {
-        printf("[%d] pszFileName=%s, refCount=%d, responsiblePID=%d\n",
-               i, cur->pszFileName, cur->refCount, (int)cur->responsiblePID);
+        printf("[%d] pszFileName=%s, refCount=%d, responsiblePID=%d, ownerPID=%d\n",
+               i, cur->pszFileName, cur->refCount, (int)cur->responsiblePID,
+               (int)cur->ownerPID);
         i++;
         cur = cur->next;
     }
@@ -180,53 +271,168 @@ void GDALDatasetPool::CheckLinks()
 }
 
 /************************************************************************/
-/*                            _RefDataset()                             */
+/*                            MoveToFront()                             */
 /************************************************************************/
 
-GDALProxyPoolCacheEntry* GDALDatasetPool::_RefDataset(const char* pszFileName, GDALAccess eAccess)
+void GDALDatasetPool::MoveToFront(GDALProxyPoolCacheEntry* cur)
 {
-    GDALProxyPoolCacheEntry* cur = firstEntry;
-    GIntBig responsiblePID = GDALGetResponsiblePIDForCurrentThread();
-    GDALProxyPoolCacheEntry* lastEntryWithZeroRefCount = NULL;
-
-    while(cur)
-    {
-        GDALProxyPoolCacheEntry* next = cur->next;
+    if (cur == firstEntry)
+        return;
 
-        if (strcmp(cur->pszFileName, pszFileName) == 0 &&
-            cur->responsiblePID == responsiblePID)
-        {
-            if (cur != firstEntry)
-            {
-                /* Move to begin */
-                if (cur->next)
-                    cur->next->prev = cur->prev;
-                else
-                    lastEntry = cur->prev;
-                cur->prev->next = cur->next;
-                cur->prev = NULL;
-                firstEntry->prev = cur;
-                cur->next = firstEntry;
-                firstEntry = cur;
+    if (cur->next)
+        cur->next->prev = cur->prev;
+    else
+        lastEntry = cur->prev;
+    cur->prev->next = cur->next;
+    cur->prev = NULL;
+    firstEntry->prev = cur;
+    cur->next = firstEntry;
+    firstEntry = cur;
 
 #ifdef DEBUG_PROXY_POOL
-                CheckLinks();
+    CheckLinks();
 #endif
-            }
+}
+
+/************************************************************************/
+/*                               Detach()                               */
+/*                                                                      */
+/*      Remove an entry from the lookup sets, so that it is no longer   */
+/*      found by _RefDataset() and _FindEntry().  It stays in the       */
+/*      LRU list.                                                       */
+/************************************************************************/
 
-            cur->refCount ++;
-            return cur;
+void GDALDatasetPool::Detach(GDALProxyPoolCacheEntry* cur)
+{
+    GDALProxyPoolCacheKey* key = cur->key;
+
+    if (key != NULL)
+    {
+        GDALProxyPoolCacheEntry** ppsLink = &(key->firstEntry);
+        while (*ppsLink != cur)
+            ppsLink = &((*ppsLink)->nextSameKey);
+        *ppsLink = cur->nextSameKey;
+
+        if (key->firstEntry == NULL)
+            CPLHashSetRemove(keySet, key);
+
+        cur->key = NULL;
+        cur->nextSameKey = NULL;
+    }
+
+    if (cur->poDS != NULL)
+        CPLHashSetRemove(datasetSet, cur);
+}
+
+/************************************************************************/
+/*                          DisableRefCount()                           */
+/************************************************************************/
+
+void GDALDatasetPool::DisableRefCount()
+{
+    disableRefCountPIDs = (GIntBig*) CPLRealloc(disableRefCountPIDs,
+                            sizeof(GIntBig) * (refCountOfDisableRefCount + 1));
+    disableRefCountPIDs[refCountOfDisableRefCount++] = CPLGetPID();
+}
+
+/************************************************************************/
+/*                           EnableRefCount()                           */
+/************************************************************************/
+
+void GDALDatasetPool::EnableRefCount()
+{
+    GIntBig nPID = CPLGetPID();
+    for (int i = refCountOfDisableRefCount - 1; i >= 0; i--)
+    {
+        if (disableRefCountPIDs[i] == nPID)
+        {
+            disableRefCountPIDs[i] = disableRefCountPIDs[--refCountOfDisableRefCount];
+            return;
         }
+    }
+    CPLAssert(0);
+}
 
-        if (cur->refCount == 0)
-            lastEntryWithZeroRefCount = cur;
+/************************************************************************/
+/*                         IsRefCountDisabled()                         */
+/************************************************************************/
 
-        cur = next;
+int GDALDatasetPool::IsRefCountDisabled()
+{
+    GIntBig nPID = CPLGetPID();
+    for (int i = 0; i < refCountOfDisableRefCount; i++)
+    {
+        if (disableRefCountPIDs[i] == nPID)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/************************************************************************/
+/*                    GDALDatasetPoolReacquireMutex()                   */
+/*                                                                      */
+/*      Take back the mutex released while opening or closing a         */
+/*      dataset.  The pool must not be touched without it, so keep      */
+/*      waiting if the acquisition times out.                           */
+/************************************************************************/
+
+static void GDALDatasetPoolReacquireMutex()
+{
+    while (!CPLAcquireMutex(*GDALGetphDLMutex(), 1000.0))
+    {
+        CPLDebug("GDAL", "GDALDatasetPool: still waiting for the dataset "
+                 "list mutex.");
     }
+}
 
+/************************************************************************/
+/*                            _RefDataset()                             */
+/*                                                                      */
+/*      Called with the mutex held.  The mutex is released while the    */
+/*      evicted dataset is closed and the new one is opened.            */
+/************************************************************************/
+
+GDALProxyPoolCacheEntry* GDALDatasetPool::_RefDataset(const char* pszFileName, GDALAccess eAccess)
+{
+    GIntBig responsiblePID = GDALGetResponsiblePIDForCurrentThread();
+    GIntBig currentPID = CPLGetPID();
+    GDALProxyPoolCacheEntry* cur;
+
+/* -------------------------------------------------------------------- */
+/*      Look for an entry of that file that is not in use by another    */
+/*      thread.                                                         */
+/* -------------------------------------------------------------------- */
+    GDALProxyPoolCacheKey sKey;
+    sKey.pszFileName = (char*) pszFileName;
+    sKey.responsiblePID = responsiblePID;
+
+    GDALProxyPoolCacheKey* key = (GDALProxyPoolCacheKey*) CPLHashSetLookup(keySet, &sKey);
+    if (key != NULL)
+    {
+        for (cur = key->firstEntry; cur != NULL; cur = cur->nextSameKey)
+        {
+            if (cur->refCount == 0 || cur->ownerPID == currentPID)
+            {
+                MoveToFront(cur);
+                cur->refCount ++;
+                cur->ownerPID = currentPID;
+                nPoolHits ++;
+                return cur;
+            }
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Recycle the least recently used entry that is not in use, or    */
+/*      allocate a new one.                                             */
+/* -------------------------------------------------------------------- */
     if (currentSize == maxSize)
     {
-        if (lastEntryWithZeroRefCount == NULL)
+        cur = lastEntry;
+        while (cur != NULL && cur->refCount != 0)
+            cur = cur->prev;
+
+        if (cur == NULL)
         {
             CPLError(CE_Failure, CPLE_AppDefined,
                      "Too many threads are running for the current value of the dataset pool size (%d).\n"
@@ -235,48 +441,39 @@ GDALProxyPoolCacheEntry* GDALDatasetPool::_RefDataset(const char* pszFileName, G
             return NULL;
         }
 
-        CPLFree(lastEntryWithZeroRefCount->pszFileName);
-        lastEntryWithZeroRefCount->pszFileName = NULL;
-        if (lastEntryWithZeroRefCount->poDS)
+        Detach(cur);
+        MoveToFront(cur);
+
+        /* Mark the entry as in use, so that no other thread recycles it */
+        /* while we close its dataset */
+        cur->refCount = 1;
+        cur->ownerPID = currentPID;
+        nPoolEvictions ++;
+
+        CPLFree(cur->pszFileName);
+        cur->pszFileName = NULL;
+        if (cur->poDS)
         {
             /* Close by pretending we are the thread that GDALOpen'ed this */
             /* dataset */
-            GDALSetResponsiblePIDForCurrentThread(lastEntryWithZeroRefCount->responsiblePID);
+            GDALDataset* poDSToClose = cur->poDS;
+            cur->poDS = NULL;
 
-            refCountOfDisableRefCount ++;
-            GDALClose(lastEntryWithZeroRefCount->poDS);
-            refCountOfDisableRefCount --;
+            GDALSetResponsiblePIDForCurrentThread(cur->responsiblePID);
 
-            lastEntryWithZeroRefCount->poDS = NULL;
-            GDALSetResponsiblePIDForCurrentThread(responsiblePID);
-        }
+            DisableRefCount();
+            CPLReleaseMutex(*GDALGetphDLMutex());
+            GDALClose(poDSToClose);
+            GDALDatasetPoolReacquireMutex();
+            EnableRefCount();
 
-        /* Recycle this entry for the to-be-openeded dataset and */
-        /* moves it to the top of the list */
-        if (lastEntryWithZeroRefCount->prev)
-            lastEntryWithZeroRefCount->prev->next = lastEntryWithZeroRefCount->next;
-        else
-            CPLAssert(0);
-        if (lastEntryWithZeroRefCount->next)
-            lastEntryWithZeroRefCount->next->prev = lastEntryWithZeroRefCount->prev;
-        else
-        {
-            CPLAssert(lastEntryWithZeroRefCount == lastEntry);
-            lastEntry->prev->next = NULL;
-            lastEntry = lastEntry->prev;
+            GDALSetResponsiblePIDForCurrentThread(responsiblePID);
         }
-        lastEntryWithZeroRefCount->prev = NULL;
-        lastEntryWithZeroRefCount->next = firstEntry;
-        firstEntry->prev = lastEntryWithZeroRefCount;
-        cur = firstEntry = lastEntryWithZeroRefCount;
-#ifdef DEBUG_PROXY_POOL
-        CheckLinks();
-#endif
     }
     else
     {
         /* Prepend */
-        cur = (GDALProxyPoolCacheEntry*) CPLMalloc(sizeof(GDALProxyPoolCacheEntry));
+        cur = (GDALProxyPoolCacheEntry*) CPLCalloc(1, sizeof(GDALProxyPoolCacheEntry));
         if (lastEntry == NULL)
             lastEntry = cur;
         cur->prev = NULL;
@@ -293,14 +490,55 @@ GDALProxyPoolCacheEntry* GDALDatasetPool::_RefDataset(const char* pszFileName, G
     cur->pszFileName = CPLStrdup(pszFileName);
     cur->responsiblePID = responsiblePID;
     cur->refCount = 1;
-
-    refCountOfDisableRefCount ++;
-    cur->poDS = (GDALDataset*) GDALOpen(pszFileName, eAccess);
-    refCountOfDisableRefCount --;
+    cur->ownerPID = currentPID;
+    nPoolOpens ++;
+
+/* -------------------------------------------------------------------- */
+/*      Open without holding the mutex.  The entry is referenced by     */
+/*      the current thread, so it cannot be recycled meanwhile.         */
+/* -------------------------------------------------------------------- */
+    DisableRefCount();
+    CPLReleaseMutex(*GDALGetphDLMutex());
+    GDALDataset* poDS = (GDALDataset*) GDALOpen(pszFileName, eAccess);
+    GDALDatasetPoolReacquireMutex();
+    EnableRefCount();
+
+    cur->poDS = poDS;
+    if (poDS != NULL)
+        CPLHashSetInsert(datasetSet, cur);
+
+/* -------------------------------------------------------------------- */
+/*      Register the entry under its key.  The key may have been        */
+/*      created or removed by another thread meanwhile.                 */
+/* -------------------------------------------------------------------- */
+    key = (GDALProxyPoolCacheKey*) CPLHashSetLookup(keySet, &sKey);
+    if (key == NULL)
+    {
+        key = (GDALProxyPoolCacheKey*) CPLMalloc(sizeof(GDALProxyPoolCacheKey));
+        key->pszFileName = CPLStrdup(pszFileName);
+        key->responsiblePID = responsiblePID;
+        key->firstEntry = NULL;
+        CPLHashSetInsert(keySet, key);
+    }
+    cur->key = key;
+    cur->nextSameKey = key->firstEntry;
+    key->firstEntry = cur;
 
     return cur;
 }
 
+/************************************************************************/
+/*                             _FindEntry()                             */
+/************************************************************************/
+
+GDALProxyPoolCacheEntry* GDALDatasetPool::_FindEntry(GDALDataset* poDS)
+{
+    GDALProxyPoolCacheEntry sEntry;
+    sEntry.poDS = poDS;
+
+    return (GDALProxyPoolCacheEntry*) CPLHashSetLookup(datasetSet, &sEntry);
+}
+
 /************************************************************************/
 /*                                 Ref()                                */
 /************************************************************************/
@@ -311,11 +549,11 @@ void GDALDatasetPool::Ref()
     if (singleton == NULL)
     {
         int maxSize = atoi(CPLGetConfigOption("GDAL_MAX_DATASET_POOL_SIZE", "100"));
-        if (maxSize < 2 || maxSize > 1000)
+        if (maxSize < 2 || maxSize > 100000)
             maxSize = 100;
         singleton = new GDALDatasetPool(maxSize);
     }
-    if (singleton->refCountOfDisableRefCount == 0)
+    if (!singleton->IsRefCountDisabled())
       singleton->refCount++;
 }
 
@@ -331,7 +569,7 @@ void GDALDatasetPool::Unref()
         CPLAssert(0);
         return;
     }
-    if (singleton->refCountOfDisableRefCount == 0)
+    if (!singleton->IsRefCountDisabled())
     {
       singleton->refCount--;
       if (singleton->refCount == 0)
@@ -359,9 +597,67 @@ GDALProxyPoolCacheEntry* GDALDatasetPool::RefDataset(const char* pszFileName, GD
 void GDALDatasetPool::UnrefDataset(GDALProxyPoolCacheEntry* cacheEntry)
 {
     CPLMutexHolderD( GDALGetphDLMutex() );
+    CPLAssert(cacheEntry->refCount > 0 && cacheEntry->ownerPID == CPLGetPID());
     cacheEntry->refCount --;
 }
 
+/************************************************************************/
+/*                       UnrefDataset()                                 */
+/************************************************************************/
+
+void GDALDatasetPool::UnrefDataset(GDALDataset* poDS)
+{
+    CPLMutexHolderD( GDALGetphDLMutex() );
+    GDALProxyPoolCacheEntry* cacheEntry = singleton->_FindEntry(poDS);
+    if (cacheEntry == NULL)
+    {
+        CPLAssert(0);
+        return;
+    }
+    CPLAssert(cacheEntry->refCount > 0 && cacheEntry->ownerPID == CPLGetPID());
+    cacheEntry->refCount --;
+}
+
+/************************************************************************/
+/*                          GetStatistics()                             */
+/************************************************************************/
+
+void GDALDatasetPool::GetStatistics(int *pnHits, int *pnOpens,
+                                    int *pnEvictions, int *pnSize)
+{
+    CPLMutexHolderD( GDALGetphDLMutex() );
+    if (pnHits)
+        *pnHits = nPoolHits;
+    if (pnOpens)
+        *pnOpens = nPoolOpens;
+    if (pnEvictions)
+        *pnEvictions = nPoolEvictions;
+    if (pnSize)
+        *pnSize = singleton ? singleton->currentSize : 0;
+}
+
+/************************************************************************/
+/*                  GDALGetDatasetPoolStatistics()                      */
+/************************************************************************/
+
+/**
+ * Fetch the counters of the pool of datasets opened by GDALProxyPoolDataset.
+ *
+ * The counters accumulate since the start of the process.
+ *
+ * @param pnHits number of times an already opened dataset was reused, or NULL.
+ * @param pnOpens number of datasets opened by the pool, or NULL.
+ * @param pnEvictions number of datasets closed to make room for another one,
+ * or NULL.
+ * @param pnSize number of datasets currently in the pool, or NULL.
+ */
+
+void CPL_STDCALL GDALGetDatasetPoolStatistics( int *pnHits, int *pnOpens,
+                                               int *pnEvictions, int *pnSize )
+{
+    GDALDatasetPool::GetStatistics(pnHits, pnOpens, pnEvictions, pnSize);
+}
+
 CPL_C_START
 
 typedef struct
@@ -481,7 +777,6 @@ GDALProxyPoolDataset::GDALProxyPoolDataset(const char* pszSourceDatasetDescripti
     pasGCPList = NULL;
     metadataSet = NULL;
     metadataItemSet = NULL;
-    cacheEntry = NULL;
 }
 
 /************************************************************************/
@@ -532,7 +827,8 @@ GDALDataset* GDALProxyPoolDataset::RefUnderlyingDataset()
     /* a VRT of GeoTIFFs that have associated .aux files */
     GIntBig curResponsiblePID = GDALGetResponsiblePIDForCurrentThread();
     GDALSetResponsiblePIDForCurrentThread(responsiblePID);
-    cacheEntry = GDALDatasetPool::RefDataset(GetDescription(), eAccess);
+    GDALProxyPoolCacheEntry* cacheEntry =
+        GDALDatasetPool::RefDataset(GetDescription(), eAccess);
     GDALSetResponsiblePIDForCurrentThread(curResponsiblePID);
     if (cacheEntry != NULL)
     {
@@ -550,12 +846,10 @@ GDALDataset* GDALProxyPoolDataset::RefUnderlyingDataset()
 
 void GDALProxyPoolDataset::UnrefUnderlyingDataset(GDALDataset* poUnderlyingDataset)
 {
-    if (cacheEntry != NULL)
-    {
-        CPLAssert(cacheEntry->poDS == poUnderlyingDataset);
-        if (cacheEntry->poDS != NULL)
-            GDALDatasetPool::UnrefDataset(cacheEntry);
-    }
+    /* Several threads may each have their own underlying dataset for */
+    /* this object, so the pool entry is found from the dataset */
+    if (poUnderlyingDataset != NULL)
+        GDALDatasetPool::UnrefDataset(poUnderlyingDataset);
 }
 
 /************************************************************************/
@@ -1069,6 +1363,57 @@ GDALRasterBand *GDALProxyPoolRasterBand::GetMaskBand()
     return poProxyMaskBand;
 }
 
+/************************************************************************/
+/*                      GDALProxyPoolPushMainBand()                     */
+/*                                                                      */
+/*      Remember the main band of the current thread an overview or     */
+/*      mask band was taken from, since several threads may use the     */
+/*      proxy band, each with its own underlying dataset.               */
+/************************************************************************/
+
+static void GDALProxyPoolPushMainBand(void** phMutex, int* pnCount,
+                                      GDALRasterBand*** ppapoBands,
+                                      GDALRasterBand*** ppapoMainBands,
+                                      GDALRasterBand* poBand,
+                                      GDALRasterBand* poMainBand)
+{
+    CPLMutexHolderD( phMutex );
+    *ppapoBands = (GDALRasterBand**)
+        CPLRealloc(*ppapoBands, (*pnCount + 1) * sizeof(GDALRasterBand*));
+    *ppapoMainBands = (GDALRasterBand**)
+        CPLRealloc(*ppapoMainBands, (*pnCount + 1) * sizeof(GDALRasterBand*));
+    (*ppapoBands)[*pnCount] = poBand;
+    (*ppapoMainBands)[*pnCount] = poMainBand;
+    (*pnCount) ++;
+}
+
+/************************************************************************/
+/*                      GDALProxyPoolPopMainBand()                      */
+/************************************************************************/
+
+static GDALRasterBand* GDALProxyPoolPopMainBand(void** phMutex, int* pnCount,
+                                                GDALRasterBand*** ppapoBands,
+                                                GDALRasterBand*** ppapoMainBands,
+                                                GDALRasterBand* poBand)
+{
+    CPLMutexHolderD( phMutex );
+    GDALRasterBand** papoBands = *ppapoBands;
+    GDALRasterBand** papoMainBands = *ppapoMainBands;
+    for (int i = *pnCount - 1; i >= 0; i--)
+    {
+        if (papoBands[i] == poBand)
+        {
+            GDALRasterBand* poMainBand = papoMainBands[i];
+            (*pnCount) --;
+            papoBands[i] = papoBands[*pnCount];
+            papoMainBands[i] = papoMainBands[*pnCount];
+            return poMainBand;
+        }
+    }
+    CPLAssert(0);
+    return NULL;
+}
+
 /* ******************************************************************** */
 /*             GDALProxyPoolOverviewRasterBand()                        */
 /* ******************************************************************** */
@@ -1082,8 +1427,10 @@ GDALProxyPoolOverviewRasterBand::GDALProxyPoolOverviewRasterBand(GDALProxyPoolDa
     this->poMainBand = poMainBand;
     this->nOverviewBand = nOverviewBand;
 
-    poUnderlyingMainRasterBand = NULL;
+    hMutex = NULL;
     nRefCountUnderlyingMainRasterBand = 0;
+    papoUnderlyingBands = NULL;
+    papoUnderlyingMainBands = NULL;
 }
 
 /* ******************************************************************** */
@@ -1093,6 +1440,10 @@ GDALProxyPoolOverviewRasterBand::GDALProxyPoolOverviewRasterBand(GDALProxyPoolDa
 GDALProxyPoolOverviewRasterBand::~GDALProxyPoolOverviewRasterBand()
 {
     CPLAssert(nRefCountUnderlyingMainRasterBand == 0);
+    CPLFree(papoUnderlyingBands);
+    CPLFree(papoUnderlyingMainBands);
+    if (hMutex != NULL)
+        CPLDestroyMutex(hMutex);
 }
 
 /* ******************************************************************** */
@@ -1101,12 +1452,21 @@ GDALProxyPoolOverviewRasterBand::~GDALProxyPoolOverviewRasterBand()
 
 GDALRasterBand* GDALProxyPoolOverviewRasterBand::RefUnderlyingRasterBand()
 {
-    poUnderlyingMainRasterBand = poMainBand->RefUnderlyingRasterBand();
+    GDALRasterBand* poUnderlyingMainRasterBand = poMainBand->RefUnderlyingRasterBand();
     if (poUnderlyingMainRasterBand == NULL)
         return NULL;
 
-    nRefCountUnderlyingMainRasterBand ++;
-    return poUnderlyingMainRasterBand->GetOverview(nOverviewBand);
+    GDALRasterBand* poUnderlyingRasterBand = poUnderlyingMainRasterBand->GetOverview(nOverviewBand);
+    if (poUnderlyingRasterBand == NULL)
+    {
+        poMainBand->UnrefUnderlyingRasterBand(poUnderlyingMainRasterBand);
+        return NULL;
+    }
+
+    GDALProxyPoolPushMainBand(&hMutex, &nRefCountUnderlyingMainRasterBand,
+                              &papoUnderlyingBands, &papoUnderlyingMainBands,
+                              poUnderlyingRasterBand, poUnderlyingMainRasterBand);
+    return poUnderlyingRasterBand;
 }
 
 /* ******************************************************************** */
@@ -1115,8 +1475,15 @@ GDALRasterBand* GDALProxyPoolOverviewRasterBand::RefUnderlyingRasterBand()
 
 void GDALProxyPoolOverviewRasterBand::UnrefUnderlyingRasterBand(GDALRasterBand* poUnderlyingRasterBand)
 {
-    poMainBand->UnrefUnderlyingRasterBand(poUnderlyingMainRasterBand);
-    nRefCountUnderlyingMainRasterBand --;
+    if (poUnderlyingRasterBand == NULL)
+        return;
+
+    GDALRasterBand* poUnderlyingMainRasterBand =
+        GDALProxyPoolPopMainBand(&hMutex, &nRefCountUnderlyingMainRasterBand,
+                                 &papoUnderlyingBands, &papoUnderlyingMainBands,
+                                 poUnderlyingRasterBand);
+    if (poUnderlyingMainRasterBand != NULL)
+        poMainBand->UnrefUnderlyingRasterBand(poUnderlyingMainRasterBand);
 }
 
 
@@ -1131,8 +1498,10 @@ GDALProxyPoolMaskBand::GDALProxyPoolMaskBand(GDALProxyPoolDataset* poDS,
 {
     this->poMainBand = poMainBand;
 
-    poUnderlyingMainRasterBand = NULL;
+    hMutex = NULL;
     nRefCountUnderlyingMainRasterBand = 0;
+    papoUnderlyingBands = NULL;
+    papoUnderlyingMainBands = NULL;
 }
 
 /* ******************************************************************** */
@@ -1142,6 +1511,10 @@ GDALProxyPoolMaskBand::GDALProxyPoolMaskBand(GDALProxyPoolDataset* poDS,
 GDALProxyPoolMaskBand::~GDALProxyPoolMaskBand()
 {
     CPLAssert(nRefCountUnderlyingMainRasterBand == 0);
+    CPLFree(papoUnderlyingBands);
+    CPLFree(papoUnderlyingMainBands);
+    if (hMutex != NULL)
+        CPLDestroyMutex(hMutex);
 }
 
 /* ******************************************************************** */
@@ -1150,12 +1523,21 @@ GDALProxyPoolMaskBand::~GDALProxyPoolMaskBand()
 
 GDALRasterBand* GDALProxyPoolMaskBand::RefUnderlyingRasterBand()
 {
-    poUnderlyingMainRasterBand = poMainBand->RefUnderlyingRasterBand();
+    GDALRasterBand* poUnderlyingMainRasterBand = poMainBand->RefUnderlyingRasterBand();
     if (poUnderlyingMainRasterBand == NULL)
         return NULL;
 
-    nRefCountUnderlyingMainRasterBand ++;
-    return poUnderlyingMainRasterBand->GetMaskBand();
+    GDALRasterBand* poUnderlyingRasterBand = poUnderlyingMainRasterBand->GetMaskBand();
+    if (poUnderlyingRasterBand == NULL)
+    {
+        poMainBand->UnrefUnderlyingRasterBand(poUnderlyingMainRasterBand);
+        return NULL;
+    }
+
+    GDALProxyPoolPushMainBand(&hMutex, &nRefCountUnderlyingMainRasterBand,
+                              &papoUnderlyingBands, &papoUnderlyingMainBands,
+                              poUnderlyingRasterBand, poUnderlyingMainRasterBand);
+    return poUnderlyingRasterBand;
 }
 
 /* ******************************************************************** */
@@ -1164,6 +1546,13 @@ GDALRasterBand* GDALProxyPoolMaskBand::RefUnderlyingRasterBand()
 
 void GDALProxyPoolMaskBand::UnrefUnderlyingRasterBand(GDALRasterBand* poUnderlyingRasterBand)
 {
-    poMainBand->UnrefUnderlyingRasterBand(poUnderlyingMainRasterBand);
-    nRefCountUnderlyingMainRasterBand --;
+    if (poUnderlyingRasterBand == NULL)
+        return;
+
+    GDALRasterBand* poUnderlyingMainRasterBand =
+        GDALProxyPoolPopMainBand(&hMutex, &nRefCountUnderlyingMainRasterBand,
+                                 &papoUnderlyingBands, &papoUnderlyingMainBands,
+                                 poUnderlyingRasterBand);
+    if (poUnderlyingMainRasterBand != NULL)
+        poMainBand->UnrefUnderlyingRasterBand(poUnderlyingMainRasterBand);
 }
@@ -31,11 +31,55 @@
 #include "gdal_priv.h"
 #include "gdal_rat.h"
 #include "cpl_string.h"
+#include "cpl_multiproc.h"
 
 #define SUBBLOCK_SIZE 64
 #define TO_SUBBLOCK(x) ((x) >> 6)
 #define WITHIN_SUBBLOCK(x) ((x) & 0x3f)
 
+/* Bands with more blocks than this use a hashed block index by default */
+#define BLOCK_HASH_THRESHOLD (1024*1024)
+
+/* -------------------------------------------------------------------- */
+/*      Entries of the sparse block index (hBlockHash).  Only blocks    */
+/*      currently in the cache have an entry, so memory use does not    */
+/*      depend on the raster size.                                      */
+/* -------------------------------------------------------------------- */
+typedef struct
+{
+    int              nXOff;
+    int              nYOff;
+    GDALRasterBlock *poBlock;
+} GDALBlockHashEntry;
+
+static unsigned long GDALBlockHashEntryHash( const void *elt )
+{
+    const GDALBlockHashEntry *psEntry = (const GDALBlockHashEntry *) elt;
+
+    return ((unsigned long) psEntry->nYOff * 73856093UL)
+        ^ ((unsigned long) psEntry->nXOff * 19349663UL);
+}
+
+static int GDALBlockHashEntryEqual( const void *elt1, const void *elt2 )
+{
+    const GDALBlockHashEntry *psEntry1 = (const GDALBlockHashEntry *) elt1;
+    const GDALBlockHashEntry *psEntry2 = (const GDALBlockHashEntry *) elt2;
+
+    return psEntry1->nXOff == psEntry2->nXOff
+        && psEntry1->nYOff == psEntry2->nYOff;
+}
+
+static int GDALBlockHashEntryCollect( void *elt, void *user_data )
+{
+    const GDALBlockHashEntry *psEntry = (const GDALBlockHashEntry *) elt;
+    std::vector<int> *panOffsets = (std::vector<int> *) user_data;
+
+    panOffsets->push_back( psEntry->nXOff );
+    panOffsets->push_back( psEntry->nYOff );
+
+    return TRUE;
+}
+
 // Number of data samples that will be used to compute approximate statistics
 // (minimum value, maximum value, etc.)
 #define GDALSTAT_APPROX_NUMSAMPLES 2500
@@ -64,6 +108,8 @@ GDALRasterBand::GDALRasterBand()
 
     bSubBlockingActive = FALSE;
     papoBlocks = NULL;
+    hBlockHash = NULL;
+    hBlockHashMutex = NULL;
 
     poMask = NULL;
     bOwnMask = false;
@@ -87,6 +133,10 @@ GDALRasterBand::~GDALRasterBand()
     FlushCache();
 
     CPLFree( papoBlocks );
+    if( hBlockHash != NULL )
+        CPLHashSetDestroy( hBlockHash );
+    if( hBlockHashMutex != NULL )
+        CPLDestroyMutex( hBlockHashMutex );
 
     if( nBlockReads > nBlocksPerRow * nBlocksPerColumn
         && nBand == 1 && poDS != NULL )
@@ -651,7 +701,7 @@ GDALGetBlockSize( GDALRasterBandH hBand, int * pnXSize, int * pnYSize )
 int GDALRasterBand::InitBlockInfo()
 
 {
-    if( papoBlocks != NULL )
+    if( papoBlocks != NULL || hBlockHash != NULL )
         return TRUE;
 
     /* Do some validation of raster and block dimensions in case the driver */
@@ -705,6 +755,32 @@ int GDALRasterBand::InitBlockInfo()
 
     nBlocksPerRow = (nRasterXSize+nBlockXSize-1) / nBlockXSize;
     nBlocksPerColumn = (nRasterYSize+nBlockYSize-1) / nBlockYSize;
+
+/* -------------------------------------------------------------------- */
+/*      For very large bands, use a hashed index of the cached blocks   */
+/*      rather than pointer arrays over all blocks.  This can be        */
+/*      controlled with GDAL_BAND_BLOCK_CACHE=ARRAY/HASHSET/AUTO.       */
+/* -------------------------------------------------------------------- */
+    const char *pszBlockCache = 
+        CPLGetConfigOption( "GDAL_BAND_BLOCK_CACHE", "AUTO" );
+    int bUseHash;
+
+    if( EQUAL(pszBlockCache, "HASHSET") )
+        bUseHash = TRUE;
+    else if( EQUAL(pszBlockCache, "ARRAY") )
+        bUseHash = FALSE;
+    else
+        bUseHash = ((double) nBlocksPerRow) * nBlocksPerColumn 
+            > BLOCK_HASH_THRESHOLD;
+
+    if( bUseHash )
+    {
+        bSubBlockingActive = FALSE;
+
+        hBlockHash = CPLHashSetNew( GDALBlockHashEntryHash, 
+                                    GDALBlockHashEntryEqual, CPLFree );
+        return TRUE;
+    }
     
     if( nBlocksPerRow < SUBBLOCK_SIZE/2 )
     {
@@ -780,11 +856,74 @@ int GDALRasterBand::InitBlockInfo()
 CPLErr GDALRasterBand::AdoptBlock( int nXBlockOff, int nYBlockOff,
                                    GDALRasterBlock * poBlock )
 
+{
+    GDALRasterBlock *poCachedBlock = NULL;
+    CPLErr eErr = AdoptBlock( nXBlockOff, nYBlockOff, poBlock, 
+                              &poCachedBlock );
+
+    if( eErr != CE_None || poCachedBlock == NULL )
+        return eErr;
+
+    poCachedBlock->DropLock();
+    CPLError( CE_Failure, CPLE_AppDefined,
+              "AdoptBlock(): block %d,%d is already cached.", 
+              nXBlockOff, nYBlockOff );
+    return CE_Failure;
+}
+
+/************************************************************************/
+/*                             AdoptBlock()                             */
+/*                                                                      */
+/*      Same as above, but when another thread has cached a block at    */
+/*      the same offsets meanwhile, that block is left in place,        */
+/*      locked and returned in *ppoCachedBlock, and poBlock is not      */
+/*      adopted.  A block already in the cache is never replaced, as    */
+/*      another thread may hold it.                                     */
+/************************************************************************/
+
+CPLErr GDALRasterBand::AdoptBlock( int nXBlockOff, int nYBlockOff,
+                                   GDALRasterBlock * poBlock,
+                                   GDALRasterBlock ** ppoCachedBlock )
+
 {
     int         nBlockIndex;
     
+    *ppoCachedBlock = NULL;
+
     if( !InitBlockInfo() )
         return CE_Failure;
+
+/* -------------------------------------------------------------------- */
+/*      Hashed block index.  The index mutex is held while checking     */
+/*      for an entry, so that two threads adopting the same block       */
+/*      end up with the same one.                                       */
+/* -------------------------------------------------------------------- */
+    if( hBlockHash != NULL )
+    {
+        CPLMutexHolderD( &hBlockHashMutex );
+
+        GDALBlockHashEntry sKey, *psEntry;
+
+        sKey.nXOff = nXBlockOff;
+        sKey.nYOff = nYBlockOff;
+
+        psEntry = (GDALBlockHashEntry *) 
+            CPLHashSetLookup( hBlockHash, &sKey );
+        if( psEntry == NULL )
+        {
+            psEntry = (GDALBlockHashEntry *) 
+                CPLMalloc(sizeof(GDALBlockHashEntry));
+            psEntry->nXOff = nXBlockOff;
+            psEntry->nYOff = nYBlockOff;
+            psEntry->poBlock = NULL;
+            CPLHashSetInsert( hBlockHash, psEntry );
+        }
+
+        *ppoCachedBlock = 
+            GDALRasterBlock::AdoptBlockRef( &(psEntry->poBlock), poBlock );
+
+        return CE_None;
+    }
     
 /* -------------------------------------------------------------------- */
 /*      Simple case without subblocking.                                */
@@ -793,39 +932,41 @@ CPLErr GDALRasterBand::AdoptBlock( int nXBlockOff, int nYBlockOff,
     {
         nBlockIndex = nXBlockOff + nYBlockOff * nBlocksPerRow;
 
-        if( papoBlocks[nBlockIndex] == poBlock )
-            return( CE_None );
-
-        if( papoBlocks[nBlockIndex] != NULL )
-            FlushBlock( nXBlockOff, nYBlockOff );
-
-        papoBlocks[nBlockIndex] = poBlock;
-        poBlock->Touch();
+        *ppoCachedBlock = 
+            GDALRasterBlock::AdoptBlockRef( papoBlocks + nBlockIndex, 
+                                            poBlock );
 
         return( CE_None );
     }
 
 /* -------------------------------------------------------------------- */
 /*      Identify the subblock in which our target occurs, and create    */
-/*      it if necessary.                                                */
+/*      it if necessary.  The block hash mutex, unused with subblocks,  */
+/*      keeps two threads from creating the same subblock.              */
 /* -------------------------------------------------------------------- */
     int nSubBlock = TO_SUBBLOCK(nXBlockOff) 
         + TO_SUBBLOCK(nYBlockOff) * nSubBlocksPerRow;
 
     if( papoBlocks[nSubBlock] == NULL )
     {
-        int nSubGridSize = 
-            sizeof(GDALRasterBlock*) * SUBBLOCK_SIZE * SUBBLOCK_SIZE;
+        CPLMutexHolderD( &hBlockHashMutex );
 
-        papoBlocks[nSubBlock] = (GDALRasterBlock *) VSIMalloc(nSubGridSize);
         if( papoBlocks[nSubBlock] == NULL )
         {
-            CPLError( CE_Failure, CPLE_OutOfMemory,
-                      "Out of memory in AdoptBlock()." );
-            return CE_Failure;
-        }
+            int nSubGridSize = 
+                sizeof(GDALRasterBlock*) * SUBBLOCK_SIZE * SUBBLOCK_SIZE;
+            void *pSubGrid = VSIMalloc(nSubGridSize);
 
-        memset( papoBlocks[nSubBlock], 0, nSubGridSize );
+            if( pSubGrid == NULL )
+            {
+                CPLError( CE_Failure, CPLE_OutOfMemory,
+                          "Out of memory in AdoptBlock()." );
+                return CE_Failure;
+            }
+
+            memset( pSubGrid, 0, nSubGridSize );
+            papoBlocks[nSubBlock] = (GDALRasterBlock *) pSubGrid;
+        }
     }
 
 /* -------------------------------------------------------------------- */
@@ -837,14 +978,9 @@ CPLErr GDALRasterBand::AdoptBlock( int nXBlockOff, int nYBlockOff,
     int nBlockInSubBlock = WITHIN_SUBBLOCK(nXBlockOff)
         + WITHIN_SUBBLOCK(nYBlockOff) * SUBBLOCK_SIZE;
 
-    if( papoSubBlockGrid[nBlockInSubBlock] == poBlock )
-        return CE_None;
-
-    if( papoSubBlockGrid[nBlockInSubBlock] != NULL )
-        FlushBlock( nXBlockOff, nYBlockOff );
-
-    papoSubBlockGrid[nBlockInSubBlock] = poBlock;
-    poBlock->Touch();
+    *ppoCachedBlock = 
+        GDALRasterBlock::AdoptBlockRef( papoSubBlockGrid + nBlockInSubBlock,
+                                        poBlock );
 
     return CE_None;
 }
@@ -867,6 +1003,31 @@ CPLErr GDALRasterBand::AdoptBlock( int nXBlockOff, int nYBlockOff,
 CPLErr GDALRasterBand::FlushCache()
 
 {
+/* -------------------------------------------------------------------- */
+/*      Hashed block index: collect the offsets of the cached blocks    */
+/*      first, as FlushBlock() modifies the hash set.                   */
+/* -------------------------------------------------------------------- */
+    if( hBlockHash != NULL )
+    {
+        std::vector<int> anOffsets;
+
+        {
+            CPLMutexHolderD( &hBlockHashMutex );
+            CPLHashSetForeach( hBlockHash, GDALBlockHashEntryCollect,
+                               &anOffsets );
+        }
+
+        for( size_t i = 0; i < anOffsets.size(); i += 2 )
+        {
+            CPLErr eErr = FlushBlock( anOffsets[i], anOffsets[i+1] );
+
+            if( eErr != CE_None )
+                return eErr;
+        }
+
+        return CE_None;
+    }
+
     if (papoBlocks == NULL)
         return CE_None;
 
@@ -966,11 +1127,29 @@ CPLErr CPL_STDCALL GDALFlushRasterCache( GDALRasterBandH hBand )
 
 CPLErr GDALRasterBand::FlushBlock( int nXBlockOff, int nYBlockOff )
 
+{
+    return FlushBlock( nXBlockOff, nYBlockOff, NULL );
+}
+
+/************************************************************************/
+/*                             FlushBlock()                             */
+/*                                                                      */
+/*      Same as above, but also reports through pbFreed whether the     */
+/*      block was actually released.  It is not when the slot is        */
+/*      empty, or when its block is locked by another thread.           */
+/************************************************************************/
+
+CPLErr GDALRasterBand::FlushBlock( int nXBlockOff, int nYBlockOff,
+                                   int *pbFreed )
+
 {
     int             nBlockIndex;
     GDALRasterBlock *poBlock = NULL;
 
-    if( !papoBlocks )
+    if( pbFreed != NULL )
+        *pbFreed = FALSE;
+
+    if( !papoBlocks && !hBlockHash )
         return CE_None;
     
 /* -------------------------------------------------------------------- */
@@ -996,17 +1175,38 @@ CPLErr GDALRasterBand::FlushBlock( int nXBlockOff, int nYBlockOff )
         return( CE_Failure );
     }
 
+/* -------------------------------------------------------------------- */
+/*      Hashed block index.                                             */
+/* -------------------------------------------------------------------- */
+    if( hBlockHash != NULL )
+    {
+        CPLMutexHolderD( &hBlockHashMutex );
+
+        GDALBlockHashEntry sKey, *psEntry;
+
+        sKey.nXOff = nXBlockOff;
+        sKey.nYOff = nYBlockOff;
+
+        psEntry = (GDALBlockHashEntry *) CPLHashSetLookup( hBlockHash, &sKey );
+        if( psEntry == NULL )
+            return CE_None;
+
+        poBlock = GDALRasterBlock::TakeBlockRef( &(psEntry->poBlock), this,
+                                                 nXBlockOff, nYBlockOff );
+
+        if( psEntry->poBlock == NULL )
+            CPLHashSetRemove( hBlockHash, &sKey );
+    }
+
 /* -------------------------------------------------------------------- */
 /*      Simple case for single level caches.                            */
 /* -------------------------------------------------------------------- */
-    if( !bSubBlockingActive )
+    else if( !bSubBlockingActive )
     {
         nBlockIndex = nXBlockOff + nYBlockOff * nBlocksPerRow;
 
-        GDALRasterBlock::SafeLockBlock( papoBlocks + nBlockIndex );
-
-        poBlock = papoBlocks[nBlockIndex];
-        papoBlocks[nBlockIndex] = NULL;
+        poBlock = GDALRasterBlock::TakeBlockRef( papoBlocks + nBlockIndex, this,
+                                                 nXBlockOff, nYBlockOff );
     }
 
 /* -------------------------------------------------------------------- */
@@ -1029,14 +1229,13 @@ CPLErr GDALRasterBand::FlushBlock( int nXBlockOff, int nYBlockOff )
         int nBlockInSubBlock = WITHIN_SUBBLOCK(nXBlockOff)
             + WITHIN_SUBBLOCK(nYBlockOff) * SUBBLOCK_SIZE;
         
-        GDALRasterBlock::SafeLockBlock( papoSubBlockGrid + nBlockInSubBlock );
-
-        poBlock = papoSubBlockGrid[nBlockInSubBlock];
-        papoSubBlockGrid[nBlockInSubBlock] = NULL;
+        poBlock = GDALRasterBlock::TakeBlockRef( 
+            papoSubBlockGrid + nBlockInSubBlock, this, nXBlockOff, nYBlockOff );
     }
 
 /* -------------------------------------------------------------------- */
-/*      Is the target block dirty?  If so we need to write it.          */
+/*      Is the target block dirty?  If so we need to write it.  A       */
+/*      block still locked by another thread was left in place.         */
 /* -------------------------------------------------------------------- */
     CPLErr eErr = CE_None;
 
@@ -1054,6 +1253,9 @@ CPLErr GDALRasterBand::FlushBlock( int nXBlockOff, int nYBlockOff )
     poBlock->DropLock();
     delete poBlock;
 
+    if( pbFreed != NULL )
+        *pbFreed = TRUE;
+
     return eErr;
 }
 
@@ -1113,6 +1315,27 @@ GDALRasterBlock *GDALRasterBand::TryGetLockedBlockRef( int nXBlockOff,
         return( NULL );
     }
 
+/* -------------------------------------------------------------------- */
+/*      Hashed block index.  The index mutex is held while locking so   */
+/*      that the entry cannot be removed under our feet.                */
+/* -------------------------------------------------------------------- */
+    if( hBlockHash != NULL )
+    {
+        CPLMutexHolderD( &hBlockHashMutex );
+
+        GDALBlockHashEntry sKey, *psEntry;
+
+        sKey.nXOff = nXBlockOff;
+        sKey.nYOff = nYBlockOff;
+
+        psEntry = (GDALBlockHashEntry *) CPLHashSetLookup( hBlockHash, &sKey );
+        if( psEntry == NULL )
+            return NULL;
+
+        return GDALRasterBlock::LockBlockRef( &(psEntry->poBlock), this,
+                                              nXBlockOff, nYBlockOff );
+    }
+
 /* -------------------------------------------------------------------- */
 /*      Simple case for single level caches.                            */
 /* -------------------------------------------------------------------- */
@@ -1120,9 +1343,8 @@ GDALRasterBlock *GDALRasterBand::TryGetLockedBlockRef( int nXBlockOff,
     {
         nBlockIndex = nXBlockOff + nYBlockOff * nBlocksPerRow;
         
-        GDALRasterBlock::SafeLockBlock( papoBlocks + nBlockIndex );
-
-        return papoBlocks[nBlockIndex];
+        return GDALRasterBlock::LockBlockRef( papoBlocks + nBlockIndex, this,
+                                              nXBlockOff, nYBlockOff );
     }
 
 /* -------------------------------------------------------------------- */
@@ -1143,9 +1365,8 @@ GDALRasterBlock *GDALRasterBand::TryGetLockedBlockRef( int nXBlockOff,
     int nBlockInSubBlock = WITHIN_SUBBLOCK(nXBlockOff)
         + WITHIN_SUBBLOCK(nYBlockOff) * SUBBLOCK_SIZE;
 
-    GDALRasterBlock::SafeLockBlock( papoSubBlockGrid + nBlockInSubBlock );
-
-    return papoSubBlockGrid[nBlockInSubBlock];
+    return GDALRasterBlock::LockBlockRef( papoSubBlockGrid + nBlockInSubBlock,
+                                          this, nXBlockOff, nYBlockOff );
 }
 
 /************************************************************************/
@@ -1239,13 +1460,24 @@ GDALRasterBlock * GDALRasterBand::GetLockedBlockRef( int nXBlockOff,
             return( NULL );
         }
 
-        if ( AdoptBlock( nXBlockOff, nYBlockOff, poBlock ) != CE_None )
+        GDALRasterBlock *poCachedBlock = NULL;
+
+        if ( AdoptBlock( nXBlockOff, nYBlockOff, poBlock, 
+                         &poCachedBlock ) != CE_None )
         {
             poBlock->DropLock();
             delete poBlock;
             return( NULL );
         }
 
+        /* Another thread cached the block meanwhile, use that one. */
+        if( poCachedBlock != NULL )
+        {
+            poBlock->DropLock();
+            delete poBlock;
+            return poCachedBlock;
+        }
+
         if( !bJustInitialize
          && IReadBlock(nXBlockOff,nYBlockOff,poBlock->GetDataRef()) != CE_None)
         {
@@ -30,6 +30,7 @@
 
 #include "gdal_priv.h"
 #include "cpl_multiproc.h"
+#include "cpl_atomic_ops.h"
 
 CPL_CVSID("$Id$");
 
@@ -37,10 +38,60 @@ static int bCacheMaxInitialized = FALSE;
 static int nCacheMax = 40 * 1024*1024;
 static volatile int nCacheUsed = 0;
 
-static volatile GDALRasterBlock *poOldest = NULL;    /* tail */
-static volatile GDALRasterBlock *poNewest = NULL;    /* head */
+/* -------------------------------------------------------------------- */
+/*      The block cache is split into a number of shards, each with     */
+/*      its own mutex and LRU list, so that threads touching and        */
+/*      expiring unrelated blocks do not all serialize on one lock.     */
+/*      A block is assigned to a shard from its band and block          */
+/*      offsets.  The byte budget (nCacheUsed/nCacheMax) stays global.  */
+/* -------------------------------------------------------------------- */
+#define RB_SHARD_COUNT  16
+
+typedef struct
+{
+    void                     *hMutex;
+    volatile GDALRasterBlock *poOldest;    /* tail */
+    volatile GDALRasterBlock *poNewest;    /* head */
+} GDALRasterBlockShard;
+
+static GDALRasterBlockShard asShards[RB_SHARD_COUNT];
+
+/* global touch counter, used to compare the age of blocks across shards */
+static volatile int nTouchCounter = 0;
+
+/************************************************************************/
+/*                     IsDirtyBlockFlushDisabled()                      */
+/************************************************************************/
+
+static int IsDirtyBlockFlushDisabled()
+
+{
+    return CPLGetTLS( CTLS_DIRTYBLOCKFLUSH ) != NULL;
+}
 
-static void *hRBMutex = NULL;
+/************************************************************************/
+/*                           GetShardIndex()                            */
+/************************************************************************/
+
+static int GetShardIndex( GDALRasterBand *poBand, int nXOff, int nYOff )
+
+{
+    GUIntBig nHash = (GUIntBig) (size_t) poBand;
+
+    nHash ^= nHash >> 7;
+    nHash = nHash * 31 + (GUInt32) nXOff;
+    nHash = nHash * 31 + (GUInt32) nYOff;
+    nHash ^= nHash >> 11;
+
+    return (int) (nHash % RB_SHARD_COUNT);
+}
+
+static GDALRasterBlockShard *GetShard( GDALRasterBand *poBand, 
+                                       int nXOff, int nYOff )
+
+{
+    return asShards + GetShardIndex( poBand, nXOff, nYOff );
+}
 
 
 /************************************************************************/
@@ -67,11 +118,7 @@ void CPL_STDCALL GDALSetCacheMax( int nNewSize )
 /* -------------------------------------------------------------------- */
     while( nCacheUsed > nCacheMax )
     {
-        int nOldCacheUsed = nCacheUsed;
-
-        GDALFlushCacheBlock();
-
-        if( nCacheUsed == nOldCacheUsed )
+        if( !GDALFlushCacheBlock() )
             break;
     }
 }
@@ -155,8 +202,10 @@ int CPL_STDCALL GDALFlushCacheBlock()
  * that is currently stored in the GDAL raster cache.  The cache holds
  * some blocks of raster data for zero or more GDALRasterBand objects
  * across zero or more GDALDataset objects in a global raster cache with
- * a least recently used (LRU) list and an upper cache limit (see
- * GDALSetCacheMax()) under which the cache size is normally kept. 
+ * an upper cache limit (see GDALSetCacheMax()) under which the cache size
+ * is normally kept.  Internally the cache is split into a fixed number of
+ * shards, each with its own mutex and least recently used (LRU) list, so
+ * that many threads can touch and expire blocks concurrently.
  *
  * Some blocks in the cache may be modified relative to the state on disk
  * (they are marked "Dirty") and must be flushed to disk before they can
@@ -189,37 +238,174 @@ int CPL_STDCALL GDALFlushCacheBlock()
  * for a new cache block would put cache memory use over the established
  * limit.   
  *
+ * The least recently used unlocked block is flushed.  As each cache
+ * shard keeps its own LRU list, the candidates at the tail of each shard
+ * are compared using the order in which they were last touched.  Dirty
+ * blocks are skipped while the calling thread has disabled the flushing
+ * of dirty blocks (see EnterDisableDirtyBlockFlush()).
+ *
  * C++ analog to the C function GDALFlushCacheBlock().
  * 
- * @return TRUE if successful or FALSE if no flushable block is found.
+ * @return TRUE if a block was freed or FALSE if no flushable block is found.
  */
 
 int GDALRasterBlock::FlushCacheBlock()
 
 {
-    int nXOff, nYOff;
-    GDALRasterBand *poBand;
+    return FlushCacheBlock( NULL );
+}
 
+/************************************************************************/
+/*                          FlushCacheBlock()                           */
+/*                                                                      */
+/*      Same as above, but also reports through pbDirtySkipped          */
+/*      whether unlocked dirty blocks were passed over because the      */
+/*      thread has disabled their flushing.                             */
+/************************************************************************/
+
+int GDALRasterBlock::FlushCacheBlock( int *pbDirtySkipped )
+
+{
+    int bNoDirty = IsDirtyBlockFlushDisabled();
+
+/* -------------------------------------------------------------------- */
+/*      The target is only flushed after its shard mutex is released,   */
+/*      so another thread may lock it in between.  FlushBlock() then    */
+/*      leaves it in place, and puts it back in the LRU list, so we     */
+/*      look for another target until a block is actually freed.        */
+/* -------------------------------------------------------------------- */
+    for( ;; )
     {
-        CPLMutexHolderD( &hRBMutex );
-        GDALRasterBlock *poTarget = (GDALRasterBlock *) poOldest;
+        int nXOff = 0, nYOff = 0;
+        GDALRasterBand *poBand = NULL;
+        int bDirtySkipped = FALSE;
 
-        while( poTarget != NULL && poTarget->GetLockCount() > 0 ) 
-            poTarget = poTarget->poPrevious;
-        
-        if( poTarget == NULL )
+        if( pbDirtySkipped != NULL )
+            *pbDirtySkipped = FALSE;
+
+/* -------------------------------------------------------------------- */
+/*      Find the shard whose least recently used unlocked block is      */
+/*      the oldest.  We only hold one shard mutex at a time, so the     */
+/*      result is approximate, but close to a global LRU.  The touch    */
+/*      counter wraps around, so ticks are compared through their       */
+/*      unsigned difference.                                            */
+/* -------------------------------------------------------------------- */
+        int iBestShard = -1, nBestTick = 0;
+
+        for( int iShard = 0; iShard < RB_SHARD_COUNT; iShard++ )
+        {
+            GDALRasterBlockShard *psShard = asShards + iShard;
+
+            CPLMutexHolderD( &(psShard->hMutex) );
+            GDALRasterBlock *poTarget = 
+                (GDALRasterBlock *) psShard->poOldest;
+
+            while( poTarget != NULL 
+                   && (poTarget->GetLockCount() > 0
+                       || (bNoDirty && poTarget->GetDirty())) )
+            {
+                if( poTarget->GetLockCount() == 0 )
+                    bDirtySkipped = TRUE;
+                poTarget = poTarget->poPrevious;
+            }
+
+            if( poTarget != NULL
+                && (iBestShard < 0 
+                    || (int) ((unsigned int) poTarget->nTouchTick 
+                              - (unsigned int) nBestTick) < 0) )
+            {
+                iBestShard = iShard;
+                nBestTick = poTarget->nTouchTick;
+            }
+        }
+
+        if( iBestShard < 0 )
+        {
+            if( pbDirtySkipped != NULL )
+                *pbDirtySkipped = bDirtySkipped;
             return FALSE;
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Detach the oldest unlocked block of that shard.  It may have    */
+/*      changed meanwhile, which does not matter much.                  */
+/* -------------------------------------------------------------------- */
+        {
+            GDALRasterBlockShard *psShard = asShards + iBestShard;
+
+            CPLMutexHolderD( &(psShard->hMutex) );
+            GDALRasterBlock *poTarget = 
+                (GDALRasterBlock *) psShard->poOldest;
+
+            while( poTarget != NULL 
+                   && (poTarget->GetLockCount() > 0
+                       || (bNoDirty && poTarget->GetDirty())) )
+                poTarget = poTarget->poPrevious;
+
+            if( poTarget == NULL )
+                continue;
 
-        poTarget->Detach();
+            poTarget->Detach();
 
-        nXOff = poTarget->GetXOff();
-        nYOff = poTarget->GetYOff();
-        poBand = poTarget->GetBand();
+            nXOff = poTarget->GetXOff();
+            nYOff = poTarget->GetYOff();
+            poBand = poTarget->GetBand();
+        }
+
+        int bFreed;
+
+        poBand->FlushBlock( nXOff, nYOff, &bFreed );
+
+        if( bFreed )
+            return TRUE;
     }
+}
+
+/************************************************************************/
+/*                    EnterDisableDirtyBlockFlush()                     */
+/************************************************************************/
+
+/**
+ * \brief Stop the calling thread from flushing dirty blocks.
+ *
+ * Flushing a dirty block writes it through the driver of its band, so a
+ * thread reading one dataset while another thread writes a second one
+ * may end up writing to the second dataset at the same time as its
+ * owner.  In this mode, the calling thread only flushes clean blocks to
+ * keep the cache within its limit, and when only dirty blocks are left
+ * it waits for other threads to write them.  Another thread must thus
+ * keep flushing blocks meanwhile, as GDALDatasetCopyWholeRaster() does.
+ *
+ * Calls may be nested, and must be balanced by calls to
+ * LeaveDisableDirtyBlockFlush() on the same thread.
+ */
 
-    poBand->FlushBlock( nXOff, nYOff );
+void GDALRasterBlock::EnterDisableDirtyBlockFlush()
 
-    return TRUE;
+{
+    size_t nDepth = (size_t) CPLGetTLS( CTLS_DIRTYBLOCKFLUSH );
+
+    CPLSetTLS( CTLS_DIRTYBLOCKFLUSH, (void *) (nDepth + 1), FALSE );
+}
+
+/************************************************************************/
+/*                    LeaveDisableDirtyBlockFlush()                     */
+/************************************************************************/
+
+/**
+ * \brief Allow the calling thread to flush dirty blocks again.
+ *
+ * @see EnterDisableDirtyBlockFlush()
+ */
+
+void GDALRasterBlock::LeaveDisableDirtyBlockFlush()
+
+{
+    size_t nDepth = (size_t) CPLGetTLS( CTLS_DIRTYBLOCKFLUSH );
+
+    CPLAssert( nDepth > 0 );
+    if( nDepth > 0 )
+        CPLSetTLS( CTLS_DIRTYBLOCKFLUSH, (void *) (nDepth - 1), FALSE );
 }
 
 /************************************************************************/
@@ -256,6 +442,7 @@ GDALRasterBlock::GDALRasterBlock( GDALRasterBand *poBandIn,
     nLockCount = 0;
 
     poNext = poPrevious = NULL;
+    nTouchTick = 0;
 
     nXOff = nXOffIn;
     nYOff = nYOffIn;
@@ -284,10 +471,7 @@ GDALRasterBlock::~GDALRasterBlock()
 
         nSizeInBytes = (nXSize * nYSize * GDALGetDataTypeSize(eType)+7)/8;
 
-        {
-            CPLMutexHolderD( &hRBMutex );
-            nCacheUsed -= nSizeInBytes;
-        }
+        CPLAtomicAdd( &nCacheUsed, -nSizeInBytes );
     }
 
     CPLAssert( nLockCount == 0 );
@@ -313,14 +497,16 @@ GDALRasterBlock::~GDALRasterBlock()
 void GDALRasterBlock::Detach()
 
 {
-    CPLMutexHolderD( &hRBMutex );
+    GDALRasterBlockShard *psShard = GetShard( poBand, nXOff, nYOff );
 
-    if( poOldest == this )
-        poOldest = poPrevious;
+    CPLMutexHolderD( &(psShard->hMutex) );
 
-    if( poNewest == this )
+    if( psShard->poOldest == this )
+        psShard->poOldest = poPrevious;
+
+    if( psShard->poNewest == this )
     {
-        poNewest = poNext;
+        psShard->poNewest = poNext;
     }
 
     if( poPrevious != NULL )
@@ -338,27 +524,43 @@ void GDALRasterBlock::Detach()
 /************************************************************************/
 
 /**
- * Confirms (via assertions) that the block cache linked list is in a
+ * Confirms (via assertions) that the block cache linked lists are in a
  * consistent state. 
  */
 
 void GDALRasterBlock::Verify()
 
 {
-    CPLMutexHolderD( &hRBMutex );
+    for( int iShard = 0; iShard < RB_SHARD_COUNT; iShard++ )
+        VerifyShard( iShard );
+}
+
+/************************************************************************/
+/*                            VerifyShard()                             */
+/************************************************************************/
+
+void GDALRasterBlock::VerifyShard( int iShard )
+
+{
+    GDALRasterBlockShard *psShard = asShards + iShard;
+
+    CPLMutexHolderD( &(psShard->hMutex) );
 
-    CPLAssert( (poNewest == NULL && poOldest == NULL)
-               || (poNewest != NULL && poOldest != NULL) );
+    CPLAssert( (psShard->poNewest == NULL && psShard->poOldest == NULL)
+               || (psShard->poNewest != NULL && psShard->poOldest != NULL) );
 
-    if( poNewest != NULL )
+    if( psShard->poNewest != NULL )
     {
-        CPLAssert( poNewest->poPrevious == NULL );
-        CPLAssert( poOldest->poNext == NULL );
+        CPLAssert( psShard->poNewest->poPrevious == NULL );
+        CPLAssert( psShard->poOldest->poNext == NULL );
         
-        for( GDALRasterBlock *poBlock = (GDALRasterBlock *) poNewest; 
+        for( GDALRasterBlock *poBlock = (GDALRasterBlock *) psShard->poNewest; 
              poBlock != NULL;
              poBlock = poBlock->poNext )
         {
+            CPLAssert( GetShardIndex( poBlock->poBand, poBlock->nXOff,
+                                      poBlock->nYOff ) == iShard );
+
             if( poBlock->poPrevious )
             {
                 CPLAssert( poBlock->poPrevious->poNext == poBlock );
@@ -414,13 +616,17 @@ CPLErr GDALRasterBlock::Write()
 void GDALRasterBlock::Touch()
 
 {
-    CPLMutexHolderD( &hRBMutex );
+    GDALRasterBlockShard *psShard = GetShard( poBand, nXOff, nYOff );
+
+    CPLMutexHolderD( &(psShard->hMutex) );
 
-    if( poNewest == this )
+    nTouchTick = CPLAtomicInc( &nTouchCounter );
+
+    if( psShard->poNewest == this )
         return;
 
-    if( poOldest == this )
-        poOldest = this->poPrevious;
+    if( psShard->poOldest == this )
+        psShard->poOldest = this->poPrevious;
     
     if( poPrevious != NULL )
         poPrevious->poNext = poNext;
@@ -429,22 +635,22 @@ void GDALRasterBlock::Touch()
         poNext->poPrevious = poPrevious;
 
     poPrevious = NULL;
-    poNext = (GDALRasterBlock *) poNewest;
+    poNext = (GDALRasterBlock *) psShard->poNewest;
 
-    if( poNewest != NULL )
+    if( psShard->poNewest != NULL )
     {
-        CPLAssert( poNewest->poPrevious == NULL );
-        poNewest->poPrevious = this;
+        CPLAssert( psShard->poNewest->poPrevious == NULL );
+        psShard->poNewest->poPrevious = this;
     }
-    poNewest = this;
+    psShard->poNewest = this;
     
-    if( poOldest == NULL )
+    if( psShard->poOldest == NULL )
     {
         CPLAssert( poPrevious == NULL && poNext == NULL );
-        poOldest = this;
+        psShard->poOldest = this;
     }
 #ifdef ENABLE_DEBUG
-    Verify();
+    VerifyShard( psShard - asShards );
 #endif
 }
 
@@ -466,7 +672,6 @@ void GDALRasterBlock::Touch()
 CPLErr GDALRasterBlock::Internalize()
 
 {
-    CPLMutexHolderD( &hRBMutex );
     void        *pNewData;
     int         nSizeInBytes;
     int         nCurCacheMax = GDALGetCacheMax();
@@ -493,15 +698,19 @@ CPLErr GDALRasterBlock::Internalize()
 /* -------------------------------------------------------------------- */
     AddLock(); /* don't flush this block! */
 
-    nCacheUsed += nSizeInBytes;
+    CPLAtomicAdd( &nCacheUsed, nSizeInBytes );
     while( nCacheUsed > nCurCacheMax )
     {
-        int nOldCacheUsed = nCacheUsed;
+        int bDirtySkipped;
 
-        GDALFlushCacheBlock();
+        if( FlushCacheBlock( &bDirtySkipped ) )
+            continue;
 
-        if( nCacheUsed == nOldCacheUsed )
+        /* Only dirty blocks are left, which some other thread writes. */
+        if( !bDirtySkipped )
             break;
+
+        CPLSleep( 0.001 );
     }
 
 /* -------------------------------------------------------------------- */
@@ -556,10 +765,16 @@ void GDALRasterBlock::MarkClean()
  * \brief Safely lock block.
  *
  * This method locks a GDALRasterBlock (and touches it) in a thread-safe
- * manner.  The global block cache mutex is held while locking the block,
- * in order to avoid race conditions with other threads that might be
- * trying to expire the block at the same time.  The block pointer may be
- * safely NULL, in which case this method does nothing. 
+ * manner.  The mutexes of all the cache shards are held while locking the
+ * block, in order to avoid race conditions with other threads that might
+ * be trying to expire the block at the same time.  The block pointer may
+ * be safely NULL, in which case this method does nothing. 
+ *
+ * Until it holds a shard mutex this method cannot know the block is
+ * still alive, so it cannot look up the shard owning it and has to hold
+ * them all.  Callers that know the band and block offsets the pointer
+ * slot belongs to should prefer the other form of this method, which
+ * only holds the mutex of that shard.
  *
  * @param ppBlock Pointer to the block pointer to try and lock/touch.
  */
@@ -569,7 +784,51 @@ int GDALRasterBlock::SafeLockBlock( GDALRasterBlock ** ppBlock )
 {
     CPLAssert( NULL != ppBlock );
 
-    CPLMutexHolderD( &hRBMutex );
+    int iShard, bLocked = FALSE;
+
+/* -------------------------------------------------------------------- */
+/*      Elsewhere at most one shard mutex is held at a time, so         */
+/*      taking all of them in order cannot deadlock.                    */
+/* -------------------------------------------------------------------- */
+    for( iShard = 0; iShard < RB_SHARD_COUNT; iShard++ )
+        CPLCreateOrAcquireMutex( &(asShards[iShard].hMutex), 1000.0 );
+
+    if( *ppBlock != NULL )
+    {
+        (*ppBlock)->AddLock();
+        (*ppBlock)->Touch();
+
+        bLocked = TRUE;
+    }
+
+    for( iShard = RB_SHARD_COUNT - 1; iShard >= 0; iShard-- )
+        CPLReleaseMutex( asShards[iShard].hMutex );
+
+    return bLocked;
+}
+
+/**
+ * \brief Safely lock block.
+ *
+ * Same as the single argument form, but the cache shard is computed from
+ * the band and block offsets associated with the pointer slot.
+ *
+ * @param ppBlock Pointer to the block pointer to try and lock/touch.
+ * @param poBand the band owning the block slot.
+ * @param nXOff the horizontal block offset of the slot.
+ * @param nYOff the vertical block offset of the slot.
+ */
+
+int GDALRasterBlock::SafeLockBlock( GDALRasterBlock ** ppBlock,
+                                    GDALRasterBand *poBand,
+                                    int nXOff, int nYOff )
+
+{
+    CPLAssert( NULL != ppBlock );
+
+    GDALRasterBlockShard *psShard = GetShard( poBand, nXOff, nYOff );
+
+    CPLMutexHolderD( &(psShard->hMutex) );
 
     if( *ppBlock != NULL )
     {
@@ -581,3 +840,143 @@ int GDALRasterBlock::SafeLockBlock( GDALRasterBlock ** ppBlock )
     else
         return FALSE;
 }
+
+/************************************************************************/
+/*                            LockBlockRef()                            */
+/************************************************************************/
+
+/**
+ * \brief Lock the block of a band block slot.
+ *
+ * Same as SafeLockBlock(), but returns the block that was locked, read
+ * from the slot under the mutex of its cache shard.  Reading the slot
+ * again afterwards could return NULL, or another block, if the block was
+ * flushed meanwhile.
+ *
+ * @param ppBlock Pointer to the block pointer to try and lock/touch.
+ * @param poBand the band owning the block slot.
+ * @param nXOff the horizontal block offset of the slot.
+ * @param nYOff the vertical block offset of the slot.
+ *
+ * @return the locked block, or NULL if the slot is empty.
+ */
+
+GDALRasterBlock *GDALRasterBlock::LockBlockRef( GDALRasterBlock ** ppBlock,
+                                                GDALRasterBand *poBand,
+                                                int nXOff, int nYOff )
+
+{
+    CPLAssert( NULL != ppBlock );
+
+    GDALRasterBlockShard *psShard = GetShard( poBand, nXOff, nYOff );
+
+    CPLMutexHolderD( &(psShard->hMutex) );
+
+    GDALRasterBlock *poBlock = *ppBlock;
+
+    if( poBlock != NULL )
+    {
+        poBlock->AddLock();
+        poBlock->Touch();
+    }
+
+    return poBlock;
+}
+
+/************************************************************************/
+/*                            TakeBlockRef()                            */
+/************************************************************************/
+
+/**
+ * \brief Remove the block of a band block slot, to flush it.
+ *
+ * Under the mutex of its cache shard, the block of the slot is locked on
+ * behalf of the caller and the slot is cleared, so that no other thread
+ * can lock the block any more.  A block locked by another thread is left
+ * in its slot, and put back in the LRU list in case it was detached, as
+ * deleting it would leave that thread with a dangling pointer.
+ *
+ * @param ppBlock Pointer to the block pointer to take.
+ * @param poBand the band owning the block slot.
+ * @param nXOff the horizontal block offset of the slot.
+ * @param nYOff the vertical block offset of the slot.
+ *
+ * @return the locked block, or NULL if the slot is empty or the block is
+ * in use.
+ */
+
+GDALRasterBlock *GDALRasterBlock::TakeBlockRef( GDALRasterBlock ** ppBlock,
+                                                GDALRasterBand *poBand,
+                                                int nXOff, int nYOff )
+
+{
+    CPLAssert( NULL != ppBlock );
+
+    GDALRasterBlockShard *psShard = GetShard( poBand, nXOff, nYOff );
+
+    CPLMutexHolderD( &(psShard->hMutex) );
+
+    GDALRasterBlock *poBlock = *ppBlock;
+
+    if( poBlock == NULL )
+        return NULL;
+
+    if( poBlock->GetLockCount() > 0 )
+    {
+        poBlock->Touch();
+        return NULL;
+    }
+
+    poBlock->AddLock();
+    *ppBlock = NULL;
+
+    return poBlock;
+}
+
+/************************************************************************/
+/*                           AdoptBlockRef()                            */
+/************************************************************************/
+
+/**
+ * \brief Put a new block in a band block slot, unless it is taken.
+ *
+ * Under the mutex of the cache shard of the new block, the block is
+ * stored in the slot and touched if the slot is empty.  Otherwise the
+ * block already in the slot, which another thread cached meanwhile, is
+ * locked on behalf of the caller and returned, and the slot is left
+ * unchanged.
+ *
+ * @param ppBlock Pointer to the block pointer of the slot.
+ * @param poBlock the new block, whose band and offsets are the slot's.
+ *
+ * @return NULL if poBlock was stored, or the locked block of the slot.
+ */
+
+GDALRasterBlock *GDALRasterBlock::AdoptBlockRef( GDALRasterBlock ** ppBlock,
+                                                 GDALRasterBlock * poBlock )
+
+{
+    CPLAssert( NULL != ppBlock && NULL != poBlock );
+
+    GDALRasterBlockShard *psShard = 
+        GetShard( poBlock->poBand, poBlock->nXOff, poBlock->nYOff );
+
+    CPLMutexHolderD( &(psShard->hMutex) );
+
+    GDALRasterBlock *poCachedBlock = *ppBlock;
+
+    if( poCachedBlock != NULL )
+    {
+        if( poCachedBlock == poBlock )
+            return NULL;
+
+        poCachedBlock->AddLock();
+        poCachedBlock->Touch();
+        return poCachedBlock;
+    }
+
+    *ppBlock = poBlock;
+    poBlock->Touch();
+
+    return NULL;
+}
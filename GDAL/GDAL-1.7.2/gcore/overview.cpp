@@ -28,9 +28,18 @@
  ****************************************************************************/
 
 #include "gdal_priv.h"
+#include "cpl_string.h"
+#include "cpl_worker_thread_pool.h"
 
 CPL_CVSID("$Id$");
 
+/* SSE2 is part of the x86-64 baseline, so it is enabled at compile time */
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define HAVE_OVR_SSE2
+#  include <emmintrin.h>
+#endif
+
 typedef enum
 {
     GRM_Near = 0,
@@ -40,8 +49,265 @@ typedef enum
     GRM_Cubic = 4,
 } GDALResamplingMethod;
 
+/************************************************************************/
+/*                          GDALOvrUseSIMD()                            */
+/*                                                                      */
+/*      The exact 2x2 AVERAGE kernels below may be disabled with the    */
+/*      GDAL_OVERVIEW_SIMD configuration option, mostly for             */
+/*      benchmarking.                                                   */
+/************************************************************************/
+
+static int GDALOvrUseSIMD()
+
+{
+    return CSLTestBoolean( CPLGetConfigOption( "GDAL_OVERVIEW_SIMD", "YES" ) );
+}
+
+/************************************************************************/
+/*                        GDALAverage2x2Float()                         */
+/*                                                                      */
+/*      Average each pair of columns of two source lines into one       */
+/*      destination line.  The sum is done in double precision, in      */
+/*      the same order as the generic AVERAGE code of                   */
+/*      GDALDownsampleChunk32R(), so the result is identical.           */
+/************************************************************************/
+
+static void GDALAverage2x2Float( const float *pafSrc0, const float *pafSrc1,
+                                 int nDstXSize, float *pafDst )
+
+{
+    int i = 0;
+
+#ifdef HAVE_OVR_SSE2
+    const __m128d dfZero = _mm_setzero_pd();
+    const __m128d dfQuarter = _mm_set1_pd( 0.25 );
+
+    for( ; i + 2 <= nDstXSize; i += 2 )
+    {
+        __m128 v0 = _mm_loadu_ps( pafSrc0 + 2 * i );
+        __m128 v1 = _mm_loadu_ps( pafSrc1 + 2 * i );
+
+        /* Even and odd columns of both lines */
+        __m128d dfA = _mm_cvtps_pd( _mm_shuffle_ps( v0, v0, _MM_SHUFFLE(2,0,2,0) ) );
+        __m128d dfB = _mm_cvtps_pd( _mm_shuffle_ps( v0, v0, _MM_SHUFFLE(3,1,3,1) ) );
+        __m128d dfC = _mm_cvtps_pd( _mm_shuffle_ps( v1, v1, _MM_SHUFFLE(2,0,2,0) ) );
+        __m128d dfD = _mm_cvtps_pd( _mm_shuffle_ps( v1, v1, _MM_SHUFFLE(3,1,3,1) ) );
+
+        __m128d dfTotal = _mm_add_pd( _mm_add_pd( _mm_add_pd( 
+                              _mm_add_pd( dfZero, dfA ), dfB ), dfC ), dfD );
+
+        _mm_storel_pi( (__m64 *) (pafDst + i), 
+                       _mm_cvtpd_ps( _mm_mul_pd( dfTotal, dfQuarter ) ) );
+    }
+#endif
+
+    for( ; i < nDstXSize; i++ )
+    {
+        double dfTotal = 0.0;
+
+        dfTotal += pafSrc0[2*i];
+        dfTotal += pafSrc0[2*i+1];
+        dfTotal += pafSrc1[2*i];
+        dfTotal += pafSrc1[2*i+1];
+
+        pafDst[i] = (float) (dfTotal / 4);
+    }
+}
+
+/************************************************************************/
+/*                        GDALAverage2x2Byte()                          */
+/*                                                                      */
+/*      Same as GDALAverage2x2Float(), on Byte data, rounding like      */
+/*      GDALCopyWords() does when the float average is written to a    */
+/*      Byte band.                                                      */
+/************************************************************************/
+
+static void GDALAverage2x2Byte( const GByte *pabySrc0, const GByte *pabySrc1,
+                                int nDstXSize, GByte *pabyDst )
+
+{
+    int i = 0;
+
+#ifdef HAVE_OVR_SSE2
+    const __m128i nLowByte = _mm_set1_epi16( 0xff );
+    const __m128i nTwo = _mm_set1_epi16( 2 );
+
+    for( ; i + 16 <= nDstXSize; i += 16 )
+    {
+        __m128i anSum[2];
+
+        for( int j = 0; j < 2; j++ )
+        {
+            __m128i v0 = _mm_loadu_si128( 
+                (const __m128i *) (pabySrc0 + 2 * i + 16 * j) );
+            __m128i v1 = _mm_loadu_si128( 
+                (const __m128i *) (pabySrc1 + 2 * i + 16 * j) );
+
+            /* 16 bit sums of the even and odd columns */
+            __m128i nSum = 
+                _mm_add_epi16( 
+                    _mm_add_epi16( _mm_and_si128( v0, nLowByte ),
+                                   _mm_srli_epi16( v0, 8 ) ),
+                    _mm_add_epi16( _mm_and_si128( v1, nLowByte ),
+                                   _mm_srli_epi16( v1, 8 ) ) );
+
+            anSum[j] = _mm_srli_epi16( _mm_add_epi16( nSum, nTwo ), 2 );
+        }
+
+        _mm_storeu_si128( (__m128i *) (pabyDst + i), 
+                          _mm_packus_epi16( anSum[0], anSum[1] ) );
+    }
+#endif
+
+    for( ; i < nDstXSize; i++ )
+    {
+        int nTotal = pabySrc0[2*i] + pabySrc0[2*i+1]
+            + pabySrc1[2*i] + pabySrc1[2*i+1];
+
+        pabyDst[i] = (GByte) ((nTotal + 2) >> 2);
+    }
+}
+
+/************************************************************************/
+/*                        GDALAverage2x2Int16()                         */
+/*                                                                      */
+/*      Same as GDALAverage2x2Byte() on Int16 data.  GDALCopyWords()    */
+/*      rounds halves away from zero when writing to Int16.             */
+/************************************************************************/
+
+static void GDALAverage2x2Int16( const GInt16 *panSrc0, const GInt16 *panSrc1,
+                                 int nDstXSize, GInt16 *panDst )
+
+{
+    int i = 0;
+
+#ifdef HAVE_OVR_SSE2
+    const __m128i nOne = _mm_set1_epi16( 1 );
+    const __m128i nTwo = _mm_set1_epi32( 2 );
+
+    for( ; i + 8 <= nDstXSize; i += 8 )
+    {
+        __m128i anAverage[2];
+
+        for( int j = 0; j < 2; j++ )
+        {
+            __m128i v0 = _mm_loadu_si128( 
+                (const __m128i *) (panSrc0 + 2 * i + 8 * j) );
+            __m128i v1 = _mm_loadu_si128( 
+                (const __m128i *) (panSrc1 + 2 * i + 8 * j) );
+
+            /* 32 bit sums of adjacent columns of both lines */
+            __m128i nSum = _mm_add_epi32( _mm_madd_epi16( v0, nOne ),
+                                          _mm_madd_epi16( v1, nOne ) );
+
+            /* Round the absolute value, and restore the sign */
+            __m128i nSign = _mm_srai_epi32( nSum, 31 );
+            __m128i nAbs = _mm_sub_epi32( _mm_xor_si128( nSum, nSign ), nSign );
+
+            nAbs = _mm_srli_epi32( _mm_add_epi32( nAbs, nTwo ), 2 );
+            anAverage[j] = 
+                _mm_sub_epi32( _mm_xor_si128( nAbs, nSign ), nSign );
+        }
+
+        _mm_storeu_si128( (__m128i *) (panDst + i), 
+                          _mm_packs_epi32( anAverage[0], anAverage[1] ) );
+    }
+#endif
+
+    for( ; i < nDstXSize; i++ )
+    {
+        int nTotal = panSrc0[2*i] + panSrc0[2*i+1]
+            + panSrc1[2*i] + panSrc1[2*i+1];
+
+        if( nTotal >= 0 )
+            panDst[i] = (GInt16) ((nTotal + 2) >> 2);
+        else
+            panDst[i] = (GInt16) -((2 - nTotal) >> 2);
+    }
+}
+
+/************************************************************************/
+/*                        GDALAverage2x2Chunk()                         */
+/*                                                                      */
+/*      Compute lines nDstYOff to nDstYOff2-1 of an overview of half    */
+/*      the size of its source, in the Byte or Int16 type of the        */
+/*      source, from a full width chunk of the source starting at an    */
+/*      even line.                                                      */
+/************************************************************************/
+
+static void GDALAverage2x2Chunk( GDALDataType eType, const void *pChunk,
+                                 int nChunkYOff, int nOXSize, 
+                                 int nDstYOff, int nDstYOff2, void *pDst )
+
+{
+    int nPixelSize = GDALGetDataTypeSize( eType ) / 8;
+    int nSrcLineSize = 2 * nOXSize * nPixelSize;
+
+    for( int iDstLine = nDstYOff; iDstLine < nDstYOff2; iDstLine++ )
+    {
+        const GByte *pabySrc = ((const GByte *) pChunk) 
+            + (2 * iDstLine - nChunkYOff) * nSrcLineSize;
+        GByte *pabyDst = ((GByte *) pDst) 
+            + (iDstLine - nDstYOff) * nOXSize * nPixelSize;
+
+        if( eType == GDT_Byte )
+            GDALAverage2x2Byte( pabySrc, pabySrc + nSrcLineSize, 
+                                nOXSize, pabyDst );
+        else
+            GDALAverage2x2Int16( (const GInt16 *) pabySrc, 
+                                 (const GInt16 *) (pabySrc + nSrcLineSize),
+                                 nOXSize, (GInt16 *) pabyDst );
+    }
+}
+
+/************************************************************************/
+/*                    GDALDownsampleChunkDstWindow()                    */
+/*                                                                      */
+/*      Compute the window of the overview that comes from a chunk      */
+/*      of the source.  The end offsets are excluded.                   */
+/************************************************************************/
+
+static void
+GDALDownsampleChunkDstWindow( int nSrcWidth, int nSrcHeight, 
+                              int nChunkXOff, int nChunkXSize,
+                              int nChunkYOff, int nChunkYSize,
+                              int nOXSize, int nOYSize,
+                              int *pnDstXOff, int *pnDstXOff2,
+                              int *pnDstYOff, int *pnDstYOff2 )
+
+{
+/* -------------------------------------------------------------------- */
+/*      Figure out the column to start writing to, and the first column */
+/*      to not write to.                                                */
+/* -------------------------------------------------------------------- */
+    *pnDstXOff = (int) (0.5 + (nChunkXOff/(double)nSrcWidth) * nOXSize);
+    *pnDstXOff2 = (int) 
+        (0.5 + ((nChunkXOff+nChunkXSize)/(double)nSrcWidth) * nOXSize);
+
+    if( nChunkXOff + nChunkXSize == nSrcWidth )
+        *pnDstXOff2 = nOXSize;
+
+/* -------------------------------------------------------------------- */
+/*      Figure out the line to start writing to, and the first line     */
+/*      to not write to.  In theory this approach should ensure that    */
+/*      every output line will be written if all input chunks are       */
+/*      processed.                                                      */
+/* -------------------------------------------------------------------- */
+    *pnDstYOff = (int) (0.5 + (nChunkYOff/(double)nSrcHeight) * nOYSize);
+    *pnDstYOff2 = (int) 
+        (0.5 + ((nChunkYOff+nChunkYSize)/(double)nSrcHeight) * nOYSize);
+
+    if( nChunkYOff + nChunkYSize == nSrcHeight )
+        *pnDstYOff2 = nOYSize;
+}
+
 /************************************************************************/
 /*                       GDALDownsampleChunk32R()                       */
+/*                                                                      */
+/*      Compute the part of a nOXSize x nOYSize overview that comes     */
+/*      from a chunk of the source, into pafDstBuffer whose size is     */
+/*      given by GDALDownsampleChunkDstWindow().  This does no I/O, so  */
+/*      it can run on several chunks at once.                           */
 /************************************************************************/
 
 static CPLErr
@@ -50,7 +316,8 @@ GDALDownsampleChunk32R( int nSrcWidth, int nSrcHeight,
                         GByte * pabyChunkNodataMask,
                         int nChunkXOff, int nChunkXSize,
                         int nChunkYOff, int nChunkYSize,
-                        GDALRasterBand * poOverview,
+                        int nOXSize, int nOYSize,
+                        float * pafDstBuffer,
                         const char * pszResampling,
                         int bHasNoData, float fNoDataValue,
                         GDALColorTable* poColorTable,
@@ -88,7 +355,7 @@ GDALDownsampleChunk32R( int nSrcWidth, int nSrcHeight,
 /* -------------------------------------------------------------------- */
 /*      Create the filter kernel and allocate scanline buffer.          */
 /* -------------------------------------------------------------------- */
-    int      nDstXOff, nDstXOff2, nDstYOff, nDstYOff2, nOXSize, nOYSize;
+    int      nDstXOff, nDstXOff2, nDstYOff, nDstYOff2;
     float    *pafDstScanline;
     int nGaussMatrixDim = 3;
     const int *panGaussMatrix;
@@ -112,8 +379,6 @@ GDALDownsampleChunk32R( int nSrcWidth, int nSrcHeight,
         6,36,90,120,90,36,6,
         1,6,15,20,15,6,1};
 
-    nOXSize = poOverview->GetXSize();
-    nOYSize = poOverview->GetYSize();
     int nResYFactor = (int) (0.5 + (double)nSrcHeight/(double)nOYSize);
 
     // matrix for gauss filter
@@ -134,38 +399,86 @@ GDALDownsampleChunk32R( int nSrcWidth, int nSrcHeight,
     }
 
 /* -------------------------------------------------------------------- */
-/*      Figure out the column to start writing to, and the first column */
-/*      to not write to.                                                */
+/*      Figure out the window of the overview to compute.               */
 /* -------------------------------------------------------------------- */
-    nDstXOff = (int) (0.5 + (nChunkXOff/(double)nSrcWidth) * nOXSize);
-    nDstXOff2 = (int) 
-        (0.5 + ((nChunkXOff+nChunkXSize)/(double)nSrcWidth) * nOXSize);
-
-    if( nChunkXOff + nChunkXSize == nSrcWidth )
-        nDstXOff2 = nOXSize;
+    GDALDownsampleChunkDstWindow( nSrcWidth, nSrcHeight,
+                                  nChunkXOff, nChunkXSize,
+                                  nChunkYOff, nChunkYSize,
+                                  nOXSize, nOYSize,
+                                  &nDstXOff, &nDstXOff2,
+                                  &nDstYOff, &nDstYOff2 );
 
+/* -------------------------------------------------------------------- */
+/*      The source columns of each destination pixel are the same for  */
+/*      all lines, so compute them once.                                */
+/* -------------------------------------------------------------------- */
+    int *panSrcXOff = (int *) 
+        VSIMalloc2( MAX(1, nDstXOff2 - nDstXOff), 2 * sizeof(int) );
+    int *panSrcXOff2;
 
-    pafDstScanline = (float *) VSIMalloc((nDstXOff2 - nDstXOff) * sizeof(float));
-    if( pafDstScanline == NULL )
+    if( panSrcXOff == NULL )
     {
         CPLError( CE_Failure, CPLE_OutOfMemory,
                   "GDALDownsampleChunk32R: Out of memory for line buffer." );
         return CE_Failure;
     }
+    panSrcXOff2 = panSrcXOff + MAX(1, nDstXOff2 - nDstXOff);
 
-/* -------------------------------------------------------------------- */
-/*      Figure out the line to start writing to, and the first line     */
-/*      to not write to.  In theory this approach should ensure that    */
-/*      every output line will be written if all input chunks are       */
-/*      processed.                                                      */
-/* -------------------------------------------------------------------- */
-    nDstYOff = (int) (0.5 + (nChunkYOff/(double)nSrcHeight) * nOYSize);
-    nDstYOff2 = (int) 
-        (0.5 + ((nChunkYOff+nChunkYSize)/(double)nSrcHeight) * nOYSize);
+    for( int iDstPixel = nDstXOff; iDstPixel < nDstXOff2; iDstPixel++ )
+    {
+        int   nSrcXOff, nSrcXOff2;
 
-    if( nChunkYOff + nChunkYSize == nSrcHeight )
-        nDstYOff2 = nOYSize;
+        if (eResampling == GRM_Gauss) 
+        {
+            nSrcXOff = (int) (0.5 + (iDstPixel/(double)nOXSize) * nSrcWidth);
+            nSrcXOff2 = (int)(0.5 + ((iDstPixel+1)/(double)nOXSize) * nSrcWidth) + 1;
+
+            int iSizeX = nSrcXOff2 - nSrcXOff;
+            nSrcXOff = nSrcXOff + iSizeX/2 - nGaussMatrixDim/2;
+            nSrcXOff2 = nSrcXOff + nGaussMatrixDim;
+            if(nSrcXOff < 0)
+                nSrcXOff = 0;
+        }
+        else if( eResampling == GRM_Cubic )
+        {
+            nSrcXOff = (int) floor(((iDstPixel+0.5)/(double)nOXSize) * nSrcWidth - 0.5)-1;
+            nSrcXOff2 = nSrcXOff + 4;
+
+            if(nSrcXOff < 0)
+                nSrcXOff = 0;
+        }
+        else
+        {
+            nSrcXOff =
+                (int) (0.5 + (iDstPixel/(double)nOXSize) * nSrcWidth);
+            if ( nSrcXOff < nChunkXOff )
+                nSrcXOff = nChunkXOff;
+            nSrcXOff2 = (int) 
+                (0.5 + ((iDstPixel+1)/(double)nOXSize) * nSrcWidth);
+        }
+
+        if( nSrcXOff2 > nSrcWidth || iDstPixel == nOXSize-1 )
+            nSrcXOff2 = nSrcWidth;
+        if( nSrcXOff2 > nChunkXOff + nChunkXSize )
+            nSrcXOff2 = nChunkXOff + nChunkXSize;
 
+        panSrcXOff[iDstPixel - nDstXOff] = nSrcXOff;
+        panSrcXOff2[iDstPixel - nDstXOff] = nSrcXOff2;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Exact 2x2 averaging without mask or color table can be done     */
+/*      by lines of pixels, when each destination pixel has two         */
+/*      source columns in the chunk.                                    */
+/* -------------------------------------------------------------------- */
+    int bAverage2x2 = 
+        eResampling == GRM_Average
+        && (poColorTable == NULL 
+            || EQUALN(pszResampling,"AVERAGE_BIT2GRAYSCALE",13))
+        && pabyChunkNodataMask == NULL
+        && nSrcWidth == 2 * nOXSize && nChunkXOff % 2 == 0 
+        && (nChunkXSize % 2 == 0 || nChunkXOff + nChunkXSize == nSrcWidth)
+        && GDALOvrUseSIMD();
 
     int nEntryCount = 0;
     GDALColorEntry* aEntries = NULL;
@@ -193,6 +506,9 @@ GDALDownsampleChunk32R( int nSrcWidth, int nSrcHeight,
         GByte *pabySrcScanlineNodataMask;
         int   nSrcYOff, nSrcYOff2 = 0, iDstPixel;
 
+        pafDstScanline = pafDstBuffer 
+            + (iDstLine - nDstYOff) * (nDstXOff2 - nDstXOff);
+
         if (eResampling == GRM_Gauss)
         {
             nSrcYOff = (int) (0.5 + (iDstLine/(double)nOYSize) * nSrcHeight);
@@ -240,46 +556,22 @@ GDALDownsampleChunk32R( int nSrcWidth, int nSrcHeight,
         else
             pabySrcScanlineNodataMask = NULL;
 
+        if( bAverage2x2 && nSrcYOff2 - nSrcYOff == 2 )
+        {
+            GDALAverage2x2Float( pafSrcScanline + 2 * nDstXOff - nChunkXOff,
+                                 pafSrcScanline + 2 * nDstXOff - nChunkXOff 
+                                 + nChunkXSize,
+                                 nDstXOff2 - nDstXOff, pafDstScanline );
+            continue;
+        }
+
 /* -------------------------------------------------------------------- */
 /*      Loop over destination pixels                                    */
 /* -------------------------------------------------------------------- */
         for( iDstPixel = nDstXOff; iDstPixel < nDstXOff2; iDstPixel++ )
         {
-            int   nSrcXOff, nSrcXOff2;
-
-            if (eResampling == GRM_Gauss) 
-            {
-                nSrcXOff = (int) (0.5 + (iDstPixel/(double)nOXSize) * nSrcWidth);
-                nSrcXOff2 = (int)(0.5 + ((iDstPixel+1)/(double)nOXSize) * nSrcWidth) + 1;
-
-                int iSizeX = nSrcXOff2 - nSrcXOff;
-                nSrcXOff = nSrcXOff + iSizeX/2 - nGaussMatrixDim/2;
-                nSrcXOff2 = nSrcXOff + nGaussMatrixDim;
-                if(nSrcXOff < 0)
-                    nSrcXOff = 0;
-            }
-            else if( eResampling == GRM_Cubic )
-            {
-                nSrcXOff = (int) floor(((iDstPixel+0.5)/(double)nOXSize) * nSrcWidth - 0.5)-1;
-                nSrcXOff2 = nSrcXOff + 4;
-
-                if(nSrcXOff < 0)
-                    nSrcXOff = 0;
-            }
-            else
-            {
-                nSrcXOff =
-                    (int) (0.5 + (iDstPixel/(double)nOXSize) * nSrcWidth);
-                if ( nSrcXOff < nChunkXOff )
-                    nSrcXOff = nChunkXOff;
-                nSrcXOff2 = (int) 
-                    (0.5 + ((iDstPixel+1)/(double)nOXSize) * nSrcWidth);
-            }
-
-            if( nSrcXOff2 > nSrcWidth || iDstPixel == nOXSize-1 )
-                nSrcXOff2 = nSrcWidth;
-            if( nSrcXOff2 > nChunkXOff + nChunkXSize )
-                nSrcXOff2 = nChunkXOff + nChunkXSize;
+            int   nSrcXOff = panSrcXOff[iDstPixel - nDstXOff];
+            int   nSrcXOff2 = panSrcXOff2[iDstPixel - nDstXOff];
 
             if ( eResampling == GRM_Near )
             { 
@@ -625,16 +917,12 @@ GDALDownsampleChunk32R( int nSrcWidth, int nSrcHeight,
                 }
             } // end of gauss
         }
-
-        eErr = poOverview->RasterIO( GF_Write, nDstXOff, iDstLine, nDstXOff2 - nDstXOff, 1, 
-                                     pafDstScanline, nDstXOff2 - nDstXOff, 1, GDT_Float32, 
-                                     0, 0 );
     }
 
-    CPLFree( pafDstScanline );
     CPLFree( aEntries );
     CPLFree( pafVals );
     CPLFree( panSums );
+    CPLFree( panSrcXOff );
 
     return eErr;
 }
@@ -799,23 +1087,15 @@ GDALDownsampleChunkC32R( int nSrcWidth, int nSrcHeight,
 }
 
 /************************************************************************/
-/*                  GDALRegenerateCascadingOverviews()                  */
+/*                      GDALSortOverviewsBySize()                       */
 /*                                                                      */
-/*      Generate a list of overviews in order from largest to           */
-/*      smallest, computing each from the next larger.                  */
+/*      Put the overviews in order from largest to smallest.            */
 /************************************************************************/
 
-static CPLErr
-GDALRegenerateCascadingOverviews( 
-    GDALRasterBand *poSrcBand, int nOverviews, GDALRasterBand **papoOvrBands, 
-    const char * pszResampling, 
-    GDALProgressFunc pfnProgress, void * pProgressData )
+static void
+GDALSortOverviewsBySize( int nOverviews, GDALRasterBand **papoOvrBands )
 
 {
-/* -------------------------------------------------------------------- */
-/*      First, we must put the overviews in order from largest to       */
-/*      smallest.                                                       */
-/* -------------------------------------------------------------------- */
     int   i, j;
 
     for( i = 0; i < nOverviews-1; i++ )
@@ -836,6 +1116,29 @@ GDALRegenerateCascadingOverviews(
             }
         }
     }
+}
+
+/************************************************************************/
+/*                  GDALRegenerateCascadingOverviews()                  */
+/*                                                                      */
+/*      Generate a list of overviews in order from largest to           */
+/*      smallest, computing each from the next larger.                  */
+/************************************************************************/
+
+static CPLErr
+GDALRegenerateCascadingOverviews( 
+    GDALRasterBand *poSrcBand, int nOverviews, GDALRasterBand **papoOvrBands, 
+    const char * pszResampling, 
+    GDALProgressFunc pfnProgress, void * pProgressData )
+
+{
+    int   i;
+
+/* -------------------------------------------------------------------- */
+/*      First, we must put the overviews in order from largest to       */
+/*      smallest.                                                       */
+/* -------------------------------------------------------------------- */
+    GDALSortOverviewsBySize( nOverviews, papoOvrBands );
 
 /* -------------------------------------------------------------------- */
 /*      Count total pixels so we can prepare appropriate scaled         */
@@ -895,64 +1198,654 @@ GDALRegenerateCascadingOverviews(
 }
 
 /************************************************************************/
-/*                      GDALRegenerateOverviews()                       */
+/*                     GDALGetOverviewChunkYSize()                      */
+/*                                                                      */
+/*      Number of lines of a band processed at once when computing      */
+/*      overviews from it.                                              */
 /************************************************************************/
 
-/**
- * \brief Generate downsampled overviews.
- *
- * This function will generate one or more overview images from a base
- * image using the requested downsampling algorithm.  It's primary use
- * is for generating overviews via GDALDataset::BuildOverviews(), but it
- * can also be used to generate downsampled images in one file from another
- * outside the overview architecture.
- *
- * The output bands need to exist in advance. 
- *
- * The full set of resampling algorithms is documented in 
- * GDALDataset::BuildOverviews().
- *
- * This function will honour properly NODATA_VALUES tuples (special dataset metadata) so
- * that only a given RGB triplet (in case of a RGB image) will be considered as the
- * nodata value and not each value of the triplet independantly per band.
- *
- * @param hSrcBand the source (base level) band. 
- * @param nOverviewCount the number of downsampled bands being generated.
- * @param pahOvrBands the list of downsampled bands to be generated.
- * @param pszResampling Resampling algorithm (eg. "AVERAGE"). 
- * @param pfnProgress progress report function.
- * @param pProgressData progress function callback data.
- * @return CE_None on success or CE_Failure on failure.
- */
-CPLErr 
-GDALRegenerateOverviews( GDALRasterBandH hSrcBand,
-                         int nOverviewCount, GDALRasterBandH *pahOvrBands, 
-                         const char * pszResampling, 
-                         GDALProgressFunc pfnProgress, void * pProgressData )
+static int GDALGetOverviewChunkYSize( GDALRasterBand *poBand )
 
 {
-    GDALRasterBand *poSrcBand = (GDALRasterBand *) hSrcBand;
-    GDALRasterBand **papoOvrBands = (GDALRasterBand **) pahOvrBands;
-    int    nFullResYChunk, nWidth;
-    int    nFRXBlockSize, nFRYBlockSize;
-    GDALDataType eType;
-    int    bHasNoData;
-    float  fNoDataValue;
-    GDALColorTable* poColorTable = NULL;
+    int    nBlockXSize, nBlockYSize;
 
-    if( pfnProgress == NULL )
-        pfnProgress = GDALDummyProgress;
+    poBand->GetBlockSize( &nBlockXSize, &nBlockYSize );
+    
+    if( nBlockYSize < 16 || nBlockYSize > 256 )
+        return 64;
+    else
+        return nBlockYSize;
+}
 
-    if( EQUAL(pszResampling,"NONE") )
-        return CE_None;
+/************************************************************************/
+/*                      GDALCanCascadeInMemory()                        */
+/*                                                                      */
+/*      Can the overviews, sorted from largest to smallest, each be     */
+/*      computed from the lines of the next larger one still in         */
+/*      memory, instead of reading them back?  This gives the same      */
+/*      result only if the values read back would be the values         */
+/*      written, converted to the data type of the band, and if they    */
+/*      are used without a mask or a color table.                       */
+/************************************************************************/
 
-/* -------------------------------------------------------------------- */
-/*      Check color tables...                                           */
-/* -------------------------------------------------------------------- */
-    if ((EQUALN(pszResampling,"AVER",4)
-         || EQUALN(pszResampling,"MODE",4)
-         || EQUALN(pszResampling,"GAUSS",5)) &&
-        poSrcBand->GetColorInterpretation() == GCI_PaletteIndex)
+static int GDALCanCascadeInMemory( int nOverviews,
+                                   GDALRasterBand **papoOvrBands,
+                                   const char *pszResampling )
+
+{
+    if( EQUAL(pszResampling,"AVERAGE_MP") )
+        return FALSE;
+
+    for( int iOverview = 0; iOverview < nOverviews - 1; iOverview++ )
+    {
+        GDALRasterBand *poOvrBand = papoOvrBands[iOverview];
+        GDALDataset    *poOvrDS = poOvrBand->GetDataset();
+
+        if( GDALDataTypeIsComplex( poOvrBand->GetRasterDataType() )
+            || poOvrBand->GetColorInterpretation() == GCI_PaletteIndex
+            || (poOvrBand->GetMaskFlags() & GMF_ALL_VALID) == 0 )
+            return FALSE;
+
+        /* lossy or reduced precision storage */
+        if( poOvrBand->GetMetadataItem( "NBITS", "IMAGE_STRUCTURE" ) != NULL )
+            return FALSE;
+
+        const char *pszCompress = (poOvrDS == NULL) ? NULL :
+            poOvrDS->GetMetadataItem( "COMPRESSION", "IMAGE_STRUCTURE" );
+        if( pszCompress != NULL && strstr( pszCompress, "JPEG" ) != NULL )
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                            GDALOvrLevel                              */
+/*                                                                      */
+/*      One overview computed by GDALRegenerateOverviewsPipeline(),     */
+/*      with the band it is computed from.                              */
+/************************************************************************/
+
+typedef struct
+{
+    GDALRasterBand *poOvrBand;
+    int             nSrcWidth;
+    int             nSrcHeight;
+    const char     *pszResampling;
+    int             bHasNoData;
+    float           fNoDataValue;
+    GDALColorTable *poColorTable;
+    GDALDataType    eSrcDataType;
+
+    /* When cascading, the lines of this overview are gathered in */
+    /* chunks to compute the next overview. */
+    int             bFeedNext;
+    int             nNextChunkYSize;
+    void           *pNextChunk;
+    int             nNextChunkYOff;
+    int             nNextChunkLines;
+    int             nNextChunkMaxLines;
+} GDALOvrLevel;
+
+/************************************************************************/
+/*                             GDALOvrJob                               */
+/*                                                                      */
+/*      The computation of the lines of an overview coming from one     */
+/*      full width chunk of its source.                                 */
+/************************************************************************/
+
+typedef struct
+{
+    int             iLevel;
+    void           *pChunk;
+    GByte          *pabyChunkNodataMask;
+    int             bOwnChunk;
+    int             nChunkYOff;
+    int             nChunkYSize;
+    int             nDstYOff;
+    int             nDstYOff2;
+    void           *pDst;
+    CPLErr          eErr;
+} GDALOvrJob;
+
+typedef struct
+{
+    GDALOvrLevel   *pasLevels;
+    GDALOvrJob     *pasJobs;
+
+    /* GDT_Float32, or the Byte or Int16 type of all the bands when */
+    /* every overview is an exact 2x2 average of its source. */
+    GDALDataType    eWorkType;
+} GDALOvrJobList;
+
+/************************************************************************/
+/*                           GDALOvrJobFunc()                           */
+/************************************************************************/
+
+static int GDALOvrJobFunc( void *pUserData, int iJob )
+
+{
+    GDALOvrJobList *psList = (GDALOvrJobList *) pUserData;
+    GDALOvrJob     *psJob = psList->pasJobs + iJob;
+    GDALOvrLevel   *psLevel = psList->pasLevels + psJob->iLevel;
+
+    if( psList->eWorkType != GDT_Float32 )
+    {
+        GDALAverage2x2Chunk( psList->eWorkType, psJob->pChunk, 
+                             psJob->nChunkYOff, psLevel->poOvrBand->GetXSize(),
+                             psJob->nDstYOff, psJob->nDstYOff2, psJob->pDst );
+        return TRUE;
+    }
+
+    psJob->eErr = 
+        GDALDownsampleChunk32R( psLevel->nSrcWidth, psLevel->nSrcHeight,
+                                (float *) psJob->pChunk, 
+                                psJob->pabyChunkNodataMask,
+                                0, psLevel->nSrcWidth,
+                                psJob->nChunkYOff, psJob->nChunkYSize,
+                                psLevel->poOvrBand->GetXSize(),
+                                psLevel->poOvrBand->GetYSize(),
+                                (float *) psJob->pDst, psLevel->pszResampling,
+                                psLevel->bHasNoData, psLevel->fNoDataValue,
+                                psLevel->poColorTable, psLevel->eSrcDataType );
+
+    return psJob->eErr == CE_None;
+}
+
+/************************************************************************/
+/*                           GDALOvrAddJob()                            */
+/************************************************************************/
+
+static GDALOvrJob *GDALOvrAddJob( GDALOvrJob **ppasJobs, int *pnJobs,
+                                  int *pnMaxJobs )
+
+{
+    if( *pnJobs == *pnMaxJobs )
+    {
+        *pnMaxJobs = *pnMaxJobs * 2 + 16;
+        *ppasJobs = (GDALOvrJob *) 
+            CPLRealloc( *ppasJobs, sizeof(GDALOvrJob) * *pnMaxJobs );
+    }
+
+    GDALOvrJob *psJob = *ppasJobs + (*pnJobs)++;
+
+    memset( psJob, 0, sizeof(GDALOvrJob) );
+    psJob->eErr = CE_None;
+
+    return psJob;
+}
+
+/************************************************************************/
+/*                        GDALOvrFeedNextLevel()                        */
+/*                                                                      */
+/*      Append lines just written to an overview to the chunk being     */
+/*      gathered for the next overview.  Float32 lines are passed       */
+/*      through the data type of the overview first, so that they are   */
+/*      the values that would be read back.  Lines in the work type     */
+/*      of the overview are copied as they are.  Complete chunks are    */
+/*      queued as jobs.                                                 */
+/************************************************************************/
+
+static CPLErr GDALOvrFeedNextLevel( GDALOvrLevel *psLevel, int iNextLevel,
+                                    GDALDataType eWorkType,
+                                    void *pLines, int nLineOff, int nLines,
+                                    GByte *pabyConvBuf,
+                                    GDALOvrJob **ppasReady, int *pnReady,
+                                    int *pnMaxReady )
+
+{
+    int          nOXSize = psLevel->poOvrBand->GetXSize();
+    int          nOYSize = psLevel->poOvrBand->GetYSize();
+    GDALDataType eOvrType = psLevel->poOvrBand->GetRasterDataType();
+    int          nOvrTypeSize = GDALGetDataTypeSize( eOvrType ) / 8;
+    int          nWorkTypeSize = GDALGetDataTypeSize( eWorkType ) / 8;
+
+    for( int iLine = 0; iLine < nLines; iLine++ )
+    {
+        if( psLevel->pNextChunk == NULL )
+        {
+            psLevel->nNextChunkYOff = nLineOff + iLine;
+            psLevel->nNextChunkLines = 0;
+            psLevel->nNextChunkMaxLines = 
+                MIN( psLevel->nNextChunkYSize, 
+                     nOYSize - psLevel->nNextChunkYOff );
+            psLevel->pNextChunk = 
+                VSIMalloc3( nWorkTypeSize, psLevel->nNextChunkMaxLines, 
+                            nOXSize );
+            if( psLevel->pNextChunk == NULL )
+            {
+                CPLError( CE_Failure, CPLE_OutOfMemory, 
+                          "Out of memory in GDALRegenerateOverviews()." );
+                return CE_Failure;
+            }
+        }
+
+        GByte *pabySrcLine = ((GByte *) pLines) 
+            + iLine * nOXSize * nWorkTypeSize;
+        GByte *pabyDstLine = ((GByte *) psLevel->pNextChunk)
+            + psLevel->nNextChunkLines * nOXSize * nWorkTypeSize;
+
+        if( eOvrType == eWorkType )
+            memcpy( pabyDstLine, pabySrcLine, nWorkTypeSize * nOXSize );
+        else
+        {
+            GDALCopyWords( pabySrcLine, eWorkType, nWorkTypeSize,
+                           pabyConvBuf, eOvrType, nOvrTypeSize, nOXSize );
+            GDALCopyWords( pabyConvBuf, eOvrType, nOvrTypeSize,
+                           pabyDstLine, eWorkType, nWorkTypeSize, nOXSize );
+        }
+
+        if( ++psLevel->nNextChunkLines == psLevel->nNextChunkMaxLines )
+        {
+            GDALOvrJob *psJob = GDALOvrAddJob( ppasReady, pnReady, 
+                                               pnMaxReady );
+
+            psJob->iLevel = iNextLevel;
+            psJob->pChunk = psLevel->pNextChunk;
+            psJob->bOwnChunk = TRUE;
+            psJob->nChunkYOff = psLevel->nNextChunkYOff;
+            psJob->nChunkYSize = psLevel->nNextChunkLines;
+
+            psLevel->pNextChunk = NULL;
+        }
+    }
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                  GDALRegenerateOverviewsPipeline()                   */
+/*                                                                      */
+/*      Compute real valued overviews of a band.  Batches of chunks     */
+/*      of the band are read, then downsampled into every overview      */
+/*      on GDAL_NUM_THREADS threads, then the lines computed are        */
+/*      written in order.  If bCascade is TRUE, the overviews are       */
+/*      sorted from largest to smallest and each one but the first is   */
+/*      computed from the lines of the previous one as they are         */
+/*      produced, so the band is read only once.  Chunks have the       */
+/*      size used when processing one overview at a time, so the        */
+/*      result does not depend on the number of threads.                */
+/*                                                                      */
+/*      Byte and Int16 AVERAGE overviews that are each exactly half     */
+/*      the size of their source are computed in the data type of the  */
+/*      band rather than in Float32, with the same result.              */
+/************************************************************************/
+
+static CPLErr
+GDALRegenerateOverviewsPipeline( GDALRasterBand *poSrcBand,
+                                 int nOverviewCount, 
+                                 GDALRasterBand **papoOvrBands,
+                                 int bCascade,
+                                 const char *pszResampling,
+                                 int bUseNoDataMask,
+                                 GDALColorTable *poColorTable,
+                                 GDALProgressFunc pfnProgress, 
+                                 void *pProgressData )
+
+{
+    int    nWidth = poSrcBand->GetXSize();
+    int    nHeight = poSrcBand->GetYSize();
+    int    nFullResYChunk = GDALGetOverviewChunkYSize( poSrcBand );
+    int    nThreads = 
+        CPLParseNumThreads( CPLGetConfigOption( "GDAL_NUM_THREADS", NULL ), 1 );
+    int    iLevel, iJob, bHasNoData;
+    float  fNoDataValue;
+
+    fNoDataValue = (float) poSrcBand->GetNoDataValue(&bHasNoData);
+
+/* -------------------------------------------------------------------- */
+/*      Setup the overviews and the band each is computed from.         */
+/* -------------------------------------------------------------------- */
+    GDALOvrLevel *pasLevels = (GDALOvrLevel *) 
+        CPLCalloc( sizeof(GDALOvrLevel), nOverviewCount );
+    int nMaxOvrLineSize = 0;
+
+    for( iLevel = 0; iLevel < nOverviewCount; iLevel++ )
+    {
+        GDALOvrLevel *psLevel = pasLevels + iLevel;
+
+        psLevel->poOvrBand = papoOvrBands[iLevel];
+
+        if( !bCascade || iLevel == 0 )
+        {
+            psLevel->nSrcWidth = nWidth;
+            psLevel->nSrcHeight = nHeight;
+            psLevel->pszResampling = pszResampling;
+            psLevel->bHasNoData = bHasNoData;
+            psLevel->fNoDataValue = fNoDataValue;
+            psLevel->poColorTable = poColorTable;
+            psLevel->eSrcDataType = poSrcBand->GetRasterDataType();
+        }
+        else
+        {
+            GDALRasterBand *poLevelSrcBand = papoOvrBands[iLevel-1];
+            int bLevelHasNoData;
+
+            psLevel->nSrcWidth = poLevelSrcBand->GetXSize();
+            psLevel->nSrcHeight = poLevelSrcBand->GetYSize();
+
+            /* we only do the bit2grayscale promotion on the base band */
+            if( EQUALN(pszResampling,"AVERAGE_BIT2GRAYSCALE",13) )
+                psLevel->pszResampling = "AVERAGE";
+            else
+                psLevel->pszResampling = pszResampling;
+
+            psLevel->fNoDataValue = (float) 
+                poLevelSrcBand->GetNoDataValue( &bLevelHasNoData );
+            psLevel->bHasNoData = bLevelHasNoData;
+            psLevel->eSrcDataType = poLevelSrcBand->GetRasterDataType();
+
+            pasLevels[iLevel-1].bFeedNext = TRUE;
+            pasLevels[iLevel-1].nNextChunkYSize = 
+                GDALGetOverviewChunkYSize( poLevelSrcBand );
+        }
+
+        nMaxOvrLineSize = 
+            MAX( nMaxOvrLineSize, 
+                 psLevel->poOvrBand->GetXSize() 
+                 * (GDALGetDataTypeSize( 
+                        psLevel->poOvrBand->GetRasterDataType() ) / 8) );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Can all the overviews be computed as exact 2x2 averages in      */
+/*      the type of the band?  Chunks must start on even lines so       */
+/*      that no source pixel pair is split between two chunks.          */
+/* -------------------------------------------------------------------- */
+    GDALDataType eWorkType = GDT_Float32;
+    GDALDataType eSrcType = poSrcBand->GetRasterDataType();
+
+    if( (eSrcType == GDT_Byte || eSrcType == GDT_Int16)
+        && EQUAL(pszResampling,"AVERAGE") && !bUseNoDataMask 
+        && poColorTable == NULL && nFullResYChunk % 2 == 0
+        && GDALOvrUseSIMD() )
+    {
+        eWorkType = eSrcType;
+
+        for( iLevel = 0; iLevel < nOverviewCount; iLevel++ )
+        {
+            GDALOvrLevel *psLevel = pasLevels + iLevel;
+
+            if( psLevel->poOvrBand->GetRasterDataType() != eSrcType
+                || psLevel->nSrcWidth != 2 * psLevel->poOvrBand->GetXSize()
+                || psLevel->nSrcHeight != 2 * psLevel->poOvrBand->GetYSize()
+                || (psLevel->bFeedNext && psLevel->nNextChunkYSize % 2 != 0) )
+                eWorkType = GDT_Float32;
+        }
+    }
+
+    int nWorkTypeSize = GDALGetDataTypeSize( eWorkType ) / 8;
+
+    GByte *pabyConvBuf = (GByte *) VSIMalloc( MAX(1,nMaxOvrLineSize) );
+    if( pabyConvBuf == NULL )
+    {
+        CPLFree( pasLevels );
+        CPLError( CE_Failure, CPLE_OutOfMemory, 
+                  "Out of memory in GDALRegenerateOverviews()." );
+        return CE_Failure;
+    }
+
+/* ==================================================================== */
+/*      Loop over the image, a batch of chunks at a time.               */
+/* ==================================================================== */
+    GDALOvrJob *pasJobs = NULL, *pasReady = NULL;
+    int    nJobs = 0, nMaxJobs = 0, nReady = 0, nMaxReady = 0;
+    int    nChunkYOff = 0;
+    CPLErr eErr = CE_None;
+
+    while( eErr == CE_None && (nChunkYOff < nHeight || nReady > 0) )
+    {
+        if( !pfnProgress( nChunkYOff / (double) nHeight, 
+                          NULL, pProgressData ) )
+        {
+            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+            eErr = CE_Failure;
+            break;
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Read the next chunks of the band, and queue the jobs of the     */
+/*      overviews computed from it.                                     */
+/* -------------------------------------------------------------------- */
+        nJobs = 0;
+
+        for( int iChunk = 0; 
+             iChunk < nThreads && nChunkYOff < nHeight && eErr == CE_None; 
+             iChunk++ )
+        {
+            int    nChunkYSize = MIN( nFullResYChunk, nHeight - nChunkYOff );
+            float *pafChunk;
+            GByte *pabyChunkNodataMask = NULL;
+
+            pafChunk = (float *) 
+                VSIMalloc3( nWorkTypeSize, nChunkYSize, nWidth );
+            if( bUseNoDataMask )
+                pabyChunkNodataMask = (GByte *) 
+                    VSIMalloc2( nChunkYSize, nWidth );
+
+            if( pafChunk == NULL 
+                || (bUseNoDataMask && pabyChunkNodataMask == NULL) )
+            {
+                CPLFree( pafChunk );
+                CPLFree( pabyChunkNodataMask );
+                CPLError( CE_Failure, CPLE_OutOfMemory, 
+                          "Out of memory in GDALRegenerateOverviews()." );
+                eErr = CE_Failure;
+                break;
+            }
+
+            for( iLevel = 0; iLevel < nOverviewCount; iLevel++ )
+            {
+                if( bCascade && iLevel > 0 )
+                    break;
+
+                GDALOvrJob *psJob = GDALOvrAddJob( &pasJobs, &nJobs, 
+                                                   &nMaxJobs );
+
+                psJob->iLevel = iLevel;
+                psJob->pChunk = pafChunk;
+                psJob->pabyChunkNodataMask = pabyChunkNodataMask;
+                psJob->bOwnChunk = (iLevel == 0);
+                psJob->nChunkYOff = nChunkYOff;
+                psJob->nChunkYSize = nChunkYSize;
+            }
+
+            eErr = poSrcBand->RasterIO( GF_Read, 0, nChunkYOff, 
+                                        nWidth, nChunkYSize, 
+                                        pafChunk, nWidth, nChunkYSize, 
+                                        eWorkType, 0, 0 );
+            if( eErr == CE_None && bUseNoDataMask )
+                eErr = poSrcBand->GetMaskBand()->RasterIO( 
+                    GF_Read, 0, nChunkYOff, nWidth, nChunkYSize, 
+                    pabyChunkNodataMask, nWidth, nChunkYSize, GDT_Byte, 0, 0 );
+
+            /* special case to promote 1bit data to 8bit 0/255 values */
+            if( EQUAL(pszResampling,"AVERAGE_BIT2GRAYSCALE") )
+            {
+                for( int i = nChunkYSize*nWidth - 1; i >= 0; i-- )
+                {
+                    if( pafChunk[i] == 1.0 )
+                        pafChunk[i] = 255.0;
+                }
+            }
+            else if( EQUAL(pszResampling,"AVERAGE_BIT2GRAYSCALE_MINISWHITE") )
+            {
+                for( int i = nChunkYSize*nWidth - 1; i >= 0; i-- )
+                {
+                    if( pafChunk[i] == 1.0 )
+                        pafChunk[i] = 0.0;
+                    else if( pafChunk[i] == 0.0 )
+                        pafChunk[i] = 255.0;
+                }
+            }
+
+            nChunkYOff += nChunkYSize;
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Add the chunks of the cascaded overviews completed in the       */
+/*      previous round.                                                 */
+/* -------------------------------------------------------------------- */
+        for( iJob = 0; iJob < nReady; iJob++ )
+            *GDALOvrAddJob( &pasJobs, &nJobs, &nMaxJobs ) = pasReady[iJob];
+        nReady = 0;
+
+/* -------------------------------------------------------------------- */
+/*      Allocate the lines computed by each job, and run the jobs.      */
+/* -------------------------------------------------------------------- */
+        for( iJob = 0; iJob < nJobs && eErr == CE_None; iJob++ )
+        {
+            GDALOvrJob   *psJob = pasJobs + iJob;
+            GDALOvrLevel *psLevel = pasLevels + psJob->iLevel;
+            int nDstXOff, nDstXOff2;
+
+            GDALDownsampleChunkDstWindow( psLevel->nSrcWidth, 
+                                          psLevel->nSrcHeight,
+                                          0, psLevel->nSrcWidth,
+                                          psJob->nChunkYOff, 
+                                          psJob->nChunkYSize,
+                                          psLevel->poOvrBand->GetXSize(),
+                                          psLevel->poOvrBand->GetYSize(),
+                                          &nDstXOff, &nDstXOff2,
+                                          &(psJob->nDstYOff), 
+                                          &(psJob->nDstYOff2) );
+
+            psJob->pDst = 
+                VSIMalloc3( nWorkTypeSize, 
+                            MAX(1, psJob->nDstYOff2 - psJob->nDstYOff),
+                            MAX(1, nDstXOff2 - nDstXOff) );
+            if( psJob->pDst == NULL )
+            {
+                CPLError( CE_Failure, CPLE_OutOfMemory, 
+                          "Out of memory in GDALRegenerateOverviews()." );
+                eErr = CE_Failure;
+            }
+        }
+
+        if( eErr == CE_None )
+        {
+            GDALOvrJobList sList;
+
+            sList.pasLevels = pasLevels;
+            sList.pasJobs = pasJobs;
+            sList.eWorkType = eWorkType;
+
+            CPLRunJobs( nJobs, nThreads, GDALOvrJobFunc, &sList );
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Write the lines in order, and pass them on to the next          */
+/*      overview when cascading.                                        */
+/* -------------------------------------------------------------------- */
+        for( iJob = 0; iJob < nJobs && eErr == CE_None; iJob++ )
+        {
+            GDALOvrJob   *psJob = pasJobs + iJob;
+            GDALOvrLevel *psLevel = pasLevels + psJob->iLevel;
+            int nOXSize = psLevel->poOvrBand->GetXSize();
+            int nLines = psJob->nDstYOff2 - psJob->nDstYOff;
+
+            eErr = psJob->eErr;
+            if( eErr == CE_None && nLines > 0 )
+                eErr = psLevel->poOvrBand->RasterIO( 
+                    GF_Write, 0, psJob->nDstYOff, nOXSize, nLines, 
+                    psJob->pDst, nOXSize, nLines, eWorkType, 0, 0 );
+
+            if( eErr == CE_None && psLevel->bFeedNext )
+                eErr = GDALOvrFeedNextLevel( psLevel, psJob->iLevel + 1,
+                                             eWorkType, psJob->pDst, 
+                                             psJob->nDstYOff, nLines,
+                                             pabyConvBuf, &pasReady, 
+                                             &nReady, &nMaxReady );
+        }
+
+        for( iJob = 0; iJob < nJobs; iJob++ )
+        {
+            if( pasJobs[iJob].bOwnChunk )
+            {
+                CPLFree( pasJobs[iJob].pChunk );
+                CPLFree( pasJobs[iJob].pabyChunkNodataMask );
+            }
+            CPLFree( pasJobs[iJob].pDst );
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Cleanup what is left after a failure.                           */
+/* -------------------------------------------------------------------- */
+    for( iJob = 0; iJob < nReady; iJob++ )
+        CPLFree( pasReady[iJob].pChunk );
+
+    for( iLevel = 0; iLevel < nOverviewCount; iLevel++ )
+        CPLFree( pasLevels[iLevel].pNextChunk );
+
+    CPLFree( pasJobs );
+    CPLFree( pasReady );
+    CPLFree( pasLevels );
+    CPLFree( pabyConvBuf );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                      GDALRegenerateOverviews()                       */
+/************************************************************************/
+
+/**
+ * \brief Generate downsampled overviews.
+ *
+ * This function will generate one or more overview images from a base
+ * image using the requested downsampling algorithm.  It's primary use
+ * is for generating overviews via GDALDataset::BuildOverviews(), but it
+ * can also be used to generate downsampled images in one file from another
+ * outside the overview architecture.
+ *
+ * The output bands need to exist in advance. 
+ *
+ * The full set of resampling algorithms is documented in 
+ * GDALDataset::BuildOverviews().
+ *
+ * This function will honour properly NODATA_VALUES tuples (special dataset metadata) so
+ * that only a given RGB triplet (in case of a RGB image) will be considered as the
+ * nodata value and not each value of the triplet independantly per band.
+ *
+ * The chunks of the source band are downsampled on the number of threads
+ * given by the GDAL_NUM_THREADS configuration option, a number or ALL_CPUS,
+ * which defaults to 1.  The result does not depend on the number of threads.
+ *
+ * @param hSrcBand the source (base level) band. 
+ * @param nOverviewCount the number of downsampled bands being generated.
+ * @param pahOvrBands the list of downsampled bands to be generated.
+ * @param pszResampling Resampling algorithm (eg. "AVERAGE"). 
+ * @param pfnProgress progress report function.
+ * @param pProgressData progress function callback data.
+ * @return CE_None on success or CE_Failure on failure.
+ */
+CPLErr 
+GDALRegenerateOverviews( GDALRasterBandH hSrcBand,
+                         int nOverviewCount, GDALRasterBandH *pahOvrBands, 
+                         const char * pszResampling, 
+                         GDALProgressFunc pfnProgress, void * pProgressData )
+
+{
+    GDALRasterBand *poSrcBand = (GDALRasterBand *) hSrcBand;
+    GDALRasterBand **papoOvrBands = (GDALRasterBand **) pahOvrBands;
+    int    nFullResYChunk, nWidth;
+    GDALColorTable* poColorTable = NULL;
+    int    bCascade = FALSE;
+
+    if( pfnProgress == NULL )
+        pfnProgress = GDALDummyProgress;
+
+    if( EQUAL(pszResampling,"NONE") )
+        return CE_None;
+
+/* -------------------------------------------------------------------- */
+/*      Check color tables...                                           */
+/* -------------------------------------------------------------------- */
+    if ((EQUALN(pszResampling,"AVER",4)
+         || EQUALN(pszResampling,"MODE",4)
+         || EQUALN(pszResampling,"GAUSS",5)) &&
+        poSrcBand->GetColorInterpretation() == GCI_PaletteIndex)
     {
         poColorTable = poSrcBand->GetColorTable();
         if (poColorTable != NULL)
@@ -991,125 +1884,90 @@ GDALRegenerateOverviews( GDALRasterBandH hSrcBand,
     /* of the band used for the mask band may not have yet occured (#3033) */
     if( (EQUALN(pszResampling,"AVER",4) || EQUALN(pszResampling,"GAUSS",5)) && nOverviewCount > 1
          && !(bUseNoDataMask && poSrcBand->GetMaskFlags() != GMF_NODATA))
-        return GDALRegenerateCascadingOverviews( poSrcBand, 
-                                                 nOverviewCount, papoOvrBands,
-                                                 pszResampling, 
-                                                 pfnProgress,
-                                                 pProgressData );
-
-/* -------------------------------------------------------------------- */
-/*      Setup one horizontal swath to read from the raw buffer.         */
-/* -------------------------------------------------------------------- */
-    float *pafChunk;
-    GByte *pabyChunkNodataMask = NULL;
-
-    poSrcBand->GetBlockSize( &nFRXBlockSize, &nFRYBlockSize );
-    
-    if( nFRYBlockSize < 16 || nFRYBlockSize > 256 )
-        nFullResYChunk = 64;
-    else
-        nFullResYChunk = nFRYBlockSize;
-
-    if( GDALDataTypeIsComplex( poSrcBand->GetRasterDataType() ) )
-        eType = GDT_CFloat32;
-    else
-        eType = GDT_Float32;
-
-    nWidth = poSrcBand->GetXSize();
-    pafChunk = (float *) 
-        VSIMalloc3((GDALGetDataTypeSize(eType)/8), nFullResYChunk, nWidth );
-    if (bUseNoDataMask)
     {
-        pabyChunkNodataMask = (GByte *) 
-            (GByte*) VSIMalloc2( nFullResYChunk, nWidth );
+        /* Compute each overview from the lines of the previous one while */
+        /* they are still in memory when this gives the same result as */
+        /* reading them back, otherwise one overview after the other. */
+        GDALSortOverviewsBySize( nOverviewCount, papoOvrBands );
+
+        if( GDALDataTypeIsComplex( poSrcBand->GetRasterDataType() )
+            || !GDALCanCascadeInMemory( nOverviewCount, papoOvrBands, 
+                                        pszResampling ) )
+            return GDALRegenerateCascadingOverviews( poSrcBand, 
+                                                     nOverviewCount, papoOvrBands,
+                                                     pszResampling, 
+                                                     pfnProgress,
+                                                     pProgressData );
+        bCascade = TRUE;
     }
 
-    if( pafChunk == NULL || (bUseNoDataMask && pabyChunkNodataMask == NULL))
-    {
-        CPLFree(pafChunk);
-        CPLFree(pabyChunkNodataMask);
-        CPLError( CE_Failure, CPLE_OutOfMemory, 
-                  "Out of memory in GDALRegenerateOverviews()." );
+    CPLErr eErr = CE_None;
 
-        return CE_Failure;
+/* -------------------------------------------------------------------- */
+/*      Real valued bands are computed by a batch of chunks at a time,  */
+/*      possibly on several threads.                                    */
+/* -------------------------------------------------------------------- */
+    if( !GDALDataTypeIsComplex( poSrcBand->GetRasterDataType() ) )
+    {
+        eErr = GDALRegenerateOverviewsPipeline( poSrcBand, 
+                                                nOverviewCount, papoOvrBands,
+                                                bCascade, pszResampling,
+                                                bUseNoDataMask, poColorTable,
+                                                pfnProgress, pProgressData );
     }
 
-    fNoDataValue = (float) poSrcBand->GetNoDataValue(&bHasNoData);
-
 /* -------------------------------------------------------------------- */
-/*      Loop over image operating on chunks.                            */
+/*      Complex bands: setup one horizontal swath to read from the     */
+/*      raw buffer and loop over image operating on chunks.             */
 /* -------------------------------------------------------------------- */
-    int  nChunkYOff = 0;
-    CPLErr eErr = CE_None;
-
-    for( nChunkYOff = 0; 
-         nChunkYOff < poSrcBand->GetYSize() && eErr == CE_None; 
-         nChunkYOff += nFullResYChunk )
+    else
     {
-        if( !pfnProgress( nChunkYOff / (double) poSrcBand->GetYSize(), 
-                          NULL, pProgressData ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        float *pafChunk;
+        int  nChunkYOff = 0;
 
-        if( nFullResYChunk + nChunkYOff > poSrcBand->GetYSize() )
-            nFullResYChunk = poSrcBand->GetYSize() - nChunkYOff;
-        
-        /* read chunk */
-        if (eErr == CE_None)
-            eErr = poSrcBand->RasterIO( GF_Read, 0, nChunkYOff, nWidth, nFullResYChunk, 
-                                pafChunk, nWidth, nFullResYChunk, eType,
-                                0, 0 );
-        if (eErr == CE_None && bUseNoDataMask)
-            eErr = poSrcBand->GetMaskBand()->RasterIO( GF_Read, 0, nChunkYOff, nWidth, nFullResYChunk, 
-                                pabyChunkNodataMask, nWidth, nFullResYChunk, GDT_Byte,
-                                0, 0 );
-
-        /* special case to promote 1bit data to 8bit 0/255 values */
-        if( EQUAL(pszResampling,"AVERAGE_BIT2GRAYSCALE") )
+        nFullResYChunk = GDALGetOverviewChunkYSize( poSrcBand );
+        nWidth = poSrcBand->GetXSize();
+
+        pafChunk = (float *) 
+            VSIMalloc3((GDALGetDataTypeSize(GDT_CFloat32)/8), nFullResYChunk, nWidth );
+        if( pafChunk == NULL )
         {
-            int i;
+            CPLError( CE_Failure, CPLE_OutOfMemory, 
+                      "Out of memory in GDALRegenerateOverviews()." );
 
-            for( i = nFullResYChunk*nWidth - 1; i >= 0; i-- )
-            {
-                if( pafChunk[i] == 1.0 )
-                    pafChunk[i] = 255.0;
-            }
+            return CE_Failure;
         }
-        else if( EQUAL(pszResampling,"AVERAGE_BIT2GRAYSCALE_MINISWHITE") )
-        {
-            int i;
 
-            for( i = nFullResYChunk*nWidth - 1; i >= 0; i-- )
+        for( nChunkYOff = 0; 
+             nChunkYOff < poSrcBand->GetYSize() && eErr == CE_None; 
+             nChunkYOff += nFullResYChunk )
+        {
+            if( !pfnProgress( nChunkYOff / (double) poSrcBand->GetYSize(), 
+                              NULL, pProgressData ) )
             {
-                if( pafChunk[i] == 1.0 )
-                    pafChunk[i] = 0.0;
-                else if( pafChunk[i] == 0.0 )
-                    pafChunk[i] = 255.0;
+                CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+                eErr = CE_Failure;
             }
-        }
+
+            if( nFullResYChunk + nChunkYOff > poSrcBand->GetYSize() )
+                nFullResYChunk = poSrcBand->GetYSize() - nChunkYOff;
         
-        for( int iOverview = 0; iOverview < nOverviewCount && eErr == CE_None; iOverview++ )
-        {
-            if( eType == GDT_Float32 )
-                eErr = GDALDownsampleChunk32R(nWidth, poSrcBand->GetYSize(), 
-                                              pafChunk,
-                                              pabyChunkNodataMask,
-                                              0, nWidth,
-                                              nChunkYOff, nFullResYChunk,
-                                              papoOvrBands[iOverview], pszResampling,
-                                              bHasNoData, fNoDataValue, poColorTable,
-                                              poSrcBand->GetRasterDataType());
-            else
+            /* read chunk */
+            if (eErr == CE_None)
+                eErr = poSrcBand->RasterIO( GF_Read, 0, nChunkYOff, nWidth, nFullResYChunk, 
+                                    pafChunk, nWidth, nFullResYChunk, GDT_CFloat32,
+                                    0, 0 );
+
+            for( int iOverview = 0; iOverview < nOverviewCount && eErr == CE_None; iOverview++ )
+            {
                 eErr = GDALDownsampleChunkC32R(nWidth, poSrcBand->GetYSize(), 
                                                pafChunk, nChunkYOff, nFullResYChunk,
                                                papoOvrBands[iOverview], pszResampling);
+            }
         }
-    }
 
-    VSIFree( pafChunk );
-    VSIFree( pabyChunkNodataMask );
+        VSIFree( pafChunk );
+    }
     
 /* -------------------------------------------------------------------- */
 /*      Renormalized overview mean / stddev if needed.                  */
@@ -1140,6 +1998,64 @@ GDALRegenerateOverviews( GDALRasterBandH hSrcBand,
 
 
 
+/************************************************************************/
+/*                       GDALOvrMultiBandChunk                          */
+/*                                                                      */
+/*      A chunk of all the bands read by                                */
+/*      GDALRegenerateOverviewsMultiBand().                             */
+/************************************************************************/
+
+typedef struct
+{
+    int     nChunkXOff, nChunkYOff, nXCount, nYCount;
+    int     nDstXOff, nDstXOff2, nDstYOff, nDstYOff2;
+    float **papafChunk;
+    GByte  *pabyChunkNoDataMask;
+} GDALOvrMultiBandChunk;
+
+typedef struct
+{
+    int           nBands;
+    int           nSrcWidth, nSrcHeight, nDstWidth, nDstHeight;
+    const char   *pszResampling;
+    int          *pabHasNoData;
+    float        *pafNoDataValue;
+    GDALDataType  eDataType;
+    GDALOvrMultiBandChunk *pasChunks;
+
+    /* Indexed by job, that is chunk * nBands + band */
+    float       **papafDst;
+    CPLErr       *paeErr;
+} GDALOvrMultiBandJobList;
+
+/************************************************************************/
+/*                      GDALOvrMultiBandJobFunc()                       */
+/************************************************************************/
+
+static int GDALOvrMultiBandJobFunc( void *pUserData, int iJob )
+
+{
+    GDALOvrMultiBandJobList *psList = (GDALOvrMultiBandJobList *) pUserData;
+    GDALOvrMultiBandChunk   *psChunk = psList->pasChunks + iJob / psList->nBands;
+    int iBand = iJob % psList->nBands;
+
+    psList->paeErr[iJob] = 
+        GDALDownsampleChunk32R( psList->nSrcWidth, psList->nSrcHeight,
+                                psChunk->papafChunk[iBand],
+                                psChunk->pabyChunkNoDataMask,
+                                psChunk->nChunkXOff, psChunk->nXCount,
+                                psChunk->nChunkYOff, psChunk->nYCount,
+                                psList->nDstWidth, psList->nDstHeight,
+                                psList->papafDst[iJob],
+                                psList->pszResampling,
+                                psList->pabHasNoData[iBand],
+                                psList->pafNoDataValue[iBand],
+                                /*poColorTable*/ NULL,
+                                psList->eDataType );
+
+    return psList->paeErr[iJob] == CE_None;
+}
+
 /************************************************************************/
 /*            GDALRegenerateOverviewsMultiBand()                        */
 /************************************************************************/
@@ -1167,6 +2083,10 @@ GDALRegenerateOverviews( GDALRasterBandH hSrcBand,
  *               read the source data of size deltax * deltay for all the bands
  *               generate the corresponding overview block for all the bands
  *
+ * Chunks are read in batches, and the overview blocks of a batch are computed
+ * on the number of threads given by the GDAL_NUM_THREADS configuration option,
+ * then written in order.
+ *
  * This function will honour properly NODATA_VALUES tuples (special dataset metadata) so
  * that only a given RGB triplet (in case of a RGB image) will be considered as the
  * nodata value and not each value of the triplet independantly per band.
@@ -1286,6 +2206,25 @@ GDALRegenerateOverviewsMultiBand(int nBands, GDALRasterBand** papoSrcBands,
     }
 
     /* Second pass to do the real job ! */
+    /* Batches of chunks of all the bands are read, then downsampled on */
+    /* GDAL_NUM_THREADS threads, then written in order. */
+    int nThreads = 
+        CPLParseNumThreads( CPLGetConfigOption( "GDAL_NUM_THREADS", NULL ), 1 );
+    int nChunkSlots = nThreads, iSlot;
+    GDALOvrMultiBandJobList sList;
+
+    sList.nBands = nBands;
+    sList.pszResampling = pszResampling;
+    sList.pabHasNoData = pabHasNoData;
+    sList.pafNoDataValue = pafNoDataValue;
+    sList.eDataType = eDataType;
+    sList.pasChunks = (GDALOvrMultiBandChunk *) 
+        CPLCalloc( sizeof(GDALOvrMultiBandChunk), nChunkSlots );
+    sList.papafDst = (float **) 
+        CPLCalloc( sizeof(float *), nChunkSlots * nBands );
+    sList.paeErr = (CPLErr *) 
+        CPLMalloc( sizeof(CPLErr) * nChunkSlots * nBands );
+
     double dfCurPixelCount = 0;
     for(iOverview=0;iOverview<nOverviews && eErr == CE_None;iOverview++)
     {
@@ -1297,6 +2236,9 @@ GDALRegenerateOverviewsMultiBand(int nBands, GDALRasterBand** papoSrcBands,
         nDstWidth = papapoOverviewBands[0][iOverview]->GetXSize();
         nDstHeight = papapoOverviewBands[0][iOverview]->GetYSize();
 
+        nSrcWidth = papoSrcBands[0]->GetXSize();
+        nSrcHeight = papoSrcBands[0]->GetYSize();
+
         /* Try to use previous level of overview as the source to compute */
         /* the next level */
         if (iOverview > 0 && papapoOverviewBands[0][iOverview - 1]->GetXSize() > nDstWidth)
@@ -1311,52 +2253,42 @@ GDALRegenerateOverviewsMultiBand(int nBands, GDALRasterBand** papoSrcBands,
         int nFullResXChunk = (nDstBlockXSize * nSrcWidth) / nDstWidth;
         int nFullResYChunk = (nDstBlockYSize * nSrcHeight) / nDstHeight;
 
-        float** papafChunk = (float**) CPLMalloc(nBands * sizeof(void*));
-        GByte* pabyChunkNoDataMask = NULL;
-        for(iBand=0;iBand<nBands;iBand++)
+        sList.nSrcWidth = nSrcWidth;
+        sList.nSrcHeight = nSrcHeight;
+        sList.nDstWidth = nDstWidth;
+        sList.nDstHeight = nDstHeight;
+
+        for( iSlot = 0; iSlot < nChunkSlots && eErr == CE_None; iSlot++ )
         {
-            papafChunk[iBand] = (float*) VSIMalloc3(nFullResXChunk, nFullResYChunk, sizeof(float));
-            if( papafChunk[iBand] == NULL )
-            {
-                while ( --iBand >= 0)
-                    CPLFree(papafChunk[iBand]);
-                CPLFree(papafChunk);
-                CPLFree(pabHasNoData);
-                CPLFree(pafNoDataValue);
+            GDALOvrMultiBandChunk *psChunk = sList.pasChunks + iSlot;
 
-                CPLError( CE_Failure, CPLE_OutOfMemory,
-                        "GDALRegenerateOverviewsMultiBand: Out of memory." );
-                return CE_Failure;
+            psChunk->papafChunk = (float**) CPLCalloc(nBands, sizeof(void*));
+            for(iBand=0;iBand<nBands && eErr == CE_None;iBand++)
+            {
+                psChunk->papafChunk[iBand] = (float*) VSIMalloc3(nFullResXChunk, nFullResYChunk, sizeof(float));
+                if( psChunk->papafChunk[iBand] == NULL )
+                    eErr = CE_Failure;
             }
-        }
-        if (bUseNoDataMask)
-        {
-            pabyChunkNoDataMask = (GByte*) VSIMalloc2(nFullResXChunk, nFullResYChunk);
-            if( pabyChunkNoDataMask == NULL )
+            if (bUseNoDataMask && eErr == CE_None)
             {
-                for(iBand=0;iBand<nBands;iBand++)
-                {
-                    CPLFree(papafChunk[iBand]);
-                }
-                CPLFree(papafChunk);
-                CPLFree(pabHasNoData);
-                CPLFree(pafNoDataValue);
-
+                psChunk->pabyChunkNoDataMask = (GByte*) VSIMalloc2(nFullResXChunk, nFullResYChunk);
+                if( psChunk->pabyChunkNoDataMask == NULL )
+                    eErr = CE_Failure;
+            }
+            if( eErr != CE_None )
                 CPLError( CE_Failure, CPLE_OutOfMemory,
                         "GDALRegenerateOverviewsMultiBand: Out of memory." );
-                return CE_Failure;
-            }
         }
 
-        int nChunkYOff;
+        int nXChunks = (nSrcWidth + nFullResXChunk - 1) / nFullResXChunk;
+        int nYChunks = (nSrcHeight + nFullResYChunk - 1) / nFullResYChunk;
+        int nChunks = nXChunks * nYChunks;
+        int iChunk;
+
         /* Iterate on destination overview, block by block */
-        for( nChunkYOff = 0; nChunkYOff < nSrcHeight && eErr == CE_None; nChunkYOff += nFullResYChunk )
+        for( iChunk = 0; iChunk < nChunks && eErr == CE_None; iChunk += nChunkSlots )
         {
-            int nYCount;
-            if  (nChunkYOff + nFullResYChunk <= nSrcHeight)
-                nYCount = nFullResYChunk;
-            else
-                nYCount = nSrcHeight - nChunkYOff;
+            int nBatch = MIN(nChunkSlots, nChunks - iChunk);
 
             if( !pfnProgress( dfCurPixelCount / dfTotalPixelCount, 
                               NULL, pProgressData ) )
@@ -1365,14 +2297,18 @@ GDALRegenerateOverviewsMultiBand(int nBands, GDALRasterBand** papoSrcBands,
                 eErr = CE_Failure;
             }
 
-            int nChunkXOff;
-            for( nChunkXOff = 0; nChunkXOff < nSrcWidth && eErr == CE_None; nChunkXOff += nFullResXChunk )
+            for( iSlot = 0; iSlot < nBatch && eErr == CE_None; iSlot++ )
             {
-                int nXCount;
-                if  (nChunkXOff + nFullResXChunk <= nSrcWidth)
-                    nXCount = nFullResXChunk;
-                else
-                    nXCount = nSrcWidth - nChunkXOff;
+                GDALOvrMultiBandChunk *psChunk = sList.pasChunks + iSlot;
+                int nChunkXOff = ((iChunk + iSlot) % nXChunks) * nFullResXChunk;
+                int nChunkYOff = ((iChunk + iSlot) / nXChunks) * nFullResYChunk;
+                int nXCount = MIN(nFullResXChunk, nSrcWidth - nChunkXOff);
+                int nYCount = MIN(nFullResYChunk, nSrcHeight - nChunkYOff);
+
+                psChunk->nChunkXOff = nChunkXOff;
+                psChunk->nChunkYOff = nChunkYOff;
+                psChunk->nXCount = nXCount;
+                psChunk->nYCount = nYCount;
 
                 /* Read the source buffers for all the bands */
                 for(iBand=0;iBand<nBands && eErr == CE_None;iBand++)
@@ -1385,7 +2321,7 @@ GDALRegenerateOverviewsMultiBand(int nBands, GDALRasterBand** papoSrcBands,
                     eErr = poSrcBand->RasterIO( GF_Read,
                                                 nChunkXOff, nChunkYOff,
                                                 nXCount, nYCount, 
-                                                papafChunk[iBand],
+                                                psChunk->papafChunk[iBand],
                                                 nXCount, nYCount,
                                                 GDT_Float32, 0, 0 );
                 }
@@ -1400,42 +2336,90 @@ GDALRegenerateOverviewsMultiBand(int nBands, GDALRasterBand** papoSrcBands,
                     eErr = poSrcBand->GetMaskBand()->RasterIO( GF_Read,
                                                                nChunkXOff, nChunkYOff,
                                                                nXCount, nYCount, 
-                                                               pabyChunkNoDataMask,
+                                                               psChunk->pabyChunkNoDataMask,
                                                                nXCount, nYCount,
                                                                GDT_Byte, 0, 0 );
                 }
 
-                /* Compute the resulting overview block */
+                /* Allocate the resulting overview blocks */
+                GDALDownsampleChunkDstWindow( nSrcWidth, nSrcHeight,
+                                              nChunkXOff, nXCount,
+                                              nChunkYOff, nYCount,
+                                              nDstWidth, nDstHeight,
+                                              &(psChunk->nDstXOff), 
+                                              &(psChunk->nDstXOff2),
+                                              &(psChunk->nDstYOff), 
+                                              &(psChunk->nDstYOff2) );
+
+                for(iBand=0;iBand<nBands && eErr == CE_None;iBand++)
+                {
+                    float *pafDst = (float *) 
+                        VSIMalloc3( sizeof(float), 
+                                    MAX(1, psChunk->nDstXOff2 - psChunk->nDstXOff),
+                                    MAX(1, psChunk->nDstYOff2 - psChunk->nDstYOff) );
+
+                    sList.papafDst[iSlot * nBands + iBand] = pafDst;
+                    if( pafDst == NULL )
+                    {
+                        CPLError( CE_Failure, CPLE_OutOfMemory,
+                                "GDALRegenerateOverviewsMultiBand: Out of memory." );
+                        eErr = CE_Failure;
+                    }
+                }
+            }
+
+            /* Compute the resulting overview blocks */
+            if( eErr == CE_None )
+                CPLRunJobs( nBatch * nBands, nThreads, 
+                            GDALOvrMultiBandJobFunc, &sList );
+
+            /* and write them in order */
+            for( iSlot = 0; iSlot < nBatch && eErr == CE_None; iSlot++ )
+            {
+                GDALOvrMultiBandChunk *psChunk = sList.pasChunks + iSlot;
+                int nDstXCount = psChunk->nDstXOff2 - psChunk->nDstXOff;
+                int nDstYCount = psChunk->nDstYOff2 - psChunk->nDstYOff;
+
                 for(iBand=0;iBand<nBands && eErr == CE_None;iBand++)
                 {
-                    eErr = GDALDownsampleChunk32R(nSrcWidth, nSrcHeight,
-                                                  papafChunk[iBand],
-                                                  pabyChunkNoDataMask,
-                                                  nChunkXOff, nXCount,
-                                                  nChunkYOff, nYCount,
-                                                  papapoOverviewBands[iBand][iOverview],
-                                                  pszResampling,
-                                                  pabHasNoData[iBand],
-                                                  pafNoDataValue[iBand],
-                                                  /*poColorTable*/ NULL,
-                                                  eDataType);
+                    eErr = sList.paeErr[iSlot * nBands + iBand];
+                    if( eErr == CE_None && nDstXCount > 0 && nDstYCount > 0 )
+                        eErr = papapoOverviewBands[iBand][iOverview]->RasterIO( 
+                            GF_Write, psChunk->nDstXOff, psChunk->nDstYOff,
+                            nDstXCount, nDstYCount,
+                            sList.papafDst[iSlot * nBands + iBand],
+                            nDstXCount, nDstYCount, GDT_Float32, 0, 0 );
                 }
+
+                dfCurPixelCount += (double)psChunk->nXCount * psChunk->nYCount;
             }
 
-            dfCurPixelCount += (double)nYCount * nSrcWidth;
+            for( iSlot = 0; iSlot < nBatch * nBands; iSlot++ )
+            {
+                CPLFree( sList.papafDst[iSlot] );
+                sList.papafDst[iSlot] = NULL;
+            }
         }
 
         /* Flush the data to overviews */
-        for(iBand=0;iBand<nBands;iBand++)
+        for( iSlot = 0; iSlot < nChunkSlots; iSlot++ )
         {
-            CPLFree(papafChunk[iBand]);
-            papapoOverviewBands[iBand][iOverview]->FlushCache();
+            GDALOvrMultiBandChunk *psChunk = sList.pasChunks + iSlot;
+
+            for(iBand=0;iBand<nBands && psChunk->papafChunk != NULL;iBand++)
+                CPLFree(psChunk->papafChunk[iBand]);
+            CPLFree(psChunk->papafChunk);
+            CPLFree(psChunk->pabyChunkNoDataMask);
+            psChunk->papafChunk = NULL;
+            psChunk->pabyChunkNoDataMask = NULL;
         }
-        CPLFree(papafChunk);
-        CPLFree(pabyChunkNoDataMask);
-
+        for(iBand=0;iBand<nBands;iBand++)
+            papapoOverviewBands[iBand][iOverview]->FlushCache();
     }
 
+    CPLFree(sList.pasChunks);
+    CPLFree(sList.papafDst);
+    CPLFree(sList.paeErr);
     CPLFree(pabHasNoData);
     CPLFree(pafNoDataValue);
 
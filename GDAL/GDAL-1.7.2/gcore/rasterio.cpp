@@ -29,6 +29,9 @@
  ****************************************************************************/
 
 #include "gdal_priv.h"
+#include "cpl_multiproc.h"
+#include "cpl_atomic_ops.h"
+#include "cpl_worker_thread_pool.h"
 
 
 #if !(defined(_MSC_VER) && _MSC_VER <= 1200)
@@ -1146,6 +1149,11 @@ void GDALReplicateWord(void *pSrcData, GDALDataType eSrcType,
  * on word boundaries.  It is assumed that all values are in native machine
  * byte order. 
  *
+ * On x86 the most common conversions between real data types are done
+ * with SSE2 or AVX2 code, with the same results.  The GDAL_COPYWORDS_SIMD
+ * configuration option may be set to NO or SSE2 to restrict this; it is
+ * read on the first call only.
+ *
  * @param pSrcData Pointer to source data to be converted.
  * @param eSrcType the source data type (see GDALDataType enum)
  * @param nSrcPixelOffset Source pixel offset, in bytes
@@ -1194,6 +1202,23 @@ GDALCopyWords( void * pSrcData, GDALDataType eSrcType, int nSrcPixelOffset,
         return;
     }
 
+    // Let the vector kernels convert what they can, the remaining words
+    // go through the generic templates below.
+    if (nWordCount >= 16)
+    {
+        int nDone = GDALCopyWordsSIMD(pSrcData, eSrcType, nSrcPixelOffset,
+                                      pDstData, eDstType, nDstPixelOffset,
+                                      nWordCount);
+        if (nDone == nWordCount)
+            return;
+
+        pSrcData = static_cast<GByte *>(pSrcData)
+            + static_cast<std::ptrdiff_t>(nDone) * nSrcPixelOffset;
+        pDstData = static_cast<GByte *>(pDstData)
+            + static_cast<std::ptrdiff_t>(nDone) * nDstPixelOffset;
+        nWordCount -= nDone;
+    }
+
     // Handle the more general case -- deals with conversion of data types
     // directly.
     switch (eSrcType)
@@ -2587,6 +2612,200 @@ GDALDataset::BlockBasedRasterIO( GDALRWFlag eRWFlag,
     return( CE_None );
 }
 
+/************************************************************************/
+/* ==================================================================== */
+/*                        Swath copy pipeline                           */
+/*                                                                      */
+/*      GDALDatasetCopyWholeRaster() lists the swaths to copy, then a   */
+/*      reader thread reads them from the source into a ring of swath   */
+/*      buffers while the calling thread writes the previous ones to    */
+/*      the destination, so that decoding and encoding overlap.  The    */
+/*      reader never flushes dirty blocks, which would write them to    */
+/*      the destination behind the back of the calling thread, and      */
+/*      the errors it raises are reported later on the calling thread.  */
+/* ==================================================================== */
+/************************************************************************/
+
+#define GDAL_COPY_SWATH_BUFFERS 3
+
+typedef struct
+{
+    CPLErr      eErrClass;
+    int         nErrNo;
+    char       *pszMsg;
+} GDALCopyError;
+
+typedef struct
+{
+    int         nBand;          /* 0 for all the bands, interleaved */
+    int         nXOff;
+    int         nYOff;
+    int         nXSize;
+    int         nYSize;
+    double      dfProgress;     /* once written */
+} GDALCopySwath;
+
+typedef struct
+{
+    GDALDataset    *poSrcDS;
+    GDALDataType    eDT;
+    int             nBandCount;
+
+    GDALCopySwath  *pasSwaths;
+    int             nSwathCount;
+
+    void           *apSwathBufs[GDAL_COPY_SWATH_BUFFERS];
+    int             nBufferCount;
+    volatile int    abFailed[GDAL_COPY_SWATH_BUFFERS];
+
+    /* errors raised while reading the swath of each buffer */
+    GDALCopyError  *apasErrors[GDAL_COPY_SWATH_BUFFERS];
+    int             anErrorCount[GDAL_COPY_SWATH_BUFFERS];
+    int             iReadBuf;
+
+    volatile int    nSwathsRead;
+    volatile int    nSwathsWritten;
+    volatile int    bStop;
+    volatile int    bReaderDone;
+} GDALCopyPipeline;
+
+/************************************************************************/
+/*                           GDALCopySwathIO()                          */
+/************************************************************************/
+
+static CPLErr GDALCopySwathIO( GDALDataset *poDS, GDALRWFlag eRWFlag,
+                               const GDALCopySwath *psSwath, void *pBuf,
+                               GDALDataType eDT, int nBandCount )
+
+{
+    int nBand = psSwath->nBand;
+
+    return poDS->RasterIO( eRWFlag,
+                           psSwath->nXOff, psSwath->nYOff,
+                           psSwath->nXSize, psSwath->nYSize,
+                           pBuf, psSwath->nXSize, psSwath->nYSize,
+                           eDT, nBand ? 1 : nBandCount,
+                           nBand ? &nBand : NULL, 0, 0, 0 );
+}
+
+/************************************************************************/
+/*                       GDALCopyClearErrors()                          */
+/************************************************************************/
+
+static void GDALCopyClearErrors( GDALCopyPipeline *psPipe, int iBuf )
+
+{
+    for( int i = 0; i < psPipe->anErrorCount[iBuf]; i++ )
+        CPLFree( psPipe->apasErrors[iBuf][i].pszMsg );
+    CPLFree( psPipe->apasErrors[iBuf] );
+
+    psPipe->apasErrors[iBuf] = NULL;
+    psPipe->anErrorCount[iBuf] = 0;
+}
+
+/************************************************************************/
+/*                     GDALCopyReaderErrorHandler()                     */
+/*                                                                      */
+/*      Keep the errors raised on the reader thread with the swath      */
+/*      being read, so that the calling thread can report them when     */
+/*      it writes that swath.  Debug messages go out right away.        */
+/************************************************************************/
+
+static void CPL_STDCALL GDALCopyReaderErrorHandler( CPLErr eErrClass,
+                                                    int nErrNo,
+                                                    const char *pszMsg )
+
+{
+    GDALCopyPipeline *psPipe = (GDALCopyPipeline *)
+        CPLGetTLS( CTLS_COPYREADER );
+
+    if( eErrClass == CE_Debug || psPipe == NULL )
+    {
+        CPLQuietErrorHandler( eErrClass, nErrNo, pszMsg );
+        return;
+    }
+
+    int iBuf = psPipe->iReadBuf;
+    int nCount = psPipe->anErrorCount[iBuf];
+    GDALCopyError *pasErrors = (GDALCopyError *)
+        VSIRealloc( psPipe->apasErrors[iBuf],
+                    (nCount + 1) * sizeof(GDALCopyError) );
+
+    if( pasErrors == NULL )
+        return;
+
+    pasErrors[nCount].eErrClass = eErrClass;
+    pasErrors[nCount].nErrNo = nErrNo;
+    pasErrors[nCount].pszMsg = CPLStrdup( pszMsg );
+
+    psPipe->apasErrors[iBuf] = pasErrors;
+    psPipe->anErrorCount[iBuf] = nCount + 1;
+}
+
+/************************************************************************/
+/*                        GDALCopyReaderThread()                        */
+/*                                                                      */
+/*      Read the swaths in order, as buffers get free.  The reader      */
+/*      stops at the first failed swath, and the calling thread         */
+/*      reads it again, reporting the error, as it would have without   */
+/*      a pipeline.                                                     */
+/************************************************************************/
+
+static void GDALCopyReaderThread( void *pData )
+
+{
+    GDALCopyPipeline *psPipe = (GDALCopyPipeline *) pData;
+
+    CPLSetTLS( CTLS_COPYREADER, psPipe, FALSE );
+    CPLPushErrorHandler( GDALCopyReaderErrorHandler );
+    GDALRasterBlock::EnterDisableDirtyBlockFlush();
+
+    for( int iSwath = 0; iSwath < psPipe->nSwathCount; iSwath++ )
+    {
+        while( iSwath - psPipe->nSwathsWritten >= psPipe->nBufferCount
+               && !psPipe->bStop )
+            CPLSleep( 0.001 );
+
+        if( psPipe->bStop )
+            break;
+
+        int iBuf = iSwath % psPipe->nBufferCount;
+
+        psPipe->iReadBuf = iBuf;
+        CPLErr eErr = GDALCopySwathIO( psPipe->poSrcDS, GF_Read,
+                                       psPipe->pasSwaths + iSwath,
+                                       psPipe->apSwathBufs[iBuf],
+                                       psPipe->eDT, psPipe->nBandCount );
+
+        psPipe->abFailed[iBuf] = (eErr != CE_None);
+        CPLAtomicInc( &(psPipe->nSwathsRead) );
+
+        if( eErr != CE_None )
+            break;
+    }
+
+    GDALRasterBlock::LeaveDisableDirtyBlockFlush();
+    CPLPopErrorHandler();
+    CPLSetTLS( CTLS_COPYREADER, NULL, FALSE );
+
+    CPLAtomicInc( &(psPipe->bReaderDone) );
+}
+
+/************************************************************************/
+/*                         GDALCopyWaitReader()                         */
+/*                                                                      */
+/*      Called by the calling thread while it waits for the reader.     */
+/*      The reader does not flush dirty blocks, so we flush blocks      */
+/*      for it while the cache is over its limit.                       */
+/************************************************************************/
+
+static void GDALCopyWaitReader()
+
+{
+    if( GDALGetCacheUsed() <= GDALGetCacheMax() || !GDALFlushCacheBlock() )
+        CPLSleep( 0.001 );
+}
+
 /************************************************************************/
 /*                     GDALDatasetCopyWholeRaster()                     */
 /************************************************************************/
@@ -2608,6 +2827,16 @@ GDALDataset::BlockBasedRasterIO( GDALRWFlag eRWFlag,
  * to force pixel interleaved operation.  More options may be supported in
  * the future.  
  *
+ * If the GDAL_COPY_PIPELINE configuration option is set to YES, the
+ * source is read on a separate thread, a few swaths ahead of the
+ * destination writes, so that decoding the source and encoding the
+ * destination overlap.  The source and destination drivers must then allow
+ * different datasets to be used from different threads, which is not the
+ * case of the drivers built on libraries that are not thread safe (such as
+ * netCDF or HDF4) when they are used on both sides, so this is off by
+ * default.  Progress is still reported, and can interrupt the copy, from
+ * the calling thread.
+ *
  * @param hSrcDS the source dataset
  * @param hDstDS the destination dataset
  * @param papszOptions transfer hints in "StringList" Name=Value format.
@@ -2795,109 +3024,186 @@ CPLErr CPL_STDCALL GDALDatasetCopyWholeRaster(
             "GDALDatasetCopyWholeRaster(): %d*%d swaths, bInterleave=%d", 
             nSwathCols, nSwathLines, bInterleave );
 
-/* ==================================================================== */
-/*      Band oriented (uninterleaved) case.                             */
-/* ==================================================================== */
-    if( !bInterleave )
+/* -------------------------------------------------------------------- */
+/*      List the swaths: band by band in the band oriented              */
+/*      (uninterleaved) case, all bands at once in the pixel            */
+/*      interleaved case.                                               */
+/* -------------------------------------------------------------------- */
+    int nSwathsPerBand = ((nYSize + nSwathLines - 1) / nSwathLines)
+        * ((nXSize + nSwathCols - 1) / nSwathCols);
+    int nSwathCount = bInterleave ? nSwathsPerBand
+                                  : nSwathsPerBand * nBandCount;
+    GDALCopySwath *pasSwaths = (GDALCopySwath *)
+        VSIMalloc2( nSwathCount, sizeof(GDALCopySwath) );
+
+    if( pasSwaths == NULL )
     {
-        int iBand, iX, iY;
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "Failed to allocate the swath list in\n"
+                  "GDALDatasetCopyWholeRaster()" );
+        CPLFree( pSwathBuf );
+        return CE_Failure;
+    }
 
-        for( iBand = 0; iBand < nBandCount && eErr == CE_None; iBand++ )
+    int iBand, iX, iY, iSwath = 0;
+
+    for( iBand = 0; iBand < (bInterleave ? 1 : nBandCount); iBand++ )
+    {
+        for( iY = 0; iY < nYSize; iY += nSwathLines )
         {
-            int nBand = iBand+1;
+            int nThisLines = nSwathLines;
 
-            for( iY = 0; iY < nYSize && eErr == CE_None; iY += nSwathLines )
+            if( iY + nThisLines > nYSize )
+                nThisLines = nYSize - iY;
+
+            for( iX = 0; iX < nXSize; iX += nSwathCols )
             {
-                int nThisLines = nSwathLines;
+                GDALCopySwath *psSwath = pasSwaths + iSwath++;
+                int nThisCols = nSwathCols;
 
-                if( iY + nThisLines > nYSize )
-                    nThisLines = nYSize - iY;
+                if( iX + nThisCols > nXSize )
+                    nThisCols = nXSize - iX;
 
-                for( iX = 0; iX < nXSize && eErr == CE_None; iX += nSwathCols )
-                {
-                    int nThisCols = nSwathCols;
-
-                    if( iX + nThisCols > nXSize )
-                        nThisCols = nXSize - iX;
-
-                    eErr = poSrcDS->RasterIO( GF_Read, 
-                                            iX, iY, nThisCols, nThisLines,
-                                            pSwathBuf, nThisCols, nThisLines, 
-                                            eDT, 1, &nBand, 
-                                            0, 0, 0 );
-
-                    if( eErr == CE_None )
-                        eErr = poDstDS->RasterIO( GF_Write, 
-                                                iX, iY, nThisCols, nThisLines,
-                                                pSwathBuf, nThisCols, nThisLines, 
-                                                eDT, 1, &nBand,
-                                                0, 0, 0 );
-
-                    if( eErr == CE_None 
-                        && !pfnProgress( 
-                            iBand / (float)nBandCount
-                            + (iY+nThisLines) / (float) (nYSize*nBandCount),
-                            NULL, pProgressData ) )
-                    {
-                        eErr = CE_Failure;
-                        CPLError( CE_Failure, CPLE_UserInterrupt, 
-                                "User terminated CreateCopy()" );
-                    }
-                }
+                psSwath->nBand = bInterleave ? 0 : iBand + 1;
+                psSwath->nXOff = iX;
+                psSwath->nYOff = iY;
+                psSwath->nXSize = nThisCols;
+                psSwath->nYSize = nThisLines;
+
+                if( bInterleave )
+                    psSwath->dfProgress = (iY+nThisLines) / (float) nYSize;
+                else
+                    psSwath->dfProgress = iBand / (float)nBandCount
+                        + (iY+nThisLines) / (float) (nYSize*nBandCount);
             }
         }
     }
 
-/* ==================================================================== */
-/*      Pixel interleaved case.                                         */
-/* ==================================================================== */
-    else /* if( bInterleave ) */
+/* -------------------------------------------------------------------- */
+/*      Start the reader thread if it was asked for, and we have        */
+/*      several swaths and the memory for more swath buffers.  It is    */
+/*      not tied to GDAL_NUM_THREADS, as the drivers of both datasets   */
+/*      must be usable from two threads at once.                        */
+/* -------------------------------------------------------------------- */
+    GDALCopyPipeline sPipe;
+    int bPipeline = FALSE;
+    int bWantPipeline =
+        CSLTestBoolean( CPLGetConfigOption( "GDAL_COPY_PIPELINE", "NO" ) );
+
+    memset( &sPipe, 0, sizeof(sPipe) );
+    sPipe.poSrcDS = poSrcDS;
+    sPipe.eDT = eDT;
+    sPipe.nBandCount = nBandCount;
+    sPipe.pasSwaths = pasSwaths;
+    sPipe.nSwathCount = nSwathCount;
+    sPipe.apSwathBufs[0] = pSwathBuf;
+    sPipe.nBufferCount = 1;
+
+    if( bWantPipeline && nSwathCount > 1 )
     {
-        int iY, iX;
-
-        for( iY = 0; iY < nYSize && eErr == CE_None; iY += nSwathLines )
+        while( sPipe.nBufferCount < GDAL_COPY_SWATH_BUFFERS
+               && sPipe.nBufferCount < nSwathCount )
         {
-            int nThisLines = nSwathLines;
+            void *pBuf = VSIMalloc3( nSwathCols, nSwathLines, nPixelSize );
 
-            if( iY + nThisLines > nYSize )
-                nThisLines = nYSize - iY;
+            if( pBuf == NULL )
+                break;
+            sPipe.apSwathBufs[sPipe.nBufferCount++] = pBuf;
+        }
 
-            for( iX = 0; iX < nXSize && eErr == CE_None; iX += nSwathCols )
-            {
-                int nThisCols = nSwathCols;
+        /* Dirty source blocks would be written by this thread while */
+        /* the reader reads the source, so write them out first. */
+        if( sPipe.nBufferCount > 1 )
+            poSrcDS->FlushCache();
 
-                if( iX + nThisCols > nXSize )
-                    nThisCols = nXSize - iX;
+        if( sPipe.nBufferCount > 1
+            && CPLCreateThread( GDALCopyReaderThread, &sPipe ) != -1 )
+            bPipeline = TRUE;
+
+        CPLDebug( "GDAL", 
+                  "GDALDatasetCopyWholeRaster(): %s reader thread, "
+                  "%d swath buffers",
+                  bPipeline ? "using a" : "no", sPipe.nBufferCount );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Copy the swaths.  Once the reader thread has stopped, either    */
+/*      on a failure or because there are no more swaths, whatever is   */
+/*      left is read on this thread.                                    */
+/* -------------------------------------------------------------------- */
+    int bReaderRunning = bPipeline;
+
+    for( iSwath = 0; iSwath < nSwathCount && eErr == CE_None; iSwath++ )
+    {
+        GDALCopySwath *psSwath = pasSwaths + iSwath;
+        int iBuf = iSwath % sPipe.nBufferCount;
+        void *pBuf = sPipe.apSwathBufs[iBuf];
+        int bRead = FALSE;
+
+        if( bReaderRunning )
+        {
+            while( sPipe.nSwathsRead <= iSwath && !sPipe.bReaderDone )
+                GDALCopyWaitReader();
 
-                eErr = poSrcDS->RasterIO( GF_Read, 
-                                        iX, iY, nThisCols, nThisLines,
-                                        pSwathBuf, nThisCols, nThisLines, 
-                                        eDT, nBandCount, NULL, 
-                                        0, 0, 0 );
-
-                if( eErr == CE_None )
-                    eErr = poDstDS->RasterIO( GF_Write, 
-                                            iX, iY, nThisCols, nThisLines,
-                                            pSwathBuf, nThisCols, nThisLines, 
-                                            eDT, nBandCount, NULL, 
-                                            0, 0, 0 );
-
-                if( eErr == CE_None 
-                    && !pfnProgress( (iY+nThisLines) / (float) nYSize,
-                                    NULL, pProgressData ) )
+            if( sPipe.nSwathsRead > iSwath && !sPipe.abFailed[iBuf] )
+            {
+                bRead = TRUE;
+                for( int i = 0; i < sPipe.anErrorCount[iBuf]; i++ )
                 {
-                    eErr = CE_Failure;
-                    CPLError( CE_Failure, CPLE_UserInterrupt, 
-                            "User terminated CreateCopy()" );
+                    GDALCopyError *psError = sPipe.apasErrors[iBuf] + i;
+                    CPLError( psError->eErrClass, psError->nErrNo, "%s",
+                              psError->pszMsg );
                 }
             }
+            else
+            {
+                while( !sPipe.bReaderDone )
+                    GDALCopyWaitReader();
+                bReaderRunning = FALSE;
+            }
+
+            /* Errors of a failed read are raised again below. */
+            GDALCopyClearErrors( &sPipe, iBuf );
+        }
+
+        if( !bRead )
+            eErr = GDALCopySwathIO( poSrcDS, GF_Read, psSwath, pBuf,
+                                    eDT, nBandCount );
+
+        if( eErr == CE_None )
+            eErr = GDALCopySwathIO( poDstDS, GF_Write, psSwath, pBuf,
+                                    eDT, nBandCount );
+
+        CPLAtomicInc( &(sPipe.nSwathsWritten) );
+
+        if( eErr == CE_None 
+            && !pfnProgress( psSwath->dfProgress, NULL, pProgressData ) )
+        {
+            eErr = CE_Failure;
+            CPLError( CE_Failure, CPLE_UserInterrupt, 
+                    "User terminated CreateCopy()" );
         }
     }
 
+/* -------------------------------------------------------------------- */
+/*      Stop the reader thread, if we are finishing early.              */
+/* -------------------------------------------------------------------- */
+    if( bPipeline )
+    {
+        sPipe.bStop = TRUE;
+        while( !sPipe.bReaderDone )
+            GDALCopyWaitReader();
+    }
+
 /* -------------------------------------------------------------------- */
 /*      Cleanup                                                         */
 /* -------------------------------------------------------------------- */
-    CPLFree( pSwathBuf );
+    for( int iBuf = 0; iBuf < sPipe.nBufferCount; iBuf++ )
+    {
+        GDALCopyClearErrors( &sPipe, iBuf );
+        CPLFree( sPipe.apSwathBufs[iBuf] );
+    }
+    CPLFree( pasSwaths );
 
     return eErr;
 }
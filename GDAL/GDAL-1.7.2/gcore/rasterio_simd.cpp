@@ -0,0 +1,983 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Core
+ * Purpose:  SSE2 and AVX2 implementations of the most common data type
+ *           conversions of GDALCopyWords().
+ *
+ ******************************************************************************
+ * Copyright (c) 2010, GDAL contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/*
+ * The kernels of this file convert packed arrays of words between the
+ * real data types, by blocks of 8 or 16 words.  GDALCopyWords() calls
+ * them through GDALCopyWordsSIMD() and converts whatever words are left
+ * over with its generic templates.
+ *
+ * The results are bit identical to the generic code: the floating point
+ * to integer conversions add 0.5 (or subtract it for negative values
+ * going to a signed type), clamp, and truncate in the same precision and
+ * order as CopyWord(), and a NaN gives the same value as the scalar
+ * truncating conversion, that is the low bits of 0x80000000.  Integer
+ * narrowing uses saturating packs, which are the same clamps.
+ *
+ * SSE2 is part of the x86-64 baseline so it is enabled at compile time.
+ * The AVX2 code is compiled with a function level target attribute (GCC
+ * 4.9 or later), and only selected if the CPU supports it at runtime.
+ */
+
+#include "gdal_priv.h"
+#include "cpl_conv.h"
+#include "cpl_string.h"
+
+CPL_CVSID("$Id$");
+
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define HAVE_GCW_SSE2
+#  include <emmintrin.h>
+#endif
+
+#if defined(HAVE_GCW_SSE2) && defined(__GNUC__) && !defined(__clang__) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#  define HAVE_GCW_AVX2
+#  include <immintrin.h>
+#  define GCW_AVX2 __attribute__((target("avx2")))
+#endif
+
+#ifndef HAVE_GCW_SSE2
+
+/************************************************************************/
+/*                         GDALCopyWordsSIMD()                          */
+/************************************************************************/
+
+int GDALCopyWordsSIMD( const void *pSrcData, GDALDataType eSrcType,
+                       int nSrcPixelOffset,
+                       void *pDstData, GDALDataType eDstType,
+                       int nDstPixelOffset, int nWordCount )
+
+{
+    return 0;
+}
+
+#else /* def HAVE_GCW_SSE2 */
+
+/* Converts the first words of a packed array, returns how many. */
+typedef int (*GCWKernel)( const void *pSrc, void *pDst, int nWordCount );
+
+/* Number of words converted by the stack buffers of strided copies. */
+#define GCW_CHUNK_SIZE   256
+
+/************************************************************************/
+/* ==================================================================== */
+/*                       SSE2 loaders and storers                       */
+/*                                                                      */
+/*      Most conversions go through two vectors of four Int32 values:   */
+/*      a loader reads 8 source words into them, and a storer writes    */
+/*      them as 8 destination words.  The loaders of floating point     */
+/*      words also round and clamp to the range of the destination.     */
+/* ==================================================================== */
+/************************************************************************/
+
+struct GCWLoadByte
+{
+    static inline void Load( const void *pSrc, int i,
+                             __m128i &xLo, __m128i &xHi )
+    {
+        const __m128i xZero = _mm_setzero_si128();
+        __m128i x = _mm_loadl_epi64( (const __m128i *)
+                                     ((const GByte *) pSrc + i) );
+
+        x = _mm_unpacklo_epi8( x, xZero );
+        xLo = _mm_unpacklo_epi16( x, xZero );
+        xHi = _mm_unpackhi_epi16( x, xZero );
+    }
+};
+
+struct GCWLoadUInt16
+{
+    static inline void Load( const void *pSrc, int i,
+                             __m128i &xLo, __m128i &xHi )
+    {
+        const __m128i xZero = _mm_setzero_si128();
+        __m128i x = _mm_loadu_si128( (const __m128i *)
+                                     ((const GUInt16 *) pSrc + i) );
+
+        xLo = _mm_unpacklo_epi16( x, xZero );
+        xHi = _mm_unpackhi_epi16( x, xZero );
+    }
+};
+
+struct GCWLoadInt16
+{
+    static inline void Load( const void *pSrc, int i,
+                             __m128i &xLo, __m128i &xHi )
+    {
+        __m128i x = _mm_loadu_si128( (const __m128i *)
+                                     ((const GInt16 *) pSrc + i) );
+
+        xLo = _mm_srai_epi32( _mm_unpacklo_epi16( x, x ), 16 );
+        xHi = _mm_srai_epi32( _mm_unpackhi_epi16( x, x ), 16 );
+    }
+};
+
+struct GCWLoadInt32
+{
+    static inline void Load( const void *pSrc, int i,
+                             __m128i &xLo, __m128i &xHi )
+    {
+        const GInt32 *panSrc = (const GInt32 *) pSrc + i;
+
+        xLo = _mm_loadu_si128( (const __m128i *) panSrc );
+        xHi = _mm_loadu_si128( (const __m128i *) (panSrc + 4) );
+    }
+};
+
+/************************************************************************/
+/*                         GCWRoundFloat32()                            */
+/*                                                                      */
+/*      The rounding and clamping of CopyWord( float, T & ) for an      */
+/*      integer type T of range [nMin,nMax].  The operand order of      */
+/*      the min and max lets a NaN through, as the scalar compares do.  */
+/************************************************************************/
+
+template<int nMin, int nMax>
+static inline __m128i GCWRoundFloat32( __m128 x )
+
+{
+    const __m128 xHalf = _mm_set1_ps( 0.5f );
+
+    if( nMin < 0 )
+    {
+        /* x >= 0 ? x + 0.5 : x - 0.5 */
+        const __m128 xSign = _mm_set1_ps( -0.0f );
+        x = _mm_add_ps( x, _mm_or_ps( xHalf, _mm_and_ps( x, xSign ) ) );
+    }
+    else
+        x = _mm_add_ps( x, xHalf );
+
+    x = _mm_min_ps( _mm_set1_ps( (float) nMax ), x );
+    x = _mm_max_ps( _mm_set1_ps( (float) nMin ), x );
+
+    return _mm_cvttps_epi32( x );
+}
+
+template<int nMin, int nMax>
+struct GCWLoadFloat32
+{
+    static inline void Load( const void *pSrc, int i,
+                             __m128i &xLo, __m128i &xHi )
+    {
+        const float *pafSrc = (const float *) pSrc + i;
+
+        xLo = GCWRoundFloat32<nMin,nMax>( _mm_loadu_ps( pafSrc ) );
+        xHi = GCWRoundFloat32<nMin,nMax>( _mm_loadu_ps( pafSrc + 4 ) );
+    }
+};
+
+/************************************************************************/
+/*                         GCWRoundFloat64()                            */
+/*                                                                      */
+/*      Same as GCWRoundFloat32() for doubles, two at a time, with      */
+/*      the two results in the low half of the returned vector.         */
+/************************************************************************/
+
+template<int nMin, int nMax>
+static inline __m128i GCWRoundFloat64( __m128d x )
+
+{
+    const __m128d xHalf = _mm_set1_pd( 0.5 );
+
+    if( nMin < 0 )
+    {
+        const __m128d xSign = _mm_set1_pd( -0.0 );
+        x = _mm_add_pd( x, _mm_or_pd( xHalf, _mm_and_pd( x, xSign ) ) );
+    }
+    else
+        x = _mm_add_pd( x, xHalf );
+
+    x = _mm_min_pd( _mm_set1_pd( (double) nMax ), x );
+    x = _mm_max_pd( _mm_set1_pd( (double) nMin ), x );
+
+    return _mm_cvttpd_epi32( x );
+}
+
+template<int nMin, int nMax>
+struct GCWLoadFloat64
+{
+    static inline void Load( const void *pSrc, int i,
+                             __m128i &xLo, __m128i &xHi )
+    {
+        const double *padfSrc = (const double *) pSrc + i;
+
+        xLo = _mm_unpacklo_epi64(
+            GCWRoundFloat64<nMin,nMax>( _mm_loadu_pd( padfSrc ) ),
+            GCWRoundFloat64<nMin,nMax>( _mm_loadu_pd( padfSrc + 2 ) ) );
+        xHi = _mm_unpacklo_epi64(
+            GCWRoundFloat64<nMin,nMax>( _mm_loadu_pd( padfSrc + 4 ) ),
+            GCWRoundFloat64<nMin,nMax>( _mm_loadu_pd( padfSrc + 6 ) ) );
+    }
+};
+
+/* -------------------------------------------------------------------- */
+/*      Storers.  The Byte and 16 bit ones saturate, except that the    */
+/*      16 bit "Low" storer keeps the low 16 bits of each value as the  */
+/*      scalar conversion of an out of range (NaN) value does.          */
+/* -------------------------------------------------------------------- */
+
+struct GCWStoreByte
+{
+    static inline void Store( void *pDst, int i, __m128i xLo, __m128i xHi )
+    {
+        __m128i x = _mm_packs_epi32( xLo, xHi );
+
+        _mm_storel_epi64( (__m128i *) ((GByte *) pDst + i),
+                          _mm_packus_epi16( x, x ) );
+    }
+};
+
+struct GCWStoreInt16
+{
+    static inline void Store( void *pDst, int i, __m128i xLo, __m128i xHi )
+    {
+        _mm_storeu_si128( (__m128i *) ((GInt16 *) pDst + i),
+                          _mm_packs_epi32( xLo, xHi ) );
+    }
+};
+
+struct GCWStoreLow16
+{
+    static inline void Store( void *pDst, int i, __m128i xLo, __m128i xHi )
+    {
+        xLo = _mm_srai_epi32( _mm_slli_epi32( xLo, 16 ), 16 );
+        xHi = _mm_srai_epi32( _mm_slli_epi32( xHi, 16 ), 16 );
+
+        _mm_storeu_si128( (__m128i *) ((GInt16 *) pDst + i),
+                          _mm_packs_epi32( xLo, xHi ) );
+    }
+};
+
+struct GCWStoreInt32
+{
+    static inline void Store( void *pDst, int i, __m128i xLo, __m128i xHi )
+    {
+        GInt32 *panDst = (GInt32 *) pDst + i;
+
+        _mm_storeu_si128( (__m128i *) panDst, xLo );
+        _mm_storeu_si128( (__m128i *) (panDst + 4), xHi );
+    }
+};
+
+struct GCWStoreFloat32
+{
+    static inline void Store( void *pDst, int i, __m128i xLo, __m128i xHi )
+    {
+        float *pafDst = (float *) pDst + i;
+
+        _mm_storeu_ps( pafDst, _mm_cvtepi32_ps( xLo ) );
+        _mm_storeu_ps( pafDst + 4, _mm_cvtepi32_ps( xHi ) );
+    }
+};
+
+struct GCWStoreFloat64
+{
+    static inline void Store( void *pDst, int i, __m128i xLo, __m128i xHi )
+    {
+        double *padfDst = (double *) pDst + i;
+
+        _mm_storeu_pd( padfDst, _mm_cvtepi32_pd( xLo ) );
+        _mm_storeu_pd( padfDst + 2,
+                       _mm_cvtepi32_pd( _mm_shuffle_epi32( xLo, 0xEE ) ) );
+        _mm_storeu_pd( padfDst + 4, _mm_cvtepi32_pd( xHi ) );
+        _mm_storeu_pd( padfDst + 6,
+                       _mm_cvtepi32_pd( _mm_shuffle_epi32( xHi, 0xEE ) ) );
+    }
+};
+
+/************************************************************************/
+/*                        GCWConvert_SSE2()                             */
+/************************************************************************/
+
+template<class Loader, class Storer>
+static int GCWConvert_SSE2( const void *pSrc, void *pDst, int nWordCount )
+
+{
+    int i;
+
+    for( i = 0; i + 8 <= nWordCount; i += 8 )
+    {
+        __m128i xLo, xHi;
+
+        Loader::Load( pSrc, i, xLo, xHi );
+        Storer::Store( pDst, i, xLo, xHi );
+    }
+
+    return i;
+}
+
+/************************************************************************/
+/*                    16 bit conversion kernels.                        */
+/*                                                                      */
+/*      Conversions that stay within 16 bit lanes, 16 words at a time.  */
+/************************************************************************/
+
+static int GCWByteTo16_SSE2( const void *pSrc, void *pDst, int nWordCount )
+
+{
+    const GByte *pabySrc = (const GByte *) pSrc;
+    GUInt16 *panDst = (GUInt16 *) pDst;
+    const __m128i xZero = _mm_setzero_si128();
+    int i;
+
+    for( i = 0; i + 16 <= nWordCount; i += 16 )
+    {
+        __m128i x = _mm_loadu_si128( (const __m128i *) (pabySrc + i) );
+
+        _mm_storeu_si128( (__m128i *) (panDst + i),
+                          _mm_unpacklo_epi8( x, xZero ) );
+        _mm_storeu_si128( (__m128i *) (panDst + i + 8),
+                          _mm_unpackhi_epi8( x, xZero ) );
+    }
+
+    return i;
+}
+
+static int GCWUInt16ToByte_SSE2( const void *pSrc, void *pDst, int nWordCount )
+
+{
+    const GUInt16 *panSrc = (const GUInt16 *) pSrc;
+    GByte *pabyDst = (GByte *) pDst;
+    const __m128i x255 = _mm_set1_epi16( 255 );
+    int i;
+
+    for( i = 0; i + 16 <= nWordCount; i += 16 )
+    {
+        __m128i xLo = _mm_loadu_si128( (const __m128i *) (panSrc + i) );
+        __m128i xHi = _mm_loadu_si128( (const __m128i *) (panSrc + i + 8) );
+
+        /* min(x, 255), as SSE2 has no unsigned 16 bit min */
+        xLo = _mm_sub_epi16( xLo, _mm_subs_epu16( xLo, x255 ) );
+        xHi = _mm_sub_epi16( xHi, _mm_subs_epu16( xHi, x255 ) );
+
+        _mm_storeu_si128( (__m128i *) (pabyDst + i),
+                          _mm_packus_epi16( xLo, xHi ) );
+    }
+
+    return i;
+}
+
+static int GCWInt16ToByte_SSE2( const void *pSrc, void *pDst, int nWordCount )
+
+{
+    const GInt16 *panSrc = (const GInt16 *) pSrc;
+    GByte *pabyDst = (GByte *) pDst;
+    int i;
+
+    for( i = 0; i + 16 <= nWordCount; i += 16 )
+    {
+        __m128i xLo = _mm_loadu_si128( (const __m128i *) (panSrc + i) );
+        __m128i xHi = _mm_loadu_si128( (const __m128i *) (panSrc + i + 8) );
+
+        _mm_storeu_si128( (__m128i *) (pabyDst + i),
+                          _mm_packus_epi16( xLo, xHi ) );
+    }
+
+    return i;
+}
+
+static int GCWInt16ToUInt16_SSE2( const void *pSrc, void *pDst,
+                                  int nWordCount )
+
+{
+    const GInt16 *panSrc = (const GInt16 *) pSrc;
+    GUInt16 *panDst = (GUInt16 *) pDst;
+    const __m128i xZero = _mm_setzero_si128();
+    int i;
+
+    for( i = 0; i + 16 <= nWordCount; i += 16 )
+    {
+        __m128i xLo = _mm_loadu_si128( (const __m128i *) (panSrc + i) );
+        __m128i xHi = _mm_loadu_si128( (const __m128i *) (panSrc + i + 8) );
+
+        _mm_storeu_si128( (__m128i *) (panDst + i),
+                          _mm_max_epi16( xLo, xZero ) );
+        _mm_storeu_si128( (__m128i *) (panDst + i + 8),
+                          _mm_max_epi16( xHi, xZero ) );
+    }
+
+    return i;
+}
+
+static int GCWUInt16ToInt16_SSE2( const void *pSrc, void *pDst,
+                                  int nWordCount )
+
+{
+    const GUInt16 *panSrc = (const GUInt16 *) pSrc;
+    GInt16 *panDst = (GInt16 *) pDst;
+    const __m128i x32767 = _mm_set1_epi16( 32767 );
+    int i;
+
+    for( i = 0; i + 16 <= nWordCount; i += 16 )
+    {
+        __m128i xLo = _mm_loadu_si128( (const __m128i *) (panSrc + i) );
+        __m128i xHi = _mm_loadu_si128( (const __m128i *) (panSrc + i + 8) );
+
+        /* values of 32768 and more have their sign bit set: OR the mask
+           of those in, then clear the sign bit, to get 32767 */
+        xLo = _mm_and_si128( _mm_or_si128( xLo, _mm_srai_epi16( xLo, 15 ) ),
+                             x32767 );
+        xHi = _mm_and_si128( _mm_or_si128( xHi, _mm_srai_epi16( xHi, 15 ) ),
+                             x32767 );
+
+        _mm_storeu_si128( (__m128i *) (panDst + i), xLo );
+        _mm_storeu_si128( (__m128i *) (panDst + i + 8), xHi );
+    }
+
+    return i;
+}
+
+/************************************************************************/
+/*                  Floating point conversion kernels.                  */
+/************************************************************************/
+
+static int GCWFloat32ToFloat64_SSE2( const void *pSrc, void *pDst,
+                                     int nWordCount )
+
+{
+    const float *pafSrc = (const float *) pSrc;
+    double *padfDst = (double *) pDst;
+    int i;
+
+    for( i = 0; i + 8 <= nWordCount; i += 8 )
+    {
+        __m128 xLo = _mm_loadu_ps( pafSrc + i );
+        __m128 xHi = _mm_loadu_ps( pafSrc + i + 4 );
+
+        _mm_storeu_pd( padfDst + i, _mm_cvtps_pd( xLo ) );
+        _mm_storeu_pd( padfDst + i + 2,
+                       _mm_cvtps_pd( _mm_movehl_ps( xLo, xLo ) ) );
+        _mm_storeu_pd( padfDst + i + 4, _mm_cvtps_pd( xHi ) );
+        _mm_storeu_pd( padfDst + i + 6,
+                       _mm_cvtps_pd( _mm_movehl_ps( xHi, xHi ) ) );
+    }
+
+    return i;
+}
+
+static int GCWFloat64ToFloat32_SSE2( const void *pSrc, void *pDst,
+                                     int nWordCount )
+
+{
+    const double *padfSrc = (const double *) pSrc;
+    float *pafDst = (float *) pDst;
+    int i;
+
+    for( i = 0; i + 8 <= nWordCount; i += 8 )
+    {
+        __m128 x0 = _mm_cvtpd_ps( _mm_loadu_pd( padfSrc + i ) );
+        __m128 x1 = _mm_cvtpd_ps( _mm_loadu_pd( padfSrc + i + 2 ) );
+        __m128 x2 = _mm_cvtpd_ps( _mm_loadu_pd( padfSrc + i + 4 ) );
+        __m128 x3 = _mm_cvtpd_ps( _mm_loadu_pd( padfSrc + i + 6 ) );
+
+        _mm_storeu_ps( pafDst + i, _mm_movelh_ps( x0, x1 ) );
+        _mm_storeu_ps( pafDst + i + 4, _mm_movelh_ps( x2, x3 ) );
+    }
+
+    return i;
+}
+
+#ifdef HAVE_GCW_AVX2
+
+/************************************************************************/
+/* ==================================================================== */
+/*                          AVX2 kernels                                */
+/*                                                                      */
+/*      Float32 to the integer types of imagery, 16 words at a time.    */
+/*      The integer to Float32 conversions are store bound, and were    */
+/*      slower with 256 bit stores than with the SSE2 kernels on        */
+/*      buffers aligned on 16 bytes, so they have no AVX2 version.      */
+/*      The kernels clear the upper halves of the ymm registers before  */
+/*      returning, or the SSE code that follows (libm for instance)     */
+/*      pays a state transition on every instruction on some CPUs.      */
+/* ==================================================================== */
+/************************************************************************/
+
+/************************************************************************/
+/*                       GCWRoundFloat32_AVX2()                         */
+/*                                                                      */
+/*      Rounds 16 floats to the integer range [nMin,nMax] as            */
+/*      GCWRoundFloat32() does, and packs them as 16 bit words in       */
+/*      order.  If bLow16 is set the low 16 bits of each Int32 are      */
+/*      kept, otherwise they are saturated.                             */
+/************************************************************************/
+
+GCW_AVX2
+static inline __m256i GCWRoundFloat32_AVX2( const float *pafSrc,
+                                            float fMin, float fMax,
+                                            int bLow16 )
+
+{
+    const __m256 xHalf = _mm256_set1_ps( 0.5f );
+    const __m256 xMin = _mm256_set1_ps( fMin );
+    const __m256 xMax = _mm256_set1_ps( fMax );
+    __m256 x0 = _mm256_loadu_ps( pafSrc );
+    __m256 x1 = _mm256_loadu_ps( pafSrc + 8 );
+
+    if( fMin < 0 )
+    {
+        const __m256 xSign = _mm256_set1_ps( -0.0f );
+        x0 = _mm256_add_ps( x0, _mm256_or_ps( xHalf,
+                                              _mm256_and_ps( x0, xSign ) ) );
+        x1 = _mm256_add_ps( x1, _mm256_or_ps( xHalf,
+                                              _mm256_and_ps( x1, xSign ) ) );
+    }
+    else
+    {
+        x0 = _mm256_add_ps( x0, xHalf );
+        x1 = _mm256_add_ps( x1, xHalf );
+    }
+
+    x0 = _mm256_max_ps( xMin, _mm256_min_ps( xMax, x0 ) );
+    x1 = _mm256_max_ps( xMin, _mm256_min_ps( xMax, x1 ) );
+
+    __m256i xi0 = _mm256_cvttps_epi32( x0 );
+    __m256i xi1 = _mm256_cvttps_epi32( x1 );
+
+    if( bLow16 )
+    {
+        xi0 = _mm256_srai_epi32( _mm256_slli_epi32( xi0, 16 ), 16 );
+        xi1 = _mm256_srai_epi32( _mm256_slli_epi32( xi1, 16 ), 16 );
+    }
+
+    /* packs works within 128 bit lanes, put the quarters back in order */
+    return _mm256_permute4x64_epi64( _mm256_packs_epi32( xi0, xi1 ), 0xD8 );
+}
+
+GCW_AVX2
+static int GCWFloat32ToByte_AVX2( const void *pSrc, void *pDst,
+                                  int nWordCount )
+
+{
+    const float *pafSrc = (const float *) pSrc;
+    GByte *pabyDst = (GByte *) pDst;
+    int i;
+
+    for( i = 0; i + 16 <= nWordCount; i += 16 )
+    {
+        __m256i x = GCWRoundFloat32_AVX2( pafSrc + i, 0.0f, 255.0f, FALSE );
+        __m128i xLo = _mm256_castsi256_si128( x );
+        __m128i xHi = _mm256_extracti128_si256( x, 1 );
+
+        _mm_storeu_si128( (__m128i *) (pabyDst + i),
+                          _mm_packus_epi16( xLo, xHi ) );
+    }
+
+    _mm256_zeroupper();
+
+    return i;
+}
+
+GCW_AVX2
+static int GCWFloat32ToUInt16_AVX2( const void *pSrc, void *pDst,
+                                    int nWordCount )
+
+{
+    const float *pafSrc = (const float *) pSrc;
+    GUInt16 *panDst = (GUInt16 *) pDst;
+    int i;
+
+    for( i = 0; i + 16 <= nWordCount; i += 16 )
+        _mm256_storeu_si256( (__m256i *) (panDst + i),
+                             GCWRoundFloat32_AVX2( pafSrc + i, 0.0f,
+                                                   65535.0f, TRUE ) );
+
+    _mm256_zeroupper();
+
+    return i;
+}
+
+GCW_AVX2
+static int GCWFloat32ToInt16_AVX2( const void *pSrc, void *pDst,
+                                   int nWordCount )
+
+{
+    const float *pafSrc = (const float *) pSrc;
+    GInt16 *panDst = (GInt16 *) pDst;
+    int i;
+
+    for( i = 0; i + 16 <= nWordCount; i += 16 )
+        _mm256_storeu_si256( (__m256i *) (panDst + i),
+                             GCWRoundFloat32_AVX2( pafSrc + i, -32768.0f,
+                                                   32767.0f, TRUE ) );
+
+    _mm256_zeroupper();
+
+    return i;
+}
+
+/************************************************************************/
+/*                            GCWHasAVX2()                              */
+/************************************************************************/
+
+static int GCWHasAVX2()
+
+{
+    static int bHasAVX2 = -1;
+
+    if( bHasAVX2 < 0 )
+    {
+        __builtin_cpu_init();
+        bHasAVX2 = __builtin_cpu_supports( "avx2" ) ? TRUE : FALSE;
+    }
+
+    return bHasAVX2;
+}
+
+#endif /* def HAVE_GCW_AVX2 */
+
+/************************************************************************/
+/*                          GCWGetKernel()                              */
+/*                                                                      */
+/*      Return the kernel converting packed eSrcType words to packed    */
+/*      eDstType words, or NULL if there is none.  Every kernel         */
+/*      converts all the words of a multiple of 16.                     */
+/************************************************************************/
+
+static GCWKernel GCWGetKernel( GDALDataType eSrcType, GDALDataType eDstType,
+                               int bAVX2 )
+
+{
+#ifdef HAVE_GCW_AVX2
+    if( bAVX2 && eSrcType == GDT_Float32 )
+    {
+        if( eDstType == GDT_Byte )
+            return GCWFloat32ToByte_AVX2;
+        if( eDstType == GDT_UInt16 )
+            return GCWFloat32ToUInt16_AVX2;
+        if( eDstType == GDT_Int16 )
+            return GCWFloat32ToInt16_AVX2;
+    }
+#endif
+
+    switch( eSrcType )
+    {
+      case GDT_Byte:
+        switch( eDstType )
+        {
+          case GDT_UInt16:
+          case GDT_Int16:
+            return GCWByteTo16_SSE2;
+          case GDT_UInt32:
+          case GDT_Int32:
+            return GCWConvert_SSE2<GCWLoadByte, GCWStoreInt32>;
+          case GDT_Float32:
+            return GCWConvert_SSE2<GCWLoadByte, GCWStoreFloat32>;
+          case GDT_Float64:
+            return GCWConvert_SSE2<GCWLoadByte, GCWStoreFloat64>;
+          default:
+            return NULL;
+        }
+
+      case GDT_UInt16:
+        switch( eDstType )
+        {
+          case GDT_Byte:
+            return GCWUInt16ToByte_SSE2;
+          case GDT_Int16:
+            return GCWUInt16ToInt16_SSE2;
+          case GDT_UInt32:
+          case GDT_Int32:
+            return GCWConvert_SSE2<GCWLoadUInt16, GCWStoreInt32>;
+          case GDT_Float32:
+            return GCWConvert_SSE2<GCWLoadUInt16, GCWStoreFloat32>;
+          case GDT_Float64:
+            return GCWConvert_SSE2<GCWLoadUInt16, GCWStoreFloat64>;
+          default:
+            return NULL;
+        }
+
+      case GDT_Int16:
+        switch( eDstType )
+        {
+          case GDT_Byte:
+            return GCWInt16ToByte_SSE2;
+          case GDT_UInt16:
+            return GCWInt16ToUInt16_SSE2;
+          case GDT_Int32:
+            return GCWConvert_SSE2<GCWLoadInt16, GCWStoreInt32>;
+          case GDT_Float32:
+            return GCWConvert_SSE2<GCWLoadInt16, GCWStoreFloat32>;
+          case GDT_Float64:
+            return GCWConvert_SSE2<GCWLoadInt16, GCWStoreFloat64>;
+          default:
+            return NULL;
+        }
+
+      case GDT_Int32:
+        switch( eDstType )
+        {
+          case GDT_Byte:
+            return GCWConvert_SSE2<GCWLoadInt32, GCWStoreByte>;
+          case GDT_Int16:
+            return GCWConvert_SSE2<GCWLoadInt32, GCWStoreInt16>;
+          case GDT_Float32:
+            return GCWConvert_SSE2<GCWLoadInt32, GCWStoreFloat32>;
+          case GDT_Float64:
+            return GCWConvert_SSE2<GCWLoadInt32, GCWStoreFloat64>;
+          default:
+            return NULL;
+        }
+
+      case GDT_Float32:
+        switch( eDstType )
+        {
+          case GDT_Byte:
+            return GCWConvert_SSE2<GCWLoadFloat32<0,255>, GCWStoreByte>;
+          case GDT_UInt16:
+            return GCWConvert_SSE2<GCWLoadFloat32<0,65535>, GCWStoreLow16>;
+          case GDT_Int16:
+            return GCWConvert_SSE2<GCWLoadFloat32<-32768,32767>,
+                                   GCWStoreLow16>;
+          case GDT_Float64:
+            return GCWFloat32ToFloat64_SSE2;
+          default:
+            return NULL;
+        }
+
+      case GDT_Float64:
+        switch( eDstType )
+        {
+          case GDT_Byte:
+            return GCWConvert_SSE2<GCWLoadFloat64<0,255>, GCWStoreByte>;
+          case GDT_UInt16:
+            return GCWConvert_SSE2<GCWLoadFloat64<0,65535>, GCWStoreLow16>;
+          case GDT_Int16:
+            return GCWConvert_SSE2<GCWLoadFloat64<-32768,32767>,
+                                   GCWStoreLow16>;
+          case GDT_Float32:
+            return GCWFloat64ToFloat32_SSE2;
+          default:
+            return NULL;
+        }
+
+      default:
+        return NULL;
+    }
+}
+
+/************************************************************************/
+/*                          GCWGetSIMDLevel()                           */
+/*                                                                      */
+/*      0 for no vector code, 1 for SSE2 and 2 for AVX2.  The           */
+/*      GDAL_COPYWORDS_SIMD configuration option may be set to NO,      */
+/*      SSE2 or AVX2 to restrict the choice, mostly for benchmarking.   */
+/*      It is only read once, GDALCopyWords() being called far too      */
+/*      often to look it up each time.                                  */
+/************************************************************************/
+
+static int GCWGetSIMDLevel()
+
+{
+    static int nLevel = -1;
+
+    if( nLevel < 0 )
+    {
+        const char *pszSIMD =
+            CPLGetConfigOption( "GDAL_COPYWORDS_SIMD", "YES" );
+        int nNewLevel = 1;
+
+        if( !CSLTestBoolean( pszSIMD ) )
+            nNewLevel = 0;
+#ifdef HAVE_GCW_AVX2
+        else if( !EQUAL(pszSIMD,"SSE2") && GCWHasAVX2() )
+            nNewLevel = 2;
+#endif
+
+        nLevel = nNewLevel;
+    }
+
+    return nLevel;
+}
+
+/************************************************************************/
+/*                         GCWGather() / GCWScatter()                   */
+/*                                                                      */
+/*      Copy words of nSize bytes between a strided array and a         */
+/*      packed one.                                                     */
+/************************************************************************/
+
+template<class T>
+static void GCWGatherT( const GByte *pabySrc, int nSrcPixelOffset,
+                        T *pDst, int nWordCount )
+
+{
+    for( int i = 0; i < nWordCount; i++ )
+        pDst[i] = *(const T *)
+            (pabySrc + (std::ptrdiff_t) i * nSrcPixelOffset);
+}
+
+static void GCWGather( const GByte *pabySrc, int nSrcPixelOffset, int nSize,
+                       void *pDst, int nWordCount )
+
+{
+    switch( nSize )
+    {
+      case 1:
+        GCWGatherT( pabySrc, nSrcPixelOffset, (GByte *) pDst, nWordCount );
+        break;
+      case 2:
+        GCWGatherT( pabySrc, nSrcPixelOffset, (GUInt16 *) pDst, nWordCount );
+        break;
+      case 4:
+        GCWGatherT( pabySrc, nSrcPixelOffset, (GUInt32 *) pDst, nWordCount );
+        break;
+      default:
+        GCWGatherT( pabySrc, nSrcPixelOffset, (double *) pDst, nWordCount );
+        break;
+    }
+}
+
+template<class T>
+static void GCWScatterT( const T *pSrc, GByte *pabyDst, int nDstPixelOffset,
+                         int nWordCount )
+
+{
+    for( int i = 0; i < nWordCount; i++ )
+        *(T *) (pabyDst + (std::ptrdiff_t) i * nDstPixelOffset) = pSrc[i];
+}
+
+static void GCWScatter( const void *pSrc, GByte *pabyDst, int nDstPixelOffset,
+                        int nSize, int nWordCount )
+
+{
+    switch( nSize )
+    {
+      case 1:
+        GCWScatterT( (const GByte *) pSrc, pabyDst, nDstPixelOffset,
+                     nWordCount );
+        break;
+      case 2:
+        GCWScatterT( (const GUInt16 *) pSrc, pabyDst, nDstPixelOffset,
+                     nWordCount );
+        break;
+      case 4:
+        GCWScatterT( (const GUInt32 *) pSrc, pabyDst, nDstPixelOffset,
+                     nWordCount );
+        break;
+      default:
+        GCWScatterT( (const double *) pSrc, pabyDst, nDstPixelOffset,
+                     nWordCount );
+        break;
+    }
+}
+
+/************************************************************************/
+/*                         GDALCopyWordsSIMD()                          */
+/*                                                                      */
+/*      Convert the first words of a GDALCopyWords() request with a     */
+/*      vector kernel, if there is one for this pair of data types.     */
+/*      Returns the number of words converted, a multiple of 16, and    */
+/*      leaves the others to the caller.  Strided words are gathered    */
+/*      into, or scattered from, packed chunks on the stack.            */
+/************************************************************************/
+
+int GDALCopyWordsSIMD( const void *pSrcData, GDALDataType eSrcType,
+                       int nSrcPixelOffset,
+                       void *pDstData, GDALDataType eDstType,
+                       int nDstPixelOffset, int nWordCount )
+
+{
+    int nLevel = GCWGetSIMDLevel();
+
+    if( nLevel == 0 )
+        return 0;
+
+    GCWKernel pfnKernel = GCWGetKernel( eSrcType, eDstType, nLevel == 2 );
+
+    if( pfnKernel == NULL )
+        return 0;
+
+    int nSrcSize = GDALGetDataTypeSize( eSrcType ) / 8;
+    int nDstSize = GDALGetDataTypeSize( eDstType ) / 8;
+    int bSrcPacked = (nSrcPixelOffset == nSrcSize);
+    int bDstPacked = (nDstPixelOffset == nDstSize);
+
+    if( bSrcPacked && bDstPacked )
+        return pfnKernel( pSrcData, pDstData, nWordCount );
+
+/* -------------------------------------------------------------------- */
+/*      The gather and scatter loops cost about as much as the generic  */
+/*      loop for the cheap conversions, only those between integer      */
+/*      and floating point words gain from the detour.                  */
+/* -------------------------------------------------------------------- */
+    int bSrcFloat = (eSrcType == GDT_Float32 || eSrcType == GDT_Float64);
+    int bDstFloat = (eDstType == GDT_Float32 || eDstType == GDT_Float64);
+
+    if( bSrcFloat == bDstFloat )
+        return 0;
+
+/* -------------------------------------------------------------------- */
+/*      Strided source or destination, go through the stack buffers.    */
+/*      They are double arrays so that the vector loads and stores      */
+/*      are aligned at least on the word size.                          */
+/* -------------------------------------------------------------------- */
+    double adfSrcChunk[GCW_CHUNK_SIZE];
+    double adfDstChunk[GCW_CHUNK_SIZE];
+    const GByte *pabySrc = (const GByte *) pSrcData;
+    GByte *pabyDst = (GByte *) pDstData;
+    int nDone = 0;
+
+    while( nWordCount - nDone >= 16 )
+    {
+        int nChunk = (nWordCount - nDone) & ~15;
+        const void *pChunkSrc;
+        void *pChunkDst;
+
+        if( nChunk > GCW_CHUNK_SIZE )
+            nChunk = GCW_CHUNK_SIZE;
+
+        if( bSrcPacked )
+            pChunkSrc = pabySrc;
+        else
+        {
+            GCWGather( pabySrc, nSrcPixelOffset, nSrcSize,
+                       adfSrcChunk, nChunk );
+            pChunkSrc = adfSrcChunk;
+        }
+
+        pChunkDst = bDstPacked ? (void *) pabyDst : (void *) adfDstChunk;
+
+        nChunk = pfnKernel( pChunkSrc, pChunkDst, nChunk );
+
+        if( !bDstPacked )
+            GCWScatter( adfDstChunk, pabyDst, nDstPixelOffset,
+                        nDstSize, nChunk );
+
+        pabySrc += (std::ptrdiff_t) nChunk * nSrcPixelOffset;
+        pabyDst += (std::ptrdiff_t) nChunk * nDstPixelOffset;
+        nDone += nChunk;
+    }
+
+    return nDone;
+}
+
+#endif /* def HAVE_GCW_SSE2 */
@@ -30,9 +30,740 @@
 #include "ogr_p.h"
 #include "ogr_gensql.h"
 #include "cpl_string.h"
+#include "cpl_hash_set.h"
 
 CPL_CVSID("$Id$");
 
+/************************************************************************/
+/* ==================================================================== */
+/*                          OGRGenSQLJoinIndex                          */
+/*                                                                      */
+/*      Hash of a secondary (joined) table keyed on its join field,     */
+/*      built in one pass over the table the first time the join is     */
+/*      needed.  For each key only the first matching feature is        */
+/*      kept, and of it only the fields the result layer selects,       */
+/*      serialized into a record.  Records are kept in memory until     */
+/*      they reach OGR_SQL_JOIN_CACHEMAX megabytes, after which they    */
+/*      all go to a temporary file.                                     */
+/* ==================================================================== */
+/************************************************************************/
+
+typedef struct
+{
+    char         *pszKey;
+    double        dfKey;
+    vsi_l_offset  nOffset;
+    size_t        nSize;
+} OGRGenSQLJoinEntry;
+
+class OGRGenSQLJoinIndex
+{
+    OGRLayer     *poLayer;
+    int           iKeyField;
+    OGRFieldType  eKeyType;
+    OGRFieldType  eProbeType;
+    int           bUsable;
+
+    int           nColumns;
+    int          *panColumns;
+    int          *panFields;
+
+    CPLHashSet   *hIndex;
+
+    GByte        *pabyRecords;
+    size_t        nRecordsSize;
+    size_t        nRecordsAlloc;
+    size_t        nMaxMem;
+
+    CPLString     osSpillFilename;
+    FILE         *fpSpill;
+    vsi_l_offset  nSpillSize;
+
+    GByte        *pabyRecord;
+    size_t        nRecordSize;
+    size_t        nRecordAlloc;
+
+    void          GrowRecord( size_t nNewSize );
+    void          AppendBytes( const void *pData, size_t nBytes );
+    void          AppendString( const char *pszValue );
+    void          SerializeFeature( OGRFeature *poFeature );
+    int           StoreRecord( OGRGenSQLJoinEntry *psEntry );
+    void          ApplyRecord( const GByte *pabyData, size_t nSize,
+                               OGRFeature *poDstFeat );
+
+  public:
+                  OGRGenSQLJoinIndex( OGRLayer *poLayer, int iKeyField,
+                                      OGRLayer *poSrcLayer, int iSrcField,
+                                      swq_select *psSelectInfo,
+                                      int iSecondaryTable );
+                 ~OGRGenSQLJoinIndex();
+
+    int           IsUsable() { return bUsable; }
+    int           Build();
+    void          Fetch( OGRFeature *poSrcFeat, int iSrcField,
+                         OGRFeature *poDstFeat );
+};
+
+/************************************************************************/
+/*                         OGRGenSQLJoinHash()                          */
+/*                                                                      */
+/*      String keys hash case insensitively, since the attribute        */
+/*      filter this replaces compared strings with EQUAL().             */
+/************************************************************************/
+
+static unsigned long OGRGenSQLJoinHash( const void *pElt )
+
+{
+    const OGRGenSQLJoinEntry *psEntry = (const OGRGenSQLJoinEntry *) pElt;
+    unsigned long nHash = 0;
+
+    if( psEntry->pszKey != NULL )
+    {
+        const char *pszIter;
+
+        for( pszIter = psEntry->pszKey; *pszIter != '\0'; pszIter++ )
+            nHash = nHash * 31 + tolower( (unsigned char) *pszIter );
+    }
+    else
+    {
+        // -0.0 and 0.0 compare equal so they must hash the same.
+        double dfKey = (psEntry->dfKey == 0.0) ? 0.0 : psEntry->dfKey;
+        GByte  abyKey[sizeof(double)];
+        size_t i;
+
+        memcpy( abyKey, &dfKey, sizeof(double) );
+        for( i = 0; i < sizeof(double); i++ )
+            nHash = nHash * 31 + abyKey[i];
+    }
+
+    return nHash;
+}
+
+/************************************************************************/
+/*                         OGRGenSQLJoinEqual()                         */
+/************************************************************************/
+
+static int OGRGenSQLJoinEqual( const void *pElt1, const void *pElt2 )
+
+{
+    const OGRGenSQLJoinEntry *psEntry1 = (const OGRGenSQLJoinEntry *) pElt1;
+    const OGRGenSQLJoinEntry *psEntry2 = (const OGRGenSQLJoinEntry *) pElt2;
+
+    if( psEntry1->pszKey != NULL )
+        return EQUAL(psEntry1->pszKey,psEntry2->pszKey);
+    else
+        return psEntry1->dfKey == psEntry2->dfKey;
+}
+
+/************************************************************************/
+/*                         OGRGenSQLJoinFree()                          */
+/************************************************************************/
+
+static void OGRGenSQLJoinFree( void *pElt )
+
+{
+    OGRGenSQLJoinEntry *psEntry = (OGRGenSQLJoinEntry *) pElt;
+
+    CPLFree( psEntry->pszKey );
+    CPLFree( psEntry );
+}
+
+/************************************************************************/
+/*                         OGRGenSQLJoinIndex()                         */
+/************************************************************************/
+
+OGRGenSQLJoinIndex::OGRGenSQLJoinIndex( OGRLayer *poLayer, int iKeyField,
+                                        OGRLayer *poSrcLayer, int iSrcField,
+                                        swq_select *psSelectInfo,
+                                        int iSecondaryTable )
+
+{
+    OGRFeatureDefn *poLayerDefn = poLayer->GetLayerDefn();
+    OGRFeatureDefn *poSrcDefn = poSrcLayer->GetLayerDefn();
+
+    this->poLayer = poLayer;
+    this->iKeyField = iKeyField;
+    eKeyType = OFTString;
+    eProbeType = OFTString;
+    bUsable = FALSE;
+
+    nColumns = 0;
+    panColumns = NULL;
+    panFields = NULL;
+
+    hIndex = NULL;
+
+    pabyRecords = NULL;
+    nRecordsSize = 0;
+    nRecordsAlloc = 0;
+    nMaxMem = (size_t) 
+        MAX(0,atoi(CPLGetConfigOption("OGR_SQL_JOIN_CACHEMAX","100")))
+        * 1024 * 1024;
+
+    fpSpill = NULL;
+    nSpillSize = 0;
+
+    pabyRecord = NULL;
+    nRecordSize = 0;
+    nRecordAlloc = 0;
+
+/* -------------------------------------------------------------------- */
+/*      We can only hash joins on regular fields, and on the type       */
+/*      combinations for which we know what the equivalent "field =     */
+/*      value" filter would match.  Scanning the primary layer to       */
+/*      build the hash would also break a self join.                    */
+/* -------------------------------------------------------------------- */
+    if( poLayer == poSrcLayer
+        || iKeyField < 0 || iKeyField >= poLayerDefn->GetFieldCount()
+        || iSrcField < 0 || iSrcField >= poSrcDefn->GetFieldCount() )
+        return;
+
+    eKeyType = poLayerDefn->GetFieldDefn( iKeyField )->GetType();
+    eProbeType = poSrcDefn->GetFieldDefn( iSrcField )->GetType();
+
+    if( eProbeType != OFTInteger && eProbeType != OFTReal 
+        && eProbeType != OFTString )
+        return;
+
+    if( eKeyType == OFTString )
+        /* any probe type */;
+    else if( (eKeyType == OFTInteger || eKeyType == OFTReal)
+             && eProbeType != OFTString )
+        /* numeric comparison */;
+    else
+        return;
+
+/* -------------------------------------------------------------------- */
+/*      Collect the result columns that come from this table.           */
+/* -------------------------------------------------------------------- */
+    int iColumn;
+
+    panColumns = (int *) CPLMalloc(sizeof(int) * 
+                                   MAX(1,psSelectInfo->result_columns));
+    panFields = (int *) CPLMalloc(sizeof(int) * 
+                                  MAX(1,psSelectInfo->result_columns));
+
+    for( iColumn = 0; iColumn < psSelectInfo->result_columns; iColumn++ )
+    {
+        swq_col_def *psColDef = psSelectInfo->column_defs + iColumn;
+
+        if( psColDef->table_index != iSecondaryTable
+            || psColDef->field_index < 0
+            || psColDef->field_index >= poLayerDefn->GetFieldCount() )
+            continue;
+
+        panColumns[nColumns] = iColumn;
+        panFields[nColumns] = psColDef->field_index;
+        nColumns++;
+    }
+
+    hIndex = CPLHashSetNew( OGRGenSQLJoinHash, OGRGenSQLJoinEqual,
+                            OGRGenSQLJoinFree );
+    bUsable = TRUE;
+}
+
+/************************************************************************/
+/*                        ~OGRGenSQLJoinIndex()                         */
+/************************************************************************/
+
+OGRGenSQLJoinIndex::~OGRGenSQLJoinIndex()
+
+{
+    if( hIndex != NULL )
+        CPLHashSetDestroy( hIndex );
+
+    if( fpSpill != NULL )
+    {
+        VSIFCloseL( fpSpill );
+        VSIUnlink( osSpillFilename );
+    }
+
+    CPLFree( pabyRecords );
+    CPLFree( pabyRecord );
+    CPLFree( panColumns );
+    CPLFree( panFields );
+}
+
+/************************************************************************/
+/*                             GrowRecord()                             */
+/************************************************************************/
+
+void OGRGenSQLJoinIndex::GrowRecord( size_t nNewSize )
+
+{
+    if( nNewSize > nRecordAlloc )
+    {
+        nRecordAlloc = MAX(nNewSize, nRecordAlloc * 2 + 256);
+        pabyRecord = (GByte *) CPLRealloc( pabyRecord, nRecordAlloc );
+    }
+}
+
+/************************************************************************/
+/*                            AppendBytes()                             */
+/************************************************************************/
+
+void OGRGenSQLJoinIndex::AppendBytes( const void *pData, size_t nBytes )
+
+{
+    GrowRecord( nRecordSize + nBytes );
+    memcpy( pabyRecord + nRecordSize, pData, nBytes );
+    nRecordSize += nBytes;
+}
+
+/************************************************************************/
+/*                            AppendString()                            */
+/*                                                                      */
+/*      Strings are stored with their terminating zero so that they     */
+/*      can be used in place when the record is applied.                */
+/************************************************************************/
+
+void OGRGenSQLJoinIndex::AppendString( const char *pszValue )
+
+{
+    GUInt32 nLength = (GUInt32) strlen(pszValue);
+
+    AppendBytes( &nLength, sizeof(nLength) );
+    AppendBytes( pszValue, nLength + 1 );
+}
+
+/************************************************************************/
+/*                          SerializeFeature()                          */
+/*                                                                      */
+/*      Write the selected fields of a secondary feature into           */
+/*      pabyRecord as a set flag followed by the raw value.             */
+/************************************************************************/
+
+void OGRGenSQLJoinIndex::SerializeFeature( OGRFeature *poFeature )
+
+{
+    OGRFeatureDefn *poLayerDefn = poLayer->GetLayerDefn();
+    int iColumn;
+
+    nRecordSize = 0;
+
+    for( iColumn = 0; iColumn < nColumns; iColumn++ )
+    {
+        int iField = panFields[iColumn];
+        OGRField *psField = poFeature->GetRawFieldRef( iField );
+        GByte bSet = (GByte) poFeature->IsFieldSet( iField );
+        GUInt32 nCount, i;
+
+        switch( poLayerDefn->GetFieldDefn( iField )->GetType() )
+        {
+          case OFTInteger:
+          case OFTReal:
+          case OFTString:
+          case OFTDate:
+          case OFTTime:
+          case OFTDateTime:
+          case OFTIntegerList:
+          case OFTRealList:
+          case OFTStringList:
+          case OFTBinary:
+            break;
+
+          default:
+            bSet = FALSE;
+            break;
+        }
+
+        AppendBytes( &bSet, 1 );
+        if( !bSet )
+            continue;
+
+        switch( poLayerDefn->GetFieldDefn( iField )->GetType() )
+        {
+          case OFTInteger:
+            AppendBytes( &(psField->Integer), sizeof(int) );
+            break;
+
+          case OFTReal:
+            AppendBytes( &(psField->Real), sizeof(double) );
+            break;
+
+          case OFTString:
+            AppendString( psField->String );
+            break;
+
+          case OFTDate:
+          case OFTTime:
+          case OFTDateTime:
+            AppendBytes( &(psField->Date), sizeof(psField->Date) );
+            break;
+
+          case OFTIntegerList:
+            nCount = psField->IntegerList.nCount;
+            AppendBytes( &nCount, sizeof(nCount) );
+            AppendBytes( psField->IntegerList.paList, sizeof(int) * nCount );
+            break;
+
+          case OFTRealList:
+            nCount = psField->RealList.nCount;
+            AppendBytes( &nCount, sizeof(nCount) );
+            AppendBytes( psField->RealList.paList, sizeof(double) * nCount );
+            break;
+
+          case OFTStringList:
+            nCount = psField->StringList.nCount;
+            AppendBytes( &nCount, sizeof(nCount) );
+            for( i = 0; i < nCount; i++ )
+                AppendString( psField->StringList.paList[i] );
+            break;
+
+          case OFTBinary:
+            nCount = psField->Binary.nCount;
+            AppendBytes( &nCount, sizeof(nCount) );
+            AppendBytes( psField->Binary.paData, nCount );
+            break;
+
+          default:
+            break;
+        }
+    }
+}
+
+/************************************************************************/
+/*                            StoreRecord()                             */
+/*                                                                      */
+/*      Save pabyRecord and note where it went in the entry.  Once      */
+/*      the memory budget is exceeded the records collected so far      */
+/*      are moved to a temporary file, and all further records are      */
+/*      appended to it.                                                 */
+/************************************************************************/
+
+int OGRGenSQLJoinIndex::StoreRecord( OGRGenSQLJoinEntry *psEntry )
+
+{
+    if( fpSpill == NULL && nRecordsSize + nRecordSize > nMaxMem )
+    {
+        osSpillFilename = CPLGenerateTempFilename( "ogr_join_" );
+        fpSpill = VSIFOpenL( osSpillFilename, "w+b" );
+        if( fpSpill == NULL )
+        {
+            CPLError( CE_Failure, CPLE_OpenFailed,
+                      "Failed to create join temporary file %s.",
+                      osSpillFilename.c_str() );
+            return FALSE;
+        }
+
+        CPLDebug( "GenSQL", "Spilling join records of layer '%s' to %s.",
+                  poLayer->GetLayerDefn()->GetName(),
+                  osSpillFilename.c_str() );
+
+        if( nRecordsSize > 0
+            && VSIFWriteL( pabyRecords, 1, nRecordsSize, fpSpill ) 
+               != nRecordsSize )
+        {
+            CPLError( CE_Failure, CPLE_FileIO,
+                      "Failed to write join temporary file %s.",
+                      osSpillFilename.c_str() );
+            return FALSE;
+        }
+
+        nSpillSize = nRecordsSize;
+        CPLFree( pabyRecords );
+        pabyRecords = NULL;
+        nRecordsSize = 0;
+        nRecordsAlloc = 0;
+    }
+
+    psEntry->nSize = nRecordSize;
+
+    if( fpSpill != NULL )
+    {
+        psEntry->nOffset = nSpillSize;
+        if( nRecordSize > 0
+            && VSIFWriteL( pabyRecord, 1, nRecordSize, fpSpill ) 
+               != nRecordSize )
+        {
+            CPLError( CE_Failure, CPLE_FileIO,
+                      "Failed to write join temporary file %s.",
+                      osSpillFilename.c_str() );
+            return FALSE;
+        }
+        nSpillSize += nRecordSize;
+    }
+    else
+    {
+        if( nRecordsSize + nRecordSize > nRecordsAlloc )
+        {
+            nRecordsAlloc = MAX(nRecordsSize + nRecordSize,
+                                nRecordsAlloc * 2 + 4096);
+            nRecordsAlloc = MIN(nRecordsAlloc, MAX(nMaxMem,
+                                                   nRecordsSize+nRecordSize));
+            pabyRecords = (GByte *) CPLRealloc( pabyRecords, nRecordsAlloc );
+        }
+
+        psEntry->nOffset = nRecordsSize;
+        memcpy( pabyRecords + nRecordsSize, pabyRecord, nRecordSize );
+        nRecordsSize += nRecordSize;
+    }
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                               Build()                                */
+/*                                                                      */
+/*      On failure the index is marked unusable, and the join falls     */
+/*      back to attribute filters.                                      */
+/************************************************************************/
+
+int OGRGenSQLJoinIndex::Build()
+
+{
+    OGRFeature *poFeature;
+    int         nFeatures = 0;
+
+    poLayer->SetAttributeFilter( NULL );
+    poLayer->ResetReading();
+
+    while( (poFeature = poLayer->GetNextFeature()) != NULL )
+    {
+        OGRGenSQLJoinEntry sProbe;
+        OGRField *psKey = poFeature->GetRawFieldRef( iKeyField );
+
+        nFeatures++;
+
+/* -------------------------------------------------------------------- */
+/*      An unset string field matched an empty string in the            */
+/*      attribute filter, unset numeric fields never matched.           */
+/* -------------------------------------------------------------------- */
+        sProbe.pszKey = NULL;
+        sProbe.dfKey = 0.0;
+
+        if( eKeyType == OFTString )
+            sProbe.pszKey = poFeature->IsFieldSet( iKeyField ) 
+                ? psKey->String : (char *) "";
+        else if( !poFeature->IsFieldSet( iKeyField ) )
+        {
+            delete poFeature;
+            continue;
+        }
+        else if( eKeyType == OFTInteger )
+            sProbe.dfKey = psKey->Integer;
+        else
+            sProbe.dfKey = psKey->Real;
+
+/* -------------------------------------------------------------------- */
+/*      Only the first feature with a given key is ever returned.       */
+/* -------------------------------------------------------------------- */
+        if( CPLHashSetLookup( hIndex, &sProbe ) != NULL )
+        {
+            delete poFeature;
+            continue;
+        }
+
+        OGRGenSQLJoinEntry *psEntry = (OGRGenSQLJoinEntry *) 
+            CPLMalloc(sizeof(OGRGenSQLJoinEntry));
+
+        psEntry->pszKey = 
+            sProbe.pszKey ? CPLStrdup( sProbe.pszKey ) : NULL;
+        psEntry->dfKey = sProbe.dfKey;
+
+        SerializeFeature( poFeature );
+        delete poFeature;
+
+        if( !StoreRecord( psEntry ) )
+        {
+            OGRGenSQLJoinFree( psEntry );
+            poLayer->ResetReading();
+            bUsable = FALSE;
+            return FALSE;
+        }
+
+        CPLHashSetInsert( hIndex, psEntry );
+    }
+
+    poLayer->ResetReading();
+
+    CPLDebug( "GenSQL", "Hashed %d keys of %d features on layer '%s'.",
+              CPLHashSetSize( hIndex ), nFeatures,
+              poLayer->GetLayerDefn()->GetName() );
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                            ApplyRecord()                             */
+/************************************************************************/
+
+void OGRGenSQLJoinIndex::ApplyRecord( const GByte *pabyData, size_t nSize,
+                                      OGRFeature *poDstFeat )
+
+{
+    OGRFeatureDefn *poLayerDefn = poLayer->GetLayerDefn();
+    size_t nOffset = 0;
+    int    iColumn;
+
+    for( iColumn = 0; iColumn < nColumns && nOffset < nSize; iColumn++ )
+    {
+        OGRField sField;
+        GUInt32  nCount, nLength, i;
+
+        if( pabyData[nOffset++] == 0 )
+            continue;
+
+        switch( poLayerDefn->GetFieldDefn(panFields[iColumn])->GetType() )
+        {
+          case OFTInteger:
+            memcpy( &(sField.Integer), pabyData + nOffset, sizeof(int) );
+            nOffset += sizeof(int);
+            poDstFeat->SetField( panColumns[iColumn], &sField );
+            break;
+
+          case OFTReal:
+            memcpy( &(sField.Real), pabyData + nOffset, sizeof(double) );
+            nOffset += sizeof(double);
+            poDstFeat->SetField( panColumns[iColumn], &sField );
+            break;
+
+          case OFTString:
+            memcpy( &nLength, pabyData + nOffset, sizeof(nLength) );
+            sField.String = (char *) pabyData + nOffset + sizeof(nLength);
+            nOffset += sizeof(nLength) + nLength + 1;
+            poDstFeat->SetField( panColumns[iColumn], &sField );
+            break;
+
+          case OFTDate:
+          case OFTTime:
+          case OFTDateTime:
+            memcpy( &(sField.Date), pabyData + nOffset, sizeof(sField.Date) );
+            nOffset += sizeof(sField.Date);
+            poDstFeat->SetField( panColumns[iColumn], &sField );
+            break;
+
+          case OFTIntegerList:
+            memcpy( &nCount, pabyData + nOffset, sizeof(nCount) );
+            nOffset += sizeof(nCount);
+            sField.IntegerList.nCount = nCount;
+            sField.IntegerList.paList = 
+                (int *) CPLMalloc(sizeof(int) * MAX(1,nCount));
+            memcpy( sField.IntegerList.paList, pabyData + nOffset,
+                    sizeof(int) * nCount );
+            nOffset += sizeof(int) * nCount;
+            poDstFeat->SetField( panColumns[iColumn], &sField );
+            CPLFree( sField.IntegerList.paList );
+            break;
+
+          case OFTRealList:
+            memcpy( &nCount, pabyData + nOffset, sizeof(nCount) );
+            nOffset += sizeof(nCount);
+            sField.RealList.nCount = nCount;
+            sField.RealList.paList = 
+                (double *) CPLMalloc(sizeof(double) * MAX(1,nCount));
+            memcpy( sField.RealList.paList, pabyData + nOffset,
+                    sizeof(double) * nCount );
+            nOffset += sizeof(double) * nCount;
+            poDstFeat->SetField( panColumns[iColumn], &sField );
+            CPLFree( sField.RealList.paList );
+            break;
+
+          case OFTStringList:
+            memcpy( &nCount, pabyData + nOffset, sizeof(nCount) );
+            nOffset += sizeof(nCount);
+            sField.StringList.nCount = nCount;
+            sField.StringList.paList = 
+                (char **) CPLMalloc(sizeof(char *) * (nCount + 1));
+            for( i = 0; i < nCount; i++ )
+            {
+                memcpy( &nLength, pabyData + nOffset, sizeof(nLength) );
+                sField.StringList.paList[i] = 
+                    (char *) pabyData + nOffset + sizeof(nLength);
+                nOffset += sizeof(nLength) + nLength + 1;
+            }
+            sField.StringList.paList[nCount] = NULL;
+            poDstFeat->SetField( panColumns[iColumn], &sField );
+            CPLFree( sField.StringList.paList );
+            break;
+
+          case OFTBinary:
+            memcpy( &nCount, pabyData + nOffset, sizeof(nCount) );
+            nOffset += sizeof(nCount);
+            sField.Binary.nCount = nCount;
+            sField.Binary.paData = (GByte *) pabyData + nOffset;
+            nOffset += nCount;
+            poDstFeat->SetField( panColumns[iColumn], &sField );
+            break;
+
+          default:
+            break;
+        }
+    }
+}
+
+/************************************************************************/
+/*                               Fetch()                                */
+/*                                                                      */
+/*      Look up the primary feature's join value, and copy the          */
+/*      selected fields of the matching secondary feature, if any.      */
+/*      The key is formed the way the old "field = value" filter        */
+/*      would have interpreted the primary value.                       */
+/************************************************************************/
+
+void OGRGenSQLJoinIndex::Fetch( OGRFeature *poSrcFeat, int iSrcField,
+                                OGRFeature *poDstFeat )
+
+{
+    OGRField *psSrcField = poSrcFeat->GetRawFieldRef( iSrcField );
+    OGRGenSQLJoinEntry sProbe;
+    char szKey[64];
+
+    sProbe.pszKey = NULL;
+    sProbe.dfKey = 0.0;
+
+    if( eKeyType == OFTString )
+    {
+        if( eProbeType == OFTInteger )
+            sprintf( szKey, "%d", psSrcField->Integer );
+        else if( eProbeType == OFTReal )
+            sprintf( szKey, "%.16g", psSrcField->Real );
+
+        if( eProbeType == OFTString )
+            sProbe.pszKey = psSrcField->String;
+        else
+            sProbe.pszKey = szKey;
+    }
+    else if( eProbeType == OFTInteger )
+        sProbe.dfKey = psSrcField->Integer;
+    else if( eKeyType == OFTInteger )
+    {
+        sprintf( szKey, "%.16g", psSrcField->Real );
+        sProbe.dfKey = atoi(szKey);
+    }
+    else
+        sProbe.dfKey = psSrcField->Real;
+
+    OGRGenSQLJoinEntry *psEntry = (OGRGenSQLJoinEntry *) 
+        CPLHashSetLookup( hIndex, &sProbe );
+
+    if( psEntry == NULL || psEntry->nSize == 0 )
+        return;
+
+/* -------------------------------------------------------------------- */
+/*      Fetch the record from memory or from the spill file.            */
+/* -------------------------------------------------------------------- */
+    if( fpSpill == NULL )
+    {
+        ApplyRecord( pabyRecords + psEntry->nOffset, psEntry->nSize,
+                     poDstFeat );
+        return;
+    }
+
+    GrowRecord( psEntry->nSize );
+    if( VSIFSeekL( fpSpill, psEntry->nOffset, SEEK_SET ) != 0
+        || VSIFReadL( pabyRecord, 1, psEntry->nSize, fpSpill ) 
+           != psEntry->nSize )
+    {
+        CPLError( CE_Failure, CPLE_FileIO,
+                  "Failed to read join temporary file %s.",
+                  osSpillFilename.c_str() );
+        return;
+    }
+
+    ApplyRecord( pabyRecord, psEntry->nSize, poDstFeat );
+}
+
 /************************************************************************/
 /*                       OGRGenSQLResultsLayer()                        */
 /************************************************************************/
@@ -53,6 +784,12 @@ OGRGenSQLResultsLayer::OGRGenSQLResultsLayer( OGRDataSource *poSrcDS,
     nNextIndexFID = 0;
     nExtraDSCount = 0;
     papoExtraDS = NULL;
+    papoJoinIndexes = NULL;
+
+    if( psSelectInfo->join_count > 0 )
+        papoJoinIndexes = (OGRGenSQLJoinIndex **)
+            CPLCalloc( sizeof(OGRGenSQLJoinIndex *), 
+                       psSelectInfo->join_count );
 
 /* -------------------------------------------------------------------- */
 /*      Identify all the layers involved in the SELECT.                 */
@@ -242,6 +979,14 @@ OGRGenSQLResultsLayer::~OGRGenSQLResultsLayer()
     if( poSummaryFeature )
         delete poSummaryFeature;
 
+    if( papoJoinIndexes != NULL )
+    {
+        for( int iJoin = 0; 
+             iJoin < ((swq_select *) pSelectInfo)->join_count; iJoin++ )
+            delete papoJoinIndexes[iJoin];
+        CPLFree( papoJoinIndexes );
+    }
+
     if( pSelectInfo != NULL )
         swq_select_free( (swq_select *) pSelectInfo );
 
@@ -555,6 +1300,40 @@ int OGRGenSQLResultsLayer::PrepareSummary()
     return TRUE;
 }
 
+/************************************************************************/
+/*                            GetJoinIndex()                            */
+/*                                                                      */
+/*      Return the hash of the secondary table of a join, building      */
+/*      it on first use, or NULL if this join has to be resolved        */
+/*      with an attribute filter on the secondary layer.                */
+/************************************************************************/
+
+OGRGenSQLJoinIndex *OGRGenSQLResultsLayer::GetJoinIndex( int iJoin )
+
+{
+    swq_select *psSelectInfo = (swq_select *) pSelectInfo;
+
+    if( papoJoinIndexes[iJoin] == NULL )
+    {
+        swq_join_def *psJoinInfo = psSelectInfo->join_defs + iJoin;
+
+        papoJoinIndexes[iJoin] = 
+            new OGRGenSQLJoinIndex( 
+                papoTableLayers[psJoinInfo->secondary_table],
+                psJoinInfo->secondary_field,
+                poSrcLayer, psJoinInfo->primary_field,
+                psSelectInfo, psJoinInfo->secondary_table );
+
+        if( papoJoinIndexes[iJoin]->IsUsable() )
+            papoJoinIndexes[iJoin]->Build();
+    }
+
+    if( !papoJoinIndexes[iJoin]->IsUsable() )
+        return NULL;
+
+    return papoJoinIndexes[iJoin];
+}
+
 /************************************************************************/
 /*                          TranslateFeature()                          */
 /************************************************************************/
@@ -648,6 +1427,16 @@ OGRFeature *OGRGenSQLResultsLayer::TranslateFeature( OGRFeature *poSrcFeat )
         if( !poSrcFeat->IsFieldSet( psJoinInfo->primary_field ) )
             continue;
 
+        // Use the hash of the secondary table when we have one.
+        OGRGenSQLJoinIndex *poJoinIndex = GetJoinIndex( iJoin );
+
+        if( poJoinIndex != NULL )
+        {
+            poJoinIndex->Fetch( poSrcFeat, psJoinInfo->primary_field,
+                                poDstFeat );
+            continue;
+        }
+
         // Prepare attribute query to express fetching on the joined variable
         sprintf( szFilter, "%s = ", 
                  poJoinLayer->GetLayerDefn()->GetFieldDefn( 
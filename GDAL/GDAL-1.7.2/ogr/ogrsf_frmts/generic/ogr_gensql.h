@@ -32,6 +32,8 @@
 
 #include "ogrsf_frmts.h"
 
+class OGRGenSQLJoinIndex;
+
 /************************************************************************/
 /*                        OGRGenSQLResultsLayer                         */
 /************************************************************************/
@@ -62,6 +64,9 @@ class CPL_DLL OGRGenSQLResultsLayer : public OGRLayer
     int         nExtraDSCount;
     OGRDataSource **papoExtraDS;
 
+    OGRGenSQLJoinIndex **papoJoinIndexes;
+    OGRGenSQLJoinIndex *GetJoinIndex( int iJoin );
+
     OGRFeature *TranslateFeature( OGRFeature * );
     void        CreateOrderByIndex();
     void        SortIndexSection( OGRField *pasIndexFields, 
@@ -40,6 +40,12 @@ CPL_CVSID("$Id$");
 #  include "cpl_wince.h"
 #endif
 
+#ifdef WIN32
+#  include <windows.h>
+#else
+#  include <sys/time.h>
+#endif
+
 static void *hConfigMutex = NULL;
 static volatile char **papszConfigOptions = NULL;
 
@@ -2293,3 +2299,30 @@ int CPLCheckForFile( char *pszFilename, char **papszSiblingFiles )
 
     return FALSE;
 }
+
+/************************************************************************/
+/*                           CPLGetWallTime()                           */
+/************************************************************************/
+
+/**
+ * Fetch the current wall clock time.
+ *
+ * The origin is unspecified, so only the difference between two calls
+ * is meaningful, for instance to time an operation.  The resolution is
+ * about a microsecond on Unix, and that of GetTickCount() on Windows.
+ *
+ * @return the wall clock time in seconds.
+ */
+
+double CPLGetWallTime()
+
+{
+#ifdef WIN32
+    return GetTickCount() / 1000.0;
+#else
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
@@ -126,6 +126,11 @@ void CPL_DLL *CPLGetSymbol( const char *, const char * );
 /* -------------------------------------------------------------------- */
 int CPL_DLL CPLGetExecPath( char *pszPathBuf, int nMaxLength );
 
+/* -------------------------------------------------------------------- */
+/*      Wall clock time, for timing operations.                         */
+/* -------------------------------------------------------------------- */
+double CPL_DLL CPLGetWallTime( void );
+
 /* -------------------------------------------------------------------- */
 /*      Filename handling functions.                                    */
 /* -------------------------------------------------------------------- */
@@ -274,6 +274,55 @@ void CPLDestroyMutex( void *hMutex )
 #endif
 }
 
+/************************************************************************/
+/*                           CPLCreateCond()                            */
+/*                                                                      */
+/*      Threads cannot be created, so nothing ever waits.               */
+/************************************************************************/
+
+void *CPLCreateCond()
+
+{
+    return CPLMalloc( 1 );
+}
+
+/************************************************************************/
+/*                            CPLCondWait()                             */
+/************************************************************************/
+
+void CPLCondWait( void *hCond, void *hMutex )
+
+{
+}
+
+/************************************************************************/
+/*                           CPLCondSignal()                            */
+/************************************************************************/
+
+void CPLCondSignal( void *hCond )
+
+{
+}
+
+/************************************************************************/
+/*                          CPLCondBroadcast()                          */
+/************************************************************************/
+
+void CPLCondBroadcast( void *hCond )
+
+{
+}
+
+/************************************************************************/
+/*                           CPLDestroyCond()                           */
+/************************************************************************/
+
+void CPLDestroyCond( void *hCond )
+
+{
+    CPLFree( hCond );
+}
+
 /************************************************************************/
 /*                            CPLLockFile()                             */
 /*                                                                      */
@@ -504,6 +553,116 @@ void CPLDestroyMutex( void *hMutexIn )
     CloseHandle( hMutex );
 }
 
+/************************************************************************/
+/*                           CPLCreateCond()                            */
+/*                                                                      */
+/*      A condition is a list of the events of the waiting threads,     */
+/*      each of which is set once by CPLCondSignal() or                 */
+/*      CPLCondBroadcast().                                             */
+/************************************************************************/
+
+typedef struct _CPLCondWaiter
+{
+    HANDLE                 hEvent;
+    struct _CPLCondWaiter *psNext;
+} CPLCondWaiter;
+
+typedef struct
+{
+    void                  *hInternalMutex;
+    CPLCondWaiter         *psWaiterList;
+} CPLWin32Cond;
+
+void *CPLCreateCond()
+
+{
+    CPLWin32Cond *psCond = (CPLWin32Cond *) CPLMalloc( sizeof(CPLWin32Cond) );
+
+    psCond->hInternalMutex = CPLCreateMutex();
+    psCond->psWaiterList = NULL;
+    CPLReleaseMutex( psCond->hInternalMutex );
+
+    return psCond;
+}
+
+/************************************************************************/
+/*                            CPLCondWait()                             */
+/************************************************************************/
+
+void CPLCondWait( void *hCond, void *hClientMutex )
+
+{
+    CPLWin32Cond *psCond = (CPLWin32Cond *) hCond;
+    CPLCondWaiter sWaiter;
+
+    /* Queue up before releasing the client mutex so no signal is lost. */
+    sWaiter.hEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+
+    CPLAcquireMutex( psCond->hInternalMutex, 1000.0 );
+    sWaiter.psNext = psCond->psWaiterList;
+    psCond->psWaiterList = &sWaiter;
+    CPLReleaseMutex( psCond->hInternalMutex );
+
+    CPLReleaseMutex( hClientMutex );
+    WaitForSingleObject( sWaiter.hEvent, INFINITE );
+    WaitForSingleObject( (HANDLE) hClientMutex, INFINITE );
+
+    CloseHandle( sWaiter.hEvent );
+}
+
+/************************************************************************/
+/*                           CPLCondSignal()                            */
+/************************************************************************/
+
+void CPLCondSignal( void *hCond )
+
+{
+    CPLWin32Cond *psCond = (CPLWin32Cond *) hCond;
+
+    CPLAcquireMutex( psCond->hInternalMutex, 1000.0 );
+    if( psCond->psWaiterList != NULL )
+    {
+        CPLCondWaiter *psWaiter = psCond->psWaiterList;
+
+        psCond->psWaiterList = psWaiter->psNext;
+        SetEvent( psWaiter->hEvent );
+    }
+    CPLReleaseMutex( psCond->hInternalMutex );
+}
+
+/************************************************************************/
+/*                          CPLCondBroadcast()                          */
+/************************************************************************/
+
+void CPLCondBroadcast( void *hCond )
+
+{
+    CPLWin32Cond *psCond = (CPLWin32Cond *) hCond;
+
+    CPLAcquireMutex( psCond->hInternalMutex, 1000.0 );
+    while( psCond->psWaiterList != NULL )
+    {
+        CPLCondWaiter *psWaiter = psCond->psWaiterList;
+
+        psCond->psWaiterList = psWaiter->psNext;
+        SetEvent( psWaiter->hEvent );
+    }
+    CPLReleaseMutex( psCond->hInternalMutex );
+}
+
+/************************************************************************/
+/*                           CPLDestroyCond()                           */
+/************************************************************************/
+
+void CPLDestroyCond( void *hCond )
+
+{
+    CPLWin32Cond *psCond = (CPLWin32Cond *) hCond;
+
+    CPLDestroyMutex( psCond->hInternalMutex );
+    CPLFree( psCond );
+}
+
 /************************************************************************/
 /*                            CPLLockFile()                             */
 /************************************************************************/
@@ -802,6 +961,68 @@ void CPLDestroyMutex( void *hMutexIn )
     free( hMutexIn );
 }
 
+/************************************************************************/
+/*                           CPLCreateCond()                            */
+/************************************************************************/
+
+void *CPLCreateCond()
+
+{
+    pthread_cond_t *pCond = (pthread_cond_t *) malloc(sizeof(pthread_cond_t));
+
+    if( pCond != NULL && pthread_cond_init( pCond, NULL ) != 0 )
+    {
+        free( pCond );
+        return NULL;
+    }
+
+    return pCond;
+}
+
+/************************************************************************/
+/*                            CPLCondWait()                             */
+/*                                                                      */
+/*      The mutex must be held exactly once by the calling thread, as   */
+/*      our mutexes are recursive.                                      */
+/************************************************************************/
+
+void CPLCondWait( void *hCond, void *hMutex )
+
+{
+    pthread_cond_wait( (pthread_cond_t *) hCond, (pthread_mutex_t *) hMutex );
+}
+
+/************************************************************************/
+/*                           CPLCondSignal()                            */
+/************************************************************************/
+
+void CPLCondSignal( void *hCond )
+
+{
+    pthread_cond_signal( (pthread_cond_t *) hCond );
+}
+
+/************************************************************************/
+/*                          CPLCondBroadcast()                          */
+/************************************************************************/
+
+void CPLCondBroadcast( void *hCond )
+
+{
+    pthread_cond_broadcast( (pthread_cond_t *) hCond );
+}
+
+/************************************************************************/
+/*                           CPLDestroyCond()                           */
+/************************************************************************/
+
+void CPLDestroyCond( void *hCond )
+
+{
+    pthread_cond_destroy( (pthread_cond_t *) hCond );
+    free( hCond );
+}
+
 /************************************************************************/
 /*                            CPLLockFile()                             */
 /*                                                                      */
@@ -61,6 +61,12 @@ int   CPL_DLL CPLAcquireMutex( void *hMutex, double dfWaitInSeconds );
 void  CPL_DLL CPLReleaseMutex( void *hMutex );
 void  CPL_DLL CPLDestroyMutex( void *hMutex );
 
+void  CPL_DLL *CPLCreateCond();
+void  CPL_DLL  CPLCondWait( void *hCond, void *hMutex );
+void  CPL_DLL  CPLCondSignal( void *hCond );
+void  CPL_DLL  CPLCondBroadcast( void *hCond );
+void  CPL_DLL  CPLDestroyCond( void *hCond );
+
 GIntBig CPL_DLL CPLGetPID();
 int   CPL_DLL CPLCreateThread( CPLThreadFunc pfnMain, void *pArg );
 void  CPL_DLL CPLSleep( double dfWaitInSeconds );
@@ -108,6 +114,8 @@ class CPL_DLL CPLMutexHolder
 #define CTLS_VERSIONINFO_LICENCE       13         /* gdal_misc.cpp */
 #define CTLS_CONFIGOPTIONS             14         /* cpl_conv.cpp */
 #define CTLS_FINDFILE                  15         /* cpl_findfile.cpp */
+#define CTLS_DIRTYBLOCKFLUSH           16         /* gdalrasterblock.cpp */
+#define CTLS_COPYREADER                17         /* rasterio.cpp */
 
 #define CTLS_MAX                       32         
 
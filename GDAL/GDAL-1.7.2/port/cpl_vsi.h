@@ -135,6 +135,8 @@ int CPL_DLL     VSIFEofL( FILE * );
 int CPL_DLL     VSIFFlushL( FILE * );
 int CPL_DLL     VSIFPrintfL( FILE *, const char *, ... ) CPL_PRINT_FUNC_FORMAT(2, 3);
 int CPL_DLL     VSIFPutcL( int, FILE * );
+void CPL_DLL   *VSIFMapL( FILE *, vsi_l_offset, size_t, void ** );
+void CPL_DLL    VSIFUnmapL( void * );
 
 #if defined(VSI_STAT64_T)
 typedef struct VSI_STAT64_T VSIStatBufL;
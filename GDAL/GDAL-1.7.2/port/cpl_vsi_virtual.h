@@ -59,6 +59,9 @@ class CPL_DLL VSIVirtualHandle {
     virtual int       Flush() {return 0;}
     virtual int       Close() = 0;
     virtual           ~VSIVirtualHandle() { }
+
+    /* Added last, so the existing vtable slots keep their place. */
+    virtual void     *GetNativeFileDescriptor() { return NULL; }
 };
 
 /************************************************************************/
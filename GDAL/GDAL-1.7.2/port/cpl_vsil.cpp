@@ -32,6 +32,17 @@
 #include "cpl_string.h"
 #include <string>
 
+#if defined(WIN32) && !defined(WIN32CE)
+#  include <windows.h>
+#  define VSI_MAP_WIN32
+#elif !defined(WIN32) && !defined(WIN32CE)
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#  define VSI_MAP_POSIX
+#endif
+
 CPL_CVSID("$Id$");
 
 /************************************************************************/
@@ -545,6 +556,174 @@ int VSIFPutcL( int nChar, FILE * fp )
     return VSIFWriteL(&cChar, 1, 1, fp);
 }
 
+/************************************************************************/
+/*                              VSIFMapL()                              */
+/************************************************************************/
+
+typedef struct
+{
+    void        *pBase;
+    size_t       nLength;
+#ifdef VSI_MAP_WIN32
+    HANDLE       hFileMapping;
+#endif
+} VSIFileMapping;
+
+/**
+ * \brief Map a region of a file into memory, read-only.
+ *
+ * This is only possible for regular files of the default file system.
+ * For other files (such as in memory ones), or if the region does not lie
+ * entirely within the file, NULL is returned without any error being
+ * issued, so callers can fall back to reading the file.
+ *
+ * The mapping remains valid until VSIFUnmapL() is called, even if the file
+ * is closed in between.  The file should not be truncated while it is
+ * mapped.
+ *
+ * @param fp file handle opened with VSIFOpenL().
+ * @param nOffset offset in bytes of the start of the region in the file.
+ * @param nSize size of the region in bytes.
+ * @param phMapping location in which the handle of the mapping, to be
+ * passed to VSIFUnmapL(), is returned.
+ *
+ * @return a pointer to the first byte of the region, or NULL.
+ */
+
+void *VSIFMapL( FILE *fp, vsi_l_offset nOffset, size_t nSize, 
+                void **phMapping )
+
+{
+    VSIVirtualHandle *poFileHandle = (VSIVirtualHandle *) fp;
+    void *pNative = poFileHandle->GetNativeFileDescriptor();
+    void *pBase = NULL;
+    vsi_l_offset nAlignedOffset;
+    size_t nDelta;
+
+    *phMapping = NULL;
+
+    if( pNative == NULL || nSize == 0 )
+        return NULL;
+
+#if defined(VSI_MAP_POSIX)
+/* -------------------------------------------------------------------- */
+/*      mmap() offsets must be a multiple of the page size.             */
+/* -------------------------------------------------------------------- */
+    int fd = (int) (size_t) pNative;
+    struct stat sStat;
+
+    if( fstat( fd, &sStat ) != 0 
+        || nOffset + nSize > (vsi_l_offset) sStat.st_size )
+        return NULL;
+
+    nAlignedOffset = nOffset - nOffset % (size_t) sysconf( _SC_PAGESIZE );
+    nDelta = (size_t) (nOffset - nAlignedOffset);
+    if( nSize > ~((size_t) 0) - nDelta
+        || (vsi_l_offset) (off_t) nAlignedOffset != nAlignedOffset )
+        return NULL;
+
+    pBase = mmap( NULL, nSize + nDelta, PROT_READ, MAP_SHARED, fd, 
+                  (off_t) nAlignedOffset );
+    if( pBase == MAP_FAILED )
+        return NULL;
+
+    VSIFileMapping *psMapping = 
+        (VSIFileMapping *) VSIMalloc( sizeof(VSIFileMapping) );
+    if( psMapping == NULL )
+    {
+        munmap( pBase, nSize + nDelta );
+        return NULL;
+    }
+
+#elif defined(VSI_MAP_WIN32)
+/* -------------------------------------------------------------------- */
+/*      MapViewOfFile() offsets must be a multiple of the allocation    */
+/*      granularity.                                                    */
+/* -------------------------------------------------------------------- */
+    HANDLE hFile = (HANDLE) pNative;
+    SYSTEM_INFO sInfo;
+    DWORD nSizeHigh = 0, nSizeLow;
+
+    nSizeLow = GetFileSize( hFile, &nSizeHigh );
+    if( nSizeLow == INVALID_FILE_SIZE && GetLastError() != NO_ERROR )
+        return NULL;
+    if( nOffset + nSize > (((vsi_l_offset) nSizeHigh) << 32) + nSizeLow )
+        return NULL;
+
+    GetSystemInfo( &sInfo );
+    nAlignedOffset = nOffset - nOffset % sInfo.dwAllocationGranularity;
+    nDelta = (size_t) (nOffset - nAlignedOffset);
+    if( nSize > ~((size_t) 0) - nDelta )
+        return NULL;
+
+    HANDLE hFileMapping = CreateFileMapping( hFile, NULL, PAGE_READONLY,
+                                             0, 0, NULL );
+    if( hFileMapping == NULL )
+        return NULL;
+
+    pBase = MapViewOfFile( hFileMapping, FILE_MAP_READ, 
+                           (DWORD) (nAlignedOffset >> 32),
+                           (DWORD) (nAlignedOffset & 0xffffffff),
+                           nSize + nDelta );
+
+    VSIFileMapping *psMapping = NULL;
+
+    if( pBase != NULL )
+        psMapping = (VSIFileMapping *) VSIMalloc( sizeof(VSIFileMapping) );
+    if( psMapping == NULL )
+    {
+        if( pBase != NULL )
+            UnmapViewOfFile( pBase );
+        CloseHandle( hFileMapping );
+        return NULL;
+    }
+    psMapping->hFileMapping = hFileMapping;
+
+#else
+    (void) nOffset;
+    (void) nAlignedOffset;
+    (void) nDelta;
+    (void) pBase;
+    return NULL;
+#endif
+
+#if defined(VSI_MAP_POSIX) || defined(VSI_MAP_WIN32)
+    psMapping->pBase = pBase;
+    psMapping->nLength = nSize + nDelta;
+    *phMapping = psMapping;
+
+    return ((GByte *) pBase) + nDelta;
+#endif
+}
+
+/************************************************************************/
+/*                             VSIFUnmapL()                             */
+/************************************************************************/
+
+/**
+ * \brief Unmap a file region mapped with VSIFMapL().
+ *
+ * @param hMapping the mapping handle returned by VSIFMapL(), may be NULL.
+ */
+
+void VSIFUnmapL( void *hMapping )
+
+{
+    VSIFileMapping *psMapping = (VSIFileMapping *) hMapping;
+
+    if( psMapping == NULL )
+        return;
+
+#if defined(VSI_MAP_POSIX)
+    munmap( psMapping->pBase, psMapping->nLength );
+#elif defined(VSI_MAP_WIN32)
+    UnmapViewOfFile( psMapping->pBase );
+    CloseHandle( psMapping->hFileMapping );
+#endif
+
+    VSIFree( psMapping );
+}
+
 /************************************************************************/
 /* ==================================================================== */
 /*                           VSIFileManager()                           */
@@ -129,6 +129,7 @@ class VSIUnixStdioHandle : public VSIVirtualHandle
     virtual int       Eof();
     virtual int       Flush();
     virtual int       Close();
+    virtual void     *GetNativeFileDescriptor();
 };
 
 /************************************************************************/
@@ -243,6 +244,16 @@ int VSIUnixStdioHandle::Flush()
     return fflush( fp );
 }
 
+/************************************************************************/
+/*                      GetNativeFileDescriptor()                       */
+/************************************************************************/
+
+void *VSIUnixStdioHandle::GetNativeFileDescriptor()
+
+{
+    return (void *) (size_t) fileno( fp );
+}
+
 /************************************************************************/
 /*                                Read()                                */
 /************************************************************************/
@@ -89,6 +89,7 @@ class VSIWin32Handle : public VSIVirtualHandle
     virtual int       Eof();
     virtual int       Flush();
     virtual int       Close();
+    virtual void     *GetNativeFileDescriptor();
 };
 
 /************************************************************************/
@@ -269,6 +270,16 @@ int VSIWin32Handle::Flush()
     return 0;
 }
 
+/************************************************************************/
+/*                      GetNativeFileDescriptor()                       */
+/************************************************************************/
+
+void *VSIWin32Handle::GetNativeFileDescriptor()
+
+{
+    return (void *) hFile;
+}
+
 /************************************************************************/
 /*                                Read()                                */
 /************************************************************************/
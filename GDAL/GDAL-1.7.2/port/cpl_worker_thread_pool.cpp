@@ -0,0 +1,349 @@
+/**********************************************************************
+ * $Id$
+ *
+ * Project:  CPL - Common Portability Library
+ * Purpose:  Simple job runner distributing work over a pool of threads.
+ *
+ **********************************************************************
+ * Copyright (c) 2010, GDAL contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "cpl_worker_thread_pool.h"
+#include "cpl_multiproc.h"
+#include "cpl_atomic_ops.h"
+#include "cpl_conv.h"
+#include "cpl_error.h"
+
+#if defined(WIN32)
+#  include <windows.h>
+#elif defined(HAVE_UNISTD_H)
+#  include <unistd.h>
+#endif
+
+CPL_CVSID("$Id$");
+
+typedef struct _CPLJobQueue
+{
+    CPLJobFunc      pfnJob;
+    void           *pUserData;
+    int             nJobCount;
+
+    volatile int    nNextJob;
+    volatile int    bFailed;
+
+    /* helper slots still open, and helpers working on the queue, */
+    /* both protected by hPoolMutex */
+    int             nHelperSlots;
+    int             nActiveHelpers;
+    struct _CPLJobQueue *psNext;
+
+    /* first error of a failed job, if it ran on a helper thread */
+    void           *hMutex;
+    int             bErrorRecorded;
+    CPLErr          eErrClass;
+    int             nErrNo;
+    char           *pszErrMsg;
+} CPLJobQueue;
+
+/* -------------------------------------------------------------------- */
+/*      The worker threads are created on demand and then kept, idle    */
+/*      threads waiting on hWorkCond for a queue with an open helper    */
+/*      slot.  The calling thread of CPLRunJobs() waits on hDoneCond    */
+/*      for the helpers of its queue to finish their last job.          */
+/* -------------------------------------------------------------------- */
+#define CPL_MAX_WORKER_THREADS 128
+
+static void *hPoolMutex = NULL;
+static void *hWorkCond = NULL;
+static void *hDoneCond = NULL;
+static CPLJobQueue *psPendingQueues = NULL;
+static int nWorkerCount = 0;
+static int nIdleWorkerCount = 0;
+
+/************************************************************************/
+/*                           CPLGetNumCPUs()                            */
+/************************************************************************/
+
+/**
+ * \brief Return the number of processors available.
+ *
+ * @return the number of online processors, or 1 if it cannot be determined.
+ */
+
+int CPLGetNumCPUs()
+
+{
+#if defined(WIN32)
+    SYSTEM_INFO sInfo;
+
+    GetSystemInfo( &sInfo );
+    return MAX(1, (int) sInfo.dwNumberOfProcessors);
+#elif defined(_SC_NPROCESSORS_ONLN)
+    return MAX(1, (int) sysconf( _SC_NPROCESSORS_ONLN ));
+#else
+    return 1;
+#endif
+}
+
+/************************************************************************/
+/*                         CPLParseNumThreads()                         */
+/************************************************************************/
+
+/**
+ * \brief Parse a NUM_THREADS style option value.
+ *
+ * The value may be a number of threads, or ALL_CPUS to use one thread per
+ * processor.
+ *
+ * @param pszValue the option value, or NULL.
+ * @param nDefault the value returned if pszValue is NULL or empty.
+ *
+ * @return the number of threads to use, at least 1.
+ */
+
+int CPLParseNumThreads( const char *pszValue, int nDefault )
+
+{
+    int nThreads;
+
+    if( pszValue == NULL || pszValue[0] == '\0' )
+        nThreads = nDefault;
+    else if( EQUAL(pszValue, "ALL_CPUS") )
+        nThreads = CPLGetNumCPUs();
+    else
+        nThreads = atoi( pszValue );
+
+    return MAX(1, nThreads);
+}
+
+/************************************************************************/
+/*                           CPLJobQueueRun()                           */
+/*                                                                      */
+/*      Errors end up in the error context of the thread raising        */
+/*      them, so the error of the first failed job is recorded for      */
+/*      CPLRunJobs() to raise it again on the calling thread.  Jobs     */
+/*      failing without an error, typically because another one         */
+/*      failed, are not considered.  An error of the calling thread     */
+/*      is only flagged, as it is already in its context.               */
+/************************************************************************/
+
+static void CPLJobQueueRun( CPLJobQueue *psQueue, int bHelperThread )
+
+{
+    while( !psQueue->bFailed )
+    {
+        int iJob = CPLAtomicInc( &(psQueue->nNextJob) ) - 1;
+
+        if( iJob >= psQueue->nJobCount )
+            break;
+
+        CPLErrorReset();
+
+        if( psQueue->pfnJob( psQueue->pUserData, iJob ) )
+            continue;
+
+        CPLMutexHolderD( &(psQueue->hMutex) );
+
+        if( !psQueue->bErrorRecorded && CPLGetLastErrorType() != CE_None )
+        {
+            psQueue->bErrorRecorded = TRUE;
+            if( bHelperThread )
+            {
+                psQueue->eErrClass = CPLGetLastErrorType();
+                psQueue->nErrNo = CPLGetLastErrorNo();
+                psQueue->pszErrMsg = CPLStrdup( CPLGetLastErrorMsg() );
+            }
+        }
+
+        psQueue->bFailed = TRUE;
+    }
+}
+
+/************************************************************************/
+/*                          CPLJobThreadMain()                          */
+/*                                                                      */
+/*      Main loop of a worker thread: take a helper slot of a pending   */
+/*      queue, help with its jobs, and go back to sleep.                */
+/************************************************************************/
+
+static void CPLJobThreadMain( void *pData )
+
+{
+    CPLAcquireMutex( hPoolMutex, 1000.0 );
+
+    for( ;; )
+    {
+        CPLJobQueue *psQueue = psPendingQueues;
+
+        if( psQueue == NULL )
+        {
+            nIdleWorkerCount++;
+            CPLCondWait( hWorkCond, hPoolMutex );
+            nIdleWorkerCount--;
+            continue;
+        }
+
+        if( --psQueue->nHelperSlots == 0 )
+            psPendingQueues = psQueue->psNext;
+        psQueue->nActiveHelpers++;
+
+        CPLReleaseMutex( hPoolMutex );
+        CPLJobQueueRun( psQueue, TRUE );
+        CPLAcquireMutex( hPoolMutex, 1000.0 );
+
+        if( --psQueue->nActiveHelpers == 0 )
+            CPLCondBroadcast( hDoneCond );
+    }
+}
+
+/************************************************************************/
+/*                         CPLUnlinkJobQueue()                          */
+/************************************************************************/
+
+static void CPLUnlinkJobQueue( CPLJobQueue *psQueue )
+
+{
+    CPLJobQueue **ppsLink = &psPendingQueues;
+
+    while( *ppsLink != NULL && *ppsLink != psQueue )
+        ppsLink = &((*ppsLink)->psNext);
+
+    if( *ppsLink != NULL )
+        *ppsLink = psQueue->psNext;
+}
+
+/************************************************************************/
+/*                             CPLRunJobs()                             */
+/************************************************************************/
+
+/**
+ * \brief Run a list of jobs on several threads.
+ *
+ * The jobs 0 to nJobCount-1 are handed out in increasing order to up to
+ * nThreadCount threads, the calling thread being one of them.  Each thread
+ * fetches the next pending job as soon as it is done with the previous one,
+ * so jobs of uneven cost are balanced over the threads.  The function
+ * returns when all jobs are finished.
+ *
+ * The helper threads come from a process wide pool.  They are created the
+ * first time they are needed and then wait for the next call, so calling
+ * this function repeatedly does not create threads each time.  As the
+ * calling thread runs the jobs itself when no helper is free, jobs may call
+ * CPLRunJobs() too.
+ *
+ * If a job returns FALSE, no more jobs are started, and jobs already
+ * running are completed.  If the first failed job ran on a helper thread,
+ * the last error it raised is raised again on the calling thread once all
+ * jobs are done, so that CPLGetLastErrorMsg() reports it.  The job callback
+ * is responsible for any locking needed to access shared state, and for
+ * collecting results.
+ *
+ * If threads cannot be created (for instance with the stub multiprocessing
+ * implementation), all the jobs are run on the calling thread.
+ *
+ * @param nJobCount the number of jobs.
+ * @param nThreadCount the maximum number of threads to use.
+ * @param pfnJob the callback processing one job.
+ * @param pUserData user data passed to pfnJob.
+ *
+ * @return TRUE if all jobs succeeded, FALSE otherwise.
+ */
+
+int CPLRunJobs( int nJobCount, int nThreadCount,
+                CPLJobFunc pfnJob, void *pUserData )
+
+{
+    CPLJobQueue sQueue;
+    int         bOffered = FALSE;
+
+    sQueue.pfnJob = pfnJob;
+    sQueue.pUserData = pUserData;
+    sQueue.nJobCount = nJobCount;
+    sQueue.nNextJob = 0;
+    sQueue.bFailed = FALSE;
+    sQueue.nHelperSlots = MIN(nThreadCount, nJobCount) - 1;
+    sQueue.nActiveHelpers = 0;
+    sQueue.psNext = NULL;
+    sQueue.hMutex = NULL;
+    sQueue.bErrorRecorded = FALSE;
+    sQueue.eErrClass = CE_None;
+    sQueue.nErrNo = CPLE_None;
+    sQueue.pszErrMsg = NULL;
+
+/* -------------------------------------------------------------------- */
+/*      Offer helper slots to the pool, starting more workers if not    */
+/*      enough of them are idle.  The calling thread works too.         */
+/* -------------------------------------------------------------------- */
+    if( sQueue.nHelperSlots > 0 )
+    {
+        CPLMutexHolderD( &hPoolMutex );
+
+        if( hWorkCond == NULL )
+        {
+            hWorkCond = CPLCreateCond();
+            hDoneCond = CPLCreateCond();
+        }
+
+        if( hWorkCond != NULL && hDoneCond != NULL )
+        {
+            sQueue.psNext = psPendingQueues;
+            psPendingQueues = &sQueue;
+            bOffered = TRUE;
+
+            int nMissing = sQueue.nHelperSlots - nIdleWorkerCount;
+
+            while( nMissing-- > 0 && nWorkerCount < CPL_MAX_WORKER_THREADS )
+            {
+                if( CPLCreateThread( CPLJobThreadMain, NULL ) == -1 )
+                    break;
+                nWorkerCount++;
+            }
+
+            CPLCondBroadcast( hWorkCond );
+        }
+    }
+
+    CPLJobQueueRun( &sQueue, FALSE );
+
+/* -------------------------------------------------------------------- */
+/*      Close the remaining helper slots, and wait for the helpers      */
+/*      to complete their last job.                                     */
+/* -------------------------------------------------------------------- */
+    if( bOffered )
+    {
+        CPLMutexHolderD( &hPoolMutex );
+
+        CPLUnlinkJobQueue( &sQueue );
+        while( sQueue.nActiveHelpers > 0 )
+            CPLCondWait( hDoneCond, hPoolMutex );
+    }
+
+    if( sQueue.hMutex != NULL )
+        CPLDestroyMutex( sQueue.hMutex );
+
+    if( sQueue.pszErrMsg != NULL )
+    {
+        CPLError( sQueue.eErrClass, sQueue.nErrNo, "%s", sQueue.pszErrMsg );
+        CPLFree( sQueue.pszErrMsg );
+    }
+
+    return !sQueue.bFailed;
+}
@@ -0,0 +1,56 @@
+/**********************************************************************
+ * $Id$
+ *
+ * Project:  CPL - Common Portability Library
+ * Purpose:  Simple job runner distributing work over a pool of threads.
+ *
+ **********************************************************************
+ * Copyright (c) 2010, GDAL contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef _CPL_WORKER_THREAD_POOL_H_INCLUDED_
+#define _CPL_WORKER_THREAD_POOL_H_INCLUDED_
+
+#include "cpl_port.h"
+
+/**
+ * \file cpl_worker_thread_pool.h
+ *
+ * Helpers to run a list of independent jobs on several threads, built
+ * on top of the primitives of cpl_multiproc.h.  The threads are kept in
+ * a process wide pool between calls.
+ */
+
+CPL_C_START
+
+/**
+ * Job callback: process job iJob, and return FALSE to stop processing.
+ */
+typedef int (*CPLJobFunc)( void *pUserData, int iJob );
+
+int CPL_DLL CPLGetNumCPUs( void );
+int CPL_DLL CPLParseNumThreads( const char *pszValue, int nDefault );
+int CPL_DLL CPLRunJobs( int nJobCount, int nThreadCount,
+                        CPLJobFunc pfnJob, void *pUserData );
+
+CPL_C_END
+
+#endif /* _CPL_WORKER_THREAD_POOL_H_INCLUDED_ */